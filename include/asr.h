@@ -4,10 +4,18 @@
 #include <atomic>
 #include <string>
 #include <chrono>
-#include "queue.h"
+#include <future>
+#include <memory>
+#include <vector>
 #include "whisper.h"
 #include "process.h"
+#include "event_bus.h"
 #include "inference.h"
+#include "metrics.h"
+#include "transcript_stabilizer.h"
+
+class AudioSource;
+class ReplayClock;
 
 #define SAMPLE_RATE 16000
 #define CHANNELS 1
@@ -15,6 +23,21 @@
 #define FRAME_LEN ((SAMPLE_RATE / 1000) * FRAME_MS) // samples per frame (320 for 20ms @ 16kHz)
 #define MAX_SPEECH_SECONDS 5
 #define TASK_CODE 50259
+// re-decode the growing recording this often while the viewer speaks, 0 disables partials
+#define ASR_PARTIAL_INTERVAL_MS 1000
+
+// ASR stage latencies and counters in the metrics registry
+struct ASRMetrics {
+    Histogram& wakeup;              // GazeStarted publish to ASR thread wakeup
+    Histogram& mel;
+    Histogram& encoder;
+    Histogram& decode_step;         // one decoder run, one token
+    Histogram& decoder;
+    Counter& partial_decoded;
+    Counter& partial_published;
+    Counter& partial_unchanged;
+    ASRMetrics();
+};
 
 /**
  * @class ASRThread
@@ -25,10 +48,10 @@
  */
 class ASRThread {
 private:
-    ThreadSafeQueue<InferenceResult>& jsonResultQueue;
-    ThreadSafeQueue<InferenceResult>& bsvarResultQueue;
+    ResultRing& results;
     std::atomic<bool>& running;
-    std::atomic<bool>& asr_trigger;
+    EventBus& events;
+    EventMailbox& gaze_events;      // GazeStarted from the inference thread
     std::string asr_model_path;
     int sample_rate;
     int channels;
@@ -37,18 +60,41 @@ private:
     std::string encoder_model_path;
     std::string decoder_model_path;
     std::string vocab_path;
-    std::string alsa_device;
+    std::unique_ptr<AudioSource> audio_source;
     int task_code;
     std::string mel_filters_path;
-    std::mutex& gaze_mutex;
-    std::condition_variable& gaze_cv;
-    bool& trigger_asr;
-    std::atomic<bool>& asr_busy;
-    std::atomic<int>& current_faces_attending;
-    std::atomic<int>& current_total_faces;
     std::vector<float> mel_filters;
-    rknn_whisper_context_t rknn_app_ctx;
+    whisper_context_t whisper_ctx;
     VocabEntry vocab[VOCAB_NUM];
+
+    int partial_interval_ms;
+    TranscriptStabilizer stabilizer;
+    std::future<std::string> partial;   // partial decode in flight, at most one
+    size_t partial_samples{0};          // recording length when the last partial started
+    FaceSnapshot session_faces;         // faces when the session was triggered
+    ASRMetrics asr_metrics;
+    ReplayClock* replay_clock;          // null unless replaying recorded audio
+
+    // Records the stage timings and trace spans of the last inference_whisper_model() call
+    void recordWhisperPerf(std::chrono::steady_clock::time_point mel_start,
+                           std::chrono::steady_clock::time_point infer_start,
+                           std::chrono::steady_clock::time_point infer_end);
+
+    /**
+     * @brief Normalizes 16 kHz mono samples and runs the Whisper encoder and decoder on them
+     * @return the recognized text, empty on failure
+     */
+    std::string decodeSamples(std::vector<short> samples, uint64_t trace_id);
+    /**
+     * @brief Called by the recorder for every frame while speech is being recorded
+     *
+     * Publishes a finished partial decode, and starts the next one once
+     * partial_interval_ms of new audio has been recorded. Decoding runs on
+     * a worker so capture keeps up; results are published from this thread.
+     */
+    void onSpeech(const std::vector<short>& recorded);
+    // Publishes a finished partial decode; with discard, waits for one in flight and drops it
+    void collectPartial(bool discard);
     /**
      * @brief Runs the automatic speech recognition process
      * @return InferenceResult containing the recognized text and face count information
@@ -75,20 +121,15 @@ public:
         const std::string& whisper_decoder_model,
         const std::string& mel_filters_path,
         const std::string& vocabulary_path,
-        ThreadSafeQueue<InferenceResult>& jsonQueue,
-        ThreadSafeQueue<InferenceResult>& bsvarQueue,
+        ResultRing& results,
         std::atomic<bool>& isRunning,
-        std::atomic<bool>& triggerFlag,
-	    std::mutex& gaze_mutex,
-        std::condition_variable& gaze_cv,
-        bool& trigger_asr,
-	    std::atomic<bool>& asr_busy,
-        std::atomic<int>& current_faces_attending,
-        std::atomic<int>& current_total_faces,
-	    std::string &alsa_device,
+        EventBus& events,
+        std::unique_ptr<AudioSource> audio_source,
         int sample_rate = 16000,
         int channels = 1,
-        int record_seconds = 3);
+        int record_seconds = 3,
+        int partial_interval_ms = ASR_PARTIAL_INTERVAL_MS,
+        ReplayClock* replay_clock = nullptr);
     /**
      * @brief Destructor for ASRThread
      * 
@@ -104,7 +145,7 @@ public:
      * Runs the ASR thread main loop.
      * - Waits for gaze detection trigger
      * - Sends "Listening..." status message
-     * - Executes speech recognition
+     * - Executes speech recognition, publishing partial transcripts while the viewer speaks
      * - Publishes results to output queues
      * - Updates face count information from inference thread
      * - Manages thread synchronization and cleanup
@@ -3,6 +3,36 @@
 
 #include "retinaface.h"
 
-bool face_is_looking_at_us(retinaface_object_t face);
+// Head orientation in degrees; 0/0/0 faces the camera. Positive yaw turns
+// towards image right, positive pitch tilts the chin down.
+struct HeadPose {
+    float yaw;
+    float pitch;
+    float roll;
+};
 
-#endif // ATTENTION_H
\ No newline at end of file
+// Head pose of one reported face
+struct FacePose {
+    int id;             // tracker id, stable while the face stays in view
+    float yaw;          // degrees
+    float pitch;
+    float roll;
+    bool attending;
+};
+
+// A face attends when its pose is inside this cone around the camera axis
+struct AttentionCone {
+    float max_yaw_deg{25.f};
+    float max_pitch_deg{20.f};
+    float pitch_offset_deg{0.f};    // camera mounted above/below the screen centre
+};
+
+// Pose of n faces from their 5 landmarks, laid out as n x 5 x (x, y) in
+// RetinaFace order: left eye, right eye, nose, left mouth, right mouth
+void estimate_head_poses(const float* landmarks, int n, HeadPose* poses);
+
+bool pose_in_cone(const HeadPose& pose, const AttentionCone& cone);
+
+bool face_is_looking_at_us(const retinaface_object_t& face, const AttentionCone& cone = AttentionCone());
+
+#endif // ATTENTION_H
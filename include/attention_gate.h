@@ -0,0 +1,71 @@
+#ifndef ATTENTION_GATE_H
+#define ATTENTION_GATE_H
+
+#include <vector>
+
+#include "face_tracker.h"
+
+struct AttentionGateConfig {
+    double dwell_s{0.8};        // continuous attention before a track may start ASR
+    double release_s{0.4};      // look-aways shorter than this do not reset the dwell
+    double cooldown_s{5.0};     // no triggers after an empty or failed transcription
+};
+
+// Counters of ASR runs started and of runs the old "any face attending"
+// rule would have started but the gate held back
+struct AttentionGateStats {
+    long triggers{0};
+    long empty_transcripts{0};
+    long avoided_glance{0};     // attention ended before the dwell time
+    long avoided_cooldown{0};   // dwell reached while cooling down
+    long avoided_repeat{0};     // track already triggered and never looked away
+};
+
+enum class GateState {
+    Idle,
+    Listening,
+    Cooldown,
+};
+
+// Decides when a tracked face has paid attention long enough to open the
+// microphone. Each track has to dwell on its own and re-arms only after
+// looking away, so one viewer does not restart ASR back to back.
+class AttentionGate {
+private:
+    struct TrackState {
+        int id;
+        double attend_s;        // continuous attention, survives short look-aways
+        double away_s;
+        bool triggered;         // served by a listening session, re-arms on look-away
+        bool cooldown_counted;
+        bool seen;
+    };
+
+    AttentionGateConfig config;
+    AttentionGateStats stats;
+    GateState state{GateState::Idle};
+    double cooldown_left{0};
+    std::vector<TrackState> states;
+
+    void endEpisode(TrackState& ts);
+
+public:
+    explicit AttentionGate(const AttentionGateConfig& config = AttentionGateConfig());
+
+    /**
+     * @brief Advance the gate by one frame
+     * @param tracks current tracks, only visible ones are considered
+     * @return id of the track that should start ASR now, or -1
+     */
+    int update(const std::vector<FaceTrack>& tracks, const FaceTrackerConfig& tracker_config, double dt);
+
+    // The listening session ended; an empty transcript starts the cooldown
+    void asrFinished(bool empty);
+
+    GateState getState() const { return state; }
+    // Attention time of a track, 0 if it is not tracked
+    double getAttendSeconds(int track_id) const;
+    const AttentionGateStats& getStats() const { return stats; }
+};
+
+#endif // ATTENTION_GATE_H
@@ -0,0 +1,42 @@
+#ifndef AUDIO_SOURCE_H
+#define AUDIO_SOURCE_H
+
+#include <string>
+
+#include <alsa/asoundlib.h>
+
+/**
+ * @class AudioSource
+ * @brief Where the recorder reads 16 kHz mono frames from
+ *
+ * The source is opened when an ASR session starts listening and closed when
+ * the recording ends. ALSA capture in production, WAV files in replay runs
+ * (see ReplayAudioSource).
+ */
+class AudioSource {
+public:
+    virtual ~AudioSource() = default;
+    virtual bool open() = 0;
+    // Fills frame with len samples; false on a read error
+    virtual bool read(short* frame, int len) = 0;
+    virtual void close() = 0;
+    virtual const std::string& getName() const = 0;
+};
+
+// ALSA capture device, e.g. plughw:1,0
+class AlsaAudioSource : public AudioSource {
+public:
+    explicit AlsaAudioSource(const std::string& device);
+    ~AlsaAudioSource() override;
+
+    bool open() override;
+    bool read(short* frame, int len) override;
+    void close() override;
+    const std::string& getName() const override { return device; }
+
+private:
+    std::string device;
+    snd_pcm_t* pcm_handle{nullptr};
+};
+
+#endif // AUDIO_SOURCE_H
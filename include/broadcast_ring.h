@@ -0,0 +1,206 @@
+#ifndef BROADCAST_RING_H
+#define BROADCAST_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <unistd.h>
+
+constexpr size_t RING_CACHE_LINE = 64;
+
+// Power of two at or above requested, minimum 2
+inline size_t ring_capacity(size_t requested) {
+    size_t capacity = 2;
+    while (capacity < requested) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+struct BroadcastConsumerStats {
+    uint64_t lag;               // entries published but not yet released
+    uint64_t max_lag;           // worst lag seen at publish time
+};
+
+/**
+ * @class BroadcastRing
+ * @brief Ring that every consumer reads at its own cursor
+ *
+ * Disruptor-style: each entry is stored once and consumers read it in place,
+ * so adding a sink costs a cursor, not a copy. A slot is only overwritten
+ * after every consumer has released it; when the slowest consumer is a full
+ * ring behind, publish() waits (and counts the stall) and tryPublish() drops
+ * the new entry (and counts the drop). Producers claim sequence numbers with
+ * a CAS and make them visible in order, so a few threads may publish.
+ * Consumers are registered before the threads start.
+ *
+ * A consumer that multiplexes the ring with sockets can register an eventfd,
+ * which is signalled on every publish and on shutdown.
+ */
+template<typename T>
+class BroadcastRing {
+public:
+    static constexpr int MAX_CONSUMERS = 8;
+
+    explicit BroadcastRing(size_t requested)
+        : capacity(ring_capacity(requested)), mask(capacity - 1), slots(new T[capacity]) {}
+
+    int addConsumer() {
+        if (consumer_count == MAX_CONSUMERS) {
+            throw std::length_error("BroadcastRing: too many consumers");
+        }
+        return consumer_count++;
+    }
+
+    // Before the threads start; the fd stays owned by the caller
+    void setEventFd(int fd) { event_fd = fd; }
+
+    // Waits for room when the ring is full. Returns false once shut down.
+    bool publish(T value) { return publishEntry(std::move(value), true); }
+
+    // Drops the entry and returns false when the ring is full, instead of waiting
+    bool tryPublish(T value) { return publishEntry(std::move(value), false); }
+
+    /**
+     * @brief Next entry for a consumer, blocking until one is published
+     * @return the entry, valid until release(); nullptr after shutdown once drained
+     */
+    const T* wait(int consumer) {
+        uint64_t cursor = consumers[consumer].cursor.load(std::memory_order_relaxed);
+        for (;;) {
+            uint32_t seen = wake.load(std::memory_order_acquire);
+            if (cursor < published.load(std::memory_order_acquire)) {
+                return &slots[cursor & mask];
+            }
+            if (shutdown.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            wake.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    // Non-blocking wait(), nullptr when nothing new is published
+    const T* poll(int consumer) {
+        uint64_t cursor = consumers[consumer].cursor.load(std::memory_order_relaxed);
+        if (cursor < published.load(std::memory_order_acquire)) {
+            return &slots[cursor & mask];
+        }
+        return nullptr;
+    }
+
+    // Done with the entry returned by wait() or poll()
+    void release(int consumer) {
+        consumers[consumer].cursor.fetch_add(1, std::memory_order_release);
+        released.fetch_add(1, std::memory_order_release);
+        released.notify_one();
+    }
+
+    void signalShutdown() {
+        shutdown.store(true, std::memory_order_release);
+        wake.fetch_add(1, std::memory_order_release);
+        wake.notify_all();
+        released.fetch_add(1, std::memory_order_release);
+        released.notify_all();
+        signalEventFd();
+    }
+
+    BroadcastConsumerStats getStats(int consumer) const {
+        uint64_t head = published.load(std::memory_order_acquire);
+        return {head - consumers[consumer].cursor.load(std::memory_order_acquire),
+                consumers[consumer].max_lag.load(std::memory_order_relaxed)};
+    }
+    // times publish() had to wait for a slow consumer
+    uint64_t getStalls() const { return stalls.load(std::memory_order_relaxed); }
+    // entries tryPublish() dropped because the ring was full
+    uint64_t getDrops() const { return drops.load(std::memory_order_relaxed); }
+    size_t getCapacity() const { return capacity; }
+
+private:
+    struct alignas(RING_CACHE_LINE) Consumer {
+        std::atomic<uint64_t> cursor{0};
+        std::atomic<uint64_t> max_lag{0};
+    };
+
+    bool publishEntry(T&& value, bool wait_for_room) {
+        uint64_t seq = claimed.load(std::memory_order_relaxed);
+        bool stalled = false;
+        for (;;) {
+            uint32_t seen = released.load(std::memory_order_acquire);
+            if (seq - slowestCursor() < capacity) {
+                // cursors only move forward, so the slot stays free once claimed
+                if (claimed.compare_exchange_weak(seq, seq + 1, std::memory_order_acq_rel,
+                                                  std::memory_order_relaxed)) {
+                    break;
+                }
+                continue;
+            }
+            if (shutdown.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (!wait_for_room) {
+                drops.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (!stalled) {
+                stalls.fetch_add(1, std::memory_order_relaxed);
+                stalled = true;
+            }
+            released.wait(seen, std::memory_order_acquire);
+            seq = claimed.load(std::memory_order_relaxed);
+        }
+        slots[seq & mask] = std::move(value);
+        // entries become visible in claim order; a later claim waits for the one before
+        for (uint64_t head = published.load(std::memory_order_acquire); head != seq;
+             head = published.load(std::memory_order_acquire)) {
+            published.wait(head, std::memory_order_acquire);
+        }
+        published.store(seq + 1, std::memory_order_release);
+        published.notify_all();
+        wake.fetch_add(1, std::memory_order_release);
+        wake.notify_all();
+        signalEventFd();
+        for (int i = 0; i < consumer_count; ++i) {
+            uint64_t lag = seq + 1 - consumers[i].cursor.load(std::memory_order_relaxed);
+            uint64_t max_lag = consumers[i].max_lag.load(std::memory_order_relaxed);
+            while (lag > max_lag &&
+                   !consumers[i].max_lag.compare_exchange_weak(max_lag, lag, std::memory_order_relaxed)) {
+            }
+        }
+        return true;
+    }
+
+    void signalEventFd() {
+        if (event_fd >= 0) {
+            uint64_t one = 1;
+            // a full counter already means "readable", nothing to lose
+            (void)!write(event_fd, &one, sizeof(one));
+        }
+    }
+
+    uint64_t slowestCursor() const {
+        uint64_t slowest = published.load(std::memory_order_relaxed);
+        for (int i = 0; i < consumer_count; ++i) {
+            slowest = std::min(slowest, consumers[i].cursor.load(std::memory_order_acquire));
+        }
+        return slowest;
+    }
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<T[]> slots;
+    Consumer consumers[MAX_CONSUMERS];
+    int consumer_count{0};
+    int event_fd{-1};
+    alignas(RING_CACHE_LINE) std::atomic<uint64_t> claimed{0};
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint32_t> wake{0};      // bumped on publish and shutdown, consumers wait on it
+    alignas(RING_CACHE_LINE) std::atomic<uint32_t> released{0};
+    std::atomic<uint64_t> stalls{0};
+    std::atomic<uint64_t> drops{0};
+    std::atomic<bool> shutdown{false};
+};
+
+#endif // BROADCAST_RING_H
@@ -0,0 +1,118 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "attention.h"
+
+struct InferenceResult;
+
+// faces carried by value in an event; counts stay exact beyond this
+constexpr int EVENT_MAX_FACES = 16;
+constexpr int EVENT_BUS_MAX_MAILBOXES = 8;
+
+enum class EventType : uint32_t {
+    GazeStarted = 1u << 0,      // inference -> ASR: a tracked face attended long enough
+    GazeEnded = 1u << 1,        // inference: nobody is attending any more
+    ListeningStarted = 1u << 2, // ASR: microphone is open
+    TranscriptReady = 1u << 3,  // ASR: session finished, empty on silence or failure
+};
+
+constexpr uint32_t eventMask(EventType type) { return static_cast<uint32_t>(type); }
+
+// Faces at the moment the event was raised
+struct FaceSnapshot {
+    int total{0};
+    int attending{0};
+    int count{0};               // entries in faces, at most EVENT_MAX_FACES
+    FacePose faces[EVENT_MAX_FACES];
+
+    void assign(const InferenceResult& result);
+    std::vector<FacePose> toVector() const;
+};
+
+struct Event {
+    EventType type;
+    std::chrono::steady_clock::time_point time;     // monotonic, set by publish()
+    int track_id{-1};           // track that triggered, GazeStarted only
+    uint64_t trace_id{0};       // interaction started by GazeStarted, carried by the ASR events
+    bool transcript_empty{false};
+    FaceSnapshot faces;
+};
+
+// Consumer-side wakeup latency, publish() to pop
+struct MailboxStats {
+    long events{0};
+    long dropped{0};
+    double latency_sum_us{0};
+    double latency_max_us{0};
+};
+
+/**
+ * @class EventMailbox
+ * @brief Bounded lock-free multi-producer, single-consumer event ring
+ *
+ * Slots carry a sequence number (Vyukov bounded queue), so producers and the
+ * consumer never take a lock. Blocking waits use C++20 atomic wait on a
+ * post counter, which cannot miss a wakeup: the consumer sleeps only if the
+ * counter still has the value it saw before its last empty check.
+ */
+class EventMailbox {
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        Event event;
+    };
+
+    uint32_t mask;
+    size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<uint64_t> head{0};     // next slot to write
+    alignas(64) std::atomic<uint64_t> tail{0};     // next slot to read
+    alignas(64) std::atomic<uint32_t> posted{0};
+    std::atomic<bool> closed{false};
+    std::atomic<long> dropped{0};
+    MailboxStats stats;
+
+    void record(const Event& event);
+
+public:
+    EventMailbox(uint32_t mask, size_t capacity);
+
+    bool accepts(EventType type) const { return (mask & eventMask(type)) != 0; }
+
+    // Lock-free; drops the event and counts it when the ring is full
+    bool post(const Event& event);
+    bool tryPop(Event& event);
+    // Blocks until an event arrives; false once the bus is shut down
+    bool waitPop(Event& event);
+    void close();
+
+    const MailboxStats& getStats();
+};
+
+/**
+ * @class EventBus
+ * @brief Typed fan-out of Events to subscriber mailboxes
+ *
+ * Subscriptions are made before the threads start; publish() is lock-free
+ * and may be called from any thread.
+ */
+class EventBus {
+private:
+    std::unique_ptr<EventMailbox> mailboxes[EVENT_BUS_MAX_MAILBOXES];
+    int mailbox_count{0};
+
+public:
+    // Throws std::runtime_error once all EVENT_BUS_MAX_MAILBOXES are taken
+    EventMailbox& subscribe(uint32_t mask, size_t capacity = 16);
+    void publish(Event event);
+    // Wakes every waiting consumer; waitPop() returns false afterwards
+    void shutdown();
+};
+
+#endif // EVENT_BUS_H
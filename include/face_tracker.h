@@ -0,0 +1,87 @@
+#ifndef FACE_TRACKER_H
+#define FACE_TRACKER_H
+
+#include <vector>
+
+#include "attention.h"
+#include "retinaface.h"
+
+// Constant-velocity Kalman filter on one coordinate, state [position, velocity]
+struct Kalman1D {
+    float pos{0};
+    float vel{0};
+    float p00{0};
+    float p01{0};
+    float p11{0};
+
+    void init(float z, float r);
+    void predict(float dt, float q);
+    void update(float z, float r);
+};
+
+struct FaceTrackerConfig {
+    float iou_threshold{0.3f};      // minimum IoU to associate a detection with a track
+    int min_hits{2};                // detections before a track is reported
+    int max_misses{3};              // detection rounds without a match before a track is dropped
+    float landmark_alpha{0.6f};     // EMA weight of a new landmark measurement
+    float process_noise{1.0f};      // velocity change per second, in face heights
+    float measurement_noise{0.04f}; // detector jitter, in face heights
+    AttentionCone cone;             // head pose counted as attending
+};
+
+struct FaceTrack {
+    int id;
+    retinaface_object_t face;       // smoothed box and landmarks, predicted between detections
+    int hits{0};
+    int misses{0};
+    bool attending{false};
+    HeadPose pose{};                // from the latest matched detection
+    double dwell_s{0};              // time since the track was first seen
+    double attention_s{0};          // accumulated time spent attending
+
+    // true when the track should be counted and drawn
+    bool visible(const FaceTrackerConfig& config) const {
+        return hits >= config.min_hits && misses == 0;
+    }
+
+    // filter state, pixel units
+    Kalman1D cx;
+    Kalman1D cy;
+    Kalman1D w;
+    Kalman1D h;
+    float landmark_dx[5];           // landmarks relative to the box centre
+    float landmark_dy[5];
+};
+
+// SORT-style multi-face tracker. Detections are associated to tracks by IoU
+// against the predicted boxes; between detector runs the tracks are only
+// predicted, so the detector does not have to run on every frame.
+class FaceTracker {
+private:
+    FaceTrackerConfig config;
+    std::vector<FaceTrack> tracks;
+    std::vector<int> track_match;
+    std::vector<int> det_match;
+    std::vector<int> pose_pending;  // tracks updated this round
+    std::vector<float> pose_landmarks;
+    std::vector<HeadPose> pose_out;
+    int next_id{1};
+
+    void advance(double dt);
+    void refreshFace(FaceTrack& track);
+    void accumulate(double dt);
+    void estimatePoses(const retinaface_result& detections);
+
+public:
+    explicit FaceTracker(const FaceTrackerConfig& config = FaceTrackerConfig());
+
+    // Frame with fresh detections
+    void update(const retinaface_result& detections, double dt);
+    // Frame without detections, tracks coast on their velocity
+    void predict(double dt);
+
+    const std::vector<FaceTrack>& getTracks() const { return tracks; }
+    const FaceTrackerConfig& getConfig() const { return config; }
+};
+
+#endif // FACE_TRACKER_H
@@ -0,0 +1,68 @@
+#ifndef _IMAGE_RESIZE_H_
+#define _IMAGE_RESIZE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+
+/**
+ * @brief Coefficient tables and row buffers of one plane, kept for one geometry
+ */
+typedef struct {
+    int channel;
+    int src_width;
+    int src_height;
+    int crop_x;
+    int crop_y;
+    int crop_width;
+    int crop_height;
+    int dst_box_width;
+    int dst_box_height;
+    void* tables;
+} resize_plane_tables_t;
+
+/**
+ * @brief Resize tables reused while the geometry stays the same
+ * 
+ * Zero-initialize before first use and free with release_resize_tables().
+ * Plane 1 is only used by the UV plane of NV12/NV21. The row buffers are
+ * scratch space, so one set of tables serves one thread at a time.
+ */
+typedef struct {
+    resize_plane_tables_t plane[2];
+} resize_tables_t;
+
+/**
+ * @brief CPU crop, resize and BGR <-> RGB swap behind convert_image
+ *
+ * Fixed-point separable bilinear, bit-identical with the scalar, NEON and
+ * SSE2 kernels. Define IMAGE_RESIZE_NO_SIMD to build the scalar kernel only.
+ * Kept apart from image_utils.c, which needs RGA and turbojpeg, so it can be
+ * built and checked on its own (scripts/checks).
+ *
+ * @param src [in] Source image
+ * @param dst [out] Target image, same format as src except BGR888 <-> RGB888
+ * @param src_box [in] Crop rectangle on source image, NULL for all of it
+ * @param dst_box [in] Rectangle on target image, NULL for all of it
+ * @param color [in] Pad color outside dst_box
+ * @param fill_pad [in] Fill the pad border; 0 leaves it untouched
+ * @param tables [in/out] Tables kept from the last call, rebuilt if the geometry changed; NULL builds them per call
+ * @return int 0: success; -1: error
+ */
+int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rect_t *src_box, image_rect_t *dst_box, char color, int fill_pad,
+                      resize_tables_t *tables);
+
+/**
+ * @brief Free the tables and zero the struct for reuse
+ * 
+ * @param tables [in] Resize tables
+ */
+void release_resize_tables(resize_tables_t *tables);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif // _IMAGE_RESIZE_H_
@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #include "common.h"
+#include "image_resize.h"
 
 /**
  * @brief LetterBox
@@ -17,6 +18,27 @@ typedef struct {
     float scale;
 } letterbox_t;
 
+/**
+ * @brief Letterbox geometry cached across frames of the same size
+ * 
+ * Zero-initialize before first use and free with release_letterbox_cache();
+ * it is recomputed whenever the source or target size changes. The CPU
+ * resize keeps its coefficient tables here for the same geometry.
+ */
+typedef struct {
+    int src_width;
+    int src_height;
+    int dst_width;
+    int dst_height;
+    image_rect_t src_box;
+    image_rect_t dst_box;
+    letterbox_t letterbox;
+    void* dst_addr;
+    char pad_color;
+    int pad_filled;
+    resize_tables_t resize_tables;
+} letterbox_cache_t;
+
 /**
  * @brief Read image file (support png/jpeg/bmp)
  * 
@@ -30,7 +52,7 @@ int read_image(const char* path, image_buffer_t* image);
  * @brief Write image file (support jpg/png)
  * 
  * @param path [in] Image path
- * @param image [in] Image for write (only support IMAGE_FORMAT_RGB888)
+ * @param image [in] Image for write (only support IMAGE_FORMAT_RGB888, jpg also IMAGE_FORMAT_BGR888)
  * @return int 0: success; -1: error
  */
 int write_image(const char* path, const image_buffer_t* image);
@@ -38,6 +60,9 @@ int write_image(const char* path, const image_buffer_t* image);
 /**
  * @brief Convert image for resize and pixel format change
  * 
+ * Source and target formats must match, except BGR888 <-> RGB888 where the
+ * channel swap is done as part of the resize.
+ * 
  * @param src_image [in] Source Image
  * @param dst_image [out] Target Image
  * @param src_box [in] Crop rectangle on source image
@@ -47,6 +72,20 @@ int write_image(const char* path, const image_buffer_t* image);
  */
 int convert_image(image_buffer_t* src_image, image_buffer_t* dst_image, image_rect_t* src_box, image_rect_t* dst_box, char color);
 
+/**
+ * @brief Resize src_box of the source into dst_box of the target
+ * 
+ * Like convert_image, but pixels outside dst_box are left untouched, so
+ * several crops can be placed into one target image.
+ * 
+ * @param src_image [in] Source Image
+ * @param dst_image [out] Target Image
+ * @param src_box [in] Crop rectangle on source image
+ * @param dst_box [in] Rectangle on target image
+ * @return int 
+ */
+int convert_image_into_box(image_buffer_t* src_image, image_buffer_t* dst_image, image_rect_t* src_box, image_rect_t* dst_box);
+
 /**
  * @brief Convert image with letterbox
  * 
@@ -58,6 +97,27 @@ int convert_image(image_buffer_t* src_image, image_buffer_t* dst_image, image_re
  */
 int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color);
 
+/**
+ * @brief Convert image with letterbox, reusing cached geometry
+ * 
+ * The target image must already be allocated. The pad border is only filled
+ * when the geometry, color or target buffer changes.
+ * 
+ * @param src_image [in] Source Image
+ * @param dst_image [out] Target Image (preallocated)
+ * @param cache [in/out] Letterbox cache, cache->letterbox holds the result
+ * @param color [in] Fill color on target image
+ * @return int 
+ */
+int convert_image_with_letterbox_cached(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_cache_t* cache, char color);
+
+/**
+ * @brief Free what the letterbox cache holds and zero it
+ * 
+ * @param cache [in] Letterbox cache
+ */
+void release_letterbox_cache(letterbox_cache_t* cache);
+
 /**
  * @brief Get the image size
  * 
@@ -4,6 +4,7 @@
 #include <atomic>
 #include <chrono>
 #include <string>
+#include <vector>
 
 #include "opencv2/core/core.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
@@ -11,51 +12,94 @@
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/videoio.hpp>
 
-#include "queue.h"
+#include "attention_gate.h"
+#include "face_tracker.h"
+#include "inference_result.h"
+#include "broadcast_ring.h"
+#include "metrics.h"
 #include "retinaface.h"
 
-// Struct to hold ML inference results
-struct InferenceResult {
-    // float confidence;
-    // std::string label;
-    int count_all_faces_in_frame;
-    int num_faces_attending;
-    std::string asr;
-    std::chrono::system_clock::time_point timestamp;
+class EventBus;
+class EventMailbox;
+class ReplayClock;
+
+// run the face detector every this many frames, the tracker predicts in between
+constexpr int DEFAULT_DETECT_INTERVAL = 2;
+// with ROI re-detection on, every this many detector runs scan the full frame
+constexpr int DEFAULT_FULL_SCAN_INTERVAL = 5;
+// ROI side length as a multiple of the tracked face size
+constexpr float ROI_PAD_SCALE = 2.0f;
+// face-count updates are published at most this often, in video time
+constexpr double FACE_UPDATE_SECONDS = 0.1;
+
+// Results are stored once and read by every publisher at its own cursor
+using ResultRing = BroadcastRing<InferenceResult>;
+constexpr size_t RESULT_RING_CAPACITY = 16;
+
+// Frame stage latencies and counters in the metrics registry
+struct FrameMetrics {
+    Histogram& capture;
+    Histogram& letterbox;
+    Histogram& npu;
+    Histogram& postprocess;
+    Histogram& draw;
+    Histogram& jpeg;
+    Counter& frames;
+    Counter& detect_frames;
+    Counter& roi_frames;
+    Counter& faces_truncated;
+    Gauge& tracks;
+    // mirrored from AttentionGateStats every frame
+    Counter& asr_triggers;
+    Counter& empty_transcripts;
+    Counter& avoided_glance;
+    Counter& avoided_cooldown;
+    Counter& avoided_repeat;
+    FrameMetrics();
 };
 
 class MLInferenceThread {
 private:
-    ThreadSafeQueue<InferenceResult>& jsonResultQueue;
-    ThreadSafeQueue<InferenceResult>& bsvarResultQueue;
+    ResultRing& results;
     std::atomic<bool>& running;
     int target_fps;
-    rknn_app_context_t rknn_app_ctx;
+    retinaface_context_t retinaface_ctx;
+    retinaface_result face_result;
+    FaceTracker tracker;
+    AttentionGate gate;
+    double frame_dt{0};
+    int detect_interval;
+    bool roi_redetect;
+    int full_scan_interval;
+    int detect_rounds{0};
+    std::chrono::steady_clock::time_point last_frame_time;
     cv::VideoCapture capture;
     int frames{0};
-    std::mutex& gaze_mutex;
-    std::condition_variable& gaze_cv;
-    bool& trigger_asr;
-    std::atomic<bool>& asr_busy;
-    std::atomic<int>& current_faces_attending;
-    std::atomic<int>& current_total_faces;
+    EventBus& events;
+    EventMailbox& asr_events;       // ListeningStarted / TranscriptReady from the ASR thread
+    bool gaze_active{false};
+    double face_update_age{FACE_UPDATE_SECONDS};  // video time since the last face-count update
+    FrameMetrics frame_metrics;
+    ReplayClock* replay_clock;      // null when pacing to a live camera
     // Simulated ML model inference
     InferenceResult runInference(cv::Mat& img);
+    void updateFrameMetrics();
+    int collectRois(const cv::Mat& img, image_rect_t* rois);
 
 public:
     MLInferenceThread(
         const std::string& model_path,
         const std::string& source_name,
-        ThreadSafeQueue<InferenceResult>& jsonQueue,
-        ThreadSafeQueue<InferenceResult>& bsvarQueue,
-        std::mutex& gaze_mutex,
-        std::condition_variable& gaze_cv,
-        bool& trigger_asr,
-        std::atomic<bool>& asr_busy,
-        std::atomic<int>& current_faces_attending,
-        std::atomic<int>& current_total_faces,
+        ResultRing& results,
+        EventBus& events,
         std::atomic<bool>& isRunning,
-        int target_fps);
+        int target_fps,
+        int max_faces = RETINAFACE_DEFAULT_MAX_FACES,
+        ReplayClock* replay_clock = nullptr,
+        int detect_interval = DEFAULT_DETECT_INTERVAL,
+        bool roi_redetect = true,
+        int full_scan_interval = DEFAULT_FULL_SCAN_INTERVAL,
+        const AttentionGateConfig& gate_config = AttentionGateConfig());
     ~MLInferenceThread(); // Destructor declaration
     void operator()();
 };
@@ -0,0 +1,113 @@
+#ifndef INFERENCE_BACKEND_H
+#define INFERENCE_BACKEND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class TensorType { Float32, Float16, Int8, UInt8, Int32, Int64, Other };
+// Undefined for tensors that are not images
+enum class TensorFormat { NCHW, NHWC, Undefined };
+
+constexpr int TENSOR_MAX_DIMS = 8;
+
+// Model input or output as the backend reports it
+struct TensorAttr {
+    int index{0};
+    std::string name;
+    int n_dims{0};
+    int64_t dims[TENSOR_MAX_DIMS]{};
+    uint32_t n_elems{0};
+    uint32_t size{0};               // bytes
+    uint32_t size_with_stride{0};   // bytes including row padding, 0 when unpadded
+    uint32_t w_stride{0};           // padded width, 0 when unpadded
+    TensorType type{TensorType::Float32};
+    TensorFormat fmt{TensorFormat::Undefined};
+    bool quantized{false};          // affine int8: real = (q - zp) * scale
+    int32_t zp{0};
+    float scale{1.0f};
+};
+
+// One output of the last run, valid until releaseOutputs()
+struct TensorOutput {
+    int index{0};
+    bool want_float{true};          // dequantize; false keeps int8 outputs as they are
+    void* buf{nullptr};
+    uint32_t size{0};               // bytes
+};
+
+/**
+ * @class InferenceBackend
+ * @brief Runs one model; the model code does its own pre- and post-processing
+ *
+ * Inputs are bound by copy with setInput(), or written in place into memory
+ * from bindInputBuffer() when the backend can hand some out. runAsync()
+ * starts a run and wait() finishes it; outputs are then read with
+ * getOutputs() and handed back with releaseOutputs() before the next run.
+ * Calls return 0 on success and a negative value on failure, like the model
+ * code that uses them. A backend is used by one thread at a time.
+ */
+class InferenceBackend {
+public:
+    virtual ~InferenceBackend() = default;
+
+    virtual int load(const std::string& model_path) = 0;
+    virtual const char* name() const = 0;
+
+    int numInputs() const { return (int)input_attrs.size(); }
+    int numOutputs() const { return (int)output_attrs.size(); }
+    const TensorAttr& inputAttr(int index) const { return input_attrs[index]; }
+    const TensorAttr& outputAttr(int index) const { return output_attrs[index]; }
+
+    // Per-channel (x - mean) / std the model expects on a uint8 image input.
+    // Converted RKNN models apply it themselves; other backends apply it in setInput().
+    virtual void setInputNormalization(int /*index*/, const float* /*mean*/, const float* /*stddev*/, int /*channels*/) {}
+    /**
+     * @brief Memory the caller writes an input into directly, replacing setInput()
+     * @param fd set to a dma-buf fd for the memory, or -1
+     * @return nullptr when the backend cannot bind this input in place
+     */
+    virtual void* bindInputBuffer(int /*index*/, TensorType /*type*/, TensorFormat /*fmt*/, uint32_t /*size*/, int* /*fd*/) {
+        return nullptr;
+    }
+    virtual int setInput(int index, const void* data, uint32_t size, TensorType type, TensorFormat fmt) = 0;
+
+    virtual int runAsync() = 0;
+    virtual int wait() = 0;
+    int run() {
+        int ret = runAsync();
+        return ret < 0 ? ret : wait();
+    }
+
+    // Fills outputs[i].buf and size for outputs[i].index
+    virtual int getOutputs(TensorOutput* outputs, int n) = 0;
+    virtual void releaseOutputs(TensorOutput* outputs, int n) = 0;
+
+protected:
+    std::vector<TensorAttr> input_attrs;
+    std::vector<TensorAttr> output_attrs;
+};
+
+/**
+ * @brief Loads a model on the backend its file name selects
+ *
+ * .rknn runs on the NPU through the RKNN runtime, .onnx on the CPU through
+ * ONNX Runtime when built with WITH_ONNXRUNTIME.
+ * @return nullptr if the model cannot be loaded or its backend is not built in
+ */
+std::unique_ptr<InferenceBackend> loadInferenceBackend(const std::string& model_path);
+
+// The backends behind loadInferenceBackend(), not yet loaded
+std::unique_ptr<InferenceBackend> makeRknnBackend();
+#ifdef BSEXT_WITH_ONNXRUNTIME
+std::unique_ptr<InferenceBackend> makeOnnxRuntimeBackend();
+#endif
+
+// Prints index, name, shape, type and quantization of a tensor
+void printTensorAttr(const TensorAttr& attr);
+const char* tensorTypeName(TensorType type);
+size_t tensorTypeSize(TensorType type);
+
+#endif // INFERENCE_BACKEND_H
@@ -0,0 +1,30 @@
+#ifndef INFERENCE_RESULT_H
+#define INFERENCE_RESULT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "attention.h"
+
+// Struct to hold ML inference results
+struct InferenceResult {
+    // float confidence;
+    // std::string label;
+    int count_all_faces_in_frame;
+    int num_faces_attending;
+    std::vector<FacePose> faces;
+    std::string asr;
+    std::chrono::system_clock::time_point timestamp;
+    // true on the final transcript of an ASR session; false on partial
+    // hypotheses, "Listening..." and face-count updates
+    bool is_final{false};
+    // interaction this result belongs to, see Tracer; 0 for face-count updates
+    uint64_t trace_id{0};
+
+    // Transcript text or the end of a session: never coalesced or filtered out
+    bool carriesTranscript() const { return !asr.empty() || is_final; }
+};
+
+#endif // INFERENCE_RESULT_H
@@ -0,0 +1,51 @@
+#ifndef MESSAGE_FORMATTER_H
+#define MESSAGE_FORMATTER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "inference_result.h"
+#include "message_writer.h"
+
+// Abstract message formatter interface
+class MessageFormatter {
+public:
+    virtual ~MessageFormatter() = default;
+    // Replaces the contents of out; reusing out across calls avoids allocation
+    virtual void formatMessage(const InferenceResult& result, std::string& out) = 0;
+};
+
+// Concrete implementation of MessageFormatter for JSON format, keys sorted
+//  e.g. {"ASR":"","faces":[],"faces_attending":0,"faces_in_frame_total":0,"is_final":false,"timestamp":1746732409,"trace_id":0}
+class JsonMessageFormatter : public MessageFormatter {
+public:
+    void formatMessage(const InferenceResult& result, std::string& out) override;
+};
+
+// Concrete implementation of MessageFormatter for BrightScript variable format
+//  e.g. "faces_attending:0!!faces_in_frame_total:0!!ASR:!!is_final:false!!timestamp:1746732409!!trace_id:0"
+class BSVariableMessageFormatter : public MessageFormatter {
+public:
+    void formatMessage(const InferenceResult& result, std::string& out) override;
+};
+
+// Compact binary format for local high-rate consumers, see docs/WIRE_FORMAT.md
+//  4-byte header (magic "BS", version, flags) then varint fields and a UTF-8 transcript
+constexpr uint8_t WIRE_MAGIC_0 = 'B';
+constexpr uint8_t WIRE_MAGIC_1 = 'S';
+constexpr uint8_t WIRE_VERSION = 1;
+constexpr uint8_t WIRE_FLAG_TRANSCRIPT = 1u << 0;
+constexpr uint8_t WIRE_FLAG_FINAL = 1u << 1;
+constexpr uint8_t WIRE_FACE_ATTENDING = 1u << 0;
+constexpr uint8_t WIRE_FACE_POSE = 1u << 1;
+
+class BinaryMessageFormatter : public MessageFormatter {
+public:
+    void formatMessage(const InferenceResult& result, std::string& out) override;
+};
+
+// Formatter by name: "json", "bsvar" or "binary"; nullptr if unknown
+std::shared_ptr<MessageFormatter> makeMessageFormatter(const std::string& format);
+
+#endif // MESSAGE_FORMATTER_H
@@ -0,0 +1,43 @@
+#ifndef MESSAGE_WRITER_H
+#define MESSAGE_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @class MessageWriter
+ * @brief Appends message fields into a caller-owned buffer
+ *
+ * The buffer is cleared on construction but keeps its capacity, so a
+ * publisher that reuses its buffers does not allocate once they have grown
+ * to the largest message. Numbers are written without locale or temporary
+ * strings.
+ */
+class MessageWriter {
+public:
+    explicit MessageWriter(std::string& out) : out(out) { out.clear(); }
+
+    void raw(std::string_view text) { out.append(text.data(), text.size()); }
+    void raw(char c) { out.push_back(c); }
+    void integer(int64_t value);
+    // one decimal place, "null" for NaN/inf as JSON has no representation
+    void fixed1(float value);
+    // JSON string literal with quotes; invalid UTF-8 becomes U+FFFD
+    void jsonString(std::string_view text);
+    void boolean(bool value) { raw(value ? std::string_view("true") : std::string_view("false")); }
+
+    // Binary fields, see docs/WIRE_FORMAT.md
+    void byte(uint8_t value) { out.push_back((char)value); }
+    // LEB128: 7 bits per byte, least significant group first
+    void varint(uint64_t value);
+    // signed values as zigzag varints so small negatives stay short
+    void zigzag(int64_t value) { varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63)); }
+    // varint byte length then UTF-8; invalid UTF-8 becomes U+FFFD
+    void utf8String(std::string_view text);
+
+private:
+    std::string& out;
+};
+
+#endif // MESSAGE_WRITER_H
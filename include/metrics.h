@@ -0,0 +1,138 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// quantile window, and the period of the compact metrics log line
+constexpr int METRICS_REPORT_SECONDS = 60;
+
+// Monotonic count; set() is only for mirroring a count kept elsewhere
+class Counter {
+public:
+    void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    void set(uint64_t v) { value.store(v, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+class Gauge {
+public:
+    void set(int64_t v) { value.store(v, std::memory_order_relaxed); }
+    int64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value{0};
+};
+
+// Log-linear buckets: values below 16 ns are exact, every power of two
+// above is split into 16 buckets, so a bucket is at most 6.25% wide.
+constexpr int HISTOGRAM_SUB_BITS = 4;
+constexpr int HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+// values are clamped below 2^40 ns, about 18 minutes
+constexpr int HISTOGRAM_MAX_BITS = 40;
+constexpr int HISTOGRAM_BUCKETS = (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+
+// Bucket counts copied out of a Histogram
+struct HistogramSnapshot {
+    std::array<uint64_t, HISTOGRAM_BUCKETS> counts{};
+    uint64_t count{0};
+    uint64_t sum_ns{0};
+
+    // Upper bound of the bucket holding quantile q, 0 when empty
+    uint64_t quantileNs(double q) const;
+};
+
+/**
+ * @class Histogram
+ * @brief HDR-style latency histogram in nanoseconds
+ *
+ * Each histogram is recorded by one thread at a time, so recording is two
+ * uncontended relaxed atomic adds and never takes a lock. Counts are
+ * cumulative; readers snapshot them and subtract the previous snapshot.
+ */
+class Histogram {
+public:
+    void record(uint64_t ns) {
+        buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+        sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+    void recordMs(double ms) { record(ms > 0 ? (uint64_t)(ms * 1e6) : 0); }
+    void recordSince(std::chrono::steady_clock::time_point start) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        record(ns.count() > 0 ? ns.count() : 0);
+    }
+    void snapshot(HistogramSnapshot& out) const;
+
+    static int bucketIndex(uint64_t ns);
+    // Largest value that falls into the bucket
+    static uint64_t bucketUpper(int index);
+
+private:
+    std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS> buckets{};
+    std::atomic<uint64_t> sum_ns{0};
+};
+
+/**
+ * @class MetricsRegistry
+ * @brief Process-wide counters, gauges and histograms
+ *
+ * Metrics are registered once, when the thread or model that records them
+ * is set up, and recorded through the returned reference; registering the
+ * same name and labels again returns the same metric. Histograms are
+ * exported as Prometheus summaries whose quantiles cover the last closed
+ * METRICS_REPORT_SECONDS window; counts and sums are cumulative.
+ */
+class MetricsRegistry {
+public:
+    // labels are in Prometheus form, e.g. stage="npu"
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "");
+
+    // Prometheus text exposition format 0.0.4
+    void writePrometheus(std::string& out);
+    // Close the current window and return the compact log line for it
+    std::string closeWindow(double elapsed_seconds);
+
+private:
+    enum class Kind { Counter, Gauge, Histogram };
+
+    struct Entry {
+        Kind kind;
+        std::string name;
+        std::string help;
+        std::string labels;
+        std::string log_key;                    // name without prefix and unit, then the label values
+        Counter* counter{nullptr};
+        Gauge* gauge{nullptr};
+        Histogram* histogram{nullptr};
+        uint64_t last_count{0};                 // counter value at the last window close
+        std::unique_ptr<HistogramSnapshot> last;        // cumulative at the last window close
+        std::unique_ptr<HistogramSnapshot> window;      // the last closed window
+    };
+
+    Entry& find(Kind kind, const std::string& name, const std::string& help, const std::string& labels);
+
+    std::mutex mutex;                           // registration and export only
+    std::deque<Entry> entries;
+    std::deque<Counter> counters;
+    std::deque<Gauge> gauges;
+    std::deque<Histogram> histograms;
+};
+
+MetricsRegistry& metrics();
+
+// Pipeline stage latency, bsext_stage_seconds{stage="<stage>"}
+Histogram& stageHistogram(const std::string& stage);
+
+#endif // METRICS_H
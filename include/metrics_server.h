@@ -0,0 +1,42 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "metrics.h"
+
+constexpr const char* METRICS_DEFAULT_ENDPOINT = "tcp:127.0.0.1:9464";
+
+/**
+ * @class MetricsServer
+ * @brief Serves the metrics registry over HTTP and logs it periodically
+ *
+ * The endpoint is tcp:<ip>:<port>, unix:<path> for HTTP over a Unix stream
+ * socket, or none. Any GET of / or /metrics is answered with the Prometheus
+ * text format, and GET /trace with the tracer's Chrome trace-event JSON; the
+ * connection is then closed and requests are served one at a time.
+ * Every METRICS_REPORT_SECONDS the quantile window is closed and one compact
+ * line is logged, with or without an endpoint.
+ */
+class MetricsServer {
+public:
+    MetricsServer(const std::string& endpoint, std::atomic<bool>& isRunning);
+    ~MetricsServer();
+
+    void operator()();
+
+private:
+    void serve(int fd);
+
+    std::string endpoint;
+    std::string unix_path;                      // unlinked at exit
+    std::atomic<bool>& running;
+    int listen_fd{-1};
+    long scrapes{0};
+    std::string response;                       // reused across scrapes
+    std::chrono::steady_clock::time_point last_report;
+};
+
+#endif // METRICS_SERVER_H
@@ -2,64 +2,205 @@
 
 #include <string>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/un.h>
 #include <unistd.h>
-#include <nlohmann/json.hpp>
 
 // #include "thread_safe_queue.h"
 #include "inference.h"
+#include "message_formatter.h"
+#include "metrics.h"
 
-using json = nlohmann::json;
-
-// Abstract message formatter interface
-class MessageFormatter {
+// Token bucket limiting a publisher to target_mps messages per second
+class TokenBucket {
 public:
-    virtual ~MessageFormatter() = default;
-    virtual std::string formatMessage(const InferenceResult& result) = 0;
+    TokenBucket(double rate, double burst);
+    // Refill and try to spend up to n tokens; returns how many were granted
+    int take(int n);
+    // Time until the next token is available
+    std::chrono::microseconds untilNext() const;
+
+private:
+    double rate;
+    double burst;
+    double tokens;
+    std::chrono::steady_clock::time_point last;
+    void refill();
 };
 
-// Concrete implementation of MessageFormatter for JSON format
-class JsonMessageFormatter : public MessageFormatter {
-public:
-    std::string formatMessage(const InferenceResult& result) override;
+// Publisher counters, logged every PUBLISHER_REPORT_SECONDS
+struct PublisherStats {
+    long results{0};            // results read from the ring
+    long coalesced{0};          // face-count updates replaced by a newer one before sending
+    long messages{0};           // messages handed to the transport
+    long dropped{0};            // messages the transport refused (full queue, no reader, too large)
+    long syscalls{0};           // send calls
+    double format_cpu_us{0};    // thread CPU time spent formatting
 };
 
-// Concrete implementation of MessageFormatter for BrightScript variable format
-//  e.g. "faces_attending:0!!faces_in_frame_total:0!!timestamp:1746732409"
-class BSVariableMessageFormatter : public MessageFormatter {
-public:
-    std::string formatMessage(const InferenceResult& result) override;
+// Per-sink latencies and counters in the metrics registry, labelled sink="<name>"
+struct PublisherMetrics {
+    Histogram& format;
+    Histogram& send;                // one send call, up to PUBLISHER_MAX_BATCH messages
+    Counter& results;
+    Counter& messages;
+    Counter& dropped;
+    Counter& coalesced;
+    Gauge& lag;
+    explicit PublisherMetrics(const std::string& sink);
 };
 
-// Concrete implementation of MessageFormatter for ASR
-class AsrMessageFormatter : public MessageFormatter {
+// sendmmsg batch size
+constexpr int PUBLISHER_MAX_BATCH = 16;
+constexpr int PUBLISHER_REPORT_SECONDS = 60;
+
+// Formatted message waiting for a token
+struct PendingMessage {
+    std::string message;
+    bool coalescable;           // no transcript, only the latest one matters
+    uint64_t trace_id;          // of the result, for the send span
+};
+
+/**
+ * @class Publisher
+ * @brief Reads results at its own ring cursor, formats, rate-limits and hands them to a transport
+ *
+ * Subclasses implement sendBatch() for one transport. messages_per_second <= 0
+ * disables the rate limit.
+ */
+class Publisher {
 public:
-    std::string formatMessage(const InferenceResult& result) override;
+    Publisher(
+        const std::string& name,
+        ResultRing& results,
+        std::atomic<bool>& isRunning,
+        std::shared_ptr<MessageFormatter> formatter,
+        int messages_per_second);
+    virtual ~Publisher() = default;
+
+    void operator()();
+    BroadcastConsumerStats getLagStats() const { return results.getStats(consumer); }
+    const std::string& getName() const { return name; }
+
+protected:
+    // Send messages[0..n), counting syscalls and dropped messages in stats
+    virtual void sendBatch(const PendingMessage* messages, int n) = 0;
+
+    PublisherStats stats;
+
+private:
+    void collect(const InferenceResult& result);
+    void sendPending();
+    void reportStats();
+
+    std::string name;
+    PublisherMetrics sink_metrics;
+    ResultRing& results;
+    int consumer;                   // this publisher's cursor in results
+    std::atomic<bool>& running;
+    std::shared_ptr<MessageFormatter> formatter;
+    TokenBucket bucket;
+    std::vector<PendingMessage> pending;    // first pending_count entries are live, the rest keep their buffers
+    size_t pending_count{0};
+    std::chrono::steady_clock::time_point last_report;
 };
 
-class UDPPublisher {
+// AF_INET datagrams to ip:port
+class UDPPublisher : public Publisher {
 public:
     UDPPublisher(
         const std::string& ip,
         const int port,
-        ThreadSafeQueue<InferenceResult>& queue,
+        ResultRing& results,
         std::atomic<bool>& isRunning,
         std::shared_ptr<MessageFormatter> formatter,
         int messages_per_second = 1);
-    
-    ~UDPPublisher();
-    
-    void operator()();
+    ~UDPPublisher() override;
+
+protected:
+    void sendBatch(const PendingMessage* messages, int n) override;
 
 private:
-    void setupSocket(const std::string& ip, const int port);
-    
     int sockfd;
     struct sockaddr_in servaddr;
-    ThreadSafeQueue<InferenceResult>& resultQueue;
-    std::atomic<bool>& running;
-    int target_mps;
-    std::shared_ptr<MessageFormatter> formatter;
 };
+
+/**
+ * @class UnixSocketPublisher
+ * @brief AF_UNIX sender for consumers on the device
+ *
+ * SOCK_DGRAM sends to a socket the consumer has bound at path. SOCK_SEQPACKET
+ * connects to a consumer listening at path and reconnects at most once a
+ * second while it is away. Sends never block: a full receive queue or a
+ * missing consumer drops the message and counts it, instead of losing it
+ * silently in the IP stack.
+ */
+class UnixSocketPublisher : public Publisher {
+public:
+    UnixSocketPublisher(
+        const std::string& path,
+        int type,                   // SOCK_DGRAM or SOCK_SEQPACKET
+        ResultRing& results,
+        std::atomic<bool>& isRunning,
+        std::shared_ptr<MessageFormatter> formatter,
+        int messages_per_second = 1);
+    ~UnixSocketPublisher() override;
+
+protected:
+    void sendBatch(const PendingMessage* messages, int n) override;
+
+private:
+    bool connectSocket();
+
+    int sockfd{-1};
+    int type;
+    struct sockaddr_un addr;
+    std::chrono::steady_clock::time_point last_connect;
+};
+
+/**
+ * @class SharedMemoryPublisher
+ * @brief Writes the latest message into a POSIX shared-memory segment (shm_state.h)
+ *
+ * Readers poll the segment without syscalls. The latest message and the
+ * latest message with a transcript are kept in separate records, so a slow
+ * reader still sees the last transcript.
+ */
+class SharedMemoryPublisher : public Publisher {
+public:
+    SharedMemoryPublisher(
+        const std::string& shm_name,
+        ResultRing& results,
+        std::atomic<bool>& isRunning,
+        std::shared_ptr<MessageFormatter> formatter,
+        int messages_per_second = 0);
+    ~SharedMemoryPublisher() override;
+
+protected:
+    void sendBatch(const PendingMessage* messages, int n) override;
+
+private:
+    std::string shm_name;
+    struct ShmStateSegment* segment{nullptr};
+};
+
+// Default rate for a format: 10 messages/s for bsvar, 1000 otherwise
+int defaultMessagesPerSecond(const std::string& format);
+
+/**
+ * @brief Publisher for a sink spec "<format>=<transport>"
+ *
+ * format is json, bsvar or binary; transport is one of
+ *   udp:<ip>:<port>   unix:<path>   seqpacket:<path>   shm:<name>
+ * e.g. "binary=shm:/attention". Shared memory is not rate-limited.
+ * Throws std::invalid_argument on a malformed spec.
+ */
+std::unique_ptr<Publisher> makePublisher(
+    const std::string& spec,
+    ResultRing& results,
+    std::atomic<bool>& isRunning);
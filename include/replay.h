@@ -0,0 +1,106 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "audio_source.h"
+
+// frame rate of the virtual clock when the video file does not report one
+constexpr double REPLAY_DEFAULT_FPS = 30.0;
+// how long a finished replay waits for the sinks to catch up
+constexpr int REPLAY_DRAIN_SECONDS = 5;
+
+// A WAV file placed on the video's timeline
+struct ReplayClip {
+    double start_seconds;
+    std::string path;
+    std::vector<short> samples;         // 16 kHz mono
+};
+
+/**
+ * @brief Reads an audio script: one "<start_seconds> <wav_path>" per line,
+ *        '#' starts a comment; relative paths are relative to the script.
+ *
+ * Clips are converted to 16 kHz mono when loaded. Throws std::runtime_error
+ * on a malformed line or an unreadable clip.
+ */
+std::vector<ReplayClip> loadReplayScript(const std::string& path);
+
+/**
+ * @class ReplayClock
+ * @brief Virtual time shared by the inference and ASR threads in replay runs
+ *
+ * Video time is the frame index over the frame rate, and the inference
+ * thread runs as fast as the pipeline allows instead of pacing to the
+ * camera. An ASR session records the audio that starts at the video time of
+ * its trigger. While a session is open the inference thread does not move
+ * past the audio read so far, and once the recording ends it waits for the
+ * session to finish, so the session ends at the same frame in every run no
+ * matter how long decoding takes on this machine.
+ */
+class ReplayClock {
+public:
+    explicit ReplayClock(double fps = REPLAY_DEFAULT_FPS);
+
+    // Inference thread
+    void setFps(double fps);
+    double frameSeconds() const { return 1.0 / fps; }
+    // Moves video time on by one frame, waiting for an open session's audio to catch up
+    void advanceFrame();
+    // A trigger at the current video time; call before GazeStarted is published
+    void sessionStarted();
+    void videoEnded();
+
+    // ASR thread
+    double sessionStartSeconds();
+    void audioReached(double seconds);
+    void sessionEnded();
+
+    // The video ended and no session is open
+    bool finished();
+    int64_t getFrames();
+    double videoSeconds();
+    // Releases a waiting inference thread at shutdown
+    void stop();
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    double fps;
+    int64_t frames{0};
+    bool session{false};
+    double session_start{0};
+    double audio_seconds{0};
+    bool video_ended{false};
+    bool stopped{false};
+};
+
+/**
+ * @class ReplayAudioSource
+ * @brief Audio source that plays the script's clips at their place on the video timeline
+ *
+ * Each open() starts at the current session's trigger time; frames outside
+ * any clip are silence, overlapping clips are mixed. Reads never wait for
+ * the video, the video waits for them.
+ */
+class ReplayAudioSource : public AudioSource {
+public:
+    ReplayAudioSource(std::vector<ReplayClip> clips, ReplayClock& clock, const std::string& name);
+
+    bool open() override;
+    bool read(short* frame, int len) override;
+    void close() override {}
+    const std::string& getName() const override { return name; }
+
+private:
+    std::vector<ReplayClip> clips;
+    ReplayClock& clock;
+    std::string name;
+    int64_t position{0};                // next sample on the video timeline
+};
+
+#endif // REPLAY_H
@@ -1,19 +1,33 @@
 #ifndef _RKNN_DEMO_MOBILENET_H_
 #define _RKNN_DEMO_MOBILENET_H_
 
-#include "rknn_api.h"
 #include "common.h"
+#include "inference_backend.h"
+#include "image_utils.h"
+#include "retinaface_postprocess.h"
 #include <string>
 
+// Stage timings of the last inference_retinaface_model() call
 typedef struct {
-    rknn_context rknn_ctx;
-    rknn_input_output_num io_num;
-    rknn_tensor_attr *input_attrs;
-    rknn_tensor_attr *output_attrs;
+    float preprocess_ms;
+    float npu_ms;       // model run, on whichever backend loaded it
+    float postprocess_ms;
+    int truncated;      // faces dropped by the result cap
+} retinaface_perf_t;
+
+typedef struct {
+    InferenceBackend *backend;          // owned, freed by release_retinaface_model()
     int model_channel;
     int model_width;
     int model_height;
-} rknn_app_context_t;
+    image_buffer_t input_img;           // letterboxed model input, allocated once at init
+    letterbox_cache_t letterbox_cache;
+    int input_bound;                    // input_img is backend memory, no setInput() needed
+    retinaface_priors_t priors;
+    retinaface_candidates_t candidates;
+    int output_int8;                    // post-process reads the quantized outputs directly
+    retinaface_perf_t perf;
+} retinaface_context_t;
 
 typedef struct box_rect_t {
     int left;    ///< Most left coordinate
@@ -34,15 +48,32 @@ typedef struct retinaface_object_t {
     ponit_t ponit[5];
 } retinaface_object_t;
 
+#define RETINAFACE_DEFAULT_MAX_FACES 256
+
+// Detection list, allocated once by init_retinaface_result() and reused
+// across frames. Holds the max_faces highest scoring faces after NMS.
 typedef struct {
     int count;
-    retinaface_object_t object[128];
+    int max_faces;
+    retinaface_object_t *object;
 } retinaface_result;
 
-int init_retinaface_model(const std::string& model_path, rknn_app_context_t *app_ctx);
+// crops per model run in ROI mode, tiled 2x2 in the model input
+#define RETINAFACE_MAX_ROIS 4
+
+int init_retinaface_result(retinaface_result *result, int max_faces);
+
+void release_retinaface_result(retinaface_result *result);
+
+int init_retinaface_model(const std::string& model_path, retinaface_context_t *app_ctx);
+
+int release_retinaface_model(retinaface_context_t *app_ctx);
 
-int release_retinaface_model(rknn_app_context_t *app_ctx);
+int inference_retinaface_model(retinaface_context_t *app_ctx, image_buffer_t *img, retinaface_result *out_result);
 
-int inference_retinaface_model(rknn_app_context_t *app_ctx, image_buffer_t *img, retinaface_result *out_result);
+// Detect only inside up to RETINAFACE_MAX_ROIS crops of img, in one model run.
+// Results are in img coordinates.
+int inference_retinaface_model_rois(retinaface_context_t *app_ctx, image_buffer_t *img, const image_rect_t *rois, int n_rois,
+                                    retinaface_result *out_result);
 
 #endif //_RKNN_DEMO_MOBILENET_H_
\ No newline at end of file
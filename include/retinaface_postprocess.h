@@ -0,0 +1,104 @@
+#ifndef _RKNN_DEMO_RETINAFACE_POSTPROCESS_H_
+#define _RKNN_DEMO_RETINAFACE_POSTPROCESS_H_
+
+// Anchor priors in SoA layout, normalized to the model input
+typedef struct {
+    int count;
+    float *cx;
+    float *cy;
+    float *w;
+    float *h;
+} retinaface_priors_t;
+
+#include <stdint.h>
+
+#define RETINAFACE_NMS_GRID 8
+
+// Priors that passed the score threshold, decoded to normalized coordinates,
+// plus the NMS workspace. Everything is allocated once for the worst case.
+typedef struct {
+    int capacity;
+    int count;
+    int *prior;         // prior index of each candidate
+    float *score;
+    float *box;         // xmin, ymin, xmax, ymax per candidate
+    float *landms;      // 5 x (x, y) per candidate
+
+    int keep_count;
+    int *keep;          // candidates kept by NMS, highest score first
+    int *order;
+    float *pixel_box;
+    float *area;
+    int cell_head[RETINAFACE_NMS_GRID * RETINAFACE_NMS_GRID];
+    int cell_capacity;
+    int *cell_next;
+    int *cell_item;
+} retinaface_candidates_t;
+
+/**
+ * @brief Number of anchor priors for a model input size
+ */
+int retinaface_count_priors(int model_w, int model_h);
+
+/**
+ * @brief Generate anchor priors for any model input size
+ *
+ * Uses the RetinaFace min_sizes/steps config with ceil'd feature maps, so
+ * non-square inputs are supported. The planes are 16-byte aligned.
+ *
+ * @return int 0: success; -1: error
+ */
+int retinaface_priors_generate(retinaface_priors_t *priors, int model_w, int model_h);
+
+void retinaface_priors_release(retinaface_priors_t *priors);
+
+int retinaface_candidates_init(retinaface_candidates_t *cand, int capacity);
+
+void retinaface_candidates_release(retinaface_candidates_t *cand);
+
+/**
+ * @brief Collect priors whose face score is above threshold
+ *
+ * Single vectorized pass over the [num_priors, 2] score tensor. Fills
+ * cand->prior and cand->score, at most cand->capacity entries.
+ *
+ * @return int number of candidates
+ */
+int retinaface_compact_scores(const float *scores, int num_priors, float threshold, retinaface_candidates_t *cand);
+
+/**
+ * @brief Decode box and landmarks of the compacted candidates only
+ *
+ * Reads the raw loc/landms tensors and leaves them untouched.
+ */
+void retinaface_decode_candidates(const float *loc, const float *landms, const retinaface_priors_t *priors,
+                                  retinaface_candidates_t *cand);
+
+/**
+ * @brief int8 variant of retinaface_compact_scores
+ *
+ * The threshold is converted to a quantized cutoff once, so the pass
+ * compares raw int8 values; only surviving scores are dequantized.
+ */
+int retinaface_compact_scores_i8(const int8_t *scores, int32_t zp, float scale, int num_priors, float threshold,
+                                 retinaface_candidates_t *cand);
+
+/**
+ * @brief int8 variant of retinaface_decode_candidates, dequantizes candidates only
+ */
+void retinaface_decode_candidates_i8(const int8_t *loc, int32_t loc_zp, float loc_scale,
+                                     const int8_t *landms, int32_t landms_zp, float landms_scale,
+                                     const retinaface_priors_t *priors, retinaface_candidates_t *cand);
+
+/**
+ * @brief Greedy NMS over the decoded candidates
+ *
+ * Sorts by score and tests each candidate only against already kept boxes
+ * that share a grid cell with it. IoU is computed on boxes scaled by
+ * width/height, with the same +1 pixel convention as before.
+ *
+ * @return int number of kept candidates, indices in cand->keep
+ */
+int retinaface_nms(retinaface_candidates_t *cand, float threshold, int width, int height);
+
+#endif //_RKNN_DEMO_RETINAFACE_POSTPROCESS_H_
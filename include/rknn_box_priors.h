@@ -1,21009 +0,0 @@
-#ifndef RKNN_BOX_PRIORS_H
-#define RKNN_BOX_PRIORS_H
-const float BOX_PRIORS_320[4200][4] = {
-{0.012500,0.012500,0.050000,0.050000},
-{0.012500,0.012500,0.100000,0.100000},
-{0.037500,0.012500,0.050000,0.050000},
-{0.037500,0.012500,0.100000,0.100000},
-{0.062500,0.012500,0.050000,0.050000},
-{0.062500,0.012500,0.100000,0.100000},
-{0.087500,0.012500,0.050000,0.050000},
-{0.087500,0.012500,0.100000,0.100000},
-{0.112500,0.012500,0.050000,0.050000},
-{0.112500,0.012500,0.100000,0.100000},
-{0.137500,0.012500,0.050000,0.050000},
-{0.137500,0.012500,0.100000,0.100000},
-{0.162500,0.012500,0.050000,0.050000},
-{0.162500,0.012500,0.100000,0.100000},
-{0.187500,0.012500,0.050000,0.050000},
-{0.187500,0.012500,0.100000,0.100000},
-{0.212500,0.012500,0.050000,0.050000},
-{0.212500,0.012500,0.100000,0.100000},
-{0.237500,0.012500,0.050000,0.050000},
-{0.237500,0.012500,0.100000,0.100000},
-{0.262500,0.012500,0.050000,0.050000},
-{0.262500,0.012500,0.100000,0.100000},
-{0.287500,0.012500,0.050000,0.050000},
-{0.287500,0.012500,0.100000,0.100000},
-{0.312500,0.012500,0.050000,0.050000},
-{0.312500,0.012500,0.100000,0.100000},
-{0.337500,0.012500,0.050000,0.050000},
-{0.337500,0.012500,0.100000,0.100000},
-{0.362500,0.012500,0.050000,0.050000},
-{0.362500,0.012500,0.100000,0.100000},
-{0.387500,0.012500,0.050000,0.050000},
-{0.387500,0.012500,0.100000,0.100000},
-{0.412500,0.012500,0.050000,0.050000},
-{0.412500,0.012500,0.100000,0.100000},
-{0.437500,0.012500,0.050000,0.050000},
-{0.437500,0.012500,0.100000,0.100000},
-{0.462500,0.012500,0.050000,0.050000},
-{0.462500,0.012500,0.100000,0.100000},
-{0.487500,0.012500,0.050000,0.050000},
-{0.487500,0.012500,0.100000,0.100000},
-{0.512500,0.012500,0.050000,0.050000},
-{0.512500,0.012500,0.100000,0.100000},
-{0.537500,0.012500,0.050000,0.050000},
-{0.537500,0.012500,0.100000,0.100000},
-{0.562500,0.012500,0.050000,0.050000},
-{0.562500,0.012500,0.100000,0.100000},
-{0.587500,0.012500,0.050000,0.050000},
-{0.587500,0.012500,0.100000,0.100000},
-{0.612500,0.012500,0.050000,0.050000},
-{0.612500,0.012500,0.100000,0.100000},
-{0.637500,0.012500,0.050000,0.050000},
-{0.637500,0.012500,0.100000,0.100000},
-{0.662500,0.012500,0.050000,0.050000},
-{0.662500,0.012500,0.100000,0.100000},
-{0.687500,0.012500,0.050000,0.050000},
-{0.687500,0.012500,0.100000,0.100000},
-{0.712500,0.012500,0.050000,0.050000},
-{0.712500,0.012500,0.100000,0.100000},
-{0.737500,0.012500,0.050000,0.050000},
-{0.737500,0.012500,0.100000,0.100000},
-{0.762500,0.012500,0.050000,0.050000},
-{0.762500,0.012500,0.100000,0.100000},
-{0.787500,0.012500,0.050000,0.050000},
-{0.787500,0.012500,0.100000,0.100000},
-{0.812500,0.012500,0.050000,0.050000},
-{0.812500,0.012500,0.100000,0.100000},
-{0.837500,0.012500,0.050000,0.050000},
-{0.837500,0.012500,0.100000,0.100000},
-{0.862500,0.012500,0.050000,0.050000},
-{0.862500,0.012500,0.100000,0.100000},
-{0.887500,0.012500,0.050000,0.050000},
-{0.887500,0.012500,0.100000,0.100000},
-{0.912500,0.012500,0.050000,0.050000},
-{0.912500,0.012500,0.100000,0.100000},
-{0.937500,0.012500,0.050000,0.050000},
-{0.937500,0.012500,0.100000,0.100000},
-{0.962500,0.012500,0.050000,0.050000},
-{0.962500,0.012500,0.100000,0.100000},
-{0.987500,0.012500,0.050000,0.050000},
-{0.987500,0.012500,0.100000,0.100000},
-{0.012500,0.037500,0.050000,0.050000},
-{0.012500,0.037500,0.100000,0.100000},
-{0.037500,0.037500,0.050000,0.050000},
-{0.037500,0.037500,0.100000,0.100000},
-{0.062500,0.037500,0.050000,0.050000},
-{0.062500,0.037500,0.100000,0.100000},
-{0.087500,0.037500,0.050000,0.050000},
-{0.087500,0.037500,0.100000,0.100000},
-{0.112500,0.037500,0.050000,0.050000},
-{0.112500,0.037500,0.100000,0.100000},
-{0.137500,0.037500,0.050000,0.050000},
-{0.137500,0.037500,0.100000,0.100000},
-{0.162500,0.037500,0.050000,0.050000},
-{0.162500,0.037500,0.100000,0.100000},
-{0.187500,0.037500,0.050000,0.050000},
-{0.187500,0.037500,0.100000,0.100000},
-{0.212500,0.037500,0.050000,0.050000},
-{0.212500,0.037500,0.100000,0.100000},
-{0.237500,0.037500,0.050000,0.050000},
-{0.237500,0.037500,0.100000,0.100000},
-{0.262500,0.037500,0.050000,0.050000},
-{0.262500,0.037500,0.100000,0.100000},
-{0.287500,0.037500,0.050000,0.050000},
-{0.287500,0.037500,0.100000,0.100000},
-{0.312500,0.037500,0.050000,0.050000},
-{0.312500,0.037500,0.100000,0.100000},
-{0.337500,0.037500,0.050000,0.050000},
-{0.337500,0.037500,0.100000,0.100000},
-{0.362500,0.037500,0.050000,0.050000},
-{0.362500,0.037500,0.100000,0.100000},
-{0.387500,0.037500,0.050000,0.050000},
-{0.387500,0.037500,0.100000,0.100000},
-{0.412500,0.037500,0.050000,0.050000},
-{0.412500,0.037500,0.100000,0.100000},
-{0.437500,0.037500,0.050000,0.050000},
-{0.437500,0.037500,0.100000,0.100000},
-{0.462500,0.037500,0.050000,0.050000},
-{0.462500,0.037500,0.100000,0.100000},
-{0.487500,0.037500,0.050000,0.050000},
-{0.487500,0.037500,0.100000,0.100000},
-{0.512500,0.037500,0.050000,0.050000},
-{0.512500,0.037500,0.100000,0.100000},
-{0.537500,0.037500,0.050000,0.050000},
-{0.537500,0.037500,0.100000,0.100000},
-{0.562500,0.037500,0.050000,0.050000},
-{0.562500,0.037500,0.100000,0.100000},
-{0.587500,0.037500,0.050000,0.050000},
-{0.587500,0.037500,0.100000,0.100000},
-{0.612500,0.037500,0.050000,0.050000},
-{0.612500,0.037500,0.100000,0.100000},
-{0.637500,0.037500,0.050000,0.050000},
-{0.637500,0.037500,0.100000,0.100000},
-{0.662500,0.037500,0.050000,0.050000},
-{0.662500,0.037500,0.100000,0.100000},
-{0.687500,0.037500,0.050000,0.050000},
-{0.687500,0.037500,0.100000,0.100000},
-{0.712500,0.037500,0.050000,0.050000},
-{0.712500,0.037500,0.100000,0.100000},
-{0.737500,0.037500,0.050000,0.050000},
-{0.737500,0.037500,0.100000,0.100000},
-{0.762500,0.037500,0.050000,0.050000},
-{0.762500,0.037500,0.100000,0.100000},
-{0.787500,0.037500,0.050000,0.050000},
-{0.787500,0.037500,0.100000,0.100000},
-{0.812500,0.037500,0.050000,0.050000},
-{0.812500,0.037500,0.100000,0.100000},
-{0.837500,0.037500,0.050000,0.050000},
-{0.837500,0.037500,0.100000,0.100000},
-{0.862500,0.037500,0.050000,0.050000},
-{0.862500,0.037500,0.100000,0.100000},
-{0.887500,0.037500,0.050000,0.050000},
-{0.887500,0.037500,0.100000,0.100000},
-{0.912500,0.037500,0.050000,0.050000},
-{0.912500,0.037500,0.100000,0.100000},
-{0.937500,0.037500,0.050000,0.050000},
-{0.937500,0.037500,0.100000,0.100000},
-{0.962500,0.037500,0.050000,0.050000},
-{0.962500,0.037500,0.100000,0.100000},
-{0.987500,0.037500,0.050000,0.050000},
-{0.987500,0.037500,0.100000,0.100000},
-{0.012500,0.062500,0.050000,0.050000},
-{0.012500,0.062500,0.100000,0.100000},
-{0.037500,0.062500,0.050000,0.050000},
-{0.037500,0.062500,0.100000,0.100000},
-{0.062500,0.062500,0.050000,0.050000},
-{0.062500,0.062500,0.100000,0.100000},
-{0.087500,0.062500,0.050000,0.050000},
-{0.087500,0.062500,0.100000,0.100000},
-{0.112500,0.062500,0.050000,0.050000},
-{0.112500,0.062500,0.100000,0.100000},
-{0.137500,0.062500,0.050000,0.050000},
-{0.137500,0.062500,0.100000,0.100000},
-{0.162500,0.062500,0.050000,0.050000},
-{0.162500,0.062500,0.100000,0.100000},
-{0.187500,0.062500,0.050000,0.050000},
-{0.187500,0.062500,0.100000,0.100000},
-{0.212500,0.062500,0.050000,0.050000},
-{0.212500,0.062500,0.100000,0.100000},
-{0.237500,0.062500,0.050000,0.050000},
-{0.237500,0.062500,0.100000,0.100000},
-{0.262500,0.062500,0.050000,0.050000},
-{0.262500,0.062500,0.100000,0.100000},
-{0.287500,0.062500,0.050000,0.050000},
-{0.287500,0.062500,0.100000,0.100000},
-{0.312500,0.062500,0.050000,0.050000},
-{0.312500,0.062500,0.100000,0.100000},
-{0.337500,0.062500,0.050000,0.050000},
-{0.337500,0.062500,0.100000,0.100000},
-{0.362500,0.062500,0.050000,0.050000},
-{0.362500,0.062500,0.100000,0.100000},
-{0.387500,0.062500,0.050000,0.050000},
-{0.387500,0.062500,0.100000,0.100000},
-{0.412500,0.062500,0.050000,0.050000},
-{0.412500,0.062500,0.100000,0.100000},
-{0.437500,0.062500,0.050000,0.050000},
-{0.437500,0.062500,0.100000,0.100000},
-{0.462500,0.062500,0.050000,0.050000},
-{0.462500,0.062500,0.100000,0.100000},
-{0.487500,0.062500,0.050000,0.050000},
-{0.487500,0.062500,0.100000,0.100000},
-{0.512500,0.062500,0.050000,0.050000},
-{0.512500,0.062500,0.100000,0.100000},
-{0.537500,0.062500,0.050000,0.050000},
-{0.537500,0.062500,0.100000,0.100000},
-{0.562500,0.062500,0.050000,0.050000},
-{0.562500,0.062500,0.100000,0.100000},
-{0.587500,0.062500,0.050000,0.050000},
-{0.587500,0.062500,0.100000,0.100000},
-{0.612500,0.062500,0.050000,0.050000},
-{0.612500,0.062500,0.100000,0.100000},
-{0.637500,0.062500,0.050000,0.050000},
-{0.637500,0.062500,0.100000,0.100000},
-{0.662500,0.062500,0.050000,0.050000},
-{0.662500,0.062500,0.100000,0.100000},
-{0.687500,0.062500,0.050000,0.050000},
-{0.687500,0.062500,0.100000,0.100000},
-{0.712500,0.062500,0.050000,0.050000},
-{0.712500,0.062500,0.100000,0.100000},
-{0.737500,0.062500,0.050000,0.050000},
-{0.737500,0.062500,0.100000,0.100000},
-{0.762500,0.062500,0.050000,0.050000},
-{0.762500,0.062500,0.100000,0.100000},
-{0.787500,0.062500,0.050000,0.050000},
-{0.787500,0.062500,0.100000,0.100000},
-{0.812500,0.062500,0.050000,0.050000},
-{0.812500,0.062500,0.100000,0.100000},
-{0.837500,0.062500,0.050000,0.050000},
-{0.837500,0.062500,0.100000,0.100000},
-{0.862500,0.062500,0.050000,0.050000},
-{0.862500,0.062500,0.100000,0.100000},
-{0.887500,0.062500,0.050000,0.050000},
-{0.887500,0.062500,0.100000,0.100000},
-{0.912500,0.062500,0.050000,0.050000},
-{0.912500,0.062500,0.100000,0.100000},
-{0.937500,0.062500,0.050000,0.050000},
-{0.937500,0.062500,0.100000,0.100000},
-{0.962500,0.062500,0.050000,0.050000},
-{0.962500,0.062500,0.100000,0.100000},
-{0.987500,0.062500,0.050000,0.050000},
-{0.987500,0.062500,0.100000,0.100000},
-{0.012500,0.087500,0.050000,0.050000},
-{0.012500,0.087500,0.100000,0.100000},
-{0.037500,0.087500,0.050000,0.050000},
-{0.037500,0.087500,0.100000,0.100000},
-{0.062500,0.087500,0.050000,0.050000},
-{0.062500,0.087500,0.100000,0.100000},
-{0.087500,0.087500,0.050000,0.050000},
-{0.087500,0.087500,0.100000,0.100000},
-{0.112500,0.087500,0.050000,0.050000},
-{0.112500,0.087500,0.100000,0.100000},
-{0.137500,0.087500,0.050000,0.050000},
-{0.137500,0.087500,0.100000,0.100000},
-{0.162500,0.087500,0.050000,0.050000},
-{0.162500,0.087500,0.100000,0.100000},
-{0.187500,0.087500,0.050000,0.050000},
-{0.187500,0.087500,0.100000,0.100000},
-{0.212500,0.087500,0.050000,0.050000},
-{0.212500,0.087500,0.100000,0.100000},
-{0.237500,0.087500,0.050000,0.050000},
-{0.237500,0.087500,0.100000,0.100000},
-{0.262500,0.087500,0.050000,0.050000},
-{0.262500,0.087500,0.100000,0.100000},
-{0.287500,0.087500,0.050000,0.050000},
-{0.287500,0.087500,0.100000,0.100000},
-{0.312500,0.087500,0.050000,0.050000},
-{0.312500,0.087500,0.100000,0.100000},
-{0.337500,0.087500,0.050000,0.050000},
-{0.337500,0.087500,0.100000,0.100000},
-{0.362500,0.087500,0.050000,0.050000},
-{0.362500,0.087500,0.100000,0.100000},
-{0.387500,0.087500,0.050000,0.050000},
-{0.387500,0.087500,0.100000,0.100000},
-{0.412500,0.087500,0.050000,0.050000},
-{0.412500,0.087500,0.100000,0.100000},
-{0.437500,0.087500,0.050000,0.050000},
-{0.437500,0.087500,0.100000,0.100000},
-{0.462500,0.087500,0.050000,0.050000},
-{0.462500,0.087500,0.100000,0.100000},
-{0.487500,0.087500,0.050000,0.050000},
-{0.487500,0.087500,0.100000,0.100000},
-{0.512500,0.087500,0.050000,0.050000},
-{0.512500,0.087500,0.100000,0.100000},
-{0.537500,0.087500,0.050000,0.050000},
-{0.537500,0.087500,0.100000,0.100000},
-{0.562500,0.087500,0.050000,0.050000},
-{0.562500,0.087500,0.100000,0.100000},
-{0.587500,0.087500,0.050000,0.050000},
-{0.587500,0.087500,0.100000,0.100000},
-{0.612500,0.087500,0.050000,0.050000},
-{0.612500,0.087500,0.100000,0.100000},
-{0.637500,0.087500,0.050000,0.050000},
-{0.637500,0.087500,0.100000,0.100000},
-{0.662500,0.087500,0.050000,0.050000},
-{0.662500,0.087500,0.100000,0.100000},
-{0.687500,0.087500,0.050000,0.050000},
-{0.687500,0.087500,0.100000,0.100000},
-{0.712500,0.087500,0.050000,0.050000},
-{0.712500,0.087500,0.100000,0.100000},
-{0.737500,0.087500,0.050000,0.050000},
-{0.737500,0.087500,0.100000,0.100000},
-{0.762500,0.087500,0.050000,0.050000},
-{0.762500,0.087500,0.100000,0.100000},
-{0.787500,0.087500,0.050000,0.050000},
-{0.787500,0.087500,0.100000,0.100000},
-{0.812500,0.087500,0.050000,0.050000},
-{0.812500,0.087500,0.100000,0.100000},
-{0.837500,0.087500,0.050000,0.050000},
-{0.837500,0.087500,0.100000,0.100000},
-{0.862500,0.087500,0.050000,0.050000},
-{0.862500,0.087500,0.100000,0.100000},
-{0.887500,0.087500,0.050000,0.050000},
-{0.887500,0.087500,0.100000,0.100000},
-{0.912500,0.087500,0.050000,0.050000},
-{0.912500,0.087500,0.100000,0.100000},
-{0.937500,0.087500,0.050000,0.050000},
-{0.937500,0.087500,0.100000,0.100000},
-{0.962500,0.087500,0.050000,0.050000},
-{0.962500,0.087500,0.100000,0.100000},
-{0.987500,0.087500,0.050000,0.050000},
-{0.987500,0.087500,0.100000,0.100000},
-{0.012500,0.112500,0.050000,0.050000},
-{0.012500,0.112500,0.100000,0.100000},
-{0.037500,0.112500,0.050000,0.050000},
-{0.037500,0.112500,0.100000,0.100000},
-{0.062500,0.112500,0.050000,0.050000},
-{0.062500,0.112500,0.100000,0.100000},
-{0.087500,0.112500,0.050000,0.050000},
-{0.087500,0.112500,0.100000,0.100000},
-{0.112500,0.112500,0.050000,0.050000},
-{0.112500,0.112500,0.100000,0.100000},
-{0.137500,0.112500,0.050000,0.050000},
-{0.137500,0.112500,0.100000,0.100000},
-{0.162500,0.112500,0.050000,0.050000},
-{0.162500,0.112500,0.100000,0.100000},
-{0.187500,0.112500,0.050000,0.050000},
-{0.187500,0.112500,0.100000,0.100000},
-{0.212500,0.112500,0.050000,0.050000},
-{0.212500,0.112500,0.100000,0.100000},
-{0.237500,0.112500,0.050000,0.050000},
-{0.237500,0.112500,0.100000,0.100000},
-{0.262500,0.112500,0.050000,0.050000},
-{0.262500,0.112500,0.100000,0.100000},
-{0.287500,0.112500,0.050000,0.050000},
-{0.287500,0.112500,0.100000,0.100000},
-{0.312500,0.112500,0.050000,0.050000},
-{0.312500,0.112500,0.100000,0.100000},
-{0.337500,0.112500,0.050000,0.050000},
-{0.337500,0.112500,0.100000,0.100000},
-{0.362500,0.112500,0.050000,0.050000},
-{0.362500,0.112500,0.100000,0.100000},
-{0.387500,0.112500,0.050000,0.050000},
-{0.387500,0.112500,0.100000,0.100000},
-{0.412500,0.112500,0.050000,0.050000},
-{0.412500,0.112500,0.100000,0.100000},
-{0.437500,0.112500,0.050000,0.050000},
-{0.437500,0.112500,0.100000,0.100000},
-{0.462500,0.112500,0.050000,0.050000},
-{0.462500,0.112500,0.100000,0.100000},
-{0.487500,0.112500,0.050000,0.050000},
-{0.487500,0.112500,0.100000,0.100000},
-{0.512500,0.112500,0.050000,0.050000},
-{0.512500,0.112500,0.100000,0.100000},
-{0.537500,0.112500,0.050000,0.050000},
-{0.537500,0.112500,0.100000,0.100000},
-{0.562500,0.112500,0.050000,0.050000},
-{0.562500,0.112500,0.100000,0.100000},
-{0.587500,0.112500,0.050000,0.050000},
-{0.587500,0.112500,0.100000,0.100000},
-{0.612500,0.112500,0.050000,0.050000},
-{0.612500,0.112500,0.100000,0.100000},
-{0.637500,0.112500,0.050000,0.050000},
-{0.637500,0.112500,0.100000,0.100000},
-{0.662500,0.112500,0.050000,0.050000},
-{0.662500,0.112500,0.100000,0.100000},
-{0.687500,0.112500,0.050000,0.050000},
-{0.687500,0.112500,0.100000,0.100000},
-{0.712500,0.112500,0.050000,0.050000},
-{0.712500,0.112500,0.100000,0.100000},
-{0.737500,0.112500,0.050000,0.050000},
-{0.737500,0.112500,0.100000,0.100000},
-{0.762500,0.112500,0.050000,0.050000},
-{0.762500,0.112500,0.100000,0.100000},
-{0.787500,0.112500,0.050000,0.050000},
-{0.787500,0.112500,0.100000,0.100000},
-{0.812500,0.112500,0.050000,0.050000},
-{0.812500,0.112500,0.100000,0.100000},
-{0.837500,0.112500,0.050000,0.050000},
-{0.837500,0.112500,0.100000,0.100000},
-{0.862500,0.112500,0.050000,0.050000},
-{0.862500,0.112500,0.100000,0.100000},
-{0.887500,0.112500,0.050000,0.050000},
-{0.887500,0.112500,0.100000,0.100000},
-{0.912500,0.112500,0.050000,0.050000},
-{0.912500,0.112500,0.100000,0.100000},
-{0.937500,0.112500,0.050000,0.050000},
-{0.937500,0.112500,0.100000,0.100000},
-{0.962500,0.112500,0.050000,0.050000},
-{0.962500,0.112500,0.100000,0.100000},
-{0.987500,0.112500,0.050000,0.050000},
-{0.987500,0.112500,0.100000,0.100000},
-{0.012500,0.137500,0.050000,0.050000},
-{0.012500,0.137500,0.100000,0.100000},
-{0.037500,0.137500,0.050000,0.050000},
-{0.037500,0.137500,0.100000,0.100000},
-{0.062500,0.137500,0.050000,0.050000},
-{0.062500,0.137500,0.100000,0.100000},
-{0.087500,0.137500,0.050000,0.050000},
-{0.087500,0.137500,0.100000,0.100000},
-{0.112500,0.137500,0.050000,0.050000},
-{0.112500,0.137500,0.100000,0.100000},
-{0.137500,0.137500,0.050000,0.050000},
-{0.137500,0.137500,0.100000,0.100000},
-{0.162500,0.137500,0.050000,0.050000},
-{0.162500,0.137500,0.100000,0.100000},
-{0.187500,0.137500,0.050000,0.050000},
-{0.187500,0.137500,0.100000,0.100000},
-{0.212500,0.137500,0.050000,0.050000},
-{0.212500,0.137500,0.100000,0.100000},
-{0.237500,0.137500,0.050000,0.050000},
-{0.237500,0.137500,0.100000,0.100000},
-{0.262500,0.137500,0.050000,0.050000},
-{0.262500,0.137500,0.100000,0.100000},
-{0.287500,0.137500,0.050000,0.050000},
-{0.287500,0.137500,0.100000,0.100000},
-{0.312500,0.137500,0.050000,0.050000},
-{0.312500,0.137500,0.100000,0.100000},
-{0.337500,0.137500,0.050000,0.050000},
-{0.337500,0.137500,0.100000,0.100000},
-{0.362500,0.137500,0.050000,0.050000},
-{0.362500,0.137500,0.100000,0.100000},
-{0.387500,0.137500,0.050000,0.050000},
-{0.387500,0.137500,0.100000,0.100000},
-{0.412500,0.137500,0.050000,0.050000},
-{0.412500,0.137500,0.100000,0.100000},
-{0.437500,0.137500,0.050000,0.050000},
-{0.437500,0.137500,0.100000,0.100000},
-{0.462500,0.137500,0.050000,0.050000},
-{0.462500,0.137500,0.100000,0.100000},
-{0.487500,0.137500,0.050000,0.050000},
-{0.487500,0.137500,0.100000,0.100000},
-{0.512500,0.137500,0.050000,0.050000},
-{0.512500,0.137500,0.100000,0.100000},
-{0.537500,0.137500,0.050000,0.050000},
-{0.537500,0.137500,0.100000,0.100000},
-{0.562500,0.137500,0.050000,0.050000},
-{0.562500,0.137500,0.100000,0.100000},
-{0.587500,0.137500,0.050000,0.050000},
-{0.587500,0.137500,0.100000,0.100000},
-{0.612500,0.137500,0.050000,0.050000},
-{0.612500,0.137500,0.100000,0.100000},
-{0.637500,0.137500,0.050000,0.050000},
-{0.637500,0.137500,0.100000,0.100000},
-{0.662500,0.137500,0.050000,0.050000},
-{0.662500,0.137500,0.100000,0.100000},
-{0.687500,0.137500,0.050000,0.050000},
-{0.687500,0.137500,0.100000,0.100000},
-{0.712500,0.137500,0.050000,0.050000},
-{0.712500,0.137500,0.100000,0.100000},
-{0.737500,0.137500,0.050000,0.050000},
-{0.737500,0.137500,0.100000,0.100000},
-{0.762500,0.137500,0.050000,0.050000},
-{0.762500,0.137500,0.100000,0.100000},
-{0.787500,0.137500,0.050000,0.050000},
-{0.787500,0.137500,0.100000,0.100000},
-{0.812500,0.137500,0.050000,0.050000},
-{0.812500,0.137500,0.100000,0.100000},
-{0.837500,0.137500,0.050000,0.050000},
-{0.837500,0.137500,0.100000,0.100000},
-{0.862500,0.137500,0.050000,0.050000},
-{0.862500,0.137500,0.100000,0.100000},
-{0.887500,0.137500,0.050000,0.050000},
-{0.887500,0.137500,0.100000,0.100000},
-{0.912500,0.137500,0.050000,0.050000},
-{0.912500,0.137500,0.100000,0.100000},
-{0.937500,0.137500,0.050000,0.050000},
-{0.937500,0.137500,0.100000,0.100000},
-{0.962500,0.137500,0.050000,0.050000},
-{0.962500,0.137500,0.100000,0.100000},
-{0.987500,0.137500,0.050000,0.050000},
-{0.987500,0.137500,0.100000,0.100000},
-{0.012500,0.162500,0.050000,0.050000},
-{0.012500,0.162500,0.100000,0.100000},
-{0.037500,0.162500,0.050000,0.050000},
-{0.037500,0.162500,0.100000,0.100000},
-{0.062500,0.162500,0.050000,0.050000},
-{0.062500,0.162500,0.100000,0.100000},
-{0.087500,0.162500,0.050000,0.050000},
-{0.087500,0.162500,0.100000,0.100000},
-{0.112500,0.162500,0.050000,0.050000},
-{0.112500,0.162500,0.100000,0.100000},
-{0.137500,0.162500,0.050000,0.050000},
-{0.137500,0.162500,0.100000,0.100000},
-{0.162500,0.162500,0.050000,0.050000},
-{0.162500,0.162500,0.100000,0.100000},
-{0.187500,0.162500,0.050000,0.050000},
-{0.187500,0.162500,0.100000,0.100000},
-{0.212500,0.162500,0.050000,0.050000},
-{0.212500,0.162500,0.100000,0.100000},
-{0.237500,0.162500,0.050000,0.050000},
-{0.237500,0.162500,0.100000,0.100000},
-{0.262500,0.162500,0.050000,0.050000},
-{0.262500,0.162500,0.100000,0.100000},
-{0.287500,0.162500,0.050000,0.050000},
-{0.287500,0.162500,0.100000,0.100000},
-{0.312500,0.162500,0.050000,0.050000},
-{0.312500,0.162500,0.100000,0.100000},
-{0.337500,0.162500,0.050000,0.050000},
-{0.337500,0.162500,0.100000,0.100000},
-{0.362500,0.162500,0.050000,0.050000},
-{0.362500,0.162500,0.100000,0.100000},
-{0.387500,0.162500,0.050000,0.050000},
-{0.387500,0.162500,0.100000,0.100000},
-{0.412500,0.162500,0.050000,0.050000},
-{0.412500,0.162500,0.100000,0.100000},
-{0.437500,0.162500,0.050000,0.050000},
-{0.437500,0.162500,0.100000,0.100000},
-{0.462500,0.162500,0.050000,0.050000},
-{0.462500,0.162500,0.100000,0.100000},
-{0.487500,0.162500,0.050000,0.050000},
-{0.487500,0.162500,0.100000,0.100000},
-{0.512500,0.162500,0.050000,0.050000},
-{0.512500,0.162500,0.100000,0.100000},
-{0.537500,0.162500,0.050000,0.050000},
-{0.537500,0.162500,0.100000,0.100000},
-{0.562500,0.162500,0.050000,0.050000},
-{0.562500,0.162500,0.100000,0.100000},
-{0.587500,0.162500,0.050000,0.050000},
-{0.587500,0.162500,0.100000,0.100000},
-{0.612500,0.162500,0.050000,0.050000},
-{0.612500,0.162500,0.100000,0.100000},
-{0.637500,0.162500,0.050000,0.050000},
-{0.637500,0.162500,0.100000,0.100000},
-{0.662500,0.162500,0.050000,0.050000},
-{0.662500,0.162500,0.100000,0.100000},
-{0.687500,0.162500,0.050000,0.050000},
-{0.687500,0.162500,0.100000,0.100000},
-{0.712500,0.162500,0.050000,0.050000},
-{0.712500,0.162500,0.100000,0.100000},
-{0.737500,0.162500,0.050000,0.050000},
-{0.737500,0.162500,0.100000,0.100000},
-{0.762500,0.162500,0.050000,0.050000},
-{0.762500,0.162500,0.100000,0.100000},
-{0.787500,0.162500,0.050000,0.050000},
-{0.787500,0.162500,0.100000,0.100000},
-{0.812500,0.162500,0.050000,0.050000},
-{0.812500,0.162500,0.100000,0.100000},
-{0.837500,0.162500,0.050000,0.050000},
-{0.837500,0.162500,0.100000,0.100000},
-{0.862500,0.162500,0.050000,0.050000},
-{0.862500,0.162500,0.100000,0.100000},
-{0.887500,0.162500,0.050000,0.050000},
-{0.887500,0.162500,0.100000,0.100000},
-{0.912500,0.162500,0.050000,0.050000},
-{0.912500,0.162500,0.100000,0.100000},
-{0.937500,0.162500,0.050000,0.050000},
-{0.937500,0.162500,0.100000,0.100000},
-{0.962500,0.162500,0.050000,0.050000},
-{0.962500,0.162500,0.100000,0.100000},
-{0.987500,0.162500,0.050000,0.050000},
-{0.987500,0.162500,0.100000,0.100000},
-{0.012500,0.187500,0.050000,0.050000},
-{0.012500,0.187500,0.100000,0.100000},
-{0.037500,0.187500,0.050000,0.050000},
-{0.037500,0.187500,0.100000,0.100000},
-{0.062500,0.187500,0.050000,0.050000},
-{0.062500,0.187500,0.100000,0.100000},
-{0.087500,0.187500,0.050000,0.050000},
-{0.087500,0.187500,0.100000,0.100000},
-{0.112500,0.187500,0.050000,0.050000},
-{0.112500,0.187500,0.100000,0.100000},
-{0.137500,0.187500,0.050000,0.050000},
-{0.137500,0.187500,0.100000,0.100000},
-{0.162500,0.187500,0.050000,0.050000},
-{0.162500,0.187500,0.100000,0.100000},
-{0.187500,0.187500,0.050000,0.050000},
-{0.187500,0.187500,0.100000,0.100000},
-{0.212500,0.187500,0.050000,0.050000},
-{0.212500,0.187500,0.100000,0.100000},
-{0.237500,0.187500,0.050000,0.050000},
-{0.237500,0.187500,0.100000,0.100000},
-{0.262500,0.187500,0.050000,0.050000},
-{0.262500,0.187500,0.100000,0.100000},
-{0.287500,0.187500,0.050000,0.050000},
-{0.287500,0.187500,0.100000,0.100000},
-{0.312500,0.187500,0.050000,0.050000},
-{0.312500,0.187500,0.100000,0.100000},
-{0.337500,0.187500,0.050000,0.050000},
-{0.337500,0.187500,0.100000,0.100000},
-{0.362500,0.187500,0.050000,0.050000},
-{0.362500,0.187500,0.100000,0.100000},
-{0.387500,0.187500,0.050000,0.050000},
-{0.387500,0.187500,0.100000,0.100000},
-{0.412500,0.187500,0.050000,0.050000},
-{0.412500,0.187500,0.100000,0.100000},
-{0.437500,0.187500,0.050000,0.050000},
-{0.437500,0.187500,0.100000,0.100000},
-{0.462500,0.187500,0.050000,0.050000},
-{0.462500,0.187500,0.100000,0.100000},
-{0.487500,0.187500,0.050000,0.050000},
-{0.487500,0.187500,0.100000,0.100000},
-{0.512500,0.187500,0.050000,0.050000},
-{0.512500,0.187500,0.100000,0.100000},
-{0.537500,0.187500,0.050000,0.050000},
-{0.537500,0.187500,0.100000,0.100000},
-{0.562500,0.187500,0.050000,0.050000},
-{0.562500,0.187500,0.100000,0.100000},
-{0.587500,0.187500,0.050000,0.050000},
-{0.587500,0.187500,0.100000,0.100000},
-{0.612500,0.187500,0.050000,0.050000},
-{0.612500,0.187500,0.100000,0.100000},
-{0.637500,0.187500,0.050000,0.050000},
-{0.637500,0.187500,0.100000,0.100000},
-{0.662500,0.187500,0.050000,0.050000},
-{0.662500,0.187500,0.100000,0.100000},
-{0.687500,0.187500,0.050000,0.050000},
-{0.687500,0.187500,0.100000,0.100000},
-{0.712500,0.187500,0.050000,0.050000},
-{0.712500,0.187500,0.100000,0.100000},
-{0.737500,0.187500,0.050000,0.050000},
-{0.737500,0.187500,0.100000,0.100000},
-{0.762500,0.187500,0.050000,0.050000},
-{0.762500,0.187500,0.100000,0.100000},
-{0.787500,0.187500,0.050000,0.050000},
-{0.787500,0.187500,0.100000,0.100000},
-{0.812500,0.187500,0.050000,0.050000},
-{0.812500,0.187500,0.100000,0.100000},
-{0.837500,0.187500,0.050000,0.050000},
-{0.837500,0.187500,0.100000,0.100000},
-{0.862500,0.187500,0.050000,0.050000},
-{0.862500,0.187500,0.100000,0.100000},
-{0.887500,0.187500,0.050000,0.050000},
-{0.887500,0.187500,0.100000,0.100000},
-{0.912500,0.187500,0.050000,0.050000},
-{0.912500,0.187500,0.100000,0.100000},
-{0.937500,0.187500,0.050000,0.050000},
-{0.937500,0.187500,0.100000,0.100000},
-{0.962500,0.187500,0.050000,0.050000},
-{0.962500,0.187500,0.100000,0.100000},
-{0.987500,0.187500,0.050000,0.050000},
-{0.987500,0.187500,0.100000,0.100000},
-{0.012500,0.212500,0.050000,0.050000},
-{0.012500,0.212500,0.100000,0.100000},
-{0.037500,0.212500,0.050000,0.050000},
-{0.037500,0.212500,0.100000,0.100000},
-{0.062500,0.212500,0.050000,0.050000},
-{0.062500,0.212500,0.100000,0.100000},
-{0.087500,0.212500,0.050000,0.050000},
-{0.087500,0.212500,0.100000,0.100000},
-{0.112500,0.212500,0.050000,0.050000},
-{0.112500,0.212500,0.100000,0.100000},
-{0.137500,0.212500,0.050000,0.050000},
-{0.137500,0.212500,0.100000,0.100000},
-{0.162500,0.212500,0.050000,0.050000},
-{0.162500,0.212500,0.100000,0.100000},
-{0.187500,0.212500,0.050000,0.050000},
-{0.187500,0.212500,0.100000,0.100000},
-{0.212500,0.212500,0.050000,0.050000},
-{0.212500,0.212500,0.100000,0.100000},
-{0.237500,0.212500,0.050000,0.050000},
-{0.237500,0.212500,0.100000,0.100000},
-{0.262500,0.212500,0.050000,0.050000},
-{0.262500,0.212500,0.100000,0.100000},
-{0.287500,0.212500,0.050000,0.050000},
-{0.287500,0.212500,0.100000,0.100000},
-{0.312500,0.212500,0.050000,0.050000},
-{0.312500,0.212500,0.100000,0.100000},
-{0.337500,0.212500,0.050000,0.050000},
-{0.337500,0.212500,0.100000,0.100000},
-{0.362500,0.212500,0.050000,0.050000},
-{0.362500,0.212500,0.100000,0.100000},
-{0.387500,0.212500,0.050000,0.050000},
-{0.387500,0.212500,0.100000,0.100000},
-{0.412500,0.212500,0.050000,0.050000},
-{0.412500,0.212500,0.100000,0.100000},
-{0.437500,0.212500,0.050000,0.050000},
-{0.437500,0.212500,0.100000,0.100000},
-{0.462500,0.212500,0.050000,0.050000},
-{0.462500,0.212500,0.100000,0.100000},
-{0.487500,0.212500,0.050000,0.050000},
-{0.487500,0.212500,0.100000,0.100000},
-{0.512500,0.212500,0.050000,0.050000},
-{0.512500,0.212500,0.100000,0.100000},
-{0.537500,0.212500,0.050000,0.050000},
-{0.537500,0.212500,0.100000,0.100000},
-{0.562500,0.212500,0.050000,0.050000},
-{0.562500,0.212500,0.100000,0.100000},
-{0.587500,0.212500,0.050000,0.050000},
-{0.587500,0.212500,0.100000,0.100000},
-{0.612500,0.212500,0.050000,0.050000},
-{0.612500,0.212500,0.100000,0.100000},
-{0.637500,0.212500,0.050000,0.050000},
-{0.637500,0.212500,0.100000,0.100000},
-{0.662500,0.212500,0.050000,0.050000},
-{0.662500,0.212500,0.100000,0.100000},
-{0.687500,0.212500,0.050000,0.050000},
-{0.687500,0.212500,0.100000,0.100000},
-{0.712500,0.212500,0.050000,0.050000},
-{0.712500,0.212500,0.100000,0.100000},
-{0.737500,0.212500,0.050000,0.050000},
-{0.737500,0.212500,0.100000,0.100000},
-{0.762500,0.212500,0.050000,0.050000},
-{0.762500,0.212500,0.100000,0.100000},
-{0.787500,0.212500,0.050000,0.050000},
-{0.787500,0.212500,0.100000,0.100000},
-{0.812500,0.212500,0.050000,0.050000},
-{0.812500,0.212500,0.100000,0.100000},
-{0.837500,0.212500,0.050000,0.050000},
-{0.837500,0.212500,0.100000,0.100000},
-{0.862500,0.212500,0.050000,0.050000},
-{0.862500,0.212500,0.100000,0.100000},
-{0.887500,0.212500,0.050000,0.050000},
-{0.887500,0.212500,0.100000,0.100000},
-{0.912500,0.212500,0.050000,0.050000},
-{0.912500,0.212500,0.100000,0.100000},
-{0.937500,0.212500,0.050000,0.050000},
-{0.937500,0.212500,0.100000,0.100000},
-{0.962500,0.212500,0.050000,0.050000},
-{0.962500,0.212500,0.100000,0.100000},
-{0.987500,0.212500,0.050000,0.050000},
-{0.987500,0.212500,0.100000,0.100000},
-{0.012500,0.237500,0.050000,0.050000},
-{0.012500,0.237500,0.100000,0.100000},
-{0.037500,0.237500,0.050000,0.050000},
-{0.037500,0.237500,0.100000,0.100000},
-{0.062500,0.237500,0.050000,0.050000},
-{0.062500,0.237500,0.100000,0.100000},
-{0.087500,0.237500,0.050000,0.050000},
-{0.087500,0.237500,0.100000,0.100000},
-{0.112500,0.237500,0.050000,0.050000},
-{0.112500,0.237500,0.100000,0.100000},
-{0.137500,0.237500,0.050000,0.050000},
-{0.137500,0.237500,0.100000,0.100000},
-{0.162500,0.237500,0.050000,0.050000},
-{0.162500,0.237500,0.100000,0.100000},
-{0.187500,0.237500,0.050000,0.050000},
-{0.187500,0.237500,0.100000,0.100000},
-{0.212500,0.237500,0.050000,0.050000},
-{0.212500,0.237500,0.100000,0.100000},
-{0.237500,0.237500,0.050000,0.050000},
-{0.237500,0.237500,0.100000,0.100000},
-{0.262500,0.237500,0.050000,0.050000},
-{0.262500,0.237500,0.100000,0.100000},
-{0.287500,0.237500,0.050000,0.050000},
-{0.287500,0.237500,0.100000,0.100000},
-{0.312500,0.237500,0.050000,0.050000},
-{0.312500,0.237500,0.100000,0.100000},
-{0.337500,0.237500,0.050000,0.050000},
-{0.337500,0.237500,0.100000,0.100000},
-{0.362500,0.237500,0.050000,0.050000},
-{0.362500,0.237500,0.100000,0.100000},
-{0.387500,0.237500,0.050000,0.050000},
-{0.387500,0.237500,0.100000,0.100000},
-{0.412500,0.237500,0.050000,0.050000},
-{0.412500,0.237500,0.100000,0.100000},
-{0.437500,0.237500,0.050000,0.050000},
-{0.437500,0.237500,0.100000,0.100000},
-{0.462500,0.237500,0.050000,0.050000},
-{0.462500,0.237500,0.100000,0.100000},
-{0.487500,0.237500,0.050000,0.050000},
-{0.487500,0.237500,0.100000,0.100000},
-{0.512500,0.237500,0.050000,0.050000},
-{0.512500,0.237500,0.100000,0.100000},
-{0.537500,0.237500,0.050000,0.050000},
-{0.537500,0.237500,0.100000,0.100000},
-{0.562500,0.237500,0.050000,0.050000},
-{0.562500,0.237500,0.100000,0.100000},
-{0.587500,0.237500,0.050000,0.050000},
-{0.587500,0.237500,0.100000,0.100000},
-{0.612500,0.237500,0.050000,0.050000},
-{0.612500,0.237500,0.100000,0.100000},
-{0.637500,0.237500,0.050000,0.050000},
-{0.637500,0.237500,0.100000,0.100000},
-{0.662500,0.237500,0.050000,0.050000},
-{0.662500,0.237500,0.100000,0.100000},
-{0.687500,0.237500,0.050000,0.050000},
-{0.687500,0.237500,0.100000,0.100000},
-{0.712500,0.237500,0.050000,0.050000},
-{0.712500,0.237500,0.100000,0.100000},
-{0.737500,0.237500,0.050000,0.050000},
-{0.737500,0.237500,0.100000,0.100000},
-{0.762500,0.237500,0.050000,0.050000},
-{0.762500,0.237500,0.100000,0.100000},
-{0.787500,0.237500,0.050000,0.050000},
-{0.787500,0.237500,0.100000,0.100000},
-{0.812500,0.237500,0.050000,0.050000},
-{0.812500,0.237500,0.100000,0.100000},
-{0.837500,0.237500,0.050000,0.050000},
-{0.837500,0.237500,0.100000,0.100000},
-{0.862500,0.237500,0.050000,0.050000},
-{0.862500,0.237500,0.100000,0.100000},
-{0.887500,0.237500,0.050000,0.050000},
-{0.887500,0.237500,0.100000,0.100000},
-{0.912500,0.237500,0.050000,0.050000},
-{0.912500,0.237500,0.100000,0.100000},
-{0.937500,0.237500,0.050000,0.050000},
-{0.937500,0.237500,0.100000,0.100000},
-{0.962500,0.237500,0.050000,0.050000},
-{0.962500,0.237500,0.100000,0.100000},
-{0.987500,0.237500,0.050000,0.050000},
-{0.987500,0.237500,0.100000,0.100000},
-{0.012500,0.262500,0.050000,0.050000},
-{0.012500,0.262500,0.100000,0.100000},
-{0.037500,0.262500,0.050000,0.050000},
-{0.037500,0.262500,0.100000,0.100000},
-{0.062500,0.262500,0.050000,0.050000},
-{0.062500,0.262500,0.100000,0.100000},
-{0.087500,0.262500,0.050000,0.050000},
-{0.087500,0.262500,0.100000,0.100000},
-{0.112500,0.262500,0.050000,0.050000},
-{0.112500,0.262500,0.100000,0.100000},
-{0.137500,0.262500,0.050000,0.050000},
-{0.137500,0.262500,0.100000,0.100000},
-{0.162500,0.262500,0.050000,0.050000},
-{0.162500,0.262500,0.100000,0.100000},
-{0.187500,0.262500,0.050000,0.050000},
-{0.187500,0.262500,0.100000,0.100000},
-{0.212500,0.262500,0.050000,0.050000},
-{0.212500,0.262500,0.100000,0.100000},
-{0.237500,0.262500,0.050000,0.050000},
-{0.237500,0.262500,0.100000,0.100000},
-{0.262500,0.262500,0.050000,0.050000},
-{0.262500,0.262500,0.100000,0.100000},
-{0.287500,0.262500,0.050000,0.050000},
-{0.287500,0.262500,0.100000,0.100000},
-{0.312500,0.262500,0.050000,0.050000},
-{0.312500,0.262500,0.100000,0.100000},
-{0.337500,0.262500,0.050000,0.050000},
-{0.337500,0.262500,0.100000,0.100000},
-{0.362500,0.262500,0.050000,0.050000},
-{0.362500,0.262500,0.100000,0.100000},
-{0.387500,0.262500,0.050000,0.050000},
-{0.387500,0.262500,0.100000,0.100000},
-{0.412500,0.262500,0.050000,0.050000},
-{0.412500,0.262500,0.100000,0.100000},
-{0.437500,0.262500,0.050000,0.050000},
-{0.437500,0.262500,0.100000,0.100000},
-{0.462500,0.262500,0.050000,0.050000},
-{0.462500,0.262500,0.100000,0.100000},
-{0.487500,0.262500,0.050000,0.050000},
-{0.487500,0.262500,0.100000,0.100000},
-{0.512500,0.262500,0.050000,0.050000},
-{0.512500,0.262500,0.100000,0.100000},
-{0.537500,0.262500,0.050000,0.050000},
-{0.537500,0.262500,0.100000,0.100000},
-{0.562500,0.262500,0.050000,0.050000},
-{0.562500,0.262500,0.100000,0.100000},
-{0.587500,0.262500,0.050000,0.050000},
-{0.587500,0.262500,0.100000,0.100000},
-{0.612500,0.262500,0.050000,0.050000},
-{0.612500,0.262500,0.100000,0.100000},
-{0.637500,0.262500,0.050000,0.050000},
-{0.637500,0.262500,0.100000,0.100000},
-{0.662500,0.262500,0.050000,0.050000},
-{0.662500,0.262500,0.100000,0.100000},
-{0.687500,0.262500,0.050000,0.050000},
-{0.687500,0.262500,0.100000,0.100000},
-{0.712500,0.262500,0.050000,0.050000},
-{0.712500,0.262500,0.100000,0.100000},
-{0.737500,0.262500,0.050000,0.050000},
-{0.737500,0.262500,0.100000,0.100000},
-{0.762500,0.262500,0.050000,0.050000},
-{0.762500,0.262500,0.100000,0.100000},
-{0.787500,0.262500,0.050000,0.050000},
-{0.787500,0.262500,0.100000,0.100000},
-{0.812500,0.262500,0.050000,0.050000},
-{0.812500,0.262500,0.100000,0.100000},
-{0.837500,0.262500,0.050000,0.050000},
-{0.837500,0.262500,0.100000,0.100000},
-{0.862500,0.262500,0.050000,0.050000},
-{0.862500,0.262500,0.100000,0.100000},
-{0.887500,0.262500,0.050000,0.050000},
-{0.887500,0.262500,0.100000,0.100000},
-{0.912500,0.262500,0.050000,0.050000},
-{0.912500,0.262500,0.100000,0.100000},
-{0.937500,0.262500,0.050000,0.050000},
-{0.937500,0.262500,0.100000,0.100000},
-{0.962500,0.262500,0.050000,0.050000},
-{0.962500,0.262500,0.100000,0.100000},
-{0.987500,0.262500,0.050000,0.050000},
-{0.987500,0.262500,0.100000,0.100000},
-{0.012500,0.287500,0.050000,0.050000},
-{0.012500,0.287500,0.100000,0.100000},
-{0.037500,0.287500,0.050000,0.050000},
-{0.037500,0.287500,0.100000,0.100000},
-{0.062500,0.287500,0.050000,0.050000},
-{0.062500,0.287500,0.100000,0.100000},
-{0.087500,0.287500,0.050000,0.050000},
-{0.087500,0.287500,0.100000,0.100000},
-{0.112500,0.287500,0.050000,0.050000},
-{0.112500,0.287500,0.100000,0.100000},
-{0.137500,0.287500,0.050000,0.050000},
-{0.137500,0.287500,0.100000,0.100000},
-{0.162500,0.287500,0.050000,0.050000},
-{0.162500,0.287500,0.100000,0.100000},
-{0.187500,0.287500,0.050000,0.050000},
-{0.187500,0.287500,0.100000,0.100000},
-{0.212500,0.287500,0.050000,0.050000},
-{0.212500,0.287500,0.100000,0.100000},
-{0.237500,0.287500,0.050000,0.050000},
-{0.237500,0.287500,0.100000,0.100000},
-{0.262500,0.287500,0.050000,0.050000},
-{0.262500,0.287500,0.100000,0.100000},
-{0.287500,0.287500,0.050000,0.050000},
-{0.287500,0.287500,0.100000,0.100000},
-{0.312500,0.287500,0.050000,0.050000},
-{0.312500,0.287500,0.100000,0.100000},
-{0.337500,0.287500,0.050000,0.050000},
-{0.337500,0.287500,0.100000,0.100000},
-{0.362500,0.287500,0.050000,0.050000},
-{0.362500,0.287500,0.100000,0.100000},
-{0.387500,0.287500,0.050000,0.050000},
-{0.387500,0.287500,0.100000,0.100000},
-{0.412500,0.287500,0.050000,0.050000},
-{0.412500,0.287500,0.100000,0.100000},
-{0.437500,0.287500,0.050000,0.050000},
-{0.437500,0.287500,0.100000,0.100000},
-{0.462500,0.287500,0.050000,0.050000},
-{0.462500,0.287500,0.100000,0.100000},
-{0.487500,0.287500,0.050000,0.050000},
-{0.487500,0.287500,0.100000,0.100000},
-{0.512500,0.287500,0.050000,0.050000},
-{0.512500,0.287500,0.100000,0.100000},
-{0.537500,0.287500,0.050000,0.050000},
-{0.537500,0.287500,0.100000,0.100000},
-{0.562500,0.287500,0.050000,0.050000},
-{0.562500,0.287500,0.100000,0.100000},
-{0.587500,0.287500,0.050000,0.050000},
-{0.587500,0.287500,0.100000,0.100000},
-{0.612500,0.287500,0.050000,0.050000},
-{0.612500,0.287500,0.100000,0.100000},
-{0.637500,0.287500,0.050000,0.050000},
-{0.637500,0.287500,0.100000,0.100000},
-{0.662500,0.287500,0.050000,0.050000},
-{0.662500,0.287500,0.100000,0.100000},
-{0.687500,0.287500,0.050000,0.050000},
-{0.687500,0.287500,0.100000,0.100000},
-{0.712500,0.287500,0.050000,0.050000},
-{0.712500,0.287500,0.100000,0.100000},
-{0.737500,0.287500,0.050000,0.050000},
-{0.737500,0.287500,0.100000,0.100000},
-{0.762500,0.287500,0.050000,0.050000},
-{0.762500,0.287500,0.100000,0.100000},
-{0.787500,0.287500,0.050000,0.050000},
-{0.787500,0.287500,0.100000,0.100000},
-{0.812500,0.287500,0.050000,0.050000},
-{0.812500,0.287500,0.100000,0.100000},
-{0.837500,0.287500,0.050000,0.050000},
-{0.837500,0.287500,0.100000,0.100000},
-{0.862500,0.287500,0.050000,0.050000},
-{0.862500,0.287500,0.100000,0.100000},
-{0.887500,0.287500,0.050000,0.050000},
-{0.887500,0.287500,0.100000,0.100000},
-{0.912500,0.287500,0.050000,0.050000},
-{0.912500,0.287500,0.100000,0.100000},
-{0.937500,0.287500,0.050000,0.050000},
-{0.937500,0.287500,0.100000,0.100000},
-{0.962500,0.287500,0.050000,0.050000},
-{0.962500,0.287500,0.100000,0.100000},
-{0.987500,0.287500,0.050000,0.050000},
-{0.987500,0.287500,0.100000,0.100000},
-{0.012500,0.312500,0.050000,0.050000},
-{0.012500,0.312500,0.100000,0.100000},
-{0.037500,0.312500,0.050000,0.050000},
-{0.037500,0.312500,0.100000,0.100000},
-{0.062500,0.312500,0.050000,0.050000},
-{0.062500,0.312500,0.100000,0.100000},
-{0.087500,0.312500,0.050000,0.050000},
-{0.087500,0.312500,0.100000,0.100000},
-{0.112500,0.312500,0.050000,0.050000},
-{0.112500,0.312500,0.100000,0.100000},
-{0.137500,0.312500,0.050000,0.050000},
-{0.137500,0.312500,0.100000,0.100000},
-{0.162500,0.312500,0.050000,0.050000},
-{0.162500,0.312500,0.100000,0.100000},
-{0.187500,0.312500,0.050000,0.050000},
-{0.187500,0.312500,0.100000,0.100000},
-{0.212500,0.312500,0.050000,0.050000},
-{0.212500,0.312500,0.100000,0.100000},
-{0.237500,0.312500,0.050000,0.050000},
-{0.237500,0.312500,0.100000,0.100000},
-{0.262500,0.312500,0.050000,0.050000},
-{0.262500,0.312500,0.100000,0.100000},
-{0.287500,0.312500,0.050000,0.050000},
-{0.287500,0.312500,0.100000,0.100000},
-{0.312500,0.312500,0.050000,0.050000},
-{0.312500,0.312500,0.100000,0.100000},
-{0.337500,0.312500,0.050000,0.050000},
-{0.337500,0.312500,0.100000,0.100000},
-{0.362500,0.312500,0.050000,0.050000},
-{0.362500,0.312500,0.100000,0.100000},
-{0.387500,0.312500,0.050000,0.050000},
-{0.387500,0.312500,0.100000,0.100000},
-{0.412500,0.312500,0.050000,0.050000},
-{0.412500,0.312500,0.100000,0.100000},
-{0.437500,0.312500,0.050000,0.050000},
-{0.437500,0.312500,0.100000,0.100000},
-{0.462500,0.312500,0.050000,0.050000},
-{0.462500,0.312500,0.100000,0.100000},
-{0.487500,0.312500,0.050000,0.050000},
-{0.487500,0.312500,0.100000,0.100000},
-{0.512500,0.312500,0.050000,0.050000},
-{0.512500,0.312500,0.100000,0.100000},
-{0.537500,0.312500,0.050000,0.050000},
-{0.537500,0.312500,0.100000,0.100000},
-{0.562500,0.312500,0.050000,0.050000},
-{0.562500,0.312500,0.100000,0.100000},
-{0.587500,0.312500,0.050000,0.050000},
-{0.587500,0.312500,0.100000,0.100000},
-{0.612500,0.312500,0.050000,0.050000},
-{0.612500,0.312500,0.100000,0.100000},
-{0.637500,0.312500,0.050000,0.050000},
-{0.637500,0.312500,0.100000,0.100000},
-{0.662500,0.312500,0.050000,0.050000},
-{0.662500,0.312500,0.100000,0.100000},
-{0.687500,0.312500,0.050000,0.050000},
-{0.687500,0.312500,0.100000,0.100000},
-{0.712500,0.312500,0.050000,0.050000},
-{0.712500,0.312500,0.100000,0.100000},
-{0.737500,0.312500,0.050000,0.050000},
-{0.737500,0.312500,0.100000,0.100000},
-{0.762500,0.312500,0.050000,0.050000},
-{0.762500,0.312500,0.100000,0.100000},
-{0.787500,0.312500,0.050000,0.050000},
-{0.787500,0.312500,0.100000,0.100000},
-{0.812500,0.312500,0.050000,0.050000},
-{0.812500,0.312500,0.100000,0.100000},
-{0.837500,0.312500,0.050000,0.050000},
-{0.837500,0.312500,0.100000,0.100000},
-{0.862500,0.312500,0.050000,0.050000},
-{0.862500,0.312500,0.100000,0.100000},
-{0.887500,0.312500,0.050000,0.050000},
-{0.887500,0.312500,0.100000,0.100000},
-{0.912500,0.312500,0.050000,0.050000},
-{0.912500,0.312500,0.100000,0.100000},
-{0.937500,0.312500,0.050000,0.050000},
-{0.937500,0.312500,0.100000,0.100000},
-{0.962500,0.312500,0.050000,0.050000},
-{0.962500,0.312500,0.100000,0.100000},
-{0.987500,0.312500,0.050000,0.050000},
-{0.987500,0.312500,0.100000,0.100000},
-{0.012500,0.337500,0.050000,0.050000},
-{0.012500,0.337500,0.100000,0.100000},
-{0.037500,0.337500,0.050000,0.050000},
-{0.037500,0.337500,0.100000,0.100000},
-{0.062500,0.337500,0.050000,0.050000},
-{0.062500,0.337500,0.100000,0.100000},
-{0.087500,0.337500,0.050000,0.050000},
-{0.087500,0.337500,0.100000,0.100000},
-{0.112500,0.337500,0.050000,0.050000},
-{0.112500,0.337500,0.100000,0.100000},
-{0.137500,0.337500,0.050000,0.050000},
-{0.137500,0.337500,0.100000,0.100000},
-{0.162500,0.337500,0.050000,0.050000},
-{0.162500,0.337500,0.100000,0.100000},
-{0.187500,0.337500,0.050000,0.050000},
-{0.187500,0.337500,0.100000,0.100000},
-{0.212500,0.337500,0.050000,0.050000},
-{0.212500,0.337500,0.100000,0.100000},
-{0.237500,0.337500,0.050000,0.050000},
-{0.237500,0.337500,0.100000,0.100000},
-{0.262500,0.337500,0.050000,0.050000},
-{0.262500,0.337500,0.100000,0.100000},
-{0.287500,0.337500,0.050000,0.050000},
-{0.287500,0.337500,0.100000,0.100000},
-{0.312500,0.337500,0.050000,0.050000},
-{0.312500,0.337500,0.100000,0.100000},
-{0.337500,0.337500,0.050000,0.050000},
-{0.337500,0.337500,0.100000,0.100000},
-{0.362500,0.337500,0.050000,0.050000},
-{0.362500,0.337500,0.100000,0.100000},
-{0.387500,0.337500,0.050000,0.050000},
-{0.387500,0.337500,0.100000,0.100000},
-{0.412500,0.337500,0.050000,0.050000},
-{0.412500,0.337500,0.100000,0.100000},
-{0.437500,0.337500,0.050000,0.050000},
-{0.437500,0.337500,0.100000,0.100000},
-{0.462500,0.337500,0.050000,0.050000},
-{0.462500,0.337500,0.100000,0.100000},
-{0.487500,0.337500,0.050000,0.050000},
-{0.487500,0.337500,0.100000,0.100000},
-{0.512500,0.337500,0.050000,0.050000},
-{0.512500,0.337500,0.100000,0.100000},
-{0.537500,0.337500,0.050000,0.050000},
-{0.537500,0.337500,0.100000,0.100000},
-{0.562500,0.337500,0.050000,0.050000},
-{0.562500,0.337500,0.100000,0.100000},
-{0.587500,0.337500,0.050000,0.050000},
-{0.587500,0.337500,0.100000,0.100000},
-{0.612500,0.337500,0.050000,0.050000},
-{0.612500,0.337500,0.100000,0.100000},
-{0.637500,0.337500,0.050000,0.050000},
-{0.637500,0.337500,0.100000,0.100000},
-{0.662500,0.337500,0.050000,0.050000},
-{0.662500,0.337500,0.100000,0.100000},
-{0.687500,0.337500,0.050000,0.050000},
-{0.687500,0.337500,0.100000,0.100000},
-{0.712500,0.337500,0.050000,0.050000},
-{0.712500,0.337500,0.100000,0.100000},
-{0.737500,0.337500,0.050000,0.050000},
-{0.737500,0.337500,0.100000,0.100000},
-{0.762500,0.337500,0.050000,0.050000},
-{0.762500,0.337500,0.100000,0.100000},
-{0.787500,0.337500,0.050000,0.050000},
-{0.787500,0.337500,0.100000,0.100000},
-{0.812500,0.337500,0.050000,0.050000},
-{0.812500,0.337500,0.100000,0.100000},
-{0.837500,0.337500,0.050000,0.050000},
-{0.837500,0.337500,0.100000,0.100000},
-{0.862500,0.337500,0.050000,0.050000},
-{0.862500,0.337500,0.100000,0.100000},
-{0.887500,0.337500,0.050000,0.050000},
-{0.887500,0.337500,0.100000,0.100000},
-{0.912500,0.337500,0.050000,0.050000},
-{0.912500,0.337500,0.100000,0.100000},
-{0.937500,0.337500,0.050000,0.050000},
-{0.937500,0.337500,0.100000,0.100000},
-{0.962500,0.337500,0.050000,0.050000},
-{0.962500,0.337500,0.100000,0.100000},
-{0.987500,0.337500,0.050000,0.050000},
-{0.987500,0.337500,0.100000,0.100000},
-{0.012500,0.362500,0.050000,0.050000},
-{0.012500,0.362500,0.100000,0.100000},
-{0.037500,0.362500,0.050000,0.050000},
-{0.037500,0.362500,0.100000,0.100000},
-{0.062500,0.362500,0.050000,0.050000},
-{0.062500,0.362500,0.100000,0.100000},
-{0.087500,0.362500,0.050000,0.050000},
-{0.087500,0.362500,0.100000,0.100000},
-{0.112500,0.362500,0.050000,0.050000},
-{0.112500,0.362500,0.100000,0.100000},
-{0.137500,0.362500,0.050000,0.050000},
-{0.137500,0.362500,0.100000,0.100000},
-{0.162500,0.362500,0.050000,0.050000},
-{0.162500,0.362500,0.100000,0.100000},
-{0.187500,0.362500,0.050000,0.050000},
-{0.187500,0.362500,0.100000,0.100000},
-{0.212500,0.362500,0.050000,0.050000},
-{0.212500,0.362500,0.100000,0.100000},
-{0.237500,0.362500,0.050000,0.050000},
-{0.237500,0.362500,0.100000,0.100000},
-{0.262500,0.362500,0.050000,0.050000},
-{0.262500,0.362500,0.100000,0.100000},
-{0.287500,0.362500,0.050000,0.050000},
-{0.287500,0.362500,0.100000,0.100000},
-{0.312500,0.362500,0.050000,0.050000},
-{0.312500,0.362500,0.100000,0.100000},
-{0.337500,0.362500,0.050000,0.050000},
-{0.337500,0.362500,0.100000,0.100000},
-{0.362500,0.362500,0.050000,0.050000},
-{0.362500,0.362500,0.100000,0.100000},
-{0.387500,0.362500,0.050000,0.050000},
-{0.387500,0.362500,0.100000,0.100000},
-{0.412500,0.362500,0.050000,0.050000},
-{0.412500,0.362500,0.100000,0.100000},
-{0.437500,0.362500,0.050000,0.050000},
-{0.437500,0.362500,0.100000,0.100000},
-{0.462500,0.362500,0.050000,0.050000},
-{0.462500,0.362500,0.100000,0.100000},
-{0.487500,0.362500,0.050000,0.050000},
-{0.487500,0.362500,0.100000,0.100000},
-{0.512500,0.362500,0.050000,0.050000},
-{0.512500,0.362500,0.100000,0.100000},
-{0.537500,0.362500,0.050000,0.050000},
-{0.537500,0.362500,0.100000,0.100000},
-{0.562500,0.362500,0.050000,0.050000},
-{0.562500,0.362500,0.100000,0.100000},
-{0.587500,0.362500,0.050000,0.050000},
-{0.587500,0.362500,0.100000,0.100000},
-{0.612500,0.362500,0.050000,0.050000},
-{0.612500,0.362500,0.100000,0.100000},
-{0.637500,0.362500,0.050000,0.050000},
-{0.637500,0.362500,0.100000,0.100000},
-{0.662500,0.362500,0.050000,0.050000},
-{0.662500,0.362500,0.100000,0.100000},
-{0.687500,0.362500,0.050000,0.050000},
-{0.687500,0.362500,0.100000,0.100000},
-{0.712500,0.362500,0.050000,0.050000},
-{0.712500,0.362500,0.100000,0.100000},
-{0.737500,0.362500,0.050000,0.050000},
-{0.737500,0.362500,0.100000,0.100000},
-{0.762500,0.362500,0.050000,0.050000},
-{0.762500,0.362500,0.100000,0.100000},
-{0.787500,0.362500,0.050000,0.050000},
-{0.787500,0.362500,0.100000,0.100000},
-{0.812500,0.362500,0.050000,0.050000},
-{0.812500,0.362500,0.100000,0.100000},
-{0.837500,0.362500,0.050000,0.050000},
-{0.837500,0.362500,0.100000,0.100000},
-{0.862500,0.362500,0.050000,0.050000},
-{0.862500,0.362500,0.100000,0.100000},
-{0.887500,0.362500,0.050000,0.050000},
-{0.887500,0.362500,0.100000,0.100000},
-{0.912500,0.362500,0.050000,0.050000},
-{0.912500,0.362500,0.100000,0.100000},
-{0.937500,0.362500,0.050000,0.050000},
-{0.937500,0.362500,0.100000,0.100000},
-{0.962500,0.362500,0.050000,0.050000},
-{0.962500,0.362500,0.100000,0.100000},
-{0.987500,0.362500,0.050000,0.050000},
-{0.987500,0.362500,0.100000,0.100000},
-{0.012500,0.387500,0.050000,0.050000},
-{0.012500,0.387500,0.100000,0.100000},
-{0.037500,0.387500,0.050000,0.050000},
-{0.037500,0.387500,0.100000,0.100000},
-{0.062500,0.387500,0.050000,0.050000},
-{0.062500,0.387500,0.100000,0.100000},
-{0.087500,0.387500,0.050000,0.050000},
-{0.087500,0.387500,0.100000,0.100000},
-{0.112500,0.387500,0.050000,0.050000},
-{0.112500,0.387500,0.100000,0.100000},
-{0.137500,0.387500,0.050000,0.050000},
-{0.137500,0.387500,0.100000,0.100000},
-{0.162500,0.387500,0.050000,0.050000},
-{0.162500,0.387500,0.100000,0.100000},
-{0.187500,0.387500,0.050000,0.050000},
-{0.187500,0.387500,0.100000,0.100000},
-{0.212500,0.387500,0.050000,0.050000},
-{0.212500,0.387500,0.100000,0.100000},
-{0.237500,0.387500,0.050000,0.050000},
-{0.237500,0.387500,0.100000,0.100000},
-{0.262500,0.387500,0.050000,0.050000},
-{0.262500,0.387500,0.100000,0.100000},
-{0.287500,0.387500,0.050000,0.050000},
-{0.287500,0.387500,0.100000,0.100000},
-{0.312500,0.387500,0.050000,0.050000},
-{0.312500,0.387500,0.100000,0.100000},
-{0.337500,0.387500,0.050000,0.050000},
-{0.337500,0.387500,0.100000,0.100000},
-{0.362500,0.387500,0.050000,0.050000},
-{0.362500,0.387500,0.100000,0.100000},
-{0.387500,0.387500,0.050000,0.050000},
-{0.387500,0.387500,0.100000,0.100000},
-{0.412500,0.387500,0.050000,0.050000},
-{0.412500,0.387500,0.100000,0.100000},
-{0.437500,0.387500,0.050000,0.050000},
-{0.437500,0.387500,0.100000,0.100000},
-{0.462500,0.387500,0.050000,0.050000},
-{0.462500,0.387500,0.100000,0.100000},
-{0.487500,0.387500,0.050000,0.050000},
-{0.487500,0.387500,0.100000,0.100000},
-{0.512500,0.387500,0.050000,0.050000},
-{0.512500,0.387500,0.100000,0.100000},
-{0.537500,0.387500,0.050000,0.050000},
-{0.537500,0.387500,0.100000,0.100000},
-{0.562500,0.387500,0.050000,0.050000},
-{0.562500,0.387500,0.100000,0.100000},
-{0.587500,0.387500,0.050000,0.050000},
-{0.587500,0.387500,0.100000,0.100000},
-{0.612500,0.387500,0.050000,0.050000},
-{0.612500,0.387500,0.100000,0.100000},
-{0.637500,0.387500,0.050000,0.050000},
-{0.637500,0.387500,0.100000,0.100000},
-{0.662500,0.387500,0.050000,0.050000},
-{0.662500,0.387500,0.100000,0.100000},
-{0.687500,0.387500,0.050000,0.050000},
-{0.687500,0.387500,0.100000,0.100000},
-{0.712500,0.387500,0.050000,0.050000},
-{0.712500,0.387500,0.100000,0.100000},
-{0.737500,0.387500,0.050000,0.050000},
-{0.737500,0.387500,0.100000,0.100000},
-{0.762500,0.387500,0.050000,0.050000},
-{0.762500,0.387500,0.100000,0.100000},
-{0.787500,0.387500,0.050000,0.050000},
-{0.787500,0.387500,0.100000,0.100000},
-{0.812500,0.387500,0.050000,0.050000},
-{0.812500,0.387500,0.100000,0.100000},
-{0.837500,0.387500,0.050000,0.050000},
-{0.837500,0.387500,0.100000,0.100000},
-{0.862500,0.387500,0.050000,0.050000},
-{0.862500,0.387500,0.100000,0.100000},
-{0.887500,0.387500,0.050000,0.050000},
-{0.887500,0.387500,0.100000,0.100000},
-{0.912500,0.387500,0.050000,0.050000},
-{0.912500,0.387500,0.100000,0.100000},
-{0.937500,0.387500,0.050000,0.050000},
-{0.937500,0.387500,0.100000,0.100000},
-{0.962500,0.387500,0.050000,0.050000},
-{0.962500,0.387500,0.100000,0.100000},
-{0.987500,0.387500,0.050000,0.050000},
-{0.987500,0.387500,0.100000,0.100000},
-{0.012500,0.412500,0.050000,0.050000},
-{0.012500,0.412500,0.100000,0.100000},
-{0.037500,0.412500,0.050000,0.050000},
-{0.037500,0.412500,0.100000,0.100000},
-{0.062500,0.412500,0.050000,0.050000},
-{0.062500,0.412500,0.100000,0.100000},
-{0.087500,0.412500,0.050000,0.050000},
-{0.087500,0.412500,0.100000,0.100000},
-{0.112500,0.412500,0.050000,0.050000},
-{0.112500,0.412500,0.100000,0.100000},
-{0.137500,0.412500,0.050000,0.050000},
-{0.137500,0.412500,0.100000,0.100000},
-{0.162500,0.412500,0.050000,0.050000},
-{0.162500,0.412500,0.100000,0.100000},
-{0.187500,0.412500,0.050000,0.050000},
-{0.187500,0.412500,0.100000,0.100000},
-{0.212500,0.412500,0.050000,0.050000},
-{0.212500,0.412500,0.100000,0.100000},
-{0.237500,0.412500,0.050000,0.050000},
-{0.237500,0.412500,0.100000,0.100000},
-{0.262500,0.412500,0.050000,0.050000},
-{0.262500,0.412500,0.100000,0.100000},
-{0.287500,0.412500,0.050000,0.050000},
-{0.287500,0.412500,0.100000,0.100000},
-{0.312500,0.412500,0.050000,0.050000},
-{0.312500,0.412500,0.100000,0.100000},
-{0.337500,0.412500,0.050000,0.050000},
-{0.337500,0.412500,0.100000,0.100000},
-{0.362500,0.412500,0.050000,0.050000},
-{0.362500,0.412500,0.100000,0.100000},
-{0.387500,0.412500,0.050000,0.050000},
-{0.387500,0.412500,0.100000,0.100000},
-{0.412500,0.412500,0.050000,0.050000},
-{0.412500,0.412500,0.100000,0.100000},
-{0.437500,0.412500,0.050000,0.050000},
-{0.437500,0.412500,0.100000,0.100000},
-{0.462500,0.412500,0.050000,0.050000},
-{0.462500,0.412500,0.100000,0.100000},
-{0.487500,0.412500,0.050000,0.050000},
-{0.487500,0.412500,0.100000,0.100000},
-{0.512500,0.412500,0.050000,0.050000},
-{0.512500,0.412500,0.100000,0.100000},
-{0.537500,0.412500,0.050000,0.050000},
-{0.537500,0.412500,0.100000,0.100000},
-{0.562500,0.412500,0.050000,0.050000},
-{0.562500,0.412500,0.100000,0.100000},
-{0.587500,0.412500,0.050000,0.050000},
-{0.587500,0.412500,0.100000,0.100000},
-{0.612500,0.412500,0.050000,0.050000},
-{0.612500,0.412500,0.100000,0.100000},
-{0.637500,0.412500,0.050000,0.050000},
-{0.637500,0.412500,0.100000,0.100000},
-{0.662500,0.412500,0.050000,0.050000},
-{0.662500,0.412500,0.100000,0.100000},
-{0.687500,0.412500,0.050000,0.050000},
-{0.687500,0.412500,0.100000,0.100000},
-{0.712500,0.412500,0.050000,0.050000},
-{0.712500,0.412500,0.100000,0.100000},
-{0.737500,0.412500,0.050000,0.050000},
-{0.737500,0.412500,0.100000,0.100000},
-{0.762500,0.412500,0.050000,0.050000},
-{0.762500,0.412500,0.100000,0.100000},
-{0.787500,0.412500,0.050000,0.050000},
-{0.787500,0.412500,0.100000,0.100000},
-{0.812500,0.412500,0.050000,0.050000},
-{0.812500,0.412500,0.100000,0.100000},
-{0.837500,0.412500,0.050000,0.050000},
-{0.837500,0.412500,0.100000,0.100000},
-{0.862500,0.412500,0.050000,0.050000},
-{0.862500,0.412500,0.100000,0.100000},
-{0.887500,0.412500,0.050000,0.050000},
-{0.887500,0.412500,0.100000,0.100000},
-{0.912500,0.412500,0.050000,0.050000},
-{0.912500,0.412500,0.100000,0.100000},
-{0.937500,0.412500,0.050000,0.050000},
-{0.937500,0.412500,0.100000,0.100000},
-{0.962500,0.412500,0.050000,0.050000},
-{0.962500,0.412500,0.100000,0.100000},
-{0.987500,0.412500,0.050000,0.050000},
-{0.987500,0.412500,0.100000,0.100000},
-{0.012500,0.437500,0.050000,0.050000},
-{0.012500,0.437500,0.100000,0.100000},
-{0.037500,0.437500,0.050000,0.050000},
-{0.037500,0.437500,0.100000,0.100000},
-{0.062500,0.437500,0.050000,0.050000},
-{0.062500,0.437500,0.100000,0.100000},
-{0.087500,0.437500,0.050000,0.050000},
-{0.087500,0.437500,0.100000,0.100000},
-{0.112500,0.437500,0.050000,0.050000},
-{0.112500,0.437500,0.100000,0.100000},
-{0.137500,0.437500,0.050000,0.050000},
-{0.137500,0.437500,0.100000,0.100000},
-{0.162500,0.437500,0.050000,0.050000},
-{0.162500,0.437500,0.100000,0.100000},
-{0.187500,0.437500,0.050000,0.050000},
-{0.187500,0.437500,0.100000,0.100000},
-{0.212500,0.437500,0.050000,0.050000},
-{0.212500,0.437500,0.100000,0.100000},
-{0.237500,0.437500,0.050000,0.050000},
-{0.237500,0.437500,0.100000,0.100000},
-{0.262500,0.437500,0.050000,0.050000},
-{0.262500,0.437500,0.100000,0.100000},
-{0.287500,0.437500,0.050000,0.050000},
-{0.287500,0.437500,0.100000,0.100000},
-{0.312500,0.437500,0.050000,0.050000},
-{0.312500,0.437500,0.100000,0.100000},
-{0.337500,0.437500,0.050000,0.050000},
-{0.337500,0.437500,0.100000,0.100000},
-{0.362500,0.437500,0.050000,0.050000},
-{0.362500,0.437500,0.100000,0.100000},
-{0.387500,0.437500,0.050000,0.050000},
-{0.387500,0.437500,0.100000,0.100000},
-{0.412500,0.437500,0.050000,0.050000},
-{0.412500,0.437500,0.100000,0.100000},
-{0.437500,0.437500,0.050000,0.050000},
-{0.437500,0.437500,0.100000,0.100000},
-{0.462500,0.437500,0.050000,0.050000},
-{0.462500,0.437500,0.100000,0.100000},
-{0.487500,0.437500,0.050000,0.050000},
-{0.487500,0.437500,0.100000,0.100000},
-{0.512500,0.437500,0.050000,0.050000},
-{0.512500,0.437500,0.100000,0.100000},
-{0.537500,0.437500,0.050000,0.050000},
-{0.537500,0.437500,0.100000,0.100000},
-{0.562500,0.437500,0.050000,0.050000},
-{0.562500,0.437500,0.100000,0.100000},
-{0.587500,0.437500,0.050000,0.050000},
-{0.587500,0.437500,0.100000,0.100000},
-{0.612500,0.437500,0.050000,0.050000},
-{0.612500,0.437500,0.100000,0.100000},
-{0.637500,0.437500,0.050000,0.050000},
-{0.637500,0.437500,0.100000,0.100000},
-{0.662500,0.437500,0.050000,0.050000},
-{0.662500,0.437500,0.100000,0.100000},
-{0.687500,0.437500,0.050000,0.050000},
-{0.687500,0.437500,0.100000,0.100000},
-{0.712500,0.437500,0.050000,0.050000},
-{0.712500,0.437500,0.100000,0.100000},
-{0.737500,0.437500,0.050000,0.050000},
-{0.737500,0.437500,0.100000,0.100000},
-{0.762500,0.437500,0.050000,0.050000},
-{0.762500,0.437500,0.100000,0.100000},
-{0.787500,0.437500,0.050000,0.050000},
-{0.787500,0.437500,0.100000,0.100000},
-{0.812500,0.437500,0.050000,0.050000},
-{0.812500,0.437500,0.100000,0.100000},
-{0.837500,0.437500,0.050000,0.050000},
-{0.837500,0.437500,0.100000,0.100000},
-{0.862500,0.437500,0.050000,0.050000},
-{0.862500,0.437500,0.100000,0.100000},
-{0.887500,0.437500,0.050000,0.050000},
-{0.887500,0.437500,0.100000,0.100000},
-{0.912500,0.437500,0.050000,0.050000},
-{0.912500,0.437500,0.100000,0.100000},
-{0.937500,0.437500,0.050000,0.050000},
-{0.937500,0.437500,0.100000,0.100000},
-{0.962500,0.437500,0.050000,0.050000},
-{0.962500,0.437500,0.100000,0.100000},
-{0.987500,0.437500,0.050000,0.050000},
-{0.987500,0.437500,0.100000,0.100000},
-{0.012500,0.462500,0.050000,0.050000},
-{0.012500,0.462500,0.100000,0.100000},
-{0.037500,0.462500,0.050000,0.050000},
-{0.037500,0.462500,0.100000,0.100000},
-{0.062500,0.462500,0.050000,0.050000},
-{0.062500,0.462500,0.100000,0.100000},
-{0.087500,0.462500,0.050000,0.050000},
-{0.087500,0.462500,0.100000,0.100000},
-{0.112500,0.462500,0.050000,0.050000},
-{0.112500,0.462500,0.100000,0.100000},
-{0.137500,0.462500,0.050000,0.050000},
-{0.137500,0.462500,0.100000,0.100000},
-{0.162500,0.462500,0.050000,0.050000},
-{0.162500,0.462500,0.100000,0.100000},
-{0.187500,0.462500,0.050000,0.050000},
-{0.187500,0.462500,0.100000,0.100000},
-{0.212500,0.462500,0.050000,0.050000},
-{0.212500,0.462500,0.100000,0.100000},
-{0.237500,0.462500,0.050000,0.050000},
-{0.237500,0.462500,0.100000,0.100000},
-{0.262500,0.462500,0.050000,0.050000},
-{0.262500,0.462500,0.100000,0.100000},
-{0.287500,0.462500,0.050000,0.050000},
-{0.287500,0.462500,0.100000,0.100000},
-{0.312500,0.462500,0.050000,0.050000},
-{0.312500,0.462500,0.100000,0.100000},
-{0.337500,0.462500,0.050000,0.050000},
-{0.337500,0.462500,0.100000,0.100000},
-{0.362500,0.462500,0.050000,0.050000},
-{0.362500,0.462500,0.100000,0.100000},
-{0.387500,0.462500,0.050000,0.050000},
-{0.387500,0.462500,0.100000,0.100000},
-{0.412500,0.462500,0.050000,0.050000},
-{0.412500,0.462500,0.100000,0.100000},
-{0.437500,0.462500,0.050000,0.050000},
-{0.437500,0.462500,0.100000,0.100000},
-{0.462500,0.462500,0.050000,0.050000},
-{0.462500,0.462500,0.100000,0.100000},
-{0.487500,0.462500,0.050000,0.050000},
-{0.487500,0.462500,0.100000,0.100000},
-{0.512500,0.462500,0.050000,0.050000},
-{0.512500,0.462500,0.100000,0.100000},
-{0.537500,0.462500,0.050000,0.050000},
-{0.537500,0.462500,0.100000,0.100000},
-{0.562500,0.462500,0.050000,0.050000},
-{0.562500,0.462500,0.100000,0.100000},
-{0.587500,0.462500,0.050000,0.050000},
-{0.587500,0.462500,0.100000,0.100000},
-{0.612500,0.462500,0.050000,0.050000},
-{0.612500,0.462500,0.100000,0.100000},
-{0.637500,0.462500,0.050000,0.050000},
-{0.637500,0.462500,0.100000,0.100000},
-{0.662500,0.462500,0.050000,0.050000},
-{0.662500,0.462500,0.100000,0.100000},
-{0.687500,0.462500,0.050000,0.050000},
-{0.687500,0.462500,0.100000,0.100000},
-{0.712500,0.462500,0.050000,0.050000},
-{0.712500,0.462500,0.100000,0.100000},
-{0.737500,0.462500,0.050000,0.050000},
-{0.737500,0.462500,0.100000,0.100000},
-{0.762500,0.462500,0.050000,0.050000},
-{0.762500,0.462500,0.100000,0.100000},
-{0.787500,0.462500,0.050000,0.050000},
-{0.787500,0.462500,0.100000,0.100000},
-{0.812500,0.462500,0.050000,0.050000},
-{0.812500,0.462500,0.100000,0.100000},
-{0.837500,0.462500,0.050000,0.050000},
-{0.837500,0.462500,0.100000,0.100000},
-{0.862500,0.462500,0.050000,0.050000},
-{0.862500,0.462500,0.100000,0.100000},
-{0.887500,0.462500,0.050000,0.050000},
-{0.887500,0.462500,0.100000,0.100000},
-{0.912500,0.462500,0.050000,0.050000},
-{0.912500,0.462500,0.100000,0.100000},
-{0.937500,0.462500,0.050000,0.050000},
-{0.937500,0.462500,0.100000,0.100000},
-{0.962500,0.462500,0.050000,0.050000},
-{0.962500,0.462500,0.100000,0.100000},
-{0.987500,0.462500,0.050000,0.050000},
-{0.987500,0.462500,0.100000,0.100000},
-{0.012500,0.487500,0.050000,0.050000},
-{0.012500,0.487500,0.100000,0.100000},
-{0.037500,0.487500,0.050000,0.050000},
-{0.037500,0.487500,0.100000,0.100000},
-{0.062500,0.487500,0.050000,0.050000},
-{0.062500,0.487500,0.100000,0.100000},
-{0.087500,0.487500,0.050000,0.050000},
-{0.087500,0.487500,0.100000,0.100000},
-{0.112500,0.487500,0.050000,0.050000},
-{0.112500,0.487500,0.100000,0.100000},
-{0.137500,0.487500,0.050000,0.050000},
-{0.137500,0.487500,0.100000,0.100000},
-{0.162500,0.487500,0.050000,0.050000},
-{0.162500,0.487500,0.100000,0.100000},
-{0.187500,0.487500,0.050000,0.050000},
-{0.187500,0.487500,0.100000,0.100000},
-{0.212500,0.487500,0.050000,0.050000},
-{0.212500,0.487500,0.100000,0.100000},
-{0.237500,0.487500,0.050000,0.050000},
-{0.237500,0.487500,0.100000,0.100000},
-{0.262500,0.487500,0.050000,0.050000},
-{0.262500,0.487500,0.100000,0.100000},
-{0.287500,0.487500,0.050000,0.050000},
-{0.287500,0.487500,0.100000,0.100000},
-{0.312500,0.487500,0.050000,0.050000},
-{0.312500,0.487500,0.100000,0.100000},
-{0.337500,0.487500,0.050000,0.050000},
-{0.337500,0.487500,0.100000,0.100000},
-{0.362500,0.487500,0.050000,0.050000},
-{0.362500,0.487500,0.100000,0.100000},
-{0.387500,0.487500,0.050000,0.050000},
-{0.387500,0.487500,0.100000,0.100000},
-{0.412500,0.487500,0.050000,0.050000},
-{0.412500,0.487500,0.100000,0.100000},
-{0.437500,0.487500,0.050000,0.050000},
-{0.437500,0.487500,0.100000,0.100000},
-{0.462500,0.487500,0.050000,0.050000},
-{0.462500,0.487500,0.100000,0.100000},
-{0.487500,0.487500,0.050000,0.050000},
-{0.487500,0.487500,0.100000,0.100000},
-{0.512500,0.487500,0.050000,0.050000},
-{0.512500,0.487500,0.100000,0.100000},
-{0.537500,0.487500,0.050000,0.050000},
-{0.537500,0.487500,0.100000,0.100000},
-{0.562500,0.487500,0.050000,0.050000},
-{0.562500,0.487500,0.100000,0.100000},
-{0.587500,0.487500,0.050000,0.050000},
-{0.587500,0.487500,0.100000,0.100000},
-{0.612500,0.487500,0.050000,0.050000},
-{0.612500,0.487500,0.100000,0.100000},
-{0.637500,0.487500,0.050000,0.050000},
-{0.637500,0.487500,0.100000,0.100000},
-{0.662500,0.487500,0.050000,0.050000},
-{0.662500,0.487500,0.100000,0.100000},
-{0.687500,0.487500,0.050000,0.050000},
-{0.687500,0.487500,0.100000,0.100000},
-{0.712500,0.487500,0.050000,0.050000},
-{0.712500,0.487500,0.100000,0.100000},
-{0.737500,0.487500,0.050000,0.050000},
-{0.737500,0.487500,0.100000,0.100000},
-{0.762500,0.487500,0.050000,0.050000},
-{0.762500,0.487500,0.100000,0.100000},
-{0.787500,0.487500,0.050000,0.050000},
-{0.787500,0.487500,0.100000,0.100000},
-{0.812500,0.487500,0.050000,0.050000},
-{0.812500,0.487500,0.100000,0.100000},
-{0.837500,0.487500,0.050000,0.050000},
-{0.837500,0.487500,0.100000,0.100000},
-{0.862500,0.487500,0.050000,0.050000},
-{0.862500,0.487500,0.100000,0.100000},
-{0.887500,0.487500,0.050000,0.050000},
-{0.887500,0.487500,0.100000,0.100000},
-{0.912500,0.487500,0.050000,0.050000},
-{0.912500,0.487500,0.100000,0.100000},
-{0.937500,0.487500,0.050000,0.050000},
-{0.937500,0.487500,0.100000,0.100000},
-{0.962500,0.487500,0.050000,0.050000},
-{0.962500,0.487500,0.100000,0.100000},
-{0.987500,0.487500,0.050000,0.050000},
-{0.987500,0.487500,0.100000,0.100000},
-{0.012500,0.512500,0.050000,0.050000},
-{0.012500,0.512500,0.100000,0.100000},
-{0.037500,0.512500,0.050000,0.050000},
-{0.037500,0.512500,0.100000,0.100000},
-{0.062500,0.512500,0.050000,0.050000},
-{0.062500,0.512500,0.100000,0.100000},
-{0.087500,0.512500,0.050000,0.050000},
-{0.087500,0.512500,0.100000,0.100000},
-{0.112500,0.512500,0.050000,0.050000},
-{0.112500,0.512500,0.100000,0.100000},
-{0.137500,0.512500,0.050000,0.050000},
-{0.137500,0.512500,0.100000,0.100000},
-{0.162500,0.512500,0.050000,0.050000},
-{0.162500,0.512500,0.100000,0.100000},
-{0.187500,0.512500,0.050000,0.050000},
-{0.187500,0.512500,0.100000,0.100000},
-{0.212500,0.512500,0.050000,0.050000},
-{0.212500,0.512500,0.100000,0.100000},
-{0.237500,0.512500,0.050000,0.050000},
-{0.237500,0.512500,0.100000,0.100000},
-{0.262500,0.512500,0.050000,0.050000},
-{0.262500,0.512500,0.100000,0.100000},
-{0.287500,0.512500,0.050000,0.050000},
-{0.287500,0.512500,0.100000,0.100000},
-{0.312500,0.512500,0.050000,0.050000},
-{0.312500,0.512500,0.100000,0.100000},
-{0.337500,0.512500,0.050000,0.050000},
-{0.337500,0.512500,0.100000,0.100000},
-{0.362500,0.512500,0.050000,0.050000},
-{0.362500,0.512500,0.100000,0.100000},
-{0.387500,0.512500,0.050000,0.050000},
-{0.387500,0.512500,0.100000,0.100000},
-{0.412500,0.512500,0.050000,0.050000},
-{0.412500,0.512500,0.100000,0.100000},
-{0.437500,0.512500,0.050000,0.050000},
-{0.437500,0.512500,0.100000,0.100000},
-{0.462500,0.512500,0.050000,0.050000},
-{0.462500,0.512500,0.100000,0.100000},
-{0.487500,0.512500,0.050000,0.050000},
-{0.487500,0.512500,0.100000,0.100000},
-{0.512500,0.512500,0.050000,0.050000},
-{0.512500,0.512500,0.100000,0.100000},
-{0.537500,0.512500,0.050000,0.050000},
-{0.537500,0.512500,0.100000,0.100000},
-{0.562500,0.512500,0.050000,0.050000},
-{0.562500,0.512500,0.100000,0.100000},
-{0.587500,0.512500,0.050000,0.050000},
-{0.587500,0.512500,0.100000,0.100000},
-{0.612500,0.512500,0.050000,0.050000},
-{0.612500,0.512500,0.100000,0.100000},
-{0.637500,0.512500,0.050000,0.050000},
-{0.637500,0.512500,0.100000,0.100000},
-{0.662500,0.512500,0.050000,0.050000},
-{0.662500,0.512500,0.100000,0.100000},
-{0.687500,0.512500,0.050000,0.050000},
-{0.687500,0.512500,0.100000,0.100000},
-{0.712500,0.512500,0.050000,0.050000},
-{0.712500,0.512500,0.100000,0.100000},
-{0.737500,0.512500,0.050000,0.050000},
-{0.737500,0.512500,0.100000,0.100000},
-{0.762500,0.512500,0.050000,0.050000},
-{0.762500,0.512500,0.100000,0.100000},
-{0.787500,0.512500,0.050000,0.050000},
-{0.787500,0.512500,0.100000,0.100000},
-{0.812500,0.512500,0.050000,0.050000},
-{0.812500,0.512500,0.100000,0.100000},
-{0.837500,0.512500,0.050000,0.050000},
-{0.837500,0.512500,0.100000,0.100000},
-{0.862500,0.512500,0.050000,0.050000},
-{0.862500,0.512500,0.100000,0.100000},
-{0.887500,0.512500,0.050000,0.050000},
-{0.887500,0.512500,0.100000,0.100000},
-{0.912500,0.512500,0.050000,0.050000},
-{0.912500,0.512500,0.100000,0.100000},
-{0.937500,0.512500,0.050000,0.050000},
-{0.937500,0.512500,0.100000,0.100000},
-{0.962500,0.512500,0.050000,0.050000},
-{0.962500,0.512500,0.100000,0.100000},
-{0.987500,0.512500,0.050000,0.050000},
-{0.987500,0.512500,0.100000,0.100000},
-{0.012500,0.537500,0.050000,0.050000},
-{0.012500,0.537500,0.100000,0.100000},
-{0.037500,0.537500,0.050000,0.050000},
-{0.037500,0.537500,0.100000,0.100000},
-{0.062500,0.537500,0.050000,0.050000},
-{0.062500,0.537500,0.100000,0.100000},
-{0.087500,0.537500,0.050000,0.050000},
-{0.087500,0.537500,0.100000,0.100000},
-{0.112500,0.537500,0.050000,0.050000},
-{0.112500,0.537500,0.100000,0.100000},
-{0.137500,0.537500,0.050000,0.050000},
-{0.137500,0.537500,0.100000,0.100000},
-{0.162500,0.537500,0.050000,0.050000},
-{0.162500,0.537500,0.100000,0.100000},
-{0.187500,0.537500,0.050000,0.050000},
-{0.187500,0.537500,0.100000,0.100000},
-{0.212500,0.537500,0.050000,0.050000},
-{0.212500,0.537500,0.100000,0.100000},
-{0.237500,0.537500,0.050000,0.050000},
-{0.237500,0.537500,0.100000,0.100000},
-{0.262500,0.537500,0.050000,0.050000},
-{0.262500,0.537500,0.100000,0.100000},
-{0.287500,0.537500,0.050000,0.050000},
-{0.287500,0.537500,0.100000,0.100000},
-{0.312500,0.537500,0.050000,0.050000},
-{0.312500,0.537500,0.100000,0.100000},
-{0.337500,0.537500,0.050000,0.050000},
-{0.337500,0.537500,0.100000,0.100000},
-{0.362500,0.537500,0.050000,0.050000},
-{0.362500,0.537500,0.100000,0.100000},
-{0.387500,0.537500,0.050000,0.050000},
-{0.387500,0.537500,0.100000,0.100000},
-{0.412500,0.537500,0.050000,0.050000},
-{0.412500,0.537500,0.100000,0.100000},
-{0.437500,0.537500,0.050000,0.050000},
-{0.437500,0.537500,0.100000,0.100000},
-{0.462500,0.537500,0.050000,0.050000},
-{0.462500,0.537500,0.100000,0.100000},
-{0.487500,0.537500,0.050000,0.050000},
-{0.487500,0.537500,0.100000,0.100000},
-{0.512500,0.537500,0.050000,0.050000},
-{0.512500,0.537500,0.100000,0.100000},
-{0.537500,0.537500,0.050000,0.050000},
-{0.537500,0.537500,0.100000,0.100000},
-{0.562500,0.537500,0.050000,0.050000},
-{0.562500,0.537500,0.100000,0.100000},
-{0.587500,0.537500,0.050000,0.050000},
-{0.587500,0.537500,0.100000,0.100000},
-{0.612500,0.537500,0.050000,0.050000},
-{0.612500,0.537500,0.100000,0.100000},
-{0.637500,0.537500,0.050000,0.050000},
-{0.637500,0.537500,0.100000,0.100000},
-{0.662500,0.537500,0.050000,0.050000},
-{0.662500,0.537500,0.100000,0.100000},
-{0.687500,0.537500,0.050000,0.050000},
-{0.687500,0.537500,0.100000,0.100000},
-{0.712500,0.537500,0.050000,0.050000},
-{0.712500,0.537500,0.100000,0.100000},
-{0.737500,0.537500,0.050000,0.050000},
-{0.737500,0.537500,0.100000,0.100000},
-{0.762500,0.537500,0.050000,0.050000},
-{0.762500,0.537500,0.100000,0.100000},
-{0.787500,0.537500,0.050000,0.050000},
-{0.787500,0.537500,0.100000,0.100000},
-{0.812500,0.537500,0.050000,0.050000},
-{0.812500,0.537500,0.100000,0.100000},
-{0.837500,0.537500,0.050000,0.050000},
-{0.837500,0.537500,0.100000,0.100000},
-{0.862500,0.537500,0.050000,0.050000},
-{0.862500,0.537500,0.100000,0.100000},
-{0.887500,0.537500,0.050000,0.050000},
-{0.887500,0.537500,0.100000,0.100000},
-{0.912500,0.537500,0.050000,0.050000},
-{0.912500,0.537500,0.100000,0.100000},
-{0.937500,0.537500,0.050000,0.050000},
-{0.937500,0.537500,0.100000,0.100000},
-{0.962500,0.537500,0.050000,0.050000},
-{0.962500,0.537500,0.100000,0.100000},
-{0.987500,0.537500,0.050000,0.050000},
-{0.987500,0.537500,0.100000,0.100000},
-{0.012500,0.562500,0.050000,0.050000},
-{0.012500,0.562500,0.100000,0.100000},
-{0.037500,0.562500,0.050000,0.050000},
-{0.037500,0.562500,0.100000,0.100000},
-{0.062500,0.562500,0.050000,0.050000},
-{0.062500,0.562500,0.100000,0.100000},
-{0.087500,0.562500,0.050000,0.050000},
-{0.087500,0.562500,0.100000,0.100000},
-{0.112500,0.562500,0.050000,0.050000},
-{0.112500,0.562500,0.100000,0.100000},
-{0.137500,0.562500,0.050000,0.050000},
-{0.137500,0.562500,0.100000,0.100000},
-{0.162500,0.562500,0.050000,0.050000},
-{0.162500,0.562500,0.100000,0.100000},
-{0.187500,0.562500,0.050000,0.050000},
-{0.187500,0.562500,0.100000,0.100000},
-{0.212500,0.562500,0.050000,0.050000},
-{0.212500,0.562500,0.100000,0.100000},
-{0.237500,0.562500,0.050000,0.050000},
-{0.237500,0.562500,0.100000,0.100000},
-{0.262500,0.562500,0.050000,0.050000},
-{0.262500,0.562500,0.100000,0.100000},
-{0.287500,0.562500,0.050000,0.050000},
-{0.287500,0.562500,0.100000,0.100000},
-{0.312500,0.562500,0.050000,0.050000},
-{0.312500,0.562500,0.100000,0.100000},
-{0.337500,0.562500,0.050000,0.050000},
-{0.337500,0.562500,0.100000,0.100000},
-{0.362500,0.562500,0.050000,0.050000},
-{0.362500,0.562500,0.100000,0.100000},
-{0.387500,0.562500,0.050000,0.050000},
-{0.387500,0.562500,0.100000,0.100000},
-{0.412500,0.562500,0.050000,0.050000},
-{0.412500,0.562500,0.100000,0.100000},
-{0.437500,0.562500,0.050000,0.050000},
-{0.437500,0.562500,0.100000,0.100000},
-{0.462500,0.562500,0.050000,0.050000},
-{0.462500,0.562500,0.100000,0.100000},
-{0.487500,0.562500,0.050000,0.050000},
-{0.487500,0.562500,0.100000,0.100000},
-{0.512500,0.562500,0.050000,0.050000},
-{0.512500,0.562500,0.100000,0.100000},
-{0.537500,0.562500,0.050000,0.050000},
-{0.537500,0.562500,0.100000,0.100000},
-{0.562500,0.562500,0.050000,0.050000},
-{0.562500,0.562500,0.100000,0.100000},
-{0.587500,0.562500,0.050000,0.050000},
-{0.587500,0.562500,0.100000,0.100000},
-{0.612500,0.562500,0.050000,0.050000},
-{0.612500,0.562500,0.100000,0.100000},
-{0.637500,0.562500,0.050000,0.050000},
-{0.637500,0.562500,0.100000,0.100000},
-{0.662500,0.562500,0.050000,0.050000},
-{0.662500,0.562500,0.100000,0.100000},
-{0.687500,0.562500,0.050000,0.050000},
-{0.687500,0.562500,0.100000,0.100000},
-{0.712500,0.562500,0.050000,0.050000},
-{0.712500,0.562500,0.100000,0.100000},
-{0.737500,0.562500,0.050000,0.050000},
-{0.737500,0.562500,0.100000,0.100000},
-{0.762500,0.562500,0.050000,0.050000},
-{0.762500,0.562500,0.100000,0.100000},
-{0.787500,0.562500,0.050000,0.050000},
-{0.787500,0.562500,0.100000,0.100000},
-{0.812500,0.562500,0.050000,0.050000},
-{0.812500,0.562500,0.100000,0.100000},
-{0.837500,0.562500,0.050000,0.050000},
-{0.837500,0.562500,0.100000,0.100000},
-{0.862500,0.562500,0.050000,0.050000},
-{0.862500,0.562500,0.100000,0.100000},
-{0.887500,0.562500,0.050000,0.050000},
-{0.887500,0.562500,0.100000,0.100000},
-{0.912500,0.562500,0.050000,0.050000},
-{0.912500,0.562500,0.100000,0.100000},
-{0.937500,0.562500,0.050000,0.050000},
-{0.937500,0.562500,0.100000,0.100000},
-{0.962500,0.562500,0.050000,0.050000},
-{0.962500,0.562500,0.100000,0.100000},
-{0.987500,0.562500,0.050000,0.050000},
-{0.987500,0.562500,0.100000,0.100000},
-{0.012500,0.587500,0.050000,0.050000},
-{0.012500,0.587500,0.100000,0.100000},
-{0.037500,0.587500,0.050000,0.050000},
-{0.037500,0.587500,0.100000,0.100000},
-{0.062500,0.587500,0.050000,0.050000},
-{0.062500,0.587500,0.100000,0.100000},
-{0.087500,0.587500,0.050000,0.050000},
-{0.087500,0.587500,0.100000,0.100000},
-{0.112500,0.587500,0.050000,0.050000},
-{0.112500,0.587500,0.100000,0.100000},
-{0.137500,0.587500,0.050000,0.050000},
-{0.137500,0.587500,0.100000,0.100000},
-{0.162500,0.587500,0.050000,0.050000},
-{0.162500,0.587500,0.100000,0.100000},
-{0.187500,0.587500,0.050000,0.050000},
-{0.187500,0.587500,0.100000,0.100000},
-{0.212500,0.587500,0.050000,0.050000},
-{0.212500,0.587500,0.100000,0.100000},
-{0.237500,0.587500,0.050000,0.050000},
-{0.237500,0.587500,0.100000,0.100000},
-{0.262500,0.587500,0.050000,0.050000},
-{0.262500,0.587500,0.100000,0.100000},
-{0.287500,0.587500,0.050000,0.050000},
-{0.287500,0.587500,0.100000,0.100000},
-{0.312500,0.587500,0.050000,0.050000},
-{0.312500,0.587500,0.100000,0.100000},
-{0.337500,0.587500,0.050000,0.050000},
-{0.337500,0.587500,0.100000,0.100000},
-{0.362500,0.587500,0.050000,0.050000},
-{0.362500,0.587500,0.100000,0.100000},
-{0.387500,0.587500,0.050000,0.050000},
-{0.387500,0.587500,0.100000,0.100000},
-{0.412500,0.587500,0.050000,0.050000},
-{0.412500,0.587500,0.100000,0.100000},
-{0.437500,0.587500,0.050000,0.050000},
-{0.437500,0.587500,0.100000,0.100000},
-{0.462500,0.587500,0.050000,0.050000},
-{0.462500,0.587500,0.100000,0.100000},
-{0.487500,0.587500,0.050000,0.050000},
-{0.487500,0.587500,0.100000,0.100000},
-{0.512500,0.587500,0.050000,0.050000},
-{0.512500,0.587500,0.100000,0.100000},
-{0.537500,0.587500,0.050000,0.050000},
-{0.537500,0.587500,0.100000,0.100000},
-{0.562500,0.587500,0.050000,0.050000},
-{0.562500,0.587500,0.100000,0.100000},
-{0.587500,0.587500,0.050000,0.050000},
-{0.587500,0.587500,0.100000,0.100000},
-{0.612500,0.587500,0.050000,0.050000},
-{0.612500,0.587500,0.100000,0.100000},
-{0.637500,0.587500,0.050000,0.050000},
-{0.637500,0.587500,0.100000,0.100000},
-{0.662500,0.587500,0.050000,0.050000},
-{0.662500,0.587500,0.100000,0.100000},
-{0.687500,0.587500,0.050000,0.050000},
-{0.687500,0.587500,0.100000,0.100000},
-{0.712500,0.587500,0.050000,0.050000},
-{0.712500,0.587500,0.100000,0.100000},
-{0.737500,0.587500,0.050000,0.050000},
-{0.737500,0.587500,0.100000,0.100000},
-{0.762500,0.587500,0.050000,0.050000},
-{0.762500,0.587500,0.100000,0.100000},
-{0.787500,0.587500,0.050000,0.050000},
-{0.787500,0.587500,0.100000,0.100000},
-{0.812500,0.587500,0.050000,0.050000},
-{0.812500,0.587500,0.100000,0.100000},
-{0.837500,0.587500,0.050000,0.050000},
-{0.837500,0.587500,0.100000,0.100000},
-{0.862500,0.587500,0.050000,0.050000},
-{0.862500,0.587500,0.100000,0.100000},
-{0.887500,0.587500,0.050000,0.050000},
-{0.887500,0.587500,0.100000,0.100000},
-{0.912500,0.587500,0.050000,0.050000},
-{0.912500,0.587500,0.100000,0.100000},
-{0.937500,0.587500,0.050000,0.050000},
-{0.937500,0.587500,0.100000,0.100000},
-{0.962500,0.587500,0.050000,0.050000},
-{0.962500,0.587500,0.100000,0.100000},
-{0.987500,0.587500,0.050000,0.050000},
-{0.987500,0.587500,0.100000,0.100000},
-{0.012500,0.612500,0.050000,0.050000},
-{0.012500,0.612500,0.100000,0.100000},
-{0.037500,0.612500,0.050000,0.050000},
-{0.037500,0.612500,0.100000,0.100000},
-{0.062500,0.612500,0.050000,0.050000},
-{0.062500,0.612500,0.100000,0.100000},
-{0.087500,0.612500,0.050000,0.050000},
-{0.087500,0.612500,0.100000,0.100000},
-{0.112500,0.612500,0.050000,0.050000},
-{0.112500,0.612500,0.100000,0.100000},
-{0.137500,0.612500,0.050000,0.050000},
-{0.137500,0.612500,0.100000,0.100000},
-{0.162500,0.612500,0.050000,0.050000},
-{0.162500,0.612500,0.100000,0.100000},
-{0.187500,0.612500,0.050000,0.050000},
-{0.187500,0.612500,0.100000,0.100000},
-{0.212500,0.612500,0.050000,0.050000},
-{0.212500,0.612500,0.100000,0.100000},
-{0.237500,0.612500,0.050000,0.050000},
-{0.237500,0.612500,0.100000,0.100000},
-{0.262500,0.612500,0.050000,0.050000},
-{0.262500,0.612500,0.100000,0.100000},
-{0.287500,0.612500,0.050000,0.050000},
-{0.287500,0.612500,0.100000,0.100000},
-{0.312500,0.612500,0.050000,0.050000},
-{0.312500,0.612500,0.100000,0.100000},
-{0.337500,0.612500,0.050000,0.050000},
-{0.337500,0.612500,0.100000,0.100000},
-{0.362500,0.612500,0.050000,0.050000},
-{0.362500,0.612500,0.100000,0.100000},
-{0.387500,0.612500,0.050000,0.050000},
-{0.387500,0.612500,0.100000,0.100000},
-{0.412500,0.612500,0.050000,0.050000},
-{0.412500,0.612500,0.100000,0.100000},
-{0.437500,0.612500,0.050000,0.050000},
-{0.437500,0.612500,0.100000,0.100000},
-{0.462500,0.612500,0.050000,0.050000},
-{0.462500,0.612500,0.100000,0.100000},
-{0.487500,0.612500,0.050000,0.050000},
-{0.487500,0.612500,0.100000,0.100000},
-{0.512500,0.612500,0.050000,0.050000},
-{0.512500,0.612500,0.100000,0.100000},
-{0.537500,0.612500,0.050000,0.050000},
-{0.537500,0.612500,0.100000,0.100000},
-{0.562500,0.612500,0.050000,0.050000},
-{0.562500,0.612500,0.100000,0.100000},
-{0.587500,0.612500,0.050000,0.050000},
-{0.587500,0.612500,0.100000,0.100000},
-{0.612500,0.612500,0.050000,0.050000},
-{0.612500,0.612500,0.100000,0.100000},
-{0.637500,0.612500,0.050000,0.050000},
-{0.637500,0.612500,0.100000,0.100000},
-{0.662500,0.612500,0.050000,0.050000},
-{0.662500,0.612500,0.100000,0.100000},
-{0.687500,0.612500,0.050000,0.050000},
-{0.687500,0.612500,0.100000,0.100000},
-{0.712500,0.612500,0.050000,0.050000},
-{0.712500,0.612500,0.100000,0.100000},
-{0.737500,0.612500,0.050000,0.050000},
-{0.737500,0.612500,0.100000,0.100000},
-{0.762500,0.612500,0.050000,0.050000},
-{0.762500,0.612500,0.100000,0.100000},
-{0.787500,0.612500,0.050000,0.050000},
-{0.787500,0.612500,0.100000,0.100000},
-{0.812500,0.612500,0.050000,0.050000},
-{0.812500,0.612500,0.100000,0.100000},
-{0.837500,0.612500,0.050000,0.050000},
-{0.837500,0.612500,0.100000,0.100000},
-{0.862500,0.612500,0.050000,0.050000},
-{0.862500,0.612500,0.100000,0.100000},
-{0.887500,0.612500,0.050000,0.050000},
-{0.887500,0.612500,0.100000,0.100000},
-{0.912500,0.612500,0.050000,0.050000},
-{0.912500,0.612500,0.100000,0.100000},
-{0.937500,0.612500,0.050000,0.050000},
-{0.937500,0.612500,0.100000,0.100000},
-{0.962500,0.612500,0.050000,0.050000},
-{0.962500,0.612500,0.100000,0.100000},
-{0.987500,0.612500,0.050000,0.050000},
-{0.987500,0.612500,0.100000,0.100000},
-{0.012500,0.637500,0.050000,0.050000},
-{0.012500,0.637500,0.100000,0.100000},
-{0.037500,0.637500,0.050000,0.050000},
-{0.037500,0.637500,0.100000,0.100000},
-{0.062500,0.637500,0.050000,0.050000},
-{0.062500,0.637500,0.100000,0.100000},
-{0.087500,0.637500,0.050000,0.050000},
-{0.087500,0.637500,0.100000,0.100000},
-{0.112500,0.637500,0.050000,0.050000},
-{0.112500,0.637500,0.100000,0.100000},
-{0.137500,0.637500,0.050000,0.050000},
-{0.137500,0.637500,0.100000,0.100000},
-{0.162500,0.637500,0.050000,0.050000},
-{0.162500,0.637500,0.100000,0.100000},
-{0.187500,0.637500,0.050000,0.050000},
-{0.187500,0.637500,0.100000,0.100000},
-{0.212500,0.637500,0.050000,0.050000},
-{0.212500,0.637500,0.100000,0.100000},
-{0.237500,0.637500,0.050000,0.050000},
-{0.237500,0.637500,0.100000,0.100000},
-{0.262500,0.637500,0.050000,0.050000},
-{0.262500,0.637500,0.100000,0.100000},
-{0.287500,0.637500,0.050000,0.050000},
-{0.287500,0.637500,0.100000,0.100000},
-{0.312500,0.637500,0.050000,0.050000},
-{0.312500,0.637500,0.100000,0.100000},
-{0.337500,0.637500,0.050000,0.050000},
-{0.337500,0.637500,0.100000,0.100000},
-{0.362500,0.637500,0.050000,0.050000},
-{0.362500,0.637500,0.100000,0.100000},
-{0.387500,0.637500,0.050000,0.050000},
-{0.387500,0.637500,0.100000,0.100000},
-{0.412500,0.637500,0.050000,0.050000},
-{0.412500,0.637500,0.100000,0.100000},
-{0.437500,0.637500,0.050000,0.050000},
-{0.437500,0.637500,0.100000,0.100000},
-{0.462500,0.637500,0.050000,0.050000},
-{0.462500,0.637500,0.100000,0.100000},
-{0.487500,0.637500,0.050000,0.050000},
-{0.487500,0.637500,0.100000,0.100000},
-{0.512500,0.637500,0.050000,0.050000},
-{0.512500,0.637500,0.100000,0.100000},
-{0.537500,0.637500,0.050000,0.050000},
-{0.537500,0.637500,0.100000,0.100000},
-{0.562500,0.637500,0.050000,0.050000},
-{0.562500,0.637500,0.100000,0.100000},
-{0.587500,0.637500,0.050000,0.050000},
-{0.587500,0.637500,0.100000,0.100000},
-{0.612500,0.637500,0.050000,0.050000},
-{0.612500,0.637500,0.100000,0.100000},
-{0.637500,0.637500,0.050000,0.050000},
-{0.637500,0.637500,0.100000,0.100000},
-{0.662500,0.637500,0.050000,0.050000},
-{0.662500,0.637500,0.100000,0.100000},
-{0.687500,0.637500,0.050000,0.050000},
-{0.687500,0.637500,0.100000,0.100000},
-{0.712500,0.637500,0.050000,0.050000},
-{0.712500,0.637500,0.100000,0.100000},
-{0.737500,0.637500,0.050000,0.050000},
-{0.737500,0.637500,0.100000,0.100000},
-{0.762500,0.637500,0.050000,0.050000},
-{0.762500,0.637500,0.100000,0.100000},
-{0.787500,0.637500,0.050000,0.050000},
-{0.787500,0.637500,0.100000,0.100000},
-{0.812500,0.637500,0.050000,0.050000},
-{0.812500,0.637500,0.100000,0.100000},
-{0.837500,0.637500,0.050000,0.050000},
-{0.837500,0.637500,0.100000,0.100000},
-{0.862500,0.637500,0.050000,0.050000},
-{0.862500,0.637500,0.100000,0.100000},
-{0.887500,0.637500,0.050000,0.050000},
-{0.887500,0.637500,0.100000,0.100000},
-{0.912500,0.637500,0.050000,0.050000},
-{0.912500,0.637500,0.100000,0.100000},
-{0.937500,0.637500,0.050000,0.050000},
-{0.937500,0.637500,0.100000,0.100000},
-{0.962500,0.637500,0.050000,0.050000},
-{0.962500,0.637500,0.100000,0.100000},
-{0.987500,0.637500,0.050000,0.050000},
-{0.987500,0.637500,0.100000,0.100000},
-{0.012500,0.662500,0.050000,0.050000},
-{0.012500,0.662500,0.100000,0.100000},
-{0.037500,0.662500,0.050000,0.050000},
-{0.037500,0.662500,0.100000,0.100000},
-{0.062500,0.662500,0.050000,0.050000},
-{0.062500,0.662500,0.100000,0.100000},
-{0.087500,0.662500,0.050000,0.050000},
-{0.087500,0.662500,0.100000,0.100000},
-{0.112500,0.662500,0.050000,0.050000},
-{0.112500,0.662500,0.100000,0.100000},
-{0.137500,0.662500,0.050000,0.050000},
-{0.137500,0.662500,0.100000,0.100000},
-{0.162500,0.662500,0.050000,0.050000},
-{0.162500,0.662500,0.100000,0.100000},
-{0.187500,0.662500,0.050000,0.050000},
-{0.187500,0.662500,0.100000,0.100000},
-{0.212500,0.662500,0.050000,0.050000},
-{0.212500,0.662500,0.100000,0.100000},
-{0.237500,0.662500,0.050000,0.050000},
-{0.237500,0.662500,0.100000,0.100000},
-{0.262500,0.662500,0.050000,0.050000},
-{0.262500,0.662500,0.100000,0.100000},
-{0.287500,0.662500,0.050000,0.050000},
-{0.287500,0.662500,0.100000,0.100000},
-{0.312500,0.662500,0.050000,0.050000},
-{0.312500,0.662500,0.100000,0.100000},
-{0.337500,0.662500,0.050000,0.050000},
-{0.337500,0.662500,0.100000,0.100000},
-{0.362500,0.662500,0.050000,0.050000},
-{0.362500,0.662500,0.100000,0.100000},
-{0.387500,0.662500,0.050000,0.050000},
-{0.387500,0.662500,0.100000,0.100000},
-{0.412500,0.662500,0.050000,0.050000},
-{0.412500,0.662500,0.100000,0.100000},
-{0.437500,0.662500,0.050000,0.050000},
-{0.437500,0.662500,0.100000,0.100000},
-{0.462500,0.662500,0.050000,0.050000},
-{0.462500,0.662500,0.100000,0.100000},
-{0.487500,0.662500,0.050000,0.050000},
-{0.487500,0.662500,0.100000,0.100000},
-{0.512500,0.662500,0.050000,0.050000},
-{0.512500,0.662500,0.100000,0.100000},
-{0.537500,0.662500,0.050000,0.050000},
-{0.537500,0.662500,0.100000,0.100000},
-{0.562500,0.662500,0.050000,0.050000},
-{0.562500,0.662500,0.100000,0.100000},
-{0.587500,0.662500,0.050000,0.050000},
-{0.587500,0.662500,0.100000,0.100000},
-{0.612500,0.662500,0.050000,0.050000},
-{0.612500,0.662500,0.100000,0.100000},
-{0.637500,0.662500,0.050000,0.050000},
-{0.637500,0.662500,0.100000,0.100000},
-{0.662500,0.662500,0.050000,0.050000},
-{0.662500,0.662500,0.100000,0.100000},
-{0.687500,0.662500,0.050000,0.050000},
-{0.687500,0.662500,0.100000,0.100000},
-{0.712500,0.662500,0.050000,0.050000},
-{0.712500,0.662500,0.100000,0.100000},
-{0.737500,0.662500,0.050000,0.050000},
-{0.737500,0.662500,0.100000,0.100000},
-{0.762500,0.662500,0.050000,0.050000},
-{0.762500,0.662500,0.100000,0.100000},
-{0.787500,0.662500,0.050000,0.050000},
-{0.787500,0.662500,0.100000,0.100000},
-{0.812500,0.662500,0.050000,0.050000},
-{0.812500,0.662500,0.100000,0.100000},
-{0.837500,0.662500,0.050000,0.050000},
-{0.837500,0.662500,0.100000,0.100000},
-{0.862500,0.662500,0.050000,0.050000},
-{0.862500,0.662500,0.100000,0.100000},
-{0.887500,0.662500,0.050000,0.050000},
-{0.887500,0.662500,0.100000,0.100000},
-{0.912500,0.662500,0.050000,0.050000},
-{0.912500,0.662500,0.100000,0.100000},
-{0.937500,0.662500,0.050000,0.050000},
-{0.937500,0.662500,0.100000,0.100000},
-{0.962500,0.662500,0.050000,0.050000},
-{0.962500,0.662500,0.100000,0.100000},
-{0.987500,0.662500,0.050000,0.050000},
-{0.987500,0.662500,0.100000,0.100000},
-{0.012500,0.687500,0.050000,0.050000},
-{0.012500,0.687500,0.100000,0.100000},
-{0.037500,0.687500,0.050000,0.050000},
-{0.037500,0.687500,0.100000,0.100000},
-{0.062500,0.687500,0.050000,0.050000},
-{0.062500,0.687500,0.100000,0.100000},
-{0.087500,0.687500,0.050000,0.050000},
-{0.087500,0.687500,0.100000,0.100000},
-{0.112500,0.687500,0.050000,0.050000},
-{0.112500,0.687500,0.100000,0.100000},
-{0.137500,0.687500,0.050000,0.050000},
-{0.137500,0.687500,0.100000,0.100000},
-{0.162500,0.687500,0.050000,0.050000},
-{0.162500,0.687500,0.100000,0.100000},
-{0.187500,0.687500,0.050000,0.050000},
-{0.187500,0.687500,0.100000,0.100000},
-{0.212500,0.687500,0.050000,0.050000},
-{0.212500,0.687500,0.100000,0.100000},
-{0.237500,0.687500,0.050000,0.050000},
-{0.237500,0.687500,0.100000,0.100000},
-{0.262500,0.687500,0.050000,0.050000},
-{0.262500,0.687500,0.100000,0.100000},
-{0.287500,0.687500,0.050000,0.050000},
-{0.287500,0.687500,0.100000,0.100000},
-{0.312500,0.687500,0.050000,0.050000},
-{0.312500,0.687500,0.100000,0.100000},
-{0.337500,0.687500,0.050000,0.050000},
-{0.337500,0.687500,0.100000,0.100000},
-{0.362500,0.687500,0.050000,0.050000},
-{0.362500,0.687500,0.100000,0.100000},
-{0.387500,0.687500,0.050000,0.050000},
-{0.387500,0.687500,0.100000,0.100000},
-{0.412500,0.687500,0.050000,0.050000},
-{0.412500,0.687500,0.100000,0.100000},
-{0.437500,0.687500,0.050000,0.050000},
-{0.437500,0.687500,0.100000,0.100000},
-{0.462500,0.687500,0.050000,0.050000},
-{0.462500,0.687500,0.100000,0.100000},
-{0.487500,0.687500,0.050000,0.050000},
-{0.487500,0.687500,0.100000,0.100000},
-{0.512500,0.687500,0.050000,0.050000},
-{0.512500,0.687500,0.100000,0.100000},
-{0.537500,0.687500,0.050000,0.050000},
-{0.537500,0.687500,0.100000,0.100000},
-{0.562500,0.687500,0.050000,0.050000},
-{0.562500,0.687500,0.100000,0.100000},
-{0.587500,0.687500,0.050000,0.050000},
-{0.587500,0.687500,0.100000,0.100000},
-{0.612500,0.687500,0.050000,0.050000},
-{0.612500,0.687500,0.100000,0.100000},
-{0.637500,0.687500,0.050000,0.050000},
-{0.637500,0.687500,0.100000,0.100000},
-{0.662500,0.687500,0.050000,0.050000},
-{0.662500,0.687500,0.100000,0.100000},
-{0.687500,0.687500,0.050000,0.050000},
-{0.687500,0.687500,0.100000,0.100000},
-{0.712500,0.687500,0.050000,0.050000},
-{0.712500,0.687500,0.100000,0.100000},
-{0.737500,0.687500,0.050000,0.050000},
-{0.737500,0.687500,0.100000,0.100000},
-{0.762500,0.687500,0.050000,0.050000},
-{0.762500,0.687500,0.100000,0.100000},
-{0.787500,0.687500,0.050000,0.050000},
-{0.787500,0.687500,0.100000,0.100000},
-{0.812500,0.687500,0.050000,0.050000},
-{0.812500,0.687500,0.100000,0.100000},
-{0.837500,0.687500,0.050000,0.050000},
-{0.837500,0.687500,0.100000,0.100000},
-{0.862500,0.687500,0.050000,0.050000},
-{0.862500,0.687500,0.100000,0.100000},
-{0.887500,0.687500,0.050000,0.050000},
-{0.887500,0.687500,0.100000,0.100000},
-{0.912500,0.687500,0.050000,0.050000},
-{0.912500,0.687500,0.100000,0.100000},
-{0.937500,0.687500,0.050000,0.050000},
-{0.937500,0.687500,0.100000,0.100000},
-{0.962500,0.687500,0.050000,0.050000},
-{0.962500,0.687500,0.100000,0.100000},
-{0.987500,0.687500,0.050000,0.050000},
-{0.987500,0.687500,0.100000,0.100000},
-{0.012500,0.712500,0.050000,0.050000},
-{0.012500,0.712500,0.100000,0.100000},
-{0.037500,0.712500,0.050000,0.050000},
-{0.037500,0.712500,0.100000,0.100000},
-{0.062500,0.712500,0.050000,0.050000},
-{0.062500,0.712500,0.100000,0.100000},
-{0.087500,0.712500,0.050000,0.050000},
-{0.087500,0.712500,0.100000,0.100000},
-{0.112500,0.712500,0.050000,0.050000},
-{0.112500,0.712500,0.100000,0.100000},
-{0.137500,0.712500,0.050000,0.050000},
-{0.137500,0.712500,0.100000,0.100000},
-{0.162500,0.712500,0.050000,0.050000},
-{0.162500,0.712500,0.100000,0.100000},
-{0.187500,0.712500,0.050000,0.050000},
-{0.187500,0.712500,0.100000,0.100000},
-{0.212500,0.712500,0.050000,0.050000},
-{0.212500,0.712500,0.100000,0.100000},
-{0.237500,0.712500,0.050000,0.050000},
-{0.237500,0.712500,0.100000,0.100000},
-{0.262500,0.712500,0.050000,0.050000},
-{0.262500,0.712500,0.100000,0.100000},
-{0.287500,0.712500,0.050000,0.050000},
-{0.287500,0.712500,0.100000,0.100000},
-{0.312500,0.712500,0.050000,0.050000},
-{0.312500,0.712500,0.100000,0.100000},
-{0.337500,0.712500,0.050000,0.050000},
-{0.337500,0.712500,0.100000,0.100000},
-{0.362500,0.712500,0.050000,0.050000},
-{0.362500,0.712500,0.100000,0.100000},
-{0.387500,0.712500,0.050000,0.050000},
-{0.387500,0.712500,0.100000,0.100000},
-{0.412500,0.712500,0.050000,0.050000},
-{0.412500,0.712500,0.100000,0.100000},
-{0.437500,0.712500,0.050000,0.050000},
-{0.437500,0.712500,0.100000,0.100000},
-{0.462500,0.712500,0.050000,0.050000},
-{0.462500,0.712500,0.100000,0.100000},
-{0.487500,0.712500,0.050000,0.050000},
-{0.487500,0.712500,0.100000,0.100000},
-{0.512500,0.712500,0.050000,0.050000},
-{0.512500,0.712500,0.100000,0.100000},
-{0.537500,0.712500,0.050000,0.050000},
-{0.537500,0.712500,0.100000,0.100000},
-{0.562500,0.712500,0.050000,0.050000},
-{0.562500,0.712500,0.100000,0.100000},
-{0.587500,0.712500,0.050000,0.050000},
-{0.587500,0.712500,0.100000,0.100000},
-{0.612500,0.712500,0.050000,0.050000},
-{0.612500,0.712500,0.100000,0.100000},
-{0.637500,0.712500,0.050000,0.050000},
-{0.637500,0.712500,0.100000,0.100000},
-{0.662500,0.712500,0.050000,0.050000},
-{0.662500,0.712500,0.100000,0.100000},
-{0.687500,0.712500,0.050000,0.050000},
-{0.687500,0.712500,0.100000,0.100000},
-{0.712500,0.712500,0.050000,0.050000},
-{0.712500,0.712500,0.100000,0.100000},
-{0.737500,0.712500,0.050000,0.050000},
-{0.737500,0.712500,0.100000,0.100000},
-{0.762500,0.712500,0.050000,0.050000},
-{0.762500,0.712500,0.100000,0.100000},
-{0.787500,0.712500,0.050000,0.050000},
-{0.787500,0.712500,0.100000,0.100000},
-{0.812500,0.712500,0.050000,0.050000},
-{0.812500,0.712500,0.100000,0.100000},
-{0.837500,0.712500,0.050000,0.050000},
-{0.837500,0.712500,0.100000,0.100000},
-{0.862500,0.712500,0.050000,0.050000},
-{0.862500,0.712500,0.100000,0.100000},
-{0.887500,0.712500,0.050000,0.050000},
-{0.887500,0.712500,0.100000,0.100000},
-{0.912500,0.712500,0.050000,0.050000},
-{0.912500,0.712500,0.100000,0.100000},
-{0.937500,0.712500,0.050000,0.050000},
-{0.937500,0.712500,0.100000,0.100000},
-{0.962500,0.712500,0.050000,0.050000},
-{0.962500,0.712500,0.100000,0.100000},
-{0.987500,0.712500,0.050000,0.050000},
-{0.987500,0.712500,0.100000,0.100000},
-{0.012500,0.737500,0.050000,0.050000},
-{0.012500,0.737500,0.100000,0.100000},
-{0.037500,0.737500,0.050000,0.050000},
-{0.037500,0.737500,0.100000,0.100000},
-{0.062500,0.737500,0.050000,0.050000},
-{0.062500,0.737500,0.100000,0.100000},
-{0.087500,0.737500,0.050000,0.050000},
-{0.087500,0.737500,0.100000,0.100000},
-{0.112500,0.737500,0.050000,0.050000},
-{0.112500,0.737500,0.100000,0.100000},
-{0.137500,0.737500,0.050000,0.050000},
-{0.137500,0.737500,0.100000,0.100000},
-{0.162500,0.737500,0.050000,0.050000},
-{0.162500,0.737500,0.100000,0.100000},
-{0.187500,0.737500,0.050000,0.050000},
-{0.187500,0.737500,0.100000,0.100000},
-{0.212500,0.737500,0.050000,0.050000},
-{0.212500,0.737500,0.100000,0.100000},
-{0.237500,0.737500,0.050000,0.050000},
-{0.237500,0.737500,0.100000,0.100000},
-{0.262500,0.737500,0.050000,0.050000},
-{0.262500,0.737500,0.100000,0.100000},
-{0.287500,0.737500,0.050000,0.050000},
-{0.287500,0.737500,0.100000,0.100000},
-{0.312500,0.737500,0.050000,0.050000},
-{0.312500,0.737500,0.100000,0.100000},
-{0.337500,0.737500,0.050000,0.050000},
-{0.337500,0.737500,0.100000,0.100000},
-{0.362500,0.737500,0.050000,0.050000},
-{0.362500,0.737500,0.100000,0.100000},
-{0.387500,0.737500,0.050000,0.050000},
-{0.387500,0.737500,0.100000,0.100000},
-{0.412500,0.737500,0.050000,0.050000},
-{0.412500,0.737500,0.100000,0.100000},
-{0.437500,0.737500,0.050000,0.050000},
-{0.437500,0.737500,0.100000,0.100000},
-{0.462500,0.737500,0.050000,0.050000},
-{0.462500,0.737500,0.100000,0.100000},
-{0.487500,0.737500,0.050000,0.050000},
-{0.487500,0.737500,0.100000,0.100000},
-{0.512500,0.737500,0.050000,0.050000},
-{0.512500,0.737500,0.100000,0.100000},
-{0.537500,0.737500,0.050000,0.050000},
-{0.537500,0.737500,0.100000,0.100000},
-{0.562500,0.737500,0.050000,0.050000},
-{0.562500,0.737500,0.100000,0.100000},
-{0.587500,0.737500,0.050000,0.050000},
-{0.587500,0.737500,0.100000,0.100000},
-{0.612500,0.737500,0.050000,0.050000},
-{0.612500,0.737500,0.100000,0.100000},
-{0.637500,0.737500,0.050000,0.050000},
-{0.637500,0.737500,0.100000,0.100000},
-{0.662500,0.737500,0.050000,0.050000},
-{0.662500,0.737500,0.100000,0.100000},
-{0.687500,0.737500,0.050000,0.050000},
-{0.687500,0.737500,0.100000,0.100000},
-{0.712500,0.737500,0.050000,0.050000},
-{0.712500,0.737500,0.100000,0.100000},
-{0.737500,0.737500,0.050000,0.050000},
-{0.737500,0.737500,0.100000,0.100000},
-{0.762500,0.737500,0.050000,0.050000},
-{0.762500,0.737500,0.100000,0.100000},
-{0.787500,0.737500,0.050000,0.050000},
-{0.787500,0.737500,0.100000,0.100000},
-{0.812500,0.737500,0.050000,0.050000},
-{0.812500,0.737500,0.100000,0.100000},
-{0.837500,0.737500,0.050000,0.050000},
-{0.837500,0.737500,0.100000,0.100000},
-{0.862500,0.737500,0.050000,0.050000},
-{0.862500,0.737500,0.100000,0.100000},
-{0.887500,0.737500,0.050000,0.050000},
-{0.887500,0.737500,0.100000,0.100000},
-{0.912500,0.737500,0.050000,0.050000},
-{0.912500,0.737500,0.100000,0.100000},
-{0.937500,0.737500,0.050000,0.050000},
-{0.937500,0.737500,0.100000,0.100000},
-{0.962500,0.737500,0.050000,0.050000},
-{0.962500,0.737500,0.100000,0.100000},
-{0.987500,0.737500,0.050000,0.050000},
-{0.987500,0.737500,0.100000,0.100000},
-{0.012500,0.762500,0.050000,0.050000},
-{0.012500,0.762500,0.100000,0.100000},
-{0.037500,0.762500,0.050000,0.050000},
-{0.037500,0.762500,0.100000,0.100000},
-{0.062500,0.762500,0.050000,0.050000},
-{0.062500,0.762500,0.100000,0.100000},
-{0.087500,0.762500,0.050000,0.050000},
-{0.087500,0.762500,0.100000,0.100000},
-{0.112500,0.762500,0.050000,0.050000},
-{0.112500,0.762500,0.100000,0.100000},
-{0.137500,0.762500,0.050000,0.050000},
-{0.137500,0.762500,0.100000,0.100000},
-{0.162500,0.762500,0.050000,0.050000},
-{0.162500,0.762500,0.100000,0.100000},
-{0.187500,0.762500,0.050000,0.050000},
-{0.187500,0.762500,0.100000,0.100000},
-{0.212500,0.762500,0.050000,0.050000},
-{0.212500,0.762500,0.100000,0.100000},
-{0.237500,0.762500,0.050000,0.050000},
-{0.237500,0.762500,0.100000,0.100000},
-{0.262500,0.762500,0.050000,0.050000},
-{0.262500,0.762500,0.100000,0.100000},
-{0.287500,0.762500,0.050000,0.050000},
-{0.287500,0.762500,0.100000,0.100000},
-{0.312500,0.762500,0.050000,0.050000},
-{0.312500,0.762500,0.100000,0.100000},
-{0.337500,0.762500,0.050000,0.050000},
-{0.337500,0.762500,0.100000,0.100000},
-{0.362500,0.762500,0.050000,0.050000},
-{0.362500,0.762500,0.100000,0.100000},
-{0.387500,0.762500,0.050000,0.050000},
-{0.387500,0.762500,0.100000,0.100000},
-{0.412500,0.762500,0.050000,0.050000},
-{0.412500,0.762500,0.100000,0.100000},
-{0.437500,0.762500,0.050000,0.050000},
-{0.437500,0.762500,0.100000,0.100000},
-{0.462500,0.762500,0.050000,0.050000},
-{0.462500,0.762500,0.100000,0.100000},
-{0.487500,0.762500,0.050000,0.050000},
-{0.487500,0.762500,0.100000,0.100000},
-{0.512500,0.762500,0.050000,0.050000},
-{0.512500,0.762500,0.100000,0.100000},
-{0.537500,0.762500,0.050000,0.050000},
-{0.537500,0.762500,0.100000,0.100000},
-{0.562500,0.762500,0.050000,0.050000},
-{0.562500,0.762500,0.100000,0.100000},
-{0.587500,0.762500,0.050000,0.050000},
-{0.587500,0.762500,0.100000,0.100000},
-{0.612500,0.762500,0.050000,0.050000},
-{0.612500,0.762500,0.100000,0.100000},
-{0.637500,0.762500,0.050000,0.050000},
-{0.637500,0.762500,0.100000,0.100000},
-{0.662500,0.762500,0.050000,0.050000},
-{0.662500,0.762500,0.100000,0.100000},
-{0.687500,0.762500,0.050000,0.050000},
-{0.687500,0.762500,0.100000,0.100000},
-{0.712500,0.762500,0.050000,0.050000},
-{0.712500,0.762500,0.100000,0.100000},
-{0.737500,0.762500,0.050000,0.050000},
-{0.737500,0.762500,0.100000,0.100000},
-{0.762500,0.762500,0.050000,0.050000},
-{0.762500,0.762500,0.100000,0.100000},
-{0.787500,0.762500,0.050000,0.050000},
-{0.787500,0.762500,0.100000,0.100000},
-{0.812500,0.762500,0.050000,0.050000},
-{0.812500,0.762500,0.100000,0.100000},
-{0.837500,0.762500,0.050000,0.050000},
-{0.837500,0.762500,0.100000,0.100000},
-{0.862500,0.762500,0.050000,0.050000},
-{0.862500,0.762500,0.100000,0.100000},
-{0.887500,0.762500,0.050000,0.050000},
-{0.887500,0.762500,0.100000,0.100000},
-{0.912500,0.762500,0.050000,0.050000},
-{0.912500,0.762500,0.100000,0.100000},
-{0.937500,0.762500,0.050000,0.050000},
-{0.937500,0.762500,0.100000,0.100000},
-{0.962500,0.762500,0.050000,0.050000},
-{0.962500,0.762500,0.100000,0.100000},
-{0.987500,0.762500,0.050000,0.050000},
-{0.987500,0.762500,0.100000,0.100000},
-{0.012500,0.787500,0.050000,0.050000},
-{0.012500,0.787500,0.100000,0.100000},
-{0.037500,0.787500,0.050000,0.050000},
-{0.037500,0.787500,0.100000,0.100000},
-{0.062500,0.787500,0.050000,0.050000},
-{0.062500,0.787500,0.100000,0.100000},
-{0.087500,0.787500,0.050000,0.050000},
-{0.087500,0.787500,0.100000,0.100000},
-{0.112500,0.787500,0.050000,0.050000},
-{0.112500,0.787500,0.100000,0.100000},
-{0.137500,0.787500,0.050000,0.050000},
-{0.137500,0.787500,0.100000,0.100000},
-{0.162500,0.787500,0.050000,0.050000},
-{0.162500,0.787500,0.100000,0.100000},
-{0.187500,0.787500,0.050000,0.050000},
-{0.187500,0.787500,0.100000,0.100000},
-{0.212500,0.787500,0.050000,0.050000},
-{0.212500,0.787500,0.100000,0.100000},
-{0.237500,0.787500,0.050000,0.050000},
-{0.237500,0.787500,0.100000,0.100000},
-{0.262500,0.787500,0.050000,0.050000},
-{0.262500,0.787500,0.100000,0.100000},
-{0.287500,0.787500,0.050000,0.050000},
-{0.287500,0.787500,0.100000,0.100000},
-{0.312500,0.787500,0.050000,0.050000},
-{0.312500,0.787500,0.100000,0.100000},
-{0.337500,0.787500,0.050000,0.050000},
-{0.337500,0.787500,0.100000,0.100000},
-{0.362500,0.787500,0.050000,0.050000},
-{0.362500,0.787500,0.100000,0.100000},
-{0.387500,0.787500,0.050000,0.050000},
-{0.387500,0.787500,0.100000,0.100000},
-{0.412500,0.787500,0.050000,0.050000},
-{0.412500,0.787500,0.100000,0.100000},
-{0.437500,0.787500,0.050000,0.050000},
-{0.437500,0.787500,0.100000,0.100000},
-{0.462500,0.787500,0.050000,0.050000},
-{0.462500,0.787500,0.100000,0.100000},
-{0.487500,0.787500,0.050000,0.050000},
-{0.487500,0.787500,0.100000,0.100000},
-{0.512500,0.787500,0.050000,0.050000},
-{0.512500,0.787500,0.100000,0.100000},
-{0.537500,0.787500,0.050000,0.050000},
-{0.537500,0.787500,0.100000,0.100000},
-{0.562500,0.787500,0.050000,0.050000},
-{0.562500,0.787500,0.100000,0.100000},
-{0.587500,0.787500,0.050000,0.050000},
-{0.587500,0.787500,0.100000,0.100000},
-{0.612500,0.787500,0.050000,0.050000},
-{0.612500,0.787500,0.100000,0.100000},
-{0.637500,0.787500,0.050000,0.050000},
-{0.637500,0.787500,0.100000,0.100000},
-{0.662500,0.787500,0.050000,0.050000},
-{0.662500,0.787500,0.100000,0.100000},
-{0.687500,0.787500,0.050000,0.050000},
-{0.687500,0.787500,0.100000,0.100000},
-{0.712500,0.787500,0.050000,0.050000},
-{0.712500,0.787500,0.100000,0.100000},
-{0.737500,0.787500,0.050000,0.050000},
-{0.737500,0.787500,0.100000,0.100000},
-{0.762500,0.787500,0.050000,0.050000},
-{0.762500,0.787500,0.100000,0.100000},
-{0.787500,0.787500,0.050000,0.050000},
-{0.787500,0.787500,0.100000,0.100000},
-{0.812500,0.787500,0.050000,0.050000},
-{0.812500,0.787500,0.100000,0.100000},
-{0.837500,0.787500,0.050000,0.050000},
-{0.837500,0.787500,0.100000,0.100000},
-{0.862500,0.787500,0.050000,0.050000},
-{0.862500,0.787500,0.100000,0.100000},
-{0.887500,0.787500,0.050000,0.050000},
-{0.887500,0.787500,0.100000,0.100000},
-{0.912500,0.787500,0.050000,0.050000},
-{0.912500,0.787500,0.100000,0.100000},
-{0.937500,0.787500,0.050000,0.050000},
-{0.937500,0.787500,0.100000,0.100000},
-{0.962500,0.787500,0.050000,0.050000},
-{0.962500,0.787500,0.100000,0.100000},
-{0.987500,0.787500,0.050000,0.050000},
-{0.987500,0.787500,0.100000,0.100000},
-{0.012500,0.812500,0.050000,0.050000},
-{0.012500,0.812500,0.100000,0.100000},
-{0.037500,0.812500,0.050000,0.050000},
-{0.037500,0.812500,0.100000,0.100000},
-{0.062500,0.812500,0.050000,0.050000},
-{0.062500,0.812500,0.100000,0.100000},
-{0.087500,0.812500,0.050000,0.050000},
-{0.087500,0.812500,0.100000,0.100000},
-{0.112500,0.812500,0.050000,0.050000},
-{0.112500,0.812500,0.100000,0.100000},
-{0.137500,0.812500,0.050000,0.050000},
-{0.137500,0.812500,0.100000,0.100000},
-{0.162500,0.812500,0.050000,0.050000},
-{0.162500,0.812500,0.100000,0.100000},
-{0.187500,0.812500,0.050000,0.050000},
-{0.187500,0.812500,0.100000,0.100000},
-{0.212500,0.812500,0.050000,0.050000},
-{0.212500,0.812500,0.100000,0.100000},
-{0.237500,0.812500,0.050000,0.050000},
-{0.237500,0.812500,0.100000,0.100000},
-{0.262500,0.812500,0.050000,0.050000},
-{0.262500,0.812500,0.100000,0.100000},
-{0.287500,0.812500,0.050000,0.050000},
-{0.287500,0.812500,0.100000,0.100000},
-{0.312500,0.812500,0.050000,0.050000},
-{0.312500,0.812500,0.100000,0.100000},
-{0.337500,0.812500,0.050000,0.050000},
-{0.337500,0.812500,0.100000,0.100000},
-{0.362500,0.812500,0.050000,0.050000},
-{0.362500,0.812500,0.100000,0.100000},
-{0.387500,0.812500,0.050000,0.050000},
-{0.387500,0.812500,0.100000,0.100000},
-{0.412500,0.812500,0.050000,0.050000},
-{0.412500,0.812500,0.100000,0.100000},
-{0.437500,0.812500,0.050000,0.050000},
-{0.437500,0.812500,0.100000,0.100000},
-{0.462500,0.812500,0.050000,0.050000},
-{0.462500,0.812500,0.100000,0.100000},
-{0.487500,0.812500,0.050000,0.050000},
-{0.487500,0.812500,0.100000,0.100000},
-{0.512500,0.812500,0.050000,0.050000},
-{0.512500,0.812500,0.100000,0.100000},
-{0.537500,0.812500,0.050000,0.050000},
-{0.537500,0.812500,0.100000,0.100000},
-{0.562500,0.812500,0.050000,0.050000},
-{0.562500,0.812500,0.100000,0.100000},
-{0.587500,0.812500,0.050000,0.050000},
-{0.587500,0.812500,0.100000,0.100000},
-{0.612500,0.812500,0.050000,0.050000},
-{0.612500,0.812500,0.100000,0.100000},
-{0.637500,0.812500,0.050000,0.050000},
-{0.637500,0.812500,0.100000,0.100000},
-{0.662500,0.812500,0.050000,0.050000},
-{0.662500,0.812500,0.100000,0.100000},
-{0.687500,0.812500,0.050000,0.050000},
-{0.687500,0.812500,0.100000,0.100000},
-{0.712500,0.812500,0.050000,0.050000},
-{0.712500,0.812500,0.100000,0.100000},
-{0.737500,0.812500,0.050000,0.050000},
-{0.737500,0.812500,0.100000,0.100000},
-{0.762500,0.812500,0.050000,0.050000},
-{0.762500,0.812500,0.100000,0.100000},
-{0.787500,0.812500,0.050000,0.050000},
-{0.787500,0.812500,0.100000,0.100000},
-{0.812500,0.812500,0.050000,0.050000},
-{0.812500,0.812500,0.100000,0.100000},
-{0.837500,0.812500,0.050000,0.050000},
-{0.837500,0.812500,0.100000,0.100000},
-{0.862500,0.812500,0.050000,0.050000},
-{0.862500,0.812500,0.100000,0.100000},
-{0.887500,0.812500,0.050000,0.050000},
-{0.887500,0.812500,0.100000,0.100000},
-{0.912500,0.812500,0.050000,0.050000},
-{0.912500,0.812500,0.100000,0.100000},
-{0.937500,0.812500,0.050000,0.050000},
-{0.937500,0.812500,0.100000,0.100000},
-{0.962500,0.812500,0.050000,0.050000},
-{0.962500,0.812500,0.100000,0.100000},
-{0.987500,0.812500,0.050000,0.050000},
-{0.987500,0.812500,0.100000,0.100000},
-{0.012500,0.837500,0.050000,0.050000},
-{0.012500,0.837500,0.100000,0.100000},
-{0.037500,0.837500,0.050000,0.050000},
-{0.037500,0.837500,0.100000,0.100000},
-{0.062500,0.837500,0.050000,0.050000},
-{0.062500,0.837500,0.100000,0.100000},
-{0.087500,0.837500,0.050000,0.050000},
-{0.087500,0.837500,0.100000,0.100000},
-{0.112500,0.837500,0.050000,0.050000},
-{0.112500,0.837500,0.100000,0.100000},
-{0.137500,0.837500,0.050000,0.050000},
-{0.137500,0.837500,0.100000,0.100000},
-{0.162500,0.837500,0.050000,0.050000},
-{0.162500,0.837500,0.100000,0.100000},
-{0.187500,0.837500,0.050000,0.050000},
-{0.187500,0.837500,0.100000,0.100000},
-{0.212500,0.837500,0.050000,0.050000},
-{0.212500,0.837500,0.100000,0.100000},
-{0.237500,0.837500,0.050000,0.050000},
-{0.237500,0.837500,0.100000,0.100000},
-{0.262500,0.837500,0.050000,0.050000},
-{0.262500,0.837500,0.100000,0.100000},
-{0.287500,0.837500,0.050000,0.050000},
-{0.287500,0.837500,0.100000,0.100000},
-{0.312500,0.837500,0.050000,0.050000},
-{0.312500,0.837500,0.100000,0.100000},
-{0.337500,0.837500,0.050000,0.050000},
-{0.337500,0.837500,0.100000,0.100000},
-{0.362500,0.837500,0.050000,0.050000},
-{0.362500,0.837500,0.100000,0.100000},
-{0.387500,0.837500,0.050000,0.050000},
-{0.387500,0.837500,0.100000,0.100000},
-{0.412500,0.837500,0.050000,0.050000},
-{0.412500,0.837500,0.100000,0.100000},
-{0.437500,0.837500,0.050000,0.050000},
-{0.437500,0.837500,0.100000,0.100000},
-{0.462500,0.837500,0.050000,0.050000},
-{0.462500,0.837500,0.100000,0.100000},
-{0.487500,0.837500,0.050000,0.050000},
-{0.487500,0.837500,0.100000,0.100000},
-{0.512500,0.837500,0.050000,0.050000},
-{0.512500,0.837500,0.100000,0.100000},
-{0.537500,0.837500,0.050000,0.050000},
-{0.537500,0.837500,0.100000,0.100000},
-{0.562500,0.837500,0.050000,0.050000},
-{0.562500,0.837500,0.100000,0.100000},
-{0.587500,0.837500,0.050000,0.050000},
-{0.587500,0.837500,0.100000,0.100000},
-{0.612500,0.837500,0.050000,0.050000},
-{0.612500,0.837500,0.100000,0.100000},
-{0.637500,0.837500,0.050000,0.050000},
-{0.637500,0.837500,0.100000,0.100000},
-{0.662500,0.837500,0.050000,0.050000},
-{0.662500,0.837500,0.100000,0.100000},
-{0.687500,0.837500,0.050000,0.050000},
-{0.687500,0.837500,0.100000,0.100000},
-{0.712500,0.837500,0.050000,0.050000},
-{0.712500,0.837500,0.100000,0.100000},
-{0.737500,0.837500,0.050000,0.050000},
-{0.737500,0.837500,0.100000,0.100000},
-{0.762500,0.837500,0.050000,0.050000},
-{0.762500,0.837500,0.100000,0.100000},
-{0.787500,0.837500,0.050000,0.050000},
-{0.787500,0.837500,0.100000,0.100000},
-{0.812500,0.837500,0.050000,0.050000},
-{0.812500,0.837500,0.100000,0.100000},
-{0.837500,0.837500,0.050000,0.050000},
-{0.837500,0.837500,0.100000,0.100000},
-{0.862500,0.837500,0.050000,0.050000},
-{0.862500,0.837500,0.100000,0.100000},
-{0.887500,0.837500,0.050000,0.050000},
-{0.887500,0.837500,0.100000,0.100000},
-{0.912500,0.837500,0.050000,0.050000},
-{0.912500,0.837500,0.100000,0.100000},
-{0.937500,0.837500,0.050000,0.050000},
-{0.937500,0.837500,0.100000,0.100000},
-{0.962500,0.837500,0.050000,0.050000},
-{0.962500,0.837500,0.100000,0.100000},
-{0.987500,0.837500,0.050000,0.050000},
-{0.987500,0.837500,0.100000,0.100000},
-{0.012500,0.862500,0.050000,0.050000},
-{0.012500,0.862500,0.100000,0.100000},
-{0.037500,0.862500,0.050000,0.050000},
-{0.037500,0.862500,0.100000,0.100000},
-{0.062500,0.862500,0.050000,0.050000},
-{0.062500,0.862500,0.100000,0.100000},
-{0.087500,0.862500,0.050000,0.050000},
-{0.087500,0.862500,0.100000,0.100000},
-{0.112500,0.862500,0.050000,0.050000},
-{0.112500,0.862500,0.100000,0.100000},
-{0.137500,0.862500,0.050000,0.050000},
-{0.137500,0.862500,0.100000,0.100000},
-{0.162500,0.862500,0.050000,0.050000},
-{0.162500,0.862500,0.100000,0.100000},
-{0.187500,0.862500,0.050000,0.050000},
-{0.187500,0.862500,0.100000,0.100000},
-{0.212500,0.862500,0.050000,0.050000},
-{0.212500,0.862500,0.100000,0.100000},
-{0.237500,0.862500,0.050000,0.050000},
-{0.237500,0.862500,0.100000,0.100000},
-{0.262500,0.862500,0.050000,0.050000},
-{0.262500,0.862500,0.100000,0.100000},
-{0.287500,0.862500,0.050000,0.050000},
-{0.287500,0.862500,0.100000,0.100000},
-{0.312500,0.862500,0.050000,0.050000},
-{0.312500,0.862500,0.100000,0.100000},
-{0.337500,0.862500,0.050000,0.050000},
-{0.337500,0.862500,0.100000,0.100000},
-{0.362500,0.862500,0.050000,0.050000},
-{0.362500,0.862500,0.100000,0.100000},
-{0.387500,0.862500,0.050000,0.050000},
-{0.387500,0.862500,0.100000,0.100000},
-{0.412500,0.862500,0.050000,0.050000},
-{0.412500,0.862500,0.100000,0.100000},
-{0.437500,0.862500,0.050000,0.050000},
-{0.437500,0.862500,0.100000,0.100000},
-{0.462500,0.862500,0.050000,0.050000},
-{0.462500,0.862500,0.100000,0.100000},
-{0.487500,0.862500,0.050000,0.050000},
-{0.487500,0.862500,0.100000,0.100000},
-{0.512500,0.862500,0.050000,0.050000},
-{0.512500,0.862500,0.100000,0.100000},
-{0.537500,0.862500,0.050000,0.050000},
-{0.537500,0.862500,0.100000,0.100000},
-{0.562500,0.862500,0.050000,0.050000},
-{0.562500,0.862500,0.100000,0.100000},
-{0.587500,0.862500,0.050000,0.050000},
-{0.587500,0.862500,0.100000,0.100000},
-{0.612500,0.862500,0.050000,0.050000},
-{0.612500,0.862500,0.100000,0.100000},
-{0.637500,0.862500,0.050000,0.050000},
-{0.637500,0.862500,0.100000,0.100000},
-{0.662500,0.862500,0.050000,0.050000},
-{0.662500,0.862500,0.100000,0.100000},
-{0.687500,0.862500,0.050000,0.050000},
-{0.687500,0.862500,0.100000,0.100000},
-{0.712500,0.862500,0.050000,0.050000},
-{0.712500,0.862500,0.100000,0.100000},
-{0.737500,0.862500,0.050000,0.050000},
-{0.737500,0.862500,0.100000,0.100000},
-{0.762500,0.862500,0.050000,0.050000},
-{0.762500,0.862500,0.100000,0.100000},
-{0.787500,0.862500,0.050000,0.050000},
-{0.787500,0.862500,0.100000,0.100000},
-{0.812500,0.862500,0.050000,0.050000},
-{0.812500,0.862500,0.100000,0.100000},
-{0.837500,0.862500,0.050000,0.050000},
-{0.837500,0.862500,0.100000,0.100000},
-{0.862500,0.862500,0.050000,0.050000},
-{0.862500,0.862500,0.100000,0.100000},
-{0.887500,0.862500,0.050000,0.050000},
-{0.887500,0.862500,0.100000,0.100000},
-{0.912500,0.862500,0.050000,0.050000},
-{0.912500,0.862500,0.100000,0.100000},
-{0.937500,0.862500,0.050000,0.050000},
-{0.937500,0.862500,0.100000,0.100000},
-{0.962500,0.862500,0.050000,0.050000},
-{0.962500,0.862500,0.100000,0.100000},
-{0.987500,0.862500,0.050000,0.050000},
-{0.987500,0.862500,0.100000,0.100000},
-{0.012500,0.887500,0.050000,0.050000},
-{0.012500,0.887500,0.100000,0.100000},
-{0.037500,0.887500,0.050000,0.050000},
-{0.037500,0.887500,0.100000,0.100000},
-{0.062500,0.887500,0.050000,0.050000},
-{0.062500,0.887500,0.100000,0.100000},
-{0.087500,0.887500,0.050000,0.050000},
-{0.087500,0.887500,0.100000,0.100000},
-{0.112500,0.887500,0.050000,0.050000},
-{0.112500,0.887500,0.100000,0.100000},
-{0.137500,0.887500,0.050000,0.050000},
-{0.137500,0.887500,0.100000,0.100000},
-{0.162500,0.887500,0.050000,0.050000},
-{0.162500,0.887500,0.100000,0.100000},
-{0.187500,0.887500,0.050000,0.050000},
-{0.187500,0.887500,0.100000,0.100000},
-{0.212500,0.887500,0.050000,0.050000},
-{0.212500,0.887500,0.100000,0.100000},
-{0.237500,0.887500,0.050000,0.050000},
-{0.237500,0.887500,0.100000,0.100000},
-{0.262500,0.887500,0.050000,0.050000},
-{0.262500,0.887500,0.100000,0.100000},
-{0.287500,0.887500,0.050000,0.050000},
-{0.287500,0.887500,0.100000,0.100000},
-{0.312500,0.887500,0.050000,0.050000},
-{0.312500,0.887500,0.100000,0.100000},
-{0.337500,0.887500,0.050000,0.050000},
-{0.337500,0.887500,0.100000,0.100000},
-{0.362500,0.887500,0.050000,0.050000},
-{0.362500,0.887500,0.100000,0.100000},
-{0.387500,0.887500,0.050000,0.050000},
-{0.387500,0.887500,0.100000,0.100000},
-{0.412500,0.887500,0.050000,0.050000},
-{0.412500,0.887500,0.100000,0.100000},
-{0.437500,0.887500,0.050000,0.050000},
-{0.437500,0.887500,0.100000,0.100000},
-{0.462500,0.887500,0.050000,0.050000},
-{0.462500,0.887500,0.100000,0.100000},
-{0.487500,0.887500,0.050000,0.050000},
-{0.487500,0.887500,0.100000,0.100000},
-{0.512500,0.887500,0.050000,0.050000},
-{0.512500,0.887500,0.100000,0.100000},
-{0.537500,0.887500,0.050000,0.050000},
-{0.537500,0.887500,0.100000,0.100000},
-{0.562500,0.887500,0.050000,0.050000},
-{0.562500,0.887500,0.100000,0.100000},
-{0.587500,0.887500,0.050000,0.050000},
-{0.587500,0.887500,0.100000,0.100000},
-{0.612500,0.887500,0.050000,0.050000},
-{0.612500,0.887500,0.100000,0.100000},
-{0.637500,0.887500,0.050000,0.050000},
-{0.637500,0.887500,0.100000,0.100000},
-{0.662500,0.887500,0.050000,0.050000},
-{0.662500,0.887500,0.100000,0.100000},
-{0.687500,0.887500,0.050000,0.050000},
-{0.687500,0.887500,0.100000,0.100000},
-{0.712500,0.887500,0.050000,0.050000},
-{0.712500,0.887500,0.100000,0.100000},
-{0.737500,0.887500,0.050000,0.050000},
-{0.737500,0.887500,0.100000,0.100000},
-{0.762500,0.887500,0.050000,0.050000},
-{0.762500,0.887500,0.100000,0.100000},
-{0.787500,0.887500,0.050000,0.050000},
-{0.787500,0.887500,0.100000,0.100000},
-{0.812500,0.887500,0.050000,0.050000},
-{0.812500,0.887500,0.100000,0.100000},
-{0.837500,0.887500,0.050000,0.050000},
-{0.837500,0.887500,0.100000,0.100000},
-{0.862500,0.887500,0.050000,0.050000},
-{0.862500,0.887500,0.100000,0.100000},
-{0.887500,0.887500,0.050000,0.050000},
-{0.887500,0.887500,0.100000,0.100000},
-{0.912500,0.887500,0.050000,0.050000},
-{0.912500,0.887500,0.100000,0.100000},
-{0.937500,0.887500,0.050000,0.050000},
-{0.937500,0.887500,0.100000,0.100000},
-{0.962500,0.887500,0.050000,0.050000},
-{0.962500,0.887500,0.100000,0.100000},
-{0.987500,0.887500,0.050000,0.050000},
-{0.987500,0.887500,0.100000,0.100000},
-{0.012500,0.912500,0.050000,0.050000},
-{0.012500,0.912500,0.100000,0.100000},
-{0.037500,0.912500,0.050000,0.050000},
-{0.037500,0.912500,0.100000,0.100000},
-{0.062500,0.912500,0.050000,0.050000},
-{0.062500,0.912500,0.100000,0.100000},
-{0.087500,0.912500,0.050000,0.050000},
-{0.087500,0.912500,0.100000,0.100000},
-{0.112500,0.912500,0.050000,0.050000},
-{0.112500,0.912500,0.100000,0.100000},
-{0.137500,0.912500,0.050000,0.050000},
-{0.137500,0.912500,0.100000,0.100000},
-{0.162500,0.912500,0.050000,0.050000},
-{0.162500,0.912500,0.100000,0.100000},
-{0.187500,0.912500,0.050000,0.050000},
-{0.187500,0.912500,0.100000,0.100000},
-{0.212500,0.912500,0.050000,0.050000},
-{0.212500,0.912500,0.100000,0.100000},
-{0.237500,0.912500,0.050000,0.050000},
-{0.237500,0.912500,0.100000,0.100000},
-{0.262500,0.912500,0.050000,0.050000},
-{0.262500,0.912500,0.100000,0.100000},
-{0.287500,0.912500,0.050000,0.050000},
-{0.287500,0.912500,0.100000,0.100000},
-{0.312500,0.912500,0.050000,0.050000},
-{0.312500,0.912500,0.100000,0.100000},
-{0.337500,0.912500,0.050000,0.050000},
-{0.337500,0.912500,0.100000,0.100000},
-{0.362500,0.912500,0.050000,0.050000},
-{0.362500,0.912500,0.100000,0.100000},
-{0.387500,0.912500,0.050000,0.050000},
-{0.387500,0.912500,0.100000,0.100000},
-{0.412500,0.912500,0.050000,0.050000},
-{0.412500,0.912500,0.100000,0.100000},
-{0.437500,0.912500,0.050000,0.050000},
-{0.437500,0.912500,0.100000,0.100000},
-{0.462500,0.912500,0.050000,0.050000},
-{0.462500,0.912500,0.100000,0.100000},
-{0.487500,0.912500,0.050000,0.050000},
-{0.487500,0.912500,0.100000,0.100000},
-{0.512500,0.912500,0.050000,0.050000},
-{0.512500,0.912500,0.100000,0.100000},
-{0.537500,0.912500,0.050000,0.050000},
-{0.537500,0.912500,0.100000,0.100000},
-{0.562500,0.912500,0.050000,0.050000},
-{0.562500,0.912500,0.100000,0.100000},
-{0.587500,0.912500,0.050000,0.050000},
-{0.587500,0.912500,0.100000,0.100000},
-{0.612500,0.912500,0.050000,0.050000},
-{0.612500,0.912500,0.100000,0.100000},
-{0.637500,0.912500,0.050000,0.050000},
-{0.637500,0.912500,0.100000,0.100000},
-{0.662500,0.912500,0.050000,0.050000},
-{0.662500,0.912500,0.100000,0.100000},
-{0.687500,0.912500,0.050000,0.050000},
-{0.687500,0.912500,0.100000,0.100000},
-{0.712500,0.912500,0.050000,0.050000},
-{0.712500,0.912500,0.100000,0.100000},
-{0.737500,0.912500,0.050000,0.050000},
-{0.737500,0.912500,0.100000,0.100000},
-{0.762500,0.912500,0.050000,0.050000},
-{0.762500,0.912500,0.100000,0.100000},
-{0.787500,0.912500,0.050000,0.050000},
-{0.787500,0.912500,0.100000,0.100000},
-{0.812500,0.912500,0.050000,0.050000},
-{0.812500,0.912500,0.100000,0.100000},
-{0.837500,0.912500,0.050000,0.050000},
-{0.837500,0.912500,0.100000,0.100000},
-{0.862500,0.912500,0.050000,0.050000},
-{0.862500,0.912500,0.100000,0.100000},
-{0.887500,0.912500,0.050000,0.050000},
-{0.887500,0.912500,0.100000,0.100000},
-{0.912500,0.912500,0.050000,0.050000},
-{0.912500,0.912500,0.100000,0.100000},
-{0.937500,0.912500,0.050000,0.050000},
-{0.937500,0.912500,0.100000,0.100000},
-{0.962500,0.912500,0.050000,0.050000},
-{0.962500,0.912500,0.100000,0.100000},
-{0.987500,0.912500,0.050000,0.050000},
-{0.987500,0.912500,0.100000,0.100000},
-{0.012500,0.937500,0.050000,0.050000},
-{0.012500,0.937500,0.100000,0.100000},
-{0.037500,0.937500,0.050000,0.050000},
-{0.037500,0.937500,0.100000,0.100000},
-{0.062500,0.937500,0.050000,0.050000},
-{0.062500,0.937500,0.100000,0.100000},
-{0.087500,0.937500,0.050000,0.050000},
-{0.087500,0.937500,0.100000,0.100000},
-{0.112500,0.937500,0.050000,0.050000},
-{0.112500,0.937500,0.100000,0.100000},
-{0.137500,0.937500,0.050000,0.050000},
-{0.137500,0.937500,0.100000,0.100000},
-{0.162500,0.937500,0.050000,0.050000},
-{0.162500,0.937500,0.100000,0.100000},
-{0.187500,0.937500,0.050000,0.050000},
-{0.187500,0.937500,0.100000,0.100000},
-{0.212500,0.937500,0.050000,0.050000},
-{0.212500,0.937500,0.100000,0.100000},
-{0.237500,0.937500,0.050000,0.050000},
-{0.237500,0.937500,0.100000,0.100000},
-{0.262500,0.937500,0.050000,0.050000},
-{0.262500,0.937500,0.100000,0.100000},
-{0.287500,0.937500,0.050000,0.050000},
-{0.287500,0.937500,0.100000,0.100000},
-{0.312500,0.937500,0.050000,0.050000},
-{0.312500,0.937500,0.100000,0.100000},
-{0.337500,0.937500,0.050000,0.050000},
-{0.337500,0.937500,0.100000,0.100000},
-{0.362500,0.937500,0.050000,0.050000},
-{0.362500,0.937500,0.100000,0.100000},
-{0.387500,0.937500,0.050000,0.050000},
-{0.387500,0.937500,0.100000,0.100000},
-{0.412500,0.937500,0.050000,0.050000},
-{0.412500,0.937500,0.100000,0.100000},
-{0.437500,0.937500,0.050000,0.050000},
-{0.437500,0.937500,0.100000,0.100000},
-{0.462500,0.937500,0.050000,0.050000},
-{0.462500,0.937500,0.100000,0.100000},
-{0.487500,0.937500,0.050000,0.050000},
-{0.487500,0.937500,0.100000,0.100000},
-{0.512500,0.937500,0.050000,0.050000},
-{0.512500,0.937500,0.100000,0.100000},
-{0.537500,0.937500,0.050000,0.050000},
-{0.537500,0.937500,0.100000,0.100000},
-{0.562500,0.937500,0.050000,0.050000},
-{0.562500,0.937500,0.100000,0.100000},
-{0.587500,0.937500,0.050000,0.050000},
-{0.587500,0.937500,0.100000,0.100000},
-{0.612500,0.937500,0.050000,0.050000},
-{0.612500,0.937500,0.100000,0.100000},
-{0.637500,0.937500,0.050000,0.050000},
-{0.637500,0.937500,0.100000,0.100000},
-{0.662500,0.937500,0.050000,0.050000},
-{0.662500,0.937500,0.100000,0.100000},
-{0.687500,0.937500,0.050000,0.050000},
-{0.687500,0.937500,0.100000,0.100000},
-{0.712500,0.937500,0.050000,0.050000},
-{0.712500,0.937500,0.100000,0.100000},
-{0.737500,0.937500,0.050000,0.050000},
-{0.737500,0.937500,0.100000,0.100000},
-{0.762500,0.937500,0.050000,0.050000},
-{0.762500,0.937500,0.100000,0.100000},
-{0.787500,0.937500,0.050000,0.050000},
-{0.787500,0.937500,0.100000,0.100000},
-{0.812500,0.937500,0.050000,0.050000},
-{0.812500,0.937500,0.100000,0.100000},
-{0.837500,0.937500,0.050000,0.050000},
-{0.837500,0.937500,0.100000,0.100000},
-{0.862500,0.937500,0.050000,0.050000},
-{0.862500,0.937500,0.100000,0.100000},
-{0.887500,0.937500,0.050000,0.050000},
-{0.887500,0.937500,0.100000,0.100000},
-{0.912500,0.937500,0.050000,0.050000},
-{0.912500,0.937500,0.100000,0.100000},
-{0.937500,0.937500,0.050000,0.050000},
-{0.937500,0.937500,0.100000,0.100000},
-{0.962500,0.937500,0.050000,0.050000},
-{0.962500,0.937500,0.100000,0.100000},
-{0.987500,0.937500,0.050000,0.050000},
-{0.987500,0.937500,0.100000,0.100000},
-{0.012500,0.962500,0.050000,0.050000},
-{0.012500,0.962500,0.100000,0.100000},
-{0.037500,0.962500,0.050000,0.050000},
-{0.037500,0.962500,0.100000,0.100000},
-{0.062500,0.962500,0.050000,0.050000},
-{0.062500,0.962500,0.100000,0.100000},
-{0.087500,0.962500,0.050000,0.050000},
-{0.087500,0.962500,0.100000,0.100000},
-{0.112500,0.962500,0.050000,0.050000},
-{0.112500,0.962500,0.100000,0.100000},
-{0.137500,0.962500,0.050000,0.050000},
-{0.137500,0.962500,0.100000,0.100000},
-{0.162500,0.962500,0.050000,0.050000},
-{0.162500,0.962500,0.100000,0.100000},
-{0.187500,0.962500,0.050000,0.050000},
-{0.187500,0.962500,0.100000,0.100000},
-{0.212500,0.962500,0.050000,0.050000},
-{0.212500,0.962500,0.100000,0.100000},
-{0.237500,0.962500,0.050000,0.050000},
-{0.237500,0.962500,0.100000,0.100000},
-{0.262500,0.962500,0.050000,0.050000},
-{0.262500,0.962500,0.100000,0.100000},
-{0.287500,0.962500,0.050000,0.050000},
-{0.287500,0.962500,0.100000,0.100000},
-{0.312500,0.962500,0.050000,0.050000},
-{0.312500,0.962500,0.100000,0.100000},
-{0.337500,0.962500,0.050000,0.050000},
-{0.337500,0.962500,0.100000,0.100000},
-{0.362500,0.962500,0.050000,0.050000},
-{0.362500,0.962500,0.100000,0.100000},
-{0.387500,0.962500,0.050000,0.050000},
-{0.387500,0.962500,0.100000,0.100000},
-{0.412500,0.962500,0.050000,0.050000},
-{0.412500,0.962500,0.100000,0.100000},
-{0.437500,0.962500,0.050000,0.050000},
-{0.437500,0.962500,0.100000,0.100000},
-{0.462500,0.962500,0.050000,0.050000},
-{0.462500,0.962500,0.100000,0.100000},
-{0.487500,0.962500,0.050000,0.050000},
-{0.487500,0.962500,0.100000,0.100000},
-{0.512500,0.962500,0.050000,0.050000},
-{0.512500,0.962500,0.100000,0.100000},
-{0.537500,0.962500,0.050000,0.050000},
-{0.537500,0.962500,0.100000,0.100000},
-{0.562500,0.962500,0.050000,0.050000},
-{0.562500,0.962500,0.100000,0.100000},
-{0.587500,0.962500,0.050000,0.050000},
-{0.587500,0.962500,0.100000,0.100000},
-{0.612500,0.962500,0.050000,0.050000},
-{0.612500,0.962500,0.100000,0.100000},
-{0.637500,0.962500,0.050000,0.050000},
-{0.637500,0.962500,0.100000,0.100000},
-{0.662500,0.962500,0.050000,0.050000},
-{0.662500,0.962500,0.100000,0.100000},
-{0.687500,0.962500,0.050000,0.050000},
-{0.687500,0.962500,0.100000,0.100000},
-{0.712500,0.962500,0.050000,0.050000},
-{0.712500,0.962500,0.100000,0.100000},
-{0.737500,0.962500,0.050000,0.050000},
-{0.737500,0.962500,0.100000,0.100000},
-{0.762500,0.962500,0.050000,0.050000},
-{0.762500,0.962500,0.100000,0.100000},
-{0.787500,0.962500,0.050000,0.050000},
-{0.787500,0.962500,0.100000,0.100000},
-{0.812500,0.962500,0.050000,0.050000},
-{0.812500,0.962500,0.100000,0.100000},
-{0.837500,0.962500,0.050000,0.050000},
-{0.837500,0.962500,0.100000,0.100000},
-{0.862500,0.962500,0.050000,0.050000},
-{0.862500,0.962500,0.100000,0.100000},
-{0.887500,0.962500,0.050000,0.050000},
-{0.887500,0.962500,0.100000,0.100000},
-{0.912500,0.962500,0.050000,0.050000},
-{0.912500,0.962500,0.100000,0.100000},
-{0.937500,0.962500,0.050000,0.050000},
-{0.937500,0.962500,0.100000,0.100000},
-{0.962500,0.962500,0.050000,0.050000},
-{0.962500,0.962500,0.100000,0.100000},
-{0.987500,0.962500,0.050000,0.050000},
-{0.987500,0.962500,0.100000,0.100000},
-{0.012500,0.987500,0.050000,0.050000},
-{0.012500,0.987500,0.100000,0.100000},
-{0.037500,0.987500,0.050000,0.050000},
-{0.037500,0.987500,0.100000,0.100000},
-{0.062500,0.987500,0.050000,0.050000},
-{0.062500,0.987500,0.100000,0.100000},
-{0.087500,0.987500,0.050000,0.050000},
-{0.087500,0.987500,0.100000,0.100000},
-{0.112500,0.987500,0.050000,0.050000},
-{0.112500,0.987500,0.100000,0.100000},
-{0.137500,0.987500,0.050000,0.050000},
-{0.137500,0.987500,0.100000,0.100000},
-{0.162500,0.987500,0.050000,0.050000},
-{0.162500,0.987500,0.100000,0.100000},
-{0.187500,0.987500,0.050000,0.050000},
-{0.187500,0.987500,0.100000,0.100000},
-{0.212500,0.987500,0.050000,0.050000},
-{0.212500,0.987500,0.100000,0.100000},
-{0.237500,0.987500,0.050000,0.050000},
-{0.237500,0.987500,0.100000,0.100000},
-{0.262500,0.987500,0.050000,0.050000},
-{0.262500,0.987500,0.100000,0.100000},
-{0.287500,0.987500,0.050000,0.050000},
-{0.287500,0.987500,0.100000,0.100000},
-{0.312500,0.987500,0.050000,0.050000},
-{0.312500,0.987500,0.100000,0.100000},
-{0.337500,0.987500,0.050000,0.050000},
-{0.337500,0.987500,0.100000,0.100000},
-{0.362500,0.987500,0.050000,0.050000},
-{0.362500,0.987500,0.100000,0.100000},
-{0.387500,0.987500,0.050000,0.050000},
-{0.387500,0.987500,0.100000,0.100000},
-{0.412500,0.987500,0.050000,0.050000},
-{0.412500,0.987500,0.100000,0.100000},
-{0.437500,0.987500,0.050000,0.050000},
-{0.437500,0.987500,0.100000,0.100000},
-{0.462500,0.987500,0.050000,0.050000},
-{0.462500,0.987500,0.100000,0.100000},
-{0.487500,0.987500,0.050000,0.050000},
-{0.487500,0.987500,0.100000,0.100000},
-{0.512500,0.987500,0.050000,0.050000},
-{0.512500,0.987500,0.100000,0.100000},
-{0.537500,0.987500,0.050000,0.050000},
-{0.537500,0.987500,0.100000,0.100000},
-{0.562500,0.987500,0.050000,0.050000},
-{0.562500,0.987500,0.100000,0.100000},
-{0.587500,0.987500,0.050000,0.050000},
-{0.587500,0.987500,0.100000,0.100000},
-{0.612500,0.987500,0.050000,0.050000},
-{0.612500,0.987500,0.100000,0.100000},
-{0.637500,0.987500,0.050000,0.050000},
-{0.637500,0.987500,0.100000,0.100000},
-{0.662500,0.987500,0.050000,0.050000},
-{0.662500,0.987500,0.100000,0.100000},
-{0.687500,0.987500,0.050000,0.050000},
-{0.687500,0.987500,0.100000,0.100000},
-{0.712500,0.987500,0.050000,0.050000},
-{0.712500,0.987500,0.100000,0.100000},
-{0.737500,0.987500,0.050000,0.050000},
-{0.737500,0.987500,0.100000,0.100000},
-{0.762500,0.987500,0.050000,0.050000},
-{0.762500,0.987500,0.100000,0.100000},
-{0.787500,0.987500,0.050000,0.050000},
-{0.787500,0.987500,0.100000,0.100000},
-{0.812500,0.987500,0.050000,0.050000},
-{0.812500,0.987500,0.100000,0.100000},
-{0.837500,0.987500,0.050000,0.050000},
-{0.837500,0.987500,0.100000,0.100000},
-{0.862500,0.987500,0.050000,0.050000},
-{0.862500,0.987500,0.100000,0.100000},
-{0.887500,0.987500,0.050000,0.050000},
-{0.887500,0.987500,0.100000,0.100000},
-{0.912500,0.987500,0.050000,0.050000},
-{0.912500,0.987500,0.100000,0.100000},
-{0.937500,0.987500,0.050000,0.050000},
-{0.937500,0.987500,0.100000,0.100000},
-{0.962500,0.987500,0.050000,0.050000},
-{0.962500,0.987500,0.100000,0.100000},
-{0.987500,0.987500,0.050000,0.050000},
-{0.987500,0.987500,0.100000,0.100000},
-{0.025000,0.025000,0.200000,0.200000},
-{0.025000,0.025000,0.400000,0.400000},
-{0.075000,0.025000,0.200000,0.200000},
-{0.075000,0.025000,0.400000,0.400000},
-{0.125000,0.025000,0.200000,0.200000},
-{0.125000,0.025000,0.400000,0.400000},
-{0.175000,0.025000,0.200000,0.200000},
-{0.175000,0.025000,0.400000,0.400000},
-{0.225000,0.025000,0.200000,0.200000},
-{0.225000,0.025000,0.400000,0.400000},
-{0.275000,0.025000,0.200000,0.200000},
-{0.275000,0.025000,0.400000,0.400000},
-{0.325000,0.025000,0.200000,0.200000},
-{0.325000,0.025000,0.400000,0.400000},
-{0.375000,0.025000,0.200000,0.200000},
-{0.375000,0.025000,0.400000,0.400000},
-{0.425000,0.025000,0.200000,0.200000},
-{0.425000,0.025000,0.400000,0.400000},
-{0.475000,0.025000,0.200000,0.200000},
-{0.475000,0.025000,0.400000,0.400000},
-{0.525000,0.025000,0.200000,0.200000},
-{0.525000,0.025000,0.400000,0.400000},
-{0.575000,0.025000,0.200000,0.200000},
-{0.575000,0.025000,0.400000,0.400000},
-{0.625000,0.025000,0.200000,0.200000},
-{0.625000,0.025000,0.400000,0.400000},
-{0.675000,0.025000,0.200000,0.200000},
-{0.675000,0.025000,0.400000,0.400000},
-{0.725000,0.025000,0.200000,0.200000},
-{0.725000,0.025000,0.400000,0.400000},
-{0.775000,0.025000,0.200000,0.200000},
-{0.775000,0.025000,0.400000,0.400000},
-{0.825000,0.025000,0.200000,0.200000},
-{0.825000,0.025000,0.400000,0.400000},
-{0.875000,0.025000,0.200000,0.200000},
-{0.875000,0.025000,0.400000,0.400000},
-{0.925000,0.025000,0.200000,0.200000},
-{0.925000,0.025000,0.400000,0.400000},
-{0.975000,0.025000,0.200000,0.200000},
-{0.975000,0.025000,0.400000,0.400000},
-{0.025000,0.075000,0.200000,0.200000},
-{0.025000,0.075000,0.400000,0.400000},
-{0.075000,0.075000,0.200000,0.200000},
-{0.075000,0.075000,0.400000,0.400000},
-{0.125000,0.075000,0.200000,0.200000},
-{0.125000,0.075000,0.400000,0.400000},
-{0.175000,0.075000,0.200000,0.200000},
-{0.175000,0.075000,0.400000,0.400000},
-{0.225000,0.075000,0.200000,0.200000},
-{0.225000,0.075000,0.400000,0.400000},
-{0.275000,0.075000,0.200000,0.200000},
-{0.275000,0.075000,0.400000,0.400000},
-{0.325000,0.075000,0.200000,0.200000},
-{0.325000,0.075000,0.400000,0.400000},
-{0.375000,0.075000,0.200000,0.200000},
-{0.375000,0.075000,0.400000,0.400000},
-{0.425000,0.075000,0.200000,0.200000},
-{0.425000,0.075000,0.400000,0.400000},
-{0.475000,0.075000,0.200000,0.200000},
-{0.475000,0.075000,0.400000,0.400000},
-{0.525000,0.075000,0.200000,0.200000},
-{0.525000,0.075000,0.400000,0.400000},
-{0.575000,0.075000,0.200000,0.200000},
-{0.575000,0.075000,0.400000,0.400000},
-{0.625000,0.075000,0.200000,0.200000},
-{0.625000,0.075000,0.400000,0.400000},
-{0.675000,0.075000,0.200000,0.200000},
-{0.675000,0.075000,0.400000,0.400000},
-{0.725000,0.075000,0.200000,0.200000},
-{0.725000,0.075000,0.400000,0.400000},
-{0.775000,0.075000,0.200000,0.200000},
-{0.775000,0.075000,0.400000,0.400000},
-{0.825000,0.075000,0.200000,0.200000},
-{0.825000,0.075000,0.400000,0.400000},
-{0.875000,0.075000,0.200000,0.200000},
-{0.875000,0.075000,0.400000,0.400000},
-{0.925000,0.075000,0.200000,0.200000},
-{0.925000,0.075000,0.400000,0.400000},
-{0.975000,0.075000,0.200000,0.200000},
-{0.975000,0.075000,0.400000,0.400000},
-{0.025000,0.125000,0.200000,0.200000},
-{0.025000,0.125000,0.400000,0.400000},
-{0.075000,0.125000,0.200000,0.200000},
-{0.075000,0.125000,0.400000,0.400000},
-{0.125000,0.125000,0.200000,0.200000},
-{0.125000,0.125000,0.400000,0.400000},
-{0.175000,0.125000,0.200000,0.200000},
-{0.175000,0.125000,0.400000,0.400000},
-{0.225000,0.125000,0.200000,0.200000},
-{0.225000,0.125000,0.400000,0.400000},
-{0.275000,0.125000,0.200000,0.200000},
-{0.275000,0.125000,0.400000,0.400000},
-{0.325000,0.125000,0.200000,0.200000},
-{0.325000,0.125000,0.400000,0.400000},
-{0.375000,0.125000,0.200000,0.200000},
-{0.375000,0.125000,0.400000,0.400000},
-{0.425000,0.125000,0.200000,0.200000},
-{0.425000,0.125000,0.400000,0.400000},
-{0.475000,0.125000,0.200000,0.200000},
-{0.475000,0.125000,0.400000,0.400000},
-{0.525000,0.125000,0.200000,0.200000},
-{0.525000,0.125000,0.400000,0.400000},
-{0.575000,0.125000,0.200000,0.200000},
-{0.575000,0.125000,0.400000,0.400000},
-{0.625000,0.125000,0.200000,0.200000},
-{0.625000,0.125000,0.400000,0.400000},
-{0.675000,0.125000,0.200000,0.200000},
-{0.675000,0.125000,0.400000,0.400000},
-{0.725000,0.125000,0.200000,0.200000},
-{0.725000,0.125000,0.400000,0.400000},
-{0.775000,0.125000,0.200000,0.200000},
-{0.775000,0.125000,0.400000,0.400000},
-{0.825000,0.125000,0.200000,0.200000},
-{0.825000,0.125000,0.400000,0.400000},
-{0.875000,0.125000,0.200000,0.200000},
-{0.875000,0.125000,0.400000,0.400000},
-{0.925000,0.125000,0.200000,0.200000},
-{0.925000,0.125000,0.400000,0.400000},
-{0.975000,0.125000,0.200000,0.200000},
-{0.975000,0.125000,0.400000,0.400000},
-{0.025000,0.175000,0.200000,0.200000},
-{0.025000,0.175000,0.400000,0.400000},
-{0.075000,0.175000,0.200000,0.200000},
-{0.075000,0.175000,0.400000,0.400000},
-{0.125000,0.175000,0.200000,0.200000},
-{0.125000,0.175000,0.400000,0.400000},
-{0.175000,0.175000,0.200000,0.200000},
-{0.175000,0.175000,0.400000,0.400000},
-{0.225000,0.175000,0.200000,0.200000},
-{0.225000,0.175000,0.400000,0.400000},
-{0.275000,0.175000,0.200000,0.200000},
-{0.275000,0.175000,0.400000,0.400000},
-{0.325000,0.175000,0.200000,0.200000},
-{0.325000,0.175000,0.400000,0.400000},
-{0.375000,0.175000,0.200000,0.200000},
-{0.375000,0.175000,0.400000,0.400000},
-{0.425000,0.175000,0.200000,0.200000},
-{0.425000,0.175000,0.400000,0.400000},
-{0.475000,0.175000,0.200000,0.200000},
-{0.475000,0.175000,0.400000,0.400000},
-{0.525000,0.175000,0.200000,0.200000},
-{0.525000,0.175000,0.400000,0.400000},
-{0.575000,0.175000,0.200000,0.200000},
-{0.575000,0.175000,0.400000,0.400000},
-{0.625000,0.175000,0.200000,0.200000},
-{0.625000,0.175000,0.400000,0.400000},
-{0.675000,0.175000,0.200000,0.200000},
-{0.675000,0.175000,0.400000,0.400000},
-{0.725000,0.175000,0.200000,0.200000},
-{0.725000,0.175000,0.400000,0.400000},
-{0.775000,0.175000,0.200000,0.200000},
-{0.775000,0.175000,0.400000,0.400000},
-{0.825000,0.175000,0.200000,0.200000},
-{0.825000,0.175000,0.400000,0.400000},
-{0.875000,0.175000,0.200000,0.200000},
-{0.875000,0.175000,0.400000,0.400000},
-{0.925000,0.175000,0.200000,0.200000},
-{0.925000,0.175000,0.400000,0.400000},
-{0.975000,0.175000,0.200000,0.200000},
-{0.975000,0.175000,0.400000,0.400000},
-{0.025000,0.225000,0.200000,0.200000},
-{0.025000,0.225000,0.400000,0.400000},
-{0.075000,0.225000,0.200000,0.200000},
-{0.075000,0.225000,0.400000,0.400000},
-{0.125000,0.225000,0.200000,0.200000},
-{0.125000,0.225000,0.400000,0.400000},
-{0.175000,0.225000,0.200000,0.200000},
-{0.175000,0.225000,0.400000,0.400000},
-{0.225000,0.225000,0.200000,0.200000},
-{0.225000,0.225000,0.400000,0.400000},
-{0.275000,0.225000,0.200000,0.200000},
-{0.275000,0.225000,0.400000,0.400000},
-{0.325000,0.225000,0.200000,0.200000},
-{0.325000,0.225000,0.400000,0.400000},
-{0.375000,0.225000,0.200000,0.200000},
-{0.375000,0.225000,0.400000,0.400000},
-{0.425000,0.225000,0.200000,0.200000},
-{0.425000,0.225000,0.400000,0.400000},
-{0.475000,0.225000,0.200000,0.200000},
-{0.475000,0.225000,0.400000,0.400000},
-{0.525000,0.225000,0.200000,0.200000},
-{0.525000,0.225000,0.400000,0.400000},
-{0.575000,0.225000,0.200000,0.200000},
-{0.575000,0.225000,0.400000,0.400000},
-{0.625000,0.225000,0.200000,0.200000},
-{0.625000,0.225000,0.400000,0.400000},
-{0.675000,0.225000,0.200000,0.200000},
-{0.675000,0.225000,0.400000,0.400000},
-{0.725000,0.225000,0.200000,0.200000},
-{0.725000,0.225000,0.400000,0.400000},
-{0.775000,0.225000,0.200000,0.200000},
-{0.775000,0.225000,0.400000,0.400000},
-{0.825000,0.225000,0.200000,0.200000},
-{0.825000,0.225000,0.400000,0.400000},
-{0.875000,0.225000,0.200000,0.200000},
-{0.875000,0.225000,0.400000,0.400000},
-{0.925000,0.225000,0.200000,0.200000},
-{0.925000,0.225000,0.400000,0.400000},
-{0.975000,0.225000,0.200000,0.200000},
-{0.975000,0.225000,0.400000,0.400000},
-{0.025000,0.275000,0.200000,0.200000},
-{0.025000,0.275000,0.400000,0.400000},
-{0.075000,0.275000,0.200000,0.200000},
-{0.075000,0.275000,0.400000,0.400000},
-{0.125000,0.275000,0.200000,0.200000},
-{0.125000,0.275000,0.400000,0.400000},
-{0.175000,0.275000,0.200000,0.200000},
-{0.175000,0.275000,0.400000,0.400000},
-{0.225000,0.275000,0.200000,0.200000},
-{0.225000,0.275000,0.400000,0.400000},
-{0.275000,0.275000,0.200000,0.200000},
-{0.275000,0.275000,0.400000,0.400000},
-{0.325000,0.275000,0.200000,0.200000},
-{0.325000,0.275000,0.400000,0.400000},
-{0.375000,0.275000,0.200000,0.200000},
-{0.375000,0.275000,0.400000,0.400000},
-{0.425000,0.275000,0.200000,0.200000},
-{0.425000,0.275000,0.400000,0.400000},
-{0.475000,0.275000,0.200000,0.200000},
-{0.475000,0.275000,0.400000,0.400000},
-{0.525000,0.275000,0.200000,0.200000},
-{0.525000,0.275000,0.400000,0.400000},
-{0.575000,0.275000,0.200000,0.200000},
-{0.575000,0.275000,0.400000,0.400000},
-{0.625000,0.275000,0.200000,0.200000},
-{0.625000,0.275000,0.400000,0.400000},
-{0.675000,0.275000,0.200000,0.200000},
-{0.675000,0.275000,0.400000,0.400000},
-{0.725000,0.275000,0.200000,0.200000},
-{0.725000,0.275000,0.400000,0.400000},
-{0.775000,0.275000,0.200000,0.200000},
-{0.775000,0.275000,0.400000,0.400000},
-{0.825000,0.275000,0.200000,0.200000},
-{0.825000,0.275000,0.400000,0.400000},
-{0.875000,0.275000,0.200000,0.200000},
-{0.875000,0.275000,0.400000,0.400000},
-{0.925000,0.275000,0.200000,0.200000},
-{0.925000,0.275000,0.400000,0.400000},
-{0.975000,0.275000,0.200000,0.200000},
-{0.975000,0.275000,0.400000,0.400000},
-{0.025000,0.325000,0.200000,0.200000},
-{0.025000,0.325000,0.400000,0.400000},
-{0.075000,0.325000,0.200000,0.200000},
-{0.075000,0.325000,0.400000,0.400000},
-{0.125000,0.325000,0.200000,0.200000},
-{0.125000,0.325000,0.400000,0.400000},
-{0.175000,0.325000,0.200000,0.200000},
-{0.175000,0.325000,0.400000,0.400000},
-{0.225000,0.325000,0.200000,0.200000},
-{0.225000,0.325000,0.400000,0.400000},
-{0.275000,0.325000,0.200000,0.200000},
-{0.275000,0.325000,0.400000,0.400000},
-{0.325000,0.325000,0.200000,0.200000},
-{0.325000,0.325000,0.400000,0.400000},
-{0.375000,0.325000,0.200000,0.200000},
-{0.375000,0.325000,0.400000,0.400000},
-{0.425000,0.325000,0.200000,0.200000},
-{0.425000,0.325000,0.400000,0.400000},
-{0.475000,0.325000,0.200000,0.200000},
-{0.475000,0.325000,0.400000,0.400000},
-{0.525000,0.325000,0.200000,0.200000},
-{0.525000,0.325000,0.400000,0.400000},
-{0.575000,0.325000,0.200000,0.200000},
-{0.575000,0.325000,0.400000,0.400000},
-{0.625000,0.325000,0.200000,0.200000},
-{0.625000,0.325000,0.400000,0.400000},
-{0.675000,0.325000,0.200000,0.200000},
-{0.675000,0.325000,0.400000,0.400000},
-{0.725000,0.325000,0.200000,0.200000},
-{0.725000,0.325000,0.400000,0.400000},
-{0.775000,0.325000,0.200000,0.200000},
-{0.775000,0.325000,0.400000,0.400000},
-{0.825000,0.325000,0.200000,0.200000},
-{0.825000,0.325000,0.400000,0.400000},
-{0.875000,0.325000,0.200000,0.200000},
-{0.875000,0.325000,0.400000,0.400000},
-{0.925000,0.325000,0.200000,0.200000},
-{0.925000,0.325000,0.400000,0.400000},
-{0.975000,0.325000,0.200000,0.200000},
-{0.975000,0.325000,0.400000,0.400000},
-{0.025000,0.375000,0.200000,0.200000},
-{0.025000,0.375000,0.400000,0.400000},
-{0.075000,0.375000,0.200000,0.200000},
-{0.075000,0.375000,0.400000,0.400000},
-{0.125000,0.375000,0.200000,0.200000},
-{0.125000,0.375000,0.400000,0.400000},
-{0.175000,0.375000,0.200000,0.200000},
-{0.175000,0.375000,0.400000,0.400000},
-{0.225000,0.375000,0.200000,0.200000},
-{0.225000,0.375000,0.400000,0.400000},
-{0.275000,0.375000,0.200000,0.200000},
-{0.275000,0.375000,0.400000,0.400000},
-{0.325000,0.375000,0.200000,0.200000},
-{0.325000,0.375000,0.400000,0.400000},
-{0.375000,0.375000,0.200000,0.200000},
-{0.375000,0.375000,0.400000,0.400000},
-{0.425000,0.375000,0.200000,0.200000},
-{0.425000,0.375000,0.400000,0.400000},
-{0.475000,0.375000,0.200000,0.200000},
-{0.475000,0.375000,0.400000,0.400000},
-{0.525000,0.375000,0.200000,0.200000},
-{0.525000,0.375000,0.400000,0.400000},
-{0.575000,0.375000,0.200000,0.200000},
-{0.575000,0.375000,0.400000,0.400000},
-{0.625000,0.375000,0.200000,0.200000},
-{0.625000,0.375000,0.400000,0.400000},
-{0.675000,0.375000,0.200000,0.200000},
-{0.675000,0.375000,0.400000,0.400000},
-{0.725000,0.375000,0.200000,0.200000},
-{0.725000,0.375000,0.400000,0.400000},
-{0.775000,0.375000,0.200000,0.200000},
-{0.775000,0.375000,0.400000,0.400000},
-{0.825000,0.375000,0.200000,0.200000},
-{0.825000,0.375000,0.400000,0.400000},
-{0.875000,0.375000,0.200000,0.200000},
-{0.875000,0.375000,0.400000,0.400000},
-{0.925000,0.375000,0.200000,0.200000},
-{0.925000,0.375000,0.400000,0.400000},
-{0.975000,0.375000,0.200000,0.200000},
-{0.975000,0.375000,0.400000,0.400000},
-{0.025000,0.425000,0.200000,0.200000},
-{0.025000,0.425000,0.400000,0.400000},
-{0.075000,0.425000,0.200000,0.200000},
-{0.075000,0.425000,0.400000,0.400000},
-{0.125000,0.425000,0.200000,0.200000},
-{0.125000,0.425000,0.400000,0.400000},
-{0.175000,0.425000,0.200000,0.200000},
-{0.175000,0.425000,0.400000,0.400000},
-{0.225000,0.425000,0.200000,0.200000},
-{0.225000,0.425000,0.400000,0.400000},
-{0.275000,0.425000,0.200000,0.200000},
-{0.275000,0.425000,0.400000,0.400000},
-{0.325000,0.425000,0.200000,0.200000},
-{0.325000,0.425000,0.400000,0.400000},
-{0.375000,0.425000,0.200000,0.200000},
-{0.375000,0.425000,0.400000,0.400000},
-{0.425000,0.425000,0.200000,0.200000},
-{0.425000,0.425000,0.400000,0.400000},
-{0.475000,0.425000,0.200000,0.200000},
-{0.475000,0.425000,0.400000,0.400000},
-{0.525000,0.425000,0.200000,0.200000},
-{0.525000,0.425000,0.400000,0.400000},
-{0.575000,0.425000,0.200000,0.200000},
-{0.575000,0.425000,0.400000,0.400000},
-{0.625000,0.425000,0.200000,0.200000},
-{0.625000,0.425000,0.400000,0.400000},
-{0.675000,0.425000,0.200000,0.200000},
-{0.675000,0.425000,0.400000,0.400000},
-{0.725000,0.425000,0.200000,0.200000},
-{0.725000,0.425000,0.400000,0.400000},
-{0.775000,0.425000,0.200000,0.200000},
-{0.775000,0.425000,0.400000,0.400000},
-{0.825000,0.425000,0.200000,0.200000},
-{0.825000,0.425000,0.400000,0.400000},
-{0.875000,0.425000,0.200000,0.200000},
-{0.875000,0.425000,0.400000,0.400000},
-{0.925000,0.425000,0.200000,0.200000},
-{0.925000,0.425000,0.400000,0.400000},
-{0.975000,0.425000,0.200000,0.200000},
-{0.975000,0.425000,0.400000,0.400000},
-{0.025000,0.475000,0.200000,0.200000},
-{0.025000,0.475000,0.400000,0.400000},
-{0.075000,0.475000,0.200000,0.200000},
-{0.075000,0.475000,0.400000,0.400000},
-{0.125000,0.475000,0.200000,0.200000},
-{0.125000,0.475000,0.400000,0.400000},
-{0.175000,0.475000,0.200000,0.200000},
-{0.175000,0.475000,0.400000,0.400000},
-{0.225000,0.475000,0.200000,0.200000},
-{0.225000,0.475000,0.400000,0.400000},
-{0.275000,0.475000,0.200000,0.200000},
-{0.275000,0.475000,0.400000,0.400000},
-{0.325000,0.475000,0.200000,0.200000},
-{0.325000,0.475000,0.400000,0.400000},
-{0.375000,0.475000,0.200000,0.200000},
-{0.375000,0.475000,0.400000,0.400000},
-{0.425000,0.475000,0.200000,0.200000},
-{0.425000,0.475000,0.400000,0.400000},
-{0.475000,0.475000,0.200000,0.200000},
-{0.475000,0.475000,0.400000,0.400000},
-{0.525000,0.475000,0.200000,0.200000},
-{0.525000,0.475000,0.400000,0.400000},
-{0.575000,0.475000,0.200000,0.200000},
-{0.575000,0.475000,0.400000,0.400000},
-{0.625000,0.475000,0.200000,0.200000},
-{0.625000,0.475000,0.400000,0.400000},
-{0.675000,0.475000,0.200000,0.200000},
-{0.675000,0.475000,0.400000,0.400000},
-{0.725000,0.475000,0.200000,0.200000},
-{0.725000,0.475000,0.400000,0.400000},
-{0.775000,0.475000,0.200000,0.200000},
-{0.775000,0.475000,0.400000,0.400000},
-{0.825000,0.475000,0.200000,0.200000},
-{0.825000,0.475000,0.400000,0.400000},
-{0.875000,0.475000,0.200000,0.200000},
-{0.875000,0.475000,0.400000,0.400000},
-{0.925000,0.475000,0.200000,0.200000},
-{0.925000,0.475000,0.400000,0.400000},
-{0.975000,0.475000,0.200000,0.200000},
-{0.975000,0.475000,0.400000,0.400000},
-{0.025000,0.525000,0.200000,0.200000},
-{0.025000,0.525000,0.400000,0.400000},
-{0.075000,0.525000,0.200000,0.200000},
-{0.075000,0.525000,0.400000,0.400000},
-{0.125000,0.525000,0.200000,0.200000},
-{0.125000,0.525000,0.400000,0.400000},
-{0.175000,0.525000,0.200000,0.200000},
-{0.175000,0.525000,0.400000,0.400000},
-{0.225000,0.525000,0.200000,0.200000},
-{0.225000,0.525000,0.400000,0.400000},
-{0.275000,0.525000,0.200000,0.200000},
-{0.275000,0.525000,0.400000,0.400000},
-{0.325000,0.525000,0.200000,0.200000},
-{0.325000,0.525000,0.400000,0.400000},
-{0.375000,0.525000,0.200000,0.200000},
-{0.375000,0.525000,0.400000,0.400000},
-{0.425000,0.525000,0.200000,0.200000},
-{0.425000,0.525000,0.400000,0.400000},
-{0.475000,0.525000,0.200000,0.200000},
-{0.475000,0.525000,0.400000,0.400000},
-{0.525000,0.525000,0.200000,0.200000},
-{0.525000,0.525000,0.400000,0.400000},
-{0.575000,0.525000,0.200000,0.200000},
-{0.575000,0.525000,0.400000,0.400000},
-{0.625000,0.525000,0.200000,0.200000},
-{0.625000,0.525000,0.400000,0.400000},
-{0.675000,0.525000,0.200000,0.200000},
-{0.675000,0.525000,0.400000,0.400000},
-{0.725000,0.525000,0.200000,0.200000},
-{0.725000,0.525000,0.400000,0.400000},
-{0.775000,0.525000,0.200000,0.200000},
-{0.775000,0.525000,0.400000,0.400000},
-{0.825000,0.525000,0.200000,0.200000},
-{0.825000,0.525000,0.400000,0.400000},
-{0.875000,0.525000,0.200000,0.200000},
-{0.875000,0.525000,0.400000,0.400000},
-{0.925000,0.525000,0.200000,0.200000},
-{0.925000,0.525000,0.400000,0.400000},
-{0.975000,0.525000,0.200000,0.200000},
-{0.975000,0.525000,0.400000,0.400000},
-{0.025000,0.575000,0.200000,0.200000},
-{0.025000,0.575000,0.400000,0.400000},
-{0.075000,0.575000,0.200000,0.200000},
-{0.075000,0.575000,0.400000,0.400000},
-{0.125000,0.575000,0.200000,0.200000},
-{0.125000,0.575000,0.400000,0.400000},
-{0.175000,0.575000,0.200000,0.200000},
-{0.175000,0.575000,0.400000,0.400000},
-{0.225000,0.575000,0.200000,0.200000},
-{0.225000,0.575000,0.400000,0.400000},
-{0.275000,0.575000,0.200000,0.200000},
-{0.275000,0.575000,0.400000,0.400000},
-{0.325000,0.575000,0.200000,0.200000},
-{0.325000,0.575000,0.400000,0.400000},
-{0.375000,0.575000,0.200000,0.200000},
-{0.375000,0.575000,0.400000,0.400000},
-{0.425000,0.575000,0.200000,0.200000},
-{0.425000,0.575000,0.400000,0.400000},
-{0.475000,0.575000,0.200000,0.200000},
-{0.475000,0.575000,0.400000,0.400000},
-{0.525000,0.575000,0.200000,0.200000},
-{0.525000,0.575000,0.400000,0.400000},
-{0.575000,0.575000,0.200000,0.200000},
-{0.575000,0.575000,0.400000,0.400000},
-{0.625000,0.575000,0.200000,0.200000},
-{0.625000,0.575000,0.400000,0.400000},
-{0.675000,0.575000,0.200000,0.200000},
-{0.675000,0.575000,0.400000,0.400000},
-{0.725000,0.575000,0.200000,0.200000},
-{0.725000,0.575000,0.400000,0.400000},
-{0.775000,0.575000,0.200000,0.200000},
-{0.775000,0.575000,0.400000,0.400000},
-{0.825000,0.575000,0.200000,0.200000},
-{0.825000,0.575000,0.400000,0.400000},
-{0.875000,0.575000,0.200000,0.200000},
-{0.875000,0.575000,0.400000,0.400000},
-{0.925000,0.575000,0.200000,0.200000},
-{0.925000,0.575000,0.400000,0.400000},
-{0.975000,0.575000,0.200000,0.200000},
-{0.975000,0.575000,0.400000,0.400000},
-{0.025000,0.625000,0.200000,0.200000},
-{0.025000,0.625000,0.400000,0.400000},
-{0.075000,0.625000,0.200000,0.200000},
-{0.075000,0.625000,0.400000,0.400000},
-{0.125000,0.625000,0.200000,0.200000},
-{0.125000,0.625000,0.400000,0.400000},
-{0.175000,0.625000,0.200000,0.200000},
-{0.175000,0.625000,0.400000,0.400000},
-{0.225000,0.625000,0.200000,0.200000},
-{0.225000,0.625000,0.400000,0.400000},
-{0.275000,0.625000,0.200000,0.200000},
-{0.275000,0.625000,0.400000,0.400000},
-{0.325000,0.625000,0.200000,0.200000},
-{0.325000,0.625000,0.400000,0.400000},
-{0.375000,0.625000,0.200000,0.200000},
-{0.375000,0.625000,0.400000,0.400000},
-{0.425000,0.625000,0.200000,0.200000},
-{0.425000,0.625000,0.400000,0.400000},
-{0.475000,0.625000,0.200000,0.200000},
-{0.475000,0.625000,0.400000,0.400000},
-{0.525000,0.625000,0.200000,0.200000},
-{0.525000,0.625000,0.400000,0.400000},
-{0.575000,0.625000,0.200000,0.200000},
-{0.575000,0.625000,0.400000,0.400000},
-{0.625000,0.625000,0.200000,0.200000},
-{0.625000,0.625000,0.400000,0.400000},
-{0.675000,0.625000,0.200000,0.200000},
-{0.675000,0.625000,0.400000,0.400000},
-{0.725000,0.625000,0.200000,0.200000},
-{0.725000,0.625000,0.400000,0.400000},
-{0.775000,0.625000,0.200000,0.200000},
-{0.775000,0.625000,0.400000,0.400000},
-{0.825000,0.625000,0.200000,0.200000},
-{0.825000,0.625000,0.400000,0.400000},
-{0.875000,0.625000,0.200000,0.200000},
-{0.875000,0.625000,0.400000,0.400000},
-{0.925000,0.625000,0.200000,0.200000},
-{0.925000,0.625000,0.400000,0.400000},
-{0.975000,0.625000,0.200000,0.200000},
-{0.975000,0.625000,0.400000,0.400000},
-{0.025000,0.675000,0.200000,0.200000},
-{0.025000,0.675000,0.400000,0.400000},
-{0.075000,0.675000,0.200000,0.200000},
-{0.075000,0.675000,0.400000,0.400000},
-{0.125000,0.675000,0.200000,0.200000},
-{0.125000,0.675000,0.400000,0.400000},
-{0.175000,0.675000,0.200000,0.200000},
-{0.175000,0.675000,0.400000,0.400000},
-{0.225000,0.675000,0.200000,0.200000},
-{0.225000,0.675000,0.400000,0.400000},
-{0.275000,0.675000,0.200000,0.200000},
-{0.275000,0.675000,0.400000,0.400000},
-{0.325000,0.675000,0.200000,0.200000},
-{0.325000,0.675000,0.400000,0.400000},
-{0.375000,0.675000,0.200000,0.200000},
-{0.375000,0.675000,0.400000,0.400000},
-{0.425000,0.675000,0.200000,0.200000},
-{0.425000,0.675000,0.400000,0.400000},
-{0.475000,0.675000,0.200000,0.200000},
-{0.475000,0.675000,0.400000,0.400000},
-{0.525000,0.675000,0.200000,0.200000},
-{0.525000,0.675000,0.400000,0.400000},
-{0.575000,0.675000,0.200000,0.200000},
-{0.575000,0.675000,0.400000,0.400000},
-{0.625000,0.675000,0.200000,0.200000},
-{0.625000,0.675000,0.400000,0.400000},
-{0.675000,0.675000,0.200000,0.200000},
-{0.675000,0.675000,0.400000,0.400000},
-{0.725000,0.675000,0.200000,0.200000},
-{0.725000,0.675000,0.400000,0.400000},
-{0.775000,0.675000,0.200000,0.200000},
-{0.775000,0.675000,0.400000,0.400000},
-{0.825000,0.675000,0.200000,0.200000},
-{0.825000,0.675000,0.400000,0.400000},
-{0.875000,0.675000,0.200000,0.200000},
-{0.875000,0.675000,0.400000,0.400000},
-{0.925000,0.675000,0.200000,0.200000},
-{0.925000,0.675000,0.400000,0.400000},
-{0.975000,0.675000,0.200000,0.200000},
-{0.975000,0.675000,0.400000,0.400000},
-{0.025000,0.725000,0.200000,0.200000},
-{0.025000,0.725000,0.400000,0.400000},
-{0.075000,0.725000,0.200000,0.200000},
-{0.075000,0.725000,0.400000,0.400000},
-{0.125000,0.725000,0.200000,0.200000},
-{0.125000,0.725000,0.400000,0.400000},
-{0.175000,0.725000,0.200000,0.200000},
-{0.175000,0.725000,0.400000,0.400000},
-{0.225000,0.725000,0.200000,0.200000},
-{0.225000,0.725000,0.400000,0.400000},
-{0.275000,0.725000,0.200000,0.200000},
-{0.275000,0.725000,0.400000,0.400000},
-{0.325000,0.725000,0.200000,0.200000},
-{0.325000,0.725000,0.400000,0.400000},
-{0.375000,0.725000,0.200000,0.200000},
-{0.375000,0.725000,0.400000,0.400000},
-{0.425000,0.725000,0.200000,0.200000},
-{0.425000,0.725000,0.400000,0.400000},
-{0.475000,0.725000,0.200000,0.200000},
-{0.475000,0.725000,0.400000,0.400000},
-{0.525000,0.725000,0.200000,0.200000},
-{0.525000,0.725000,0.400000,0.400000},
-{0.575000,0.725000,0.200000,0.200000},
-{0.575000,0.725000,0.400000,0.400000},
-{0.625000,0.725000,0.200000,0.200000},
-{0.625000,0.725000,0.400000,0.400000},
-{0.675000,0.725000,0.200000,0.200000},
-{0.675000,0.725000,0.400000,0.400000},
-{0.725000,0.725000,0.200000,0.200000},
-{0.725000,0.725000,0.400000,0.400000},
-{0.775000,0.725000,0.200000,0.200000},
-{0.775000,0.725000,0.400000,0.400000},
-{0.825000,0.725000,0.200000,0.200000},
-{0.825000,0.725000,0.400000,0.400000},
-{0.875000,0.725000,0.200000,0.200000},
-{0.875000,0.725000,0.400000,0.400000},
-{0.925000,0.725000,0.200000,0.200000},
-{0.925000,0.725000,0.400000,0.400000},
-{0.975000,0.725000,0.200000,0.200000},
-{0.975000,0.725000,0.400000,0.400000},
-{0.025000,0.775000,0.200000,0.200000},
-{0.025000,0.775000,0.400000,0.400000},
-{0.075000,0.775000,0.200000,0.200000},
-{0.075000,0.775000,0.400000,0.400000},
-{0.125000,0.775000,0.200000,0.200000},
-{0.125000,0.775000,0.400000,0.400000},
-{0.175000,0.775000,0.200000,0.200000},
-{0.175000,0.775000,0.400000,0.400000},
-{0.225000,0.775000,0.200000,0.200000},
-{0.225000,0.775000,0.400000,0.400000},
-{0.275000,0.775000,0.200000,0.200000},
-{0.275000,0.775000,0.400000,0.400000},
-{0.325000,0.775000,0.200000,0.200000},
-{0.325000,0.775000,0.400000,0.400000},
-{0.375000,0.775000,0.200000,0.200000},
-{0.375000,0.775000,0.400000,0.400000},
-{0.425000,0.775000,0.200000,0.200000},
-{0.425000,0.775000,0.400000,0.400000},
-{0.475000,0.775000,0.200000,0.200000},
-{0.475000,0.775000,0.400000,0.400000},
-{0.525000,0.775000,0.200000,0.200000},
-{0.525000,0.775000,0.400000,0.400000},
-{0.575000,0.775000,0.200000,0.200000},
-{0.575000,0.775000,0.400000,0.400000},
-{0.625000,0.775000,0.200000,0.200000},
-{0.625000,0.775000,0.400000,0.400000},
-{0.675000,0.775000,0.200000,0.200000},
-{0.675000,0.775000,0.400000,0.400000},
-{0.725000,0.775000,0.200000,0.200000},
-{0.725000,0.775000,0.400000,0.400000},
-{0.775000,0.775000,0.200000,0.200000},
-{0.775000,0.775000,0.400000,0.400000},
-{0.825000,0.775000,0.200000,0.200000},
-{0.825000,0.775000,0.400000,0.400000},
-{0.875000,0.775000,0.200000,0.200000},
-{0.875000,0.775000,0.400000,0.400000},
-{0.925000,0.775000,0.200000,0.200000},
-{0.925000,0.775000,0.400000,0.400000},
-{0.975000,0.775000,0.200000,0.200000},
-{0.975000,0.775000,0.400000,0.400000},
-{0.025000,0.825000,0.200000,0.200000},
-{0.025000,0.825000,0.400000,0.400000},
-{0.075000,0.825000,0.200000,0.200000},
-{0.075000,0.825000,0.400000,0.400000},
-{0.125000,0.825000,0.200000,0.200000},
-{0.125000,0.825000,0.400000,0.400000},
-{0.175000,0.825000,0.200000,0.200000},
-{0.175000,0.825000,0.400000,0.400000},
-{0.225000,0.825000,0.200000,0.200000},
-{0.225000,0.825000,0.400000,0.400000},
-{0.275000,0.825000,0.200000,0.200000},
-{0.275000,0.825000,0.400000,0.400000},
-{0.325000,0.825000,0.200000,0.200000},
-{0.325000,0.825000,0.400000,0.400000},
-{0.375000,0.825000,0.200000,0.200000},
-{0.375000,0.825000,0.400000,0.400000},
-{0.425000,0.825000,0.200000,0.200000},
-{0.425000,0.825000,0.400000,0.400000},
-{0.475000,0.825000,0.200000,0.200000},
-{0.475000,0.825000,0.400000,0.400000},
-{0.525000,0.825000,0.200000,0.200000},
-{0.525000,0.825000,0.400000,0.400000},
-{0.575000,0.825000,0.200000,0.200000},
-{0.575000,0.825000,0.400000,0.400000},
-{0.625000,0.825000,0.200000,0.200000},
-{0.625000,0.825000,0.400000,0.400000},
-{0.675000,0.825000,0.200000,0.200000},
-{0.675000,0.825000,0.400000,0.400000},
-{0.725000,0.825000,0.200000,0.200000},
-{0.725000,0.825000,0.400000,0.400000},
-{0.775000,0.825000,0.200000,0.200000},
-{0.775000,0.825000,0.400000,0.400000},
-{0.825000,0.825000,0.200000,0.200000},
-{0.825000,0.825000,0.400000,0.400000},
-{0.875000,0.825000,0.200000,0.200000},
-{0.875000,0.825000,0.400000,0.400000},
-{0.925000,0.825000,0.200000,0.200000},
-{0.925000,0.825000,0.400000,0.400000},
-{0.975000,0.825000,0.200000,0.200000},
-{0.975000,0.825000,0.400000,0.400000},
-{0.025000,0.875000,0.200000,0.200000},
-{0.025000,0.875000,0.400000,0.400000},
-{0.075000,0.875000,0.200000,0.200000},
-{0.075000,0.875000,0.400000,0.400000},
-{0.125000,0.875000,0.200000,0.200000},
-{0.125000,0.875000,0.400000,0.400000},
-{0.175000,0.875000,0.200000,0.200000},
-{0.175000,0.875000,0.400000,0.400000},
-{0.225000,0.875000,0.200000,0.200000},
-{0.225000,0.875000,0.400000,0.400000},
-{0.275000,0.875000,0.200000,0.200000},
-{0.275000,0.875000,0.400000,0.400000},
-{0.325000,0.875000,0.200000,0.200000},
-{0.325000,0.875000,0.400000,0.400000},
-{0.375000,0.875000,0.200000,0.200000},
-{0.375000,0.875000,0.400000,0.400000},
-{0.425000,0.875000,0.200000,0.200000},
-{0.425000,0.875000,0.400000,0.400000},
-{0.475000,0.875000,0.200000,0.200000},
-{0.475000,0.875000,0.400000,0.400000},
-{0.525000,0.875000,0.200000,0.200000},
-{0.525000,0.875000,0.400000,0.400000},
-{0.575000,0.875000,0.200000,0.200000},
-{0.575000,0.875000,0.400000,0.400000},
-{0.625000,0.875000,0.200000,0.200000},
-{0.625000,0.875000,0.400000,0.400000},
-{0.675000,0.875000,0.200000,0.200000},
-{0.675000,0.875000,0.400000,0.400000},
-{0.725000,0.875000,0.200000,0.200000},
-{0.725000,0.875000,0.400000,0.400000},
-{0.775000,0.875000,0.200000,0.200000},
-{0.775000,0.875000,0.400000,0.400000},
-{0.825000,0.875000,0.200000,0.200000},
-{0.825000,0.875000,0.400000,0.400000},
-{0.875000,0.875000,0.200000,0.200000},
-{0.875000,0.875000,0.400000,0.400000},
-{0.925000,0.875000,0.200000,0.200000},
-{0.925000,0.875000,0.400000,0.400000},
-{0.975000,0.875000,0.200000,0.200000},
-{0.975000,0.875000,0.400000,0.400000},
-{0.025000,0.925000,0.200000,0.200000},
-{0.025000,0.925000,0.400000,0.400000},
-{0.075000,0.925000,0.200000,0.200000},
-{0.075000,0.925000,0.400000,0.400000},
-{0.125000,0.925000,0.200000,0.200000},
-{0.125000,0.925000,0.400000,0.400000},
-{0.175000,0.925000,0.200000,0.200000},
-{0.175000,0.925000,0.400000,0.400000},
-{0.225000,0.925000,0.200000,0.200000},
-{0.225000,0.925000,0.400000,0.400000},
-{0.275000,0.925000,0.200000,0.200000},
-{0.275000,0.925000,0.400000,0.400000},
-{0.325000,0.925000,0.200000,0.200000},
-{0.325000,0.925000,0.400000,0.400000},
-{0.375000,0.925000,0.200000,0.200000},
-{0.375000,0.925000,0.400000,0.400000},
-{0.425000,0.925000,0.200000,0.200000},
-{0.425000,0.925000,0.400000,0.400000},
-{0.475000,0.925000,0.200000,0.200000},
-{0.475000,0.925000,0.400000,0.400000},
-{0.525000,0.925000,0.200000,0.200000},
-{0.525000,0.925000,0.400000,0.400000},
-{0.575000,0.925000,0.200000,0.200000},
-{0.575000,0.925000,0.400000,0.400000},
-{0.625000,0.925000,0.200000,0.200000},
-{0.625000,0.925000,0.400000,0.400000},
-{0.675000,0.925000,0.200000,0.200000},
-{0.675000,0.925000,0.400000,0.400000},
-{0.725000,0.925000,0.200000,0.200000},
-{0.725000,0.925000,0.400000,0.400000},
-{0.775000,0.925000,0.200000,0.200000},
-{0.775000,0.925000,0.400000,0.400000},
-{0.825000,0.925000,0.200000,0.200000},
-{0.825000,0.925000,0.400000,0.400000},
-{0.875000,0.925000,0.200000,0.200000},
-{0.875000,0.925000,0.400000,0.400000},
-{0.925000,0.925000,0.200000,0.200000},
-{0.925000,0.925000,0.400000,0.400000},
-{0.975000,0.925000,0.200000,0.200000},
-{0.975000,0.925000,0.400000,0.400000},
-{0.025000,0.975000,0.200000,0.200000},
-{0.025000,0.975000,0.400000,0.400000},
-{0.075000,0.975000,0.200000,0.200000},
-{0.075000,0.975000,0.400000,0.400000},
-{0.125000,0.975000,0.200000,0.200000},
-{0.125000,0.975000,0.400000,0.400000},
-{0.175000,0.975000,0.200000,0.200000},
-{0.175000,0.975000,0.400000,0.400000},
-{0.225000,0.975000,0.200000,0.200000},
-{0.225000,0.975000,0.400000,0.400000},
-{0.275000,0.975000,0.200000,0.200000},
-{0.275000,0.975000,0.400000,0.400000},
-{0.325000,0.975000,0.200000,0.200000},
-{0.325000,0.975000,0.400000,0.400000},
-{0.375000,0.975000,0.200000,0.200000},
-{0.375000,0.975000,0.400000,0.400000},
-{0.425000,0.975000,0.200000,0.200000},
-{0.425000,0.975000,0.400000,0.400000},
-{0.475000,0.975000,0.200000,0.200000},
-{0.475000,0.975000,0.400000,0.400000},
-{0.525000,0.975000,0.200000,0.200000},
-{0.525000,0.975000,0.400000,0.400000},
-{0.575000,0.975000,0.200000,0.200000},
-{0.575000,0.975000,0.400000,0.400000},
-{0.625000,0.975000,0.200000,0.200000},
-{0.625000,0.975000,0.400000,0.400000},
-{0.675000,0.975000,0.200000,0.200000},
-{0.675000,0.975000,0.400000,0.400000},
-{0.725000,0.975000,0.200000,0.200000},
-{0.725000,0.975000,0.400000,0.400000},
-{0.775000,0.975000,0.200000,0.200000},
-{0.775000,0.975000,0.400000,0.400000},
-{0.825000,0.975000,0.200000,0.200000},
-{0.825000,0.975000,0.400000,0.400000},
-{0.875000,0.975000,0.200000,0.200000},
-{0.875000,0.975000,0.400000,0.400000},
-{0.925000,0.975000,0.200000,0.200000},
-{0.925000,0.975000,0.400000,0.400000},
-{0.975000,0.975000,0.200000,0.200000},
-{0.975000,0.975000,0.400000,0.400000},
-{0.050000,0.050000,0.800000,0.800000},
-{0.050000,0.050000,1.600000,1.600000},
-{0.150000,0.050000,0.800000,0.800000},
-{0.150000,0.050000,1.600000,1.600000},
-{0.250000,0.050000,0.800000,0.800000},
-{0.250000,0.050000,1.600000,1.600000},
-{0.350000,0.050000,0.800000,0.800000},
-{0.350000,0.050000,1.600000,1.600000},
-{0.450000,0.050000,0.800000,0.800000},
-{0.450000,0.050000,1.600000,1.600000},
-{0.550000,0.050000,0.800000,0.800000},
-{0.550000,0.050000,1.600000,1.600000},
-{0.650000,0.050000,0.800000,0.800000},
-{0.650000,0.050000,1.600000,1.600000},
-{0.750000,0.050000,0.800000,0.800000},
-{0.750000,0.050000,1.600000,1.600000},
-{0.850000,0.050000,0.800000,0.800000},
-{0.850000,0.050000,1.600000,1.600000},
-{0.950000,0.050000,0.800000,0.800000},
-{0.950000,0.050000,1.600000,1.600000},
-{0.050000,0.150000,0.800000,0.800000},
-{0.050000,0.150000,1.600000,1.600000},
-{0.150000,0.150000,0.800000,0.800000},
-{0.150000,0.150000,1.600000,1.600000},
-{0.250000,0.150000,0.800000,0.800000},
-{0.250000,0.150000,1.600000,1.600000},
-{0.350000,0.150000,0.800000,0.800000},
-{0.350000,0.150000,1.600000,1.600000},
-{0.450000,0.150000,0.800000,0.800000},
-{0.450000,0.150000,1.600000,1.600000},
-{0.550000,0.150000,0.800000,0.800000},
-{0.550000,0.150000,1.600000,1.600000},
-{0.650000,0.150000,0.800000,0.800000},
-{0.650000,0.150000,1.600000,1.600000},
-{0.750000,0.150000,0.800000,0.800000},
-{0.750000,0.150000,1.600000,1.600000},
-{0.850000,0.150000,0.800000,0.800000},
-{0.850000,0.150000,1.600000,1.600000},
-{0.950000,0.150000,0.800000,0.800000},
-{0.950000,0.150000,1.600000,1.600000},
-{0.050000,0.250000,0.800000,0.800000},
-{0.050000,0.250000,1.600000,1.600000},
-{0.150000,0.250000,0.800000,0.800000},
-{0.150000,0.250000,1.600000,1.600000},
-{0.250000,0.250000,0.800000,0.800000},
-{0.250000,0.250000,1.600000,1.600000},
-{0.350000,0.250000,0.800000,0.800000},
-{0.350000,0.250000,1.600000,1.600000},
-{0.450000,0.250000,0.800000,0.800000},
-{0.450000,0.250000,1.600000,1.600000},
-{0.550000,0.250000,0.800000,0.800000},
-{0.550000,0.250000,1.600000,1.600000},
-{0.650000,0.250000,0.800000,0.800000},
-{0.650000,0.250000,1.600000,1.600000},
-{0.750000,0.250000,0.800000,0.800000},
-{0.750000,0.250000,1.600000,1.600000},
-{0.850000,0.250000,0.800000,0.800000},
-{0.850000,0.250000,1.600000,1.600000},
-{0.950000,0.250000,0.800000,0.800000},
-{0.950000,0.250000,1.600000,1.600000},
-{0.050000,0.350000,0.800000,0.800000},
-{0.050000,0.350000,1.600000,1.600000},
-{0.150000,0.350000,0.800000,0.800000},
-{0.150000,0.350000,1.600000,1.600000},
-{0.250000,0.350000,0.800000,0.800000},
-{0.250000,0.350000,1.600000,1.600000},
-{0.350000,0.350000,0.800000,0.800000},
-{0.350000,0.350000,1.600000,1.600000},
-{0.450000,0.350000,0.800000,0.800000},
-{0.450000,0.350000,1.600000,1.600000},
-{0.550000,0.350000,0.800000,0.800000},
-{0.550000,0.350000,1.600000,1.600000},
-{0.650000,0.350000,0.800000,0.800000},
-{0.650000,0.350000,1.600000,1.600000},
-{0.750000,0.350000,0.800000,0.800000},
-{0.750000,0.350000,1.600000,1.600000},
-{0.850000,0.350000,0.800000,0.800000},
-{0.850000,0.350000,1.600000,1.600000},
-{0.950000,0.350000,0.800000,0.800000},
-{0.950000,0.350000,1.600000,1.600000},
-{0.050000,0.450000,0.800000,0.800000},
-{0.050000,0.450000,1.600000,1.600000},
-{0.150000,0.450000,0.800000,0.800000},
-{0.150000,0.450000,1.600000,1.600000},
-{0.250000,0.450000,0.800000,0.800000},
-{0.250000,0.450000,1.600000,1.600000},
-{0.350000,0.450000,0.800000,0.800000},
-{0.350000,0.450000,1.600000,1.600000},
-{0.450000,0.450000,0.800000,0.800000},
-{0.450000,0.450000,1.600000,1.600000},
-{0.550000,0.450000,0.800000,0.800000},
-{0.550000,0.450000,1.600000,1.600000},
-{0.650000,0.450000,0.800000,0.800000},
-{0.650000,0.450000,1.600000,1.600000},
-{0.750000,0.450000,0.800000,0.800000},
-{0.750000,0.450000,1.600000,1.600000},
-{0.850000,0.450000,0.800000,0.800000},
-{0.850000,0.450000,1.600000,1.600000},
-{0.950000,0.450000,0.800000,0.800000},
-{0.950000,0.450000,1.600000,1.600000},
-{0.050000,0.550000,0.800000,0.800000},
-{0.050000,0.550000,1.600000,1.600000},
-{0.150000,0.550000,0.800000,0.800000},
-{0.150000,0.550000,1.600000,1.600000},
-{0.250000,0.550000,0.800000,0.800000},
-{0.250000,0.550000,1.600000,1.600000},
-{0.350000,0.550000,0.800000,0.800000},
-{0.350000,0.550000,1.600000,1.600000},
-{0.450000,0.550000,0.800000,0.800000},
-{0.450000,0.550000,1.600000,1.600000},
-{0.550000,0.550000,0.800000,0.800000},
-{0.550000,0.550000,1.600000,1.600000},
-{0.650000,0.550000,0.800000,0.800000},
-{0.650000,0.550000,1.600000,1.600000},
-{0.750000,0.550000,0.800000,0.800000},
-{0.750000,0.550000,1.600000,1.600000},
-{0.850000,0.550000,0.800000,0.800000},
-{0.850000,0.550000,1.600000,1.600000},
-{0.950000,0.550000,0.800000,0.800000},
-{0.950000,0.550000,1.600000,1.600000},
-{0.050000,0.650000,0.800000,0.800000},
-{0.050000,0.650000,1.600000,1.600000},
-{0.150000,0.650000,0.800000,0.800000},
-{0.150000,0.650000,1.600000,1.600000},
-{0.250000,0.650000,0.800000,0.800000},
-{0.250000,0.650000,1.600000,1.600000},
-{0.350000,0.650000,0.800000,0.800000},
-{0.350000,0.650000,1.600000,1.600000},
-{0.450000,0.650000,0.800000,0.800000},
-{0.450000,0.650000,1.600000,1.600000},
-{0.550000,0.650000,0.800000,0.800000},
-{0.550000,0.650000,1.600000,1.600000},
-{0.650000,0.650000,0.800000,0.800000},
-{0.650000,0.650000,1.600000,1.600000},
-{0.750000,0.650000,0.800000,0.800000},
-{0.750000,0.650000,1.600000,1.600000},
-{0.850000,0.650000,0.800000,0.800000},
-{0.850000,0.650000,1.600000,1.600000},
-{0.950000,0.650000,0.800000,0.800000},
-{0.950000,0.650000,1.600000,1.600000},
-{0.050000,0.750000,0.800000,0.800000},
-{0.050000,0.750000,1.600000,1.600000},
-{0.150000,0.750000,0.800000,0.800000},
-{0.150000,0.750000,1.600000,1.600000},
-{0.250000,0.750000,0.800000,0.800000},
-{0.250000,0.750000,1.600000,1.600000},
-{0.350000,0.750000,0.800000,0.800000},
-{0.350000,0.750000,1.600000,1.600000},
-{0.450000,0.750000,0.800000,0.800000},
-{0.450000,0.750000,1.600000,1.600000},
-{0.550000,0.750000,0.800000,0.800000},
-{0.550000,0.750000,1.600000,1.600000},
-{0.650000,0.750000,0.800000,0.800000},
-{0.650000,0.750000,1.600000,1.600000},
-{0.750000,0.750000,0.800000,0.800000},
-{0.750000,0.750000,1.600000,1.600000},
-{0.850000,0.750000,0.800000,0.800000},
-{0.850000,0.750000,1.600000,1.600000},
-{0.950000,0.750000,0.800000,0.800000},
-{0.950000,0.750000,1.600000,1.600000},
-{0.050000,0.850000,0.800000,0.800000},
-{0.050000,0.850000,1.600000,1.600000},
-{0.150000,0.850000,0.800000,0.800000},
-{0.150000,0.850000,1.600000,1.600000},
-{0.250000,0.850000,0.800000,0.800000},
-{0.250000,0.850000,1.600000,1.600000},
-{0.350000,0.850000,0.800000,0.800000},
-{0.350000,0.850000,1.600000,1.600000},
-{0.450000,0.850000,0.800000,0.800000},
-{0.450000,0.850000,1.600000,1.600000},
-{0.550000,0.850000,0.800000,0.800000},
-{0.550000,0.850000,1.600000,1.600000},
-{0.650000,0.850000,0.800000,0.800000},
-{0.650000,0.850000,1.600000,1.600000},
-{0.750000,0.850000,0.800000,0.800000},
-{0.750000,0.850000,1.600000,1.600000},
-{0.850000,0.850000,0.800000,0.800000},
-{0.850000,0.850000,1.600000,1.600000},
-{0.950000,0.850000,0.800000,0.800000},
-{0.950000,0.850000,1.600000,1.600000},
-{0.050000,0.950000,0.800000,0.800000},
-{0.050000,0.950000,1.600000,1.600000},
-{0.150000,0.950000,0.800000,0.800000},
-{0.150000,0.950000,1.600000,1.600000},
-{0.250000,0.950000,0.800000,0.800000},
-{0.250000,0.950000,1.600000,1.600000},
-{0.350000,0.950000,0.800000,0.800000},
-{0.350000,0.950000,1.600000,1.600000},
-{0.450000,0.950000,0.800000,0.800000},
-{0.450000,0.950000,1.600000,1.600000},
-{0.550000,0.950000,0.800000,0.800000},
-{0.550000,0.950000,1.600000,1.600000},
-{0.650000,0.950000,0.800000,0.800000},
-{0.650000,0.950000,1.600000,1.600000},
-{0.750000,0.950000,0.800000,0.800000},
-{0.750000,0.950000,1.600000,1.600000},
-{0.850000,0.950000,0.800000,0.800000},
-{0.850000,0.950000,1.600000,1.600000},
-{0.950000,0.950000,0.800000,0.800000},
-{0.950000,0.950000,1.600000,1.600000}
-};
-
-const float BOX_PRIORS_640[16800][4] = {
-{0.006250,0.006250,0.025000,0.025000},
-{0.006250,0.006250,0.050000,0.050000},
-{0.018750,0.006250,0.025000,0.025000},
-{0.018750,0.006250,0.050000,0.050000},
-{0.031250,0.006250,0.025000,0.025000},
-{0.031250,0.006250,0.050000,0.050000},
-{0.043750,0.006250,0.025000,0.025000},
-{0.043750,0.006250,0.050000,0.050000},
-{0.056250,0.006250,0.025000,0.025000},
-{0.056250,0.006250,0.050000,0.050000},
-{0.068750,0.006250,0.025000,0.025000},
-{0.068750,0.006250,0.050000,0.050000},
-{0.081250,0.006250,0.025000,0.025000},
-{0.081250,0.006250,0.050000,0.050000},
-{0.093750,0.006250,0.025000,0.025000},
-{0.093750,0.006250,0.050000,0.050000},
-{0.106250,0.006250,0.025000,0.025000},
-{0.106250,0.006250,0.050000,0.050000},
-{0.118750,0.006250,0.025000,0.025000},
-{0.118750,0.006250,0.050000,0.050000},
-{0.131250,0.006250,0.025000,0.025000},
-{0.131250,0.006250,0.050000,0.050000},
-{0.143750,0.006250,0.025000,0.025000},
-{0.143750,0.006250,0.050000,0.050000},
-{0.156250,0.006250,0.025000,0.025000},
-{0.156250,0.006250,0.050000,0.050000},
-{0.168750,0.006250,0.025000,0.025000},
-{0.168750,0.006250,0.050000,0.050000},
-{0.181250,0.006250,0.025000,0.025000},
-{0.181250,0.006250,0.050000,0.050000},
-{0.193750,0.006250,0.025000,0.025000},
-{0.193750,0.006250,0.050000,0.050000},
-{0.206250,0.006250,0.025000,0.025000},
-{0.206250,0.006250,0.050000,0.050000},
-{0.218750,0.006250,0.025000,0.025000},
-{0.218750,0.006250,0.050000,0.050000},
-{0.231250,0.006250,0.025000,0.025000},
-{0.231250,0.006250,0.050000,0.050000},
-{0.243750,0.006250,0.025000,0.025000},
-{0.243750,0.006250,0.050000,0.050000},
-{0.256250,0.006250,0.025000,0.025000},
-{0.256250,0.006250,0.050000,0.050000},
-{0.268750,0.006250,0.025000,0.025000},
-{0.268750,0.006250,0.050000,0.050000},
-{0.281250,0.006250,0.025000,0.025000},
-{0.281250,0.006250,0.050000,0.050000},
-{0.293750,0.006250,0.025000,0.025000},
-{0.293750,0.006250,0.050000,0.050000},
-{0.306250,0.006250,0.025000,0.025000},
-{0.306250,0.006250,0.050000,0.050000},
-{0.318750,0.006250,0.025000,0.025000},
-{0.318750,0.006250,0.050000,0.050000},
-{0.331250,0.006250,0.025000,0.025000},
-{0.331250,0.006250,0.050000,0.050000},
-{0.343750,0.006250,0.025000,0.025000},
-{0.343750,0.006250,0.050000,0.050000},
-{0.356250,0.006250,0.025000,0.025000},
-{0.356250,0.006250,0.050000,0.050000},
-{0.368750,0.006250,0.025000,0.025000},
-{0.368750,0.006250,0.050000,0.050000},
-{0.381250,0.006250,0.025000,0.025000},
-{0.381250,0.006250,0.050000,0.050000},
-{0.393750,0.006250,0.025000,0.025000},
-{0.393750,0.006250,0.050000,0.050000},
-{0.406250,0.006250,0.025000,0.025000},
-{0.406250,0.006250,0.050000,0.050000},
-{0.418750,0.006250,0.025000,0.025000},
-{0.418750,0.006250,0.050000,0.050000},
-{0.431250,0.006250,0.025000,0.025000},
-{0.431250,0.006250,0.050000,0.050000},
-{0.443750,0.006250,0.025000,0.025000},
-{0.443750,0.006250,0.050000,0.050000},
-{0.456250,0.006250,0.025000,0.025000},
-{0.456250,0.006250,0.050000,0.050000},
-{0.468750,0.006250,0.025000,0.025000},
-{0.468750,0.006250,0.050000,0.050000},
-{0.481250,0.006250,0.025000,0.025000},
-{0.481250,0.006250,0.050000,0.050000},
-{0.493750,0.006250,0.025000,0.025000},
-{0.493750,0.006250,0.050000,0.050000},
-{0.506250,0.006250,0.025000,0.025000},
-{0.506250,0.006250,0.050000,0.050000},
-{0.518750,0.006250,0.025000,0.025000},
-{0.518750,0.006250,0.050000,0.050000},
-{0.531250,0.006250,0.025000,0.025000},
-{0.531250,0.006250,0.050000,0.050000},
-{0.543750,0.006250,0.025000,0.025000},
-{0.543750,0.006250,0.050000,0.050000},
-{0.556250,0.006250,0.025000,0.025000},
-{0.556250,0.006250,0.050000,0.050000},
-{0.568750,0.006250,0.025000,0.025000},
-{0.568750,0.006250,0.050000,0.050000},
-{0.581250,0.006250,0.025000,0.025000},
-{0.581250,0.006250,0.050000,0.050000},
-{0.593750,0.006250,0.025000,0.025000},
-{0.593750,0.006250,0.050000,0.050000},
-{0.606250,0.006250,0.025000,0.025000},
-{0.606250,0.006250,0.050000,0.050000},
-{0.618750,0.006250,0.025000,0.025000},
-{0.618750,0.006250,0.050000,0.050000},
-{0.631250,0.006250,0.025000,0.025000},
-{0.631250,0.006250,0.050000,0.050000},
-{0.643750,0.006250,0.025000,0.025000},
-{0.643750,0.006250,0.050000,0.050000},
-{0.656250,0.006250,0.025000,0.025000},
-{0.656250,0.006250,0.050000,0.050000},
-{0.668750,0.006250,0.025000,0.025000},
-{0.668750,0.006250,0.050000,0.050000},
-{0.681250,0.006250,0.025000,0.025000},
-{0.681250,0.006250,0.050000,0.050000},
-{0.693750,0.006250,0.025000,0.025000},
-{0.693750,0.006250,0.050000,0.050000},
-{0.706250,0.006250,0.025000,0.025000},
-{0.706250,0.006250,0.050000,0.050000},
-{0.718750,0.006250,0.025000,0.025000},
-{0.718750,0.006250,0.050000,0.050000},
-{0.731250,0.006250,0.025000,0.025000},
-{0.731250,0.006250,0.050000,0.050000},
-{0.743750,0.006250,0.025000,0.025000},
-{0.743750,0.006250,0.050000,0.050000},
-{0.756250,0.006250,0.025000,0.025000},
-{0.756250,0.006250,0.050000,0.050000},
-{0.768750,0.006250,0.025000,0.025000},
-{0.768750,0.006250,0.050000,0.050000},
-{0.781250,0.006250,0.025000,0.025000},
-{0.781250,0.006250,0.050000,0.050000},
-{0.793750,0.006250,0.025000,0.025000},
-{0.793750,0.006250,0.050000,0.050000},
-{0.806250,0.006250,0.025000,0.025000},
-{0.806250,0.006250,0.050000,0.050000},
-{0.818750,0.006250,0.025000,0.025000},
-{0.818750,0.006250,0.050000,0.050000},
-{0.831250,0.006250,0.025000,0.025000},
-{0.831250,0.006250,0.050000,0.050000},
-{0.843750,0.006250,0.025000,0.025000},
-{0.843750,0.006250,0.050000,0.050000},
-{0.856250,0.006250,0.025000,0.025000},
-{0.856250,0.006250,0.050000,0.050000},
-{0.868750,0.006250,0.025000,0.025000},
-{0.868750,0.006250,0.050000,0.050000},
-{0.881250,0.006250,0.025000,0.025000},
-{0.881250,0.006250,0.050000,0.050000},
-{0.893750,0.006250,0.025000,0.025000},
-{0.893750,0.006250,0.050000,0.050000},
-{0.906250,0.006250,0.025000,0.025000},
-{0.906250,0.006250,0.050000,0.050000},
-{0.918750,0.006250,0.025000,0.025000},
-{0.918750,0.006250,0.050000,0.050000},
-{0.931250,0.006250,0.025000,0.025000},
-{0.931250,0.006250,0.050000,0.050000},
-{0.943750,0.006250,0.025000,0.025000},
-{0.943750,0.006250,0.050000,0.050000},
-{0.956250,0.006250,0.025000,0.025000},
-{0.956250,0.006250,0.050000,0.050000},
-{0.968750,0.006250,0.025000,0.025000},
-{0.968750,0.006250,0.050000,0.050000},
-{0.981250,0.006250,0.025000,0.025000},
-{0.981250,0.006250,0.050000,0.050000},
-{0.993750,0.006250,0.025000,0.025000},
-{0.993750,0.006250,0.050000,0.050000},
-{0.006250,0.018750,0.025000,0.025000},
-{0.006250,0.018750,0.050000,0.050000},
-{0.018750,0.018750,0.025000,0.025000},
-{0.018750,0.018750,0.050000,0.050000},
-{0.031250,0.018750,0.025000,0.025000},
-{0.031250,0.018750,0.050000,0.050000},
-{0.043750,0.018750,0.025000,0.025000},
-{0.043750,0.018750,0.050000,0.050000},
-{0.056250,0.018750,0.025000,0.025000},
-{0.056250,0.018750,0.050000,0.050000},
-{0.068750,0.018750,0.025000,0.025000},
-{0.068750,0.018750,0.050000,0.050000},
-{0.081250,0.018750,0.025000,0.025000},
-{0.081250,0.018750,0.050000,0.050000},
-{0.093750,0.018750,0.025000,0.025000},
-{0.093750,0.018750,0.050000,0.050000},
-{0.106250,0.018750,0.025000,0.025000},
-{0.106250,0.018750,0.050000,0.050000},
-{0.118750,0.018750,0.025000,0.025000},
-{0.118750,0.018750,0.050000,0.050000},
-{0.131250,0.018750,0.025000,0.025000},
-{0.131250,0.018750,0.050000,0.050000},
-{0.143750,0.018750,0.025000,0.025000},
-{0.143750,0.018750,0.050000,0.050000},
-{0.156250,0.018750,0.025000,0.025000},
-{0.156250,0.018750,0.050000,0.050000},
-{0.168750,0.018750,0.025000,0.025000},
-{0.168750,0.018750,0.050000,0.050000},
-{0.181250,0.018750,0.025000,0.025000},
-{0.181250,0.018750,0.050000,0.050000},
-{0.193750,0.018750,0.025000,0.025000},
-{0.193750,0.018750,0.050000,0.050000},
-{0.206250,0.018750,0.025000,0.025000},
-{0.206250,0.018750,0.050000,0.050000},
-{0.218750,0.018750,0.025000,0.025000},
-{0.218750,0.018750,0.050000,0.050000},
-{0.231250,0.018750,0.025000,0.025000},
-{0.231250,0.018750,0.050000,0.050000},
-{0.243750,0.018750,0.025000,0.025000},
-{0.243750,0.018750,0.050000,0.050000},
-{0.256250,0.018750,0.025000,0.025000},
-{0.256250,0.018750,0.050000,0.050000},
-{0.268750,0.018750,0.025000,0.025000},
-{0.268750,0.018750,0.050000,0.050000},
-{0.281250,0.018750,0.025000,0.025000},
-{0.281250,0.018750,0.050000,0.050000},
-{0.293750,0.018750,0.025000,0.025000},
-{0.293750,0.018750,0.050000,0.050000},
-{0.306250,0.018750,0.025000,0.025000},
-{0.306250,0.018750,0.050000,0.050000},
-{0.318750,0.018750,0.025000,0.025000},
-{0.318750,0.018750,0.050000,0.050000},
-{0.331250,0.018750,0.025000,0.025000},
-{0.331250,0.018750,0.050000,0.050000},
-{0.343750,0.018750,0.025000,0.025000},
-{0.343750,0.018750,0.050000,0.050000},
-{0.356250,0.018750,0.025000,0.025000},
-{0.356250,0.018750,0.050000,0.050000},
-{0.368750,0.018750,0.025000,0.025000},
-{0.368750,0.018750,0.050000,0.050000},
-{0.381250,0.018750,0.025000,0.025000},
-{0.381250,0.018750,0.050000,0.050000},
-{0.393750,0.018750,0.025000,0.025000},
-{0.393750,0.018750,0.050000,0.050000},
-{0.406250,0.018750,0.025000,0.025000},
-{0.406250,0.018750,0.050000,0.050000},
-{0.418750,0.018750,0.025000,0.025000},
-{0.418750,0.018750,0.050000,0.050000},
-{0.431250,0.018750,0.025000,0.025000},
-{0.431250,0.018750,0.050000,0.050000},
-{0.443750,0.018750,0.025000,0.025000},
-{0.443750,0.018750,0.050000,0.050000},
-{0.456250,0.018750,0.025000,0.025000},
-{0.456250,0.018750,0.050000,0.050000},
-{0.468750,0.018750,0.025000,0.025000},
-{0.468750,0.018750,0.050000,0.050000},
-{0.481250,0.018750,0.025000,0.025000},
-{0.481250,0.018750,0.050000,0.050000},
-{0.493750,0.018750,0.025000,0.025000},
-{0.493750,0.018750,0.050000,0.050000},
-{0.506250,0.018750,0.025000,0.025000},
-{0.506250,0.018750,0.050000,0.050000},
-{0.518750,0.018750,0.025000,0.025000},
-{0.518750,0.018750,0.050000,0.050000},
-{0.531250,0.018750,0.025000,0.025000},
-{0.531250,0.018750,0.050000,0.050000},
-{0.543750,0.018750,0.025000,0.025000},
-{0.543750,0.018750,0.050000,0.050000},
-{0.556250,0.018750,0.025000,0.025000},
-{0.556250,0.018750,0.050000,0.050000},
-{0.568750,0.018750,0.025000,0.025000},
-{0.568750,0.018750,0.050000,0.050000},
-{0.581250,0.018750,0.025000,0.025000},
-{0.581250,0.018750,0.050000,0.050000},
-{0.593750,0.018750,0.025000,0.025000},
-{0.593750,0.018750,0.050000,0.050000},
-{0.606250,0.018750,0.025000,0.025000},
-{0.606250,0.018750,0.050000,0.050000},
-{0.618750,0.018750,0.025000,0.025000},
-{0.618750,0.018750,0.050000,0.050000},
-{0.631250,0.018750,0.025000,0.025000},
-{0.631250,0.018750,0.050000,0.050000},
-{0.643750,0.018750,0.025000,0.025000},
-{0.643750,0.018750,0.050000,0.050000},
-{0.656250,0.018750,0.025000,0.025000},
-{0.656250,0.018750,0.050000,0.050000},
-{0.668750,0.018750,0.025000,0.025000},
-{0.668750,0.018750,0.050000,0.050000},
-{0.681250,0.018750,0.025000,0.025000},
-{0.681250,0.018750,0.050000,0.050000},
-{0.693750,0.018750,0.025000,0.025000},
-{0.693750,0.018750,0.050000,0.050000},
-{0.706250,0.018750,0.025000,0.025000},
-{0.706250,0.018750,0.050000,0.050000},
-{0.718750,0.018750,0.025000,0.025000},
-{0.718750,0.018750,0.050000,0.050000},
-{0.731250,0.018750,0.025000,0.025000},
-{0.731250,0.018750,0.050000,0.050000},
-{0.743750,0.018750,0.025000,0.025000},
-{0.743750,0.018750,0.050000,0.050000},
-{0.756250,0.018750,0.025000,0.025000},
-{0.756250,0.018750,0.050000,0.050000},
-{0.768750,0.018750,0.025000,0.025000},
-{0.768750,0.018750,0.050000,0.050000},
-{0.781250,0.018750,0.025000,0.025000},
-{0.781250,0.018750,0.050000,0.050000},
-{0.793750,0.018750,0.025000,0.025000},
-{0.793750,0.018750,0.050000,0.050000},
-{0.806250,0.018750,0.025000,0.025000},
-{0.806250,0.018750,0.050000,0.050000},
-{0.818750,0.018750,0.025000,0.025000},
-{0.818750,0.018750,0.050000,0.050000},
-{0.831250,0.018750,0.025000,0.025000},
-{0.831250,0.018750,0.050000,0.050000},
-{0.843750,0.018750,0.025000,0.025000},
-{0.843750,0.018750,0.050000,0.050000},
-{0.856250,0.018750,0.025000,0.025000},
-{0.856250,0.018750,0.050000,0.050000},
-{0.868750,0.018750,0.025000,0.025000},
-{0.868750,0.018750,0.050000,0.050000},
-{0.881250,0.018750,0.025000,0.025000},
-{0.881250,0.018750,0.050000,0.050000},
-{0.893750,0.018750,0.025000,0.025000},
-{0.893750,0.018750,0.050000,0.050000},
-{0.906250,0.018750,0.025000,0.025000},
-{0.906250,0.018750,0.050000,0.050000},
-{0.918750,0.018750,0.025000,0.025000},
-{0.918750,0.018750,0.050000,0.050000},
-{0.931250,0.018750,0.025000,0.025000},
-{0.931250,0.018750,0.050000,0.050000},
-{0.943750,0.018750,0.025000,0.025000},
-{0.943750,0.018750,0.050000,0.050000},
-{0.956250,0.018750,0.025000,0.025000},
-{0.956250,0.018750,0.050000,0.050000},
-{0.968750,0.018750,0.025000,0.025000},
-{0.968750,0.018750,0.050000,0.050000},
-{0.981250,0.018750,0.025000,0.025000},
-{0.981250,0.018750,0.050000,0.050000},
-{0.993750,0.018750,0.025000,0.025000},
-{0.993750,0.018750,0.050000,0.050000},
-{0.006250,0.031250,0.025000,0.025000},
-{0.006250,0.031250,0.050000,0.050000},
-{0.018750,0.031250,0.025000,0.025000},
-{0.018750,0.031250,0.050000,0.050000},
-{0.031250,0.031250,0.025000,0.025000},
-{0.031250,0.031250,0.050000,0.050000},
-{0.043750,0.031250,0.025000,0.025000},
-{0.043750,0.031250,0.050000,0.050000},
-{0.056250,0.031250,0.025000,0.025000},
-{0.056250,0.031250,0.050000,0.050000},
-{0.068750,0.031250,0.025000,0.025000},
-{0.068750,0.031250,0.050000,0.050000},
-{0.081250,0.031250,0.025000,0.025000},
-{0.081250,0.031250,0.050000,0.050000},
-{0.093750,0.031250,0.025000,0.025000},
-{0.093750,0.031250,0.050000,0.050000},
-{0.106250,0.031250,0.025000,0.025000},
-{0.106250,0.031250,0.050000,0.050000},
-{0.118750,0.031250,0.025000,0.025000},
-{0.118750,0.031250,0.050000,0.050000},
-{0.131250,0.031250,0.025000,0.025000},
-{0.131250,0.031250,0.050000,0.050000},
-{0.143750,0.031250,0.025000,0.025000},
-{0.143750,0.031250,0.050000,0.050000},
-{0.156250,0.031250,0.025000,0.025000},
-{0.156250,0.031250,0.050000,0.050000},
-{0.168750,0.031250,0.025000,0.025000},
-{0.168750,0.031250,0.050000,0.050000},
-{0.181250,0.031250,0.025000,0.025000},
-{0.181250,0.031250,0.050000,0.050000},
-{0.193750,0.031250,0.025000,0.025000},
-{0.193750,0.031250,0.050000,0.050000},
-{0.206250,0.031250,0.025000,0.025000},
-{0.206250,0.031250,0.050000,0.050000},
-{0.218750,0.031250,0.025000,0.025000},
-{0.218750,0.031250,0.050000,0.050000},
-{0.231250,0.031250,0.025000,0.025000},
-{0.231250,0.031250,0.050000,0.050000},
-{0.243750,0.031250,0.025000,0.025000},
-{0.243750,0.031250,0.050000,0.050000},
-{0.256250,0.031250,0.025000,0.025000},
-{0.256250,0.031250,0.050000,0.050000},
-{0.268750,0.031250,0.025000,0.025000},
-{0.268750,0.031250,0.050000,0.050000},
-{0.281250,0.031250,0.025000,0.025000},
-{0.281250,0.031250,0.050000,0.050000},
-{0.293750,0.031250,0.025000,0.025000},
-{0.293750,0.031250,0.050000,0.050000},
-{0.306250,0.031250,0.025000,0.025000},
-{0.306250,0.031250,0.050000,0.050000},
-{0.318750,0.031250,0.025000,0.025000},
-{0.318750,0.031250,0.050000,0.050000},
-{0.331250,0.031250,0.025000,0.025000},
-{0.331250,0.031250,0.050000,0.050000},
-{0.343750,0.031250,0.025000,0.025000},
-{0.343750,0.031250,0.050000,0.050000},
-{0.356250,0.031250,0.025000,0.025000},
-{0.356250,0.031250,0.050000,0.050000},
-{0.368750,0.031250,0.025000,0.025000},
-{0.368750,0.031250,0.050000,0.050000},
-{0.381250,0.031250,0.025000,0.025000},
-{0.381250,0.031250,0.050000,0.050000},
-{0.393750,0.031250,0.025000,0.025000},
-{0.393750,0.031250,0.050000,0.050000},
-{0.406250,0.031250,0.025000,0.025000},
-{0.406250,0.031250,0.050000,0.050000},
-{0.418750,0.031250,0.025000,0.025000},
-{0.418750,0.031250,0.050000,0.050000},
-{0.431250,0.031250,0.025000,0.025000},
-{0.431250,0.031250,0.050000,0.050000},
-{0.443750,0.031250,0.025000,0.025000},
-{0.443750,0.031250,0.050000,0.050000},
-{0.456250,0.031250,0.025000,0.025000},
-{0.456250,0.031250,0.050000,0.050000},
-{0.468750,0.031250,0.025000,0.025000},
-{0.468750,0.031250,0.050000,0.050000},
-{0.481250,0.031250,0.025000,0.025000},
-{0.481250,0.031250,0.050000,0.050000},
-{0.493750,0.031250,0.025000,0.025000},
-{0.493750,0.031250,0.050000,0.050000},
-{0.506250,0.031250,0.025000,0.025000},
-{0.506250,0.031250,0.050000,0.050000},
-{0.518750,0.031250,0.025000,0.025000},
-{0.518750,0.031250,0.050000,0.050000},
-{0.531250,0.031250,0.025000,0.025000},
-{0.531250,0.031250,0.050000,0.050000},
-{0.543750,0.031250,0.025000,0.025000},
-{0.543750,0.031250,0.050000,0.050000},
-{0.556250,0.031250,0.025000,0.025000},
-{0.556250,0.031250,0.050000,0.050000},
-{0.568750,0.031250,0.025000,0.025000},
-{0.568750,0.031250,0.050000,0.050000},
-{0.581250,0.031250,0.025000,0.025000},
-{0.581250,0.031250,0.050000,0.050000},
-{0.593750,0.031250,0.025000,0.025000},
-{0.593750,0.031250,0.050000,0.050000},
-{0.606250,0.031250,0.025000,0.025000},
-{0.606250,0.031250,0.050000,0.050000},
-{0.618750,0.031250,0.025000,0.025000},
-{0.618750,0.031250,0.050000,0.050000},
-{0.631250,0.031250,0.025000,0.025000},
-{0.631250,0.031250,0.050000,0.050000},
-{0.643750,0.031250,0.025000,0.025000},
-{0.643750,0.031250,0.050000,0.050000},
-{0.656250,0.031250,0.025000,0.025000},
-{0.656250,0.031250,0.050000,0.050000},
-{0.668750,0.031250,0.025000,0.025000},
-{0.668750,0.031250,0.050000,0.050000},
-{0.681250,0.031250,0.025000,0.025000},
-{0.681250,0.031250,0.050000,0.050000},
-{0.693750,0.031250,0.025000,0.025000},
-{0.693750,0.031250,0.050000,0.050000},
-{0.706250,0.031250,0.025000,0.025000},
-{0.706250,0.031250,0.050000,0.050000},
-{0.718750,0.031250,0.025000,0.025000},
-{0.718750,0.031250,0.050000,0.050000},
-{0.731250,0.031250,0.025000,0.025000},
-{0.731250,0.031250,0.050000,0.050000},
-{0.743750,0.031250,0.025000,0.025000},
-{0.743750,0.031250,0.050000,0.050000},
-{0.756250,0.031250,0.025000,0.025000},
-{0.756250,0.031250,0.050000,0.050000},
-{0.768750,0.031250,0.025000,0.025000},
-{0.768750,0.031250,0.050000,0.050000},
-{0.781250,0.031250,0.025000,0.025000},
-{0.781250,0.031250,0.050000,0.050000},
-{0.793750,0.031250,0.025000,0.025000},
-{0.793750,0.031250,0.050000,0.050000},
-{0.806250,0.031250,0.025000,0.025000},
-{0.806250,0.031250,0.050000,0.050000},
-{0.818750,0.031250,0.025000,0.025000},
-{0.818750,0.031250,0.050000,0.050000},
-{0.831250,0.031250,0.025000,0.025000},
-{0.831250,0.031250,0.050000,0.050000},
-{0.843750,0.031250,0.025000,0.025000},
-{0.843750,0.031250,0.050000,0.050000},
-{0.856250,0.031250,0.025000,0.025000},
-{0.856250,0.031250,0.050000,0.050000},
-{0.868750,0.031250,0.025000,0.025000},
-{0.868750,0.031250,0.050000,0.050000},
-{0.881250,0.031250,0.025000,0.025000},
-{0.881250,0.031250,0.050000,0.050000},
-{0.893750,0.031250,0.025000,0.025000},
-{0.893750,0.031250,0.050000,0.050000},
-{0.906250,0.031250,0.025000,0.025000},
-{0.906250,0.031250,0.050000,0.050000},
-{0.918750,0.031250,0.025000,0.025000},
-{0.918750,0.031250,0.050000,0.050000},
-{0.931250,0.031250,0.025000,0.025000},
-{0.931250,0.031250,0.050000,0.050000},
-{0.943750,0.031250,0.025000,0.025000},
-{0.943750,0.031250,0.050000,0.050000},
-{0.956250,0.031250,0.025000,0.025000},
-{0.956250,0.031250,0.050000,0.050000},
-{0.968750,0.031250,0.025000,0.025000},
-{0.968750,0.031250,0.050000,0.050000},
-{0.981250,0.031250,0.025000,0.025000},
-{0.981250,0.031250,0.050000,0.050000},
-{0.993750,0.031250,0.025000,0.025000},
-{0.993750,0.031250,0.050000,0.050000},
-{0.006250,0.043750,0.025000,0.025000},
-{0.006250,0.043750,0.050000,0.050000},
-{0.018750,0.043750,0.025000,0.025000},
-{0.018750,0.043750,0.050000,0.050000},
-{0.031250,0.043750,0.025000,0.025000},
-{0.031250,0.043750,0.050000,0.050000},
-{0.043750,0.043750,0.025000,0.025000},
-{0.043750,0.043750,0.050000,0.050000},
-{0.056250,0.043750,0.025000,0.025000},
-{0.056250,0.043750,0.050000,0.050000},
-{0.068750,0.043750,0.025000,0.025000},
-{0.068750,0.043750,0.050000,0.050000},
-{0.081250,0.043750,0.025000,0.025000},
-{0.081250,0.043750,0.050000,0.050000},
-{0.093750,0.043750,0.025000,0.025000},
-{0.093750,0.043750,0.050000,0.050000},
-{0.106250,0.043750,0.025000,0.025000},
-{0.106250,0.043750,0.050000,0.050000},
-{0.118750,0.043750,0.025000,0.025000},
-{0.118750,0.043750,0.050000,0.050000},
-{0.131250,0.043750,0.025000,0.025000},
-{0.131250,0.043750,0.050000,0.050000},
-{0.143750,0.043750,0.025000,0.025000},
-{0.143750,0.043750,0.050000,0.050000},
-{0.156250,0.043750,0.025000,0.025000},
-{0.156250,0.043750,0.050000,0.050000},
-{0.168750,0.043750,0.025000,0.025000},
-{0.168750,0.043750,0.050000,0.050000},
-{0.181250,0.043750,0.025000,0.025000},
-{0.181250,0.043750,0.050000,0.050000},
-{0.193750,0.043750,0.025000,0.025000},
-{0.193750,0.043750,0.050000,0.050000},
-{0.206250,0.043750,0.025000,0.025000},
-{0.206250,0.043750,0.050000,0.050000},
-{0.218750,0.043750,0.025000,0.025000},
-{0.218750,0.043750,0.050000,0.050000},
-{0.231250,0.043750,0.025000,0.025000},
-{0.231250,0.043750,0.050000,0.050000},
-{0.243750,0.043750,0.025000,0.025000},
-{0.243750,0.043750,0.050000,0.050000},
-{0.256250,0.043750,0.025000,0.025000},
-{0.256250,0.043750,0.050000,0.050000},
-{0.268750,0.043750,0.025000,0.025000},
-{0.268750,0.043750,0.050000,0.050000},
-{0.281250,0.043750,0.025000,0.025000},
-{0.281250,0.043750,0.050000,0.050000},
-{0.293750,0.043750,0.025000,0.025000},
-{0.293750,0.043750,0.050000,0.050000},
-{0.306250,0.043750,0.025000,0.025000},
-{0.306250,0.043750,0.050000,0.050000},
-{0.318750,0.043750,0.025000,0.025000},
-{0.318750,0.043750,0.050000,0.050000},
-{0.331250,0.043750,0.025000,0.025000},
-{0.331250,0.043750,0.050000,0.050000},
-{0.343750,0.043750,0.025000,0.025000},
-{0.343750,0.043750,0.050000,0.050000},
-{0.356250,0.043750,0.025000,0.025000},
-{0.356250,0.043750,0.050000,0.050000},
-{0.368750,0.043750,0.025000,0.025000},
-{0.368750,0.043750,0.050000,0.050000},
-{0.381250,0.043750,0.025000,0.025000},
-{0.381250,0.043750,0.050000,0.050000},
-{0.393750,0.043750,0.025000,0.025000},
-{0.393750,0.043750,0.050000,0.050000},
-{0.406250,0.043750,0.025000,0.025000},
-{0.406250,0.043750,0.050000,0.050000},
-{0.418750,0.043750,0.025000,0.025000},
-{0.418750,0.043750,0.050000,0.050000},
-{0.431250,0.043750,0.025000,0.025000},
-{0.431250,0.043750,0.050000,0.050000},
-{0.443750,0.043750,0.025000,0.025000},
-{0.443750,0.043750,0.050000,0.050000},
-{0.456250,0.043750,0.025000,0.025000},
-{0.456250,0.043750,0.050000,0.050000},
-{0.468750,0.043750,0.025000,0.025000},
-{0.468750,0.043750,0.050000,0.050000},
-{0.481250,0.043750,0.025000,0.025000},
-{0.481250,0.043750,0.050000,0.050000},
-{0.493750,0.043750,0.025000,0.025000},
-{0.493750,0.043750,0.050000,0.050000},
-{0.506250,0.043750,0.025000,0.025000},
-{0.506250,0.043750,0.050000,0.050000},
-{0.518750,0.043750,0.025000,0.025000},
-{0.518750,0.043750,0.050000,0.050000},
-{0.531250,0.043750,0.025000,0.025000},
-{0.531250,0.043750,0.050000,0.050000},
-{0.543750,0.043750,0.025000,0.025000},
-{0.543750,0.043750,0.050000,0.050000},
-{0.556250,0.043750,0.025000,0.025000},
-{0.556250,0.043750,0.050000,0.050000},
-{0.568750,0.043750,0.025000,0.025000},
-{0.568750,0.043750,0.050000,0.050000},
-{0.581250,0.043750,0.025000,0.025000},
-{0.581250,0.043750,0.050000,0.050000},
-{0.593750,0.043750,0.025000,0.025000},
-{0.593750,0.043750,0.050000,0.050000},
-{0.606250,0.043750,0.025000,0.025000},
-{0.606250,0.043750,0.050000,0.050000},
-{0.618750,0.043750,0.025000,0.025000},
-{0.618750,0.043750,0.050000,0.050000},
-{0.631250,0.043750,0.025000,0.025000},
-{0.631250,0.043750,0.050000,0.050000},
-{0.643750,0.043750,0.025000,0.025000},
-{0.643750,0.043750,0.050000,0.050000},
-{0.656250,0.043750,0.025000,0.025000},
-{0.656250,0.043750,0.050000,0.050000},
-{0.668750,0.043750,0.025000,0.025000},
-{0.668750,0.043750,0.050000,0.050000},
-{0.681250,0.043750,0.025000,0.025000},
-{0.681250,0.043750,0.050000,0.050000},
-{0.693750,0.043750,0.025000,0.025000},
-{0.693750,0.043750,0.050000,0.050000},
-{0.706250,0.043750,0.025000,0.025000},
-{0.706250,0.043750,0.050000,0.050000},
-{0.718750,0.043750,0.025000,0.025000},
-{0.718750,0.043750,0.050000,0.050000},
-{0.731250,0.043750,0.025000,0.025000},
-{0.731250,0.043750,0.050000,0.050000},
-{0.743750,0.043750,0.025000,0.025000},
-{0.743750,0.043750,0.050000,0.050000},
-{0.756250,0.043750,0.025000,0.025000},
-{0.756250,0.043750,0.050000,0.050000},
-{0.768750,0.043750,0.025000,0.025000},
-{0.768750,0.043750,0.050000,0.050000},
-{0.781250,0.043750,0.025000,0.025000},
-{0.781250,0.043750,0.050000,0.050000},
-{0.793750,0.043750,0.025000,0.025000},
-{0.793750,0.043750,0.050000,0.050000},
-{0.806250,0.043750,0.025000,0.025000},
-{0.806250,0.043750,0.050000,0.050000},
-{0.818750,0.043750,0.025000,0.025000},
-{0.818750,0.043750,0.050000,0.050000},
-{0.831250,0.043750,0.025000,0.025000},
-{0.831250,0.043750,0.050000,0.050000},
-{0.843750,0.043750,0.025000,0.025000},
-{0.843750,0.043750,0.050000,0.050000},
-{0.856250,0.043750,0.025000,0.025000},
-{0.856250,0.043750,0.050000,0.050000},
-{0.868750,0.043750,0.025000,0.025000},
-{0.868750,0.043750,0.050000,0.050000},
-{0.881250,0.043750,0.025000,0.025000},
-{0.881250,0.043750,0.050000,0.050000},
-{0.893750,0.043750,0.025000,0.025000},
-{0.893750,0.043750,0.050000,0.050000},
-{0.906250,0.043750,0.025000,0.025000},
-{0.906250,0.043750,0.050000,0.050000},
-{0.918750,0.043750,0.025000,0.025000},
-{0.918750,0.043750,0.050000,0.050000},
-{0.931250,0.043750,0.025000,0.025000},
-{0.931250,0.043750,0.050000,0.050000},
-{0.943750,0.043750,0.025000,0.025000},
-{0.943750,0.043750,0.050000,0.050000},
-{0.956250,0.043750,0.025000,0.025000},
-{0.956250,0.043750,0.050000,0.050000},
-{0.968750,0.043750,0.025000,0.025000},
-{0.968750,0.043750,0.050000,0.050000},
-{0.981250,0.043750,0.025000,0.025000},
-{0.981250,0.043750,0.050000,0.050000},
-{0.993750,0.043750,0.025000,0.025000},
-{0.993750,0.043750,0.050000,0.050000},
-{0.006250,0.056250,0.025000,0.025000},
-{0.006250,0.056250,0.050000,0.050000},
-{0.018750,0.056250,0.025000,0.025000},
-{0.018750,0.056250,0.050000,0.050000},
-{0.031250,0.056250,0.025000,0.025000},
-{0.031250,0.056250,0.050000,0.050000},
-{0.043750,0.056250,0.025000,0.025000},
-{0.043750,0.056250,0.050000,0.050000},
-{0.056250,0.056250,0.025000,0.025000},
-{0.056250,0.056250,0.050000,0.050000},
-{0.068750,0.056250,0.025000,0.025000},
-{0.068750,0.056250,0.050000,0.050000},
-{0.081250,0.056250,0.025000,0.025000},
-{0.081250,0.056250,0.050000,0.050000},
-{0.093750,0.056250,0.025000,0.025000},
-{0.093750,0.056250,0.050000,0.050000},
-{0.106250,0.056250,0.025000,0.025000},
-{0.106250,0.056250,0.050000,0.050000},
-{0.118750,0.056250,0.025000,0.025000},
-{0.118750,0.056250,0.050000,0.050000},
-{0.131250,0.056250,0.025000,0.025000},
-{0.131250,0.056250,0.050000,0.050000},
-{0.143750,0.056250,0.025000,0.025000},
-{0.143750,0.056250,0.050000,0.050000},
-{0.156250,0.056250,0.025000,0.025000},
-{0.156250,0.056250,0.050000,0.050000},
-{0.168750,0.056250,0.025000,0.025000},
-{0.168750,0.056250,0.050000,0.050000},
-{0.181250,0.056250,0.025000,0.025000},
-{0.181250,0.056250,0.050000,0.050000},
-{0.193750,0.056250,0.025000,0.025000},
-{0.193750,0.056250,0.050000,0.050000},
-{0.206250,0.056250,0.025000,0.025000},
-{0.206250,0.056250,0.050000,0.050000},
-{0.218750,0.056250,0.025000,0.025000},
-{0.218750,0.056250,0.050000,0.050000},
-{0.231250,0.056250,0.025000,0.025000},
-{0.231250,0.056250,0.050000,0.050000},
-{0.243750,0.056250,0.025000,0.025000},
-{0.243750,0.056250,0.050000,0.050000},
-{0.256250,0.056250,0.025000,0.025000},
-{0.256250,0.056250,0.050000,0.050000},
-{0.268750,0.056250,0.025000,0.025000},
-{0.268750,0.056250,0.050000,0.050000},
-{0.281250,0.056250,0.025000,0.025000},
-{0.281250,0.056250,0.050000,0.050000},
-{0.293750,0.056250,0.025000,0.025000},
-{0.293750,0.056250,0.050000,0.050000},
-{0.306250,0.056250,0.025000,0.025000},
-{0.306250,0.056250,0.050000,0.050000},
-{0.318750,0.056250,0.025000,0.025000},
-{0.318750,0.056250,0.050000,0.050000},
-{0.331250,0.056250,0.025000,0.025000},
-{0.331250,0.056250,0.050000,0.050000},
-{0.343750,0.056250,0.025000,0.025000},
-{0.343750,0.056250,0.050000,0.050000},
-{0.356250,0.056250,0.025000,0.025000},
-{0.356250,0.056250,0.050000,0.050000},
-{0.368750,0.056250,0.025000,0.025000},
-{0.368750,0.056250,0.050000,0.050000},
-{0.381250,0.056250,0.025000,0.025000},
-{0.381250,0.056250,0.050000,0.050000},
-{0.393750,0.056250,0.025000,0.025000},
-{0.393750,0.056250,0.050000,0.050000},
-{0.406250,0.056250,0.025000,0.025000},
-{0.406250,0.056250,0.050000,0.050000},
-{0.418750,0.056250,0.025000,0.025000},
-{0.418750,0.056250,0.050000,0.050000},
-{0.431250,0.056250,0.025000,0.025000},
-{0.431250,0.056250,0.050000,0.050000},
-{0.443750,0.056250,0.025000,0.025000},
-{0.443750,0.056250,0.050000,0.050000},
-{0.456250,0.056250,0.025000,0.025000},
-{0.456250,0.056250,0.050000,0.050000},
-{0.468750,0.056250,0.025000,0.025000},
-{0.468750,0.056250,0.050000,0.050000},
-{0.481250,0.056250,0.025000,0.025000},
-{0.481250,0.056250,0.050000,0.050000},
-{0.493750,0.056250,0.025000,0.025000},
-{0.493750,0.056250,0.050000,0.050000},
-{0.506250,0.056250,0.025000,0.025000},
-{0.506250,0.056250,0.050000,0.050000},
-{0.518750,0.056250,0.025000,0.025000},
-{0.518750,0.056250,0.050000,0.050000},
-{0.531250,0.056250,0.025000,0.025000},
-{0.531250,0.056250,0.050000,0.050000},
-{0.543750,0.056250,0.025000,0.025000},
-{0.543750,0.056250,0.050000,0.050000},
-{0.556250,0.056250,0.025000,0.025000},
-{0.556250,0.056250,0.050000,0.050000},
-{0.568750,0.056250,0.025000,0.025000},
-{0.568750,0.056250,0.050000,0.050000},
-{0.581250,0.056250,0.025000,0.025000},
-{0.581250,0.056250,0.050000,0.050000},
-{0.593750,0.056250,0.025000,0.025000},
-{0.593750,0.056250,0.050000,0.050000},
-{0.606250,0.056250,0.025000,0.025000},
-{0.606250,0.056250,0.050000,0.050000},
-{0.618750,0.056250,0.025000,0.025000},
-{0.618750,0.056250,0.050000,0.050000},
-{0.631250,0.056250,0.025000,0.025000},
-{0.631250,0.056250,0.050000,0.050000},
-{0.643750,0.056250,0.025000,0.025000},
-{0.643750,0.056250,0.050000,0.050000},
-{0.656250,0.056250,0.025000,0.025000},
-{0.656250,0.056250,0.050000,0.050000},
-{0.668750,0.056250,0.025000,0.025000},
-{0.668750,0.056250,0.050000,0.050000},
-{0.681250,0.056250,0.025000,0.025000},
-{0.681250,0.056250,0.050000,0.050000},
-{0.693750,0.056250,0.025000,0.025000},
-{0.693750,0.056250,0.050000,0.050000},
-{0.706250,0.056250,0.025000,0.025000},
-{0.706250,0.056250,0.050000,0.050000},
-{0.718750,0.056250,0.025000,0.025000},
-{0.718750,0.056250,0.050000,0.050000},
-{0.731250,0.056250,0.025000,0.025000},
-{0.731250,0.056250,0.050000,0.050000},
-{0.743750,0.056250,0.025000,0.025000},
-{0.743750,0.056250,0.050000,0.050000},
-{0.756250,0.056250,0.025000,0.025000},
-{0.756250,0.056250,0.050000,0.050000},
-{0.768750,0.056250,0.025000,0.025000},
-{0.768750,0.056250,0.050000,0.050000},
-{0.781250,0.056250,0.025000,0.025000},
-{0.781250,0.056250,0.050000,0.050000},
-{0.793750,0.056250,0.025000,0.025000},
-{0.793750,0.056250,0.050000,0.050000},
-{0.806250,0.056250,0.025000,0.025000},
-{0.806250,0.056250,0.050000,0.050000},
-{0.818750,0.056250,0.025000,0.025000},
-{0.818750,0.056250,0.050000,0.050000},
-{0.831250,0.056250,0.025000,0.025000},
-{0.831250,0.056250,0.050000,0.050000},
-{0.843750,0.056250,0.025000,0.025000},
-{0.843750,0.056250,0.050000,0.050000},
-{0.856250,0.056250,0.025000,0.025000},
-{0.856250,0.056250,0.050000,0.050000},
-{0.868750,0.056250,0.025000,0.025000},
-{0.868750,0.056250,0.050000,0.050000},
-{0.881250,0.056250,0.025000,0.025000},
-{0.881250,0.056250,0.050000,0.050000},
-{0.893750,0.056250,0.025000,0.025000},
-{0.893750,0.056250,0.050000,0.050000},
-{0.906250,0.056250,0.025000,0.025000},
-{0.906250,0.056250,0.050000,0.050000},
-{0.918750,0.056250,0.025000,0.025000},
-{0.918750,0.056250,0.050000,0.050000},
-{0.931250,0.056250,0.025000,0.025000},
-{0.931250,0.056250,0.050000,0.050000},
-{0.943750,0.056250,0.025000,0.025000},
-{0.943750,0.056250,0.050000,0.050000},
-{0.956250,0.056250,0.025000,0.025000},
-{0.956250,0.056250,0.050000,0.050000},
-{0.968750,0.056250,0.025000,0.025000},
-{0.968750,0.056250,0.050000,0.050000},
-{0.981250,0.056250,0.025000,0.025000},
-{0.981250,0.056250,0.050000,0.050000},
-{0.993750,0.056250,0.025000,0.025000},
-{0.993750,0.056250,0.050000,0.050000},
-{0.006250,0.068750,0.025000,0.025000},
-{0.006250,0.068750,0.050000,0.050000},
-{0.018750,0.068750,0.025000,0.025000},
-{0.018750,0.068750,0.050000,0.050000},
-{0.031250,0.068750,0.025000,0.025000},
-{0.031250,0.068750,0.050000,0.050000},
-{0.043750,0.068750,0.025000,0.025000},
-{0.043750,0.068750,0.050000,0.050000},
-{0.056250,0.068750,0.025000,0.025000},
-{0.056250,0.068750,0.050000,0.050000},
-{0.068750,0.068750,0.025000,0.025000},
-{0.068750,0.068750,0.050000,0.050000},
-{0.081250,0.068750,0.025000,0.025000},
-{0.081250,0.068750,0.050000,0.050000},
-{0.093750,0.068750,0.025000,0.025000},
-{0.093750,0.068750,0.050000,0.050000},
-{0.106250,0.068750,0.025000,0.025000},
-{0.106250,0.068750,0.050000,0.050000},
-{0.118750,0.068750,0.025000,0.025000},
-{0.118750,0.068750,0.050000,0.050000},
-{0.131250,0.068750,0.025000,0.025000},
-{0.131250,0.068750,0.050000,0.050000},
-{0.143750,0.068750,0.025000,0.025000},
-{0.143750,0.068750,0.050000,0.050000},
-{0.156250,0.068750,0.025000,0.025000},
-{0.156250,0.068750,0.050000,0.050000},
-{0.168750,0.068750,0.025000,0.025000},
-{0.168750,0.068750,0.050000,0.050000},
-{0.181250,0.068750,0.025000,0.025000},
-{0.181250,0.068750,0.050000,0.050000},
-{0.193750,0.068750,0.025000,0.025000},
-{0.193750,0.068750,0.050000,0.050000},
-{0.206250,0.068750,0.025000,0.025000},
-{0.206250,0.068750,0.050000,0.050000},
-{0.218750,0.068750,0.025000,0.025000},
-{0.218750,0.068750,0.050000,0.050000},
-{0.231250,0.068750,0.025000,0.025000},
-{0.231250,0.068750,0.050000,0.050000},
-{0.243750,0.068750,0.025000,0.025000},
-{0.243750,0.068750,0.050000,0.050000},
-{0.256250,0.068750,0.025000,0.025000},
-{0.256250,0.068750,0.050000,0.050000},
-{0.268750,0.068750,0.025000,0.025000},
-{0.268750,0.068750,0.050000,0.050000},
-{0.281250,0.068750,0.025000,0.025000},
-{0.281250,0.068750,0.050000,0.050000},
-{0.293750,0.068750,0.025000,0.025000},
-{0.293750,0.068750,0.050000,0.050000},
-{0.306250,0.068750,0.025000,0.025000},
-{0.306250,0.068750,0.050000,0.050000},
-{0.318750,0.068750,0.025000,0.025000},
-{0.318750,0.068750,0.050000,0.050000},
-{0.331250,0.068750,0.025000,0.025000},
-{0.331250,0.068750,0.050000,0.050000},
-{0.343750,0.068750,0.025000,0.025000},
-{0.343750,0.068750,0.050000,0.050000},
-{0.356250,0.068750,0.025000,0.025000},
-{0.356250,0.068750,0.050000,0.050000},
-{0.368750,0.068750,0.025000,0.025000},
-{0.368750,0.068750,0.050000,0.050000},
-{0.381250,0.068750,0.025000,0.025000},
-{0.381250,0.068750,0.050000,0.050000},
-{0.393750,0.068750,0.025000,0.025000},
-{0.393750,0.068750,0.050000,0.050000},
-{0.406250,0.068750,0.025000,0.025000},
-{0.406250,0.068750,0.050000,0.050000},
-{0.418750,0.068750,0.025000,0.025000},
-{0.418750,0.068750,0.050000,0.050000},
-{0.431250,0.068750,0.025000,0.025000},
-{0.431250,0.068750,0.050000,0.050000},
-{0.443750,0.068750,0.025000,0.025000},
-{0.443750,0.068750,0.050000,0.050000},
-{0.456250,0.068750,0.025000,0.025000},
-{0.456250,0.068750,0.050000,0.050000},
-{0.468750,0.068750,0.025000,0.025000},
-{0.468750,0.068750,0.050000,0.050000},
-{0.481250,0.068750,0.025000,0.025000},
-{0.481250,0.068750,0.050000,0.050000},
-{0.493750,0.068750,0.025000,0.025000},
-{0.493750,0.068750,0.050000,0.050000},
-{0.506250,0.068750,0.025000,0.025000},
-{0.506250,0.068750,0.050000,0.050000},
-{0.518750,0.068750,0.025000,0.025000},
-{0.518750,0.068750,0.050000,0.050000},
-{0.531250,0.068750,0.025000,0.025000},
-{0.531250,0.068750,0.050000,0.050000},
-{0.543750,0.068750,0.025000,0.025000},
-{0.543750,0.068750,0.050000,0.050000},
-{0.556250,0.068750,0.025000,0.025000},
-{0.556250,0.068750,0.050000,0.050000},
-{0.568750,0.068750,0.025000,0.025000},
-{0.568750,0.068750,0.050000,0.050000},
-{0.581250,0.068750,0.025000,0.025000},
-{0.581250,0.068750,0.050000,0.050000},
-{0.593750,0.068750,0.025000,0.025000},
-{0.593750,0.068750,0.050000,0.050000},
-{0.606250,0.068750,0.025000,0.025000},
-{0.606250,0.068750,0.050000,0.050000},
-{0.618750,0.068750,0.025000,0.025000},
-{0.618750,0.068750,0.050000,0.050000},
-{0.631250,0.068750,0.025000,0.025000},
-{0.631250,0.068750,0.050000,0.050000},
-{0.643750,0.068750,0.025000,0.025000},
-{0.643750,0.068750,0.050000,0.050000},
-{0.656250,0.068750,0.025000,0.025000},
-{0.656250,0.068750,0.050000,0.050000},
-{0.668750,0.068750,0.025000,0.025000},
-{0.668750,0.068750,0.050000,0.050000},
-{0.681250,0.068750,0.025000,0.025000},
-{0.681250,0.068750,0.050000,0.050000},
-{0.693750,0.068750,0.025000,0.025000},
-{0.693750,0.068750,0.050000,0.050000},
-{0.706250,0.068750,0.025000,0.025000},
-{0.706250,0.068750,0.050000,0.050000},
-{0.718750,0.068750,0.025000,0.025000},
-{0.718750,0.068750,0.050000,0.050000},
-{0.731250,0.068750,0.025000,0.025000},
-{0.731250,0.068750,0.050000,0.050000},
-{0.743750,0.068750,0.025000,0.025000},
-{0.743750,0.068750,0.050000,0.050000},
-{0.756250,0.068750,0.025000,0.025000},
-{0.756250,0.068750,0.050000,0.050000},
-{0.768750,0.068750,0.025000,0.025000},
-{0.768750,0.068750,0.050000,0.050000},
-{0.781250,0.068750,0.025000,0.025000},
-{0.781250,0.068750,0.050000,0.050000},
-{0.793750,0.068750,0.025000,0.025000},
-{0.793750,0.068750,0.050000,0.050000},
-{0.806250,0.068750,0.025000,0.025000},
-{0.806250,0.068750,0.050000,0.050000},
-{0.818750,0.068750,0.025000,0.025000},
-{0.818750,0.068750,0.050000,0.050000},
-{0.831250,0.068750,0.025000,0.025000},
-{0.831250,0.068750,0.050000,0.050000},
-{0.843750,0.068750,0.025000,0.025000},
-{0.843750,0.068750,0.050000,0.050000},
-{0.856250,0.068750,0.025000,0.025000},
-{0.856250,0.068750,0.050000,0.050000},
-{0.868750,0.068750,0.025000,0.025000},
-{0.868750,0.068750,0.050000,0.050000},
-{0.881250,0.068750,0.025000,0.025000},
-{0.881250,0.068750,0.050000,0.050000},
-{0.893750,0.068750,0.025000,0.025000},
-{0.893750,0.068750,0.050000,0.050000},
-{0.906250,0.068750,0.025000,0.025000},
-{0.906250,0.068750,0.050000,0.050000},
-{0.918750,0.068750,0.025000,0.025000},
-{0.918750,0.068750,0.050000,0.050000},
-{0.931250,0.068750,0.025000,0.025000},
-{0.931250,0.068750,0.050000,0.050000},
-{0.943750,0.068750,0.025000,0.025000},
-{0.943750,0.068750,0.050000,0.050000},
-{0.956250,0.068750,0.025000,0.025000},
-{0.956250,0.068750,0.050000,0.050000},
-{0.968750,0.068750,0.025000,0.025000},
-{0.968750,0.068750,0.050000,0.050000},
-{0.981250,0.068750,0.025000,0.025000},
-{0.981250,0.068750,0.050000,0.050000},
-{0.993750,0.068750,0.025000,0.025000},
-{0.993750,0.068750,0.050000,0.050000},
-{0.006250,0.081250,0.025000,0.025000},
-{0.006250,0.081250,0.050000,0.050000},
-{0.018750,0.081250,0.025000,0.025000},
-{0.018750,0.081250,0.050000,0.050000},
-{0.031250,0.081250,0.025000,0.025000},
-{0.031250,0.081250,0.050000,0.050000},
-{0.043750,0.081250,0.025000,0.025000},
-{0.043750,0.081250,0.050000,0.050000},
-{0.056250,0.081250,0.025000,0.025000},
-{0.056250,0.081250,0.050000,0.050000},
-{0.068750,0.081250,0.025000,0.025000},
-{0.068750,0.081250,0.050000,0.050000},
-{0.081250,0.081250,0.025000,0.025000},
-{0.081250,0.081250,0.050000,0.050000},
-{0.093750,0.081250,0.025000,0.025000},
-{0.093750,0.081250,0.050000,0.050000},
-{0.106250,0.081250,0.025000,0.025000},
-{0.106250,0.081250,0.050000,0.050000},
-{0.118750,0.081250,0.025000,0.025000},
-{0.118750,0.081250,0.050000,0.050000},
-{0.131250,0.081250,0.025000,0.025000},
-{0.131250,0.081250,0.050000,0.050000},
-{0.143750,0.081250,0.025000,0.025000},
-{0.143750,0.081250,0.050000,0.050000},
-{0.156250,0.081250,0.025000,0.025000},
-{0.156250,0.081250,0.050000,0.050000},
-{0.168750,0.081250,0.025000,0.025000},
-{0.168750,0.081250,0.050000,0.050000},
-{0.181250,0.081250,0.025000,0.025000},
-{0.181250,0.081250,0.050000,0.050000},
-{0.193750,0.081250,0.025000,0.025000},
-{0.193750,0.081250,0.050000,0.050000},
-{0.206250,0.081250,0.025000,0.025000},
-{0.206250,0.081250,0.050000,0.050000},
-{0.218750,0.081250,0.025000,0.025000},
-{0.218750,0.081250,0.050000,0.050000},
-{0.231250,0.081250,0.025000,0.025000},
-{0.231250,0.081250,0.050000,0.050000},
-{0.243750,0.081250,0.025000,0.025000},
-{0.243750,0.081250,0.050000,0.050000},
-{0.256250,0.081250,0.025000,0.025000},
-{0.256250,0.081250,0.050000,0.050000},
-{0.268750,0.081250,0.025000,0.025000},
-{0.268750,0.081250,0.050000,0.050000},
-{0.281250,0.081250,0.025000,0.025000},
-{0.281250,0.081250,0.050000,0.050000},
-{0.293750,0.081250,0.025000,0.025000},
-{0.293750,0.081250,0.050000,0.050000},
-{0.306250,0.081250,0.025000,0.025000},
-{0.306250,0.081250,0.050000,0.050000},
-{0.318750,0.081250,0.025000,0.025000},
-{0.318750,0.081250,0.050000,0.050000},
-{0.331250,0.081250,0.025000,0.025000},
-{0.331250,0.081250,0.050000,0.050000},
-{0.343750,0.081250,0.025000,0.025000},
-{0.343750,0.081250,0.050000,0.050000},
-{0.356250,0.081250,0.025000,0.025000},
-{0.356250,0.081250,0.050000,0.050000},
-{0.368750,0.081250,0.025000,0.025000},
-{0.368750,0.081250,0.050000,0.050000},
-{0.381250,0.081250,0.025000,0.025000},
-{0.381250,0.081250,0.050000,0.050000},
-{0.393750,0.081250,0.025000,0.025000},
-{0.393750,0.081250,0.050000,0.050000},
-{0.406250,0.081250,0.025000,0.025000},
-{0.406250,0.081250,0.050000,0.050000},
-{0.418750,0.081250,0.025000,0.025000},
-{0.418750,0.081250,0.050000,0.050000},
-{0.431250,0.081250,0.025000,0.025000},
-{0.431250,0.081250,0.050000,0.050000},
-{0.443750,0.081250,0.025000,0.025000},
-{0.443750,0.081250,0.050000,0.050000},
-{0.456250,0.081250,0.025000,0.025000},
-{0.456250,0.081250,0.050000,0.050000},
-{0.468750,0.081250,0.025000,0.025000},
-{0.468750,0.081250,0.050000,0.050000},
-{0.481250,0.081250,0.025000,0.025000},
-{0.481250,0.081250,0.050000,0.050000},
-{0.493750,0.081250,0.025000,0.025000},
-{0.493750,0.081250,0.050000,0.050000},
-{0.506250,0.081250,0.025000,0.025000},
-{0.506250,0.081250,0.050000,0.050000},
-{0.518750,0.081250,0.025000,0.025000},
-{0.518750,0.081250,0.050000,0.050000},
-{0.531250,0.081250,0.025000,0.025000},
-{0.531250,0.081250,0.050000,0.050000},
-{0.543750,0.081250,0.025000,0.025000},
-{0.543750,0.081250,0.050000,0.050000},
-{0.556250,0.081250,0.025000,0.025000},
-{0.556250,0.081250,0.050000,0.050000},
-{0.568750,0.081250,0.025000,0.025000},
-{0.568750,0.081250,0.050000,0.050000},
-{0.581250,0.081250,0.025000,0.025000},
-{0.581250,0.081250,0.050000,0.050000},
-{0.593750,0.081250,0.025000,0.025000},
-{0.593750,0.081250,0.050000,0.050000},
-{0.606250,0.081250,0.025000,0.025000},
-{0.606250,0.081250,0.050000,0.050000},
-{0.618750,0.081250,0.025000,0.025000},
-{0.618750,0.081250,0.050000,0.050000},
-{0.631250,0.081250,0.025000,0.025000},
-{0.631250,0.081250,0.050000,0.050000},
-{0.643750,0.081250,0.025000,0.025000},
-{0.643750,0.081250,0.050000,0.050000},
-{0.656250,0.081250,0.025000,0.025000},
-{0.656250,0.081250,0.050000,0.050000},
-{0.668750,0.081250,0.025000,0.025000},
-{0.668750,0.081250,0.050000,0.050000},
-{0.681250,0.081250,0.025000,0.025000},
-{0.681250,0.081250,0.050000,0.050000},
-{0.693750,0.081250,0.025000,0.025000},
-{0.693750,0.081250,0.050000,0.050000},
-{0.706250,0.081250,0.025000,0.025000},
-{0.706250,0.081250,0.050000,0.050000},
-{0.718750,0.081250,0.025000,0.025000},
-{0.718750,0.081250,0.050000,0.050000},
-{0.731250,0.081250,0.025000,0.025000},
-{0.731250,0.081250,0.050000,0.050000},
-{0.743750,0.081250,0.025000,0.025000},
-{0.743750,0.081250,0.050000,0.050000},
-{0.756250,0.081250,0.025000,0.025000},
-{0.756250,0.081250,0.050000,0.050000},
-{0.768750,0.081250,0.025000,0.025000},
-{0.768750,0.081250,0.050000,0.050000},
-{0.781250,0.081250,0.025000,0.025000},
-{0.781250,0.081250,0.050000,0.050000},
-{0.793750,0.081250,0.025000,0.025000},
-{0.793750,0.081250,0.050000,0.050000},
-{0.806250,0.081250,0.025000,0.025000},
-{0.806250,0.081250,0.050000,0.050000},
-{0.818750,0.081250,0.025000,0.025000},
-{0.818750,0.081250,0.050000,0.050000},
-{0.831250,0.081250,0.025000,0.025000},
-{0.831250,0.081250,0.050000,0.050000},
-{0.843750,0.081250,0.025000,0.025000},
-{0.843750,0.081250,0.050000,0.050000},
-{0.856250,0.081250,0.025000,0.025000},
-{0.856250,0.081250,0.050000,0.050000},
-{0.868750,0.081250,0.025000,0.025000},
-{0.868750,0.081250,0.050000,0.050000},
-{0.881250,0.081250,0.025000,0.025000},
-{0.881250,0.081250,0.050000,0.050000},
-{0.893750,0.081250,0.025000,0.025000},
-{0.893750,0.081250,0.050000,0.050000},
-{0.906250,0.081250,0.025000,0.025000},
-{0.906250,0.081250,0.050000,0.050000},
-{0.918750,0.081250,0.025000,0.025000},
-{0.918750,0.081250,0.050000,0.050000},
-{0.931250,0.081250,0.025000,0.025000},
-{0.931250,0.081250,0.050000,0.050000},
-{0.943750,0.081250,0.025000,0.025000},
-{0.943750,0.081250,0.050000,0.050000},
-{0.956250,0.081250,0.025000,0.025000},
-{0.956250,0.081250,0.050000,0.050000},
-{0.968750,0.081250,0.025000,0.025000},
-{0.968750,0.081250,0.050000,0.050000},
-{0.981250,0.081250,0.025000,0.025000},
-{0.981250,0.081250,0.050000,0.050000},
-{0.993750,0.081250,0.025000,0.025000},
-{0.993750,0.081250,0.050000,0.050000},
-{0.006250,0.093750,0.025000,0.025000},
-{0.006250,0.093750,0.050000,0.050000},
-{0.018750,0.093750,0.025000,0.025000},
-{0.018750,0.093750,0.050000,0.050000},
-{0.031250,0.093750,0.025000,0.025000},
-{0.031250,0.093750,0.050000,0.050000},
-{0.043750,0.093750,0.025000,0.025000},
-{0.043750,0.093750,0.050000,0.050000},
-{0.056250,0.093750,0.025000,0.025000},
-{0.056250,0.093750,0.050000,0.050000},
-{0.068750,0.093750,0.025000,0.025000},
-{0.068750,0.093750,0.050000,0.050000},
-{0.081250,0.093750,0.025000,0.025000},
-{0.081250,0.093750,0.050000,0.050000},
-{0.093750,0.093750,0.025000,0.025000},
-{0.093750,0.093750,0.050000,0.050000},
-{0.106250,0.093750,0.025000,0.025000},
-{0.106250,0.093750,0.050000,0.050000},
-{0.118750,0.093750,0.025000,0.025000},
-{0.118750,0.093750,0.050000,0.050000},
-{0.131250,0.093750,0.025000,0.025000},
-{0.131250,0.093750,0.050000,0.050000},
-{0.143750,0.093750,0.025000,0.025000},
-{0.143750,0.093750,0.050000,0.050000},
-{0.156250,0.093750,0.025000,0.025000},
-{0.156250,0.093750,0.050000,0.050000},
-{0.168750,0.093750,0.025000,0.025000},
-{0.168750,0.093750,0.050000,0.050000},
-{0.181250,0.093750,0.025000,0.025000},
-{0.181250,0.093750,0.050000,0.050000},
-{0.193750,0.093750,0.025000,0.025000},
-{0.193750,0.093750,0.050000,0.050000},
-{0.206250,0.093750,0.025000,0.025000},
-{0.206250,0.093750,0.050000,0.050000},
-{0.218750,0.093750,0.025000,0.025000},
-{0.218750,0.093750,0.050000,0.050000},
-{0.231250,0.093750,0.025000,0.025000},
-{0.231250,0.093750,0.050000,0.050000},
-{0.243750,0.093750,0.025000,0.025000},
-{0.243750,0.093750,0.050000,0.050000},
-{0.256250,0.093750,0.025000,0.025000},
-{0.256250,0.093750,0.050000,0.050000},
-{0.268750,0.093750,0.025000,0.025000},
-{0.268750,0.093750,0.050000,0.050000},
-{0.281250,0.093750,0.025000,0.025000},
-{0.281250,0.093750,0.050000,0.050000},
-{0.293750,0.093750,0.025000,0.025000},
-{0.293750,0.093750,0.050000,0.050000},
-{0.306250,0.093750,0.025000,0.025000},
-{0.306250,0.093750,0.050000,0.050000},
-{0.318750,0.093750,0.025000,0.025000},
-{0.318750,0.093750,0.050000,0.050000},
-{0.331250,0.093750,0.025000,0.025000},
-{0.331250,0.093750,0.050000,0.050000},
-{0.343750,0.093750,0.025000,0.025000},
-{0.343750,0.093750,0.050000,0.050000},
-{0.356250,0.093750,0.025000,0.025000},
-{0.356250,0.093750,0.050000,0.050000},
-{0.368750,0.093750,0.025000,0.025000},
-{0.368750,0.093750,0.050000,0.050000},
-{0.381250,0.093750,0.025000,0.025000},
-{0.381250,0.093750,0.050000,0.050000},
-{0.393750,0.093750,0.025000,0.025000},
-{0.393750,0.093750,0.050000,0.050000},
-{0.406250,0.093750,0.025000,0.025000},
-{0.406250,0.093750,0.050000,0.050000},
-{0.418750,0.093750,0.025000,0.025000},
-{0.418750,0.093750,0.050000,0.050000},
-{0.431250,0.093750,0.025000,0.025000},
-{0.431250,0.093750,0.050000,0.050000},
-{0.443750,0.093750,0.025000,0.025000},
-{0.443750,0.093750,0.050000,0.050000},
-{0.456250,0.093750,0.025000,0.025000},
-{0.456250,0.093750,0.050000,0.050000},
-{0.468750,0.093750,0.025000,0.025000},
-{0.468750,0.093750,0.050000,0.050000},
-{0.481250,0.093750,0.025000,0.025000},
-{0.481250,0.093750,0.050000,0.050000},
-{0.493750,0.093750,0.025000,0.025000},
-{0.493750,0.093750,0.050000,0.050000},
-{0.506250,0.093750,0.025000,0.025000},
-{0.506250,0.093750,0.050000,0.050000},
-{0.518750,0.093750,0.025000,0.025000},
-{0.518750,0.093750,0.050000,0.050000},
-{0.531250,0.093750,0.025000,0.025000},
-{0.531250,0.093750,0.050000,0.050000},
-{0.543750,0.093750,0.025000,0.025000},
-{0.543750,0.093750,0.050000,0.050000},
-{0.556250,0.093750,0.025000,0.025000},
-{0.556250,0.093750,0.050000,0.050000},
-{0.568750,0.093750,0.025000,0.025000},
-{0.568750,0.093750,0.050000,0.050000},
-{0.581250,0.093750,0.025000,0.025000},
-{0.581250,0.093750,0.050000,0.050000},
-{0.593750,0.093750,0.025000,0.025000},
-{0.593750,0.093750,0.050000,0.050000},
-{0.606250,0.093750,0.025000,0.025000},
-{0.606250,0.093750,0.050000,0.050000},
-{0.618750,0.093750,0.025000,0.025000},
-{0.618750,0.093750,0.050000,0.050000},
-{0.631250,0.093750,0.025000,0.025000},
-{0.631250,0.093750,0.050000,0.050000},
-{0.643750,0.093750,0.025000,0.025000},
-{0.643750,0.093750,0.050000,0.050000},
-{0.656250,0.093750,0.025000,0.025000},
-{0.656250,0.093750,0.050000,0.050000},
-{0.668750,0.093750,0.025000,0.025000},
-{0.668750,0.093750,0.050000,0.050000},
-{0.681250,0.093750,0.025000,0.025000},
-{0.681250,0.093750,0.050000,0.050000},
-{0.693750,0.093750,0.025000,0.025000},
-{0.693750,0.093750,0.050000,0.050000},
-{0.706250,0.093750,0.025000,0.025000},
-{0.706250,0.093750,0.050000,0.050000},
-{0.718750,0.093750,0.025000,0.025000},
-{0.718750,0.093750,0.050000,0.050000},
-{0.731250,0.093750,0.025000,0.025000},
-{0.731250,0.093750,0.050000,0.050000},
-{0.743750,0.093750,0.025000,0.025000},
-{0.743750,0.093750,0.050000,0.050000},
-{0.756250,0.093750,0.025000,0.025000},
-{0.756250,0.093750,0.050000,0.050000},
-{0.768750,0.093750,0.025000,0.025000},
-{0.768750,0.093750,0.050000,0.050000},
-{0.781250,0.093750,0.025000,0.025000},
-{0.781250,0.093750,0.050000,0.050000},
-{0.793750,0.093750,0.025000,0.025000},
-{0.793750,0.093750,0.050000,0.050000},
-{0.806250,0.093750,0.025000,0.025000},
-{0.806250,0.093750,0.050000,0.050000},
-{0.818750,0.093750,0.025000,0.025000},
-{0.818750,0.093750,0.050000,0.050000},
-{0.831250,0.093750,0.025000,0.025000},
-{0.831250,0.093750,0.050000,0.050000},
-{0.843750,0.093750,0.025000,0.025000},
-{0.843750,0.093750,0.050000,0.050000},
-{0.856250,0.093750,0.025000,0.025000},
-{0.856250,0.093750,0.050000,0.050000},
-{0.868750,0.093750,0.025000,0.025000},
-{0.868750,0.093750,0.050000,0.050000},
-{0.881250,0.093750,0.025000,0.025000},
-{0.881250,0.093750,0.050000,0.050000},
-{0.893750,0.093750,0.025000,0.025000},
-{0.893750,0.093750,0.050000,0.050000},
-{0.906250,0.093750,0.025000,0.025000},
-{0.906250,0.093750,0.050000,0.050000},
-{0.918750,0.093750,0.025000,0.025000},
-{0.918750,0.093750,0.050000,0.050000},
-{0.931250,0.093750,0.025000,0.025000},
-{0.931250,0.093750,0.050000,0.050000},
-{0.943750,0.093750,0.025000,0.025000},
-{0.943750,0.093750,0.050000,0.050000},
-{0.956250,0.093750,0.025000,0.025000},
-{0.956250,0.093750,0.050000,0.050000},
-{0.968750,0.093750,0.025000,0.025000},
-{0.968750,0.093750,0.050000,0.050000},
-{0.981250,0.093750,0.025000,0.025000},
-{0.981250,0.093750,0.050000,0.050000},
-{0.993750,0.093750,0.025000,0.025000},
-{0.993750,0.093750,0.050000,0.050000},
-{0.006250,0.106250,0.025000,0.025000},
-{0.006250,0.106250,0.050000,0.050000},
-{0.018750,0.106250,0.025000,0.025000},
-{0.018750,0.106250,0.050000,0.050000},
-{0.031250,0.106250,0.025000,0.025000},
-{0.031250,0.106250,0.050000,0.050000},
-{0.043750,0.106250,0.025000,0.025000},
-{0.043750,0.106250,0.050000,0.050000},
-{0.056250,0.106250,0.025000,0.025000},
-{0.056250,0.106250,0.050000,0.050000},
-{0.068750,0.106250,0.025000,0.025000},
-{0.068750,0.106250,0.050000,0.050000},
-{0.081250,0.106250,0.025000,0.025000},
-{0.081250,0.106250,0.050000,0.050000},
-{0.093750,0.106250,0.025000,0.025000},
-{0.093750,0.106250,0.050000,0.050000},
-{0.106250,0.106250,0.025000,0.025000},
-{0.106250,0.106250,0.050000,0.050000},
-{0.118750,0.106250,0.025000,0.025000},
-{0.118750,0.106250,0.050000,0.050000},
-{0.131250,0.106250,0.025000,0.025000},
-{0.131250,0.106250,0.050000,0.050000},
-{0.143750,0.106250,0.025000,0.025000},
-{0.143750,0.106250,0.050000,0.050000},
-{0.156250,0.106250,0.025000,0.025000},
-{0.156250,0.106250,0.050000,0.050000},
-{0.168750,0.106250,0.025000,0.025000},
-{0.168750,0.106250,0.050000,0.050000},
-{0.181250,0.106250,0.025000,0.025000},
-{0.181250,0.106250,0.050000,0.050000},
-{0.193750,0.106250,0.025000,0.025000},
-{0.193750,0.106250,0.050000,0.050000},
-{0.206250,0.106250,0.025000,0.025000},
-{0.206250,0.106250,0.050000,0.050000},
-{0.218750,0.106250,0.025000,0.025000},
-{0.218750,0.106250,0.050000,0.050000},
-{0.231250,0.106250,0.025000,0.025000},
-{0.231250,0.106250,0.050000,0.050000},
-{0.243750,0.106250,0.025000,0.025000},
-{0.243750,0.106250,0.050000,0.050000},
-{0.256250,0.106250,0.025000,0.025000},
-{0.256250,0.106250,0.050000,0.050000},
-{0.268750,0.106250,0.025000,0.025000},
-{0.268750,0.106250,0.050000,0.050000},
-{0.281250,0.106250,0.025000,0.025000},
-{0.281250,0.106250,0.050000,0.050000},
-{0.293750,0.106250,0.025000,0.025000},
-{0.293750,0.106250,0.050000,0.050000},
-{0.306250,0.106250,0.025000,0.025000},
-{0.306250,0.106250,0.050000,0.050000},
-{0.318750,0.106250,0.025000,0.025000},
-{0.318750,0.106250,0.050000,0.050000},
-{0.331250,0.106250,0.025000,0.025000},
-{0.331250,0.106250,0.050000,0.050000},
-{0.343750,0.106250,0.025000,0.025000},
-{0.343750,0.106250,0.050000,0.050000},
-{0.356250,0.106250,0.025000,0.025000},
-{0.356250,0.106250,0.050000,0.050000},
-{0.368750,0.106250,0.025000,0.025000},
-{0.368750,0.106250,0.050000,0.050000},
-{0.381250,0.106250,0.025000,0.025000},
-{0.381250,0.106250,0.050000,0.050000},
-{0.393750,0.106250,0.025000,0.025000},
-{0.393750,0.106250,0.050000,0.050000},
-{0.406250,0.106250,0.025000,0.025000},
-{0.406250,0.106250,0.050000,0.050000},
-{0.418750,0.106250,0.025000,0.025000},
-{0.418750,0.106250,0.050000,0.050000},
-{0.431250,0.106250,0.025000,0.025000},
-{0.431250,0.106250,0.050000,0.050000},
-{0.443750,0.106250,0.025000,0.025000},
-{0.443750,0.106250,0.050000,0.050000},
-{0.456250,0.106250,0.025000,0.025000},
-{0.456250,0.106250,0.050000,0.050000},
-{0.468750,0.106250,0.025000,0.025000},
-{0.468750,0.106250,0.050000,0.050000},
-{0.481250,0.106250,0.025000,0.025000},
-{0.481250,0.106250,0.050000,0.050000},
-{0.493750,0.106250,0.025000,0.025000},
-{0.493750,0.106250,0.050000,0.050000},
-{0.506250,0.106250,0.025000,0.025000},
-{0.506250,0.106250,0.050000,0.050000},
-{0.518750,0.106250,0.025000,0.025000},
-{0.518750,0.106250,0.050000,0.050000},
-{0.531250,0.106250,0.025000,0.025000},
-{0.531250,0.106250,0.050000,0.050000},
-{0.543750,0.106250,0.025000,0.025000},
-{0.543750,0.106250,0.050000,0.050000},
-{0.556250,0.106250,0.025000,0.025000},
-{0.556250,0.106250,0.050000,0.050000},
-{0.568750,0.106250,0.025000,0.025000},
-{0.568750,0.106250,0.050000,0.050000},
-{0.581250,0.106250,0.025000,0.025000},
-{0.581250,0.106250,0.050000,0.050000},
-{0.593750,0.106250,0.025000,0.025000},
-{0.593750,0.106250,0.050000,0.050000},
-{0.606250,0.106250,0.025000,0.025000},
-{0.606250,0.106250,0.050000,0.050000},
-{0.618750,0.106250,0.025000,0.025000},
-{0.618750,0.106250,0.050000,0.050000},
-{0.631250,0.106250,0.025000,0.025000},
-{0.631250,0.106250,0.050000,0.050000},
-{0.643750,0.106250,0.025000,0.025000},
-{0.643750,0.106250,0.050000,0.050000},
-{0.656250,0.106250,0.025000,0.025000},
-{0.656250,0.106250,0.050000,0.050000},
-{0.668750,0.106250,0.025000,0.025000},
-{0.668750,0.106250,0.050000,0.050000},
-{0.681250,0.106250,0.025000,0.025000},
-{0.681250,0.106250,0.050000,0.050000},
-{0.693750,0.106250,0.025000,0.025000},
-{0.693750,0.106250,0.050000,0.050000},
-{0.706250,0.106250,0.025000,0.025000},
-{0.706250,0.106250,0.050000,0.050000},
-{0.718750,0.106250,0.025000,0.025000},
-{0.718750,0.106250,0.050000,0.050000},
-{0.731250,0.106250,0.025000,0.025000},
-{0.731250,0.106250,0.050000,0.050000},
-{0.743750,0.106250,0.025000,0.025000},
-{0.743750,0.106250,0.050000,0.050000},
-{0.756250,0.106250,0.025000,0.025000},
-{0.756250,0.106250,0.050000,0.050000},
-{0.768750,0.106250,0.025000,0.025000},
-{0.768750,0.106250,0.050000,0.050000},
-{0.781250,0.106250,0.025000,0.025000},
-{0.781250,0.106250,0.050000,0.050000},
-{0.793750,0.106250,0.025000,0.025000},
-{0.793750,0.106250,0.050000,0.050000},
-{0.806250,0.106250,0.025000,0.025000},
-{0.806250,0.106250,0.050000,0.050000},
-{0.818750,0.106250,0.025000,0.025000},
-{0.818750,0.106250,0.050000,0.050000},
-{0.831250,0.106250,0.025000,0.025000},
-{0.831250,0.106250,0.050000,0.050000},
-{0.843750,0.106250,0.025000,0.025000},
-{0.843750,0.106250,0.050000,0.050000},
-{0.856250,0.106250,0.025000,0.025000},
-{0.856250,0.106250,0.050000,0.050000},
-{0.868750,0.106250,0.025000,0.025000},
-{0.868750,0.106250,0.050000,0.050000},
-{0.881250,0.106250,0.025000,0.025000},
-{0.881250,0.106250,0.050000,0.050000},
-{0.893750,0.106250,0.025000,0.025000},
-{0.893750,0.106250,0.050000,0.050000},
-{0.906250,0.106250,0.025000,0.025000},
-{0.906250,0.106250,0.050000,0.050000},
-{0.918750,0.106250,0.025000,0.025000},
-{0.918750,0.106250,0.050000,0.050000},
-{0.931250,0.106250,0.025000,0.025000},
-{0.931250,0.106250,0.050000,0.050000},
-{0.943750,0.106250,0.025000,0.025000},
-{0.943750,0.106250,0.050000,0.050000},
-{0.956250,0.106250,0.025000,0.025000},
-{0.956250,0.106250,0.050000,0.050000},
-{0.968750,0.106250,0.025000,0.025000},
-{0.968750,0.106250,0.050000,0.050000},
-{0.981250,0.106250,0.025000,0.025000},
-{0.981250,0.106250,0.050000,0.050000},
-{0.993750,0.106250,0.025000,0.025000},
-{0.993750,0.106250,0.050000,0.050000},
-{0.006250,0.118750,0.025000,0.025000},
-{0.006250,0.118750,0.050000,0.050000},
-{0.018750,0.118750,0.025000,0.025000},
-{0.018750,0.118750,0.050000,0.050000},
-{0.031250,0.118750,0.025000,0.025000},
-{0.031250,0.118750,0.050000,0.050000},
-{0.043750,0.118750,0.025000,0.025000},
-{0.043750,0.118750,0.050000,0.050000},
-{0.056250,0.118750,0.025000,0.025000},
-{0.056250,0.118750,0.050000,0.050000},
-{0.068750,0.118750,0.025000,0.025000},
-{0.068750,0.118750,0.050000,0.050000},
-{0.081250,0.118750,0.025000,0.025000},
-{0.081250,0.118750,0.050000,0.050000},
-{0.093750,0.118750,0.025000,0.025000},
-{0.093750,0.118750,0.050000,0.050000},
-{0.106250,0.118750,0.025000,0.025000},
-{0.106250,0.118750,0.050000,0.050000},
-{0.118750,0.118750,0.025000,0.025000},
-{0.118750,0.118750,0.050000,0.050000},
-{0.131250,0.118750,0.025000,0.025000},
-{0.131250,0.118750,0.050000,0.050000},
-{0.143750,0.118750,0.025000,0.025000},
-{0.143750,0.118750,0.050000,0.050000},
-{0.156250,0.118750,0.025000,0.025000},
-{0.156250,0.118750,0.050000,0.050000},
-{0.168750,0.118750,0.025000,0.025000},
-{0.168750,0.118750,0.050000,0.050000},
-{0.181250,0.118750,0.025000,0.025000},
-{0.181250,0.118750,0.050000,0.050000},
-{0.193750,0.118750,0.025000,0.025000},
-{0.193750,0.118750,0.050000,0.050000},
-{0.206250,0.118750,0.025000,0.025000},
-{0.206250,0.118750,0.050000,0.050000},
-{0.218750,0.118750,0.025000,0.025000},
-{0.218750,0.118750,0.050000,0.050000},
-{0.231250,0.118750,0.025000,0.025000},
-{0.231250,0.118750,0.050000,0.050000},
-{0.243750,0.118750,0.025000,0.025000},
-{0.243750,0.118750,0.050000,0.050000},
-{0.256250,0.118750,0.025000,0.025000},
-{0.256250,0.118750,0.050000,0.050000},
-{0.268750,0.118750,0.025000,0.025000},
-{0.268750,0.118750,0.050000,0.050000},
-{0.281250,0.118750,0.025000,0.025000},
-{0.281250,0.118750,0.050000,0.050000},
-{0.293750,0.118750,0.025000,0.025000},
-{0.293750,0.118750,0.050000,0.050000},
-{0.306250,0.118750,0.025000,0.025000},
-{0.306250,0.118750,0.050000,0.050000},
-{0.318750,0.118750,0.025000,0.025000},
-{0.318750,0.118750,0.050000,0.050000},
-{0.331250,0.118750,0.025000,0.025000},
-{0.331250,0.118750,0.050000,0.050000},
-{0.343750,0.118750,0.025000,0.025000},
-{0.343750,0.118750,0.050000,0.050000},
-{0.356250,0.118750,0.025000,0.025000},
-{0.356250,0.118750,0.050000,0.050000},
-{0.368750,0.118750,0.025000,0.025000},
-{0.368750,0.118750,0.050000,0.050000},
-{0.381250,0.118750,0.025000,0.025000},
-{0.381250,0.118750,0.050000,0.050000},
-{0.393750,0.118750,0.025000,0.025000},
-{0.393750,0.118750,0.050000,0.050000},
-{0.406250,0.118750,0.025000,0.025000},
-{0.406250,0.118750,0.050000,0.050000},
-{0.418750,0.118750,0.025000,0.025000},
-{0.418750,0.118750,0.050000,0.050000},
-{0.431250,0.118750,0.025000,0.025000},
-{0.431250,0.118750,0.050000,0.050000},
-{0.443750,0.118750,0.025000,0.025000},
-{0.443750,0.118750,0.050000,0.050000},
-{0.456250,0.118750,0.025000,0.025000},
-{0.456250,0.118750,0.050000,0.050000},
-{0.468750,0.118750,0.025000,0.025000},
-{0.468750,0.118750,0.050000,0.050000},
-{0.481250,0.118750,0.025000,0.025000},
-{0.481250,0.118750,0.050000,0.050000},
-{0.493750,0.118750,0.025000,0.025000},
-{0.493750,0.118750,0.050000,0.050000},
-{0.506250,0.118750,0.025000,0.025000},
-{0.506250,0.118750,0.050000,0.050000},
-{0.518750,0.118750,0.025000,0.025000},
-{0.518750,0.118750,0.050000,0.050000},
-{0.531250,0.118750,0.025000,0.025000},
-{0.531250,0.118750,0.050000,0.050000},
-{0.543750,0.118750,0.025000,0.025000},
-{0.543750,0.118750,0.050000,0.050000},
-{0.556250,0.118750,0.025000,0.025000},
-{0.556250,0.118750,0.050000,0.050000},
-{0.568750,0.118750,0.025000,0.025000},
-{0.568750,0.118750,0.050000,0.050000},
-{0.581250,0.118750,0.025000,0.025000},
-{0.581250,0.118750,0.050000,0.050000},
-{0.593750,0.118750,0.025000,0.025000},
-{0.593750,0.118750,0.050000,0.050000},
-{0.606250,0.118750,0.025000,0.025000},
-{0.606250,0.118750,0.050000,0.050000},
-{0.618750,0.118750,0.025000,0.025000},
-{0.618750,0.118750,0.050000,0.050000},
-{0.631250,0.118750,0.025000,0.025000},
-{0.631250,0.118750,0.050000,0.050000},
-{0.643750,0.118750,0.025000,0.025000},
-{0.643750,0.118750,0.050000,0.050000},
-{0.656250,0.118750,0.025000,0.025000},
-{0.656250,0.118750,0.050000,0.050000},
-{0.668750,0.118750,0.025000,0.025000},
-{0.668750,0.118750,0.050000,0.050000},
-{0.681250,0.118750,0.025000,0.025000},
-{0.681250,0.118750,0.050000,0.050000},
-{0.693750,0.118750,0.025000,0.025000},
-{0.693750,0.118750,0.050000,0.050000},
-{0.706250,0.118750,0.025000,0.025000},
-{0.706250,0.118750,0.050000,0.050000},
-{0.718750,0.118750,0.025000,0.025000},
-{0.718750,0.118750,0.050000,0.050000},
-{0.731250,0.118750,0.025000,0.025000},
-{0.731250,0.118750,0.050000,0.050000},
-{0.743750,0.118750,0.025000,0.025000},
-{0.743750,0.118750,0.050000,0.050000},
-{0.756250,0.118750,0.025000,0.025000},
-{0.756250,0.118750,0.050000,0.050000},
-{0.768750,0.118750,0.025000,0.025000},
-{0.768750,0.118750,0.050000,0.050000},
-{0.781250,0.118750,0.025000,0.025000},
-{0.781250,0.118750,0.050000,0.050000},
-{0.793750,0.118750,0.025000,0.025000},
-{0.793750,0.118750,0.050000,0.050000},
-{0.806250,0.118750,0.025000,0.025000},
-{0.806250,0.118750,0.050000,0.050000},
-{0.818750,0.118750,0.025000,0.025000},
-{0.818750,0.118750,0.050000,0.050000},
-{0.831250,0.118750,0.025000,0.025000},
-{0.831250,0.118750,0.050000,0.050000},
-{0.843750,0.118750,0.025000,0.025000},
-{0.843750,0.118750,0.050000,0.050000},
-{0.856250,0.118750,0.025000,0.025000},
-{0.856250,0.118750,0.050000,0.050000},
-{0.868750,0.118750,0.025000,0.025000},
-{0.868750,0.118750,0.050000,0.050000},
-{0.881250,0.118750,0.025000,0.025000},
-{0.881250,0.118750,0.050000,0.050000},
-{0.893750,0.118750,0.025000,0.025000},
-{0.893750,0.118750,0.050000,0.050000},
-{0.906250,0.118750,0.025000,0.025000},
-{0.906250,0.118750,0.050000,0.050000},
-{0.918750,0.118750,0.025000,0.025000},
-{0.918750,0.118750,0.050000,0.050000},
-{0.931250,0.118750,0.025000,0.025000},
-{0.931250,0.118750,0.050000,0.050000},
-{0.943750,0.118750,0.025000,0.025000},
-{0.943750,0.118750,0.050000,0.050000},
-{0.956250,0.118750,0.025000,0.025000},
-{0.956250,0.118750,0.050000,0.050000},
-{0.968750,0.118750,0.025000,0.025000},
-{0.968750,0.118750,0.050000,0.050000},
-{0.981250,0.118750,0.025000,0.025000},
-{0.981250,0.118750,0.050000,0.050000},
-{0.993750,0.118750,0.025000,0.025000},
-{0.993750,0.118750,0.050000,0.050000},
-{0.006250,0.131250,0.025000,0.025000},
-{0.006250,0.131250,0.050000,0.050000},
-{0.018750,0.131250,0.025000,0.025000},
-{0.018750,0.131250,0.050000,0.050000},
-{0.031250,0.131250,0.025000,0.025000},
-{0.031250,0.131250,0.050000,0.050000},
-{0.043750,0.131250,0.025000,0.025000},
-{0.043750,0.131250,0.050000,0.050000},
-{0.056250,0.131250,0.025000,0.025000},
-{0.056250,0.131250,0.050000,0.050000},
-{0.068750,0.131250,0.025000,0.025000},
-{0.068750,0.131250,0.050000,0.050000},
-{0.081250,0.131250,0.025000,0.025000},
-{0.081250,0.131250,0.050000,0.050000},
-{0.093750,0.131250,0.025000,0.025000},
-{0.093750,0.131250,0.050000,0.050000},
-{0.106250,0.131250,0.025000,0.025000},
-{0.106250,0.131250,0.050000,0.050000},
-{0.118750,0.131250,0.025000,0.025000},
-{0.118750,0.131250,0.050000,0.050000},
-{0.131250,0.131250,0.025000,0.025000},
-{0.131250,0.131250,0.050000,0.050000},
-{0.143750,0.131250,0.025000,0.025000},
-{0.143750,0.131250,0.050000,0.050000},
-{0.156250,0.131250,0.025000,0.025000},
-{0.156250,0.131250,0.050000,0.050000},
-{0.168750,0.131250,0.025000,0.025000},
-{0.168750,0.131250,0.050000,0.050000},
-{0.181250,0.131250,0.025000,0.025000},
-{0.181250,0.131250,0.050000,0.050000},
-{0.193750,0.131250,0.025000,0.025000},
-{0.193750,0.131250,0.050000,0.050000},
-{0.206250,0.131250,0.025000,0.025000},
-{0.206250,0.131250,0.050000,0.050000},
-{0.218750,0.131250,0.025000,0.025000},
-{0.218750,0.131250,0.050000,0.050000},
-{0.231250,0.131250,0.025000,0.025000},
-{0.231250,0.131250,0.050000,0.050000},
-{0.243750,0.131250,0.025000,0.025000},
-{0.243750,0.131250,0.050000,0.050000},
-{0.256250,0.131250,0.025000,0.025000},
-{0.256250,0.131250,0.050000,0.050000},
-{0.268750,0.131250,0.025000,0.025000},
-{0.268750,0.131250,0.050000,0.050000},
-{0.281250,0.131250,0.025000,0.025000},
-{0.281250,0.131250,0.050000,0.050000},
-{0.293750,0.131250,0.025000,0.025000},
-{0.293750,0.131250,0.050000,0.050000},
-{0.306250,0.131250,0.025000,0.025000},
-{0.306250,0.131250,0.050000,0.050000},
-{0.318750,0.131250,0.025000,0.025000},
-{0.318750,0.131250,0.050000,0.050000},
-{0.331250,0.131250,0.025000,0.025000},
-{0.331250,0.131250,0.050000,0.050000},
-{0.343750,0.131250,0.025000,0.025000},
-{0.343750,0.131250,0.050000,0.050000},
-{0.356250,0.131250,0.025000,0.025000},
-{0.356250,0.131250,0.050000,0.050000},
-{0.368750,0.131250,0.025000,0.025000},
-{0.368750,0.131250,0.050000,0.050000},
-{0.381250,0.131250,0.025000,0.025000},
-{0.381250,0.131250,0.050000,0.050000},
-{0.393750,0.131250,0.025000,0.025000},
-{0.393750,0.131250,0.050000,0.050000},
-{0.406250,0.131250,0.025000,0.025000},
-{0.406250,0.131250,0.050000,0.050000},
-{0.418750,0.131250,0.025000,0.025000},
-{0.418750,0.131250,0.050000,0.050000},
-{0.431250,0.131250,0.025000,0.025000},
-{0.431250,0.131250,0.050000,0.050000},
-{0.443750,0.131250,0.025000,0.025000},
-{0.443750,0.131250,0.050000,0.050000},
-{0.456250,0.131250,0.025000,0.025000},
-{0.456250,0.131250,0.050000,0.050000},
-{0.468750,0.131250,0.025000,0.025000},
-{0.468750,0.131250,0.050000,0.050000},
-{0.481250,0.131250,0.025000,0.025000},
-{0.481250,0.131250,0.050000,0.050000},
-{0.493750,0.131250,0.025000,0.025000},
-{0.493750,0.131250,0.050000,0.050000},
-{0.506250,0.131250,0.025000,0.025000},
-{0.506250,0.131250,0.050000,0.050000},
-{0.518750,0.131250,0.025000,0.025000},
-{0.518750,0.131250,0.050000,0.050000},
-{0.531250,0.131250,0.025000,0.025000},
-{0.531250,0.131250,0.050000,0.050000},
-{0.543750,0.131250,0.025000,0.025000},
-{0.543750,0.131250,0.050000,0.050000},
-{0.556250,0.131250,0.025000,0.025000},
-{0.556250,0.131250,0.050000,0.050000},
-{0.568750,0.131250,0.025000,0.025000},
-{0.568750,0.131250,0.050000,0.050000},
-{0.581250,0.131250,0.025000,0.025000},
-{0.581250,0.131250,0.050000,0.050000},
-{0.593750,0.131250,0.025000,0.025000},
-{0.593750,0.131250,0.050000,0.050000},
-{0.606250,0.131250,0.025000,0.025000},
-{0.606250,0.131250,0.050000,0.050000},
-{0.618750,0.131250,0.025000,0.025000},
-{0.618750,0.131250,0.050000,0.050000},
-{0.631250,0.131250,0.025000,0.025000},
-{0.631250,0.131250,0.050000,0.050000},
-{0.643750,0.131250,0.025000,0.025000},
-{0.643750,0.131250,0.050000,0.050000},
-{0.656250,0.131250,0.025000,0.025000},
-{0.656250,0.131250,0.050000,0.050000},
-{0.668750,0.131250,0.025000,0.025000},
-{0.668750,0.131250,0.050000,0.050000},
-{0.681250,0.131250,0.025000,0.025000},
-{0.681250,0.131250,0.050000,0.050000},
-{0.693750,0.131250,0.025000,0.025000},
-{0.693750,0.131250,0.050000,0.050000},
-{0.706250,0.131250,0.025000,0.025000},
-{0.706250,0.131250,0.050000,0.050000},
-{0.718750,0.131250,0.025000,0.025000},
-{0.718750,0.131250,0.050000,0.050000},
-{0.731250,0.131250,0.025000,0.025000},
-{0.731250,0.131250,0.050000,0.050000},
-{0.743750,0.131250,0.025000,0.025000},
-{0.743750,0.131250,0.050000,0.050000},
-{0.756250,0.131250,0.025000,0.025000},
-{0.756250,0.131250,0.050000,0.050000},
-{0.768750,0.131250,0.025000,0.025000},
-{0.768750,0.131250,0.050000,0.050000},
-{0.781250,0.131250,0.025000,0.025000},
-{0.781250,0.131250,0.050000,0.050000},
-{0.793750,0.131250,0.025000,0.025000},
-{0.793750,0.131250,0.050000,0.050000},
-{0.806250,0.131250,0.025000,0.025000},
-{0.806250,0.131250,0.050000,0.050000},
-{0.818750,0.131250,0.025000,0.025000},
-{0.818750,0.131250,0.050000,0.050000},
-{0.831250,0.131250,0.025000,0.025000},
-{0.831250,0.131250,0.050000,0.050000},
-{0.843750,0.131250,0.025000,0.025000},
-{0.843750,0.131250,0.050000,0.050000},
-{0.856250,0.131250,0.025000,0.025000},
-{0.856250,0.131250,0.050000,0.050000},
-{0.868750,0.131250,0.025000,0.025000},
-{0.868750,0.131250,0.050000,0.050000},
-{0.881250,0.131250,0.025000,0.025000},
-{0.881250,0.131250,0.050000,0.050000},
-{0.893750,0.131250,0.025000,0.025000},
-{0.893750,0.131250,0.050000,0.050000},
-{0.906250,0.131250,0.025000,0.025000},
-{0.906250,0.131250,0.050000,0.050000},
-{0.918750,0.131250,0.025000,0.025000},
-{0.918750,0.131250,0.050000,0.050000},
-{0.931250,0.131250,0.025000,0.025000},
-{0.931250,0.131250,0.050000,0.050000},
-{0.943750,0.131250,0.025000,0.025000},
-{0.943750,0.131250,0.050000,0.050000},
-{0.956250,0.131250,0.025000,0.025000},
-{0.956250,0.131250,0.050000,0.050000},
-{0.968750,0.131250,0.025000,0.025000},
-{0.968750,0.131250,0.050000,0.050000},
-{0.981250,0.131250,0.025000,0.025000},
-{0.981250,0.131250,0.050000,0.050000},
-{0.993750,0.131250,0.025000,0.025000},
-{0.993750,0.131250,0.050000,0.050000},
-{0.006250,0.143750,0.025000,0.025000},
-{0.006250,0.143750,0.050000,0.050000},
-{0.018750,0.143750,0.025000,0.025000},
-{0.018750,0.143750,0.050000,0.050000},
-{0.031250,0.143750,0.025000,0.025000},
-{0.031250,0.143750,0.050000,0.050000},
-{0.043750,0.143750,0.025000,0.025000},
-{0.043750,0.143750,0.050000,0.050000},
-{0.056250,0.143750,0.025000,0.025000},
-{0.056250,0.143750,0.050000,0.050000},
-{0.068750,0.143750,0.025000,0.025000},
-{0.068750,0.143750,0.050000,0.050000},
-{0.081250,0.143750,0.025000,0.025000},
-{0.081250,0.143750,0.050000,0.050000},
-{0.093750,0.143750,0.025000,0.025000},
-{0.093750,0.143750,0.050000,0.050000},
-{0.106250,0.143750,0.025000,0.025000},
-{0.106250,0.143750,0.050000,0.050000},
-{0.118750,0.143750,0.025000,0.025000},
-{0.118750,0.143750,0.050000,0.050000},
-{0.131250,0.143750,0.025000,0.025000},
-{0.131250,0.143750,0.050000,0.050000},
-{0.143750,0.143750,0.025000,0.025000},
-{0.143750,0.143750,0.050000,0.050000},
-{0.156250,0.143750,0.025000,0.025000},
-{0.156250,0.143750,0.050000,0.050000},
-{0.168750,0.143750,0.025000,0.025000},
-{0.168750,0.143750,0.050000,0.050000},
-{0.181250,0.143750,0.025000,0.025000},
-{0.181250,0.143750,0.050000,0.050000},
-{0.193750,0.143750,0.025000,0.025000},
-{0.193750,0.143750,0.050000,0.050000},
-{0.206250,0.143750,0.025000,0.025000},
-{0.206250,0.143750,0.050000,0.050000},
-{0.218750,0.143750,0.025000,0.025000},
-{0.218750,0.143750,0.050000,0.050000},
-{0.231250,0.143750,0.025000,0.025000},
-{0.231250,0.143750,0.050000,0.050000},
-{0.243750,0.143750,0.025000,0.025000},
-{0.243750,0.143750,0.050000,0.050000},
-{0.256250,0.143750,0.025000,0.025000},
-{0.256250,0.143750,0.050000,0.050000},
-{0.268750,0.143750,0.025000,0.025000},
-{0.268750,0.143750,0.050000,0.050000},
-{0.281250,0.143750,0.025000,0.025000},
-{0.281250,0.143750,0.050000,0.050000},
-{0.293750,0.143750,0.025000,0.025000},
-{0.293750,0.143750,0.050000,0.050000},
-{0.306250,0.143750,0.025000,0.025000},
-{0.306250,0.143750,0.050000,0.050000},
-{0.318750,0.143750,0.025000,0.025000},
-{0.318750,0.143750,0.050000,0.050000},
-{0.331250,0.143750,0.025000,0.025000},
-{0.331250,0.143750,0.050000,0.050000},
-{0.343750,0.143750,0.025000,0.025000},
-{0.343750,0.143750,0.050000,0.050000},
-{0.356250,0.143750,0.025000,0.025000},
-{0.356250,0.143750,0.050000,0.050000},
-{0.368750,0.143750,0.025000,0.025000},
-{0.368750,0.143750,0.050000,0.050000},
-{0.381250,0.143750,0.025000,0.025000},
-{0.381250,0.143750,0.050000,0.050000},
-{0.393750,0.143750,0.025000,0.025000},
-{0.393750,0.143750,0.050000,0.050000},
-{0.406250,0.143750,0.025000,0.025000},
-{0.406250,0.143750,0.050000,0.050000},
-{0.418750,0.143750,0.025000,0.025000},
-{0.418750,0.143750,0.050000,0.050000},
-{0.431250,0.143750,0.025000,0.025000},
-{0.431250,0.143750,0.050000,0.050000},
-{0.443750,0.143750,0.025000,0.025000},
-{0.443750,0.143750,0.050000,0.050000},
-{0.456250,0.143750,0.025000,0.025000},
-{0.456250,0.143750,0.050000,0.050000},
-{0.468750,0.143750,0.025000,0.025000},
-{0.468750,0.143750,0.050000,0.050000},
-{0.481250,0.143750,0.025000,0.025000},
-{0.481250,0.143750,0.050000,0.050000},
-{0.493750,0.143750,0.025000,0.025000},
-{0.493750,0.143750,0.050000,0.050000},
-{0.506250,0.143750,0.025000,0.025000},
-{0.506250,0.143750,0.050000,0.050000},
-{0.518750,0.143750,0.025000,0.025000},
-{0.518750,0.143750,0.050000,0.050000},
-{0.531250,0.143750,0.025000,0.025000},
-{0.531250,0.143750,0.050000,0.050000},
-{0.543750,0.143750,0.025000,0.025000},
-{0.543750,0.143750,0.050000,0.050000},
-{0.556250,0.143750,0.025000,0.025000},
-{0.556250,0.143750,0.050000,0.050000},
-{0.568750,0.143750,0.025000,0.025000},
-{0.568750,0.143750,0.050000,0.050000},
-{0.581250,0.143750,0.025000,0.025000},
-{0.581250,0.143750,0.050000,0.050000},
-{0.593750,0.143750,0.025000,0.025000},
-{0.593750,0.143750,0.050000,0.050000},
-{0.606250,0.143750,0.025000,0.025000},
-{0.606250,0.143750,0.050000,0.050000},
-{0.618750,0.143750,0.025000,0.025000},
-{0.618750,0.143750,0.050000,0.050000},
-{0.631250,0.143750,0.025000,0.025000},
-{0.631250,0.143750,0.050000,0.050000},
-{0.643750,0.143750,0.025000,0.025000},
-{0.643750,0.143750,0.050000,0.050000},
-{0.656250,0.143750,0.025000,0.025000},
-{0.656250,0.143750,0.050000,0.050000},
-{0.668750,0.143750,0.025000,0.025000},
-{0.668750,0.143750,0.050000,0.050000},
-{0.681250,0.143750,0.025000,0.025000},
-{0.681250,0.143750,0.050000,0.050000},
-{0.693750,0.143750,0.025000,0.025000},
-{0.693750,0.143750,0.050000,0.050000},
-{0.706250,0.143750,0.025000,0.025000},
-{0.706250,0.143750,0.050000,0.050000},
-{0.718750,0.143750,0.025000,0.025000},
-{0.718750,0.143750,0.050000,0.050000},
-{0.731250,0.143750,0.025000,0.025000},
-{0.731250,0.143750,0.050000,0.050000},
-{0.743750,0.143750,0.025000,0.025000},
-{0.743750,0.143750,0.050000,0.050000},
-{0.756250,0.143750,0.025000,0.025000},
-{0.756250,0.143750,0.050000,0.050000},
-{0.768750,0.143750,0.025000,0.025000},
-{0.768750,0.143750,0.050000,0.050000},
-{0.781250,0.143750,0.025000,0.025000},
-{0.781250,0.143750,0.050000,0.050000},
-{0.793750,0.143750,0.025000,0.025000},
-{0.793750,0.143750,0.050000,0.050000},
-{0.806250,0.143750,0.025000,0.025000},
-{0.806250,0.143750,0.050000,0.050000},
-{0.818750,0.143750,0.025000,0.025000},
-{0.818750,0.143750,0.050000,0.050000},
-{0.831250,0.143750,0.025000,0.025000},
-{0.831250,0.143750,0.050000,0.050000},
-{0.843750,0.143750,0.025000,0.025000},
-{0.843750,0.143750,0.050000,0.050000},
-{0.856250,0.143750,0.025000,0.025000},
-{0.856250,0.143750,0.050000,0.050000},
-{0.868750,0.143750,0.025000,0.025000},
-{0.868750,0.143750,0.050000,0.050000},
-{0.881250,0.143750,0.025000,0.025000},
-{0.881250,0.143750,0.050000,0.050000},
-{0.893750,0.143750,0.025000,0.025000},
-{0.893750,0.143750,0.050000,0.050000},
-{0.906250,0.143750,0.025000,0.025000},
-{0.906250,0.143750,0.050000,0.050000},
-{0.918750,0.143750,0.025000,0.025000},
-{0.918750,0.143750,0.050000,0.050000},
-{0.931250,0.143750,0.025000,0.025000},
-{0.931250,0.143750,0.050000,0.050000},
-{0.943750,0.143750,0.025000,0.025000},
-{0.943750,0.143750,0.050000,0.050000},
-{0.956250,0.143750,0.025000,0.025000},
-{0.956250,0.143750,0.050000,0.050000},
-{0.968750,0.143750,0.025000,0.025000},
-{0.968750,0.143750,0.050000,0.050000},
-{0.981250,0.143750,0.025000,0.025000},
-{0.981250,0.143750,0.050000,0.050000},
-{0.993750,0.143750,0.025000,0.025000},
-{0.993750,0.143750,0.050000,0.050000},
-{0.006250,0.156250,0.025000,0.025000},
-{0.006250,0.156250,0.050000,0.050000},
-{0.018750,0.156250,0.025000,0.025000},
-{0.018750,0.156250,0.050000,0.050000},
-{0.031250,0.156250,0.025000,0.025000},
-{0.031250,0.156250,0.050000,0.050000},
-{0.043750,0.156250,0.025000,0.025000},
-{0.043750,0.156250,0.050000,0.050000},
-{0.056250,0.156250,0.025000,0.025000},
-{0.056250,0.156250,0.050000,0.050000},
-{0.068750,0.156250,0.025000,0.025000},
-{0.068750,0.156250,0.050000,0.050000},
-{0.081250,0.156250,0.025000,0.025000},
-{0.081250,0.156250,0.050000,0.050000},
-{0.093750,0.156250,0.025000,0.025000},
-{0.093750,0.156250,0.050000,0.050000},
-{0.106250,0.156250,0.025000,0.025000},
-{0.106250,0.156250,0.050000,0.050000},
-{0.118750,0.156250,0.025000,0.025000},
-{0.118750,0.156250,0.050000,0.050000},
-{0.131250,0.156250,0.025000,0.025000},
-{0.131250,0.156250,0.050000,0.050000},
-{0.143750,0.156250,0.025000,0.025000},
-{0.143750,0.156250,0.050000,0.050000},
-{0.156250,0.156250,0.025000,0.025000},
-{0.156250,0.156250,0.050000,0.050000},
-{0.168750,0.156250,0.025000,0.025000},
-{0.168750,0.156250,0.050000,0.050000},
-{0.181250,0.156250,0.025000,0.025000},
-{0.181250,0.156250,0.050000,0.050000},
-{0.193750,0.156250,0.025000,0.025000},
-{0.193750,0.156250,0.050000,0.050000},
-{0.206250,0.156250,0.025000,0.025000},
-{0.206250,0.156250,0.050000,0.050000},
-{0.218750,0.156250,0.025000,0.025000},
-{0.218750,0.156250,0.050000,0.050000},
-{0.231250,0.156250,0.025000,0.025000},
-{0.231250,0.156250,0.050000,0.050000},
-{0.243750,0.156250,0.025000,0.025000},
-{0.243750,0.156250,0.050000,0.050000},
-{0.256250,0.156250,0.025000,0.025000},
-{0.256250,0.156250,0.050000,0.050000},
-{0.268750,0.156250,0.025000,0.025000},
-{0.268750,0.156250,0.050000,0.050000},
-{0.281250,0.156250,0.025000,0.025000},
-{0.281250,0.156250,0.050000,0.050000},
-{0.293750,0.156250,0.025000,0.025000},
-{0.293750,0.156250,0.050000,0.050000},
-{0.306250,0.156250,0.025000,0.025000},
-{0.306250,0.156250,0.050000,0.050000},
-{0.318750,0.156250,0.025000,0.025000},
-{0.318750,0.156250,0.050000,0.050000},
-{0.331250,0.156250,0.025000,0.025000},
-{0.331250,0.156250,0.050000,0.050000},
-{0.343750,0.156250,0.025000,0.025000},
-{0.343750,0.156250,0.050000,0.050000},
-{0.356250,0.156250,0.025000,0.025000},
-{0.356250,0.156250,0.050000,0.050000},
-{0.368750,0.156250,0.025000,0.025000},
-{0.368750,0.156250,0.050000,0.050000},
-{0.381250,0.156250,0.025000,0.025000},
-{0.381250,0.156250,0.050000,0.050000},
-{0.393750,0.156250,0.025000,0.025000},
-{0.393750,0.156250,0.050000,0.050000},
-{0.406250,0.156250,0.025000,0.025000},
-{0.406250,0.156250,0.050000,0.050000},
-{0.418750,0.156250,0.025000,0.025000},
-{0.418750,0.156250,0.050000,0.050000},
-{0.431250,0.156250,0.025000,0.025000},
-{0.431250,0.156250,0.050000,0.050000},
-{0.443750,0.156250,0.025000,0.025000},
-{0.443750,0.156250,0.050000,0.050000},
-{0.456250,0.156250,0.025000,0.025000},
-{0.456250,0.156250,0.050000,0.050000},
-{0.468750,0.156250,0.025000,0.025000},
-{0.468750,0.156250,0.050000,0.050000},
-{0.481250,0.156250,0.025000,0.025000},
-{0.481250,0.156250,0.050000,0.050000},
-{0.493750,0.156250,0.025000,0.025000},
-{0.493750,0.156250,0.050000,0.050000},
-{0.506250,0.156250,0.025000,0.025000},
-{0.506250,0.156250,0.050000,0.050000},
-{0.518750,0.156250,0.025000,0.025000},
-{0.518750,0.156250,0.050000,0.050000},
-{0.531250,0.156250,0.025000,0.025000},
-{0.531250,0.156250,0.050000,0.050000},
-{0.543750,0.156250,0.025000,0.025000},
-{0.543750,0.156250,0.050000,0.050000},
-{0.556250,0.156250,0.025000,0.025000},
-{0.556250,0.156250,0.050000,0.050000},
-{0.568750,0.156250,0.025000,0.025000},
-{0.568750,0.156250,0.050000,0.050000},
-{0.581250,0.156250,0.025000,0.025000},
-{0.581250,0.156250,0.050000,0.050000},
-{0.593750,0.156250,0.025000,0.025000},
-{0.593750,0.156250,0.050000,0.050000},
-{0.606250,0.156250,0.025000,0.025000},
-{0.606250,0.156250,0.050000,0.050000},
-{0.618750,0.156250,0.025000,0.025000},
-{0.618750,0.156250,0.050000,0.050000},
-{0.631250,0.156250,0.025000,0.025000},
-{0.631250,0.156250,0.050000,0.050000},
-{0.643750,0.156250,0.025000,0.025000},
-{0.643750,0.156250,0.050000,0.050000},
-{0.656250,0.156250,0.025000,0.025000},
-{0.656250,0.156250,0.050000,0.050000},
-{0.668750,0.156250,0.025000,0.025000},
-{0.668750,0.156250,0.050000,0.050000},
-{0.681250,0.156250,0.025000,0.025000},
-{0.681250,0.156250,0.050000,0.050000},
-{0.693750,0.156250,0.025000,0.025000},
-{0.693750,0.156250,0.050000,0.050000},
-{0.706250,0.156250,0.025000,0.025000},
-{0.706250,0.156250,0.050000,0.050000},
-{0.718750,0.156250,0.025000,0.025000},
-{0.718750,0.156250,0.050000,0.050000},
-{0.731250,0.156250,0.025000,0.025000},
-{0.731250,0.156250,0.050000,0.050000},
-{0.743750,0.156250,0.025000,0.025000},
-{0.743750,0.156250,0.050000,0.050000},
-{0.756250,0.156250,0.025000,0.025000},
-{0.756250,0.156250,0.050000,0.050000},
-{0.768750,0.156250,0.025000,0.025000},
-{0.768750,0.156250,0.050000,0.050000},
-{0.781250,0.156250,0.025000,0.025000},
-{0.781250,0.156250,0.050000,0.050000},
-{0.793750,0.156250,0.025000,0.025000},
-{0.793750,0.156250,0.050000,0.050000},
-{0.806250,0.156250,0.025000,0.025000},
-{0.806250,0.156250,0.050000,0.050000},
-{0.818750,0.156250,0.025000,0.025000},
-{0.818750,0.156250,0.050000,0.050000},
-{0.831250,0.156250,0.025000,0.025000},
-{0.831250,0.156250,0.050000,0.050000},
-{0.843750,0.156250,0.025000,0.025000},
-{0.843750,0.156250,0.050000,0.050000},
-{0.856250,0.156250,0.025000,0.025000},
-{0.856250,0.156250,0.050000,0.050000},
-{0.868750,0.156250,0.025000,0.025000},
-{0.868750,0.156250,0.050000,0.050000},
-{0.881250,0.156250,0.025000,0.025000},
-{0.881250,0.156250,0.050000,0.050000},
-{0.893750,0.156250,0.025000,0.025000},
-{0.893750,0.156250,0.050000,0.050000},
-{0.906250,0.156250,0.025000,0.025000},
-{0.906250,0.156250,0.050000,0.050000},
-{0.918750,0.156250,0.025000,0.025000},
-{0.918750,0.156250,0.050000,0.050000},
-{0.931250,0.156250,0.025000,0.025000},
-{0.931250,0.156250,0.050000,0.050000},
-{0.943750,0.156250,0.025000,0.025000},
-{0.943750,0.156250,0.050000,0.050000},
-{0.956250,0.156250,0.025000,0.025000},
-{0.956250,0.156250,0.050000,0.050000},
-{0.968750,0.156250,0.025000,0.025000},
-{0.968750,0.156250,0.050000,0.050000},
-{0.981250,0.156250,0.025000,0.025000},
-{0.981250,0.156250,0.050000,0.050000},
-{0.993750,0.156250,0.025000,0.025000},
-{0.993750,0.156250,0.050000,0.050000},
-{0.006250,0.168750,0.025000,0.025000},
-{0.006250,0.168750,0.050000,0.050000},
-{0.018750,0.168750,0.025000,0.025000},
-{0.018750,0.168750,0.050000,0.050000},
-{0.031250,0.168750,0.025000,0.025000},
-{0.031250,0.168750,0.050000,0.050000},
-{0.043750,0.168750,0.025000,0.025000},
-{0.043750,0.168750,0.050000,0.050000},
-{0.056250,0.168750,0.025000,0.025000},
-{0.056250,0.168750,0.050000,0.050000},
-{0.068750,0.168750,0.025000,0.025000},
-{0.068750,0.168750,0.050000,0.050000},
-{0.081250,0.168750,0.025000,0.025000},
-{0.081250,0.168750,0.050000,0.050000},
-{0.093750,0.168750,0.025000,0.025000},
-{0.093750,0.168750,0.050000,0.050000},
-{0.106250,0.168750,0.025000,0.025000},
-{0.106250,0.168750,0.050000,0.050000},
-{0.118750,0.168750,0.025000,0.025000},
-{0.118750,0.168750,0.050000,0.050000},
-{0.131250,0.168750,0.025000,0.025000},
-{0.131250,0.168750,0.050000,0.050000},
-{0.143750,0.168750,0.025000,0.025000},
-{0.143750,0.168750,0.050000,0.050000},
-{0.156250,0.168750,0.025000,0.025000},
-{0.156250,0.168750,0.050000,0.050000},
-{0.168750,0.168750,0.025000,0.025000},
-{0.168750,0.168750,0.050000,0.050000},
-{0.181250,0.168750,0.025000,0.025000},
-{0.181250,0.168750,0.050000,0.050000},
-{0.193750,0.168750,0.025000,0.025000},
-{0.193750,0.168750,0.050000,0.050000},
-{0.206250,0.168750,0.025000,0.025000},
-{0.206250,0.168750,0.050000,0.050000},
-{0.218750,0.168750,0.025000,0.025000},
-{0.218750,0.168750,0.050000,0.050000},
-{0.231250,0.168750,0.025000,0.025000},
-{0.231250,0.168750,0.050000,0.050000},
-{0.243750,0.168750,0.025000,0.025000},
-{0.243750,0.168750,0.050000,0.050000},
-{0.256250,0.168750,0.025000,0.025000},
-{0.256250,0.168750,0.050000,0.050000},
-{0.268750,0.168750,0.025000,0.025000},
-{0.268750,0.168750,0.050000,0.050000},
-{0.281250,0.168750,0.025000,0.025000},
-{0.281250,0.168750,0.050000,0.050000},
-{0.293750,0.168750,0.025000,0.025000},
-{0.293750,0.168750,0.050000,0.050000},
-{0.306250,0.168750,0.025000,0.025000},
-{0.306250,0.168750,0.050000,0.050000},
-{0.318750,0.168750,0.025000,0.025000},
-{0.318750,0.168750,0.050000,0.050000},
-{0.331250,0.168750,0.025000,0.025000},
-{0.331250,0.168750,0.050000,0.050000},
-{0.343750,0.168750,0.025000,0.025000},
-{0.343750,0.168750,0.050000,0.050000},
-{0.356250,0.168750,0.025000,0.025000},
-{0.356250,0.168750,0.050000,0.050000},
-{0.368750,0.168750,0.025000,0.025000},
-{0.368750,0.168750,0.050000,0.050000},
-{0.381250,0.168750,0.025000,0.025000},
-{0.381250,0.168750,0.050000,0.050000},
-{0.393750,0.168750,0.025000,0.025000},
-{0.393750,0.168750,0.050000,0.050000},
-{0.406250,0.168750,0.025000,0.025000},
-{0.406250,0.168750,0.050000,0.050000},
-{0.418750,0.168750,0.025000,0.025000},
-{0.418750,0.168750,0.050000,0.050000},
-{0.431250,0.168750,0.025000,0.025000},
-{0.431250,0.168750,0.050000,0.050000},
-{0.443750,0.168750,0.025000,0.025000},
-{0.443750,0.168750,0.050000,0.050000},
-{0.456250,0.168750,0.025000,0.025000},
-{0.456250,0.168750,0.050000,0.050000},
-{0.468750,0.168750,0.025000,0.025000},
-{0.468750,0.168750,0.050000,0.050000},
-{0.481250,0.168750,0.025000,0.025000},
-{0.481250,0.168750,0.050000,0.050000},
-{0.493750,0.168750,0.025000,0.025000},
-{0.493750,0.168750,0.050000,0.050000},
-{0.506250,0.168750,0.025000,0.025000},
-{0.506250,0.168750,0.050000,0.050000},
-{0.518750,0.168750,0.025000,0.025000},
-{0.518750,0.168750,0.050000,0.050000},
-{0.531250,0.168750,0.025000,0.025000},
-{0.531250,0.168750,0.050000,0.050000},
-{0.543750,0.168750,0.025000,0.025000},
-{0.543750,0.168750,0.050000,0.050000},
-{0.556250,0.168750,0.025000,0.025000},
-{0.556250,0.168750,0.050000,0.050000},
-{0.568750,0.168750,0.025000,0.025000},
-{0.568750,0.168750,0.050000,0.050000},
-{0.581250,0.168750,0.025000,0.025000},
-{0.581250,0.168750,0.050000,0.050000},
-{0.593750,0.168750,0.025000,0.025000},
-{0.593750,0.168750,0.050000,0.050000},
-{0.606250,0.168750,0.025000,0.025000},
-{0.606250,0.168750,0.050000,0.050000},
-{0.618750,0.168750,0.025000,0.025000},
-{0.618750,0.168750,0.050000,0.050000},
-{0.631250,0.168750,0.025000,0.025000},
-{0.631250,0.168750,0.050000,0.050000},
-{0.643750,0.168750,0.025000,0.025000},
-{0.643750,0.168750,0.050000,0.050000},
-{0.656250,0.168750,0.025000,0.025000},
-{0.656250,0.168750,0.050000,0.050000},
-{0.668750,0.168750,0.025000,0.025000},
-{0.668750,0.168750,0.050000,0.050000},
-{0.681250,0.168750,0.025000,0.025000},
-{0.681250,0.168750,0.050000,0.050000},
-{0.693750,0.168750,0.025000,0.025000},
-{0.693750,0.168750,0.050000,0.050000},
-{0.706250,0.168750,0.025000,0.025000},
-{0.706250,0.168750,0.050000,0.050000},
-{0.718750,0.168750,0.025000,0.025000},
-{0.718750,0.168750,0.050000,0.050000},
-{0.731250,0.168750,0.025000,0.025000},
-{0.731250,0.168750,0.050000,0.050000},
-{0.743750,0.168750,0.025000,0.025000},
-{0.743750,0.168750,0.050000,0.050000},
-{0.756250,0.168750,0.025000,0.025000},
-{0.756250,0.168750,0.050000,0.050000},
-{0.768750,0.168750,0.025000,0.025000},
-{0.768750,0.168750,0.050000,0.050000},
-{0.781250,0.168750,0.025000,0.025000},
-{0.781250,0.168750,0.050000,0.050000},
-{0.793750,0.168750,0.025000,0.025000},
-{0.793750,0.168750,0.050000,0.050000},
-{0.806250,0.168750,0.025000,0.025000},
-{0.806250,0.168750,0.050000,0.050000},
-{0.818750,0.168750,0.025000,0.025000},
-{0.818750,0.168750,0.050000,0.050000},
-{0.831250,0.168750,0.025000,0.025000},
-{0.831250,0.168750,0.050000,0.050000},
-{0.843750,0.168750,0.025000,0.025000},
-{0.843750,0.168750,0.050000,0.050000},
-{0.856250,0.168750,0.025000,0.025000},
-{0.856250,0.168750,0.050000,0.050000},
-{0.868750,0.168750,0.025000,0.025000},
-{0.868750,0.168750,0.050000,0.050000},
-{0.881250,0.168750,0.025000,0.025000},
-{0.881250,0.168750,0.050000,0.050000},
-{0.893750,0.168750,0.025000,0.025000},
-{0.893750,0.168750,0.050000,0.050000},
-{0.906250,0.168750,0.025000,0.025000},
-{0.906250,0.168750,0.050000,0.050000},
-{0.918750,0.168750,0.025000,0.025000},
-{0.918750,0.168750,0.050000,0.050000},
-{0.931250,0.168750,0.025000,0.025000},
-{0.931250,0.168750,0.050000,0.050000},
-{0.943750,0.168750,0.025000,0.025000},
-{0.943750,0.168750,0.050000,0.050000},
-{0.956250,0.168750,0.025000,0.025000},
-{0.956250,0.168750,0.050000,0.050000},
-{0.968750,0.168750,0.025000,0.025000},
-{0.968750,0.168750,0.050000,0.050000},
-{0.981250,0.168750,0.025000,0.025000},
-{0.981250,0.168750,0.050000,0.050000},
-{0.993750,0.168750,0.025000,0.025000},
-{0.993750,0.168750,0.050000,0.050000},
-{0.006250,0.181250,0.025000,0.025000},
-{0.006250,0.181250,0.050000,0.050000},
-{0.018750,0.181250,0.025000,0.025000},
-{0.018750,0.181250,0.050000,0.050000},
-{0.031250,0.181250,0.025000,0.025000},
-{0.031250,0.181250,0.050000,0.050000},
-{0.043750,0.181250,0.025000,0.025000},
-{0.043750,0.181250,0.050000,0.050000},
-{0.056250,0.181250,0.025000,0.025000},
-{0.056250,0.181250,0.050000,0.050000},
-{0.068750,0.181250,0.025000,0.025000},
-{0.068750,0.181250,0.050000,0.050000},
-{0.081250,0.181250,0.025000,0.025000},
-{0.081250,0.181250,0.050000,0.050000},
-{0.093750,0.181250,0.025000,0.025000},
-{0.093750,0.181250,0.050000,0.050000},
-{0.106250,0.181250,0.025000,0.025000},
-{0.106250,0.181250,0.050000,0.050000},
-{0.118750,0.181250,0.025000,0.025000},
-{0.118750,0.181250,0.050000,0.050000},
-{0.131250,0.181250,0.025000,0.025000},
-{0.131250,0.181250,0.050000,0.050000},
-{0.143750,0.181250,0.025000,0.025000},
-{0.143750,0.181250,0.050000,0.050000},
-{0.156250,0.181250,0.025000,0.025000},
-{0.156250,0.181250,0.050000,0.050000},
-{0.168750,0.181250,0.025000,0.025000},
-{0.168750,0.181250,0.050000,0.050000},
-{0.181250,0.181250,0.025000,0.025000},
-{0.181250,0.181250,0.050000,0.050000},
-{0.193750,0.181250,0.025000,0.025000},
-{0.193750,0.181250,0.050000,0.050000},
-{0.206250,0.181250,0.025000,0.025000},
-{0.206250,0.181250,0.050000,0.050000},
-{0.218750,0.181250,0.025000,0.025000},
-{0.218750,0.181250,0.050000,0.050000},
-{0.231250,0.181250,0.025000,0.025000},
-{0.231250,0.181250,0.050000,0.050000},
-{0.243750,0.181250,0.025000,0.025000},
-{0.243750,0.181250,0.050000,0.050000},
-{0.256250,0.181250,0.025000,0.025000},
-{0.256250,0.181250,0.050000,0.050000},
-{0.268750,0.181250,0.025000,0.025000},
-{0.268750,0.181250,0.050000,0.050000},
-{0.281250,0.181250,0.025000,0.025000},
-{0.281250,0.181250,0.050000,0.050000},
-{0.293750,0.181250,0.025000,0.025000},
-{0.293750,0.181250,0.050000,0.050000},
-{0.306250,0.181250,0.025000,0.025000},
-{0.306250,0.181250,0.050000,0.050000},
-{0.318750,0.181250,0.025000,0.025000},
-{0.318750,0.181250,0.050000,0.050000},
-{0.331250,0.181250,0.025000,0.025000},
-{0.331250,0.181250,0.050000,0.050000},
-{0.343750,0.181250,0.025000,0.025000},
-{0.343750,0.181250,0.050000,0.050000},
-{0.356250,0.181250,0.025000,0.025000},
-{0.356250,0.181250,0.050000,0.050000},
-{0.368750,0.181250,0.025000,0.025000},
-{0.368750,0.181250,0.050000,0.050000},
-{0.381250,0.181250,0.025000,0.025000},
-{0.381250,0.181250,0.050000,0.050000},
-{0.393750,0.181250,0.025000,0.025000},
-{0.393750,0.181250,0.050000,0.050000},
-{0.406250,0.181250,0.025000,0.025000},
-{0.406250,0.181250,0.050000,0.050000},
-{0.418750,0.181250,0.025000,0.025000},
-{0.418750,0.181250,0.050000,0.050000},
-{0.431250,0.181250,0.025000,0.025000},
-{0.431250,0.181250,0.050000,0.050000},
-{0.443750,0.181250,0.025000,0.025000},
-{0.443750,0.181250,0.050000,0.050000},
-{0.456250,0.181250,0.025000,0.025000},
-{0.456250,0.181250,0.050000,0.050000},
-{0.468750,0.181250,0.025000,0.025000},
-{0.468750,0.181250,0.050000,0.050000},
-{0.481250,0.181250,0.025000,0.025000},
-{0.481250,0.181250,0.050000,0.050000},
-{0.493750,0.181250,0.025000,0.025000},
-{0.493750,0.181250,0.050000,0.050000},
-{0.506250,0.181250,0.025000,0.025000},
-{0.506250,0.181250,0.050000,0.050000},
-{0.518750,0.181250,0.025000,0.025000},
-{0.518750,0.181250,0.050000,0.050000},
-{0.531250,0.181250,0.025000,0.025000},
-{0.531250,0.181250,0.050000,0.050000},
-{0.543750,0.181250,0.025000,0.025000},
-{0.543750,0.181250,0.050000,0.050000},
-{0.556250,0.181250,0.025000,0.025000},
-{0.556250,0.181250,0.050000,0.050000},
-{0.568750,0.181250,0.025000,0.025000},
-{0.568750,0.181250,0.050000,0.050000},
-{0.581250,0.181250,0.025000,0.025000},
-{0.581250,0.181250,0.050000,0.050000},
-{0.593750,0.181250,0.025000,0.025000},
-{0.593750,0.181250,0.050000,0.050000},
-{0.606250,0.181250,0.025000,0.025000},
-{0.606250,0.181250,0.050000,0.050000},
-{0.618750,0.181250,0.025000,0.025000},
-{0.618750,0.181250,0.050000,0.050000},
-{0.631250,0.181250,0.025000,0.025000},
-{0.631250,0.181250,0.050000,0.050000},
-{0.643750,0.181250,0.025000,0.025000},
-{0.643750,0.181250,0.050000,0.050000},
-{0.656250,0.181250,0.025000,0.025000},
-{0.656250,0.181250,0.050000,0.050000},
-{0.668750,0.181250,0.025000,0.025000},
-{0.668750,0.181250,0.050000,0.050000},
-{0.681250,0.181250,0.025000,0.025000},
-{0.681250,0.181250,0.050000,0.050000},
-{0.693750,0.181250,0.025000,0.025000},
-{0.693750,0.181250,0.050000,0.050000},
-{0.706250,0.181250,0.025000,0.025000},
-{0.706250,0.181250,0.050000,0.050000},
-{0.718750,0.181250,0.025000,0.025000},
-{0.718750,0.181250,0.050000,0.050000},
-{0.731250,0.181250,0.025000,0.025000},
-{0.731250,0.181250,0.050000,0.050000},
-{0.743750,0.181250,0.025000,0.025000},
-{0.743750,0.181250,0.050000,0.050000},
-{0.756250,0.181250,0.025000,0.025000},
-{0.756250,0.181250,0.050000,0.050000},
-{0.768750,0.181250,0.025000,0.025000},
-{0.768750,0.181250,0.050000,0.050000},
-{0.781250,0.181250,0.025000,0.025000},
-{0.781250,0.181250,0.050000,0.050000},
-{0.793750,0.181250,0.025000,0.025000},
-{0.793750,0.181250,0.050000,0.050000},
-{0.806250,0.181250,0.025000,0.025000},
-{0.806250,0.181250,0.050000,0.050000},
-{0.818750,0.181250,0.025000,0.025000},
-{0.818750,0.181250,0.050000,0.050000},
-{0.831250,0.181250,0.025000,0.025000},
-{0.831250,0.181250,0.050000,0.050000},
-{0.843750,0.181250,0.025000,0.025000},
-{0.843750,0.181250,0.050000,0.050000},
-{0.856250,0.181250,0.025000,0.025000},
-{0.856250,0.181250,0.050000,0.050000},
-{0.868750,0.181250,0.025000,0.025000},
-{0.868750,0.181250,0.050000,0.050000},
-{0.881250,0.181250,0.025000,0.025000},
-{0.881250,0.181250,0.050000,0.050000},
-{0.893750,0.181250,0.025000,0.025000},
-{0.893750,0.181250,0.050000,0.050000},
-{0.906250,0.181250,0.025000,0.025000},
-{0.906250,0.181250,0.050000,0.050000},
-{0.918750,0.181250,0.025000,0.025000},
-{0.918750,0.181250,0.050000,0.050000},
-{0.931250,0.181250,0.025000,0.025000},
-{0.931250,0.181250,0.050000,0.050000},
-{0.943750,0.181250,0.025000,0.025000},
-{0.943750,0.181250,0.050000,0.050000},
-{0.956250,0.181250,0.025000,0.025000},
-{0.956250,0.181250,0.050000,0.050000},
-{0.968750,0.181250,0.025000,0.025000},
-{0.968750,0.181250,0.050000,0.050000},
-{0.981250,0.181250,0.025000,0.025000},
-{0.981250,0.181250,0.050000,0.050000},
-{0.993750,0.181250,0.025000,0.025000},
-{0.993750,0.181250,0.050000,0.050000},
-{0.006250,0.193750,0.025000,0.025000},
-{0.006250,0.193750,0.050000,0.050000},
-{0.018750,0.193750,0.025000,0.025000},
-{0.018750,0.193750,0.050000,0.050000},
-{0.031250,0.193750,0.025000,0.025000},
-{0.031250,0.193750,0.050000,0.050000},
-{0.043750,0.193750,0.025000,0.025000},
-{0.043750,0.193750,0.050000,0.050000},
-{0.056250,0.193750,0.025000,0.025000},
-{0.056250,0.193750,0.050000,0.050000},
-{0.068750,0.193750,0.025000,0.025000},
-{0.068750,0.193750,0.050000,0.050000},
-{0.081250,0.193750,0.025000,0.025000},
-{0.081250,0.193750,0.050000,0.050000},
-{0.093750,0.193750,0.025000,0.025000},
-{0.093750,0.193750,0.050000,0.050000},
-{0.106250,0.193750,0.025000,0.025000},
-{0.106250,0.193750,0.050000,0.050000},
-{0.118750,0.193750,0.025000,0.025000},
-{0.118750,0.193750,0.050000,0.050000},
-{0.131250,0.193750,0.025000,0.025000},
-{0.131250,0.193750,0.050000,0.050000},
-{0.143750,0.193750,0.025000,0.025000},
-{0.143750,0.193750,0.050000,0.050000},
-{0.156250,0.193750,0.025000,0.025000},
-{0.156250,0.193750,0.050000,0.050000},
-{0.168750,0.193750,0.025000,0.025000},
-{0.168750,0.193750,0.050000,0.050000},
-{0.181250,0.193750,0.025000,0.025000},
-{0.181250,0.193750,0.050000,0.050000},
-{0.193750,0.193750,0.025000,0.025000},
-{0.193750,0.193750,0.050000,0.050000},
-{0.206250,0.193750,0.025000,0.025000},
-{0.206250,0.193750,0.050000,0.050000},
-{0.218750,0.193750,0.025000,0.025000},
-{0.218750,0.193750,0.050000,0.050000},
-{0.231250,0.193750,0.025000,0.025000},
-{0.231250,0.193750,0.050000,0.050000},
-{0.243750,0.193750,0.025000,0.025000},
-{0.243750,0.193750,0.050000,0.050000},
-{0.256250,0.193750,0.025000,0.025000},
-{0.256250,0.193750,0.050000,0.050000},
-{0.268750,0.193750,0.025000,0.025000},
-{0.268750,0.193750,0.050000,0.050000},
-{0.281250,0.193750,0.025000,0.025000},
-{0.281250,0.193750,0.050000,0.050000},
-{0.293750,0.193750,0.025000,0.025000},
-{0.293750,0.193750,0.050000,0.050000},
-{0.306250,0.193750,0.025000,0.025000},
-{0.306250,0.193750,0.050000,0.050000},
-{0.318750,0.193750,0.025000,0.025000},
-{0.318750,0.193750,0.050000,0.050000},
-{0.331250,0.193750,0.025000,0.025000},
-{0.331250,0.193750,0.050000,0.050000},
-{0.343750,0.193750,0.025000,0.025000},
-{0.343750,0.193750,0.050000,0.050000},
-{0.356250,0.193750,0.025000,0.025000},
-{0.356250,0.193750,0.050000,0.050000},
-{0.368750,0.193750,0.025000,0.025000},
-{0.368750,0.193750,0.050000,0.050000},
-{0.381250,0.193750,0.025000,0.025000},
-{0.381250,0.193750,0.050000,0.050000},
-{0.393750,0.193750,0.025000,0.025000},
-{0.393750,0.193750,0.050000,0.050000},
-{0.406250,0.193750,0.025000,0.025000},
-{0.406250,0.193750,0.050000,0.050000},
-{0.418750,0.193750,0.025000,0.025000},
-{0.418750,0.193750,0.050000,0.050000},
-{0.431250,0.193750,0.025000,0.025000},
-{0.431250,0.193750,0.050000,0.050000},
-{0.443750,0.193750,0.025000,0.025000},
-{0.443750,0.193750,0.050000,0.050000},
-{0.456250,0.193750,0.025000,0.025000},
-{0.456250,0.193750,0.050000,0.050000},
-{0.468750,0.193750,0.025000,0.025000},
-{0.468750,0.193750,0.050000,0.050000},
-{0.481250,0.193750,0.025000,0.025000},
-{0.481250,0.193750,0.050000,0.050000},
-{0.493750,0.193750,0.025000,0.025000},
-{0.493750,0.193750,0.050000,0.050000},
-{0.506250,0.193750,0.025000,0.025000},
-{0.506250,0.193750,0.050000,0.050000},
-{0.518750,0.193750,0.025000,0.025000},
-{0.518750,0.193750,0.050000,0.050000},
-{0.531250,0.193750,0.025000,0.025000},
-{0.531250,0.193750,0.050000,0.050000},
-{0.543750,0.193750,0.025000,0.025000},
-{0.543750,0.193750,0.050000,0.050000},
-{0.556250,0.193750,0.025000,0.025000},
-{0.556250,0.193750,0.050000,0.050000},
-{0.568750,0.193750,0.025000,0.025000},
-{0.568750,0.193750,0.050000,0.050000},
-{0.581250,0.193750,0.025000,0.025000},
-{0.581250,0.193750,0.050000,0.050000},
-{0.593750,0.193750,0.025000,0.025000},
-{0.593750,0.193750,0.050000,0.050000},
-{0.606250,0.193750,0.025000,0.025000},
-{0.606250,0.193750,0.050000,0.050000},
-{0.618750,0.193750,0.025000,0.025000},
-{0.618750,0.193750,0.050000,0.050000},
-{0.631250,0.193750,0.025000,0.025000},
-{0.631250,0.193750,0.050000,0.050000},
-{0.643750,0.193750,0.025000,0.025000},
-{0.643750,0.193750,0.050000,0.050000},
-{0.656250,0.193750,0.025000,0.025000},
-{0.656250,0.193750,0.050000,0.050000},
-{0.668750,0.193750,0.025000,0.025000},
-{0.668750,0.193750,0.050000,0.050000},
-{0.681250,0.193750,0.025000,0.025000},
-{0.681250,0.193750,0.050000,0.050000},
-{0.693750,0.193750,0.025000,0.025000},
-{0.693750,0.193750,0.050000,0.050000},
-{0.706250,0.193750,0.025000,0.025000},
-{0.706250,0.193750,0.050000,0.050000},
-{0.718750,0.193750,0.025000,0.025000},
-{0.718750,0.193750,0.050000,0.050000},
-{0.731250,0.193750,0.025000,0.025000},
-{0.731250,0.193750,0.050000,0.050000},
-{0.743750,0.193750,0.025000,0.025000},
-{0.743750,0.193750,0.050000,0.050000},
-{0.756250,0.193750,0.025000,0.025000},
-{0.756250,0.193750,0.050000,0.050000},
-{0.768750,0.193750,0.025000,0.025000},
-{0.768750,0.193750,0.050000,0.050000},
-{0.781250,0.193750,0.025000,0.025000},
-{0.781250,0.193750,0.050000,0.050000},
-{0.793750,0.193750,0.025000,0.025000},
-{0.793750,0.193750,0.050000,0.050000},
-{0.806250,0.193750,0.025000,0.025000},
-{0.806250,0.193750,0.050000,0.050000},
-{0.818750,0.193750,0.025000,0.025000},
-{0.818750,0.193750,0.050000,0.050000},
-{0.831250,0.193750,0.025000,0.025000},
-{0.831250,0.193750,0.050000,0.050000},
-{0.843750,0.193750,0.025000,0.025000},
-{0.843750,0.193750,0.050000,0.050000},
-{0.856250,0.193750,0.025000,0.025000},
-{0.856250,0.193750,0.050000,0.050000},
-{0.868750,0.193750,0.025000,0.025000},
-{0.868750,0.193750,0.050000,0.050000},
-{0.881250,0.193750,0.025000,0.025000},
-{0.881250,0.193750,0.050000,0.050000},
-{0.893750,0.193750,0.025000,0.025000},
-{0.893750,0.193750,0.050000,0.050000},
-{0.906250,0.193750,0.025000,0.025000},
-{0.906250,0.193750,0.050000,0.050000},
-{0.918750,0.193750,0.025000,0.025000},
-{0.918750,0.193750,0.050000,0.050000},
-{0.931250,0.193750,0.025000,0.025000},
-{0.931250,0.193750,0.050000,0.050000},
-{0.943750,0.193750,0.025000,0.025000},
-{0.943750,0.193750,0.050000,0.050000},
-{0.956250,0.193750,0.025000,0.025000},
-{0.956250,0.193750,0.050000,0.050000},
-{0.968750,0.193750,0.025000,0.025000},
-{0.968750,0.193750,0.050000,0.050000},
-{0.981250,0.193750,0.025000,0.025000},
-{0.981250,0.193750,0.050000,0.050000},
-{0.993750,0.193750,0.025000,0.025000},
-{0.993750,0.193750,0.050000,0.050000},
-{0.006250,0.206250,0.025000,0.025000},
-{0.006250,0.206250,0.050000,0.050000},
-{0.018750,0.206250,0.025000,0.025000},
-{0.018750,0.206250,0.050000,0.050000},
-{0.031250,0.206250,0.025000,0.025000},
-{0.031250,0.206250,0.050000,0.050000},
-{0.043750,0.206250,0.025000,0.025000},
-{0.043750,0.206250,0.050000,0.050000},
-{0.056250,0.206250,0.025000,0.025000},
-{0.056250,0.206250,0.050000,0.050000},
-{0.068750,0.206250,0.025000,0.025000},
-{0.068750,0.206250,0.050000,0.050000},
-{0.081250,0.206250,0.025000,0.025000},
-{0.081250,0.206250,0.050000,0.050000},
-{0.093750,0.206250,0.025000,0.025000},
-{0.093750,0.206250,0.050000,0.050000},
-{0.106250,0.206250,0.025000,0.025000},
-{0.106250,0.206250,0.050000,0.050000},
-{0.118750,0.206250,0.025000,0.025000},
-{0.118750,0.206250,0.050000,0.050000},
-{0.131250,0.206250,0.025000,0.025000},
-{0.131250,0.206250,0.050000,0.050000},
-{0.143750,0.206250,0.025000,0.025000},
-{0.143750,0.206250,0.050000,0.050000},
-{0.156250,0.206250,0.025000,0.025000},
-{0.156250,0.206250,0.050000,0.050000},
-{0.168750,0.206250,0.025000,0.025000},
-{0.168750,0.206250,0.050000,0.050000},
-{0.181250,0.206250,0.025000,0.025000},
-{0.181250,0.206250,0.050000,0.050000},
-{0.193750,0.206250,0.025000,0.025000},
-{0.193750,0.206250,0.050000,0.050000},
-{0.206250,0.206250,0.025000,0.025000},
-{0.206250,0.206250,0.050000,0.050000},
-{0.218750,0.206250,0.025000,0.025000},
-{0.218750,0.206250,0.050000,0.050000},
-{0.231250,0.206250,0.025000,0.025000},
-{0.231250,0.206250,0.050000,0.050000},
-{0.243750,0.206250,0.025000,0.025000},
-{0.243750,0.206250,0.050000,0.050000},
-{0.256250,0.206250,0.025000,0.025000},
-{0.256250,0.206250,0.050000,0.050000},
-{0.268750,0.206250,0.025000,0.025000},
-{0.268750,0.206250,0.050000,0.050000},
-{0.281250,0.206250,0.025000,0.025000},
-{0.281250,0.206250,0.050000,0.050000},
-{0.293750,0.206250,0.025000,0.025000},
-{0.293750,0.206250,0.050000,0.050000},
-{0.306250,0.206250,0.025000,0.025000},
-{0.306250,0.206250,0.050000,0.050000},
-{0.318750,0.206250,0.025000,0.025000},
-{0.318750,0.206250,0.050000,0.050000},
-{0.331250,0.206250,0.025000,0.025000},
-{0.331250,0.206250,0.050000,0.050000},
-{0.343750,0.206250,0.025000,0.025000},
-{0.343750,0.206250,0.050000,0.050000},
-{0.356250,0.206250,0.025000,0.025000},
-{0.356250,0.206250,0.050000,0.050000},
-{0.368750,0.206250,0.025000,0.025000},
-{0.368750,0.206250,0.050000,0.050000},
-{0.381250,0.206250,0.025000,0.025000},
-{0.381250,0.206250,0.050000,0.050000},
-{0.393750,0.206250,0.025000,0.025000},
-{0.393750,0.206250,0.050000,0.050000},
-{0.406250,0.206250,0.025000,0.025000},
-{0.406250,0.206250,0.050000,0.050000},
-{0.418750,0.206250,0.025000,0.025000},
-{0.418750,0.206250,0.050000,0.050000},
-{0.431250,0.206250,0.025000,0.025000},
-{0.431250,0.206250,0.050000,0.050000},
-{0.443750,0.206250,0.025000,0.025000},
-{0.443750,0.206250,0.050000,0.050000},
-{0.456250,0.206250,0.025000,0.025000},
-{0.456250,0.206250,0.050000,0.050000},
-{0.468750,0.206250,0.025000,0.025000},
-{0.468750,0.206250,0.050000,0.050000},
-{0.481250,0.206250,0.025000,0.025000},
-{0.481250,0.206250,0.050000,0.050000},
-{0.493750,0.206250,0.025000,0.025000},
-{0.493750,0.206250,0.050000,0.050000},
-{0.506250,0.206250,0.025000,0.025000},
-{0.506250,0.206250,0.050000,0.050000},
-{0.518750,0.206250,0.025000,0.025000},
-{0.518750,0.206250,0.050000,0.050000},
-{0.531250,0.206250,0.025000,0.025000},
-{0.531250,0.206250,0.050000,0.050000},
-{0.543750,0.206250,0.025000,0.025000},
-{0.543750,0.206250,0.050000,0.050000},
-{0.556250,0.206250,0.025000,0.025000},
-{0.556250,0.206250,0.050000,0.050000},
-{0.568750,0.206250,0.025000,0.025000},
-{0.568750,0.206250,0.050000,0.050000},
-{0.581250,0.206250,0.025000,0.025000},
-{0.581250,0.206250,0.050000,0.050000},
-{0.593750,0.206250,0.025000,0.025000},
-{0.593750,0.206250,0.050000,0.050000},
-{0.606250,0.206250,0.025000,0.025000},
-{0.606250,0.206250,0.050000,0.050000},
-{0.618750,0.206250,0.025000,0.025000},
-{0.618750,0.206250,0.050000,0.050000},
-{0.631250,0.206250,0.025000,0.025000},
-{0.631250,0.206250,0.050000,0.050000},
-{0.643750,0.206250,0.025000,0.025000},
-{0.643750,0.206250,0.050000,0.050000},
-{0.656250,0.206250,0.025000,0.025000},
-{0.656250,0.206250,0.050000,0.050000},
-{0.668750,0.206250,0.025000,0.025000},
-{0.668750,0.206250,0.050000,0.050000},
-{0.681250,0.206250,0.025000,0.025000},
-{0.681250,0.206250,0.050000,0.050000},
-{0.693750,0.206250,0.025000,0.025000},
-{0.693750,0.206250,0.050000,0.050000},
-{0.706250,0.206250,0.025000,0.025000},
-{0.706250,0.206250,0.050000,0.050000},
-{0.718750,0.206250,0.025000,0.025000},
-{0.718750,0.206250,0.050000,0.050000},
-{0.731250,0.206250,0.025000,0.025000},
-{0.731250,0.206250,0.050000,0.050000},
-{0.743750,0.206250,0.025000,0.025000},
-{0.743750,0.206250,0.050000,0.050000},
-{0.756250,0.206250,0.025000,0.025000},
-{0.756250,0.206250,0.050000,0.050000},
-{0.768750,0.206250,0.025000,0.025000},
-{0.768750,0.206250,0.050000,0.050000},
-{0.781250,0.206250,0.025000,0.025000},
-{0.781250,0.206250,0.050000,0.050000},
-{0.793750,0.206250,0.025000,0.025000},
-{0.793750,0.206250,0.050000,0.050000},
-{0.806250,0.206250,0.025000,0.025000},
-{0.806250,0.206250,0.050000,0.050000},
-{0.818750,0.206250,0.025000,0.025000},
-{0.818750,0.206250,0.050000,0.050000},
-{0.831250,0.206250,0.025000,0.025000},
-{0.831250,0.206250,0.050000,0.050000},
-{0.843750,0.206250,0.025000,0.025000},
-{0.843750,0.206250,0.050000,0.050000},
-{0.856250,0.206250,0.025000,0.025000},
-{0.856250,0.206250,0.050000,0.050000},
-{0.868750,0.206250,0.025000,0.025000},
-{0.868750,0.206250,0.050000,0.050000},
-{0.881250,0.206250,0.025000,0.025000},
-{0.881250,0.206250,0.050000,0.050000},
-{0.893750,0.206250,0.025000,0.025000},
-{0.893750,0.206250,0.050000,0.050000},
-{0.906250,0.206250,0.025000,0.025000},
-{0.906250,0.206250,0.050000,0.050000},
-{0.918750,0.206250,0.025000,0.025000},
-{0.918750,0.206250,0.050000,0.050000},
-{0.931250,0.206250,0.025000,0.025000},
-{0.931250,0.206250,0.050000,0.050000},
-{0.943750,0.206250,0.025000,0.025000},
-{0.943750,0.206250,0.050000,0.050000},
-{0.956250,0.206250,0.025000,0.025000},
-{0.956250,0.206250,0.050000,0.050000},
-{0.968750,0.206250,0.025000,0.025000},
-{0.968750,0.206250,0.050000,0.050000},
-{0.981250,0.206250,0.025000,0.025000},
-{0.981250,0.206250,0.050000,0.050000},
-{0.993750,0.206250,0.025000,0.025000},
-{0.993750,0.206250,0.050000,0.050000},
-{0.006250,0.218750,0.025000,0.025000},
-{0.006250,0.218750,0.050000,0.050000},
-{0.018750,0.218750,0.025000,0.025000},
-{0.018750,0.218750,0.050000,0.050000},
-{0.031250,0.218750,0.025000,0.025000},
-{0.031250,0.218750,0.050000,0.050000},
-{0.043750,0.218750,0.025000,0.025000},
-{0.043750,0.218750,0.050000,0.050000},
-{0.056250,0.218750,0.025000,0.025000},
-{0.056250,0.218750,0.050000,0.050000},
-{0.068750,0.218750,0.025000,0.025000},
-{0.068750,0.218750,0.050000,0.050000},
-{0.081250,0.218750,0.025000,0.025000},
-{0.081250,0.218750,0.050000,0.050000},
-{0.093750,0.218750,0.025000,0.025000},
-{0.093750,0.218750,0.050000,0.050000},
-{0.106250,0.218750,0.025000,0.025000},
-{0.106250,0.218750,0.050000,0.050000},
-{0.118750,0.218750,0.025000,0.025000},
-{0.118750,0.218750,0.050000,0.050000},
-{0.131250,0.218750,0.025000,0.025000},
-{0.131250,0.218750,0.050000,0.050000},
-{0.143750,0.218750,0.025000,0.025000},
-{0.143750,0.218750,0.050000,0.050000},
-{0.156250,0.218750,0.025000,0.025000},
-{0.156250,0.218750,0.050000,0.050000},
-{0.168750,0.218750,0.025000,0.025000},
-{0.168750,0.218750,0.050000,0.050000},
-{0.181250,0.218750,0.025000,0.025000},
-{0.181250,0.218750,0.050000,0.050000},
-{0.193750,0.218750,0.025000,0.025000},
-{0.193750,0.218750,0.050000,0.050000},
-{0.206250,0.218750,0.025000,0.025000},
-{0.206250,0.218750,0.050000,0.050000},
-{0.218750,0.218750,0.025000,0.025000},
-{0.218750,0.218750,0.050000,0.050000},
-{0.231250,0.218750,0.025000,0.025000},
-{0.231250,0.218750,0.050000,0.050000},
-{0.243750,0.218750,0.025000,0.025000},
-{0.243750,0.218750,0.050000,0.050000},
-{0.256250,0.218750,0.025000,0.025000},
-{0.256250,0.218750,0.050000,0.050000},
-{0.268750,0.218750,0.025000,0.025000},
-{0.268750,0.218750,0.050000,0.050000},
-{0.281250,0.218750,0.025000,0.025000},
-{0.281250,0.218750,0.050000,0.050000},
-{0.293750,0.218750,0.025000,0.025000},
-{0.293750,0.218750,0.050000,0.050000},
-{0.306250,0.218750,0.025000,0.025000},
-{0.306250,0.218750,0.050000,0.050000},
-{0.318750,0.218750,0.025000,0.025000},
-{0.318750,0.218750,0.050000,0.050000},
-{0.331250,0.218750,0.025000,0.025000},
-{0.331250,0.218750,0.050000,0.050000},
-{0.343750,0.218750,0.025000,0.025000},
-{0.343750,0.218750,0.050000,0.050000},
-{0.356250,0.218750,0.025000,0.025000},
-{0.356250,0.218750,0.050000,0.050000},
-{0.368750,0.218750,0.025000,0.025000},
-{0.368750,0.218750,0.050000,0.050000},
-{0.381250,0.218750,0.025000,0.025000},
-{0.381250,0.218750,0.050000,0.050000},
-{0.393750,0.218750,0.025000,0.025000},
-{0.393750,0.218750,0.050000,0.050000},
-{0.406250,0.218750,0.025000,0.025000},
-{0.406250,0.218750,0.050000,0.050000},
-{0.418750,0.218750,0.025000,0.025000},
-{0.418750,0.218750,0.050000,0.050000},
-{0.431250,0.218750,0.025000,0.025000},
-{0.431250,0.218750,0.050000,0.050000},
-{0.443750,0.218750,0.025000,0.025000},
-{0.443750,0.218750,0.050000,0.050000},
-{0.456250,0.218750,0.025000,0.025000},
-{0.456250,0.218750,0.050000,0.050000},
-{0.468750,0.218750,0.025000,0.025000},
-{0.468750,0.218750,0.050000,0.050000},
-{0.481250,0.218750,0.025000,0.025000},
-{0.481250,0.218750,0.050000,0.050000},
-{0.493750,0.218750,0.025000,0.025000},
-{0.493750,0.218750,0.050000,0.050000},
-{0.506250,0.218750,0.025000,0.025000},
-{0.506250,0.218750,0.050000,0.050000},
-{0.518750,0.218750,0.025000,0.025000},
-{0.518750,0.218750,0.050000,0.050000},
-{0.531250,0.218750,0.025000,0.025000},
-{0.531250,0.218750,0.050000,0.050000},
-{0.543750,0.218750,0.025000,0.025000},
-{0.543750,0.218750,0.050000,0.050000},
-{0.556250,0.218750,0.025000,0.025000},
-{0.556250,0.218750,0.050000,0.050000},
-{0.568750,0.218750,0.025000,0.025000},
-{0.568750,0.218750,0.050000,0.050000},
-{0.581250,0.218750,0.025000,0.025000},
-{0.581250,0.218750,0.050000,0.050000},
-{0.593750,0.218750,0.025000,0.025000},
-{0.593750,0.218750,0.050000,0.050000},
-{0.606250,0.218750,0.025000,0.025000},
-{0.606250,0.218750,0.050000,0.050000},
-{0.618750,0.218750,0.025000,0.025000},
-{0.618750,0.218750,0.050000,0.050000},
-{0.631250,0.218750,0.025000,0.025000},
-{0.631250,0.218750,0.050000,0.050000},
-{0.643750,0.218750,0.025000,0.025000},
-{0.643750,0.218750,0.050000,0.050000},
-{0.656250,0.218750,0.025000,0.025000},
-{0.656250,0.218750,0.050000,0.050000},
-{0.668750,0.218750,0.025000,0.025000},
-{0.668750,0.218750,0.050000,0.050000},
-{0.681250,0.218750,0.025000,0.025000},
-{0.681250,0.218750,0.050000,0.050000},
-{0.693750,0.218750,0.025000,0.025000},
-{0.693750,0.218750,0.050000,0.050000},
-{0.706250,0.218750,0.025000,0.025000},
-{0.706250,0.218750,0.050000,0.050000},
-{0.718750,0.218750,0.025000,0.025000},
-{0.718750,0.218750,0.050000,0.050000},
-{0.731250,0.218750,0.025000,0.025000},
-{0.731250,0.218750,0.050000,0.050000},
-{0.743750,0.218750,0.025000,0.025000},
-{0.743750,0.218750,0.050000,0.050000},
-{0.756250,0.218750,0.025000,0.025000},
-{0.756250,0.218750,0.050000,0.050000},
-{0.768750,0.218750,0.025000,0.025000},
-{0.768750,0.218750,0.050000,0.050000},
-{0.781250,0.218750,0.025000,0.025000},
-{0.781250,0.218750,0.050000,0.050000},
-{0.793750,0.218750,0.025000,0.025000},
-{0.793750,0.218750,0.050000,0.050000},
-{0.806250,0.218750,0.025000,0.025000},
-{0.806250,0.218750,0.050000,0.050000},
-{0.818750,0.218750,0.025000,0.025000},
-{0.818750,0.218750,0.050000,0.050000},
-{0.831250,0.218750,0.025000,0.025000},
-{0.831250,0.218750,0.050000,0.050000},
-{0.843750,0.218750,0.025000,0.025000},
-{0.843750,0.218750,0.050000,0.050000},
-{0.856250,0.218750,0.025000,0.025000},
-{0.856250,0.218750,0.050000,0.050000},
-{0.868750,0.218750,0.025000,0.025000},
-{0.868750,0.218750,0.050000,0.050000},
-{0.881250,0.218750,0.025000,0.025000},
-{0.881250,0.218750,0.050000,0.050000},
-{0.893750,0.218750,0.025000,0.025000},
-{0.893750,0.218750,0.050000,0.050000},
-{0.906250,0.218750,0.025000,0.025000},
-{0.906250,0.218750,0.050000,0.050000},
-{0.918750,0.218750,0.025000,0.025000},
-{0.918750,0.218750,0.050000,0.050000},
-{0.931250,0.218750,0.025000,0.025000},
-{0.931250,0.218750,0.050000,0.050000},
-{0.943750,0.218750,0.025000,0.025000},
-{0.943750,0.218750,0.050000,0.050000},
-{0.956250,0.218750,0.025000,0.025000},
-{0.956250,0.218750,0.050000,0.050000},
-{0.968750,0.218750,0.025000,0.025000},
-{0.968750,0.218750,0.050000,0.050000},
-{0.981250,0.218750,0.025000,0.025000},
-{0.981250,0.218750,0.050000,0.050000},
-{0.993750,0.218750,0.025000,0.025000},
-{0.993750,0.218750,0.050000,0.050000},
-{0.006250,0.231250,0.025000,0.025000},
-{0.006250,0.231250,0.050000,0.050000},
-{0.018750,0.231250,0.025000,0.025000},
-{0.018750,0.231250,0.050000,0.050000},
-{0.031250,0.231250,0.025000,0.025000},
-{0.031250,0.231250,0.050000,0.050000},
-{0.043750,0.231250,0.025000,0.025000},
-{0.043750,0.231250,0.050000,0.050000},
-{0.056250,0.231250,0.025000,0.025000},
-{0.056250,0.231250,0.050000,0.050000},
-{0.068750,0.231250,0.025000,0.025000},
-{0.068750,0.231250,0.050000,0.050000},
-{0.081250,0.231250,0.025000,0.025000},
-{0.081250,0.231250,0.050000,0.050000},
-{0.093750,0.231250,0.025000,0.025000},
-{0.093750,0.231250,0.050000,0.050000},
-{0.106250,0.231250,0.025000,0.025000},
-{0.106250,0.231250,0.050000,0.050000},
-{0.118750,0.231250,0.025000,0.025000},
-{0.118750,0.231250,0.050000,0.050000},
-{0.131250,0.231250,0.025000,0.025000},
-{0.131250,0.231250,0.050000,0.050000},
-{0.143750,0.231250,0.025000,0.025000},
-{0.143750,0.231250,0.050000,0.050000},
-{0.156250,0.231250,0.025000,0.025000},
-{0.156250,0.231250,0.050000,0.050000},
-{0.168750,0.231250,0.025000,0.025000},
-{0.168750,0.231250,0.050000,0.050000},
-{0.181250,0.231250,0.025000,0.025000},
-{0.181250,0.231250,0.050000,0.050000},
-{0.193750,0.231250,0.025000,0.025000},
-{0.193750,0.231250,0.050000,0.050000},
-{0.206250,0.231250,0.025000,0.025000},
-{0.206250,0.231250,0.050000,0.050000},
-{0.218750,0.231250,0.025000,0.025000},
-{0.218750,0.231250,0.050000,0.050000},
-{0.231250,0.231250,0.025000,0.025000},
-{0.231250,0.231250,0.050000,0.050000},
-{0.243750,0.231250,0.025000,0.025000},
-{0.243750,0.231250,0.050000,0.050000},
-{0.256250,0.231250,0.025000,0.025000},
-{0.256250,0.231250,0.050000,0.050000},
-{0.268750,0.231250,0.025000,0.025000},
-{0.268750,0.231250,0.050000,0.050000},
-{0.281250,0.231250,0.025000,0.025000},
-{0.281250,0.231250,0.050000,0.050000},
-{0.293750,0.231250,0.025000,0.025000},
-{0.293750,0.231250,0.050000,0.050000},
-{0.306250,0.231250,0.025000,0.025000},
-{0.306250,0.231250,0.050000,0.050000},
-{0.318750,0.231250,0.025000,0.025000},
-{0.318750,0.231250,0.050000,0.050000},
-{0.331250,0.231250,0.025000,0.025000},
-{0.331250,0.231250,0.050000,0.050000},
-{0.343750,0.231250,0.025000,0.025000},
-{0.343750,0.231250,0.050000,0.050000},
-{0.356250,0.231250,0.025000,0.025000},
-{0.356250,0.231250,0.050000,0.050000},
-{0.368750,0.231250,0.025000,0.025000},
-{0.368750,0.231250,0.050000,0.050000},
-{0.381250,0.231250,0.025000,0.025000},
-{0.381250,0.231250,0.050000,0.050000},
-{0.393750,0.231250,0.025000,0.025000},
-{0.393750,0.231250,0.050000,0.050000},
-{0.406250,0.231250,0.025000,0.025000},
-{0.406250,0.231250,0.050000,0.050000},
-{0.418750,0.231250,0.025000,0.025000},
-{0.418750,0.231250,0.050000,0.050000},
-{0.431250,0.231250,0.025000,0.025000},
-{0.431250,0.231250,0.050000,0.050000},
-{0.443750,0.231250,0.025000,0.025000},
-{0.443750,0.231250,0.050000,0.050000},
-{0.456250,0.231250,0.025000,0.025000},
-{0.456250,0.231250,0.050000,0.050000},
-{0.468750,0.231250,0.025000,0.025000},
-{0.468750,0.231250,0.050000,0.050000},
-{0.481250,0.231250,0.025000,0.025000},
-{0.481250,0.231250,0.050000,0.050000},
-{0.493750,0.231250,0.025000,0.025000},
-{0.493750,0.231250,0.050000,0.050000},
-{0.506250,0.231250,0.025000,0.025000},
-{0.506250,0.231250,0.050000,0.050000},
-{0.518750,0.231250,0.025000,0.025000},
-{0.518750,0.231250,0.050000,0.050000},
-{0.531250,0.231250,0.025000,0.025000},
-{0.531250,0.231250,0.050000,0.050000},
-{0.543750,0.231250,0.025000,0.025000},
-{0.543750,0.231250,0.050000,0.050000},
-{0.556250,0.231250,0.025000,0.025000},
-{0.556250,0.231250,0.050000,0.050000},
-{0.568750,0.231250,0.025000,0.025000},
-{0.568750,0.231250,0.050000,0.050000},
-{0.581250,0.231250,0.025000,0.025000},
-{0.581250,0.231250,0.050000,0.050000},
-{0.593750,0.231250,0.025000,0.025000},
-{0.593750,0.231250,0.050000,0.050000},
-{0.606250,0.231250,0.025000,0.025000},
-{0.606250,0.231250,0.050000,0.050000},
-{0.618750,0.231250,0.025000,0.025000},
-{0.618750,0.231250,0.050000,0.050000},
-{0.631250,0.231250,0.025000,0.025000},
-{0.631250,0.231250,0.050000,0.050000},
-{0.643750,0.231250,0.025000,0.025000},
-{0.643750,0.231250,0.050000,0.050000},
-{0.656250,0.231250,0.025000,0.025000},
-{0.656250,0.231250,0.050000,0.050000},
-{0.668750,0.231250,0.025000,0.025000},
-{0.668750,0.231250,0.050000,0.050000},
-{0.681250,0.231250,0.025000,0.025000},
-{0.681250,0.231250,0.050000,0.050000},
-{0.693750,0.231250,0.025000,0.025000},
-{0.693750,0.231250,0.050000,0.050000},
-{0.706250,0.231250,0.025000,0.025000},
-{0.706250,0.231250,0.050000,0.050000},
-{0.718750,0.231250,0.025000,0.025000},
-{0.718750,0.231250,0.050000,0.050000},
-{0.731250,0.231250,0.025000,0.025000},
-{0.731250,0.231250,0.050000,0.050000},
-{0.743750,0.231250,0.025000,0.025000},
-{0.743750,0.231250,0.050000,0.050000},
-{0.756250,0.231250,0.025000,0.025000},
-{0.756250,0.231250,0.050000,0.050000},
-{0.768750,0.231250,0.025000,0.025000},
-{0.768750,0.231250,0.050000,0.050000},
-{0.781250,0.231250,0.025000,0.025000},
-{0.781250,0.231250,0.050000,0.050000},
-{0.793750,0.231250,0.025000,0.025000},
-{0.793750,0.231250,0.050000,0.050000},
-{0.806250,0.231250,0.025000,0.025000},
-{0.806250,0.231250,0.050000,0.050000},
-{0.818750,0.231250,0.025000,0.025000},
-{0.818750,0.231250,0.050000,0.050000},
-{0.831250,0.231250,0.025000,0.025000},
-{0.831250,0.231250,0.050000,0.050000},
-{0.843750,0.231250,0.025000,0.025000},
-{0.843750,0.231250,0.050000,0.050000},
-{0.856250,0.231250,0.025000,0.025000},
-{0.856250,0.231250,0.050000,0.050000},
-{0.868750,0.231250,0.025000,0.025000},
-{0.868750,0.231250,0.050000,0.050000},
-{0.881250,0.231250,0.025000,0.025000},
-{0.881250,0.231250,0.050000,0.050000},
-{0.893750,0.231250,0.025000,0.025000},
-{0.893750,0.231250,0.050000,0.050000},
-{0.906250,0.231250,0.025000,0.025000},
-{0.906250,0.231250,0.050000,0.050000},
-{0.918750,0.231250,0.025000,0.025000},
-{0.918750,0.231250,0.050000,0.050000},
-{0.931250,0.231250,0.025000,0.025000},
-{0.931250,0.231250,0.050000,0.050000},
-{0.943750,0.231250,0.025000,0.025000},
-{0.943750,0.231250,0.050000,0.050000},
-{0.956250,0.231250,0.025000,0.025000},
-{0.956250,0.231250,0.050000,0.050000},
-{0.968750,0.231250,0.025000,0.025000},
-{0.968750,0.231250,0.050000,0.050000},
-{0.981250,0.231250,0.025000,0.025000},
-{0.981250,0.231250,0.050000,0.050000},
-{0.993750,0.231250,0.025000,0.025000},
-{0.993750,0.231250,0.050000,0.050000},
-{0.006250,0.243750,0.025000,0.025000},
-{0.006250,0.243750,0.050000,0.050000},
-{0.018750,0.243750,0.025000,0.025000},
-{0.018750,0.243750,0.050000,0.050000},
-{0.031250,0.243750,0.025000,0.025000},
-{0.031250,0.243750,0.050000,0.050000},
-{0.043750,0.243750,0.025000,0.025000},
-{0.043750,0.243750,0.050000,0.050000},
-{0.056250,0.243750,0.025000,0.025000},
-{0.056250,0.243750,0.050000,0.050000},
-{0.068750,0.243750,0.025000,0.025000},
-{0.068750,0.243750,0.050000,0.050000},
-{0.081250,0.243750,0.025000,0.025000},
-{0.081250,0.243750,0.050000,0.050000},
-{0.093750,0.243750,0.025000,0.025000},
-{0.093750,0.243750,0.050000,0.050000},
-{0.106250,0.243750,0.025000,0.025000},
-{0.106250,0.243750,0.050000,0.050000},
-{0.118750,0.243750,0.025000,0.025000},
-{0.118750,0.243750,0.050000,0.050000},
-{0.131250,0.243750,0.025000,0.025000},
-{0.131250,0.243750,0.050000,0.050000},
-{0.143750,0.243750,0.025000,0.025000},
-{0.143750,0.243750,0.050000,0.050000},
-{0.156250,0.243750,0.025000,0.025000},
-{0.156250,0.243750,0.050000,0.050000},
-{0.168750,0.243750,0.025000,0.025000},
-{0.168750,0.243750,0.050000,0.050000},
-{0.181250,0.243750,0.025000,0.025000},
-{0.181250,0.243750,0.050000,0.050000},
-{0.193750,0.243750,0.025000,0.025000},
-{0.193750,0.243750,0.050000,0.050000},
-{0.206250,0.243750,0.025000,0.025000},
-{0.206250,0.243750,0.050000,0.050000},
-{0.218750,0.243750,0.025000,0.025000},
-{0.218750,0.243750,0.050000,0.050000},
-{0.231250,0.243750,0.025000,0.025000},
-{0.231250,0.243750,0.050000,0.050000},
-{0.243750,0.243750,0.025000,0.025000},
-{0.243750,0.243750,0.050000,0.050000},
-{0.256250,0.243750,0.025000,0.025000},
-{0.256250,0.243750,0.050000,0.050000},
-{0.268750,0.243750,0.025000,0.025000},
-{0.268750,0.243750,0.050000,0.050000},
-{0.281250,0.243750,0.025000,0.025000},
-{0.281250,0.243750,0.050000,0.050000},
-{0.293750,0.243750,0.025000,0.025000},
-{0.293750,0.243750,0.050000,0.050000},
-{0.306250,0.243750,0.025000,0.025000},
-{0.306250,0.243750,0.050000,0.050000},
-{0.318750,0.243750,0.025000,0.025000},
-{0.318750,0.243750,0.050000,0.050000},
-{0.331250,0.243750,0.025000,0.025000},
-{0.331250,0.243750,0.050000,0.050000},
-{0.343750,0.243750,0.025000,0.025000},
-{0.343750,0.243750,0.050000,0.050000},
-{0.356250,0.243750,0.025000,0.025000},
-{0.356250,0.243750,0.050000,0.050000},
-{0.368750,0.243750,0.025000,0.025000},
-{0.368750,0.243750,0.050000,0.050000},
-{0.381250,0.243750,0.025000,0.025000},
-{0.381250,0.243750,0.050000,0.050000},
-{0.393750,0.243750,0.025000,0.025000},
-{0.393750,0.243750,0.050000,0.050000},
-{0.406250,0.243750,0.025000,0.025000},
-{0.406250,0.243750,0.050000,0.050000},
-{0.418750,0.243750,0.025000,0.025000},
-{0.418750,0.243750,0.050000,0.050000},
-{0.431250,0.243750,0.025000,0.025000},
-{0.431250,0.243750,0.050000,0.050000},
-{0.443750,0.243750,0.025000,0.025000},
-{0.443750,0.243750,0.050000,0.050000},
-{0.456250,0.243750,0.025000,0.025000},
-{0.456250,0.243750,0.050000,0.050000},
-{0.468750,0.243750,0.025000,0.025000},
-{0.468750,0.243750,0.050000,0.050000},
-{0.481250,0.243750,0.025000,0.025000},
-{0.481250,0.243750,0.050000,0.050000},
-{0.493750,0.243750,0.025000,0.025000},
-{0.493750,0.243750,0.050000,0.050000},
-{0.506250,0.243750,0.025000,0.025000},
-{0.506250,0.243750,0.050000,0.050000},
-{0.518750,0.243750,0.025000,0.025000},
-{0.518750,0.243750,0.050000,0.050000},
-{0.531250,0.243750,0.025000,0.025000},
-{0.531250,0.243750,0.050000,0.050000},
-{0.543750,0.243750,0.025000,0.025000},
-{0.543750,0.243750,0.050000,0.050000},
-{0.556250,0.243750,0.025000,0.025000},
-{0.556250,0.243750,0.050000,0.050000},
-{0.568750,0.243750,0.025000,0.025000},
-{0.568750,0.243750,0.050000,0.050000},
-{0.581250,0.243750,0.025000,0.025000},
-{0.581250,0.243750,0.050000,0.050000},
-{0.593750,0.243750,0.025000,0.025000},
-{0.593750,0.243750,0.050000,0.050000},
-{0.606250,0.243750,0.025000,0.025000},
-{0.606250,0.243750,0.050000,0.050000},
-{0.618750,0.243750,0.025000,0.025000},
-{0.618750,0.243750,0.050000,0.050000},
-{0.631250,0.243750,0.025000,0.025000},
-{0.631250,0.243750,0.050000,0.050000},
-{0.643750,0.243750,0.025000,0.025000},
-{0.643750,0.243750,0.050000,0.050000},
-{0.656250,0.243750,0.025000,0.025000},
-{0.656250,0.243750,0.050000,0.050000},
-{0.668750,0.243750,0.025000,0.025000},
-{0.668750,0.243750,0.050000,0.050000},
-{0.681250,0.243750,0.025000,0.025000},
-{0.681250,0.243750,0.050000,0.050000},
-{0.693750,0.243750,0.025000,0.025000},
-{0.693750,0.243750,0.050000,0.050000},
-{0.706250,0.243750,0.025000,0.025000},
-{0.706250,0.243750,0.050000,0.050000},
-{0.718750,0.243750,0.025000,0.025000},
-{0.718750,0.243750,0.050000,0.050000},
-{0.731250,0.243750,0.025000,0.025000},
-{0.731250,0.243750,0.050000,0.050000},
-{0.743750,0.243750,0.025000,0.025000},
-{0.743750,0.243750,0.050000,0.050000},
-{0.756250,0.243750,0.025000,0.025000},
-{0.756250,0.243750,0.050000,0.050000},
-{0.768750,0.243750,0.025000,0.025000},
-{0.768750,0.243750,0.050000,0.050000},
-{0.781250,0.243750,0.025000,0.025000},
-{0.781250,0.243750,0.050000,0.050000},
-{0.793750,0.243750,0.025000,0.025000},
-{0.793750,0.243750,0.050000,0.050000},
-{0.806250,0.243750,0.025000,0.025000},
-{0.806250,0.243750,0.050000,0.050000},
-{0.818750,0.243750,0.025000,0.025000},
-{0.818750,0.243750,0.050000,0.050000},
-{0.831250,0.243750,0.025000,0.025000},
-{0.831250,0.243750,0.050000,0.050000},
-{0.843750,0.243750,0.025000,0.025000},
-{0.843750,0.243750,0.050000,0.050000},
-{0.856250,0.243750,0.025000,0.025000},
-{0.856250,0.243750,0.050000,0.050000},
-{0.868750,0.243750,0.025000,0.025000},
-{0.868750,0.243750,0.050000,0.050000},
-{0.881250,0.243750,0.025000,0.025000},
-{0.881250,0.243750,0.050000,0.050000},
-{0.893750,0.243750,0.025000,0.025000},
-{0.893750,0.243750,0.050000,0.050000},
-{0.906250,0.243750,0.025000,0.025000},
-{0.906250,0.243750,0.050000,0.050000},
-{0.918750,0.243750,0.025000,0.025000},
-{0.918750,0.243750,0.050000,0.050000},
-{0.931250,0.243750,0.025000,0.025000},
-{0.931250,0.243750,0.050000,0.050000},
-{0.943750,0.243750,0.025000,0.025000},
-{0.943750,0.243750,0.050000,0.050000},
-{0.956250,0.243750,0.025000,0.025000},
-{0.956250,0.243750,0.050000,0.050000},
-{0.968750,0.243750,0.025000,0.025000},
-{0.968750,0.243750,0.050000,0.050000},
-{0.981250,0.243750,0.025000,0.025000},
-{0.981250,0.243750,0.050000,0.050000},
-{0.993750,0.243750,0.025000,0.025000},
-{0.993750,0.243750,0.050000,0.050000},
-{0.006250,0.256250,0.025000,0.025000},
-{0.006250,0.256250,0.050000,0.050000},
-{0.018750,0.256250,0.025000,0.025000},
-{0.018750,0.256250,0.050000,0.050000},
-{0.031250,0.256250,0.025000,0.025000},
-{0.031250,0.256250,0.050000,0.050000},
-{0.043750,0.256250,0.025000,0.025000},
-{0.043750,0.256250,0.050000,0.050000},
-{0.056250,0.256250,0.025000,0.025000},
-{0.056250,0.256250,0.050000,0.050000},
-{0.068750,0.256250,0.025000,0.025000},
-{0.068750,0.256250,0.050000,0.050000},
-{0.081250,0.256250,0.025000,0.025000},
-{0.081250,0.256250,0.050000,0.050000},
-{0.093750,0.256250,0.025000,0.025000},
-{0.093750,0.256250,0.050000,0.050000},
-{0.106250,0.256250,0.025000,0.025000},
-{0.106250,0.256250,0.050000,0.050000},
-{0.118750,0.256250,0.025000,0.025000},
-{0.118750,0.256250,0.050000,0.050000},
-{0.131250,0.256250,0.025000,0.025000},
-{0.131250,0.256250,0.050000,0.050000},
-{0.143750,0.256250,0.025000,0.025000},
-{0.143750,0.256250,0.050000,0.050000},
-{0.156250,0.256250,0.025000,0.025000},
-{0.156250,0.256250,0.050000,0.050000},
-{0.168750,0.256250,0.025000,0.025000},
-{0.168750,0.256250,0.050000,0.050000},
-{0.181250,0.256250,0.025000,0.025000},
-{0.181250,0.256250,0.050000,0.050000},
-{0.193750,0.256250,0.025000,0.025000},
-{0.193750,0.256250,0.050000,0.050000},
-{0.206250,0.256250,0.025000,0.025000},
-{0.206250,0.256250,0.050000,0.050000},
-{0.218750,0.256250,0.025000,0.025000},
-{0.218750,0.256250,0.050000,0.050000},
-{0.231250,0.256250,0.025000,0.025000},
-{0.231250,0.256250,0.050000,0.050000},
-{0.243750,0.256250,0.025000,0.025000},
-{0.243750,0.256250,0.050000,0.050000},
-{0.256250,0.256250,0.025000,0.025000},
-{0.256250,0.256250,0.050000,0.050000},
-{0.268750,0.256250,0.025000,0.025000},
-{0.268750,0.256250,0.050000,0.050000},
-{0.281250,0.256250,0.025000,0.025000},
-{0.281250,0.256250,0.050000,0.050000},
-{0.293750,0.256250,0.025000,0.025000},
-{0.293750,0.256250,0.050000,0.050000},
-{0.306250,0.256250,0.025000,0.025000},
-{0.306250,0.256250,0.050000,0.050000},
-{0.318750,0.256250,0.025000,0.025000},
-{0.318750,0.256250,0.050000,0.050000},
-{0.331250,0.256250,0.025000,0.025000},
-{0.331250,0.256250,0.050000,0.050000},
-{0.343750,0.256250,0.025000,0.025000},
-{0.343750,0.256250,0.050000,0.050000},
-{0.356250,0.256250,0.025000,0.025000},
-{0.356250,0.256250,0.050000,0.050000},
-{0.368750,0.256250,0.025000,0.025000},
-{0.368750,0.256250,0.050000,0.050000},
-{0.381250,0.256250,0.025000,0.025000},
-{0.381250,0.256250,0.050000,0.050000},
-{0.393750,0.256250,0.025000,0.025000},
-{0.393750,0.256250,0.050000,0.050000},
-{0.406250,0.256250,0.025000,0.025000},
-{0.406250,0.256250,0.050000,0.050000},
-{0.418750,0.256250,0.025000,0.025000},
-{0.418750,0.256250,0.050000,0.050000},
-{0.431250,0.256250,0.025000,0.025000},
-{0.431250,0.256250,0.050000,0.050000},
-{0.443750,0.256250,0.025000,0.025000},
-{0.443750,0.256250,0.050000,0.050000},
-{0.456250,0.256250,0.025000,0.025000},
-{0.456250,0.256250,0.050000,0.050000},
-{0.468750,0.256250,0.025000,0.025000},
-{0.468750,0.256250,0.050000,0.050000},
-{0.481250,0.256250,0.025000,0.025000},
-{0.481250,0.256250,0.050000,0.050000},
-{0.493750,0.256250,0.025000,0.025000},
-{0.493750,0.256250,0.050000,0.050000},
-{0.506250,0.256250,0.025000,0.025000},
-{0.506250,0.256250,0.050000,0.050000},
-{0.518750,0.256250,0.025000,0.025000},
-{0.518750,0.256250,0.050000,0.050000},
-{0.531250,0.256250,0.025000,0.025000},
-{0.531250,0.256250,0.050000,0.050000},
-{0.543750,0.256250,0.025000,0.025000},
-{0.543750,0.256250,0.050000,0.050000},
-{0.556250,0.256250,0.025000,0.025000},
-{0.556250,0.256250,0.050000,0.050000},
-{0.568750,0.256250,0.025000,0.025000},
-{0.568750,0.256250,0.050000,0.050000},
-{0.581250,0.256250,0.025000,0.025000},
-{0.581250,0.256250,0.050000,0.050000},
-{0.593750,0.256250,0.025000,0.025000},
-{0.593750,0.256250,0.050000,0.050000},
-{0.606250,0.256250,0.025000,0.025000},
-{0.606250,0.256250,0.050000,0.050000},
-{0.618750,0.256250,0.025000,0.025000},
-{0.618750,0.256250,0.050000,0.050000},
-{0.631250,0.256250,0.025000,0.025000},
-{0.631250,0.256250,0.050000,0.050000},
-{0.643750,0.256250,0.025000,0.025000},
-{0.643750,0.256250,0.050000,0.050000},
-{0.656250,0.256250,0.025000,0.025000},
-{0.656250,0.256250,0.050000,0.050000},
-{0.668750,0.256250,0.025000,0.025000},
-{0.668750,0.256250,0.050000,0.050000},
-{0.681250,0.256250,0.025000,0.025000},
-{0.681250,0.256250,0.050000,0.050000},
-{0.693750,0.256250,0.025000,0.025000},
-{0.693750,0.256250,0.050000,0.050000},
-{0.706250,0.256250,0.025000,0.025000},
-{0.706250,0.256250,0.050000,0.050000},
-{0.718750,0.256250,0.025000,0.025000},
-{0.718750,0.256250,0.050000,0.050000},
-{0.731250,0.256250,0.025000,0.025000},
-{0.731250,0.256250,0.050000,0.050000},
-{0.743750,0.256250,0.025000,0.025000},
-{0.743750,0.256250,0.050000,0.050000},
-{0.756250,0.256250,0.025000,0.025000},
-{0.756250,0.256250,0.050000,0.050000},
-{0.768750,0.256250,0.025000,0.025000},
-{0.768750,0.256250,0.050000,0.050000},
-{0.781250,0.256250,0.025000,0.025000},
-{0.781250,0.256250,0.050000,0.050000},
-{0.793750,0.256250,0.025000,0.025000},
-{0.793750,0.256250,0.050000,0.050000},
-{0.806250,0.256250,0.025000,0.025000},
-{0.806250,0.256250,0.050000,0.050000},
-{0.818750,0.256250,0.025000,0.025000},
-{0.818750,0.256250,0.050000,0.050000},
-{0.831250,0.256250,0.025000,0.025000},
-{0.831250,0.256250,0.050000,0.050000},
-{0.843750,0.256250,0.025000,0.025000},
-{0.843750,0.256250,0.050000,0.050000},
-{0.856250,0.256250,0.025000,0.025000},
-{0.856250,0.256250,0.050000,0.050000},
-{0.868750,0.256250,0.025000,0.025000},
-{0.868750,0.256250,0.050000,0.050000},
-{0.881250,0.256250,0.025000,0.025000},
-{0.881250,0.256250,0.050000,0.050000},
-{0.893750,0.256250,0.025000,0.025000},
-{0.893750,0.256250,0.050000,0.050000},
-{0.906250,0.256250,0.025000,0.025000},
-{0.906250,0.256250,0.050000,0.050000},
-{0.918750,0.256250,0.025000,0.025000},
-{0.918750,0.256250,0.050000,0.050000},
-{0.931250,0.256250,0.025000,0.025000},
-{0.931250,0.256250,0.050000,0.050000},
-{0.943750,0.256250,0.025000,0.025000},
-{0.943750,0.256250,0.050000,0.050000},
-{0.956250,0.256250,0.025000,0.025000},
-{0.956250,0.256250,0.050000,0.050000},
-{0.968750,0.256250,0.025000,0.025000},
-{0.968750,0.256250,0.050000,0.050000},
-{0.981250,0.256250,0.025000,0.025000},
-{0.981250,0.256250,0.050000,0.050000},
-{0.993750,0.256250,0.025000,0.025000},
-{0.993750,0.256250,0.050000,0.050000},
-{0.006250,0.268750,0.025000,0.025000},
-{0.006250,0.268750,0.050000,0.050000},
-{0.018750,0.268750,0.025000,0.025000},
-{0.018750,0.268750,0.050000,0.050000},
-{0.031250,0.268750,0.025000,0.025000},
-{0.031250,0.268750,0.050000,0.050000},
-{0.043750,0.268750,0.025000,0.025000},
-{0.043750,0.268750,0.050000,0.050000},
-{0.056250,0.268750,0.025000,0.025000},
-{0.056250,0.268750,0.050000,0.050000},
-{0.068750,0.268750,0.025000,0.025000},
-{0.068750,0.268750,0.050000,0.050000},
-{0.081250,0.268750,0.025000,0.025000},
-{0.081250,0.268750,0.050000,0.050000},
-{0.093750,0.268750,0.025000,0.025000},
-{0.093750,0.268750,0.050000,0.050000},
-{0.106250,0.268750,0.025000,0.025000},
-{0.106250,0.268750,0.050000,0.050000},
-{0.118750,0.268750,0.025000,0.025000},
-{0.118750,0.268750,0.050000,0.050000},
-{0.131250,0.268750,0.025000,0.025000},
-{0.131250,0.268750,0.050000,0.050000},
-{0.143750,0.268750,0.025000,0.025000},
-{0.143750,0.268750,0.050000,0.050000},
-{0.156250,0.268750,0.025000,0.025000},
-{0.156250,0.268750,0.050000,0.050000},
-{0.168750,0.268750,0.025000,0.025000},
-{0.168750,0.268750,0.050000,0.050000},
-{0.181250,0.268750,0.025000,0.025000},
-{0.181250,0.268750,0.050000,0.050000},
-{0.193750,0.268750,0.025000,0.025000},
-{0.193750,0.268750,0.050000,0.050000},
-{0.206250,0.268750,0.025000,0.025000},
-{0.206250,0.268750,0.050000,0.050000},
-{0.218750,0.268750,0.025000,0.025000},
-{0.218750,0.268750,0.050000,0.050000},
-{0.231250,0.268750,0.025000,0.025000},
-{0.231250,0.268750,0.050000,0.050000},
-{0.243750,0.268750,0.025000,0.025000},
-{0.243750,0.268750,0.050000,0.050000},
-{0.256250,0.268750,0.025000,0.025000},
-{0.256250,0.268750,0.050000,0.050000},
-{0.268750,0.268750,0.025000,0.025000},
-{0.268750,0.268750,0.050000,0.050000},
-{0.281250,0.268750,0.025000,0.025000},
-{0.281250,0.268750,0.050000,0.050000},
-{0.293750,0.268750,0.025000,0.025000},
-{0.293750,0.268750,0.050000,0.050000},
-{0.306250,0.268750,0.025000,0.025000},
-{0.306250,0.268750,0.050000,0.050000},
-{0.318750,0.268750,0.025000,0.025000},
-{0.318750,0.268750,0.050000,0.050000},
-{0.331250,0.268750,0.025000,0.025000},
-{0.331250,0.268750,0.050000,0.050000},
-{0.343750,0.268750,0.025000,0.025000},
-{0.343750,0.268750,0.050000,0.050000},
-{0.356250,0.268750,0.025000,0.025000},
-{0.356250,0.268750,0.050000,0.050000},
-{0.368750,0.268750,0.025000,0.025000},
-{0.368750,0.268750,0.050000,0.050000},
-{0.381250,0.268750,0.025000,0.025000},
-{0.381250,0.268750,0.050000,0.050000},
-{0.393750,0.268750,0.025000,0.025000},
-{0.393750,0.268750,0.050000,0.050000},
-{0.406250,0.268750,0.025000,0.025000},
-{0.406250,0.268750,0.050000,0.050000},
-{0.418750,0.268750,0.025000,0.025000},
-{0.418750,0.268750,0.050000,0.050000},
-{0.431250,0.268750,0.025000,0.025000},
-{0.431250,0.268750,0.050000,0.050000},
-{0.443750,0.268750,0.025000,0.025000},
-{0.443750,0.268750,0.050000,0.050000},
-{0.456250,0.268750,0.025000,0.025000},
-{0.456250,0.268750,0.050000,0.050000},
-{0.468750,0.268750,0.025000,0.025000},
-{0.468750,0.268750,0.050000,0.050000},
-{0.481250,0.268750,0.025000,0.025000},
-{0.481250,0.268750,0.050000,0.050000},
-{0.493750,0.268750,0.025000,0.025000},
-{0.493750,0.268750,0.050000,0.050000},
-{0.506250,0.268750,0.025000,0.025000},
-{0.506250,0.268750,0.050000,0.050000},
-{0.518750,0.268750,0.025000,0.025000},
-{0.518750,0.268750,0.050000,0.050000},
-{0.531250,0.268750,0.025000,0.025000},
-{0.531250,0.268750,0.050000,0.050000},
-{0.543750,0.268750,0.025000,0.025000},
-{0.543750,0.268750,0.050000,0.050000},
-{0.556250,0.268750,0.025000,0.025000},
-{0.556250,0.268750,0.050000,0.050000},
-{0.568750,0.268750,0.025000,0.025000},
-{0.568750,0.268750,0.050000,0.050000},
-{0.581250,0.268750,0.025000,0.025000},
-{0.581250,0.268750,0.050000,0.050000},
-{0.593750,0.268750,0.025000,0.025000},
-{0.593750,0.268750,0.050000,0.050000},
-{0.606250,0.268750,0.025000,0.025000},
-{0.606250,0.268750,0.050000,0.050000},
-{0.618750,0.268750,0.025000,0.025000},
-{0.618750,0.268750,0.050000,0.050000},
-{0.631250,0.268750,0.025000,0.025000},
-{0.631250,0.268750,0.050000,0.050000},
-{0.643750,0.268750,0.025000,0.025000},
-{0.643750,0.268750,0.050000,0.050000},
-{0.656250,0.268750,0.025000,0.025000},
-{0.656250,0.268750,0.050000,0.050000},
-{0.668750,0.268750,0.025000,0.025000},
-{0.668750,0.268750,0.050000,0.050000},
-{0.681250,0.268750,0.025000,0.025000},
-{0.681250,0.268750,0.050000,0.050000},
-{0.693750,0.268750,0.025000,0.025000},
-{0.693750,0.268750,0.050000,0.050000},
-{0.706250,0.268750,0.025000,0.025000},
-{0.706250,0.268750,0.050000,0.050000},
-{0.718750,0.268750,0.025000,0.025000},
-{0.718750,0.268750,0.050000,0.050000},
-{0.731250,0.268750,0.025000,0.025000},
-{0.731250,0.268750,0.050000,0.050000},
-{0.743750,0.268750,0.025000,0.025000},
-{0.743750,0.268750,0.050000,0.050000},
-{0.756250,0.268750,0.025000,0.025000},
-{0.756250,0.268750,0.050000,0.050000},
-{0.768750,0.268750,0.025000,0.025000},
-{0.768750,0.268750,0.050000,0.050000},
-{0.781250,0.268750,0.025000,0.025000},
-{0.781250,0.268750,0.050000,0.050000},
-{0.793750,0.268750,0.025000,0.025000},
-{0.793750,0.268750,0.050000,0.050000},
-{0.806250,0.268750,0.025000,0.025000},
-{0.806250,0.268750,0.050000,0.050000},
-{0.818750,0.268750,0.025000,0.025000},
-{0.818750,0.268750,0.050000,0.050000},
-{0.831250,0.268750,0.025000,0.025000},
-{0.831250,0.268750,0.050000,0.050000},
-{0.843750,0.268750,0.025000,0.025000},
-{0.843750,0.268750,0.050000,0.050000},
-{0.856250,0.268750,0.025000,0.025000},
-{0.856250,0.268750,0.050000,0.050000},
-{0.868750,0.268750,0.025000,0.025000},
-{0.868750,0.268750,0.050000,0.050000},
-{0.881250,0.268750,0.025000,0.025000},
-{0.881250,0.268750,0.050000,0.050000},
-{0.893750,0.268750,0.025000,0.025000},
-{0.893750,0.268750,0.050000,0.050000},
-{0.906250,0.268750,0.025000,0.025000},
-{0.906250,0.268750,0.050000,0.050000},
-{0.918750,0.268750,0.025000,0.025000},
-{0.918750,0.268750,0.050000,0.050000},
-{0.931250,0.268750,0.025000,0.025000},
-{0.931250,0.268750,0.050000,0.050000},
-{0.943750,0.268750,0.025000,0.025000},
-{0.943750,0.268750,0.050000,0.050000},
-{0.956250,0.268750,0.025000,0.025000},
-{0.956250,0.268750,0.050000,0.050000},
-{0.968750,0.268750,0.025000,0.025000},
-{0.968750,0.268750,0.050000,0.050000},
-{0.981250,0.268750,0.025000,0.025000},
-{0.981250,0.268750,0.050000,0.050000},
-{0.993750,0.268750,0.025000,0.025000},
-{0.993750,0.268750,0.050000,0.050000},
-{0.006250,0.281250,0.025000,0.025000},
-{0.006250,0.281250,0.050000,0.050000},
-{0.018750,0.281250,0.025000,0.025000},
-{0.018750,0.281250,0.050000,0.050000},
-{0.031250,0.281250,0.025000,0.025000},
-{0.031250,0.281250,0.050000,0.050000},
-{0.043750,0.281250,0.025000,0.025000},
-{0.043750,0.281250,0.050000,0.050000},
-{0.056250,0.281250,0.025000,0.025000},
-{0.056250,0.281250,0.050000,0.050000},
-{0.068750,0.281250,0.025000,0.025000},
-{0.068750,0.281250,0.050000,0.050000},
-{0.081250,0.281250,0.025000,0.025000},
-{0.081250,0.281250,0.050000,0.050000},
-{0.093750,0.281250,0.025000,0.025000},
-{0.093750,0.281250,0.050000,0.050000},
-{0.106250,0.281250,0.025000,0.025000},
-{0.106250,0.281250,0.050000,0.050000},
-{0.118750,0.281250,0.025000,0.025000},
-{0.118750,0.281250,0.050000,0.050000},
-{0.131250,0.281250,0.025000,0.025000},
-{0.131250,0.281250,0.050000,0.050000},
-{0.143750,0.281250,0.025000,0.025000},
-{0.143750,0.281250,0.050000,0.050000},
-{0.156250,0.281250,0.025000,0.025000},
-{0.156250,0.281250,0.050000,0.050000},
-{0.168750,0.281250,0.025000,0.025000},
-{0.168750,0.281250,0.050000,0.050000},
-{0.181250,0.281250,0.025000,0.025000},
-{0.181250,0.281250,0.050000,0.050000},
-{0.193750,0.281250,0.025000,0.025000},
-{0.193750,0.281250,0.050000,0.050000},
-{0.206250,0.281250,0.025000,0.025000},
-{0.206250,0.281250,0.050000,0.050000},
-{0.218750,0.281250,0.025000,0.025000},
-{0.218750,0.281250,0.050000,0.050000},
-{0.231250,0.281250,0.025000,0.025000},
-{0.231250,0.281250,0.050000,0.050000},
-{0.243750,0.281250,0.025000,0.025000},
-{0.243750,0.281250,0.050000,0.050000},
-{0.256250,0.281250,0.025000,0.025000},
-{0.256250,0.281250,0.050000,0.050000},
-{0.268750,0.281250,0.025000,0.025000},
-{0.268750,0.281250,0.050000,0.050000},
-{0.281250,0.281250,0.025000,0.025000},
-{0.281250,0.281250,0.050000,0.050000},
-{0.293750,0.281250,0.025000,0.025000},
-{0.293750,0.281250,0.050000,0.050000},
-{0.306250,0.281250,0.025000,0.025000},
-{0.306250,0.281250,0.050000,0.050000},
-{0.318750,0.281250,0.025000,0.025000},
-{0.318750,0.281250,0.050000,0.050000},
-{0.331250,0.281250,0.025000,0.025000},
-{0.331250,0.281250,0.050000,0.050000},
-{0.343750,0.281250,0.025000,0.025000},
-{0.343750,0.281250,0.050000,0.050000},
-{0.356250,0.281250,0.025000,0.025000},
-{0.356250,0.281250,0.050000,0.050000},
-{0.368750,0.281250,0.025000,0.025000},
-{0.368750,0.281250,0.050000,0.050000},
-{0.381250,0.281250,0.025000,0.025000},
-{0.381250,0.281250,0.050000,0.050000},
-{0.393750,0.281250,0.025000,0.025000},
-{0.393750,0.281250,0.050000,0.050000},
-{0.406250,0.281250,0.025000,0.025000},
-{0.406250,0.281250,0.050000,0.050000},
-{0.418750,0.281250,0.025000,0.025000},
-{0.418750,0.281250,0.050000,0.050000},
-{0.431250,0.281250,0.025000,0.025000},
-{0.431250,0.281250,0.050000,0.050000},
-{0.443750,0.281250,0.025000,0.025000},
-{0.443750,0.281250,0.050000,0.050000},
-{0.456250,0.281250,0.025000,0.025000},
-{0.456250,0.281250,0.050000,0.050000},
-{0.468750,0.281250,0.025000,0.025000},
-{0.468750,0.281250,0.050000,0.050000},
-{0.481250,0.281250,0.025000,0.025000},
-{0.481250,0.281250,0.050000,0.050000},
-{0.493750,0.281250,0.025000,0.025000},
-{0.493750,0.281250,0.050000,0.050000},
-{0.506250,0.281250,0.025000,0.025000},
-{0.506250,0.281250,0.050000,0.050000},
-{0.518750,0.281250,0.025000,0.025000},
-{0.518750,0.281250,0.050000,0.050000},
-{0.531250,0.281250,0.025000,0.025000},
-{0.531250,0.281250,0.050000,0.050000},
-{0.543750,0.281250,0.025000,0.025000},
-{0.543750,0.281250,0.050000,0.050000},
-{0.556250,0.281250,0.025000,0.025000},
-{0.556250,0.281250,0.050000,0.050000},
-{0.568750,0.281250,0.025000,0.025000},
-{0.568750,0.281250,0.050000,0.050000},
-{0.581250,0.281250,0.025000,0.025000},
-{0.581250,0.281250,0.050000,0.050000},
-{0.593750,0.281250,0.025000,0.025000},
-{0.593750,0.281250,0.050000,0.050000},
-{0.606250,0.281250,0.025000,0.025000},
-{0.606250,0.281250,0.050000,0.050000},
-{0.618750,0.281250,0.025000,0.025000},
-{0.618750,0.281250,0.050000,0.050000},
-{0.631250,0.281250,0.025000,0.025000},
-{0.631250,0.281250,0.050000,0.050000},
-{0.643750,0.281250,0.025000,0.025000},
-{0.643750,0.281250,0.050000,0.050000},
-{0.656250,0.281250,0.025000,0.025000},
-{0.656250,0.281250,0.050000,0.050000},
-{0.668750,0.281250,0.025000,0.025000},
-{0.668750,0.281250,0.050000,0.050000},
-{0.681250,0.281250,0.025000,0.025000},
-{0.681250,0.281250,0.050000,0.050000},
-{0.693750,0.281250,0.025000,0.025000},
-{0.693750,0.281250,0.050000,0.050000},
-{0.706250,0.281250,0.025000,0.025000},
-{0.706250,0.281250,0.050000,0.050000},
-{0.718750,0.281250,0.025000,0.025000},
-{0.718750,0.281250,0.050000,0.050000},
-{0.731250,0.281250,0.025000,0.025000},
-{0.731250,0.281250,0.050000,0.050000},
-{0.743750,0.281250,0.025000,0.025000},
-{0.743750,0.281250,0.050000,0.050000},
-{0.756250,0.281250,0.025000,0.025000},
-{0.756250,0.281250,0.050000,0.050000},
-{0.768750,0.281250,0.025000,0.025000},
-{0.768750,0.281250,0.050000,0.050000},
-{0.781250,0.281250,0.025000,0.025000},
-{0.781250,0.281250,0.050000,0.050000},
-{0.793750,0.281250,0.025000,0.025000},
-{0.793750,0.281250,0.050000,0.050000},
-{0.806250,0.281250,0.025000,0.025000},
-{0.806250,0.281250,0.050000,0.050000},
-{0.818750,0.281250,0.025000,0.025000},
-{0.818750,0.281250,0.050000,0.050000},
-{0.831250,0.281250,0.025000,0.025000},
-{0.831250,0.281250,0.050000,0.050000},
-{0.843750,0.281250,0.025000,0.025000},
-{0.843750,0.281250,0.050000,0.050000},
-{0.856250,0.281250,0.025000,0.025000},
-{0.856250,0.281250,0.050000,0.050000},
-{0.868750,0.281250,0.025000,0.025000},
-{0.868750,0.281250,0.050000,0.050000},
-{0.881250,0.281250,0.025000,0.025000},
-{0.881250,0.281250,0.050000,0.050000},
-{0.893750,0.281250,0.025000,0.025000},
-{0.893750,0.281250,0.050000,0.050000},
-{0.906250,0.281250,0.025000,0.025000},
-{0.906250,0.281250,0.050000,0.050000},
-{0.918750,0.281250,0.025000,0.025000},
-{0.918750,0.281250,0.050000,0.050000},
-{0.931250,0.281250,0.025000,0.025000},
-{0.931250,0.281250,0.050000,0.050000},
-{0.943750,0.281250,0.025000,0.025000},
-{0.943750,0.281250,0.050000,0.050000},
-{0.956250,0.281250,0.025000,0.025000},
-{0.956250,0.281250,0.050000,0.050000},
-{0.968750,0.281250,0.025000,0.025000},
-{0.968750,0.281250,0.050000,0.050000},
-{0.981250,0.281250,0.025000,0.025000},
-{0.981250,0.281250,0.050000,0.050000},
-{0.993750,0.281250,0.025000,0.025000},
-{0.993750,0.281250,0.050000,0.050000},
-{0.006250,0.293750,0.025000,0.025000},
-{0.006250,0.293750,0.050000,0.050000},
-{0.018750,0.293750,0.025000,0.025000},
-{0.018750,0.293750,0.050000,0.050000},
-{0.031250,0.293750,0.025000,0.025000},
-{0.031250,0.293750,0.050000,0.050000},
-{0.043750,0.293750,0.025000,0.025000},
-{0.043750,0.293750,0.050000,0.050000},
-{0.056250,0.293750,0.025000,0.025000},
-{0.056250,0.293750,0.050000,0.050000},
-{0.068750,0.293750,0.025000,0.025000},
-{0.068750,0.293750,0.050000,0.050000},
-{0.081250,0.293750,0.025000,0.025000},
-{0.081250,0.293750,0.050000,0.050000},
-{0.093750,0.293750,0.025000,0.025000},
-{0.093750,0.293750,0.050000,0.050000},
-{0.106250,0.293750,0.025000,0.025000},
-{0.106250,0.293750,0.050000,0.050000},
-{0.118750,0.293750,0.025000,0.025000},
-{0.118750,0.293750,0.050000,0.050000},
-{0.131250,0.293750,0.025000,0.025000},
-{0.131250,0.293750,0.050000,0.050000},
-{0.143750,0.293750,0.025000,0.025000},
-{0.143750,0.293750,0.050000,0.050000},
-{0.156250,0.293750,0.025000,0.025000},
-{0.156250,0.293750,0.050000,0.050000},
-{0.168750,0.293750,0.025000,0.025000},
-{0.168750,0.293750,0.050000,0.050000},
-{0.181250,0.293750,0.025000,0.025000},
-{0.181250,0.293750,0.050000,0.050000},
-{0.193750,0.293750,0.025000,0.025000},
-{0.193750,0.293750,0.050000,0.050000},
-{0.206250,0.293750,0.025000,0.025000},
-{0.206250,0.293750,0.050000,0.050000},
-{0.218750,0.293750,0.025000,0.025000},
-{0.218750,0.293750,0.050000,0.050000},
-{0.231250,0.293750,0.025000,0.025000},
-{0.231250,0.293750,0.050000,0.050000},
-{0.243750,0.293750,0.025000,0.025000},
-{0.243750,0.293750,0.050000,0.050000},
-{0.256250,0.293750,0.025000,0.025000},
-{0.256250,0.293750,0.050000,0.050000},
-{0.268750,0.293750,0.025000,0.025000},
-{0.268750,0.293750,0.050000,0.050000},
-{0.281250,0.293750,0.025000,0.025000},
-{0.281250,0.293750,0.050000,0.050000},
-{0.293750,0.293750,0.025000,0.025000},
-{0.293750,0.293750,0.050000,0.050000},
-{0.306250,0.293750,0.025000,0.025000},
-{0.306250,0.293750,0.050000,0.050000},
-{0.318750,0.293750,0.025000,0.025000},
-{0.318750,0.293750,0.050000,0.050000},
-{0.331250,0.293750,0.025000,0.025000},
-{0.331250,0.293750,0.050000,0.050000},
-{0.343750,0.293750,0.025000,0.025000},
-{0.343750,0.293750,0.050000,0.050000},
-{0.356250,0.293750,0.025000,0.025000},
-{0.356250,0.293750,0.050000,0.050000},
-{0.368750,0.293750,0.025000,0.025000},
-{0.368750,0.293750,0.050000,0.050000},
-{0.381250,0.293750,0.025000,0.025000},
-{0.381250,0.293750,0.050000,0.050000},
-{0.393750,0.293750,0.025000,0.025000},
-{0.393750,0.293750,0.050000,0.050000},
-{0.406250,0.293750,0.025000,0.025000},
-{0.406250,0.293750,0.050000,0.050000},
-{0.418750,0.293750,0.025000,0.025000},
-{0.418750,0.293750,0.050000,0.050000},
-{0.431250,0.293750,0.025000,0.025000},
-{0.431250,0.293750,0.050000,0.050000},
-{0.443750,0.293750,0.025000,0.025000},
-{0.443750,0.293750,0.050000,0.050000},
-{0.456250,0.293750,0.025000,0.025000},
-{0.456250,0.293750,0.050000,0.050000},
-{0.468750,0.293750,0.025000,0.025000},
-{0.468750,0.293750,0.050000,0.050000},
-{0.481250,0.293750,0.025000,0.025000},
-{0.481250,0.293750,0.050000,0.050000},
-{0.493750,0.293750,0.025000,0.025000},
-{0.493750,0.293750,0.050000,0.050000},
-{0.506250,0.293750,0.025000,0.025000},
-{0.506250,0.293750,0.050000,0.050000},
-{0.518750,0.293750,0.025000,0.025000},
-{0.518750,0.293750,0.050000,0.050000},
-{0.531250,0.293750,0.025000,0.025000},
-{0.531250,0.293750,0.050000,0.050000},
-{0.543750,0.293750,0.025000,0.025000},
-{0.543750,0.293750,0.050000,0.050000},
-{0.556250,0.293750,0.025000,0.025000},
-{0.556250,0.293750,0.050000,0.050000},
-{0.568750,0.293750,0.025000,0.025000},
-{0.568750,0.293750,0.050000,0.050000},
-{0.581250,0.293750,0.025000,0.025000},
-{0.581250,0.293750,0.050000,0.050000},
-{0.593750,0.293750,0.025000,0.025000},
-{0.593750,0.293750,0.050000,0.050000},
-{0.606250,0.293750,0.025000,0.025000},
-{0.606250,0.293750,0.050000,0.050000},
-{0.618750,0.293750,0.025000,0.025000},
-{0.618750,0.293750,0.050000,0.050000},
-{0.631250,0.293750,0.025000,0.025000},
-{0.631250,0.293750,0.050000,0.050000},
-{0.643750,0.293750,0.025000,0.025000},
-{0.643750,0.293750,0.050000,0.050000},
-{0.656250,0.293750,0.025000,0.025000},
-{0.656250,0.293750,0.050000,0.050000},
-{0.668750,0.293750,0.025000,0.025000},
-{0.668750,0.293750,0.050000,0.050000},
-{0.681250,0.293750,0.025000,0.025000},
-{0.681250,0.293750,0.050000,0.050000},
-{0.693750,0.293750,0.025000,0.025000},
-{0.693750,0.293750,0.050000,0.050000},
-{0.706250,0.293750,0.025000,0.025000},
-{0.706250,0.293750,0.050000,0.050000},
-{0.718750,0.293750,0.025000,0.025000},
-{0.718750,0.293750,0.050000,0.050000},
-{0.731250,0.293750,0.025000,0.025000},
-{0.731250,0.293750,0.050000,0.050000},
-{0.743750,0.293750,0.025000,0.025000},
-{0.743750,0.293750,0.050000,0.050000},
-{0.756250,0.293750,0.025000,0.025000},
-{0.756250,0.293750,0.050000,0.050000},
-{0.768750,0.293750,0.025000,0.025000},
-{0.768750,0.293750,0.050000,0.050000},
-{0.781250,0.293750,0.025000,0.025000},
-{0.781250,0.293750,0.050000,0.050000},
-{0.793750,0.293750,0.025000,0.025000},
-{0.793750,0.293750,0.050000,0.050000},
-{0.806250,0.293750,0.025000,0.025000},
-{0.806250,0.293750,0.050000,0.050000},
-{0.818750,0.293750,0.025000,0.025000},
-{0.818750,0.293750,0.050000,0.050000},
-{0.831250,0.293750,0.025000,0.025000},
-{0.831250,0.293750,0.050000,0.050000},
-{0.843750,0.293750,0.025000,0.025000},
-{0.843750,0.293750,0.050000,0.050000},
-{0.856250,0.293750,0.025000,0.025000},
-{0.856250,0.293750,0.050000,0.050000},
-{0.868750,0.293750,0.025000,0.025000},
-{0.868750,0.293750,0.050000,0.050000},
-{0.881250,0.293750,0.025000,0.025000},
-{0.881250,0.293750,0.050000,0.050000},
-{0.893750,0.293750,0.025000,0.025000},
-{0.893750,0.293750,0.050000,0.050000},
-{0.906250,0.293750,0.025000,0.025000},
-{0.906250,0.293750,0.050000,0.050000},
-{0.918750,0.293750,0.025000,0.025000},
-{0.918750,0.293750,0.050000,0.050000},
-{0.931250,0.293750,0.025000,0.025000},
-{0.931250,0.293750,0.050000,0.050000},
-{0.943750,0.293750,0.025000,0.025000},
-{0.943750,0.293750,0.050000,0.050000},
-{0.956250,0.293750,0.025000,0.025000},
-{0.956250,0.293750,0.050000,0.050000},
-{0.968750,0.293750,0.025000,0.025000},
-{0.968750,0.293750,0.050000,0.050000},
-{0.981250,0.293750,0.025000,0.025000},
-{0.981250,0.293750,0.050000,0.050000},
-{0.993750,0.293750,0.025000,0.025000},
-{0.993750,0.293750,0.050000,0.050000},
-{0.006250,0.306250,0.025000,0.025000},
-{0.006250,0.306250,0.050000,0.050000},
-{0.018750,0.306250,0.025000,0.025000},
-{0.018750,0.306250,0.050000,0.050000},
-{0.031250,0.306250,0.025000,0.025000},
-{0.031250,0.306250,0.050000,0.050000},
-{0.043750,0.306250,0.025000,0.025000},
-{0.043750,0.306250,0.050000,0.050000},
-{0.056250,0.306250,0.025000,0.025000},
-{0.056250,0.306250,0.050000,0.050000},
-{0.068750,0.306250,0.025000,0.025000},
-{0.068750,0.306250,0.050000,0.050000},
-{0.081250,0.306250,0.025000,0.025000},
-{0.081250,0.306250,0.050000,0.050000},
-{0.093750,0.306250,0.025000,0.025000},
-{0.093750,0.306250,0.050000,0.050000},
-{0.106250,0.306250,0.025000,0.025000},
-{0.106250,0.306250,0.050000,0.050000},
-{0.118750,0.306250,0.025000,0.025000},
-{0.118750,0.306250,0.050000,0.050000},
-{0.131250,0.306250,0.025000,0.025000},
-{0.131250,0.306250,0.050000,0.050000},
-{0.143750,0.306250,0.025000,0.025000},
-{0.143750,0.306250,0.050000,0.050000},
-{0.156250,0.306250,0.025000,0.025000},
-{0.156250,0.306250,0.050000,0.050000},
-{0.168750,0.306250,0.025000,0.025000},
-{0.168750,0.306250,0.050000,0.050000},
-{0.181250,0.306250,0.025000,0.025000},
-{0.181250,0.306250,0.050000,0.050000},
-{0.193750,0.306250,0.025000,0.025000},
-{0.193750,0.306250,0.050000,0.050000},
-{0.206250,0.306250,0.025000,0.025000},
-{0.206250,0.306250,0.050000,0.050000},
-{0.218750,0.306250,0.025000,0.025000},
-{0.218750,0.306250,0.050000,0.050000},
-{0.231250,0.306250,0.025000,0.025000},
-{0.231250,0.306250,0.050000,0.050000},
-{0.243750,0.306250,0.025000,0.025000},
-{0.243750,0.306250,0.050000,0.050000},
-{0.256250,0.306250,0.025000,0.025000},
-{0.256250,0.306250,0.050000,0.050000},
-{0.268750,0.306250,0.025000,0.025000},
-{0.268750,0.306250,0.050000,0.050000},
-{0.281250,0.306250,0.025000,0.025000},
-{0.281250,0.306250,0.050000,0.050000},
-{0.293750,0.306250,0.025000,0.025000},
-{0.293750,0.306250,0.050000,0.050000},
-{0.306250,0.306250,0.025000,0.025000},
-{0.306250,0.306250,0.050000,0.050000},
-{0.318750,0.306250,0.025000,0.025000},
-{0.318750,0.306250,0.050000,0.050000},
-{0.331250,0.306250,0.025000,0.025000},
-{0.331250,0.306250,0.050000,0.050000},
-{0.343750,0.306250,0.025000,0.025000},
-{0.343750,0.306250,0.050000,0.050000},
-{0.356250,0.306250,0.025000,0.025000},
-{0.356250,0.306250,0.050000,0.050000},
-{0.368750,0.306250,0.025000,0.025000},
-{0.368750,0.306250,0.050000,0.050000},
-{0.381250,0.306250,0.025000,0.025000},
-{0.381250,0.306250,0.050000,0.050000},
-{0.393750,0.306250,0.025000,0.025000},
-{0.393750,0.306250,0.050000,0.050000},
-{0.406250,0.306250,0.025000,0.025000},
-{0.406250,0.306250,0.050000,0.050000},
-{0.418750,0.306250,0.025000,0.025000},
-{0.418750,0.306250,0.050000,0.050000},
-{0.431250,0.306250,0.025000,0.025000},
-{0.431250,0.306250,0.050000,0.050000},
-{0.443750,0.306250,0.025000,0.025000},
-{0.443750,0.306250,0.050000,0.050000},
-{0.456250,0.306250,0.025000,0.025000},
-{0.456250,0.306250,0.050000,0.050000},
-{0.468750,0.306250,0.025000,0.025000},
-{0.468750,0.306250,0.050000,0.050000},
-{0.481250,0.306250,0.025000,0.025000},
-{0.481250,0.306250,0.050000,0.050000},
-{0.493750,0.306250,0.025000,0.025000},
-{0.493750,0.306250,0.050000,0.050000},
-{0.506250,0.306250,0.025000,0.025000},
-{0.506250,0.306250,0.050000,0.050000},
-{0.518750,0.306250,0.025000,0.025000},
-{0.518750,0.306250,0.050000,0.050000},
-{0.531250,0.306250,0.025000,0.025000},
-{0.531250,0.306250,0.050000,0.050000},
-{0.543750,0.306250,0.025000,0.025000},
-{0.543750,0.306250,0.050000,0.050000},
-{0.556250,0.306250,0.025000,0.025000},
-{0.556250,0.306250,0.050000,0.050000},
-{0.568750,0.306250,0.025000,0.025000},
-{0.568750,0.306250,0.050000,0.050000},
-{0.581250,0.306250,0.025000,0.025000},
-{0.581250,0.306250,0.050000,0.050000},
-{0.593750,0.306250,0.025000,0.025000},
-{0.593750,0.306250,0.050000,0.050000},
-{0.606250,0.306250,0.025000,0.025000},
-{0.606250,0.306250,0.050000,0.050000},
-{0.618750,0.306250,0.025000,0.025000},
-{0.618750,0.306250,0.050000,0.050000},
-{0.631250,0.306250,0.025000,0.025000},
-{0.631250,0.306250,0.050000,0.050000},
-{0.643750,0.306250,0.025000,0.025000},
-{0.643750,0.306250,0.050000,0.050000},
-{0.656250,0.306250,0.025000,0.025000},
-{0.656250,0.306250,0.050000,0.050000},
-{0.668750,0.306250,0.025000,0.025000},
-{0.668750,0.306250,0.050000,0.050000},
-{0.681250,0.306250,0.025000,0.025000},
-{0.681250,0.306250,0.050000,0.050000},
-{0.693750,0.306250,0.025000,0.025000},
-{0.693750,0.306250,0.050000,0.050000},
-{0.706250,0.306250,0.025000,0.025000},
-{0.706250,0.306250,0.050000,0.050000},
-{0.718750,0.306250,0.025000,0.025000},
-{0.718750,0.306250,0.050000,0.050000},
-{0.731250,0.306250,0.025000,0.025000},
-{0.731250,0.306250,0.050000,0.050000},
-{0.743750,0.306250,0.025000,0.025000},
-{0.743750,0.306250,0.050000,0.050000},
-{0.756250,0.306250,0.025000,0.025000},
-{0.756250,0.306250,0.050000,0.050000},
-{0.768750,0.306250,0.025000,0.025000},
-{0.768750,0.306250,0.050000,0.050000},
-{0.781250,0.306250,0.025000,0.025000},
-{0.781250,0.306250,0.050000,0.050000},
-{0.793750,0.306250,0.025000,0.025000},
-{0.793750,0.306250,0.050000,0.050000},
-{0.806250,0.306250,0.025000,0.025000},
-{0.806250,0.306250,0.050000,0.050000},
-{0.818750,0.306250,0.025000,0.025000},
-{0.818750,0.306250,0.050000,0.050000},
-{0.831250,0.306250,0.025000,0.025000},
-{0.831250,0.306250,0.050000,0.050000},
-{0.843750,0.306250,0.025000,0.025000},
-{0.843750,0.306250,0.050000,0.050000},
-{0.856250,0.306250,0.025000,0.025000},
-{0.856250,0.306250,0.050000,0.050000},
-{0.868750,0.306250,0.025000,0.025000},
-{0.868750,0.306250,0.050000,0.050000},
-{0.881250,0.306250,0.025000,0.025000},
-{0.881250,0.306250,0.050000,0.050000},
-{0.893750,0.306250,0.025000,0.025000},
-{0.893750,0.306250,0.050000,0.050000},
-{0.906250,0.306250,0.025000,0.025000},
-{0.906250,0.306250,0.050000,0.050000},
-{0.918750,0.306250,0.025000,0.025000},
-{0.918750,0.306250,0.050000,0.050000},
-{0.931250,0.306250,0.025000,0.025000},
-{0.931250,0.306250,0.050000,0.050000},
-{0.943750,0.306250,0.025000,0.025000},
-{0.943750,0.306250,0.050000,0.050000},
-{0.956250,0.306250,0.025000,0.025000},
-{0.956250,0.306250,0.050000,0.050000},
-{0.968750,0.306250,0.025000,0.025000},
-{0.968750,0.306250,0.050000,0.050000},
-{0.981250,0.306250,0.025000,0.025000},
-{0.981250,0.306250,0.050000,0.050000},
-{0.993750,0.306250,0.025000,0.025000},
-{0.993750,0.306250,0.050000,0.050000},
-{0.006250,0.318750,0.025000,0.025000},
-{0.006250,0.318750,0.050000,0.050000},
-{0.018750,0.318750,0.025000,0.025000},
-{0.018750,0.318750,0.050000,0.050000},
-{0.031250,0.318750,0.025000,0.025000},
-{0.031250,0.318750,0.050000,0.050000},
-{0.043750,0.318750,0.025000,0.025000},
-{0.043750,0.318750,0.050000,0.050000},
-{0.056250,0.318750,0.025000,0.025000},
-{0.056250,0.318750,0.050000,0.050000},
-{0.068750,0.318750,0.025000,0.025000},
-{0.068750,0.318750,0.050000,0.050000},
-{0.081250,0.318750,0.025000,0.025000},
-{0.081250,0.318750,0.050000,0.050000},
-{0.093750,0.318750,0.025000,0.025000},
-{0.093750,0.318750,0.050000,0.050000},
-{0.106250,0.318750,0.025000,0.025000},
-{0.106250,0.318750,0.050000,0.050000},
-{0.118750,0.318750,0.025000,0.025000},
-{0.118750,0.318750,0.050000,0.050000},
-{0.131250,0.318750,0.025000,0.025000},
-{0.131250,0.318750,0.050000,0.050000},
-{0.143750,0.318750,0.025000,0.025000},
-{0.143750,0.318750,0.050000,0.050000},
-{0.156250,0.318750,0.025000,0.025000},
-{0.156250,0.318750,0.050000,0.050000},
-{0.168750,0.318750,0.025000,0.025000},
-{0.168750,0.318750,0.050000,0.050000},
-{0.181250,0.318750,0.025000,0.025000},
-{0.181250,0.318750,0.050000,0.050000},
-{0.193750,0.318750,0.025000,0.025000},
-{0.193750,0.318750,0.050000,0.050000},
-{0.206250,0.318750,0.025000,0.025000},
-{0.206250,0.318750,0.050000,0.050000},
-{0.218750,0.318750,0.025000,0.025000},
-{0.218750,0.318750,0.050000,0.050000},
-{0.231250,0.318750,0.025000,0.025000},
-{0.231250,0.318750,0.050000,0.050000},
-{0.243750,0.318750,0.025000,0.025000},
-{0.243750,0.318750,0.050000,0.050000},
-{0.256250,0.318750,0.025000,0.025000},
-{0.256250,0.318750,0.050000,0.050000},
-{0.268750,0.318750,0.025000,0.025000},
-{0.268750,0.318750,0.050000,0.050000},
-{0.281250,0.318750,0.025000,0.025000},
-{0.281250,0.318750,0.050000,0.050000},
-{0.293750,0.318750,0.025000,0.025000},
-{0.293750,0.318750,0.050000,0.050000},
-{0.306250,0.318750,0.025000,0.025000},
-{0.306250,0.318750,0.050000,0.050000},
-{0.318750,0.318750,0.025000,0.025000},
-{0.318750,0.318750,0.050000,0.050000},
-{0.331250,0.318750,0.025000,0.025000},
-{0.331250,0.318750,0.050000,0.050000},
-{0.343750,0.318750,0.025000,0.025000},
-{0.343750,0.318750,0.050000,0.050000},
-{0.356250,0.318750,0.025000,0.025000},
-{0.356250,0.318750,0.050000,0.050000},
-{0.368750,0.318750,0.025000,0.025000},
-{0.368750,0.318750,0.050000,0.050000},
-{0.381250,0.318750,0.025000,0.025000},
-{0.381250,0.318750,0.050000,0.050000},
-{0.393750,0.318750,0.025000,0.025000},
-{0.393750,0.318750,0.050000,0.050000},
-{0.406250,0.318750,0.025000,0.025000},
-{0.406250,0.318750,0.050000,0.050000},
-{0.418750,0.318750,0.025000,0.025000},
-{0.418750,0.318750,0.050000,0.050000},
-{0.431250,0.318750,0.025000,0.025000},
-{0.431250,0.318750,0.050000,0.050000},
-{0.443750,0.318750,0.025000,0.025000},
-{0.443750,0.318750,0.050000,0.050000},
-{0.456250,0.318750,0.025000,0.025000},
-{0.456250,0.318750,0.050000,0.050000},
-{0.468750,0.318750,0.025000,0.025000},
-{0.468750,0.318750,0.050000,0.050000},
-{0.481250,0.318750,0.025000,0.025000},
-{0.481250,0.318750,0.050000,0.050000},
-{0.493750,0.318750,0.025000,0.025000},
-{0.493750,0.318750,0.050000,0.050000},
-{0.506250,0.318750,0.025000,0.025000},
-{0.506250,0.318750,0.050000,0.050000},
-{0.518750,0.318750,0.025000,0.025000},
-{0.518750,0.318750,0.050000,0.050000},
-{0.531250,0.318750,0.025000,0.025000},
-{0.531250,0.318750,0.050000,0.050000},
-{0.543750,0.318750,0.025000,0.025000},
-{0.543750,0.318750,0.050000,0.050000},
-{0.556250,0.318750,0.025000,0.025000},
-{0.556250,0.318750,0.050000,0.050000},
-{0.568750,0.318750,0.025000,0.025000},
-{0.568750,0.318750,0.050000,0.050000},
-{0.581250,0.318750,0.025000,0.025000},
-{0.581250,0.318750,0.050000,0.050000},
-{0.593750,0.318750,0.025000,0.025000},
-{0.593750,0.318750,0.050000,0.050000},
-{0.606250,0.318750,0.025000,0.025000},
-{0.606250,0.318750,0.050000,0.050000},
-{0.618750,0.318750,0.025000,0.025000},
-{0.618750,0.318750,0.050000,0.050000},
-{0.631250,0.318750,0.025000,0.025000},
-{0.631250,0.318750,0.050000,0.050000},
-{0.643750,0.318750,0.025000,0.025000},
-{0.643750,0.318750,0.050000,0.050000},
-{0.656250,0.318750,0.025000,0.025000},
-{0.656250,0.318750,0.050000,0.050000},
-{0.668750,0.318750,0.025000,0.025000},
-{0.668750,0.318750,0.050000,0.050000},
-{0.681250,0.318750,0.025000,0.025000},
-{0.681250,0.318750,0.050000,0.050000},
-{0.693750,0.318750,0.025000,0.025000},
-{0.693750,0.318750,0.050000,0.050000},
-{0.706250,0.318750,0.025000,0.025000},
-{0.706250,0.318750,0.050000,0.050000},
-{0.718750,0.318750,0.025000,0.025000},
-{0.718750,0.318750,0.050000,0.050000},
-{0.731250,0.318750,0.025000,0.025000},
-{0.731250,0.318750,0.050000,0.050000},
-{0.743750,0.318750,0.025000,0.025000},
-{0.743750,0.318750,0.050000,0.050000},
-{0.756250,0.318750,0.025000,0.025000},
-{0.756250,0.318750,0.050000,0.050000},
-{0.768750,0.318750,0.025000,0.025000},
-{0.768750,0.318750,0.050000,0.050000},
-{0.781250,0.318750,0.025000,0.025000},
-{0.781250,0.318750,0.050000,0.050000},
-{0.793750,0.318750,0.025000,0.025000},
-{0.793750,0.318750,0.050000,0.050000},
-{0.806250,0.318750,0.025000,0.025000},
-{0.806250,0.318750,0.050000,0.050000},
-{0.818750,0.318750,0.025000,0.025000},
-{0.818750,0.318750,0.050000,0.050000},
-{0.831250,0.318750,0.025000,0.025000},
-{0.831250,0.318750,0.050000,0.050000},
-{0.843750,0.318750,0.025000,0.025000},
-{0.843750,0.318750,0.050000,0.050000},
-{0.856250,0.318750,0.025000,0.025000},
-{0.856250,0.318750,0.050000,0.050000},
-{0.868750,0.318750,0.025000,0.025000},
-{0.868750,0.318750,0.050000,0.050000},
-{0.881250,0.318750,0.025000,0.025000},
-{0.881250,0.318750,0.050000,0.050000},
-{0.893750,0.318750,0.025000,0.025000},
-{0.893750,0.318750,0.050000,0.050000},
-{0.906250,0.318750,0.025000,0.025000},
-{0.906250,0.318750,0.050000,0.050000},
-{0.918750,0.318750,0.025000,0.025000},
-{0.918750,0.318750,0.050000,0.050000},
-{0.931250,0.318750,0.025000,0.025000},
-{0.931250,0.318750,0.050000,0.050000},
-{0.943750,0.318750,0.025000,0.025000},
-{0.943750,0.318750,0.050000,0.050000},
-{0.956250,0.318750,0.025000,0.025000},
-{0.956250,0.318750,0.050000,0.050000},
-{0.968750,0.318750,0.025000,0.025000},
-{0.968750,0.318750,0.050000,0.050000},
-{0.981250,0.318750,0.025000,0.025000},
-{0.981250,0.318750,0.050000,0.050000},
-{0.993750,0.318750,0.025000,0.025000},
-{0.993750,0.318750,0.050000,0.050000},
-{0.006250,0.331250,0.025000,0.025000},
-{0.006250,0.331250,0.050000,0.050000},
-{0.018750,0.331250,0.025000,0.025000},
-{0.018750,0.331250,0.050000,0.050000},
-{0.031250,0.331250,0.025000,0.025000},
-{0.031250,0.331250,0.050000,0.050000},
-{0.043750,0.331250,0.025000,0.025000},
-{0.043750,0.331250,0.050000,0.050000},
-{0.056250,0.331250,0.025000,0.025000},
-{0.056250,0.331250,0.050000,0.050000},
-{0.068750,0.331250,0.025000,0.025000},
-{0.068750,0.331250,0.050000,0.050000},
-{0.081250,0.331250,0.025000,0.025000},
-{0.081250,0.331250,0.050000,0.050000},
-{0.093750,0.331250,0.025000,0.025000},
-{0.093750,0.331250,0.050000,0.050000},
-{0.106250,0.331250,0.025000,0.025000},
-{0.106250,0.331250,0.050000,0.050000},
-{0.118750,0.331250,0.025000,0.025000},
-{0.118750,0.331250,0.050000,0.050000},
-{0.131250,0.331250,0.025000,0.025000},
-{0.131250,0.331250,0.050000,0.050000},
-{0.143750,0.331250,0.025000,0.025000},
-{0.143750,0.331250,0.050000,0.050000},
-{0.156250,0.331250,0.025000,0.025000},
-{0.156250,0.331250,0.050000,0.050000},
-{0.168750,0.331250,0.025000,0.025000},
-{0.168750,0.331250,0.050000,0.050000},
-{0.181250,0.331250,0.025000,0.025000},
-{0.181250,0.331250,0.050000,0.050000},
-{0.193750,0.331250,0.025000,0.025000},
-{0.193750,0.331250,0.050000,0.050000},
-{0.206250,0.331250,0.025000,0.025000},
-{0.206250,0.331250,0.050000,0.050000},
-{0.218750,0.331250,0.025000,0.025000},
-{0.218750,0.331250,0.050000,0.050000},
-{0.231250,0.331250,0.025000,0.025000},
-{0.231250,0.331250,0.050000,0.050000},
-{0.243750,0.331250,0.025000,0.025000},
-{0.243750,0.331250,0.050000,0.050000},
-{0.256250,0.331250,0.025000,0.025000},
-{0.256250,0.331250,0.050000,0.050000},
-{0.268750,0.331250,0.025000,0.025000},
-{0.268750,0.331250,0.050000,0.050000},
-{0.281250,0.331250,0.025000,0.025000},
-{0.281250,0.331250,0.050000,0.050000},
-{0.293750,0.331250,0.025000,0.025000},
-{0.293750,0.331250,0.050000,0.050000},
-{0.306250,0.331250,0.025000,0.025000},
-{0.306250,0.331250,0.050000,0.050000},
-{0.318750,0.331250,0.025000,0.025000},
-{0.318750,0.331250,0.050000,0.050000},
-{0.331250,0.331250,0.025000,0.025000},
-{0.331250,0.331250,0.050000,0.050000},
-{0.343750,0.331250,0.025000,0.025000},
-{0.343750,0.331250,0.050000,0.050000},
-{0.356250,0.331250,0.025000,0.025000},
-{0.356250,0.331250,0.050000,0.050000},
-{0.368750,0.331250,0.025000,0.025000},
-{0.368750,0.331250,0.050000,0.050000},
-{0.381250,0.331250,0.025000,0.025000},
-{0.381250,0.331250,0.050000,0.050000},
-{0.393750,0.331250,0.025000,0.025000},
-{0.393750,0.331250,0.050000,0.050000},
-{0.406250,0.331250,0.025000,0.025000},
-{0.406250,0.331250,0.050000,0.050000},
-{0.418750,0.331250,0.025000,0.025000},
-{0.418750,0.331250,0.050000,0.050000},
-{0.431250,0.331250,0.025000,0.025000},
-{0.431250,0.331250,0.050000,0.050000},
-{0.443750,0.331250,0.025000,0.025000},
-{0.443750,0.331250,0.050000,0.050000},
-{0.456250,0.331250,0.025000,0.025000},
-{0.456250,0.331250,0.050000,0.050000},
-{0.468750,0.331250,0.025000,0.025000},
-{0.468750,0.331250,0.050000,0.050000},
-{0.481250,0.331250,0.025000,0.025000},
-{0.481250,0.331250,0.050000,0.050000},
-{0.493750,0.331250,0.025000,0.025000},
-{0.493750,0.331250,0.050000,0.050000},
-{0.506250,0.331250,0.025000,0.025000},
-{0.506250,0.331250,0.050000,0.050000},
-{0.518750,0.331250,0.025000,0.025000},
-{0.518750,0.331250,0.050000,0.050000},
-{0.531250,0.331250,0.025000,0.025000},
-{0.531250,0.331250,0.050000,0.050000},
-{0.543750,0.331250,0.025000,0.025000},
-{0.543750,0.331250,0.050000,0.050000},
-{0.556250,0.331250,0.025000,0.025000},
-{0.556250,0.331250,0.050000,0.050000},
-{0.568750,0.331250,0.025000,0.025000},
-{0.568750,0.331250,0.050000,0.050000},
-{0.581250,0.331250,0.025000,0.025000},
-{0.581250,0.331250,0.050000,0.050000},
-{0.593750,0.331250,0.025000,0.025000},
-{0.593750,0.331250,0.050000,0.050000},
-{0.606250,0.331250,0.025000,0.025000},
-{0.606250,0.331250,0.050000,0.050000},
-{0.618750,0.331250,0.025000,0.025000},
-{0.618750,0.331250,0.050000,0.050000},
-{0.631250,0.331250,0.025000,0.025000},
-{0.631250,0.331250,0.050000,0.050000},
-{0.643750,0.331250,0.025000,0.025000},
-{0.643750,0.331250,0.050000,0.050000},
-{0.656250,0.331250,0.025000,0.025000},
-{0.656250,0.331250,0.050000,0.050000},
-{0.668750,0.331250,0.025000,0.025000},
-{0.668750,0.331250,0.050000,0.050000},
-{0.681250,0.331250,0.025000,0.025000},
-{0.681250,0.331250,0.050000,0.050000},
-{0.693750,0.331250,0.025000,0.025000},
-{0.693750,0.331250,0.050000,0.050000},
-{0.706250,0.331250,0.025000,0.025000},
-{0.706250,0.331250,0.050000,0.050000},
-{0.718750,0.331250,0.025000,0.025000},
-{0.718750,0.331250,0.050000,0.050000},
-{0.731250,0.331250,0.025000,0.025000},
-{0.731250,0.331250,0.050000,0.050000},
-{0.743750,0.331250,0.025000,0.025000},
-{0.743750,0.331250,0.050000,0.050000},
-{0.756250,0.331250,0.025000,0.025000},
-{0.756250,0.331250,0.050000,0.050000},
-{0.768750,0.331250,0.025000,0.025000},
-{0.768750,0.331250,0.050000,0.050000},
-{0.781250,0.331250,0.025000,0.025000},
-{0.781250,0.331250,0.050000,0.050000},
-{0.793750,0.331250,0.025000,0.025000},
-{0.793750,0.331250,0.050000,0.050000},
-{0.806250,0.331250,0.025000,0.025000},
-{0.806250,0.331250,0.050000,0.050000},
-{0.818750,0.331250,0.025000,0.025000},
-{0.818750,0.331250,0.050000,0.050000},
-{0.831250,0.331250,0.025000,0.025000},
-{0.831250,0.331250,0.050000,0.050000},
-{0.843750,0.331250,0.025000,0.025000},
-{0.843750,0.331250,0.050000,0.050000},
-{0.856250,0.331250,0.025000,0.025000},
-{0.856250,0.331250,0.050000,0.050000},
-{0.868750,0.331250,0.025000,0.025000},
-{0.868750,0.331250,0.050000,0.050000},
-{0.881250,0.331250,0.025000,0.025000},
-{0.881250,0.331250,0.050000,0.050000},
-{0.893750,0.331250,0.025000,0.025000},
-{0.893750,0.331250,0.050000,0.050000},
-{0.906250,0.331250,0.025000,0.025000},
-{0.906250,0.331250,0.050000,0.050000},
-{0.918750,0.331250,0.025000,0.025000},
-{0.918750,0.331250,0.050000,0.050000},
-{0.931250,0.331250,0.025000,0.025000},
-{0.931250,0.331250,0.050000,0.050000},
-{0.943750,0.331250,0.025000,0.025000},
-{0.943750,0.331250,0.050000,0.050000},
-{0.956250,0.331250,0.025000,0.025000},
-{0.956250,0.331250,0.050000,0.050000},
-{0.968750,0.331250,0.025000,0.025000},
-{0.968750,0.331250,0.050000,0.050000},
-{0.981250,0.331250,0.025000,0.025000},
-{0.981250,0.331250,0.050000,0.050000},
-{0.993750,0.331250,0.025000,0.025000},
-{0.993750,0.331250,0.050000,0.050000},
-{0.006250,0.343750,0.025000,0.025000},
-{0.006250,0.343750,0.050000,0.050000},
-{0.018750,0.343750,0.025000,0.025000},
-{0.018750,0.343750,0.050000,0.050000},
-{0.031250,0.343750,0.025000,0.025000},
-{0.031250,0.343750,0.050000,0.050000},
-{0.043750,0.343750,0.025000,0.025000},
-{0.043750,0.343750,0.050000,0.050000},
-{0.056250,0.343750,0.025000,0.025000},
-{0.056250,0.343750,0.050000,0.050000},
-{0.068750,0.343750,0.025000,0.025000},
-{0.068750,0.343750,0.050000,0.050000},
-{0.081250,0.343750,0.025000,0.025000},
-{0.081250,0.343750,0.050000,0.050000},
-{0.093750,0.343750,0.025000,0.025000},
-{0.093750,0.343750,0.050000,0.050000},
-{0.106250,0.343750,0.025000,0.025000},
-{0.106250,0.343750,0.050000,0.050000},
-{0.118750,0.343750,0.025000,0.025000},
-{0.118750,0.343750,0.050000,0.050000},
-{0.131250,0.343750,0.025000,0.025000},
-{0.131250,0.343750,0.050000,0.050000},
-{0.143750,0.343750,0.025000,0.025000},
-{0.143750,0.343750,0.050000,0.050000},
-{0.156250,0.343750,0.025000,0.025000},
-{0.156250,0.343750,0.050000,0.050000},
-{0.168750,0.343750,0.025000,0.025000},
-{0.168750,0.343750,0.050000,0.050000},
-{0.181250,0.343750,0.025000,0.025000},
-{0.181250,0.343750,0.050000,0.050000},
-{0.193750,0.343750,0.025000,0.025000},
-{0.193750,0.343750,0.050000,0.050000},
-{0.206250,0.343750,0.025000,0.025000},
-{0.206250,0.343750,0.050000,0.050000},
-{0.218750,0.343750,0.025000,0.025000},
-{0.218750,0.343750,0.050000,0.050000},
-{0.231250,0.343750,0.025000,0.025000},
-{0.231250,0.343750,0.050000,0.050000},
-{0.243750,0.343750,0.025000,0.025000},
-{0.243750,0.343750,0.050000,0.050000},
-{0.256250,0.343750,0.025000,0.025000},
-{0.256250,0.343750,0.050000,0.050000},
-{0.268750,0.343750,0.025000,0.025000},
-{0.268750,0.343750,0.050000,0.050000},
-{0.281250,0.343750,0.025000,0.025000},
-{0.281250,0.343750,0.050000,0.050000},
-{0.293750,0.343750,0.025000,0.025000},
-{0.293750,0.343750,0.050000,0.050000},
-{0.306250,0.343750,0.025000,0.025000},
-{0.306250,0.343750,0.050000,0.050000},
-{0.318750,0.343750,0.025000,0.025000},
-{0.318750,0.343750,0.050000,0.050000},
-{0.331250,0.343750,0.025000,0.025000},
-{0.331250,0.343750,0.050000,0.050000},
-{0.343750,0.343750,0.025000,0.025000},
-{0.343750,0.343750,0.050000,0.050000},
-{0.356250,0.343750,0.025000,0.025000},
-{0.356250,0.343750,0.050000,0.050000},
-{0.368750,0.343750,0.025000,0.025000},
-{0.368750,0.343750,0.050000,0.050000},
-{0.381250,0.343750,0.025000,0.025000},
-{0.381250,0.343750,0.050000,0.050000},
-{0.393750,0.343750,0.025000,0.025000},
-{0.393750,0.343750,0.050000,0.050000},
-{0.406250,0.343750,0.025000,0.025000},
-{0.406250,0.343750,0.050000,0.050000},
-{0.418750,0.343750,0.025000,0.025000},
-{0.418750,0.343750,0.050000,0.050000},
-{0.431250,0.343750,0.025000,0.025000},
-{0.431250,0.343750,0.050000,0.050000},
-{0.443750,0.343750,0.025000,0.025000},
-{0.443750,0.343750,0.050000,0.050000},
-{0.456250,0.343750,0.025000,0.025000},
-{0.456250,0.343750,0.050000,0.050000},
-{0.468750,0.343750,0.025000,0.025000},
-{0.468750,0.343750,0.050000,0.050000},
-{0.481250,0.343750,0.025000,0.025000},
-{0.481250,0.343750,0.050000,0.050000},
-{0.493750,0.343750,0.025000,0.025000},
-{0.493750,0.343750,0.050000,0.050000},
-{0.506250,0.343750,0.025000,0.025000},
-{0.506250,0.343750,0.050000,0.050000},
-{0.518750,0.343750,0.025000,0.025000},
-{0.518750,0.343750,0.050000,0.050000},
-{0.531250,0.343750,0.025000,0.025000},
-{0.531250,0.343750,0.050000,0.050000},
-{0.543750,0.343750,0.025000,0.025000},
-{0.543750,0.343750,0.050000,0.050000},
-{0.556250,0.343750,0.025000,0.025000},
-{0.556250,0.343750,0.050000,0.050000},
-{0.568750,0.343750,0.025000,0.025000},
-{0.568750,0.343750,0.050000,0.050000},
-{0.581250,0.343750,0.025000,0.025000},
-{0.581250,0.343750,0.050000,0.050000},
-{0.593750,0.343750,0.025000,0.025000},
-{0.593750,0.343750,0.050000,0.050000},
-{0.606250,0.343750,0.025000,0.025000},
-{0.606250,0.343750,0.050000,0.050000},
-{0.618750,0.343750,0.025000,0.025000},
-{0.618750,0.343750,0.050000,0.050000},
-{0.631250,0.343750,0.025000,0.025000},
-{0.631250,0.343750,0.050000,0.050000},
-{0.643750,0.343750,0.025000,0.025000},
-{0.643750,0.343750,0.050000,0.050000},
-{0.656250,0.343750,0.025000,0.025000},
-{0.656250,0.343750,0.050000,0.050000},
-{0.668750,0.343750,0.025000,0.025000},
-{0.668750,0.343750,0.050000,0.050000},
-{0.681250,0.343750,0.025000,0.025000},
-{0.681250,0.343750,0.050000,0.050000},
-{0.693750,0.343750,0.025000,0.025000},
-{0.693750,0.343750,0.050000,0.050000},
-{0.706250,0.343750,0.025000,0.025000},
-{0.706250,0.343750,0.050000,0.050000},
-{0.718750,0.343750,0.025000,0.025000},
-{0.718750,0.343750,0.050000,0.050000},
-{0.731250,0.343750,0.025000,0.025000},
-{0.731250,0.343750,0.050000,0.050000},
-{0.743750,0.343750,0.025000,0.025000},
-{0.743750,0.343750,0.050000,0.050000},
-{0.756250,0.343750,0.025000,0.025000},
-{0.756250,0.343750,0.050000,0.050000},
-{0.768750,0.343750,0.025000,0.025000},
-{0.768750,0.343750,0.050000,0.050000},
-{0.781250,0.343750,0.025000,0.025000},
-{0.781250,0.343750,0.050000,0.050000},
-{0.793750,0.343750,0.025000,0.025000},
-{0.793750,0.343750,0.050000,0.050000},
-{0.806250,0.343750,0.025000,0.025000},
-{0.806250,0.343750,0.050000,0.050000},
-{0.818750,0.343750,0.025000,0.025000},
-{0.818750,0.343750,0.050000,0.050000},
-{0.831250,0.343750,0.025000,0.025000},
-{0.831250,0.343750,0.050000,0.050000},
-{0.843750,0.343750,0.025000,0.025000},
-{0.843750,0.343750,0.050000,0.050000},
-{0.856250,0.343750,0.025000,0.025000},
-{0.856250,0.343750,0.050000,0.050000},
-{0.868750,0.343750,0.025000,0.025000},
-{0.868750,0.343750,0.050000,0.050000},
-{0.881250,0.343750,0.025000,0.025000},
-{0.881250,0.343750,0.050000,0.050000},
-{0.893750,0.343750,0.025000,0.025000},
-{0.893750,0.343750,0.050000,0.050000},
-{0.906250,0.343750,0.025000,0.025000},
-{0.906250,0.343750,0.050000,0.050000},
-{0.918750,0.343750,0.025000,0.025000},
-{0.918750,0.343750,0.050000,0.050000},
-{0.931250,0.343750,0.025000,0.025000},
-{0.931250,0.343750,0.050000,0.050000},
-{0.943750,0.343750,0.025000,0.025000},
-{0.943750,0.343750,0.050000,0.050000},
-{0.956250,0.343750,0.025000,0.025000},
-{0.956250,0.343750,0.050000,0.050000},
-{0.968750,0.343750,0.025000,0.025000},
-{0.968750,0.343750,0.050000,0.050000},
-{0.981250,0.343750,0.025000,0.025000},
-{0.981250,0.343750,0.050000,0.050000},
-{0.993750,0.343750,0.025000,0.025000},
-{0.993750,0.343750,0.050000,0.050000},
-{0.006250,0.356250,0.025000,0.025000},
-{0.006250,0.356250,0.050000,0.050000},
-{0.018750,0.356250,0.025000,0.025000},
-{0.018750,0.356250,0.050000,0.050000},
-{0.031250,0.356250,0.025000,0.025000},
-{0.031250,0.356250,0.050000,0.050000},
-{0.043750,0.356250,0.025000,0.025000},
-{0.043750,0.356250,0.050000,0.050000},
-{0.056250,0.356250,0.025000,0.025000},
-{0.056250,0.356250,0.050000,0.050000},
-{0.068750,0.356250,0.025000,0.025000},
-{0.068750,0.356250,0.050000,0.050000},
-{0.081250,0.356250,0.025000,0.025000},
-{0.081250,0.356250,0.050000,0.050000},
-{0.093750,0.356250,0.025000,0.025000},
-{0.093750,0.356250,0.050000,0.050000},
-{0.106250,0.356250,0.025000,0.025000},
-{0.106250,0.356250,0.050000,0.050000},
-{0.118750,0.356250,0.025000,0.025000},
-{0.118750,0.356250,0.050000,0.050000},
-{0.131250,0.356250,0.025000,0.025000},
-{0.131250,0.356250,0.050000,0.050000},
-{0.143750,0.356250,0.025000,0.025000},
-{0.143750,0.356250,0.050000,0.050000},
-{0.156250,0.356250,0.025000,0.025000},
-{0.156250,0.356250,0.050000,0.050000},
-{0.168750,0.356250,0.025000,0.025000},
-{0.168750,0.356250,0.050000,0.050000},
-{0.181250,0.356250,0.025000,0.025000},
-{0.181250,0.356250,0.050000,0.050000},
-{0.193750,0.356250,0.025000,0.025000},
-{0.193750,0.356250,0.050000,0.050000},
-{0.206250,0.356250,0.025000,0.025000},
-{0.206250,0.356250,0.050000,0.050000},
-{0.218750,0.356250,0.025000,0.025000},
-{0.218750,0.356250,0.050000,0.050000},
-{0.231250,0.356250,0.025000,0.025000},
-{0.231250,0.356250,0.050000,0.050000},
-{0.243750,0.356250,0.025000,0.025000},
-{0.243750,0.356250,0.050000,0.050000},
-{0.256250,0.356250,0.025000,0.025000},
-{0.256250,0.356250,0.050000,0.050000},
-{0.268750,0.356250,0.025000,0.025000},
-{0.268750,0.356250,0.050000,0.050000},
-{0.281250,0.356250,0.025000,0.025000},
-{0.281250,0.356250,0.050000,0.050000},
-{0.293750,0.356250,0.025000,0.025000},
-{0.293750,0.356250,0.050000,0.050000},
-{0.306250,0.356250,0.025000,0.025000},
-{0.306250,0.356250,0.050000,0.050000},
-{0.318750,0.356250,0.025000,0.025000},
-{0.318750,0.356250,0.050000,0.050000},
-{0.331250,0.356250,0.025000,0.025000},
-{0.331250,0.356250,0.050000,0.050000},
-{0.343750,0.356250,0.025000,0.025000},
-{0.343750,0.356250,0.050000,0.050000},
-{0.356250,0.356250,0.025000,0.025000},
-{0.356250,0.356250,0.050000,0.050000},
-{0.368750,0.356250,0.025000,0.025000},
-{0.368750,0.356250,0.050000,0.050000},
-{0.381250,0.356250,0.025000,0.025000},
-{0.381250,0.356250,0.050000,0.050000},
-{0.393750,0.356250,0.025000,0.025000},
-{0.393750,0.356250,0.050000,0.050000},
-{0.406250,0.356250,0.025000,0.025000},
-{0.406250,0.356250,0.050000,0.050000},
-{0.418750,0.356250,0.025000,0.025000},
-{0.418750,0.356250,0.050000,0.050000},
-{0.431250,0.356250,0.025000,0.025000},
-{0.431250,0.356250,0.050000,0.050000},
-{0.443750,0.356250,0.025000,0.025000},
-{0.443750,0.356250,0.050000,0.050000},
-{0.456250,0.356250,0.025000,0.025000},
-{0.456250,0.356250,0.050000,0.050000},
-{0.468750,0.356250,0.025000,0.025000},
-{0.468750,0.356250,0.050000,0.050000},
-{0.481250,0.356250,0.025000,0.025000},
-{0.481250,0.356250,0.050000,0.050000},
-{0.493750,0.356250,0.025000,0.025000},
-{0.493750,0.356250,0.050000,0.050000},
-{0.506250,0.356250,0.025000,0.025000},
-{0.506250,0.356250,0.050000,0.050000},
-{0.518750,0.356250,0.025000,0.025000},
-{0.518750,0.356250,0.050000,0.050000},
-{0.531250,0.356250,0.025000,0.025000},
-{0.531250,0.356250,0.050000,0.050000},
-{0.543750,0.356250,0.025000,0.025000},
-{0.543750,0.356250,0.050000,0.050000},
-{0.556250,0.356250,0.025000,0.025000},
-{0.556250,0.356250,0.050000,0.050000},
-{0.568750,0.356250,0.025000,0.025000},
-{0.568750,0.356250,0.050000,0.050000},
-{0.581250,0.356250,0.025000,0.025000},
-{0.581250,0.356250,0.050000,0.050000},
-{0.593750,0.356250,0.025000,0.025000},
-{0.593750,0.356250,0.050000,0.050000},
-{0.606250,0.356250,0.025000,0.025000},
-{0.606250,0.356250,0.050000,0.050000},
-{0.618750,0.356250,0.025000,0.025000},
-{0.618750,0.356250,0.050000,0.050000},
-{0.631250,0.356250,0.025000,0.025000},
-{0.631250,0.356250,0.050000,0.050000},
-{0.643750,0.356250,0.025000,0.025000},
-{0.643750,0.356250,0.050000,0.050000},
-{0.656250,0.356250,0.025000,0.025000},
-{0.656250,0.356250,0.050000,0.050000},
-{0.668750,0.356250,0.025000,0.025000},
-{0.668750,0.356250,0.050000,0.050000},
-{0.681250,0.356250,0.025000,0.025000},
-{0.681250,0.356250,0.050000,0.050000},
-{0.693750,0.356250,0.025000,0.025000},
-{0.693750,0.356250,0.050000,0.050000},
-{0.706250,0.356250,0.025000,0.025000},
-{0.706250,0.356250,0.050000,0.050000},
-{0.718750,0.356250,0.025000,0.025000},
-{0.718750,0.356250,0.050000,0.050000},
-{0.731250,0.356250,0.025000,0.025000},
-{0.731250,0.356250,0.050000,0.050000},
-{0.743750,0.356250,0.025000,0.025000},
-{0.743750,0.356250,0.050000,0.050000},
-{0.756250,0.356250,0.025000,0.025000},
-{0.756250,0.356250,0.050000,0.050000},
-{0.768750,0.356250,0.025000,0.025000},
-{0.768750,0.356250,0.050000,0.050000},
-{0.781250,0.356250,0.025000,0.025000},
-{0.781250,0.356250,0.050000,0.050000},
-{0.793750,0.356250,0.025000,0.025000},
-{0.793750,0.356250,0.050000,0.050000},
-{0.806250,0.356250,0.025000,0.025000},
-{0.806250,0.356250,0.050000,0.050000},
-{0.818750,0.356250,0.025000,0.025000},
-{0.818750,0.356250,0.050000,0.050000},
-{0.831250,0.356250,0.025000,0.025000},
-{0.831250,0.356250,0.050000,0.050000},
-{0.843750,0.356250,0.025000,0.025000},
-{0.843750,0.356250,0.050000,0.050000},
-{0.856250,0.356250,0.025000,0.025000},
-{0.856250,0.356250,0.050000,0.050000},
-{0.868750,0.356250,0.025000,0.025000},
-{0.868750,0.356250,0.050000,0.050000},
-{0.881250,0.356250,0.025000,0.025000},
-{0.881250,0.356250,0.050000,0.050000},
-{0.893750,0.356250,0.025000,0.025000},
-{0.893750,0.356250,0.050000,0.050000},
-{0.906250,0.356250,0.025000,0.025000},
-{0.906250,0.356250,0.050000,0.050000},
-{0.918750,0.356250,0.025000,0.025000},
-{0.918750,0.356250,0.050000,0.050000},
-{0.931250,0.356250,0.025000,0.025000},
-{0.931250,0.356250,0.050000,0.050000},
-{0.943750,0.356250,0.025000,0.025000},
-{0.943750,0.356250,0.050000,0.050000},
-{0.956250,0.356250,0.025000,0.025000},
-{0.956250,0.356250,0.050000,0.050000},
-{0.968750,0.356250,0.025000,0.025000},
-{0.968750,0.356250,0.050000,0.050000},
-{0.981250,0.356250,0.025000,0.025000},
-{0.981250,0.356250,0.050000,0.050000},
-{0.993750,0.356250,0.025000,0.025000},
-{0.993750,0.356250,0.050000,0.050000},
-{0.006250,0.368750,0.025000,0.025000},
-{0.006250,0.368750,0.050000,0.050000},
-{0.018750,0.368750,0.025000,0.025000},
-{0.018750,0.368750,0.050000,0.050000},
-{0.031250,0.368750,0.025000,0.025000},
-{0.031250,0.368750,0.050000,0.050000},
-{0.043750,0.368750,0.025000,0.025000},
-{0.043750,0.368750,0.050000,0.050000},
-{0.056250,0.368750,0.025000,0.025000},
-{0.056250,0.368750,0.050000,0.050000},
-{0.068750,0.368750,0.025000,0.025000},
-{0.068750,0.368750,0.050000,0.050000},
-{0.081250,0.368750,0.025000,0.025000},
-{0.081250,0.368750,0.050000,0.050000},
-{0.093750,0.368750,0.025000,0.025000},
-{0.093750,0.368750,0.050000,0.050000},
-{0.106250,0.368750,0.025000,0.025000},
-{0.106250,0.368750,0.050000,0.050000},
-{0.118750,0.368750,0.025000,0.025000},
-{0.118750,0.368750,0.050000,0.050000},
-{0.131250,0.368750,0.025000,0.025000},
-{0.131250,0.368750,0.050000,0.050000},
-{0.143750,0.368750,0.025000,0.025000},
-{0.143750,0.368750,0.050000,0.050000},
-{0.156250,0.368750,0.025000,0.025000},
-{0.156250,0.368750,0.050000,0.050000},
-{0.168750,0.368750,0.025000,0.025000},
-{0.168750,0.368750,0.050000,0.050000},
-{0.181250,0.368750,0.025000,0.025000},
-{0.181250,0.368750,0.050000,0.050000},
-{0.193750,0.368750,0.025000,0.025000},
-{0.193750,0.368750,0.050000,0.050000},
-{0.206250,0.368750,0.025000,0.025000},
-{0.206250,0.368750,0.050000,0.050000},
-{0.218750,0.368750,0.025000,0.025000},
-{0.218750,0.368750,0.050000,0.050000},
-{0.231250,0.368750,0.025000,0.025000},
-{0.231250,0.368750,0.050000,0.050000},
-{0.243750,0.368750,0.025000,0.025000},
-{0.243750,0.368750,0.050000,0.050000},
-{0.256250,0.368750,0.025000,0.025000},
-{0.256250,0.368750,0.050000,0.050000},
-{0.268750,0.368750,0.025000,0.025000},
-{0.268750,0.368750,0.050000,0.050000},
-{0.281250,0.368750,0.025000,0.025000},
-{0.281250,0.368750,0.050000,0.050000},
-{0.293750,0.368750,0.025000,0.025000},
-{0.293750,0.368750,0.050000,0.050000},
-{0.306250,0.368750,0.025000,0.025000},
-{0.306250,0.368750,0.050000,0.050000},
-{0.318750,0.368750,0.025000,0.025000},
-{0.318750,0.368750,0.050000,0.050000},
-{0.331250,0.368750,0.025000,0.025000},
-{0.331250,0.368750,0.050000,0.050000},
-{0.343750,0.368750,0.025000,0.025000},
-{0.343750,0.368750,0.050000,0.050000},
-{0.356250,0.368750,0.025000,0.025000},
-{0.356250,0.368750,0.050000,0.050000},
-{0.368750,0.368750,0.025000,0.025000},
-{0.368750,0.368750,0.050000,0.050000},
-{0.381250,0.368750,0.025000,0.025000},
-{0.381250,0.368750,0.050000,0.050000},
-{0.393750,0.368750,0.025000,0.025000},
-{0.393750,0.368750,0.050000,0.050000},
-{0.406250,0.368750,0.025000,0.025000},
-{0.406250,0.368750,0.050000,0.050000},
-{0.418750,0.368750,0.025000,0.025000},
-{0.418750,0.368750,0.050000,0.050000},
-{0.431250,0.368750,0.025000,0.025000},
-{0.431250,0.368750,0.050000,0.050000},
-{0.443750,0.368750,0.025000,0.025000},
-{0.443750,0.368750,0.050000,0.050000},
-{0.456250,0.368750,0.025000,0.025000},
-{0.456250,0.368750,0.050000,0.050000},
-{0.468750,0.368750,0.025000,0.025000},
-{0.468750,0.368750,0.050000,0.050000},
-{0.481250,0.368750,0.025000,0.025000},
-{0.481250,0.368750,0.050000,0.050000},
-{0.493750,0.368750,0.025000,0.025000},
-{0.493750,0.368750,0.050000,0.050000},
-{0.506250,0.368750,0.025000,0.025000},
-{0.506250,0.368750,0.050000,0.050000},
-{0.518750,0.368750,0.025000,0.025000},
-{0.518750,0.368750,0.050000,0.050000},
-{0.531250,0.368750,0.025000,0.025000},
-{0.531250,0.368750,0.050000,0.050000},
-{0.543750,0.368750,0.025000,0.025000},
-{0.543750,0.368750,0.050000,0.050000},
-{0.556250,0.368750,0.025000,0.025000},
-{0.556250,0.368750,0.050000,0.050000},
-{0.568750,0.368750,0.025000,0.025000},
-{0.568750,0.368750,0.050000,0.050000},
-{0.581250,0.368750,0.025000,0.025000},
-{0.581250,0.368750,0.050000,0.050000},
-{0.593750,0.368750,0.025000,0.025000},
-{0.593750,0.368750,0.050000,0.050000},
-{0.606250,0.368750,0.025000,0.025000},
-{0.606250,0.368750,0.050000,0.050000},
-{0.618750,0.368750,0.025000,0.025000},
-{0.618750,0.368750,0.050000,0.050000},
-{0.631250,0.368750,0.025000,0.025000},
-{0.631250,0.368750,0.050000,0.050000},
-{0.643750,0.368750,0.025000,0.025000},
-{0.643750,0.368750,0.050000,0.050000},
-{0.656250,0.368750,0.025000,0.025000},
-{0.656250,0.368750,0.050000,0.050000},
-{0.668750,0.368750,0.025000,0.025000},
-{0.668750,0.368750,0.050000,0.050000},
-{0.681250,0.368750,0.025000,0.025000},
-{0.681250,0.368750,0.050000,0.050000},
-{0.693750,0.368750,0.025000,0.025000},
-{0.693750,0.368750,0.050000,0.050000},
-{0.706250,0.368750,0.025000,0.025000},
-{0.706250,0.368750,0.050000,0.050000},
-{0.718750,0.368750,0.025000,0.025000},
-{0.718750,0.368750,0.050000,0.050000},
-{0.731250,0.368750,0.025000,0.025000},
-{0.731250,0.368750,0.050000,0.050000},
-{0.743750,0.368750,0.025000,0.025000},
-{0.743750,0.368750,0.050000,0.050000},
-{0.756250,0.368750,0.025000,0.025000},
-{0.756250,0.368750,0.050000,0.050000},
-{0.768750,0.368750,0.025000,0.025000},
-{0.768750,0.368750,0.050000,0.050000},
-{0.781250,0.368750,0.025000,0.025000},
-{0.781250,0.368750,0.050000,0.050000},
-{0.793750,0.368750,0.025000,0.025000},
-{0.793750,0.368750,0.050000,0.050000},
-{0.806250,0.368750,0.025000,0.025000},
-{0.806250,0.368750,0.050000,0.050000},
-{0.818750,0.368750,0.025000,0.025000},
-{0.818750,0.368750,0.050000,0.050000},
-{0.831250,0.368750,0.025000,0.025000},
-{0.831250,0.368750,0.050000,0.050000},
-{0.843750,0.368750,0.025000,0.025000},
-{0.843750,0.368750,0.050000,0.050000},
-{0.856250,0.368750,0.025000,0.025000},
-{0.856250,0.368750,0.050000,0.050000},
-{0.868750,0.368750,0.025000,0.025000},
-{0.868750,0.368750,0.050000,0.050000},
-{0.881250,0.368750,0.025000,0.025000},
-{0.881250,0.368750,0.050000,0.050000},
-{0.893750,0.368750,0.025000,0.025000},
-{0.893750,0.368750,0.050000,0.050000},
-{0.906250,0.368750,0.025000,0.025000},
-{0.906250,0.368750,0.050000,0.050000},
-{0.918750,0.368750,0.025000,0.025000},
-{0.918750,0.368750,0.050000,0.050000},
-{0.931250,0.368750,0.025000,0.025000},
-{0.931250,0.368750,0.050000,0.050000},
-{0.943750,0.368750,0.025000,0.025000},
-{0.943750,0.368750,0.050000,0.050000},
-{0.956250,0.368750,0.025000,0.025000},
-{0.956250,0.368750,0.050000,0.050000},
-{0.968750,0.368750,0.025000,0.025000},
-{0.968750,0.368750,0.050000,0.050000},
-{0.981250,0.368750,0.025000,0.025000},
-{0.981250,0.368750,0.050000,0.050000},
-{0.993750,0.368750,0.025000,0.025000},
-{0.993750,0.368750,0.050000,0.050000},
-{0.006250,0.381250,0.025000,0.025000},
-{0.006250,0.381250,0.050000,0.050000},
-{0.018750,0.381250,0.025000,0.025000},
-{0.018750,0.381250,0.050000,0.050000},
-{0.031250,0.381250,0.025000,0.025000},
-{0.031250,0.381250,0.050000,0.050000},
-{0.043750,0.381250,0.025000,0.025000},
-{0.043750,0.381250,0.050000,0.050000},
-{0.056250,0.381250,0.025000,0.025000},
-{0.056250,0.381250,0.050000,0.050000},
-{0.068750,0.381250,0.025000,0.025000},
-{0.068750,0.381250,0.050000,0.050000},
-{0.081250,0.381250,0.025000,0.025000},
-{0.081250,0.381250,0.050000,0.050000},
-{0.093750,0.381250,0.025000,0.025000},
-{0.093750,0.381250,0.050000,0.050000},
-{0.106250,0.381250,0.025000,0.025000},
-{0.106250,0.381250,0.050000,0.050000},
-{0.118750,0.381250,0.025000,0.025000},
-{0.118750,0.381250,0.050000,0.050000},
-{0.131250,0.381250,0.025000,0.025000},
-{0.131250,0.381250,0.050000,0.050000},
-{0.143750,0.381250,0.025000,0.025000},
-{0.143750,0.381250,0.050000,0.050000},
-{0.156250,0.381250,0.025000,0.025000},
-{0.156250,0.381250,0.050000,0.050000},
-{0.168750,0.381250,0.025000,0.025000},
-{0.168750,0.381250,0.050000,0.050000},
-{0.181250,0.381250,0.025000,0.025000},
-{0.181250,0.381250,0.050000,0.050000},
-{0.193750,0.381250,0.025000,0.025000},
-{0.193750,0.381250,0.050000,0.050000},
-{0.206250,0.381250,0.025000,0.025000},
-{0.206250,0.381250,0.050000,0.050000},
-{0.218750,0.381250,0.025000,0.025000},
-{0.218750,0.381250,0.050000,0.050000},
-{0.231250,0.381250,0.025000,0.025000},
-{0.231250,0.381250,0.050000,0.050000},
-{0.243750,0.381250,0.025000,0.025000},
-{0.243750,0.381250,0.050000,0.050000},
-{0.256250,0.381250,0.025000,0.025000},
-{0.256250,0.381250,0.050000,0.050000},
-{0.268750,0.381250,0.025000,0.025000},
-{0.268750,0.381250,0.050000,0.050000},
-{0.281250,0.381250,0.025000,0.025000},
-{0.281250,0.381250,0.050000,0.050000},
-{0.293750,0.381250,0.025000,0.025000},
-{0.293750,0.381250,0.050000,0.050000},
-{0.306250,0.381250,0.025000,0.025000},
-{0.306250,0.381250,0.050000,0.050000},
-{0.318750,0.381250,0.025000,0.025000},
-{0.318750,0.381250,0.050000,0.050000},
-{0.331250,0.381250,0.025000,0.025000},
-{0.331250,0.381250,0.050000,0.050000},
-{0.343750,0.381250,0.025000,0.025000},
-{0.343750,0.381250,0.050000,0.050000},
-{0.356250,0.381250,0.025000,0.025000},
-{0.356250,0.381250,0.050000,0.050000},
-{0.368750,0.381250,0.025000,0.025000},
-{0.368750,0.381250,0.050000,0.050000},
-{0.381250,0.381250,0.025000,0.025000},
-{0.381250,0.381250,0.050000,0.050000},
-{0.393750,0.381250,0.025000,0.025000},
-{0.393750,0.381250,0.050000,0.050000},
-{0.406250,0.381250,0.025000,0.025000},
-{0.406250,0.381250,0.050000,0.050000},
-{0.418750,0.381250,0.025000,0.025000},
-{0.418750,0.381250,0.050000,0.050000},
-{0.431250,0.381250,0.025000,0.025000},
-{0.431250,0.381250,0.050000,0.050000},
-{0.443750,0.381250,0.025000,0.025000},
-{0.443750,0.381250,0.050000,0.050000},
-{0.456250,0.381250,0.025000,0.025000},
-{0.456250,0.381250,0.050000,0.050000},
-{0.468750,0.381250,0.025000,0.025000},
-{0.468750,0.381250,0.050000,0.050000},
-{0.481250,0.381250,0.025000,0.025000},
-{0.481250,0.381250,0.050000,0.050000},
-{0.493750,0.381250,0.025000,0.025000},
-{0.493750,0.381250,0.050000,0.050000},
-{0.506250,0.381250,0.025000,0.025000},
-{0.506250,0.381250,0.050000,0.050000},
-{0.518750,0.381250,0.025000,0.025000},
-{0.518750,0.381250,0.050000,0.050000},
-{0.531250,0.381250,0.025000,0.025000},
-{0.531250,0.381250,0.050000,0.050000},
-{0.543750,0.381250,0.025000,0.025000},
-{0.543750,0.381250,0.050000,0.050000},
-{0.556250,0.381250,0.025000,0.025000},
-{0.556250,0.381250,0.050000,0.050000},
-{0.568750,0.381250,0.025000,0.025000},
-{0.568750,0.381250,0.050000,0.050000},
-{0.581250,0.381250,0.025000,0.025000},
-{0.581250,0.381250,0.050000,0.050000},
-{0.593750,0.381250,0.025000,0.025000},
-{0.593750,0.381250,0.050000,0.050000},
-{0.606250,0.381250,0.025000,0.025000},
-{0.606250,0.381250,0.050000,0.050000},
-{0.618750,0.381250,0.025000,0.025000},
-{0.618750,0.381250,0.050000,0.050000},
-{0.631250,0.381250,0.025000,0.025000},
-{0.631250,0.381250,0.050000,0.050000},
-{0.643750,0.381250,0.025000,0.025000},
-{0.643750,0.381250,0.050000,0.050000},
-{0.656250,0.381250,0.025000,0.025000},
-{0.656250,0.381250,0.050000,0.050000},
-{0.668750,0.381250,0.025000,0.025000},
-{0.668750,0.381250,0.050000,0.050000},
-{0.681250,0.381250,0.025000,0.025000},
-{0.681250,0.381250,0.050000,0.050000},
-{0.693750,0.381250,0.025000,0.025000},
-{0.693750,0.381250,0.050000,0.050000},
-{0.706250,0.381250,0.025000,0.025000},
-{0.706250,0.381250,0.050000,0.050000},
-{0.718750,0.381250,0.025000,0.025000},
-{0.718750,0.381250,0.050000,0.050000},
-{0.731250,0.381250,0.025000,0.025000},
-{0.731250,0.381250,0.050000,0.050000},
-{0.743750,0.381250,0.025000,0.025000},
-{0.743750,0.381250,0.050000,0.050000},
-{0.756250,0.381250,0.025000,0.025000},
-{0.756250,0.381250,0.050000,0.050000},
-{0.768750,0.381250,0.025000,0.025000},
-{0.768750,0.381250,0.050000,0.050000},
-{0.781250,0.381250,0.025000,0.025000},
-{0.781250,0.381250,0.050000,0.050000},
-{0.793750,0.381250,0.025000,0.025000},
-{0.793750,0.381250,0.050000,0.050000},
-{0.806250,0.381250,0.025000,0.025000},
-{0.806250,0.381250,0.050000,0.050000},
-{0.818750,0.381250,0.025000,0.025000},
-{0.818750,0.381250,0.050000,0.050000},
-{0.831250,0.381250,0.025000,0.025000},
-{0.831250,0.381250,0.050000,0.050000},
-{0.843750,0.381250,0.025000,0.025000},
-{0.843750,0.381250,0.050000,0.050000},
-{0.856250,0.381250,0.025000,0.025000},
-{0.856250,0.381250,0.050000,0.050000},
-{0.868750,0.381250,0.025000,0.025000},
-{0.868750,0.381250,0.050000,0.050000},
-{0.881250,0.381250,0.025000,0.025000},
-{0.881250,0.381250,0.050000,0.050000},
-{0.893750,0.381250,0.025000,0.025000},
-{0.893750,0.381250,0.050000,0.050000},
-{0.906250,0.381250,0.025000,0.025000},
-{0.906250,0.381250,0.050000,0.050000},
-{0.918750,0.381250,0.025000,0.025000},
-{0.918750,0.381250,0.050000,0.050000},
-{0.931250,0.381250,0.025000,0.025000},
-{0.931250,0.381250,0.050000,0.050000},
-{0.943750,0.381250,0.025000,0.025000},
-{0.943750,0.381250,0.050000,0.050000},
-{0.956250,0.381250,0.025000,0.025000},
-{0.956250,0.381250,0.050000,0.050000},
-{0.968750,0.381250,0.025000,0.025000},
-{0.968750,0.381250,0.050000,0.050000},
-{0.981250,0.381250,0.025000,0.025000},
-{0.981250,0.381250,0.050000,0.050000},
-{0.993750,0.381250,0.025000,0.025000},
-{0.993750,0.381250,0.050000,0.050000},
-{0.006250,0.393750,0.025000,0.025000},
-{0.006250,0.393750,0.050000,0.050000},
-{0.018750,0.393750,0.025000,0.025000},
-{0.018750,0.393750,0.050000,0.050000},
-{0.031250,0.393750,0.025000,0.025000},
-{0.031250,0.393750,0.050000,0.050000},
-{0.043750,0.393750,0.025000,0.025000},
-{0.043750,0.393750,0.050000,0.050000},
-{0.056250,0.393750,0.025000,0.025000},
-{0.056250,0.393750,0.050000,0.050000},
-{0.068750,0.393750,0.025000,0.025000},
-{0.068750,0.393750,0.050000,0.050000},
-{0.081250,0.393750,0.025000,0.025000},
-{0.081250,0.393750,0.050000,0.050000},
-{0.093750,0.393750,0.025000,0.025000},
-{0.093750,0.393750,0.050000,0.050000},
-{0.106250,0.393750,0.025000,0.025000},
-{0.106250,0.393750,0.050000,0.050000},
-{0.118750,0.393750,0.025000,0.025000},
-{0.118750,0.393750,0.050000,0.050000},
-{0.131250,0.393750,0.025000,0.025000},
-{0.131250,0.393750,0.050000,0.050000},
-{0.143750,0.393750,0.025000,0.025000},
-{0.143750,0.393750,0.050000,0.050000},
-{0.156250,0.393750,0.025000,0.025000},
-{0.156250,0.393750,0.050000,0.050000},
-{0.168750,0.393750,0.025000,0.025000},
-{0.168750,0.393750,0.050000,0.050000},
-{0.181250,0.393750,0.025000,0.025000},
-{0.181250,0.393750,0.050000,0.050000},
-{0.193750,0.393750,0.025000,0.025000},
-{0.193750,0.393750,0.050000,0.050000},
-{0.206250,0.393750,0.025000,0.025000},
-{0.206250,0.393750,0.050000,0.050000},
-{0.218750,0.393750,0.025000,0.025000},
-{0.218750,0.393750,0.050000,0.050000},
-{0.231250,0.393750,0.025000,0.025000},
-{0.231250,0.393750,0.050000,0.050000},
-{0.243750,0.393750,0.025000,0.025000},
-{0.243750,0.393750,0.050000,0.050000},
-{0.256250,0.393750,0.025000,0.025000},
-{0.256250,0.393750,0.050000,0.050000},
-{0.268750,0.393750,0.025000,0.025000},
-{0.268750,0.393750,0.050000,0.050000},
-{0.281250,0.393750,0.025000,0.025000},
-{0.281250,0.393750,0.050000,0.050000},
-{0.293750,0.393750,0.025000,0.025000},
-{0.293750,0.393750,0.050000,0.050000},
-{0.306250,0.393750,0.025000,0.025000},
-{0.306250,0.393750,0.050000,0.050000},
-{0.318750,0.393750,0.025000,0.025000},
-{0.318750,0.393750,0.050000,0.050000},
-{0.331250,0.393750,0.025000,0.025000},
-{0.331250,0.393750,0.050000,0.050000},
-{0.343750,0.393750,0.025000,0.025000},
-{0.343750,0.393750,0.050000,0.050000},
-{0.356250,0.393750,0.025000,0.025000},
-{0.356250,0.393750,0.050000,0.050000},
-{0.368750,0.393750,0.025000,0.025000},
-{0.368750,0.393750,0.050000,0.050000},
-{0.381250,0.393750,0.025000,0.025000},
-{0.381250,0.393750,0.050000,0.050000},
-{0.393750,0.393750,0.025000,0.025000},
-{0.393750,0.393750,0.050000,0.050000},
-{0.406250,0.393750,0.025000,0.025000},
-{0.406250,0.393750,0.050000,0.050000},
-{0.418750,0.393750,0.025000,0.025000},
-{0.418750,0.393750,0.050000,0.050000},
-{0.431250,0.393750,0.025000,0.025000},
-{0.431250,0.393750,0.050000,0.050000},
-{0.443750,0.393750,0.025000,0.025000},
-{0.443750,0.393750,0.050000,0.050000},
-{0.456250,0.393750,0.025000,0.025000},
-{0.456250,0.393750,0.050000,0.050000},
-{0.468750,0.393750,0.025000,0.025000},
-{0.468750,0.393750,0.050000,0.050000},
-{0.481250,0.393750,0.025000,0.025000},
-{0.481250,0.393750,0.050000,0.050000},
-{0.493750,0.393750,0.025000,0.025000},
-{0.493750,0.393750,0.050000,0.050000},
-{0.506250,0.393750,0.025000,0.025000},
-{0.506250,0.393750,0.050000,0.050000},
-{0.518750,0.393750,0.025000,0.025000},
-{0.518750,0.393750,0.050000,0.050000},
-{0.531250,0.393750,0.025000,0.025000},
-{0.531250,0.393750,0.050000,0.050000},
-{0.543750,0.393750,0.025000,0.025000},
-{0.543750,0.393750,0.050000,0.050000},
-{0.556250,0.393750,0.025000,0.025000},
-{0.556250,0.393750,0.050000,0.050000},
-{0.568750,0.393750,0.025000,0.025000},
-{0.568750,0.393750,0.050000,0.050000},
-{0.581250,0.393750,0.025000,0.025000},
-{0.581250,0.393750,0.050000,0.050000},
-{0.593750,0.393750,0.025000,0.025000},
-{0.593750,0.393750,0.050000,0.050000},
-{0.606250,0.393750,0.025000,0.025000},
-{0.606250,0.393750,0.050000,0.050000},
-{0.618750,0.393750,0.025000,0.025000},
-{0.618750,0.393750,0.050000,0.050000},
-{0.631250,0.393750,0.025000,0.025000},
-{0.631250,0.393750,0.050000,0.050000},
-{0.643750,0.393750,0.025000,0.025000},
-{0.643750,0.393750,0.050000,0.050000},
-{0.656250,0.393750,0.025000,0.025000},
-{0.656250,0.393750,0.050000,0.050000},
-{0.668750,0.393750,0.025000,0.025000},
-{0.668750,0.393750,0.050000,0.050000},
-{0.681250,0.393750,0.025000,0.025000},
-{0.681250,0.393750,0.050000,0.050000},
-{0.693750,0.393750,0.025000,0.025000},
-{0.693750,0.393750,0.050000,0.050000},
-{0.706250,0.393750,0.025000,0.025000},
-{0.706250,0.393750,0.050000,0.050000},
-{0.718750,0.393750,0.025000,0.025000},
-{0.718750,0.393750,0.050000,0.050000},
-{0.731250,0.393750,0.025000,0.025000},
-{0.731250,0.393750,0.050000,0.050000},
-{0.743750,0.393750,0.025000,0.025000},
-{0.743750,0.393750,0.050000,0.050000},
-{0.756250,0.393750,0.025000,0.025000},
-{0.756250,0.393750,0.050000,0.050000},
-{0.768750,0.393750,0.025000,0.025000},
-{0.768750,0.393750,0.050000,0.050000},
-{0.781250,0.393750,0.025000,0.025000},
-{0.781250,0.393750,0.050000,0.050000},
-{0.793750,0.393750,0.025000,0.025000},
-{0.793750,0.393750,0.050000,0.050000},
-{0.806250,0.393750,0.025000,0.025000},
-{0.806250,0.393750,0.050000,0.050000},
-{0.818750,0.393750,0.025000,0.025000},
-{0.818750,0.393750,0.050000,0.050000},
-{0.831250,0.393750,0.025000,0.025000},
-{0.831250,0.393750,0.050000,0.050000},
-{0.843750,0.393750,0.025000,0.025000},
-{0.843750,0.393750,0.050000,0.050000},
-{0.856250,0.393750,0.025000,0.025000},
-{0.856250,0.393750,0.050000,0.050000},
-{0.868750,0.393750,0.025000,0.025000},
-{0.868750,0.393750,0.050000,0.050000},
-{0.881250,0.393750,0.025000,0.025000},
-{0.881250,0.393750,0.050000,0.050000},
-{0.893750,0.393750,0.025000,0.025000},
-{0.893750,0.393750,0.050000,0.050000},
-{0.906250,0.393750,0.025000,0.025000},
-{0.906250,0.393750,0.050000,0.050000},
-{0.918750,0.393750,0.025000,0.025000},
-{0.918750,0.393750,0.050000,0.050000},
-{0.931250,0.393750,0.025000,0.025000},
-{0.931250,0.393750,0.050000,0.050000},
-{0.943750,0.393750,0.025000,0.025000},
-{0.943750,0.393750,0.050000,0.050000},
-{0.956250,0.393750,0.025000,0.025000},
-{0.956250,0.393750,0.050000,0.050000},
-{0.968750,0.393750,0.025000,0.025000},
-{0.968750,0.393750,0.050000,0.050000},
-{0.981250,0.393750,0.025000,0.025000},
-{0.981250,0.393750,0.050000,0.050000},
-{0.993750,0.393750,0.025000,0.025000},
-{0.993750,0.393750,0.050000,0.050000},
-{0.006250,0.406250,0.025000,0.025000},
-{0.006250,0.406250,0.050000,0.050000},
-{0.018750,0.406250,0.025000,0.025000},
-{0.018750,0.406250,0.050000,0.050000},
-{0.031250,0.406250,0.025000,0.025000},
-{0.031250,0.406250,0.050000,0.050000},
-{0.043750,0.406250,0.025000,0.025000},
-{0.043750,0.406250,0.050000,0.050000},
-{0.056250,0.406250,0.025000,0.025000},
-{0.056250,0.406250,0.050000,0.050000},
-{0.068750,0.406250,0.025000,0.025000},
-{0.068750,0.406250,0.050000,0.050000},
-{0.081250,0.406250,0.025000,0.025000},
-{0.081250,0.406250,0.050000,0.050000},
-{0.093750,0.406250,0.025000,0.025000},
-{0.093750,0.406250,0.050000,0.050000},
-{0.106250,0.406250,0.025000,0.025000},
-{0.106250,0.406250,0.050000,0.050000},
-{0.118750,0.406250,0.025000,0.025000},
-{0.118750,0.406250,0.050000,0.050000},
-{0.131250,0.406250,0.025000,0.025000},
-{0.131250,0.406250,0.050000,0.050000},
-{0.143750,0.406250,0.025000,0.025000},
-{0.143750,0.406250,0.050000,0.050000},
-{0.156250,0.406250,0.025000,0.025000},
-{0.156250,0.406250,0.050000,0.050000},
-{0.168750,0.406250,0.025000,0.025000},
-{0.168750,0.406250,0.050000,0.050000},
-{0.181250,0.406250,0.025000,0.025000},
-{0.181250,0.406250,0.050000,0.050000},
-{0.193750,0.406250,0.025000,0.025000},
-{0.193750,0.406250,0.050000,0.050000},
-{0.206250,0.406250,0.025000,0.025000},
-{0.206250,0.406250,0.050000,0.050000},
-{0.218750,0.406250,0.025000,0.025000},
-{0.218750,0.406250,0.050000,0.050000},
-{0.231250,0.406250,0.025000,0.025000},
-{0.231250,0.406250,0.050000,0.050000},
-{0.243750,0.406250,0.025000,0.025000},
-{0.243750,0.406250,0.050000,0.050000},
-{0.256250,0.406250,0.025000,0.025000},
-{0.256250,0.406250,0.050000,0.050000},
-{0.268750,0.406250,0.025000,0.025000},
-{0.268750,0.406250,0.050000,0.050000},
-{0.281250,0.406250,0.025000,0.025000},
-{0.281250,0.406250,0.050000,0.050000},
-{0.293750,0.406250,0.025000,0.025000},
-{0.293750,0.406250,0.050000,0.050000},
-{0.306250,0.406250,0.025000,0.025000},
-{0.306250,0.406250,0.050000,0.050000},
-{0.318750,0.406250,0.025000,0.025000},
-{0.318750,0.406250,0.050000,0.050000},
-{0.331250,0.406250,0.025000,0.025000},
-{0.331250,0.406250,0.050000,0.050000},
-{0.343750,0.406250,0.025000,0.025000},
-{0.343750,0.406250,0.050000,0.050000},
-{0.356250,0.406250,0.025000,0.025000},
-{0.356250,0.406250,0.050000,0.050000},
-{0.368750,0.406250,0.025000,0.025000},
-{0.368750,0.406250,0.050000,0.050000},
-{0.381250,0.406250,0.025000,0.025000},
-{0.381250,0.406250,0.050000,0.050000},
-{0.393750,0.406250,0.025000,0.025000},
-{0.393750,0.406250,0.050000,0.050000},
-{0.406250,0.406250,0.025000,0.025000},
-{0.406250,0.406250,0.050000,0.050000},
-{0.418750,0.406250,0.025000,0.025000},
-{0.418750,0.406250,0.050000,0.050000},
-{0.431250,0.406250,0.025000,0.025000},
-{0.431250,0.406250,0.050000,0.050000},
-{0.443750,0.406250,0.025000,0.025000},
-{0.443750,0.406250,0.050000,0.050000},
-{0.456250,0.406250,0.025000,0.025000},
-{0.456250,0.406250,0.050000,0.050000},
-{0.468750,0.406250,0.025000,0.025000},
-{0.468750,0.406250,0.050000,0.050000},
-{0.481250,0.406250,0.025000,0.025000},
-{0.481250,0.406250,0.050000,0.050000},
-{0.493750,0.406250,0.025000,0.025000},
-{0.493750,0.406250,0.050000,0.050000},
-{0.506250,0.406250,0.025000,0.025000},
-{0.506250,0.406250,0.050000,0.050000},
-{0.518750,0.406250,0.025000,0.025000},
-{0.518750,0.406250,0.050000,0.050000},
-{0.531250,0.406250,0.025000,0.025000},
-{0.531250,0.406250,0.050000,0.050000},
-{0.543750,0.406250,0.025000,0.025000},
-{0.543750,0.406250,0.050000,0.050000},
-{0.556250,0.406250,0.025000,0.025000},
-{0.556250,0.406250,0.050000,0.050000},
-{0.568750,0.406250,0.025000,0.025000},
-{0.568750,0.406250,0.050000,0.050000},
-{0.581250,0.406250,0.025000,0.025000},
-{0.581250,0.406250,0.050000,0.050000},
-{0.593750,0.406250,0.025000,0.025000},
-{0.593750,0.406250,0.050000,0.050000},
-{0.606250,0.406250,0.025000,0.025000},
-{0.606250,0.406250,0.050000,0.050000},
-{0.618750,0.406250,0.025000,0.025000},
-{0.618750,0.406250,0.050000,0.050000},
-{0.631250,0.406250,0.025000,0.025000},
-{0.631250,0.406250,0.050000,0.050000},
-{0.643750,0.406250,0.025000,0.025000},
-{0.643750,0.406250,0.050000,0.050000},
-{0.656250,0.406250,0.025000,0.025000},
-{0.656250,0.406250,0.050000,0.050000},
-{0.668750,0.406250,0.025000,0.025000},
-{0.668750,0.406250,0.050000,0.050000},
-{0.681250,0.406250,0.025000,0.025000},
-{0.681250,0.406250,0.050000,0.050000},
-{0.693750,0.406250,0.025000,0.025000},
-{0.693750,0.406250,0.050000,0.050000},
-{0.706250,0.406250,0.025000,0.025000},
-{0.706250,0.406250,0.050000,0.050000},
-{0.718750,0.406250,0.025000,0.025000},
-{0.718750,0.406250,0.050000,0.050000},
-{0.731250,0.406250,0.025000,0.025000},
-{0.731250,0.406250,0.050000,0.050000},
-{0.743750,0.406250,0.025000,0.025000},
-{0.743750,0.406250,0.050000,0.050000},
-{0.756250,0.406250,0.025000,0.025000},
-{0.756250,0.406250,0.050000,0.050000},
-{0.768750,0.406250,0.025000,0.025000},
-{0.768750,0.406250,0.050000,0.050000},
-{0.781250,0.406250,0.025000,0.025000},
-{0.781250,0.406250,0.050000,0.050000},
-{0.793750,0.406250,0.025000,0.025000},
-{0.793750,0.406250,0.050000,0.050000},
-{0.806250,0.406250,0.025000,0.025000},
-{0.806250,0.406250,0.050000,0.050000},
-{0.818750,0.406250,0.025000,0.025000},
-{0.818750,0.406250,0.050000,0.050000},
-{0.831250,0.406250,0.025000,0.025000},
-{0.831250,0.406250,0.050000,0.050000},
-{0.843750,0.406250,0.025000,0.025000},
-{0.843750,0.406250,0.050000,0.050000},
-{0.856250,0.406250,0.025000,0.025000},
-{0.856250,0.406250,0.050000,0.050000},
-{0.868750,0.406250,0.025000,0.025000},
-{0.868750,0.406250,0.050000,0.050000},
-{0.881250,0.406250,0.025000,0.025000},
-{0.881250,0.406250,0.050000,0.050000},
-{0.893750,0.406250,0.025000,0.025000},
-{0.893750,0.406250,0.050000,0.050000},
-{0.906250,0.406250,0.025000,0.025000},
-{0.906250,0.406250,0.050000,0.050000},
-{0.918750,0.406250,0.025000,0.025000},
-{0.918750,0.406250,0.050000,0.050000},
-{0.931250,0.406250,0.025000,0.025000},
-{0.931250,0.406250,0.050000,0.050000},
-{0.943750,0.406250,0.025000,0.025000},
-{0.943750,0.406250,0.050000,0.050000},
-{0.956250,0.406250,0.025000,0.025000},
-{0.956250,0.406250,0.050000,0.050000},
-{0.968750,0.406250,0.025000,0.025000},
-{0.968750,0.406250,0.050000,0.050000},
-{0.981250,0.406250,0.025000,0.025000},
-{0.981250,0.406250,0.050000,0.050000},
-{0.993750,0.406250,0.025000,0.025000},
-{0.993750,0.406250,0.050000,0.050000},
-{0.006250,0.418750,0.025000,0.025000},
-{0.006250,0.418750,0.050000,0.050000},
-{0.018750,0.418750,0.025000,0.025000},
-{0.018750,0.418750,0.050000,0.050000},
-{0.031250,0.418750,0.025000,0.025000},
-{0.031250,0.418750,0.050000,0.050000},
-{0.043750,0.418750,0.025000,0.025000},
-{0.043750,0.418750,0.050000,0.050000},
-{0.056250,0.418750,0.025000,0.025000},
-{0.056250,0.418750,0.050000,0.050000},
-{0.068750,0.418750,0.025000,0.025000},
-{0.068750,0.418750,0.050000,0.050000},
-{0.081250,0.418750,0.025000,0.025000},
-{0.081250,0.418750,0.050000,0.050000},
-{0.093750,0.418750,0.025000,0.025000},
-{0.093750,0.418750,0.050000,0.050000},
-{0.106250,0.418750,0.025000,0.025000},
-{0.106250,0.418750,0.050000,0.050000},
-{0.118750,0.418750,0.025000,0.025000},
-{0.118750,0.418750,0.050000,0.050000},
-{0.131250,0.418750,0.025000,0.025000},
-{0.131250,0.418750,0.050000,0.050000},
-{0.143750,0.418750,0.025000,0.025000},
-{0.143750,0.418750,0.050000,0.050000},
-{0.156250,0.418750,0.025000,0.025000},
-{0.156250,0.418750,0.050000,0.050000},
-{0.168750,0.418750,0.025000,0.025000},
-{0.168750,0.418750,0.050000,0.050000},
-{0.181250,0.418750,0.025000,0.025000},
-{0.181250,0.418750,0.050000,0.050000},
-{0.193750,0.418750,0.025000,0.025000},
-{0.193750,0.418750,0.050000,0.050000},
-{0.206250,0.418750,0.025000,0.025000},
-{0.206250,0.418750,0.050000,0.050000},
-{0.218750,0.418750,0.025000,0.025000},
-{0.218750,0.418750,0.050000,0.050000},
-{0.231250,0.418750,0.025000,0.025000},
-{0.231250,0.418750,0.050000,0.050000},
-{0.243750,0.418750,0.025000,0.025000},
-{0.243750,0.418750,0.050000,0.050000},
-{0.256250,0.418750,0.025000,0.025000},
-{0.256250,0.418750,0.050000,0.050000},
-{0.268750,0.418750,0.025000,0.025000},
-{0.268750,0.418750,0.050000,0.050000},
-{0.281250,0.418750,0.025000,0.025000},
-{0.281250,0.418750,0.050000,0.050000},
-{0.293750,0.418750,0.025000,0.025000},
-{0.293750,0.418750,0.050000,0.050000},
-{0.306250,0.418750,0.025000,0.025000},
-{0.306250,0.418750,0.050000,0.050000},
-{0.318750,0.418750,0.025000,0.025000},
-{0.318750,0.418750,0.050000,0.050000},
-{0.331250,0.418750,0.025000,0.025000},
-{0.331250,0.418750,0.050000,0.050000},
-{0.343750,0.418750,0.025000,0.025000},
-{0.343750,0.418750,0.050000,0.050000},
-{0.356250,0.418750,0.025000,0.025000},
-{0.356250,0.418750,0.050000,0.050000},
-{0.368750,0.418750,0.025000,0.025000},
-{0.368750,0.418750,0.050000,0.050000},
-{0.381250,0.418750,0.025000,0.025000},
-{0.381250,0.418750,0.050000,0.050000},
-{0.393750,0.418750,0.025000,0.025000},
-{0.393750,0.418750,0.050000,0.050000},
-{0.406250,0.418750,0.025000,0.025000},
-{0.406250,0.418750,0.050000,0.050000},
-{0.418750,0.418750,0.025000,0.025000},
-{0.418750,0.418750,0.050000,0.050000},
-{0.431250,0.418750,0.025000,0.025000},
-{0.431250,0.418750,0.050000,0.050000},
-{0.443750,0.418750,0.025000,0.025000},
-{0.443750,0.418750,0.050000,0.050000},
-{0.456250,0.418750,0.025000,0.025000},
-{0.456250,0.418750,0.050000,0.050000},
-{0.468750,0.418750,0.025000,0.025000},
-{0.468750,0.418750,0.050000,0.050000},
-{0.481250,0.418750,0.025000,0.025000},
-{0.481250,0.418750,0.050000,0.050000},
-{0.493750,0.418750,0.025000,0.025000},
-{0.493750,0.418750,0.050000,0.050000},
-{0.506250,0.418750,0.025000,0.025000},
-{0.506250,0.418750,0.050000,0.050000},
-{0.518750,0.418750,0.025000,0.025000},
-{0.518750,0.418750,0.050000,0.050000},
-{0.531250,0.418750,0.025000,0.025000},
-{0.531250,0.418750,0.050000,0.050000},
-{0.543750,0.418750,0.025000,0.025000},
-{0.543750,0.418750,0.050000,0.050000},
-{0.556250,0.418750,0.025000,0.025000},
-{0.556250,0.418750,0.050000,0.050000},
-{0.568750,0.418750,0.025000,0.025000},
-{0.568750,0.418750,0.050000,0.050000},
-{0.581250,0.418750,0.025000,0.025000},
-{0.581250,0.418750,0.050000,0.050000},
-{0.593750,0.418750,0.025000,0.025000},
-{0.593750,0.418750,0.050000,0.050000},
-{0.606250,0.418750,0.025000,0.025000},
-{0.606250,0.418750,0.050000,0.050000},
-{0.618750,0.418750,0.025000,0.025000},
-{0.618750,0.418750,0.050000,0.050000},
-{0.631250,0.418750,0.025000,0.025000},
-{0.631250,0.418750,0.050000,0.050000},
-{0.643750,0.418750,0.025000,0.025000},
-{0.643750,0.418750,0.050000,0.050000},
-{0.656250,0.418750,0.025000,0.025000},
-{0.656250,0.418750,0.050000,0.050000},
-{0.668750,0.418750,0.025000,0.025000},
-{0.668750,0.418750,0.050000,0.050000},
-{0.681250,0.418750,0.025000,0.025000},
-{0.681250,0.418750,0.050000,0.050000},
-{0.693750,0.418750,0.025000,0.025000},
-{0.693750,0.418750,0.050000,0.050000},
-{0.706250,0.418750,0.025000,0.025000},
-{0.706250,0.418750,0.050000,0.050000},
-{0.718750,0.418750,0.025000,0.025000},
-{0.718750,0.418750,0.050000,0.050000},
-{0.731250,0.418750,0.025000,0.025000},
-{0.731250,0.418750,0.050000,0.050000},
-{0.743750,0.418750,0.025000,0.025000},
-{0.743750,0.418750,0.050000,0.050000},
-{0.756250,0.418750,0.025000,0.025000},
-{0.756250,0.418750,0.050000,0.050000},
-{0.768750,0.418750,0.025000,0.025000},
-{0.768750,0.418750,0.050000,0.050000},
-{0.781250,0.418750,0.025000,0.025000},
-{0.781250,0.418750,0.050000,0.050000},
-{0.793750,0.418750,0.025000,0.025000},
-{0.793750,0.418750,0.050000,0.050000},
-{0.806250,0.418750,0.025000,0.025000},
-{0.806250,0.418750,0.050000,0.050000},
-{0.818750,0.418750,0.025000,0.025000},
-{0.818750,0.418750,0.050000,0.050000},
-{0.831250,0.418750,0.025000,0.025000},
-{0.831250,0.418750,0.050000,0.050000},
-{0.843750,0.418750,0.025000,0.025000},
-{0.843750,0.418750,0.050000,0.050000},
-{0.856250,0.418750,0.025000,0.025000},
-{0.856250,0.418750,0.050000,0.050000},
-{0.868750,0.418750,0.025000,0.025000},
-{0.868750,0.418750,0.050000,0.050000},
-{0.881250,0.418750,0.025000,0.025000},
-{0.881250,0.418750,0.050000,0.050000},
-{0.893750,0.418750,0.025000,0.025000},
-{0.893750,0.418750,0.050000,0.050000},
-{0.906250,0.418750,0.025000,0.025000},
-{0.906250,0.418750,0.050000,0.050000},
-{0.918750,0.418750,0.025000,0.025000},
-{0.918750,0.418750,0.050000,0.050000},
-{0.931250,0.418750,0.025000,0.025000},
-{0.931250,0.418750,0.050000,0.050000},
-{0.943750,0.418750,0.025000,0.025000},
-{0.943750,0.418750,0.050000,0.050000},
-{0.956250,0.418750,0.025000,0.025000},
-{0.956250,0.418750,0.050000,0.050000},
-{0.968750,0.418750,0.025000,0.025000},
-{0.968750,0.418750,0.050000,0.050000},
-{0.981250,0.418750,0.025000,0.025000},
-{0.981250,0.418750,0.050000,0.050000},
-{0.993750,0.418750,0.025000,0.025000},
-{0.993750,0.418750,0.050000,0.050000},
-{0.006250,0.431250,0.025000,0.025000},
-{0.006250,0.431250,0.050000,0.050000},
-{0.018750,0.431250,0.025000,0.025000},
-{0.018750,0.431250,0.050000,0.050000},
-{0.031250,0.431250,0.025000,0.025000},
-{0.031250,0.431250,0.050000,0.050000},
-{0.043750,0.431250,0.025000,0.025000},
-{0.043750,0.431250,0.050000,0.050000},
-{0.056250,0.431250,0.025000,0.025000},
-{0.056250,0.431250,0.050000,0.050000},
-{0.068750,0.431250,0.025000,0.025000},
-{0.068750,0.431250,0.050000,0.050000},
-{0.081250,0.431250,0.025000,0.025000},
-{0.081250,0.431250,0.050000,0.050000},
-{0.093750,0.431250,0.025000,0.025000},
-{0.093750,0.431250,0.050000,0.050000},
-{0.106250,0.431250,0.025000,0.025000},
-{0.106250,0.431250,0.050000,0.050000},
-{0.118750,0.431250,0.025000,0.025000},
-{0.118750,0.431250,0.050000,0.050000},
-{0.131250,0.431250,0.025000,0.025000},
-{0.131250,0.431250,0.050000,0.050000},
-{0.143750,0.431250,0.025000,0.025000},
-{0.143750,0.431250,0.050000,0.050000},
-{0.156250,0.431250,0.025000,0.025000},
-{0.156250,0.431250,0.050000,0.050000},
-{0.168750,0.431250,0.025000,0.025000},
-{0.168750,0.431250,0.050000,0.050000},
-{0.181250,0.431250,0.025000,0.025000},
-{0.181250,0.431250,0.050000,0.050000},
-{0.193750,0.431250,0.025000,0.025000},
-{0.193750,0.431250,0.050000,0.050000},
-{0.206250,0.431250,0.025000,0.025000},
-{0.206250,0.431250,0.050000,0.050000},
-{0.218750,0.431250,0.025000,0.025000},
-{0.218750,0.431250,0.050000,0.050000},
-{0.231250,0.431250,0.025000,0.025000},
-{0.231250,0.431250,0.050000,0.050000},
-{0.243750,0.431250,0.025000,0.025000},
-{0.243750,0.431250,0.050000,0.050000},
-{0.256250,0.431250,0.025000,0.025000},
-{0.256250,0.431250,0.050000,0.050000},
-{0.268750,0.431250,0.025000,0.025000},
-{0.268750,0.431250,0.050000,0.050000},
-{0.281250,0.431250,0.025000,0.025000},
-{0.281250,0.431250,0.050000,0.050000},
-{0.293750,0.431250,0.025000,0.025000},
-{0.293750,0.431250,0.050000,0.050000},
-{0.306250,0.431250,0.025000,0.025000},
-{0.306250,0.431250,0.050000,0.050000},
-{0.318750,0.431250,0.025000,0.025000},
-{0.318750,0.431250,0.050000,0.050000},
-{0.331250,0.431250,0.025000,0.025000},
-{0.331250,0.431250,0.050000,0.050000},
-{0.343750,0.431250,0.025000,0.025000},
-{0.343750,0.431250,0.050000,0.050000},
-{0.356250,0.431250,0.025000,0.025000},
-{0.356250,0.431250,0.050000,0.050000},
-{0.368750,0.431250,0.025000,0.025000},
-{0.368750,0.431250,0.050000,0.050000},
-{0.381250,0.431250,0.025000,0.025000},
-{0.381250,0.431250,0.050000,0.050000},
-{0.393750,0.431250,0.025000,0.025000},
-{0.393750,0.431250,0.050000,0.050000},
-{0.406250,0.431250,0.025000,0.025000},
-{0.406250,0.431250,0.050000,0.050000},
-{0.418750,0.431250,0.025000,0.025000},
-{0.418750,0.431250,0.050000,0.050000},
-{0.431250,0.431250,0.025000,0.025000},
-{0.431250,0.431250,0.050000,0.050000},
-{0.443750,0.431250,0.025000,0.025000},
-{0.443750,0.431250,0.050000,0.050000},
-{0.456250,0.431250,0.025000,0.025000},
-{0.456250,0.431250,0.050000,0.050000},
-{0.468750,0.431250,0.025000,0.025000},
-{0.468750,0.431250,0.050000,0.050000},
-{0.481250,0.431250,0.025000,0.025000},
-{0.481250,0.431250,0.050000,0.050000},
-{0.493750,0.431250,0.025000,0.025000},
-{0.493750,0.431250,0.050000,0.050000},
-{0.506250,0.431250,0.025000,0.025000},
-{0.506250,0.431250,0.050000,0.050000},
-{0.518750,0.431250,0.025000,0.025000},
-{0.518750,0.431250,0.050000,0.050000},
-{0.531250,0.431250,0.025000,0.025000},
-{0.531250,0.431250,0.050000,0.050000},
-{0.543750,0.431250,0.025000,0.025000},
-{0.543750,0.431250,0.050000,0.050000},
-{0.556250,0.431250,0.025000,0.025000},
-{0.556250,0.431250,0.050000,0.050000},
-{0.568750,0.431250,0.025000,0.025000},
-{0.568750,0.431250,0.050000,0.050000},
-{0.581250,0.431250,0.025000,0.025000},
-{0.581250,0.431250,0.050000,0.050000},
-{0.593750,0.431250,0.025000,0.025000},
-{0.593750,0.431250,0.050000,0.050000},
-{0.606250,0.431250,0.025000,0.025000},
-{0.606250,0.431250,0.050000,0.050000},
-{0.618750,0.431250,0.025000,0.025000},
-{0.618750,0.431250,0.050000,0.050000},
-{0.631250,0.431250,0.025000,0.025000},
-{0.631250,0.431250,0.050000,0.050000},
-{0.643750,0.431250,0.025000,0.025000},
-{0.643750,0.431250,0.050000,0.050000},
-{0.656250,0.431250,0.025000,0.025000},
-{0.656250,0.431250,0.050000,0.050000},
-{0.668750,0.431250,0.025000,0.025000},
-{0.668750,0.431250,0.050000,0.050000},
-{0.681250,0.431250,0.025000,0.025000},
-{0.681250,0.431250,0.050000,0.050000},
-{0.693750,0.431250,0.025000,0.025000},
-{0.693750,0.431250,0.050000,0.050000},
-{0.706250,0.431250,0.025000,0.025000},
-{0.706250,0.431250,0.050000,0.050000},
-{0.718750,0.431250,0.025000,0.025000},
-{0.718750,0.431250,0.050000,0.050000},
-{0.731250,0.431250,0.025000,0.025000},
-{0.731250,0.431250,0.050000,0.050000},
-{0.743750,0.431250,0.025000,0.025000},
-{0.743750,0.431250,0.050000,0.050000},
-{0.756250,0.431250,0.025000,0.025000},
-{0.756250,0.431250,0.050000,0.050000},
-{0.768750,0.431250,0.025000,0.025000},
-{0.768750,0.431250,0.050000,0.050000},
-{0.781250,0.431250,0.025000,0.025000},
-{0.781250,0.431250,0.050000,0.050000},
-{0.793750,0.431250,0.025000,0.025000},
-{0.793750,0.431250,0.050000,0.050000},
-{0.806250,0.431250,0.025000,0.025000},
-{0.806250,0.431250,0.050000,0.050000},
-{0.818750,0.431250,0.025000,0.025000},
-{0.818750,0.431250,0.050000,0.050000},
-{0.831250,0.431250,0.025000,0.025000},
-{0.831250,0.431250,0.050000,0.050000},
-{0.843750,0.431250,0.025000,0.025000},
-{0.843750,0.431250,0.050000,0.050000},
-{0.856250,0.431250,0.025000,0.025000},
-{0.856250,0.431250,0.050000,0.050000},
-{0.868750,0.431250,0.025000,0.025000},
-{0.868750,0.431250,0.050000,0.050000},
-{0.881250,0.431250,0.025000,0.025000},
-{0.881250,0.431250,0.050000,0.050000},
-{0.893750,0.431250,0.025000,0.025000},
-{0.893750,0.431250,0.050000,0.050000},
-{0.906250,0.431250,0.025000,0.025000},
-{0.906250,0.431250,0.050000,0.050000},
-{0.918750,0.431250,0.025000,0.025000},
-{0.918750,0.431250,0.050000,0.050000},
-{0.931250,0.431250,0.025000,0.025000},
-{0.931250,0.431250,0.050000,0.050000},
-{0.943750,0.431250,0.025000,0.025000},
-{0.943750,0.431250,0.050000,0.050000},
-{0.956250,0.431250,0.025000,0.025000},
-{0.956250,0.431250,0.050000,0.050000},
-{0.968750,0.431250,0.025000,0.025000},
-{0.968750,0.431250,0.050000,0.050000},
-{0.981250,0.431250,0.025000,0.025000},
-{0.981250,0.431250,0.050000,0.050000},
-{0.993750,0.431250,0.025000,0.025000},
-{0.993750,0.431250,0.050000,0.050000},
-{0.006250,0.443750,0.025000,0.025000},
-{0.006250,0.443750,0.050000,0.050000},
-{0.018750,0.443750,0.025000,0.025000},
-{0.018750,0.443750,0.050000,0.050000},
-{0.031250,0.443750,0.025000,0.025000},
-{0.031250,0.443750,0.050000,0.050000},
-{0.043750,0.443750,0.025000,0.025000},
-{0.043750,0.443750,0.050000,0.050000},
-{0.056250,0.443750,0.025000,0.025000},
-{0.056250,0.443750,0.050000,0.050000},
-{0.068750,0.443750,0.025000,0.025000},
-{0.068750,0.443750,0.050000,0.050000},
-{0.081250,0.443750,0.025000,0.025000},
-{0.081250,0.443750,0.050000,0.050000},
-{0.093750,0.443750,0.025000,0.025000},
-{0.093750,0.443750,0.050000,0.050000},
-{0.106250,0.443750,0.025000,0.025000},
-{0.106250,0.443750,0.050000,0.050000},
-{0.118750,0.443750,0.025000,0.025000},
-{0.118750,0.443750,0.050000,0.050000},
-{0.131250,0.443750,0.025000,0.025000},
-{0.131250,0.443750,0.050000,0.050000},
-{0.143750,0.443750,0.025000,0.025000},
-{0.143750,0.443750,0.050000,0.050000},
-{0.156250,0.443750,0.025000,0.025000},
-{0.156250,0.443750,0.050000,0.050000},
-{0.168750,0.443750,0.025000,0.025000},
-{0.168750,0.443750,0.050000,0.050000},
-{0.181250,0.443750,0.025000,0.025000},
-{0.181250,0.443750,0.050000,0.050000},
-{0.193750,0.443750,0.025000,0.025000},
-{0.193750,0.443750,0.050000,0.050000},
-{0.206250,0.443750,0.025000,0.025000},
-{0.206250,0.443750,0.050000,0.050000},
-{0.218750,0.443750,0.025000,0.025000},
-{0.218750,0.443750,0.050000,0.050000},
-{0.231250,0.443750,0.025000,0.025000},
-{0.231250,0.443750,0.050000,0.050000},
-{0.243750,0.443750,0.025000,0.025000},
-{0.243750,0.443750,0.050000,0.050000},
-{0.256250,0.443750,0.025000,0.025000},
-{0.256250,0.443750,0.050000,0.050000},
-{0.268750,0.443750,0.025000,0.025000},
-{0.268750,0.443750,0.050000,0.050000},
-{0.281250,0.443750,0.025000,0.025000},
-{0.281250,0.443750,0.050000,0.050000},
-{0.293750,0.443750,0.025000,0.025000},
-{0.293750,0.443750,0.050000,0.050000},
-{0.306250,0.443750,0.025000,0.025000},
-{0.306250,0.443750,0.050000,0.050000},
-{0.318750,0.443750,0.025000,0.025000},
-{0.318750,0.443750,0.050000,0.050000},
-{0.331250,0.443750,0.025000,0.025000},
-{0.331250,0.443750,0.050000,0.050000},
-{0.343750,0.443750,0.025000,0.025000},
-{0.343750,0.443750,0.050000,0.050000},
-{0.356250,0.443750,0.025000,0.025000},
-{0.356250,0.443750,0.050000,0.050000},
-{0.368750,0.443750,0.025000,0.025000},
-{0.368750,0.443750,0.050000,0.050000},
-{0.381250,0.443750,0.025000,0.025000},
-{0.381250,0.443750,0.050000,0.050000},
-{0.393750,0.443750,0.025000,0.025000},
-{0.393750,0.443750,0.050000,0.050000},
-{0.406250,0.443750,0.025000,0.025000},
-{0.406250,0.443750,0.050000,0.050000},
-{0.418750,0.443750,0.025000,0.025000},
-{0.418750,0.443750,0.050000,0.050000},
-{0.431250,0.443750,0.025000,0.025000},
-{0.431250,0.443750,0.050000,0.050000},
-{0.443750,0.443750,0.025000,0.025000},
-{0.443750,0.443750,0.050000,0.050000},
-{0.456250,0.443750,0.025000,0.025000},
-{0.456250,0.443750,0.050000,0.050000},
-{0.468750,0.443750,0.025000,0.025000},
-{0.468750,0.443750,0.050000,0.050000},
-{0.481250,0.443750,0.025000,0.025000},
-{0.481250,0.443750,0.050000,0.050000},
-{0.493750,0.443750,0.025000,0.025000},
-{0.493750,0.443750,0.050000,0.050000},
-{0.506250,0.443750,0.025000,0.025000},
-{0.506250,0.443750,0.050000,0.050000},
-{0.518750,0.443750,0.025000,0.025000},
-{0.518750,0.443750,0.050000,0.050000},
-{0.531250,0.443750,0.025000,0.025000},
-{0.531250,0.443750,0.050000,0.050000},
-{0.543750,0.443750,0.025000,0.025000},
-{0.543750,0.443750,0.050000,0.050000},
-{0.556250,0.443750,0.025000,0.025000},
-{0.556250,0.443750,0.050000,0.050000},
-{0.568750,0.443750,0.025000,0.025000},
-{0.568750,0.443750,0.050000,0.050000},
-{0.581250,0.443750,0.025000,0.025000},
-{0.581250,0.443750,0.050000,0.050000},
-{0.593750,0.443750,0.025000,0.025000},
-{0.593750,0.443750,0.050000,0.050000},
-{0.606250,0.443750,0.025000,0.025000},
-{0.606250,0.443750,0.050000,0.050000},
-{0.618750,0.443750,0.025000,0.025000},
-{0.618750,0.443750,0.050000,0.050000},
-{0.631250,0.443750,0.025000,0.025000},
-{0.631250,0.443750,0.050000,0.050000},
-{0.643750,0.443750,0.025000,0.025000},
-{0.643750,0.443750,0.050000,0.050000},
-{0.656250,0.443750,0.025000,0.025000},
-{0.656250,0.443750,0.050000,0.050000},
-{0.668750,0.443750,0.025000,0.025000},
-{0.668750,0.443750,0.050000,0.050000},
-{0.681250,0.443750,0.025000,0.025000},
-{0.681250,0.443750,0.050000,0.050000},
-{0.693750,0.443750,0.025000,0.025000},
-{0.693750,0.443750,0.050000,0.050000},
-{0.706250,0.443750,0.025000,0.025000},
-{0.706250,0.443750,0.050000,0.050000},
-{0.718750,0.443750,0.025000,0.025000},
-{0.718750,0.443750,0.050000,0.050000},
-{0.731250,0.443750,0.025000,0.025000},
-{0.731250,0.443750,0.050000,0.050000},
-{0.743750,0.443750,0.025000,0.025000},
-{0.743750,0.443750,0.050000,0.050000},
-{0.756250,0.443750,0.025000,0.025000},
-{0.756250,0.443750,0.050000,0.050000},
-{0.768750,0.443750,0.025000,0.025000},
-{0.768750,0.443750,0.050000,0.050000},
-{0.781250,0.443750,0.025000,0.025000},
-{0.781250,0.443750,0.050000,0.050000},
-{0.793750,0.443750,0.025000,0.025000},
-{0.793750,0.443750,0.050000,0.050000},
-{0.806250,0.443750,0.025000,0.025000},
-{0.806250,0.443750,0.050000,0.050000},
-{0.818750,0.443750,0.025000,0.025000},
-{0.818750,0.443750,0.050000,0.050000},
-{0.831250,0.443750,0.025000,0.025000},
-{0.831250,0.443750,0.050000,0.050000},
-{0.843750,0.443750,0.025000,0.025000},
-{0.843750,0.443750,0.050000,0.050000},
-{0.856250,0.443750,0.025000,0.025000},
-{0.856250,0.443750,0.050000,0.050000},
-{0.868750,0.443750,0.025000,0.025000},
-{0.868750,0.443750,0.050000,0.050000},
-{0.881250,0.443750,0.025000,0.025000},
-{0.881250,0.443750,0.050000,0.050000},
-{0.893750,0.443750,0.025000,0.025000},
-{0.893750,0.443750,0.050000,0.050000},
-{0.906250,0.443750,0.025000,0.025000},
-{0.906250,0.443750,0.050000,0.050000},
-{0.918750,0.443750,0.025000,0.025000},
-{0.918750,0.443750,0.050000,0.050000},
-{0.931250,0.443750,0.025000,0.025000},
-{0.931250,0.443750,0.050000,0.050000},
-{0.943750,0.443750,0.025000,0.025000},
-{0.943750,0.443750,0.050000,0.050000},
-{0.956250,0.443750,0.025000,0.025000},
-{0.956250,0.443750,0.050000,0.050000},
-{0.968750,0.443750,0.025000,0.025000},
-{0.968750,0.443750,0.050000,0.050000},
-{0.981250,0.443750,0.025000,0.025000},
-{0.981250,0.443750,0.050000,0.050000},
-{0.993750,0.443750,0.025000,0.025000},
-{0.993750,0.443750,0.050000,0.050000},
-{0.006250,0.456250,0.025000,0.025000},
-{0.006250,0.456250,0.050000,0.050000},
-{0.018750,0.456250,0.025000,0.025000},
-{0.018750,0.456250,0.050000,0.050000},
-{0.031250,0.456250,0.025000,0.025000},
-{0.031250,0.456250,0.050000,0.050000},
-{0.043750,0.456250,0.025000,0.025000},
-{0.043750,0.456250,0.050000,0.050000},
-{0.056250,0.456250,0.025000,0.025000},
-{0.056250,0.456250,0.050000,0.050000},
-{0.068750,0.456250,0.025000,0.025000},
-{0.068750,0.456250,0.050000,0.050000},
-{0.081250,0.456250,0.025000,0.025000},
-{0.081250,0.456250,0.050000,0.050000},
-{0.093750,0.456250,0.025000,0.025000},
-{0.093750,0.456250,0.050000,0.050000},
-{0.106250,0.456250,0.025000,0.025000},
-{0.106250,0.456250,0.050000,0.050000},
-{0.118750,0.456250,0.025000,0.025000},
-{0.118750,0.456250,0.050000,0.050000},
-{0.131250,0.456250,0.025000,0.025000},
-{0.131250,0.456250,0.050000,0.050000},
-{0.143750,0.456250,0.025000,0.025000},
-{0.143750,0.456250,0.050000,0.050000},
-{0.156250,0.456250,0.025000,0.025000},
-{0.156250,0.456250,0.050000,0.050000},
-{0.168750,0.456250,0.025000,0.025000},
-{0.168750,0.456250,0.050000,0.050000},
-{0.181250,0.456250,0.025000,0.025000},
-{0.181250,0.456250,0.050000,0.050000},
-{0.193750,0.456250,0.025000,0.025000},
-{0.193750,0.456250,0.050000,0.050000},
-{0.206250,0.456250,0.025000,0.025000},
-{0.206250,0.456250,0.050000,0.050000},
-{0.218750,0.456250,0.025000,0.025000},
-{0.218750,0.456250,0.050000,0.050000},
-{0.231250,0.456250,0.025000,0.025000},
-{0.231250,0.456250,0.050000,0.050000},
-{0.243750,0.456250,0.025000,0.025000},
-{0.243750,0.456250,0.050000,0.050000},
-{0.256250,0.456250,0.025000,0.025000},
-{0.256250,0.456250,0.050000,0.050000},
-{0.268750,0.456250,0.025000,0.025000},
-{0.268750,0.456250,0.050000,0.050000},
-{0.281250,0.456250,0.025000,0.025000},
-{0.281250,0.456250,0.050000,0.050000},
-{0.293750,0.456250,0.025000,0.025000},
-{0.293750,0.456250,0.050000,0.050000},
-{0.306250,0.456250,0.025000,0.025000},
-{0.306250,0.456250,0.050000,0.050000},
-{0.318750,0.456250,0.025000,0.025000},
-{0.318750,0.456250,0.050000,0.050000},
-{0.331250,0.456250,0.025000,0.025000},
-{0.331250,0.456250,0.050000,0.050000},
-{0.343750,0.456250,0.025000,0.025000},
-{0.343750,0.456250,0.050000,0.050000},
-{0.356250,0.456250,0.025000,0.025000},
-{0.356250,0.456250,0.050000,0.050000},
-{0.368750,0.456250,0.025000,0.025000},
-{0.368750,0.456250,0.050000,0.050000},
-{0.381250,0.456250,0.025000,0.025000},
-{0.381250,0.456250,0.050000,0.050000},
-{0.393750,0.456250,0.025000,0.025000},
-{0.393750,0.456250,0.050000,0.050000},
-{0.406250,0.456250,0.025000,0.025000},
-{0.406250,0.456250,0.050000,0.050000},
-{0.418750,0.456250,0.025000,0.025000},
-{0.418750,0.456250,0.050000,0.050000},
-{0.431250,0.456250,0.025000,0.025000},
-{0.431250,0.456250,0.050000,0.050000},
-{0.443750,0.456250,0.025000,0.025000},
-{0.443750,0.456250,0.050000,0.050000},
-{0.456250,0.456250,0.025000,0.025000},
-{0.456250,0.456250,0.050000,0.050000},
-{0.468750,0.456250,0.025000,0.025000},
-{0.468750,0.456250,0.050000,0.050000},
-{0.481250,0.456250,0.025000,0.025000},
-{0.481250,0.456250,0.050000,0.050000},
-{0.493750,0.456250,0.025000,0.025000},
-{0.493750,0.456250,0.050000,0.050000},
-{0.506250,0.456250,0.025000,0.025000},
-{0.506250,0.456250,0.050000,0.050000},
-{0.518750,0.456250,0.025000,0.025000},
-{0.518750,0.456250,0.050000,0.050000},
-{0.531250,0.456250,0.025000,0.025000},
-{0.531250,0.456250,0.050000,0.050000},
-{0.543750,0.456250,0.025000,0.025000},
-{0.543750,0.456250,0.050000,0.050000},
-{0.556250,0.456250,0.025000,0.025000},
-{0.556250,0.456250,0.050000,0.050000},
-{0.568750,0.456250,0.025000,0.025000},
-{0.568750,0.456250,0.050000,0.050000},
-{0.581250,0.456250,0.025000,0.025000},
-{0.581250,0.456250,0.050000,0.050000},
-{0.593750,0.456250,0.025000,0.025000},
-{0.593750,0.456250,0.050000,0.050000},
-{0.606250,0.456250,0.025000,0.025000},
-{0.606250,0.456250,0.050000,0.050000},
-{0.618750,0.456250,0.025000,0.025000},
-{0.618750,0.456250,0.050000,0.050000},
-{0.631250,0.456250,0.025000,0.025000},
-{0.631250,0.456250,0.050000,0.050000},
-{0.643750,0.456250,0.025000,0.025000},
-{0.643750,0.456250,0.050000,0.050000},
-{0.656250,0.456250,0.025000,0.025000},
-{0.656250,0.456250,0.050000,0.050000},
-{0.668750,0.456250,0.025000,0.025000},
-{0.668750,0.456250,0.050000,0.050000},
-{0.681250,0.456250,0.025000,0.025000},
-{0.681250,0.456250,0.050000,0.050000},
-{0.693750,0.456250,0.025000,0.025000},
-{0.693750,0.456250,0.050000,0.050000},
-{0.706250,0.456250,0.025000,0.025000},
-{0.706250,0.456250,0.050000,0.050000},
-{0.718750,0.456250,0.025000,0.025000},
-{0.718750,0.456250,0.050000,0.050000},
-{0.731250,0.456250,0.025000,0.025000},
-{0.731250,0.456250,0.050000,0.050000},
-{0.743750,0.456250,0.025000,0.025000},
-{0.743750,0.456250,0.050000,0.050000},
-{0.756250,0.456250,0.025000,0.025000},
-{0.756250,0.456250,0.050000,0.050000},
-{0.768750,0.456250,0.025000,0.025000},
-{0.768750,0.456250,0.050000,0.050000},
-{0.781250,0.456250,0.025000,0.025000},
-{0.781250,0.456250,0.050000,0.050000},
-{0.793750,0.456250,0.025000,0.025000},
-{0.793750,0.456250,0.050000,0.050000},
-{0.806250,0.456250,0.025000,0.025000},
-{0.806250,0.456250,0.050000,0.050000},
-{0.818750,0.456250,0.025000,0.025000},
-{0.818750,0.456250,0.050000,0.050000},
-{0.831250,0.456250,0.025000,0.025000},
-{0.831250,0.456250,0.050000,0.050000},
-{0.843750,0.456250,0.025000,0.025000},
-{0.843750,0.456250,0.050000,0.050000},
-{0.856250,0.456250,0.025000,0.025000},
-{0.856250,0.456250,0.050000,0.050000},
-{0.868750,0.456250,0.025000,0.025000},
-{0.868750,0.456250,0.050000,0.050000},
-{0.881250,0.456250,0.025000,0.025000},
-{0.881250,0.456250,0.050000,0.050000},
-{0.893750,0.456250,0.025000,0.025000},
-{0.893750,0.456250,0.050000,0.050000},
-{0.906250,0.456250,0.025000,0.025000},
-{0.906250,0.456250,0.050000,0.050000},
-{0.918750,0.456250,0.025000,0.025000},
-{0.918750,0.456250,0.050000,0.050000},
-{0.931250,0.456250,0.025000,0.025000},
-{0.931250,0.456250,0.050000,0.050000},
-{0.943750,0.456250,0.025000,0.025000},
-{0.943750,0.456250,0.050000,0.050000},
-{0.956250,0.456250,0.025000,0.025000},
-{0.956250,0.456250,0.050000,0.050000},
-{0.968750,0.456250,0.025000,0.025000},
-{0.968750,0.456250,0.050000,0.050000},
-{0.981250,0.456250,0.025000,0.025000},
-{0.981250,0.456250,0.050000,0.050000},
-{0.993750,0.456250,0.025000,0.025000},
-{0.993750,0.456250,0.050000,0.050000},
-{0.006250,0.468750,0.025000,0.025000},
-{0.006250,0.468750,0.050000,0.050000},
-{0.018750,0.468750,0.025000,0.025000},
-{0.018750,0.468750,0.050000,0.050000},
-{0.031250,0.468750,0.025000,0.025000},
-{0.031250,0.468750,0.050000,0.050000},
-{0.043750,0.468750,0.025000,0.025000},
-{0.043750,0.468750,0.050000,0.050000},
-{0.056250,0.468750,0.025000,0.025000},
-{0.056250,0.468750,0.050000,0.050000},
-{0.068750,0.468750,0.025000,0.025000},
-{0.068750,0.468750,0.050000,0.050000},
-{0.081250,0.468750,0.025000,0.025000},
-{0.081250,0.468750,0.050000,0.050000},
-{0.093750,0.468750,0.025000,0.025000},
-{0.093750,0.468750,0.050000,0.050000},
-{0.106250,0.468750,0.025000,0.025000},
-{0.106250,0.468750,0.050000,0.050000},
-{0.118750,0.468750,0.025000,0.025000},
-{0.118750,0.468750,0.050000,0.050000},
-{0.131250,0.468750,0.025000,0.025000},
-{0.131250,0.468750,0.050000,0.050000},
-{0.143750,0.468750,0.025000,0.025000},
-{0.143750,0.468750,0.050000,0.050000},
-{0.156250,0.468750,0.025000,0.025000},
-{0.156250,0.468750,0.050000,0.050000},
-{0.168750,0.468750,0.025000,0.025000},
-{0.168750,0.468750,0.050000,0.050000},
-{0.181250,0.468750,0.025000,0.025000},
-{0.181250,0.468750,0.050000,0.050000},
-{0.193750,0.468750,0.025000,0.025000},
-{0.193750,0.468750,0.050000,0.050000},
-{0.206250,0.468750,0.025000,0.025000},
-{0.206250,0.468750,0.050000,0.050000},
-{0.218750,0.468750,0.025000,0.025000},
-{0.218750,0.468750,0.050000,0.050000},
-{0.231250,0.468750,0.025000,0.025000},
-{0.231250,0.468750,0.050000,0.050000},
-{0.243750,0.468750,0.025000,0.025000},
-{0.243750,0.468750,0.050000,0.050000},
-{0.256250,0.468750,0.025000,0.025000},
-{0.256250,0.468750,0.050000,0.050000},
-{0.268750,0.468750,0.025000,0.025000},
-{0.268750,0.468750,0.050000,0.050000},
-{0.281250,0.468750,0.025000,0.025000},
-{0.281250,0.468750,0.050000,0.050000},
-{0.293750,0.468750,0.025000,0.025000},
-{0.293750,0.468750,0.050000,0.050000},
-{0.306250,0.468750,0.025000,0.025000},
-{0.306250,0.468750,0.050000,0.050000},
-{0.318750,0.468750,0.025000,0.025000},
-{0.318750,0.468750,0.050000,0.050000},
-{0.331250,0.468750,0.025000,0.025000},
-{0.331250,0.468750,0.050000,0.050000},
-{0.343750,0.468750,0.025000,0.025000},
-{0.343750,0.468750,0.050000,0.050000},
-{0.356250,0.468750,0.025000,0.025000},
-{0.356250,0.468750,0.050000,0.050000},
-{0.368750,0.468750,0.025000,0.025000},
-{0.368750,0.468750,0.050000,0.050000},
-{0.381250,0.468750,0.025000,0.025000},
-{0.381250,0.468750,0.050000,0.050000},
-{0.393750,0.468750,0.025000,0.025000},
-{0.393750,0.468750,0.050000,0.050000},
-{0.406250,0.468750,0.025000,0.025000},
-{0.406250,0.468750,0.050000,0.050000},
-{0.418750,0.468750,0.025000,0.025000},
-{0.418750,0.468750,0.050000,0.050000},
-{0.431250,0.468750,0.025000,0.025000},
-{0.431250,0.468750,0.050000,0.050000},
-{0.443750,0.468750,0.025000,0.025000},
-{0.443750,0.468750,0.050000,0.050000},
-{0.456250,0.468750,0.025000,0.025000},
-{0.456250,0.468750,0.050000,0.050000},
-{0.468750,0.468750,0.025000,0.025000},
-{0.468750,0.468750,0.050000,0.050000},
-{0.481250,0.468750,0.025000,0.025000},
-{0.481250,0.468750,0.050000,0.050000},
-{0.493750,0.468750,0.025000,0.025000},
-{0.493750,0.468750,0.050000,0.050000},
-{0.506250,0.468750,0.025000,0.025000},
-{0.506250,0.468750,0.050000,0.050000},
-{0.518750,0.468750,0.025000,0.025000},
-{0.518750,0.468750,0.050000,0.050000},
-{0.531250,0.468750,0.025000,0.025000},
-{0.531250,0.468750,0.050000,0.050000},
-{0.543750,0.468750,0.025000,0.025000},
-{0.543750,0.468750,0.050000,0.050000},
-{0.556250,0.468750,0.025000,0.025000},
-{0.556250,0.468750,0.050000,0.050000},
-{0.568750,0.468750,0.025000,0.025000},
-{0.568750,0.468750,0.050000,0.050000},
-{0.581250,0.468750,0.025000,0.025000},
-{0.581250,0.468750,0.050000,0.050000},
-{0.593750,0.468750,0.025000,0.025000},
-{0.593750,0.468750,0.050000,0.050000},
-{0.606250,0.468750,0.025000,0.025000},
-{0.606250,0.468750,0.050000,0.050000},
-{0.618750,0.468750,0.025000,0.025000},
-{0.618750,0.468750,0.050000,0.050000},
-{0.631250,0.468750,0.025000,0.025000},
-{0.631250,0.468750,0.050000,0.050000},
-{0.643750,0.468750,0.025000,0.025000},
-{0.643750,0.468750,0.050000,0.050000},
-{0.656250,0.468750,0.025000,0.025000},
-{0.656250,0.468750,0.050000,0.050000},
-{0.668750,0.468750,0.025000,0.025000},
-{0.668750,0.468750,0.050000,0.050000},
-{0.681250,0.468750,0.025000,0.025000},
-{0.681250,0.468750,0.050000,0.050000},
-{0.693750,0.468750,0.025000,0.025000},
-{0.693750,0.468750,0.050000,0.050000},
-{0.706250,0.468750,0.025000,0.025000},
-{0.706250,0.468750,0.050000,0.050000},
-{0.718750,0.468750,0.025000,0.025000},
-{0.718750,0.468750,0.050000,0.050000},
-{0.731250,0.468750,0.025000,0.025000},
-{0.731250,0.468750,0.050000,0.050000},
-{0.743750,0.468750,0.025000,0.025000},
-{0.743750,0.468750,0.050000,0.050000},
-{0.756250,0.468750,0.025000,0.025000},
-{0.756250,0.468750,0.050000,0.050000},
-{0.768750,0.468750,0.025000,0.025000},
-{0.768750,0.468750,0.050000,0.050000},
-{0.781250,0.468750,0.025000,0.025000},
-{0.781250,0.468750,0.050000,0.050000},
-{0.793750,0.468750,0.025000,0.025000},
-{0.793750,0.468750,0.050000,0.050000},
-{0.806250,0.468750,0.025000,0.025000},
-{0.806250,0.468750,0.050000,0.050000},
-{0.818750,0.468750,0.025000,0.025000},
-{0.818750,0.468750,0.050000,0.050000},
-{0.831250,0.468750,0.025000,0.025000},
-{0.831250,0.468750,0.050000,0.050000},
-{0.843750,0.468750,0.025000,0.025000},
-{0.843750,0.468750,0.050000,0.050000},
-{0.856250,0.468750,0.025000,0.025000},
-{0.856250,0.468750,0.050000,0.050000},
-{0.868750,0.468750,0.025000,0.025000},
-{0.868750,0.468750,0.050000,0.050000},
-{0.881250,0.468750,0.025000,0.025000},
-{0.881250,0.468750,0.050000,0.050000},
-{0.893750,0.468750,0.025000,0.025000},
-{0.893750,0.468750,0.050000,0.050000},
-{0.906250,0.468750,0.025000,0.025000},
-{0.906250,0.468750,0.050000,0.050000},
-{0.918750,0.468750,0.025000,0.025000},
-{0.918750,0.468750,0.050000,0.050000},
-{0.931250,0.468750,0.025000,0.025000},
-{0.931250,0.468750,0.050000,0.050000},
-{0.943750,0.468750,0.025000,0.025000},
-{0.943750,0.468750,0.050000,0.050000},
-{0.956250,0.468750,0.025000,0.025000},
-{0.956250,0.468750,0.050000,0.050000},
-{0.968750,0.468750,0.025000,0.025000},
-{0.968750,0.468750,0.050000,0.050000},
-{0.981250,0.468750,0.025000,0.025000},
-{0.981250,0.468750,0.050000,0.050000},
-{0.993750,0.468750,0.025000,0.025000},
-{0.993750,0.468750,0.050000,0.050000},
-{0.006250,0.481250,0.025000,0.025000},
-{0.006250,0.481250,0.050000,0.050000},
-{0.018750,0.481250,0.025000,0.025000},
-{0.018750,0.481250,0.050000,0.050000},
-{0.031250,0.481250,0.025000,0.025000},
-{0.031250,0.481250,0.050000,0.050000},
-{0.043750,0.481250,0.025000,0.025000},
-{0.043750,0.481250,0.050000,0.050000},
-{0.056250,0.481250,0.025000,0.025000},
-{0.056250,0.481250,0.050000,0.050000},
-{0.068750,0.481250,0.025000,0.025000},
-{0.068750,0.481250,0.050000,0.050000},
-{0.081250,0.481250,0.025000,0.025000},
-{0.081250,0.481250,0.050000,0.050000},
-{0.093750,0.481250,0.025000,0.025000},
-{0.093750,0.481250,0.050000,0.050000},
-{0.106250,0.481250,0.025000,0.025000},
-{0.106250,0.481250,0.050000,0.050000},
-{0.118750,0.481250,0.025000,0.025000},
-{0.118750,0.481250,0.050000,0.050000},
-{0.131250,0.481250,0.025000,0.025000},
-{0.131250,0.481250,0.050000,0.050000},
-{0.143750,0.481250,0.025000,0.025000},
-{0.143750,0.481250,0.050000,0.050000},
-{0.156250,0.481250,0.025000,0.025000},
-{0.156250,0.481250,0.050000,0.050000},
-{0.168750,0.481250,0.025000,0.025000},
-{0.168750,0.481250,0.050000,0.050000},
-{0.181250,0.481250,0.025000,0.025000},
-{0.181250,0.481250,0.050000,0.050000},
-{0.193750,0.481250,0.025000,0.025000},
-{0.193750,0.481250,0.050000,0.050000},
-{0.206250,0.481250,0.025000,0.025000},
-{0.206250,0.481250,0.050000,0.050000},
-{0.218750,0.481250,0.025000,0.025000},
-{0.218750,0.481250,0.050000,0.050000},
-{0.231250,0.481250,0.025000,0.025000},
-{0.231250,0.481250,0.050000,0.050000},
-{0.243750,0.481250,0.025000,0.025000},
-{0.243750,0.481250,0.050000,0.050000},
-{0.256250,0.481250,0.025000,0.025000},
-{0.256250,0.481250,0.050000,0.050000},
-{0.268750,0.481250,0.025000,0.025000},
-{0.268750,0.481250,0.050000,0.050000},
-{0.281250,0.481250,0.025000,0.025000},
-{0.281250,0.481250,0.050000,0.050000},
-{0.293750,0.481250,0.025000,0.025000},
-{0.293750,0.481250,0.050000,0.050000},
-{0.306250,0.481250,0.025000,0.025000},
-{0.306250,0.481250,0.050000,0.050000},
-{0.318750,0.481250,0.025000,0.025000},
-{0.318750,0.481250,0.050000,0.050000},
-{0.331250,0.481250,0.025000,0.025000},
-{0.331250,0.481250,0.050000,0.050000},
-{0.343750,0.481250,0.025000,0.025000},
-{0.343750,0.481250,0.050000,0.050000},
-{0.356250,0.481250,0.025000,0.025000},
-{0.356250,0.481250,0.050000,0.050000},
-{0.368750,0.481250,0.025000,0.025000},
-{0.368750,0.481250,0.050000,0.050000},
-{0.381250,0.481250,0.025000,0.025000},
-{0.381250,0.481250,0.050000,0.050000},
-{0.393750,0.481250,0.025000,0.025000},
-{0.393750,0.481250,0.050000,0.050000},
-{0.406250,0.481250,0.025000,0.025000},
-{0.406250,0.481250,0.050000,0.050000},
-{0.418750,0.481250,0.025000,0.025000},
-{0.418750,0.481250,0.050000,0.050000},
-{0.431250,0.481250,0.025000,0.025000},
-{0.431250,0.481250,0.050000,0.050000},
-{0.443750,0.481250,0.025000,0.025000},
-{0.443750,0.481250,0.050000,0.050000},
-{0.456250,0.481250,0.025000,0.025000},
-{0.456250,0.481250,0.050000,0.050000},
-{0.468750,0.481250,0.025000,0.025000},
-{0.468750,0.481250,0.050000,0.050000},
-{0.481250,0.481250,0.025000,0.025000},
-{0.481250,0.481250,0.050000,0.050000},
-{0.493750,0.481250,0.025000,0.025000},
-{0.493750,0.481250,0.050000,0.050000},
-{0.506250,0.481250,0.025000,0.025000},
-{0.506250,0.481250,0.050000,0.050000},
-{0.518750,0.481250,0.025000,0.025000},
-{0.518750,0.481250,0.050000,0.050000},
-{0.531250,0.481250,0.025000,0.025000},
-{0.531250,0.481250,0.050000,0.050000},
-{0.543750,0.481250,0.025000,0.025000},
-{0.543750,0.481250,0.050000,0.050000},
-{0.556250,0.481250,0.025000,0.025000},
-{0.556250,0.481250,0.050000,0.050000},
-{0.568750,0.481250,0.025000,0.025000},
-{0.568750,0.481250,0.050000,0.050000},
-{0.581250,0.481250,0.025000,0.025000},
-{0.581250,0.481250,0.050000,0.050000},
-{0.593750,0.481250,0.025000,0.025000},
-{0.593750,0.481250,0.050000,0.050000},
-{0.606250,0.481250,0.025000,0.025000},
-{0.606250,0.481250,0.050000,0.050000},
-{0.618750,0.481250,0.025000,0.025000},
-{0.618750,0.481250,0.050000,0.050000},
-{0.631250,0.481250,0.025000,0.025000},
-{0.631250,0.481250,0.050000,0.050000},
-{0.643750,0.481250,0.025000,0.025000},
-{0.643750,0.481250,0.050000,0.050000},
-{0.656250,0.481250,0.025000,0.025000},
-{0.656250,0.481250,0.050000,0.050000},
-{0.668750,0.481250,0.025000,0.025000},
-{0.668750,0.481250,0.050000,0.050000},
-{0.681250,0.481250,0.025000,0.025000},
-{0.681250,0.481250,0.050000,0.050000},
-{0.693750,0.481250,0.025000,0.025000},
-{0.693750,0.481250,0.050000,0.050000},
-{0.706250,0.481250,0.025000,0.025000},
-{0.706250,0.481250,0.050000,0.050000},
-{0.718750,0.481250,0.025000,0.025000},
-{0.718750,0.481250,0.050000,0.050000},
-{0.731250,0.481250,0.025000,0.025000},
-{0.731250,0.481250,0.050000,0.050000},
-{0.743750,0.481250,0.025000,0.025000},
-{0.743750,0.481250,0.050000,0.050000},
-{0.756250,0.481250,0.025000,0.025000},
-{0.756250,0.481250,0.050000,0.050000},
-{0.768750,0.481250,0.025000,0.025000},
-{0.768750,0.481250,0.050000,0.050000},
-{0.781250,0.481250,0.025000,0.025000},
-{0.781250,0.481250,0.050000,0.050000},
-{0.793750,0.481250,0.025000,0.025000},
-{0.793750,0.481250,0.050000,0.050000},
-{0.806250,0.481250,0.025000,0.025000},
-{0.806250,0.481250,0.050000,0.050000},
-{0.818750,0.481250,0.025000,0.025000},
-{0.818750,0.481250,0.050000,0.050000},
-{0.831250,0.481250,0.025000,0.025000},
-{0.831250,0.481250,0.050000,0.050000},
-{0.843750,0.481250,0.025000,0.025000},
-{0.843750,0.481250,0.050000,0.050000},
-{0.856250,0.481250,0.025000,0.025000},
-{0.856250,0.481250,0.050000,0.050000},
-{0.868750,0.481250,0.025000,0.025000},
-{0.868750,0.481250,0.050000,0.050000},
-{0.881250,0.481250,0.025000,0.025000},
-{0.881250,0.481250,0.050000,0.050000},
-{0.893750,0.481250,0.025000,0.025000},
-{0.893750,0.481250,0.050000,0.050000},
-{0.906250,0.481250,0.025000,0.025000},
-{0.906250,0.481250,0.050000,0.050000},
-{0.918750,0.481250,0.025000,0.025000},
-{0.918750,0.481250,0.050000,0.050000},
-{0.931250,0.481250,0.025000,0.025000},
-{0.931250,0.481250,0.050000,0.050000},
-{0.943750,0.481250,0.025000,0.025000},
-{0.943750,0.481250,0.050000,0.050000},
-{0.956250,0.481250,0.025000,0.025000},
-{0.956250,0.481250,0.050000,0.050000},
-{0.968750,0.481250,0.025000,0.025000},
-{0.968750,0.481250,0.050000,0.050000},
-{0.981250,0.481250,0.025000,0.025000},
-{0.981250,0.481250,0.050000,0.050000},
-{0.993750,0.481250,0.025000,0.025000},
-{0.993750,0.481250,0.050000,0.050000},
-{0.006250,0.493750,0.025000,0.025000},
-{0.006250,0.493750,0.050000,0.050000},
-{0.018750,0.493750,0.025000,0.025000},
-{0.018750,0.493750,0.050000,0.050000},
-{0.031250,0.493750,0.025000,0.025000},
-{0.031250,0.493750,0.050000,0.050000},
-{0.043750,0.493750,0.025000,0.025000},
-{0.043750,0.493750,0.050000,0.050000},
-{0.056250,0.493750,0.025000,0.025000},
-{0.056250,0.493750,0.050000,0.050000},
-{0.068750,0.493750,0.025000,0.025000},
-{0.068750,0.493750,0.050000,0.050000},
-{0.081250,0.493750,0.025000,0.025000},
-{0.081250,0.493750,0.050000,0.050000},
-{0.093750,0.493750,0.025000,0.025000},
-{0.093750,0.493750,0.050000,0.050000},
-{0.106250,0.493750,0.025000,0.025000},
-{0.106250,0.493750,0.050000,0.050000},
-{0.118750,0.493750,0.025000,0.025000},
-{0.118750,0.493750,0.050000,0.050000},
-{0.131250,0.493750,0.025000,0.025000},
-{0.131250,0.493750,0.050000,0.050000},
-{0.143750,0.493750,0.025000,0.025000},
-{0.143750,0.493750,0.050000,0.050000},
-{0.156250,0.493750,0.025000,0.025000},
-{0.156250,0.493750,0.050000,0.050000},
-{0.168750,0.493750,0.025000,0.025000},
-{0.168750,0.493750,0.050000,0.050000},
-{0.181250,0.493750,0.025000,0.025000},
-{0.181250,0.493750,0.050000,0.050000},
-{0.193750,0.493750,0.025000,0.025000},
-{0.193750,0.493750,0.050000,0.050000},
-{0.206250,0.493750,0.025000,0.025000},
-{0.206250,0.493750,0.050000,0.050000},
-{0.218750,0.493750,0.025000,0.025000},
-{0.218750,0.493750,0.050000,0.050000},
-{0.231250,0.493750,0.025000,0.025000},
-{0.231250,0.493750,0.050000,0.050000},
-{0.243750,0.493750,0.025000,0.025000},
-{0.243750,0.493750,0.050000,0.050000},
-{0.256250,0.493750,0.025000,0.025000},
-{0.256250,0.493750,0.050000,0.050000},
-{0.268750,0.493750,0.025000,0.025000},
-{0.268750,0.493750,0.050000,0.050000},
-{0.281250,0.493750,0.025000,0.025000},
-{0.281250,0.493750,0.050000,0.050000},
-{0.293750,0.493750,0.025000,0.025000},
-{0.293750,0.493750,0.050000,0.050000},
-{0.306250,0.493750,0.025000,0.025000},
-{0.306250,0.493750,0.050000,0.050000},
-{0.318750,0.493750,0.025000,0.025000},
-{0.318750,0.493750,0.050000,0.050000},
-{0.331250,0.493750,0.025000,0.025000},
-{0.331250,0.493750,0.050000,0.050000},
-{0.343750,0.493750,0.025000,0.025000},
-{0.343750,0.493750,0.050000,0.050000},
-{0.356250,0.493750,0.025000,0.025000},
-{0.356250,0.493750,0.050000,0.050000},
-{0.368750,0.493750,0.025000,0.025000},
-{0.368750,0.493750,0.050000,0.050000},
-{0.381250,0.493750,0.025000,0.025000},
-{0.381250,0.493750,0.050000,0.050000},
-{0.393750,0.493750,0.025000,0.025000},
-{0.393750,0.493750,0.050000,0.050000},
-{0.406250,0.493750,0.025000,0.025000},
-{0.406250,0.493750,0.050000,0.050000},
-{0.418750,0.493750,0.025000,0.025000},
-{0.418750,0.493750,0.050000,0.050000},
-{0.431250,0.493750,0.025000,0.025000},
-{0.431250,0.493750,0.050000,0.050000},
-{0.443750,0.493750,0.025000,0.025000},
-{0.443750,0.493750,0.050000,0.050000},
-{0.456250,0.493750,0.025000,0.025000},
-{0.456250,0.493750,0.050000,0.050000},
-{0.468750,0.493750,0.025000,0.025000},
-{0.468750,0.493750,0.050000,0.050000},
-{0.481250,0.493750,0.025000,0.025000},
-{0.481250,0.493750,0.050000,0.050000},
-{0.493750,0.493750,0.025000,0.025000},
-{0.493750,0.493750,0.050000,0.050000},
-{0.506250,0.493750,0.025000,0.025000},
-{0.506250,0.493750,0.050000,0.050000},
-{0.518750,0.493750,0.025000,0.025000},
-{0.518750,0.493750,0.050000,0.050000},
-{0.531250,0.493750,0.025000,0.025000},
-{0.531250,0.493750,0.050000,0.050000},
-{0.543750,0.493750,0.025000,0.025000},
-{0.543750,0.493750,0.050000,0.050000},
-{0.556250,0.493750,0.025000,0.025000},
-{0.556250,0.493750,0.050000,0.050000},
-{0.568750,0.493750,0.025000,0.025000},
-{0.568750,0.493750,0.050000,0.050000},
-{0.581250,0.493750,0.025000,0.025000},
-{0.581250,0.493750,0.050000,0.050000},
-{0.593750,0.493750,0.025000,0.025000},
-{0.593750,0.493750,0.050000,0.050000},
-{0.606250,0.493750,0.025000,0.025000},
-{0.606250,0.493750,0.050000,0.050000},
-{0.618750,0.493750,0.025000,0.025000},
-{0.618750,0.493750,0.050000,0.050000},
-{0.631250,0.493750,0.025000,0.025000},
-{0.631250,0.493750,0.050000,0.050000},
-{0.643750,0.493750,0.025000,0.025000},
-{0.643750,0.493750,0.050000,0.050000},
-{0.656250,0.493750,0.025000,0.025000},
-{0.656250,0.493750,0.050000,0.050000},
-{0.668750,0.493750,0.025000,0.025000},
-{0.668750,0.493750,0.050000,0.050000},
-{0.681250,0.493750,0.025000,0.025000},
-{0.681250,0.493750,0.050000,0.050000},
-{0.693750,0.493750,0.025000,0.025000},
-{0.693750,0.493750,0.050000,0.050000},
-{0.706250,0.493750,0.025000,0.025000},
-{0.706250,0.493750,0.050000,0.050000},
-{0.718750,0.493750,0.025000,0.025000},
-{0.718750,0.493750,0.050000,0.050000},
-{0.731250,0.493750,0.025000,0.025000},
-{0.731250,0.493750,0.050000,0.050000},
-{0.743750,0.493750,0.025000,0.025000},
-{0.743750,0.493750,0.050000,0.050000},
-{0.756250,0.493750,0.025000,0.025000},
-{0.756250,0.493750,0.050000,0.050000},
-{0.768750,0.493750,0.025000,0.025000},
-{0.768750,0.493750,0.050000,0.050000},
-{0.781250,0.493750,0.025000,0.025000},
-{0.781250,0.493750,0.050000,0.050000},
-{0.793750,0.493750,0.025000,0.025000},
-{0.793750,0.493750,0.050000,0.050000},
-{0.806250,0.493750,0.025000,0.025000},
-{0.806250,0.493750,0.050000,0.050000},
-{0.818750,0.493750,0.025000,0.025000},
-{0.818750,0.493750,0.050000,0.050000},
-{0.831250,0.493750,0.025000,0.025000},
-{0.831250,0.493750,0.050000,0.050000},
-{0.843750,0.493750,0.025000,0.025000},
-{0.843750,0.493750,0.050000,0.050000},
-{0.856250,0.493750,0.025000,0.025000},
-{0.856250,0.493750,0.050000,0.050000},
-{0.868750,0.493750,0.025000,0.025000},
-{0.868750,0.493750,0.050000,0.050000},
-{0.881250,0.493750,0.025000,0.025000},
-{0.881250,0.493750,0.050000,0.050000},
-{0.893750,0.493750,0.025000,0.025000},
-{0.893750,0.493750,0.050000,0.050000},
-{0.906250,0.493750,0.025000,0.025000},
-{0.906250,0.493750,0.050000,0.050000},
-{0.918750,0.493750,0.025000,0.025000},
-{0.918750,0.493750,0.050000,0.050000},
-{0.931250,0.493750,0.025000,0.025000},
-{0.931250,0.493750,0.050000,0.050000},
-{0.943750,0.493750,0.025000,0.025000},
-{0.943750,0.493750,0.050000,0.050000},
-{0.956250,0.493750,0.025000,0.025000},
-{0.956250,0.493750,0.050000,0.050000},
-{0.968750,0.493750,0.025000,0.025000},
-{0.968750,0.493750,0.050000,0.050000},
-{0.981250,0.493750,0.025000,0.025000},
-{0.981250,0.493750,0.050000,0.050000},
-{0.993750,0.493750,0.025000,0.025000},
-{0.993750,0.493750,0.050000,0.050000},
-{0.006250,0.506250,0.025000,0.025000},
-{0.006250,0.506250,0.050000,0.050000},
-{0.018750,0.506250,0.025000,0.025000},
-{0.018750,0.506250,0.050000,0.050000},
-{0.031250,0.506250,0.025000,0.025000},
-{0.031250,0.506250,0.050000,0.050000},
-{0.043750,0.506250,0.025000,0.025000},
-{0.043750,0.506250,0.050000,0.050000},
-{0.056250,0.506250,0.025000,0.025000},
-{0.056250,0.506250,0.050000,0.050000},
-{0.068750,0.506250,0.025000,0.025000},
-{0.068750,0.506250,0.050000,0.050000},
-{0.081250,0.506250,0.025000,0.025000},
-{0.081250,0.506250,0.050000,0.050000},
-{0.093750,0.506250,0.025000,0.025000},
-{0.093750,0.506250,0.050000,0.050000},
-{0.106250,0.506250,0.025000,0.025000},
-{0.106250,0.506250,0.050000,0.050000},
-{0.118750,0.506250,0.025000,0.025000},
-{0.118750,0.506250,0.050000,0.050000},
-{0.131250,0.506250,0.025000,0.025000},
-{0.131250,0.506250,0.050000,0.050000},
-{0.143750,0.506250,0.025000,0.025000},
-{0.143750,0.506250,0.050000,0.050000},
-{0.156250,0.506250,0.025000,0.025000},
-{0.156250,0.506250,0.050000,0.050000},
-{0.168750,0.506250,0.025000,0.025000},
-{0.168750,0.506250,0.050000,0.050000},
-{0.181250,0.506250,0.025000,0.025000},
-{0.181250,0.506250,0.050000,0.050000},
-{0.193750,0.506250,0.025000,0.025000},
-{0.193750,0.506250,0.050000,0.050000},
-{0.206250,0.506250,0.025000,0.025000},
-{0.206250,0.506250,0.050000,0.050000},
-{0.218750,0.506250,0.025000,0.025000},
-{0.218750,0.506250,0.050000,0.050000},
-{0.231250,0.506250,0.025000,0.025000},
-{0.231250,0.506250,0.050000,0.050000},
-{0.243750,0.506250,0.025000,0.025000},
-{0.243750,0.506250,0.050000,0.050000},
-{0.256250,0.506250,0.025000,0.025000},
-{0.256250,0.506250,0.050000,0.050000},
-{0.268750,0.506250,0.025000,0.025000},
-{0.268750,0.506250,0.050000,0.050000},
-{0.281250,0.506250,0.025000,0.025000},
-{0.281250,0.506250,0.050000,0.050000},
-{0.293750,0.506250,0.025000,0.025000},
-{0.293750,0.506250,0.050000,0.050000},
-{0.306250,0.506250,0.025000,0.025000},
-{0.306250,0.506250,0.050000,0.050000},
-{0.318750,0.506250,0.025000,0.025000},
-{0.318750,0.506250,0.050000,0.050000},
-{0.331250,0.506250,0.025000,0.025000},
-{0.331250,0.506250,0.050000,0.050000},
-{0.343750,0.506250,0.025000,0.025000},
-{0.343750,0.506250,0.050000,0.050000},
-{0.356250,0.506250,0.025000,0.025000},
-{0.356250,0.506250,0.050000,0.050000},
-{0.368750,0.506250,0.025000,0.025000},
-{0.368750,0.506250,0.050000,0.050000},
-{0.381250,0.506250,0.025000,0.025000},
-{0.381250,0.506250,0.050000,0.050000},
-{0.393750,0.506250,0.025000,0.025000},
-{0.393750,0.506250,0.050000,0.050000},
-{0.406250,0.506250,0.025000,0.025000},
-{0.406250,0.506250,0.050000,0.050000},
-{0.418750,0.506250,0.025000,0.025000},
-{0.418750,0.506250,0.050000,0.050000},
-{0.431250,0.506250,0.025000,0.025000},
-{0.431250,0.506250,0.050000,0.050000},
-{0.443750,0.506250,0.025000,0.025000},
-{0.443750,0.506250,0.050000,0.050000},
-{0.456250,0.506250,0.025000,0.025000},
-{0.456250,0.506250,0.050000,0.050000},
-{0.468750,0.506250,0.025000,0.025000},
-{0.468750,0.506250,0.050000,0.050000},
-{0.481250,0.506250,0.025000,0.025000},
-{0.481250,0.506250,0.050000,0.050000},
-{0.493750,0.506250,0.025000,0.025000},
-{0.493750,0.506250,0.050000,0.050000},
-{0.506250,0.506250,0.025000,0.025000},
-{0.506250,0.506250,0.050000,0.050000},
-{0.518750,0.506250,0.025000,0.025000},
-{0.518750,0.506250,0.050000,0.050000},
-{0.531250,0.506250,0.025000,0.025000},
-{0.531250,0.506250,0.050000,0.050000},
-{0.543750,0.506250,0.025000,0.025000},
-{0.543750,0.506250,0.050000,0.050000},
-{0.556250,0.506250,0.025000,0.025000},
-{0.556250,0.506250,0.050000,0.050000},
-{0.568750,0.506250,0.025000,0.025000},
-{0.568750,0.506250,0.050000,0.050000},
-{0.581250,0.506250,0.025000,0.025000},
-{0.581250,0.506250,0.050000,0.050000},
-{0.593750,0.506250,0.025000,0.025000},
-{0.593750,0.506250,0.050000,0.050000},
-{0.606250,0.506250,0.025000,0.025000},
-{0.606250,0.506250,0.050000,0.050000},
-{0.618750,0.506250,0.025000,0.025000},
-{0.618750,0.506250,0.050000,0.050000},
-{0.631250,0.506250,0.025000,0.025000},
-{0.631250,0.506250,0.050000,0.050000},
-{0.643750,0.506250,0.025000,0.025000},
-{0.643750,0.506250,0.050000,0.050000},
-{0.656250,0.506250,0.025000,0.025000},
-{0.656250,0.506250,0.050000,0.050000},
-{0.668750,0.506250,0.025000,0.025000},
-{0.668750,0.506250,0.050000,0.050000},
-{0.681250,0.506250,0.025000,0.025000},
-{0.681250,0.506250,0.050000,0.050000},
-{0.693750,0.506250,0.025000,0.025000},
-{0.693750,0.506250,0.050000,0.050000},
-{0.706250,0.506250,0.025000,0.025000},
-{0.706250,0.506250,0.050000,0.050000},
-{0.718750,0.506250,0.025000,0.025000},
-{0.718750,0.506250,0.050000,0.050000},
-{0.731250,0.506250,0.025000,0.025000},
-{0.731250,0.506250,0.050000,0.050000},
-{0.743750,0.506250,0.025000,0.025000},
-{0.743750,0.506250,0.050000,0.050000},
-{0.756250,0.506250,0.025000,0.025000},
-{0.756250,0.506250,0.050000,0.050000},
-{0.768750,0.506250,0.025000,0.025000},
-{0.768750,0.506250,0.050000,0.050000},
-{0.781250,0.506250,0.025000,0.025000},
-{0.781250,0.506250,0.050000,0.050000},
-{0.793750,0.506250,0.025000,0.025000},
-{0.793750,0.506250,0.050000,0.050000},
-{0.806250,0.506250,0.025000,0.025000},
-{0.806250,0.506250,0.050000,0.050000},
-{0.818750,0.506250,0.025000,0.025000},
-{0.818750,0.506250,0.050000,0.050000},
-{0.831250,0.506250,0.025000,0.025000},
-{0.831250,0.506250,0.050000,0.050000},
-{0.843750,0.506250,0.025000,0.025000},
-{0.843750,0.506250,0.050000,0.050000},
-{0.856250,0.506250,0.025000,0.025000},
-{0.856250,0.506250,0.050000,0.050000},
-{0.868750,0.506250,0.025000,0.025000},
-{0.868750,0.506250,0.050000,0.050000},
-{0.881250,0.506250,0.025000,0.025000},
-{0.881250,0.506250,0.050000,0.050000},
-{0.893750,0.506250,0.025000,0.025000},
-{0.893750,0.506250,0.050000,0.050000},
-{0.906250,0.506250,0.025000,0.025000},
-{0.906250,0.506250,0.050000,0.050000},
-{0.918750,0.506250,0.025000,0.025000},
-{0.918750,0.506250,0.050000,0.050000},
-{0.931250,0.506250,0.025000,0.025000},
-{0.931250,0.506250,0.050000,0.050000},
-{0.943750,0.506250,0.025000,0.025000},
-{0.943750,0.506250,0.050000,0.050000},
-{0.956250,0.506250,0.025000,0.025000},
-{0.956250,0.506250,0.050000,0.050000},
-{0.968750,0.506250,0.025000,0.025000},
-{0.968750,0.506250,0.050000,0.050000},
-{0.981250,0.506250,0.025000,0.025000},
-{0.981250,0.506250,0.050000,0.050000},
-{0.993750,0.506250,0.025000,0.025000},
-{0.993750,0.506250,0.050000,0.050000},
-{0.006250,0.518750,0.025000,0.025000},
-{0.006250,0.518750,0.050000,0.050000},
-{0.018750,0.518750,0.025000,0.025000},
-{0.018750,0.518750,0.050000,0.050000},
-{0.031250,0.518750,0.025000,0.025000},
-{0.031250,0.518750,0.050000,0.050000},
-{0.043750,0.518750,0.025000,0.025000},
-{0.043750,0.518750,0.050000,0.050000},
-{0.056250,0.518750,0.025000,0.025000},
-{0.056250,0.518750,0.050000,0.050000},
-{0.068750,0.518750,0.025000,0.025000},
-{0.068750,0.518750,0.050000,0.050000},
-{0.081250,0.518750,0.025000,0.025000},
-{0.081250,0.518750,0.050000,0.050000},
-{0.093750,0.518750,0.025000,0.025000},
-{0.093750,0.518750,0.050000,0.050000},
-{0.106250,0.518750,0.025000,0.025000},
-{0.106250,0.518750,0.050000,0.050000},
-{0.118750,0.518750,0.025000,0.025000},
-{0.118750,0.518750,0.050000,0.050000},
-{0.131250,0.518750,0.025000,0.025000},
-{0.131250,0.518750,0.050000,0.050000},
-{0.143750,0.518750,0.025000,0.025000},
-{0.143750,0.518750,0.050000,0.050000},
-{0.156250,0.518750,0.025000,0.025000},
-{0.156250,0.518750,0.050000,0.050000},
-{0.168750,0.518750,0.025000,0.025000},
-{0.168750,0.518750,0.050000,0.050000},
-{0.181250,0.518750,0.025000,0.025000},
-{0.181250,0.518750,0.050000,0.050000},
-{0.193750,0.518750,0.025000,0.025000},
-{0.193750,0.518750,0.050000,0.050000},
-{0.206250,0.518750,0.025000,0.025000},
-{0.206250,0.518750,0.050000,0.050000},
-{0.218750,0.518750,0.025000,0.025000},
-{0.218750,0.518750,0.050000,0.050000},
-{0.231250,0.518750,0.025000,0.025000},
-{0.231250,0.518750,0.050000,0.050000},
-{0.243750,0.518750,0.025000,0.025000},
-{0.243750,0.518750,0.050000,0.050000},
-{0.256250,0.518750,0.025000,0.025000},
-{0.256250,0.518750,0.050000,0.050000},
-{0.268750,0.518750,0.025000,0.025000},
-{0.268750,0.518750,0.050000,0.050000},
-{0.281250,0.518750,0.025000,0.025000},
-{0.281250,0.518750,0.050000,0.050000},
-{0.293750,0.518750,0.025000,0.025000},
-{0.293750,0.518750,0.050000,0.050000},
-{0.306250,0.518750,0.025000,0.025000},
-{0.306250,0.518750,0.050000,0.050000},
-{0.318750,0.518750,0.025000,0.025000},
-{0.318750,0.518750,0.050000,0.050000},
-{0.331250,0.518750,0.025000,0.025000},
-{0.331250,0.518750,0.050000,0.050000},
-{0.343750,0.518750,0.025000,0.025000},
-{0.343750,0.518750,0.050000,0.050000},
-{0.356250,0.518750,0.025000,0.025000},
-{0.356250,0.518750,0.050000,0.050000},
-{0.368750,0.518750,0.025000,0.025000},
-{0.368750,0.518750,0.050000,0.050000},
-{0.381250,0.518750,0.025000,0.025000},
-{0.381250,0.518750,0.050000,0.050000},
-{0.393750,0.518750,0.025000,0.025000},
-{0.393750,0.518750,0.050000,0.050000},
-{0.406250,0.518750,0.025000,0.025000},
-{0.406250,0.518750,0.050000,0.050000},
-{0.418750,0.518750,0.025000,0.025000},
-{0.418750,0.518750,0.050000,0.050000},
-{0.431250,0.518750,0.025000,0.025000},
-{0.431250,0.518750,0.050000,0.050000},
-{0.443750,0.518750,0.025000,0.025000},
-{0.443750,0.518750,0.050000,0.050000},
-{0.456250,0.518750,0.025000,0.025000},
-{0.456250,0.518750,0.050000,0.050000},
-{0.468750,0.518750,0.025000,0.025000},
-{0.468750,0.518750,0.050000,0.050000},
-{0.481250,0.518750,0.025000,0.025000},
-{0.481250,0.518750,0.050000,0.050000},
-{0.493750,0.518750,0.025000,0.025000},
-{0.493750,0.518750,0.050000,0.050000},
-{0.506250,0.518750,0.025000,0.025000},
-{0.506250,0.518750,0.050000,0.050000},
-{0.518750,0.518750,0.025000,0.025000},
-{0.518750,0.518750,0.050000,0.050000},
-{0.531250,0.518750,0.025000,0.025000},
-{0.531250,0.518750,0.050000,0.050000},
-{0.543750,0.518750,0.025000,0.025000},
-{0.543750,0.518750,0.050000,0.050000},
-{0.556250,0.518750,0.025000,0.025000},
-{0.556250,0.518750,0.050000,0.050000},
-{0.568750,0.518750,0.025000,0.025000},
-{0.568750,0.518750,0.050000,0.050000},
-{0.581250,0.518750,0.025000,0.025000},
-{0.581250,0.518750,0.050000,0.050000},
-{0.593750,0.518750,0.025000,0.025000},
-{0.593750,0.518750,0.050000,0.050000},
-{0.606250,0.518750,0.025000,0.025000},
-{0.606250,0.518750,0.050000,0.050000},
-{0.618750,0.518750,0.025000,0.025000},
-{0.618750,0.518750,0.050000,0.050000},
-{0.631250,0.518750,0.025000,0.025000},
-{0.631250,0.518750,0.050000,0.050000},
-{0.643750,0.518750,0.025000,0.025000},
-{0.643750,0.518750,0.050000,0.050000},
-{0.656250,0.518750,0.025000,0.025000},
-{0.656250,0.518750,0.050000,0.050000},
-{0.668750,0.518750,0.025000,0.025000},
-{0.668750,0.518750,0.050000,0.050000},
-{0.681250,0.518750,0.025000,0.025000},
-{0.681250,0.518750,0.050000,0.050000},
-{0.693750,0.518750,0.025000,0.025000},
-{0.693750,0.518750,0.050000,0.050000},
-{0.706250,0.518750,0.025000,0.025000},
-{0.706250,0.518750,0.050000,0.050000},
-{0.718750,0.518750,0.025000,0.025000},
-{0.718750,0.518750,0.050000,0.050000},
-{0.731250,0.518750,0.025000,0.025000},
-{0.731250,0.518750,0.050000,0.050000},
-{0.743750,0.518750,0.025000,0.025000},
-{0.743750,0.518750,0.050000,0.050000},
-{0.756250,0.518750,0.025000,0.025000},
-{0.756250,0.518750,0.050000,0.050000},
-{0.768750,0.518750,0.025000,0.025000},
-{0.768750,0.518750,0.050000,0.050000},
-{0.781250,0.518750,0.025000,0.025000},
-{0.781250,0.518750,0.050000,0.050000},
-{0.793750,0.518750,0.025000,0.025000},
-{0.793750,0.518750,0.050000,0.050000},
-{0.806250,0.518750,0.025000,0.025000},
-{0.806250,0.518750,0.050000,0.050000},
-{0.818750,0.518750,0.025000,0.025000},
-{0.818750,0.518750,0.050000,0.050000},
-{0.831250,0.518750,0.025000,0.025000},
-{0.831250,0.518750,0.050000,0.050000},
-{0.843750,0.518750,0.025000,0.025000},
-{0.843750,0.518750,0.050000,0.050000},
-{0.856250,0.518750,0.025000,0.025000},
-{0.856250,0.518750,0.050000,0.050000},
-{0.868750,0.518750,0.025000,0.025000},
-{0.868750,0.518750,0.050000,0.050000},
-{0.881250,0.518750,0.025000,0.025000},
-{0.881250,0.518750,0.050000,0.050000},
-{0.893750,0.518750,0.025000,0.025000},
-{0.893750,0.518750,0.050000,0.050000},
-{0.906250,0.518750,0.025000,0.025000},
-{0.906250,0.518750,0.050000,0.050000},
-{0.918750,0.518750,0.025000,0.025000},
-{0.918750,0.518750,0.050000,0.050000},
-{0.931250,0.518750,0.025000,0.025000},
-{0.931250,0.518750,0.050000,0.050000},
-{0.943750,0.518750,0.025000,0.025000},
-{0.943750,0.518750,0.050000,0.050000},
-{0.956250,0.518750,0.025000,0.025000},
-{0.956250,0.518750,0.050000,0.050000},
-{0.968750,0.518750,0.025000,0.025000},
-{0.968750,0.518750,0.050000,0.050000},
-{0.981250,0.518750,0.025000,0.025000},
-{0.981250,0.518750,0.050000,0.050000},
-{0.993750,0.518750,0.025000,0.025000},
-{0.993750,0.518750,0.050000,0.050000},
-{0.006250,0.531250,0.025000,0.025000},
-{0.006250,0.531250,0.050000,0.050000},
-{0.018750,0.531250,0.025000,0.025000},
-{0.018750,0.531250,0.050000,0.050000},
-{0.031250,0.531250,0.025000,0.025000},
-{0.031250,0.531250,0.050000,0.050000},
-{0.043750,0.531250,0.025000,0.025000},
-{0.043750,0.531250,0.050000,0.050000},
-{0.056250,0.531250,0.025000,0.025000},
-{0.056250,0.531250,0.050000,0.050000},
-{0.068750,0.531250,0.025000,0.025000},
-{0.068750,0.531250,0.050000,0.050000},
-{0.081250,0.531250,0.025000,0.025000},
-{0.081250,0.531250,0.050000,0.050000},
-{0.093750,0.531250,0.025000,0.025000},
-{0.093750,0.531250,0.050000,0.050000},
-{0.106250,0.531250,0.025000,0.025000},
-{0.106250,0.531250,0.050000,0.050000},
-{0.118750,0.531250,0.025000,0.025000},
-{0.118750,0.531250,0.050000,0.050000},
-{0.131250,0.531250,0.025000,0.025000},
-{0.131250,0.531250,0.050000,0.050000},
-{0.143750,0.531250,0.025000,0.025000},
-{0.143750,0.531250,0.050000,0.050000},
-{0.156250,0.531250,0.025000,0.025000},
-{0.156250,0.531250,0.050000,0.050000},
-{0.168750,0.531250,0.025000,0.025000},
-{0.168750,0.531250,0.050000,0.050000},
-{0.181250,0.531250,0.025000,0.025000},
-{0.181250,0.531250,0.050000,0.050000},
-{0.193750,0.531250,0.025000,0.025000},
-{0.193750,0.531250,0.050000,0.050000},
-{0.206250,0.531250,0.025000,0.025000},
-{0.206250,0.531250,0.050000,0.050000},
-{0.218750,0.531250,0.025000,0.025000},
-{0.218750,0.531250,0.050000,0.050000},
-{0.231250,0.531250,0.025000,0.025000},
-{0.231250,0.531250,0.050000,0.050000},
-{0.243750,0.531250,0.025000,0.025000},
-{0.243750,0.531250,0.050000,0.050000},
-{0.256250,0.531250,0.025000,0.025000},
-{0.256250,0.531250,0.050000,0.050000},
-{0.268750,0.531250,0.025000,0.025000},
-{0.268750,0.531250,0.050000,0.050000},
-{0.281250,0.531250,0.025000,0.025000},
-{0.281250,0.531250,0.050000,0.050000},
-{0.293750,0.531250,0.025000,0.025000},
-{0.293750,0.531250,0.050000,0.050000},
-{0.306250,0.531250,0.025000,0.025000},
-{0.306250,0.531250,0.050000,0.050000},
-{0.318750,0.531250,0.025000,0.025000},
-{0.318750,0.531250,0.050000,0.050000},
-{0.331250,0.531250,0.025000,0.025000},
-{0.331250,0.531250,0.050000,0.050000},
-{0.343750,0.531250,0.025000,0.025000},
-{0.343750,0.531250,0.050000,0.050000},
-{0.356250,0.531250,0.025000,0.025000},
-{0.356250,0.531250,0.050000,0.050000},
-{0.368750,0.531250,0.025000,0.025000},
-{0.368750,0.531250,0.050000,0.050000},
-{0.381250,0.531250,0.025000,0.025000},
-{0.381250,0.531250,0.050000,0.050000},
-{0.393750,0.531250,0.025000,0.025000},
-{0.393750,0.531250,0.050000,0.050000},
-{0.406250,0.531250,0.025000,0.025000},
-{0.406250,0.531250,0.050000,0.050000},
-{0.418750,0.531250,0.025000,0.025000},
-{0.418750,0.531250,0.050000,0.050000},
-{0.431250,0.531250,0.025000,0.025000},
-{0.431250,0.531250,0.050000,0.050000},
-{0.443750,0.531250,0.025000,0.025000},
-{0.443750,0.531250,0.050000,0.050000},
-{0.456250,0.531250,0.025000,0.025000},
-{0.456250,0.531250,0.050000,0.050000},
-{0.468750,0.531250,0.025000,0.025000},
-{0.468750,0.531250,0.050000,0.050000},
-{0.481250,0.531250,0.025000,0.025000},
-{0.481250,0.531250,0.050000,0.050000},
-{0.493750,0.531250,0.025000,0.025000},
-{0.493750,0.531250,0.050000,0.050000},
-{0.506250,0.531250,0.025000,0.025000},
-{0.506250,0.531250,0.050000,0.050000},
-{0.518750,0.531250,0.025000,0.025000},
-{0.518750,0.531250,0.050000,0.050000},
-{0.531250,0.531250,0.025000,0.025000},
-{0.531250,0.531250,0.050000,0.050000},
-{0.543750,0.531250,0.025000,0.025000},
-{0.543750,0.531250,0.050000,0.050000},
-{0.556250,0.531250,0.025000,0.025000},
-{0.556250,0.531250,0.050000,0.050000},
-{0.568750,0.531250,0.025000,0.025000},
-{0.568750,0.531250,0.050000,0.050000},
-{0.581250,0.531250,0.025000,0.025000},
-{0.581250,0.531250,0.050000,0.050000},
-{0.593750,0.531250,0.025000,0.025000},
-{0.593750,0.531250,0.050000,0.050000},
-{0.606250,0.531250,0.025000,0.025000},
-{0.606250,0.531250,0.050000,0.050000},
-{0.618750,0.531250,0.025000,0.025000},
-{0.618750,0.531250,0.050000,0.050000},
-{0.631250,0.531250,0.025000,0.025000},
-{0.631250,0.531250,0.050000,0.050000},
-{0.643750,0.531250,0.025000,0.025000},
-{0.643750,0.531250,0.050000,0.050000},
-{0.656250,0.531250,0.025000,0.025000},
-{0.656250,0.531250,0.050000,0.050000},
-{0.668750,0.531250,0.025000,0.025000},
-{0.668750,0.531250,0.050000,0.050000},
-{0.681250,0.531250,0.025000,0.025000},
-{0.681250,0.531250,0.050000,0.050000},
-{0.693750,0.531250,0.025000,0.025000},
-{0.693750,0.531250,0.050000,0.050000},
-{0.706250,0.531250,0.025000,0.025000},
-{0.706250,0.531250,0.050000,0.050000},
-{0.718750,0.531250,0.025000,0.025000},
-{0.718750,0.531250,0.050000,0.050000},
-{0.731250,0.531250,0.025000,0.025000},
-{0.731250,0.531250,0.050000,0.050000},
-{0.743750,0.531250,0.025000,0.025000},
-{0.743750,0.531250,0.050000,0.050000},
-{0.756250,0.531250,0.025000,0.025000},
-{0.756250,0.531250,0.050000,0.050000},
-{0.768750,0.531250,0.025000,0.025000},
-{0.768750,0.531250,0.050000,0.050000},
-{0.781250,0.531250,0.025000,0.025000},
-{0.781250,0.531250,0.050000,0.050000},
-{0.793750,0.531250,0.025000,0.025000},
-{0.793750,0.531250,0.050000,0.050000},
-{0.806250,0.531250,0.025000,0.025000},
-{0.806250,0.531250,0.050000,0.050000},
-{0.818750,0.531250,0.025000,0.025000},
-{0.818750,0.531250,0.050000,0.050000},
-{0.831250,0.531250,0.025000,0.025000},
-{0.831250,0.531250,0.050000,0.050000},
-{0.843750,0.531250,0.025000,0.025000},
-{0.843750,0.531250,0.050000,0.050000},
-{0.856250,0.531250,0.025000,0.025000},
-{0.856250,0.531250,0.050000,0.050000},
-{0.868750,0.531250,0.025000,0.025000},
-{0.868750,0.531250,0.050000,0.050000},
-{0.881250,0.531250,0.025000,0.025000},
-{0.881250,0.531250,0.050000,0.050000},
-{0.893750,0.531250,0.025000,0.025000},
-{0.893750,0.531250,0.050000,0.050000},
-{0.906250,0.531250,0.025000,0.025000},
-{0.906250,0.531250,0.050000,0.050000},
-{0.918750,0.531250,0.025000,0.025000},
-{0.918750,0.531250,0.050000,0.050000},
-{0.931250,0.531250,0.025000,0.025000},
-{0.931250,0.531250,0.050000,0.050000},
-{0.943750,0.531250,0.025000,0.025000},
-{0.943750,0.531250,0.050000,0.050000},
-{0.956250,0.531250,0.025000,0.025000},
-{0.956250,0.531250,0.050000,0.050000},
-{0.968750,0.531250,0.025000,0.025000},
-{0.968750,0.531250,0.050000,0.050000},
-{0.981250,0.531250,0.025000,0.025000},
-{0.981250,0.531250,0.050000,0.050000},
-{0.993750,0.531250,0.025000,0.025000},
-{0.993750,0.531250,0.050000,0.050000},
-{0.006250,0.543750,0.025000,0.025000},
-{0.006250,0.543750,0.050000,0.050000},
-{0.018750,0.543750,0.025000,0.025000},
-{0.018750,0.543750,0.050000,0.050000},
-{0.031250,0.543750,0.025000,0.025000},
-{0.031250,0.543750,0.050000,0.050000},
-{0.043750,0.543750,0.025000,0.025000},
-{0.043750,0.543750,0.050000,0.050000},
-{0.056250,0.543750,0.025000,0.025000},
-{0.056250,0.543750,0.050000,0.050000},
-{0.068750,0.543750,0.025000,0.025000},
-{0.068750,0.543750,0.050000,0.050000},
-{0.081250,0.543750,0.025000,0.025000},
-{0.081250,0.543750,0.050000,0.050000},
-{0.093750,0.543750,0.025000,0.025000},
-{0.093750,0.543750,0.050000,0.050000},
-{0.106250,0.543750,0.025000,0.025000},
-{0.106250,0.543750,0.050000,0.050000},
-{0.118750,0.543750,0.025000,0.025000},
-{0.118750,0.543750,0.050000,0.050000},
-{0.131250,0.543750,0.025000,0.025000},
-{0.131250,0.543750,0.050000,0.050000},
-{0.143750,0.543750,0.025000,0.025000},
-{0.143750,0.543750,0.050000,0.050000},
-{0.156250,0.543750,0.025000,0.025000},
-{0.156250,0.543750,0.050000,0.050000},
-{0.168750,0.543750,0.025000,0.025000},
-{0.168750,0.543750,0.050000,0.050000},
-{0.181250,0.543750,0.025000,0.025000},
-{0.181250,0.543750,0.050000,0.050000},
-{0.193750,0.543750,0.025000,0.025000},
-{0.193750,0.543750,0.050000,0.050000},
-{0.206250,0.543750,0.025000,0.025000},
-{0.206250,0.543750,0.050000,0.050000},
-{0.218750,0.543750,0.025000,0.025000},
-{0.218750,0.543750,0.050000,0.050000},
-{0.231250,0.543750,0.025000,0.025000},
-{0.231250,0.543750,0.050000,0.050000},
-{0.243750,0.543750,0.025000,0.025000},
-{0.243750,0.543750,0.050000,0.050000},
-{0.256250,0.543750,0.025000,0.025000},
-{0.256250,0.543750,0.050000,0.050000},
-{0.268750,0.543750,0.025000,0.025000},
-{0.268750,0.543750,0.050000,0.050000},
-{0.281250,0.543750,0.025000,0.025000},
-{0.281250,0.543750,0.050000,0.050000},
-{0.293750,0.543750,0.025000,0.025000},
-{0.293750,0.543750,0.050000,0.050000},
-{0.306250,0.543750,0.025000,0.025000},
-{0.306250,0.543750,0.050000,0.050000},
-{0.318750,0.543750,0.025000,0.025000},
-{0.318750,0.543750,0.050000,0.050000},
-{0.331250,0.543750,0.025000,0.025000},
-{0.331250,0.543750,0.050000,0.050000},
-{0.343750,0.543750,0.025000,0.025000},
-{0.343750,0.543750,0.050000,0.050000},
-{0.356250,0.543750,0.025000,0.025000},
-{0.356250,0.543750,0.050000,0.050000},
-{0.368750,0.543750,0.025000,0.025000},
-{0.368750,0.543750,0.050000,0.050000},
-{0.381250,0.543750,0.025000,0.025000},
-{0.381250,0.543750,0.050000,0.050000},
-{0.393750,0.543750,0.025000,0.025000},
-{0.393750,0.543750,0.050000,0.050000},
-{0.406250,0.543750,0.025000,0.025000},
-{0.406250,0.543750,0.050000,0.050000},
-{0.418750,0.543750,0.025000,0.025000},
-{0.418750,0.543750,0.050000,0.050000},
-{0.431250,0.543750,0.025000,0.025000},
-{0.431250,0.543750,0.050000,0.050000},
-{0.443750,0.543750,0.025000,0.025000},
-{0.443750,0.543750,0.050000,0.050000},
-{0.456250,0.543750,0.025000,0.025000},
-{0.456250,0.543750,0.050000,0.050000},
-{0.468750,0.543750,0.025000,0.025000},
-{0.468750,0.543750,0.050000,0.050000},
-{0.481250,0.543750,0.025000,0.025000},
-{0.481250,0.543750,0.050000,0.050000},
-{0.493750,0.543750,0.025000,0.025000},
-{0.493750,0.543750,0.050000,0.050000},
-{0.506250,0.543750,0.025000,0.025000},
-{0.506250,0.543750,0.050000,0.050000},
-{0.518750,0.543750,0.025000,0.025000},
-{0.518750,0.543750,0.050000,0.050000},
-{0.531250,0.543750,0.025000,0.025000},
-{0.531250,0.543750,0.050000,0.050000},
-{0.543750,0.543750,0.025000,0.025000},
-{0.543750,0.543750,0.050000,0.050000},
-{0.556250,0.543750,0.025000,0.025000},
-{0.556250,0.543750,0.050000,0.050000},
-{0.568750,0.543750,0.025000,0.025000},
-{0.568750,0.543750,0.050000,0.050000},
-{0.581250,0.543750,0.025000,0.025000},
-{0.581250,0.543750,0.050000,0.050000},
-{0.593750,0.543750,0.025000,0.025000},
-{0.593750,0.543750,0.050000,0.050000},
-{0.606250,0.543750,0.025000,0.025000},
-{0.606250,0.543750,0.050000,0.050000},
-{0.618750,0.543750,0.025000,0.025000},
-{0.618750,0.543750,0.050000,0.050000},
-{0.631250,0.543750,0.025000,0.025000},
-{0.631250,0.543750,0.050000,0.050000},
-{0.643750,0.543750,0.025000,0.025000},
-{0.643750,0.543750,0.050000,0.050000},
-{0.656250,0.543750,0.025000,0.025000},
-{0.656250,0.543750,0.050000,0.050000},
-{0.668750,0.543750,0.025000,0.025000},
-{0.668750,0.543750,0.050000,0.050000},
-{0.681250,0.543750,0.025000,0.025000},
-{0.681250,0.543750,0.050000,0.050000},
-{0.693750,0.543750,0.025000,0.025000},
-{0.693750,0.543750,0.050000,0.050000},
-{0.706250,0.543750,0.025000,0.025000},
-{0.706250,0.543750,0.050000,0.050000},
-{0.718750,0.543750,0.025000,0.025000},
-{0.718750,0.543750,0.050000,0.050000},
-{0.731250,0.543750,0.025000,0.025000},
-{0.731250,0.543750,0.050000,0.050000},
-{0.743750,0.543750,0.025000,0.025000},
-{0.743750,0.543750,0.050000,0.050000},
-{0.756250,0.543750,0.025000,0.025000},
-{0.756250,0.543750,0.050000,0.050000},
-{0.768750,0.543750,0.025000,0.025000},
-{0.768750,0.543750,0.050000,0.050000},
-{0.781250,0.543750,0.025000,0.025000},
-{0.781250,0.543750,0.050000,0.050000},
-{0.793750,0.543750,0.025000,0.025000},
-{0.793750,0.543750,0.050000,0.050000},
-{0.806250,0.543750,0.025000,0.025000},
-{0.806250,0.543750,0.050000,0.050000},
-{0.818750,0.543750,0.025000,0.025000},
-{0.818750,0.543750,0.050000,0.050000},
-{0.831250,0.543750,0.025000,0.025000},
-{0.831250,0.543750,0.050000,0.050000},
-{0.843750,0.543750,0.025000,0.025000},
-{0.843750,0.543750,0.050000,0.050000},
-{0.856250,0.543750,0.025000,0.025000},
-{0.856250,0.543750,0.050000,0.050000},
-{0.868750,0.543750,0.025000,0.025000},
-{0.868750,0.543750,0.050000,0.050000},
-{0.881250,0.543750,0.025000,0.025000},
-{0.881250,0.543750,0.050000,0.050000},
-{0.893750,0.543750,0.025000,0.025000},
-{0.893750,0.543750,0.050000,0.050000},
-{0.906250,0.543750,0.025000,0.025000},
-{0.906250,0.543750,0.050000,0.050000},
-{0.918750,0.543750,0.025000,0.025000},
-{0.918750,0.543750,0.050000,0.050000},
-{0.931250,0.543750,0.025000,0.025000},
-{0.931250,0.543750,0.050000,0.050000},
-{0.943750,0.543750,0.025000,0.025000},
-{0.943750,0.543750,0.050000,0.050000},
-{0.956250,0.543750,0.025000,0.025000},
-{0.956250,0.543750,0.050000,0.050000},
-{0.968750,0.543750,0.025000,0.025000},
-{0.968750,0.543750,0.050000,0.050000},
-{0.981250,0.543750,0.025000,0.025000},
-{0.981250,0.543750,0.050000,0.050000},
-{0.993750,0.543750,0.025000,0.025000},
-{0.993750,0.543750,0.050000,0.050000},
-{0.006250,0.556250,0.025000,0.025000},
-{0.006250,0.556250,0.050000,0.050000},
-{0.018750,0.556250,0.025000,0.025000},
-{0.018750,0.556250,0.050000,0.050000},
-{0.031250,0.556250,0.025000,0.025000},
-{0.031250,0.556250,0.050000,0.050000},
-{0.043750,0.556250,0.025000,0.025000},
-{0.043750,0.556250,0.050000,0.050000},
-{0.056250,0.556250,0.025000,0.025000},
-{0.056250,0.556250,0.050000,0.050000},
-{0.068750,0.556250,0.025000,0.025000},
-{0.068750,0.556250,0.050000,0.050000},
-{0.081250,0.556250,0.025000,0.025000},
-{0.081250,0.556250,0.050000,0.050000},
-{0.093750,0.556250,0.025000,0.025000},
-{0.093750,0.556250,0.050000,0.050000},
-{0.106250,0.556250,0.025000,0.025000},
-{0.106250,0.556250,0.050000,0.050000},
-{0.118750,0.556250,0.025000,0.025000},
-{0.118750,0.556250,0.050000,0.050000},
-{0.131250,0.556250,0.025000,0.025000},
-{0.131250,0.556250,0.050000,0.050000},
-{0.143750,0.556250,0.025000,0.025000},
-{0.143750,0.556250,0.050000,0.050000},
-{0.156250,0.556250,0.025000,0.025000},
-{0.156250,0.556250,0.050000,0.050000},
-{0.168750,0.556250,0.025000,0.025000},
-{0.168750,0.556250,0.050000,0.050000},
-{0.181250,0.556250,0.025000,0.025000},
-{0.181250,0.556250,0.050000,0.050000},
-{0.193750,0.556250,0.025000,0.025000},
-{0.193750,0.556250,0.050000,0.050000},
-{0.206250,0.556250,0.025000,0.025000},
-{0.206250,0.556250,0.050000,0.050000},
-{0.218750,0.556250,0.025000,0.025000},
-{0.218750,0.556250,0.050000,0.050000},
-{0.231250,0.556250,0.025000,0.025000},
-{0.231250,0.556250,0.050000,0.050000},
-{0.243750,0.556250,0.025000,0.025000},
-{0.243750,0.556250,0.050000,0.050000},
-{0.256250,0.556250,0.025000,0.025000},
-{0.256250,0.556250,0.050000,0.050000},
-{0.268750,0.556250,0.025000,0.025000},
-{0.268750,0.556250,0.050000,0.050000},
-{0.281250,0.556250,0.025000,0.025000},
-{0.281250,0.556250,0.050000,0.050000},
-{0.293750,0.556250,0.025000,0.025000},
-{0.293750,0.556250,0.050000,0.050000},
-{0.306250,0.556250,0.025000,0.025000},
-{0.306250,0.556250,0.050000,0.050000},
-{0.318750,0.556250,0.025000,0.025000},
-{0.318750,0.556250,0.050000,0.050000},
-{0.331250,0.556250,0.025000,0.025000},
-{0.331250,0.556250,0.050000,0.050000},
-{0.343750,0.556250,0.025000,0.025000},
-{0.343750,0.556250,0.050000,0.050000},
-{0.356250,0.556250,0.025000,0.025000},
-{0.356250,0.556250,0.050000,0.050000},
-{0.368750,0.556250,0.025000,0.025000},
-{0.368750,0.556250,0.050000,0.050000},
-{0.381250,0.556250,0.025000,0.025000},
-{0.381250,0.556250,0.050000,0.050000},
-{0.393750,0.556250,0.025000,0.025000},
-{0.393750,0.556250,0.050000,0.050000},
-{0.406250,0.556250,0.025000,0.025000},
-{0.406250,0.556250,0.050000,0.050000},
-{0.418750,0.556250,0.025000,0.025000},
-{0.418750,0.556250,0.050000,0.050000},
-{0.431250,0.556250,0.025000,0.025000},
-{0.431250,0.556250,0.050000,0.050000},
-{0.443750,0.556250,0.025000,0.025000},
-{0.443750,0.556250,0.050000,0.050000},
-{0.456250,0.556250,0.025000,0.025000},
-{0.456250,0.556250,0.050000,0.050000},
-{0.468750,0.556250,0.025000,0.025000},
-{0.468750,0.556250,0.050000,0.050000},
-{0.481250,0.556250,0.025000,0.025000},
-{0.481250,0.556250,0.050000,0.050000},
-{0.493750,0.556250,0.025000,0.025000},
-{0.493750,0.556250,0.050000,0.050000},
-{0.506250,0.556250,0.025000,0.025000},
-{0.506250,0.556250,0.050000,0.050000},
-{0.518750,0.556250,0.025000,0.025000},
-{0.518750,0.556250,0.050000,0.050000},
-{0.531250,0.556250,0.025000,0.025000},
-{0.531250,0.556250,0.050000,0.050000},
-{0.543750,0.556250,0.025000,0.025000},
-{0.543750,0.556250,0.050000,0.050000},
-{0.556250,0.556250,0.025000,0.025000},
-{0.556250,0.556250,0.050000,0.050000},
-{0.568750,0.556250,0.025000,0.025000},
-{0.568750,0.556250,0.050000,0.050000},
-{0.581250,0.556250,0.025000,0.025000},
-{0.581250,0.556250,0.050000,0.050000},
-{0.593750,0.556250,0.025000,0.025000},
-{0.593750,0.556250,0.050000,0.050000},
-{0.606250,0.556250,0.025000,0.025000},
-{0.606250,0.556250,0.050000,0.050000},
-{0.618750,0.556250,0.025000,0.025000},
-{0.618750,0.556250,0.050000,0.050000},
-{0.631250,0.556250,0.025000,0.025000},
-{0.631250,0.556250,0.050000,0.050000},
-{0.643750,0.556250,0.025000,0.025000},
-{0.643750,0.556250,0.050000,0.050000},
-{0.656250,0.556250,0.025000,0.025000},
-{0.656250,0.556250,0.050000,0.050000},
-{0.668750,0.556250,0.025000,0.025000},
-{0.668750,0.556250,0.050000,0.050000},
-{0.681250,0.556250,0.025000,0.025000},
-{0.681250,0.556250,0.050000,0.050000},
-{0.693750,0.556250,0.025000,0.025000},
-{0.693750,0.556250,0.050000,0.050000},
-{0.706250,0.556250,0.025000,0.025000},
-{0.706250,0.556250,0.050000,0.050000},
-{0.718750,0.556250,0.025000,0.025000},
-{0.718750,0.556250,0.050000,0.050000},
-{0.731250,0.556250,0.025000,0.025000},
-{0.731250,0.556250,0.050000,0.050000},
-{0.743750,0.556250,0.025000,0.025000},
-{0.743750,0.556250,0.050000,0.050000},
-{0.756250,0.556250,0.025000,0.025000},
-{0.756250,0.556250,0.050000,0.050000},
-{0.768750,0.556250,0.025000,0.025000},
-{0.768750,0.556250,0.050000,0.050000},
-{0.781250,0.556250,0.025000,0.025000},
-{0.781250,0.556250,0.050000,0.050000},
-{0.793750,0.556250,0.025000,0.025000},
-{0.793750,0.556250,0.050000,0.050000},
-{0.806250,0.556250,0.025000,0.025000},
-{0.806250,0.556250,0.050000,0.050000},
-{0.818750,0.556250,0.025000,0.025000},
-{0.818750,0.556250,0.050000,0.050000},
-{0.831250,0.556250,0.025000,0.025000},
-{0.831250,0.556250,0.050000,0.050000},
-{0.843750,0.556250,0.025000,0.025000},
-{0.843750,0.556250,0.050000,0.050000},
-{0.856250,0.556250,0.025000,0.025000},
-{0.856250,0.556250,0.050000,0.050000},
-{0.868750,0.556250,0.025000,0.025000},
-{0.868750,0.556250,0.050000,0.050000},
-{0.881250,0.556250,0.025000,0.025000},
-{0.881250,0.556250,0.050000,0.050000},
-{0.893750,0.556250,0.025000,0.025000},
-{0.893750,0.556250,0.050000,0.050000},
-{0.906250,0.556250,0.025000,0.025000},
-{0.906250,0.556250,0.050000,0.050000},
-{0.918750,0.556250,0.025000,0.025000},
-{0.918750,0.556250,0.050000,0.050000},
-{0.931250,0.556250,0.025000,0.025000},
-{0.931250,0.556250,0.050000,0.050000},
-{0.943750,0.556250,0.025000,0.025000},
-{0.943750,0.556250,0.050000,0.050000},
-{0.956250,0.556250,0.025000,0.025000},
-{0.956250,0.556250,0.050000,0.050000},
-{0.968750,0.556250,0.025000,0.025000},
-{0.968750,0.556250,0.050000,0.050000},
-{0.981250,0.556250,0.025000,0.025000},
-{0.981250,0.556250,0.050000,0.050000},
-{0.993750,0.556250,0.025000,0.025000},
-{0.993750,0.556250,0.050000,0.050000},
-{0.006250,0.568750,0.025000,0.025000},
-{0.006250,0.568750,0.050000,0.050000},
-{0.018750,0.568750,0.025000,0.025000},
-{0.018750,0.568750,0.050000,0.050000},
-{0.031250,0.568750,0.025000,0.025000},
-{0.031250,0.568750,0.050000,0.050000},
-{0.043750,0.568750,0.025000,0.025000},
-{0.043750,0.568750,0.050000,0.050000},
-{0.056250,0.568750,0.025000,0.025000},
-{0.056250,0.568750,0.050000,0.050000},
-{0.068750,0.568750,0.025000,0.025000},
-{0.068750,0.568750,0.050000,0.050000},
-{0.081250,0.568750,0.025000,0.025000},
-{0.081250,0.568750,0.050000,0.050000},
-{0.093750,0.568750,0.025000,0.025000},
-{0.093750,0.568750,0.050000,0.050000},
-{0.106250,0.568750,0.025000,0.025000},
-{0.106250,0.568750,0.050000,0.050000},
-{0.118750,0.568750,0.025000,0.025000},
-{0.118750,0.568750,0.050000,0.050000},
-{0.131250,0.568750,0.025000,0.025000},
-{0.131250,0.568750,0.050000,0.050000},
-{0.143750,0.568750,0.025000,0.025000},
-{0.143750,0.568750,0.050000,0.050000},
-{0.156250,0.568750,0.025000,0.025000},
-{0.156250,0.568750,0.050000,0.050000},
-{0.168750,0.568750,0.025000,0.025000},
-{0.168750,0.568750,0.050000,0.050000},
-{0.181250,0.568750,0.025000,0.025000},
-{0.181250,0.568750,0.050000,0.050000},
-{0.193750,0.568750,0.025000,0.025000},
-{0.193750,0.568750,0.050000,0.050000},
-{0.206250,0.568750,0.025000,0.025000},
-{0.206250,0.568750,0.050000,0.050000},
-{0.218750,0.568750,0.025000,0.025000},
-{0.218750,0.568750,0.050000,0.050000},
-{0.231250,0.568750,0.025000,0.025000},
-{0.231250,0.568750,0.050000,0.050000},
-{0.243750,0.568750,0.025000,0.025000},
-{0.243750,0.568750,0.050000,0.050000},
-{0.256250,0.568750,0.025000,0.025000},
-{0.256250,0.568750,0.050000,0.050000},
-{0.268750,0.568750,0.025000,0.025000},
-{0.268750,0.568750,0.050000,0.050000},
-{0.281250,0.568750,0.025000,0.025000},
-{0.281250,0.568750,0.050000,0.050000},
-{0.293750,0.568750,0.025000,0.025000},
-{0.293750,0.568750,0.050000,0.050000},
-{0.306250,0.568750,0.025000,0.025000},
-{0.306250,0.568750,0.050000,0.050000},
-{0.318750,0.568750,0.025000,0.025000},
-{0.318750,0.568750,0.050000,0.050000},
-{0.331250,0.568750,0.025000,0.025000},
-{0.331250,0.568750,0.050000,0.050000},
-{0.343750,0.568750,0.025000,0.025000},
-{0.343750,0.568750,0.050000,0.050000},
-{0.356250,0.568750,0.025000,0.025000},
-{0.356250,0.568750,0.050000,0.050000},
-{0.368750,0.568750,0.025000,0.025000},
-{0.368750,0.568750,0.050000,0.050000},
-{0.381250,0.568750,0.025000,0.025000},
-{0.381250,0.568750,0.050000,0.050000},
-{0.393750,0.568750,0.025000,0.025000},
-{0.393750,0.568750,0.050000,0.050000},
-{0.406250,0.568750,0.025000,0.025000},
-{0.406250,0.568750,0.050000,0.050000},
-{0.418750,0.568750,0.025000,0.025000},
-{0.418750,0.568750,0.050000,0.050000},
-{0.431250,0.568750,0.025000,0.025000},
-{0.431250,0.568750,0.050000,0.050000},
-{0.443750,0.568750,0.025000,0.025000},
-{0.443750,0.568750,0.050000,0.050000},
-{0.456250,0.568750,0.025000,0.025000},
-{0.456250,0.568750,0.050000,0.050000},
-{0.468750,0.568750,0.025000,0.025000},
-{0.468750,0.568750,0.050000,0.050000},
-{0.481250,0.568750,0.025000,0.025000},
-{0.481250,0.568750,0.050000,0.050000},
-{0.493750,0.568750,0.025000,0.025000},
-{0.493750,0.568750,0.050000,0.050000},
-{0.506250,0.568750,0.025000,0.025000},
-{0.506250,0.568750,0.050000,0.050000},
-{0.518750,0.568750,0.025000,0.025000},
-{0.518750,0.568750,0.050000,0.050000},
-{0.531250,0.568750,0.025000,0.025000},
-{0.531250,0.568750,0.050000,0.050000},
-{0.543750,0.568750,0.025000,0.025000},
-{0.543750,0.568750,0.050000,0.050000},
-{0.556250,0.568750,0.025000,0.025000},
-{0.556250,0.568750,0.050000,0.050000},
-{0.568750,0.568750,0.025000,0.025000},
-{0.568750,0.568750,0.050000,0.050000},
-{0.581250,0.568750,0.025000,0.025000},
-{0.581250,0.568750,0.050000,0.050000},
-{0.593750,0.568750,0.025000,0.025000},
-{0.593750,0.568750,0.050000,0.050000},
-{0.606250,0.568750,0.025000,0.025000},
-{0.606250,0.568750,0.050000,0.050000},
-{0.618750,0.568750,0.025000,0.025000},
-{0.618750,0.568750,0.050000,0.050000},
-{0.631250,0.568750,0.025000,0.025000},
-{0.631250,0.568750,0.050000,0.050000},
-{0.643750,0.568750,0.025000,0.025000},
-{0.643750,0.568750,0.050000,0.050000},
-{0.656250,0.568750,0.025000,0.025000},
-{0.656250,0.568750,0.050000,0.050000},
-{0.668750,0.568750,0.025000,0.025000},
-{0.668750,0.568750,0.050000,0.050000},
-{0.681250,0.568750,0.025000,0.025000},
-{0.681250,0.568750,0.050000,0.050000},
-{0.693750,0.568750,0.025000,0.025000},
-{0.693750,0.568750,0.050000,0.050000},
-{0.706250,0.568750,0.025000,0.025000},
-{0.706250,0.568750,0.050000,0.050000},
-{0.718750,0.568750,0.025000,0.025000},
-{0.718750,0.568750,0.050000,0.050000},
-{0.731250,0.568750,0.025000,0.025000},
-{0.731250,0.568750,0.050000,0.050000},
-{0.743750,0.568750,0.025000,0.025000},
-{0.743750,0.568750,0.050000,0.050000},
-{0.756250,0.568750,0.025000,0.025000},
-{0.756250,0.568750,0.050000,0.050000},
-{0.768750,0.568750,0.025000,0.025000},
-{0.768750,0.568750,0.050000,0.050000},
-{0.781250,0.568750,0.025000,0.025000},
-{0.781250,0.568750,0.050000,0.050000},
-{0.793750,0.568750,0.025000,0.025000},
-{0.793750,0.568750,0.050000,0.050000},
-{0.806250,0.568750,0.025000,0.025000},
-{0.806250,0.568750,0.050000,0.050000},
-{0.818750,0.568750,0.025000,0.025000},
-{0.818750,0.568750,0.050000,0.050000},
-{0.831250,0.568750,0.025000,0.025000},
-{0.831250,0.568750,0.050000,0.050000},
-{0.843750,0.568750,0.025000,0.025000},
-{0.843750,0.568750,0.050000,0.050000},
-{0.856250,0.568750,0.025000,0.025000},
-{0.856250,0.568750,0.050000,0.050000},
-{0.868750,0.568750,0.025000,0.025000},
-{0.868750,0.568750,0.050000,0.050000},
-{0.881250,0.568750,0.025000,0.025000},
-{0.881250,0.568750,0.050000,0.050000},
-{0.893750,0.568750,0.025000,0.025000},
-{0.893750,0.568750,0.050000,0.050000},
-{0.906250,0.568750,0.025000,0.025000},
-{0.906250,0.568750,0.050000,0.050000},
-{0.918750,0.568750,0.025000,0.025000},
-{0.918750,0.568750,0.050000,0.050000},
-{0.931250,0.568750,0.025000,0.025000},
-{0.931250,0.568750,0.050000,0.050000},
-{0.943750,0.568750,0.025000,0.025000},
-{0.943750,0.568750,0.050000,0.050000},
-{0.956250,0.568750,0.025000,0.025000},
-{0.956250,0.568750,0.050000,0.050000},
-{0.968750,0.568750,0.025000,0.025000},
-{0.968750,0.568750,0.050000,0.050000},
-{0.981250,0.568750,0.025000,0.025000},
-{0.981250,0.568750,0.050000,0.050000},
-{0.993750,0.568750,0.025000,0.025000},
-{0.993750,0.568750,0.050000,0.050000},
-{0.006250,0.581250,0.025000,0.025000},
-{0.006250,0.581250,0.050000,0.050000},
-{0.018750,0.581250,0.025000,0.025000},
-{0.018750,0.581250,0.050000,0.050000},
-{0.031250,0.581250,0.025000,0.025000},
-{0.031250,0.581250,0.050000,0.050000},
-{0.043750,0.581250,0.025000,0.025000},
-{0.043750,0.581250,0.050000,0.050000},
-{0.056250,0.581250,0.025000,0.025000},
-{0.056250,0.581250,0.050000,0.050000},
-{0.068750,0.581250,0.025000,0.025000},
-{0.068750,0.581250,0.050000,0.050000},
-{0.081250,0.581250,0.025000,0.025000},
-{0.081250,0.581250,0.050000,0.050000},
-{0.093750,0.581250,0.025000,0.025000},
-{0.093750,0.581250,0.050000,0.050000},
-{0.106250,0.581250,0.025000,0.025000},
-{0.106250,0.581250,0.050000,0.050000},
-{0.118750,0.581250,0.025000,0.025000},
-{0.118750,0.581250,0.050000,0.050000},
-{0.131250,0.581250,0.025000,0.025000},
-{0.131250,0.581250,0.050000,0.050000},
-{0.143750,0.581250,0.025000,0.025000},
-{0.143750,0.581250,0.050000,0.050000},
-{0.156250,0.581250,0.025000,0.025000},
-{0.156250,0.581250,0.050000,0.050000},
-{0.168750,0.581250,0.025000,0.025000},
-{0.168750,0.581250,0.050000,0.050000},
-{0.181250,0.581250,0.025000,0.025000},
-{0.181250,0.581250,0.050000,0.050000},
-{0.193750,0.581250,0.025000,0.025000},
-{0.193750,0.581250,0.050000,0.050000},
-{0.206250,0.581250,0.025000,0.025000},
-{0.206250,0.581250,0.050000,0.050000},
-{0.218750,0.581250,0.025000,0.025000},
-{0.218750,0.581250,0.050000,0.050000},
-{0.231250,0.581250,0.025000,0.025000},
-{0.231250,0.581250,0.050000,0.050000},
-{0.243750,0.581250,0.025000,0.025000},
-{0.243750,0.581250,0.050000,0.050000},
-{0.256250,0.581250,0.025000,0.025000},
-{0.256250,0.581250,0.050000,0.050000},
-{0.268750,0.581250,0.025000,0.025000},
-{0.268750,0.581250,0.050000,0.050000},
-{0.281250,0.581250,0.025000,0.025000},
-{0.281250,0.581250,0.050000,0.050000},
-{0.293750,0.581250,0.025000,0.025000},
-{0.293750,0.581250,0.050000,0.050000},
-{0.306250,0.581250,0.025000,0.025000},
-{0.306250,0.581250,0.050000,0.050000},
-{0.318750,0.581250,0.025000,0.025000},
-{0.318750,0.581250,0.050000,0.050000},
-{0.331250,0.581250,0.025000,0.025000},
-{0.331250,0.581250,0.050000,0.050000},
-{0.343750,0.581250,0.025000,0.025000},
-{0.343750,0.581250,0.050000,0.050000},
-{0.356250,0.581250,0.025000,0.025000},
-{0.356250,0.581250,0.050000,0.050000},
-{0.368750,0.581250,0.025000,0.025000},
-{0.368750,0.581250,0.050000,0.050000},
-{0.381250,0.581250,0.025000,0.025000},
-{0.381250,0.581250,0.050000,0.050000},
-{0.393750,0.581250,0.025000,0.025000},
-{0.393750,0.581250,0.050000,0.050000},
-{0.406250,0.581250,0.025000,0.025000},
-{0.406250,0.581250,0.050000,0.050000},
-{0.418750,0.581250,0.025000,0.025000},
-{0.418750,0.581250,0.050000,0.050000},
-{0.431250,0.581250,0.025000,0.025000},
-{0.431250,0.581250,0.050000,0.050000},
-{0.443750,0.581250,0.025000,0.025000},
-{0.443750,0.581250,0.050000,0.050000},
-{0.456250,0.581250,0.025000,0.025000},
-{0.456250,0.581250,0.050000,0.050000},
-{0.468750,0.581250,0.025000,0.025000},
-{0.468750,0.581250,0.050000,0.050000},
-{0.481250,0.581250,0.025000,0.025000},
-{0.481250,0.581250,0.050000,0.050000},
-{0.493750,0.581250,0.025000,0.025000},
-{0.493750,0.581250,0.050000,0.050000},
-{0.506250,0.581250,0.025000,0.025000},
-{0.506250,0.581250,0.050000,0.050000},
-{0.518750,0.581250,0.025000,0.025000},
-{0.518750,0.581250,0.050000,0.050000},
-{0.531250,0.581250,0.025000,0.025000},
-{0.531250,0.581250,0.050000,0.050000},
-{0.543750,0.581250,0.025000,0.025000},
-{0.543750,0.581250,0.050000,0.050000},
-{0.556250,0.581250,0.025000,0.025000},
-{0.556250,0.581250,0.050000,0.050000},
-{0.568750,0.581250,0.025000,0.025000},
-{0.568750,0.581250,0.050000,0.050000},
-{0.581250,0.581250,0.025000,0.025000},
-{0.581250,0.581250,0.050000,0.050000},
-{0.593750,0.581250,0.025000,0.025000},
-{0.593750,0.581250,0.050000,0.050000},
-{0.606250,0.581250,0.025000,0.025000},
-{0.606250,0.581250,0.050000,0.050000},
-{0.618750,0.581250,0.025000,0.025000},
-{0.618750,0.581250,0.050000,0.050000},
-{0.631250,0.581250,0.025000,0.025000},
-{0.631250,0.581250,0.050000,0.050000},
-{0.643750,0.581250,0.025000,0.025000},
-{0.643750,0.581250,0.050000,0.050000},
-{0.656250,0.581250,0.025000,0.025000},
-{0.656250,0.581250,0.050000,0.050000},
-{0.668750,0.581250,0.025000,0.025000},
-{0.668750,0.581250,0.050000,0.050000},
-{0.681250,0.581250,0.025000,0.025000},
-{0.681250,0.581250,0.050000,0.050000},
-{0.693750,0.581250,0.025000,0.025000},
-{0.693750,0.581250,0.050000,0.050000},
-{0.706250,0.581250,0.025000,0.025000},
-{0.706250,0.581250,0.050000,0.050000},
-{0.718750,0.581250,0.025000,0.025000},
-{0.718750,0.581250,0.050000,0.050000},
-{0.731250,0.581250,0.025000,0.025000},
-{0.731250,0.581250,0.050000,0.050000},
-{0.743750,0.581250,0.025000,0.025000},
-{0.743750,0.581250,0.050000,0.050000},
-{0.756250,0.581250,0.025000,0.025000},
-{0.756250,0.581250,0.050000,0.050000},
-{0.768750,0.581250,0.025000,0.025000},
-{0.768750,0.581250,0.050000,0.050000},
-{0.781250,0.581250,0.025000,0.025000},
-{0.781250,0.581250,0.050000,0.050000},
-{0.793750,0.581250,0.025000,0.025000},
-{0.793750,0.581250,0.050000,0.050000},
-{0.806250,0.581250,0.025000,0.025000},
-{0.806250,0.581250,0.050000,0.050000},
-{0.818750,0.581250,0.025000,0.025000},
-{0.818750,0.581250,0.050000,0.050000},
-{0.831250,0.581250,0.025000,0.025000},
-{0.831250,0.581250,0.050000,0.050000},
-{0.843750,0.581250,0.025000,0.025000},
-{0.843750,0.581250,0.050000,0.050000},
-{0.856250,0.581250,0.025000,0.025000},
-{0.856250,0.581250,0.050000,0.050000},
-{0.868750,0.581250,0.025000,0.025000},
-{0.868750,0.581250,0.050000,0.050000},
-{0.881250,0.581250,0.025000,0.025000},
-{0.881250,0.581250,0.050000,0.050000},
-{0.893750,0.581250,0.025000,0.025000},
-{0.893750,0.581250,0.050000,0.050000},
-{0.906250,0.581250,0.025000,0.025000},
-{0.906250,0.581250,0.050000,0.050000},
-{0.918750,0.581250,0.025000,0.025000},
-{0.918750,0.581250,0.050000,0.050000},
-{0.931250,0.581250,0.025000,0.025000},
-{0.931250,0.581250,0.050000,0.050000},
-{0.943750,0.581250,0.025000,0.025000},
-{0.943750,0.581250,0.050000,0.050000},
-{0.956250,0.581250,0.025000,0.025000},
-{0.956250,0.581250,0.050000,0.050000},
-{0.968750,0.581250,0.025000,0.025000},
-{0.968750,0.581250,0.050000,0.050000},
-{0.981250,0.581250,0.025000,0.025000},
-{0.981250,0.581250,0.050000,0.050000},
-{0.993750,0.581250,0.025000,0.025000},
-{0.993750,0.581250,0.050000,0.050000},
-{0.006250,0.593750,0.025000,0.025000},
-{0.006250,0.593750,0.050000,0.050000},
-{0.018750,0.593750,0.025000,0.025000},
-{0.018750,0.593750,0.050000,0.050000},
-{0.031250,0.593750,0.025000,0.025000},
-{0.031250,0.593750,0.050000,0.050000},
-{0.043750,0.593750,0.025000,0.025000},
-{0.043750,0.593750,0.050000,0.050000},
-{0.056250,0.593750,0.025000,0.025000},
-{0.056250,0.593750,0.050000,0.050000},
-{0.068750,0.593750,0.025000,0.025000},
-{0.068750,0.593750,0.050000,0.050000},
-{0.081250,0.593750,0.025000,0.025000},
-{0.081250,0.593750,0.050000,0.050000},
-{0.093750,0.593750,0.025000,0.025000},
-{0.093750,0.593750,0.050000,0.050000},
-{0.106250,0.593750,0.025000,0.025000},
-{0.106250,0.593750,0.050000,0.050000},
-{0.118750,0.593750,0.025000,0.025000},
-{0.118750,0.593750,0.050000,0.050000},
-{0.131250,0.593750,0.025000,0.025000},
-{0.131250,0.593750,0.050000,0.050000},
-{0.143750,0.593750,0.025000,0.025000},
-{0.143750,0.593750,0.050000,0.050000},
-{0.156250,0.593750,0.025000,0.025000},
-{0.156250,0.593750,0.050000,0.050000},
-{0.168750,0.593750,0.025000,0.025000},
-{0.168750,0.593750,0.050000,0.050000},
-{0.181250,0.593750,0.025000,0.025000},
-{0.181250,0.593750,0.050000,0.050000},
-{0.193750,0.593750,0.025000,0.025000},
-{0.193750,0.593750,0.050000,0.050000},
-{0.206250,0.593750,0.025000,0.025000},
-{0.206250,0.593750,0.050000,0.050000},
-{0.218750,0.593750,0.025000,0.025000},
-{0.218750,0.593750,0.050000,0.050000},
-{0.231250,0.593750,0.025000,0.025000},
-{0.231250,0.593750,0.050000,0.050000},
-{0.243750,0.593750,0.025000,0.025000},
-{0.243750,0.593750,0.050000,0.050000},
-{0.256250,0.593750,0.025000,0.025000},
-{0.256250,0.593750,0.050000,0.050000},
-{0.268750,0.593750,0.025000,0.025000},
-{0.268750,0.593750,0.050000,0.050000},
-{0.281250,0.593750,0.025000,0.025000},
-{0.281250,0.593750,0.050000,0.050000},
-{0.293750,0.593750,0.025000,0.025000},
-{0.293750,0.593750,0.050000,0.050000},
-{0.306250,0.593750,0.025000,0.025000},
-{0.306250,0.593750,0.050000,0.050000},
-{0.318750,0.593750,0.025000,0.025000},
-{0.318750,0.593750,0.050000,0.050000},
-{0.331250,0.593750,0.025000,0.025000},
-{0.331250,0.593750,0.050000,0.050000},
-{0.343750,0.593750,0.025000,0.025000},
-{0.343750,0.593750,0.050000,0.050000},
-{0.356250,0.593750,0.025000,0.025000},
-{0.356250,0.593750,0.050000,0.050000},
-{0.368750,0.593750,0.025000,0.025000},
-{0.368750,0.593750,0.050000,0.050000},
-{0.381250,0.593750,0.025000,0.025000},
-{0.381250,0.593750,0.050000,0.050000},
-{0.393750,0.593750,0.025000,0.025000},
-{0.393750,0.593750,0.050000,0.050000},
-{0.406250,0.593750,0.025000,0.025000},
-{0.406250,0.593750,0.050000,0.050000},
-{0.418750,0.593750,0.025000,0.025000},
-{0.418750,0.593750,0.050000,0.050000},
-{0.431250,0.593750,0.025000,0.025000},
-{0.431250,0.593750,0.050000,0.050000},
-{0.443750,0.593750,0.025000,0.025000},
-{0.443750,0.593750,0.050000,0.050000},
-{0.456250,0.593750,0.025000,0.025000},
-{0.456250,0.593750,0.050000,0.050000},
-{0.468750,0.593750,0.025000,0.025000},
-{0.468750,0.593750,0.050000,0.050000},
-{0.481250,0.593750,0.025000,0.025000},
-{0.481250,0.593750,0.050000,0.050000},
-{0.493750,0.593750,0.025000,0.025000},
-{0.493750,0.593750,0.050000,0.050000},
-{0.506250,0.593750,0.025000,0.025000},
-{0.506250,0.593750,0.050000,0.050000},
-{0.518750,0.593750,0.025000,0.025000},
-{0.518750,0.593750,0.050000,0.050000},
-{0.531250,0.593750,0.025000,0.025000},
-{0.531250,0.593750,0.050000,0.050000},
-{0.543750,0.593750,0.025000,0.025000},
-{0.543750,0.593750,0.050000,0.050000},
-{0.556250,0.593750,0.025000,0.025000},
-{0.556250,0.593750,0.050000,0.050000},
-{0.568750,0.593750,0.025000,0.025000},
-{0.568750,0.593750,0.050000,0.050000},
-{0.581250,0.593750,0.025000,0.025000},
-{0.581250,0.593750,0.050000,0.050000},
-{0.593750,0.593750,0.025000,0.025000},
-{0.593750,0.593750,0.050000,0.050000},
-{0.606250,0.593750,0.025000,0.025000},
-{0.606250,0.593750,0.050000,0.050000},
-{0.618750,0.593750,0.025000,0.025000},
-{0.618750,0.593750,0.050000,0.050000},
-{0.631250,0.593750,0.025000,0.025000},
-{0.631250,0.593750,0.050000,0.050000},
-{0.643750,0.593750,0.025000,0.025000},
-{0.643750,0.593750,0.050000,0.050000},
-{0.656250,0.593750,0.025000,0.025000},
-{0.656250,0.593750,0.050000,0.050000},
-{0.668750,0.593750,0.025000,0.025000},
-{0.668750,0.593750,0.050000,0.050000},
-{0.681250,0.593750,0.025000,0.025000},
-{0.681250,0.593750,0.050000,0.050000},
-{0.693750,0.593750,0.025000,0.025000},
-{0.693750,0.593750,0.050000,0.050000},
-{0.706250,0.593750,0.025000,0.025000},
-{0.706250,0.593750,0.050000,0.050000},
-{0.718750,0.593750,0.025000,0.025000},
-{0.718750,0.593750,0.050000,0.050000},
-{0.731250,0.593750,0.025000,0.025000},
-{0.731250,0.593750,0.050000,0.050000},
-{0.743750,0.593750,0.025000,0.025000},
-{0.743750,0.593750,0.050000,0.050000},
-{0.756250,0.593750,0.025000,0.025000},
-{0.756250,0.593750,0.050000,0.050000},
-{0.768750,0.593750,0.025000,0.025000},
-{0.768750,0.593750,0.050000,0.050000},
-{0.781250,0.593750,0.025000,0.025000},
-{0.781250,0.593750,0.050000,0.050000},
-{0.793750,0.593750,0.025000,0.025000},
-{0.793750,0.593750,0.050000,0.050000},
-{0.806250,0.593750,0.025000,0.025000},
-{0.806250,0.593750,0.050000,0.050000},
-{0.818750,0.593750,0.025000,0.025000},
-{0.818750,0.593750,0.050000,0.050000},
-{0.831250,0.593750,0.025000,0.025000},
-{0.831250,0.593750,0.050000,0.050000},
-{0.843750,0.593750,0.025000,0.025000},
-{0.843750,0.593750,0.050000,0.050000},
-{0.856250,0.593750,0.025000,0.025000},
-{0.856250,0.593750,0.050000,0.050000},
-{0.868750,0.593750,0.025000,0.025000},
-{0.868750,0.593750,0.050000,0.050000},
-{0.881250,0.593750,0.025000,0.025000},
-{0.881250,0.593750,0.050000,0.050000},
-{0.893750,0.593750,0.025000,0.025000},
-{0.893750,0.593750,0.050000,0.050000},
-{0.906250,0.593750,0.025000,0.025000},
-{0.906250,0.593750,0.050000,0.050000},
-{0.918750,0.593750,0.025000,0.025000},
-{0.918750,0.593750,0.050000,0.050000},
-{0.931250,0.593750,0.025000,0.025000},
-{0.931250,0.593750,0.050000,0.050000},
-{0.943750,0.593750,0.025000,0.025000},
-{0.943750,0.593750,0.050000,0.050000},
-{0.956250,0.593750,0.025000,0.025000},
-{0.956250,0.593750,0.050000,0.050000},
-{0.968750,0.593750,0.025000,0.025000},
-{0.968750,0.593750,0.050000,0.050000},
-{0.981250,0.593750,0.025000,0.025000},
-{0.981250,0.593750,0.050000,0.050000},
-{0.993750,0.593750,0.025000,0.025000},
-{0.993750,0.593750,0.050000,0.050000},
-{0.006250,0.606250,0.025000,0.025000},
-{0.006250,0.606250,0.050000,0.050000},
-{0.018750,0.606250,0.025000,0.025000},
-{0.018750,0.606250,0.050000,0.050000},
-{0.031250,0.606250,0.025000,0.025000},
-{0.031250,0.606250,0.050000,0.050000},
-{0.043750,0.606250,0.025000,0.025000},
-{0.043750,0.606250,0.050000,0.050000},
-{0.056250,0.606250,0.025000,0.025000},
-{0.056250,0.606250,0.050000,0.050000},
-{0.068750,0.606250,0.025000,0.025000},
-{0.068750,0.606250,0.050000,0.050000},
-{0.081250,0.606250,0.025000,0.025000},
-{0.081250,0.606250,0.050000,0.050000},
-{0.093750,0.606250,0.025000,0.025000},
-{0.093750,0.606250,0.050000,0.050000},
-{0.106250,0.606250,0.025000,0.025000},
-{0.106250,0.606250,0.050000,0.050000},
-{0.118750,0.606250,0.025000,0.025000},
-{0.118750,0.606250,0.050000,0.050000},
-{0.131250,0.606250,0.025000,0.025000},
-{0.131250,0.606250,0.050000,0.050000},
-{0.143750,0.606250,0.025000,0.025000},
-{0.143750,0.606250,0.050000,0.050000},
-{0.156250,0.606250,0.025000,0.025000},
-{0.156250,0.606250,0.050000,0.050000},
-{0.168750,0.606250,0.025000,0.025000},
-{0.168750,0.606250,0.050000,0.050000},
-{0.181250,0.606250,0.025000,0.025000},
-{0.181250,0.606250,0.050000,0.050000},
-{0.193750,0.606250,0.025000,0.025000},
-{0.193750,0.606250,0.050000,0.050000},
-{0.206250,0.606250,0.025000,0.025000},
-{0.206250,0.606250,0.050000,0.050000},
-{0.218750,0.606250,0.025000,0.025000},
-{0.218750,0.606250,0.050000,0.050000},
-{0.231250,0.606250,0.025000,0.025000},
-{0.231250,0.606250,0.050000,0.050000},
-{0.243750,0.606250,0.025000,0.025000},
-{0.243750,0.606250,0.050000,0.050000},
-{0.256250,0.606250,0.025000,0.025000},
-{0.256250,0.606250,0.050000,0.050000},
-{0.268750,0.606250,0.025000,0.025000},
-{0.268750,0.606250,0.050000,0.050000},
-{0.281250,0.606250,0.025000,0.025000},
-{0.281250,0.606250,0.050000,0.050000},
-{0.293750,0.606250,0.025000,0.025000},
-{0.293750,0.606250,0.050000,0.050000},
-{0.306250,0.606250,0.025000,0.025000},
-{0.306250,0.606250,0.050000,0.050000},
-{0.318750,0.606250,0.025000,0.025000},
-{0.318750,0.606250,0.050000,0.050000},
-{0.331250,0.606250,0.025000,0.025000},
-{0.331250,0.606250,0.050000,0.050000},
-{0.343750,0.606250,0.025000,0.025000},
-{0.343750,0.606250,0.050000,0.050000},
-{0.356250,0.606250,0.025000,0.025000},
-{0.356250,0.606250,0.050000,0.050000},
-{0.368750,0.606250,0.025000,0.025000},
-{0.368750,0.606250,0.050000,0.050000},
-{0.381250,0.606250,0.025000,0.025000},
-{0.381250,0.606250,0.050000,0.050000},
-{0.393750,0.606250,0.025000,0.025000},
-{0.393750,0.606250,0.050000,0.050000},
-{0.406250,0.606250,0.025000,0.025000},
-{0.406250,0.606250,0.050000,0.050000},
-{0.418750,0.606250,0.025000,0.025000},
-{0.418750,0.606250,0.050000,0.050000},
-{0.431250,0.606250,0.025000,0.025000},
-{0.431250,0.606250,0.050000,0.050000},
-{0.443750,0.606250,0.025000,0.025000},
-{0.443750,0.606250,0.050000,0.050000},
-{0.456250,0.606250,0.025000,0.025000},
-{0.456250,0.606250,0.050000,0.050000},
-{0.468750,0.606250,0.025000,0.025000},
-{0.468750,0.606250,0.050000,0.050000},
-{0.481250,0.606250,0.025000,0.025000},
-{0.481250,0.606250,0.050000,0.050000},
-{0.493750,0.606250,0.025000,0.025000},
-{0.493750,0.606250,0.050000,0.050000},
-{0.506250,0.606250,0.025000,0.025000},
-{0.506250,0.606250,0.050000,0.050000},
-{0.518750,0.606250,0.025000,0.025000},
-{0.518750,0.606250,0.050000,0.050000},
-{0.531250,0.606250,0.025000,0.025000},
-{0.531250,0.606250,0.050000,0.050000},
-{0.543750,0.606250,0.025000,0.025000},
-{0.543750,0.606250,0.050000,0.050000},
-{0.556250,0.606250,0.025000,0.025000},
-{0.556250,0.606250,0.050000,0.050000},
-{0.568750,0.606250,0.025000,0.025000},
-{0.568750,0.606250,0.050000,0.050000},
-{0.581250,0.606250,0.025000,0.025000},
-{0.581250,0.606250,0.050000,0.050000},
-{0.593750,0.606250,0.025000,0.025000},
-{0.593750,0.606250,0.050000,0.050000},
-{0.606250,0.606250,0.025000,0.025000},
-{0.606250,0.606250,0.050000,0.050000},
-{0.618750,0.606250,0.025000,0.025000},
-{0.618750,0.606250,0.050000,0.050000},
-{0.631250,0.606250,0.025000,0.025000},
-{0.631250,0.606250,0.050000,0.050000},
-{0.643750,0.606250,0.025000,0.025000},
-{0.643750,0.606250,0.050000,0.050000},
-{0.656250,0.606250,0.025000,0.025000},
-{0.656250,0.606250,0.050000,0.050000},
-{0.668750,0.606250,0.025000,0.025000},
-{0.668750,0.606250,0.050000,0.050000},
-{0.681250,0.606250,0.025000,0.025000},
-{0.681250,0.606250,0.050000,0.050000},
-{0.693750,0.606250,0.025000,0.025000},
-{0.693750,0.606250,0.050000,0.050000},
-{0.706250,0.606250,0.025000,0.025000},
-{0.706250,0.606250,0.050000,0.050000},
-{0.718750,0.606250,0.025000,0.025000},
-{0.718750,0.606250,0.050000,0.050000},
-{0.731250,0.606250,0.025000,0.025000},
-{0.731250,0.606250,0.050000,0.050000},
-{0.743750,0.606250,0.025000,0.025000},
-{0.743750,0.606250,0.050000,0.050000},
-{0.756250,0.606250,0.025000,0.025000},
-{0.756250,0.606250,0.050000,0.050000},
-{0.768750,0.606250,0.025000,0.025000},
-{0.768750,0.606250,0.050000,0.050000},
-{0.781250,0.606250,0.025000,0.025000},
-{0.781250,0.606250,0.050000,0.050000},
-{0.793750,0.606250,0.025000,0.025000},
-{0.793750,0.606250,0.050000,0.050000},
-{0.806250,0.606250,0.025000,0.025000},
-{0.806250,0.606250,0.050000,0.050000},
-{0.818750,0.606250,0.025000,0.025000},
-{0.818750,0.606250,0.050000,0.050000},
-{0.831250,0.606250,0.025000,0.025000},
-{0.831250,0.606250,0.050000,0.050000},
-{0.843750,0.606250,0.025000,0.025000},
-{0.843750,0.606250,0.050000,0.050000},
-{0.856250,0.606250,0.025000,0.025000},
-{0.856250,0.606250,0.050000,0.050000},
-{0.868750,0.606250,0.025000,0.025000},
-{0.868750,0.606250,0.050000,0.050000},
-{0.881250,0.606250,0.025000,0.025000},
-{0.881250,0.606250,0.050000,0.050000},
-{0.893750,0.606250,0.025000,0.025000},
-{0.893750,0.606250,0.050000,0.050000},
-{0.906250,0.606250,0.025000,0.025000},
-{0.906250,0.606250,0.050000,0.050000},
-{0.918750,0.606250,0.025000,0.025000},
-{0.918750,0.606250,0.050000,0.050000},
-{0.931250,0.606250,0.025000,0.025000},
-{0.931250,0.606250,0.050000,0.050000},
-{0.943750,0.606250,0.025000,0.025000},
-{0.943750,0.606250,0.050000,0.050000},
-{0.956250,0.606250,0.025000,0.025000},
-{0.956250,0.606250,0.050000,0.050000},
-{0.968750,0.606250,0.025000,0.025000},
-{0.968750,0.606250,0.050000,0.050000},
-{0.981250,0.606250,0.025000,0.025000},
-{0.981250,0.606250,0.050000,0.050000},
-{0.993750,0.606250,0.025000,0.025000},
-{0.993750,0.606250,0.050000,0.050000},
-{0.006250,0.618750,0.025000,0.025000},
-{0.006250,0.618750,0.050000,0.050000},
-{0.018750,0.618750,0.025000,0.025000},
-{0.018750,0.618750,0.050000,0.050000},
-{0.031250,0.618750,0.025000,0.025000},
-{0.031250,0.618750,0.050000,0.050000},
-{0.043750,0.618750,0.025000,0.025000},
-{0.043750,0.618750,0.050000,0.050000},
-{0.056250,0.618750,0.025000,0.025000},
-{0.056250,0.618750,0.050000,0.050000},
-{0.068750,0.618750,0.025000,0.025000},
-{0.068750,0.618750,0.050000,0.050000},
-{0.081250,0.618750,0.025000,0.025000},
-{0.081250,0.618750,0.050000,0.050000},
-{0.093750,0.618750,0.025000,0.025000},
-{0.093750,0.618750,0.050000,0.050000},
-{0.106250,0.618750,0.025000,0.025000},
-{0.106250,0.618750,0.050000,0.050000},
-{0.118750,0.618750,0.025000,0.025000},
-{0.118750,0.618750,0.050000,0.050000},
-{0.131250,0.618750,0.025000,0.025000},
-{0.131250,0.618750,0.050000,0.050000},
-{0.143750,0.618750,0.025000,0.025000},
-{0.143750,0.618750,0.050000,0.050000},
-{0.156250,0.618750,0.025000,0.025000},
-{0.156250,0.618750,0.050000,0.050000},
-{0.168750,0.618750,0.025000,0.025000},
-{0.168750,0.618750,0.050000,0.050000},
-{0.181250,0.618750,0.025000,0.025000},
-{0.181250,0.618750,0.050000,0.050000},
-{0.193750,0.618750,0.025000,0.025000},
-{0.193750,0.618750,0.050000,0.050000},
-{0.206250,0.618750,0.025000,0.025000},
-{0.206250,0.618750,0.050000,0.050000},
-{0.218750,0.618750,0.025000,0.025000},
-{0.218750,0.618750,0.050000,0.050000},
-{0.231250,0.618750,0.025000,0.025000},
-{0.231250,0.618750,0.050000,0.050000},
-{0.243750,0.618750,0.025000,0.025000},
-{0.243750,0.618750,0.050000,0.050000},
-{0.256250,0.618750,0.025000,0.025000},
-{0.256250,0.618750,0.050000,0.050000},
-{0.268750,0.618750,0.025000,0.025000},
-{0.268750,0.618750,0.050000,0.050000},
-{0.281250,0.618750,0.025000,0.025000},
-{0.281250,0.618750,0.050000,0.050000},
-{0.293750,0.618750,0.025000,0.025000},
-{0.293750,0.618750,0.050000,0.050000},
-{0.306250,0.618750,0.025000,0.025000},
-{0.306250,0.618750,0.050000,0.050000},
-{0.318750,0.618750,0.025000,0.025000},
-{0.318750,0.618750,0.050000,0.050000},
-{0.331250,0.618750,0.025000,0.025000},
-{0.331250,0.618750,0.050000,0.050000},
-{0.343750,0.618750,0.025000,0.025000},
-{0.343750,0.618750,0.050000,0.050000},
-{0.356250,0.618750,0.025000,0.025000},
-{0.356250,0.618750,0.050000,0.050000},
-{0.368750,0.618750,0.025000,0.025000},
-{0.368750,0.618750,0.050000,0.050000},
-{0.381250,0.618750,0.025000,0.025000},
-{0.381250,0.618750,0.050000,0.050000},
-{0.393750,0.618750,0.025000,0.025000},
-{0.393750,0.618750,0.050000,0.050000},
-{0.406250,0.618750,0.025000,0.025000},
-{0.406250,0.618750,0.050000,0.050000},
-{0.418750,0.618750,0.025000,0.025000},
-{0.418750,0.618750,0.050000,0.050000},
-{0.431250,0.618750,0.025000,0.025000},
-{0.431250,0.618750,0.050000,0.050000},
-{0.443750,0.618750,0.025000,0.025000},
-{0.443750,0.618750,0.050000,0.050000},
-{0.456250,0.618750,0.025000,0.025000},
-{0.456250,0.618750,0.050000,0.050000},
-{0.468750,0.618750,0.025000,0.025000},
-{0.468750,0.618750,0.050000,0.050000},
-{0.481250,0.618750,0.025000,0.025000},
-{0.481250,0.618750,0.050000,0.050000},
-{0.493750,0.618750,0.025000,0.025000},
-{0.493750,0.618750,0.050000,0.050000},
-{0.506250,0.618750,0.025000,0.025000},
-{0.506250,0.618750,0.050000,0.050000},
-{0.518750,0.618750,0.025000,0.025000},
-{0.518750,0.618750,0.050000,0.050000},
-{0.531250,0.618750,0.025000,0.025000},
-{0.531250,0.618750,0.050000,0.050000},
-{0.543750,0.618750,0.025000,0.025000},
-{0.543750,0.618750,0.050000,0.050000},
-{0.556250,0.618750,0.025000,0.025000},
-{0.556250,0.618750,0.050000,0.050000},
-{0.568750,0.618750,0.025000,0.025000},
-{0.568750,0.618750,0.050000,0.050000},
-{0.581250,0.618750,0.025000,0.025000},
-{0.581250,0.618750,0.050000,0.050000},
-{0.593750,0.618750,0.025000,0.025000},
-{0.593750,0.618750,0.050000,0.050000},
-{0.606250,0.618750,0.025000,0.025000},
-{0.606250,0.618750,0.050000,0.050000},
-{0.618750,0.618750,0.025000,0.025000},
-{0.618750,0.618750,0.050000,0.050000},
-{0.631250,0.618750,0.025000,0.025000},
-{0.631250,0.618750,0.050000,0.050000},
-{0.643750,0.618750,0.025000,0.025000},
-{0.643750,0.618750,0.050000,0.050000},
-{0.656250,0.618750,0.025000,0.025000},
-{0.656250,0.618750,0.050000,0.050000},
-{0.668750,0.618750,0.025000,0.025000},
-{0.668750,0.618750,0.050000,0.050000},
-{0.681250,0.618750,0.025000,0.025000},
-{0.681250,0.618750,0.050000,0.050000},
-{0.693750,0.618750,0.025000,0.025000},
-{0.693750,0.618750,0.050000,0.050000},
-{0.706250,0.618750,0.025000,0.025000},
-{0.706250,0.618750,0.050000,0.050000},
-{0.718750,0.618750,0.025000,0.025000},
-{0.718750,0.618750,0.050000,0.050000},
-{0.731250,0.618750,0.025000,0.025000},
-{0.731250,0.618750,0.050000,0.050000},
-{0.743750,0.618750,0.025000,0.025000},
-{0.743750,0.618750,0.050000,0.050000},
-{0.756250,0.618750,0.025000,0.025000},
-{0.756250,0.618750,0.050000,0.050000},
-{0.768750,0.618750,0.025000,0.025000},
-{0.768750,0.618750,0.050000,0.050000},
-{0.781250,0.618750,0.025000,0.025000},
-{0.781250,0.618750,0.050000,0.050000},
-{0.793750,0.618750,0.025000,0.025000},
-{0.793750,0.618750,0.050000,0.050000},
-{0.806250,0.618750,0.025000,0.025000},
-{0.806250,0.618750,0.050000,0.050000},
-{0.818750,0.618750,0.025000,0.025000},
-{0.818750,0.618750,0.050000,0.050000},
-{0.831250,0.618750,0.025000,0.025000},
-{0.831250,0.618750,0.050000,0.050000},
-{0.843750,0.618750,0.025000,0.025000},
-{0.843750,0.618750,0.050000,0.050000},
-{0.856250,0.618750,0.025000,0.025000},
-{0.856250,0.618750,0.050000,0.050000},
-{0.868750,0.618750,0.025000,0.025000},
-{0.868750,0.618750,0.050000,0.050000},
-{0.881250,0.618750,0.025000,0.025000},
-{0.881250,0.618750,0.050000,0.050000},
-{0.893750,0.618750,0.025000,0.025000},
-{0.893750,0.618750,0.050000,0.050000},
-{0.906250,0.618750,0.025000,0.025000},
-{0.906250,0.618750,0.050000,0.050000},
-{0.918750,0.618750,0.025000,0.025000},
-{0.918750,0.618750,0.050000,0.050000},
-{0.931250,0.618750,0.025000,0.025000},
-{0.931250,0.618750,0.050000,0.050000},
-{0.943750,0.618750,0.025000,0.025000},
-{0.943750,0.618750,0.050000,0.050000},
-{0.956250,0.618750,0.025000,0.025000},
-{0.956250,0.618750,0.050000,0.050000},
-{0.968750,0.618750,0.025000,0.025000},
-{0.968750,0.618750,0.050000,0.050000},
-{0.981250,0.618750,0.025000,0.025000},
-{0.981250,0.618750,0.050000,0.050000},
-{0.993750,0.618750,0.025000,0.025000},
-{0.993750,0.618750,0.050000,0.050000},
-{0.006250,0.631250,0.025000,0.025000},
-{0.006250,0.631250,0.050000,0.050000},
-{0.018750,0.631250,0.025000,0.025000},
-{0.018750,0.631250,0.050000,0.050000},
-{0.031250,0.631250,0.025000,0.025000},
-{0.031250,0.631250,0.050000,0.050000},
-{0.043750,0.631250,0.025000,0.025000},
-{0.043750,0.631250,0.050000,0.050000},
-{0.056250,0.631250,0.025000,0.025000},
-{0.056250,0.631250,0.050000,0.050000},
-{0.068750,0.631250,0.025000,0.025000},
-{0.068750,0.631250,0.050000,0.050000},
-{0.081250,0.631250,0.025000,0.025000},
-{0.081250,0.631250,0.050000,0.050000},
-{0.093750,0.631250,0.025000,0.025000},
-{0.093750,0.631250,0.050000,0.050000},
-{0.106250,0.631250,0.025000,0.025000},
-{0.106250,0.631250,0.050000,0.050000},
-{0.118750,0.631250,0.025000,0.025000},
-{0.118750,0.631250,0.050000,0.050000},
-{0.131250,0.631250,0.025000,0.025000},
-{0.131250,0.631250,0.050000,0.050000},
-{0.143750,0.631250,0.025000,0.025000},
-{0.143750,0.631250,0.050000,0.050000},
-{0.156250,0.631250,0.025000,0.025000},
-{0.156250,0.631250,0.050000,0.050000},
-{0.168750,0.631250,0.025000,0.025000},
-{0.168750,0.631250,0.050000,0.050000},
-{0.181250,0.631250,0.025000,0.025000},
-{0.181250,0.631250,0.050000,0.050000},
-{0.193750,0.631250,0.025000,0.025000},
-{0.193750,0.631250,0.050000,0.050000},
-{0.206250,0.631250,0.025000,0.025000},
-{0.206250,0.631250,0.050000,0.050000},
-{0.218750,0.631250,0.025000,0.025000},
-{0.218750,0.631250,0.050000,0.050000},
-{0.231250,0.631250,0.025000,0.025000},
-{0.231250,0.631250,0.050000,0.050000},
-{0.243750,0.631250,0.025000,0.025000},
-{0.243750,0.631250,0.050000,0.050000},
-{0.256250,0.631250,0.025000,0.025000},
-{0.256250,0.631250,0.050000,0.050000},
-{0.268750,0.631250,0.025000,0.025000},
-{0.268750,0.631250,0.050000,0.050000},
-{0.281250,0.631250,0.025000,0.025000},
-{0.281250,0.631250,0.050000,0.050000},
-{0.293750,0.631250,0.025000,0.025000},
-{0.293750,0.631250,0.050000,0.050000},
-{0.306250,0.631250,0.025000,0.025000},
-{0.306250,0.631250,0.050000,0.050000},
-{0.318750,0.631250,0.025000,0.025000},
-{0.318750,0.631250,0.050000,0.050000},
-{0.331250,0.631250,0.025000,0.025000},
-{0.331250,0.631250,0.050000,0.050000},
-{0.343750,0.631250,0.025000,0.025000},
-{0.343750,0.631250,0.050000,0.050000},
-{0.356250,0.631250,0.025000,0.025000},
-{0.356250,0.631250,0.050000,0.050000},
-{0.368750,0.631250,0.025000,0.025000},
-{0.368750,0.631250,0.050000,0.050000},
-{0.381250,0.631250,0.025000,0.025000},
-{0.381250,0.631250,0.050000,0.050000},
-{0.393750,0.631250,0.025000,0.025000},
-{0.393750,0.631250,0.050000,0.050000},
-{0.406250,0.631250,0.025000,0.025000},
-{0.406250,0.631250,0.050000,0.050000},
-{0.418750,0.631250,0.025000,0.025000},
-{0.418750,0.631250,0.050000,0.050000},
-{0.431250,0.631250,0.025000,0.025000},
-{0.431250,0.631250,0.050000,0.050000},
-{0.443750,0.631250,0.025000,0.025000},
-{0.443750,0.631250,0.050000,0.050000},
-{0.456250,0.631250,0.025000,0.025000},
-{0.456250,0.631250,0.050000,0.050000},
-{0.468750,0.631250,0.025000,0.025000},
-{0.468750,0.631250,0.050000,0.050000},
-{0.481250,0.631250,0.025000,0.025000},
-{0.481250,0.631250,0.050000,0.050000},
-{0.493750,0.631250,0.025000,0.025000},
-{0.493750,0.631250,0.050000,0.050000},
-{0.506250,0.631250,0.025000,0.025000},
-{0.506250,0.631250,0.050000,0.050000},
-{0.518750,0.631250,0.025000,0.025000},
-{0.518750,0.631250,0.050000,0.050000},
-{0.531250,0.631250,0.025000,0.025000},
-{0.531250,0.631250,0.050000,0.050000},
-{0.543750,0.631250,0.025000,0.025000},
-{0.543750,0.631250,0.050000,0.050000},
-{0.556250,0.631250,0.025000,0.025000},
-{0.556250,0.631250,0.050000,0.050000},
-{0.568750,0.631250,0.025000,0.025000},
-{0.568750,0.631250,0.050000,0.050000},
-{0.581250,0.631250,0.025000,0.025000},
-{0.581250,0.631250,0.050000,0.050000},
-{0.593750,0.631250,0.025000,0.025000},
-{0.593750,0.631250,0.050000,0.050000},
-{0.606250,0.631250,0.025000,0.025000},
-{0.606250,0.631250,0.050000,0.050000},
-{0.618750,0.631250,0.025000,0.025000},
-{0.618750,0.631250,0.050000,0.050000},
-{0.631250,0.631250,0.025000,0.025000},
-{0.631250,0.631250,0.050000,0.050000},
-{0.643750,0.631250,0.025000,0.025000},
-{0.643750,0.631250,0.050000,0.050000},
-{0.656250,0.631250,0.025000,0.025000},
-{0.656250,0.631250,0.050000,0.050000},
-{0.668750,0.631250,0.025000,0.025000},
-{0.668750,0.631250,0.050000,0.050000},
-{0.681250,0.631250,0.025000,0.025000},
-{0.681250,0.631250,0.050000,0.050000},
-{0.693750,0.631250,0.025000,0.025000},
-{0.693750,0.631250,0.050000,0.050000},
-{0.706250,0.631250,0.025000,0.025000},
-{0.706250,0.631250,0.050000,0.050000},
-{0.718750,0.631250,0.025000,0.025000},
-{0.718750,0.631250,0.050000,0.050000},
-{0.731250,0.631250,0.025000,0.025000},
-{0.731250,0.631250,0.050000,0.050000},
-{0.743750,0.631250,0.025000,0.025000},
-{0.743750,0.631250,0.050000,0.050000},
-{0.756250,0.631250,0.025000,0.025000},
-{0.756250,0.631250,0.050000,0.050000},
-{0.768750,0.631250,0.025000,0.025000},
-{0.768750,0.631250,0.050000,0.050000},
-{0.781250,0.631250,0.025000,0.025000},
-{0.781250,0.631250,0.050000,0.050000},
-{0.793750,0.631250,0.025000,0.025000},
-{0.793750,0.631250,0.050000,0.050000},
-{0.806250,0.631250,0.025000,0.025000},
-{0.806250,0.631250,0.050000,0.050000},
-{0.818750,0.631250,0.025000,0.025000},
-{0.818750,0.631250,0.050000,0.050000},
-{0.831250,0.631250,0.025000,0.025000},
-{0.831250,0.631250,0.050000,0.050000},
-{0.843750,0.631250,0.025000,0.025000},
-{0.843750,0.631250,0.050000,0.050000},
-{0.856250,0.631250,0.025000,0.025000},
-{0.856250,0.631250,0.050000,0.050000},
-{0.868750,0.631250,0.025000,0.025000},
-{0.868750,0.631250,0.050000,0.050000},
-{0.881250,0.631250,0.025000,0.025000},
-{0.881250,0.631250,0.050000,0.050000},
-{0.893750,0.631250,0.025000,0.025000},
-{0.893750,0.631250,0.050000,0.050000},
-{0.906250,0.631250,0.025000,0.025000},
-{0.906250,0.631250,0.050000,0.050000},
-{0.918750,0.631250,0.025000,0.025000},
-{0.918750,0.631250,0.050000,0.050000},
-{0.931250,0.631250,0.025000,0.025000},
-{0.931250,0.631250,0.050000,0.050000},
-{0.943750,0.631250,0.025000,0.025000},
-{0.943750,0.631250,0.050000,0.050000},
-{0.956250,0.631250,0.025000,0.025000},
-{0.956250,0.631250,0.050000,0.050000},
-{0.968750,0.631250,0.025000,0.025000},
-{0.968750,0.631250,0.050000,0.050000},
-{0.981250,0.631250,0.025000,0.025000},
-{0.981250,0.631250,0.050000,0.050000},
-{0.993750,0.631250,0.025000,0.025000},
-{0.993750,0.631250,0.050000,0.050000},
-{0.006250,0.643750,0.025000,0.025000},
-{0.006250,0.643750,0.050000,0.050000},
-{0.018750,0.643750,0.025000,0.025000},
-{0.018750,0.643750,0.050000,0.050000},
-{0.031250,0.643750,0.025000,0.025000},
-{0.031250,0.643750,0.050000,0.050000},
-{0.043750,0.643750,0.025000,0.025000},
-{0.043750,0.643750,0.050000,0.050000},
-{0.056250,0.643750,0.025000,0.025000},
-{0.056250,0.643750,0.050000,0.050000},
-{0.068750,0.643750,0.025000,0.025000},
-{0.068750,0.643750,0.050000,0.050000},
-{0.081250,0.643750,0.025000,0.025000},
-{0.081250,0.643750,0.050000,0.050000},
-{0.093750,0.643750,0.025000,0.025000},
-{0.093750,0.643750,0.050000,0.050000},
-{0.106250,0.643750,0.025000,0.025000},
-{0.106250,0.643750,0.050000,0.050000},
-{0.118750,0.643750,0.025000,0.025000},
-{0.118750,0.643750,0.050000,0.050000},
-{0.131250,0.643750,0.025000,0.025000},
-{0.131250,0.643750,0.050000,0.050000},
-{0.143750,0.643750,0.025000,0.025000},
-{0.143750,0.643750,0.050000,0.050000},
-{0.156250,0.643750,0.025000,0.025000},
-{0.156250,0.643750,0.050000,0.050000},
-{0.168750,0.643750,0.025000,0.025000},
-{0.168750,0.643750,0.050000,0.050000},
-{0.181250,0.643750,0.025000,0.025000},
-{0.181250,0.643750,0.050000,0.050000},
-{0.193750,0.643750,0.025000,0.025000},
-{0.193750,0.643750,0.050000,0.050000},
-{0.206250,0.643750,0.025000,0.025000},
-{0.206250,0.643750,0.050000,0.050000},
-{0.218750,0.643750,0.025000,0.025000},
-{0.218750,0.643750,0.050000,0.050000},
-{0.231250,0.643750,0.025000,0.025000},
-{0.231250,0.643750,0.050000,0.050000},
-{0.243750,0.643750,0.025000,0.025000},
-{0.243750,0.643750,0.050000,0.050000},
-{0.256250,0.643750,0.025000,0.025000},
-{0.256250,0.643750,0.050000,0.050000},
-{0.268750,0.643750,0.025000,0.025000},
-{0.268750,0.643750,0.050000,0.050000},
-{0.281250,0.643750,0.025000,0.025000},
-{0.281250,0.643750,0.050000,0.050000},
-{0.293750,0.643750,0.025000,0.025000},
-{0.293750,0.643750,0.050000,0.050000},
-{0.306250,0.643750,0.025000,0.025000},
-{0.306250,0.643750,0.050000,0.050000},
-{0.318750,0.643750,0.025000,0.025000},
-{0.318750,0.643750,0.050000,0.050000},
-{0.331250,0.643750,0.025000,0.025000},
-{0.331250,0.643750,0.050000,0.050000},
-{0.343750,0.643750,0.025000,0.025000},
-{0.343750,0.643750,0.050000,0.050000},
-{0.356250,0.643750,0.025000,0.025000},
-{0.356250,0.643750,0.050000,0.050000},
-{0.368750,0.643750,0.025000,0.025000},
-{0.368750,0.643750,0.050000,0.050000},
-{0.381250,0.643750,0.025000,0.025000},
-{0.381250,0.643750,0.050000,0.050000},
-{0.393750,0.643750,0.025000,0.025000},
-{0.393750,0.643750,0.050000,0.050000},
-{0.406250,0.643750,0.025000,0.025000},
-{0.406250,0.643750,0.050000,0.050000},
-{0.418750,0.643750,0.025000,0.025000},
-{0.418750,0.643750,0.050000,0.050000},
-{0.431250,0.643750,0.025000,0.025000},
-{0.431250,0.643750,0.050000,0.050000},
-{0.443750,0.643750,0.025000,0.025000},
-{0.443750,0.643750,0.050000,0.050000},
-{0.456250,0.643750,0.025000,0.025000},
-{0.456250,0.643750,0.050000,0.050000},
-{0.468750,0.643750,0.025000,0.025000},
-{0.468750,0.643750,0.050000,0.050000},
-{0.481250,0.643750,0.025000,0.025000},
-{0.481250,0.643750,0.050000,0.050000},
-{0.493750,0.643750,0.025000,0.025000},
-{0.493750,0.643750,0.050000,0.050000},
-{0.506250,0.643750,0.025000,0.025000},
-{0.506250,0.643750,0.050000,0.050000},
-{0.518750,0.643750,0.025000,0.025000},
-{0.518750,0.643750,0.050000,0.050000},
-{0.531250,0.643750,0.025000,0.025000},
-{0.531250,0.643750,0.050000,0.050000},
-{0.543750,0.643750,0.025000,0.025000},
-{0.543750,0.643750,0.050000,0.050000},
-{0.556250,0.643750,0.025000,0.025000},
-{0.556250,0.643750,0.050000,0.050000},
-{0.568750,0.643750,0.025000,0.025000},
-{0.568750,0.643750,0.050000,0.050000},
-{0.581250,0.643750,0.025000,0.025000},
-{0.581250,0.643750,0.050000,0.050000},
-{0.593750,0.643750,0.025000,0.025000},
-{0.593750,0.643750,0.050000,0.050000},
-{0.606250,0.643750,0.025000,0.025000},
-{0.606250,0.643750,0.050000,0.050000},
-{0.618750,0.643750,0.025000,0.025000},
-{0.618750,0.643750,0.050000,0.050000},
-{0.631250,0.643750,0.025000,0.025000},
-{0.631250,0.643750,0.050000,0.050000},
-{0.643750,0.643750,0.025000,0.025000},
-{0.643750,0.643750,0.050000,0.050000},
-{0.656250,0.643750,0.025000,0.025000},
-{0.656250,0.643750,0.050000,0.050000},
-{0.668750,0.643750,0.025000,0.025000},
-{0.668750,0.643750,0.050000,0.050000},
-{0.681250,0.643750,0.025000,0.025000},
-{0.681250,0.643750,0.050000,0.050000},
-{0.693750,0.643750,0.025000,0.025000},
-{0.693750,0.643750,0.050000,0.050000},
-{0.706250,0.643750,0.025000,0.025000},
-{0.706250,0.643750,0.050000,0.050000},
-{0.718750,0.643750,0.025000,0.025000},
-{0.718750,0.643750,0.050000,0.050000},
-{0.731250,0.643750,0.025000,0.025000},
-{0.731250,0.643750,0.050000,0.050000},
-{0.743750,0.643750,0.025000,0.025000},
-{0.743750,0.643750,0.050000,0.050000},
-{0.756250,0.643750,0.025000,0.025000},
-{0.756250,0.643750,0.050000,0.050000},
-{0.768750,0.643750,0.025000,0.025000},
-{0.768750,0.643750,0.050000,0.050000},
-{0.781250,0.643750,0.025000,0.025000},
-{0.781250,0.643750,0.050000,0.050000},
-{0.793750,0.643750,0.025000,0.025000},
-{0.793750,0.643750,0.050000,0.050000},
-{0.806250,0.643750,0.025000,0.025000},
-{0.806250,0.643750,0.050000,0.050000},
-{0.818750,0.643750,0.025000,0.025000},
-{0.818750,0.643750,0.050000,0.050000},
-{0.831250,0.643750,0.025000,0.025000},
-{0.831250,0.643750,0.050000,0.050000},
-{0.843750,0.643750,0.025000,0.025000},
-{0.843750,0.643750,0.050000,0.050000},
-{0.856250,0.643750,0.025000,0.025000},
-{0.856250,0.643750,0.050000,0.050000},
-{0.868750,0.643750,0.025000,0.025000},
-{0.868750,0.643750,0.050000,0.050000},
-{0.881250,0.643750,0.025000,0.025000},
-{0.881250,0.643750,0.050000,0.050000},
-{0.893750,0.643750,0.025000,0.025000},
-{0.893750,0.643750,0.050000,0.050000},
-{0.906250,0.643750,0.025000,0.025000},
-{0.906250,0.643750,0.050000,0.050000},
-{0.918750,0.643750,0.025000,0.025000},
-{0.918750,0.643750,0.050000,0.050000},
-{0.931250,0.643750,0.025000,0.025000},
-{0.931250,0.643750,0.050000,0.050000},
-{0.943750,0.643750,0.025000,0.025000},
-{0.943750,0.643750,0.050000,0.050000},
-{0.956250,0.643750,0.025000,0.025000},
-{0.956250,0.643750,0.050000,0.050000},
-{0.968750,0.643750,0.025000,0.025000},
-{0.968750,0.643750,0.050000,0.050000},
-{0.981250,0.643750,0.025000,0.025000},
-{0.981250,0.643750,0.050000,0.050000},
-{0.993750,0.643750,0.025000,0.025000},
-{0.993750,0.643750,0.050000,0.050000},
-{0.006250,0.656250,0.025000,0.025000},
-{0.006250,0.656250,0.050000,0.050000},
-{0.018750,0.656250,0.025000,0.025000},
-{0.018750,0.656250,0.050000,0.050000},
-{0.031250,0.656250,0.025000,0.025000},
-{0.031250,0.656250,0.050000,0.050000},
-{0.043750,0.656250,0.025000,0.025000},
-{0.043750,0.656250,0.050000,0.050000},
-{0.056250,0.656250,0.025000,0.025000},
-{0.056250,0.656250,0.050000,0.050000},
-{0.068750,0.656250,0.025000,0.025000},
-{0.068750,0.656250,0.050000,0.050000},
-{0.081250,0.656250,0.025000,0.025000},
-{0.081250,0.656250,0.050000,0.050000},
-{0.093750,0.656250,0.025000,0.025000},
-{0.093750,0.656250,0.050000,0.050000},
-{0.106250,0.656250,0.025000,0.025000},
-{0.106250,0.656250,0.050000,0.050000},
-{0.118750,0.656250,0.025000,0.025000},
-{0.118750,0.656250,0.050000,0.050000},
-{0.131250,0.656250,0.025000,0.025000},
-{0.131250,0.656250,0.050000,0.050000},
-{0.143750,0.656250,0.025000,0.025000},
-{0.143750,0.656250,0.050000,0.050000},
-{0.156250,0.656250,0.025000,0.025000},
-{0.156250,0.656250,0.050000,0.050000},
-{0.168750,0.656250,0.025000,0.025000},
-{0.168750,0.656250,0.050000,0.050000},
-{0.181250,0.656250,0.025000,0.025000},
-{0.181250,0.656250,0.050000,0.050000},
-{0.193750,0.656250,0.025000,0.025000},
-{0.193750,0.656250,0.050000,0.050000},
-{0.206250,0.656250,0.025000,0.025000},
-{0.206250,0.656250,0.050000,0.050000},
-{0.218750,0.656250,0.025000,0.025000},
-{0.218750,0.656250,0.050000,0.050000},
-{0.231250,0.656250,0.025000,0.025000},
-{0.231250,0.656250,0.050000,0.050000},
-{0.243750,0.656250,0.025000,0.025000},
-{0.243750,0.656250,0.050000,0.050000},
-{0.256250,0.656250,0.025000,0.025000},
-{0.256250,0.656250,0.050000,0.050000},
-{0.268750,0.656250,0.025000,0.025000},
-{0.268750,0.656250,0.050000,0.050000},
-{0.281250,0.656250,0.025000,0.025000},
-{0.281250,0.656250,0.050000,0.050000},
-{0.293750,0.656250,0.025000,0.025000},
-{0.293750,0.656250,0.050000,0.050000},
-{0.306250,0.656250,0.025000,0.025000},
-{0.306250,0.656250,0.050000,0.050000},
-{0.318750,0.656250,0.025000,0.025000},
-{0.318750,0.656250,0.050000,0.050000},
-{0.331250,0.656250,0.025000,0.025000},
-{0.331250,0.656250,0.050000,0.050000},
-{0.343750,0.656250,0.025000,0.025000},
-{0.343750,0.656250,0.050000,0.050000},
-{0.356250,0.656250,0.025000,0.025000},
-{0.356250,0.656250,0.050000,0.050000},
-{0.368750,0.656250,0.025000,0.025000},
-{0.368750,0.656250,0.050000,0.050000},
-{0.381250,0.656250,0.025000,0.025000},
-{0.381250,0.656250,0.050000,0.050000},
-{0.393750,0.656250,0.025000,0.025000},
-{0.393750,0.656250,0.050000,0.050000},
-{0.406250,0.656250,0.025000,0.025000},
-{0.406250,0.656250,0.050000,0.050000},
-{0.418750,0.656250,0.025000,0.025000},
-{0.418750,0.656250,0.050000,0.050000},
-{0.431250,0.656250,0.025000,0.025000},
-{0.431250,0.656250,0.050000,0.050000},
-{0.443750,0.656250,0.025000,0.025000},
-{0.443750,0.656250,0.050000,0.050000},
-{0.456250,0.656250,0.025000,0.025000},
-{0.456250,0.656250,0.050000,0.050000},
-{0.468750,0.656250,0.025000,0.025000},
-{0.468750,0.656250,0.050000,0.050000},
-{0.481250,0.656250,0.025000,0.025000},
-{0.481250,0.656250,0.050000,0.050000},
-{0.493750,0.656250,0.025000,0.025000},
-{0.493750,0.656250,0.050000,0.050000},
-{0.506250,0.656250,0.025000,0.025000},
-{0.506250,0.656250,0.050000,0.050000},
-{0.518750,0.656250,0.025000,0.025000},
-{0.518750,0.656250,0.050000,0.050000},
-{0.531250,0.656250,0.025000,0.025000},
-{0.531250,0.656250,0.050000,0.050000},
-{0.543750,0.656250,0.025000,0.025000},
-{0.543750,0.656250,0.050000,0.050000},
-{0.556250,0.656250,0.025000,0.025000},
-{0.556250,0.656250,0.050000,0.050000},
-{0.568750,0.656250,0.025000,0.025000},
-{0.568750,0.656250,0.050000,0.050000},
-{0.581250,0.656250,0.025000,0.025000},
-{0.581250,0.656250,0.050000,0.050000},
-{0.593750,0.656250,0.025000,0.025000},
-{0.593750,0.656250,0.050000,0.050000},
-{0.606250,0.656250,0.025000,0.025000},
-{0.606250,0.656250,0.050000,0.050000},
-{0.618750,0.656250,0.025000,0.025000},
-{0.618750,0.656250,0.050000,0.050000},
-{0.631250,0.656250,0.025000,0.025000},
-{0.631250,0.656250,0.050000,0.050000},
-{0.643750,0.656250,0.025000,0.025000},
-{0.643750,0.656250,0.050000,0.050000},
-{0.656250,0.656250,0.025000,0.025000},
-{0.656250,0.656250,0.050000,0.050000},
-{0.668750,0.656250,0.025000,0.025000},
-{0.668750,0.656250,0.050000,0.050000},
-{0.681250,0.656250,0.025000,0.025000},
-{0.681250,0.656250,0.050000,0.050000},
-{0.693750,0.656250,0.025000,0.025000},
-{0.693750,0.656250,0.050000,0.050000},
-{0.706250,0.656250,0.025000,0.025000},
-{0.706250,0.656250,0.050000,0.050000},
-{0.718750,0.656250,0.025000,0.025000},
-{0.718750,0.656250,0.050000,0.050000},
-{0.731250,0.656250,0.025000,0.025000},
-{0.731250,0.656250,0.050000,0.050000},
-{0.743750,0.656250,0.025000,0.025000},
-{0.743750,0.656250,0.050000,0.050000},
-{0.756250,0.656250,0.025000,0.025000},
-{0.756250,0.656250,0.050000,0.050000},
-{0.768750,0.656250,0.025000,0.025000},
-{0.768750,0.656250,0.050000,0.050000},
-{0.781250,0.656250,0.025000,0.025000},
-{0.781250,0.656250,0.050000,0.050000},
-{0.793750,0.656250,0.025000,0.025000},
-{0.793750,0.656250,0.050000,0.050000},
-{0.806250,0.656250,0.025000,0.025000},
-{0.806250,0.656250,0.050000,0.050000},
-{0.818750,0.656250,0.025000,0.025000},
-{0.818750,0.656250,0.050000,0.050000},
-{0.831250,0.656250,0.025000,0.025000},
-{0.831250,0.656250,0.050000,0.050000},
-{0.843750,0.656250,0.025000,0.025000},
-{0.843750,0.656250,0.050000,0.050000},
-{0.856250,0.656250,0.025000,0.025000},
-{0.856250,0.656250,0.050000,0.050000},
-{0.868750,0.656250,0.025000,0.025000},
-{0.868750,0.656250,0.050000,0.050000},
-{0.881250,0.656250,0.025000,0.025000},
-{0.881250,0.656250,0.050000,0.050000},
-{0.893750,0.656250,0.025000,0.025000},
-{0.893750,0.656250,0.050000,0.050000},
-{0.906250,0.656250,0.025000,0.025000},
-{0.906250,0.656250,0.050000,0.050000},
-{0.918750,0.656250,0.025000,0.025000},
-{0.918750,0.656250,0.050000,0.050000},
-{0.931250,0.656250,0.025000,0.025000},
-{0.931250,0.656250,0.050000,0.050000},
-{0.943750,0.656250,0.025000,0.025000},
-{0.943750,0.656250,0.050000,0.050000},
-{0.956250,0.656250,0.025000,0.025000},
-{0.956250,0.656250,0.050000,0.050000},
-{0.968750,0.656250,0.025000,0.025000},
-{0.968750,0.656250,0.050000,0.050000},
-{0.981250,0.656250,0.025000,0.025000},
-{0.981250,0.656250,0.050000,0.050000},
-{0.993750,0.656250,0.025000,0.025000},
-{0.993750,0.656250,0.050000,0.050000},
-{0.006250,0.668750,0.025000,0.025000},
-{0.006250,0.668750,0.050000,0.050000},
-{0.018750,0.668750,0.025000,0.025000},
-{0.018750,0.668750,0.050000,0.050000},
-{0.031250,0.668750,0.025000,0.025000},
-{0.031250,0.668750,0.050000,0.050000},
-{0.043750,0.668750,0.025000,0.025000},
-{0.043750,0.668750,0.050000,0.050000},
-{0.056250,0.668750,0.025000,0.025000},
-{0.056250,0.668750,0.050000,0.050000},
-{0.068750,0.668750,0.025000,0.025000},
-{0.068750,0.668750,0.050000,0.050000},
-{0.081250,0.668750,0.025000,0.025000},
-{0.081250,0.668750,0.050000,0.050000},
-{0.093750,0.668750,0.025000,0.025000},
-{0.093750,0.668750,0.050000,0.050000},
-{0.106250,0.668750,0.025000,0.025000},
-{0.106250,0.668750,0.050000,0.050000},
-{0.118750,0.668750,0.025000,0.025000},
-{0.118750,0.668750,0.050000,0.050000},
-{0.131250,0.668750,0.025000,0.025000},
-{0.131250,0.668750,0.050000,0.050000},
-{0.143750,0.668750,0.025000,0.025000},
-{0.143750,0.668750,0.050000,0.050000},
-{0.156250,0.668750,0.025000,0.025000},
-{0.156250,0.668750,0.050000,0.050000},
-{0.168750,0.668750,0.025000,0.025000},
-{0.168750,0.668750,0.050000,0.050000},
-{0.181250,0.668750,0.025000,0.025000},
-{0.181250,0.668750,0.050000,0.050000},
-{0.193750,0.668750,0.025000,0.025000},
-{0.193750,0.668750,0.050000,0.050000},
-{0.206250,0.668750,0.025000,0.025000},
-{0.206250,0.668750,0.050000,0.050000},
-{0.218750,0.668750,0.025000,0.025000},
-{0.218750,0.668750,0.050000,0.050000},
-{0.231250,0.668750,0.025000,0.025000},
-{0.231250,0.668750,0.050000,0.050000},
-{0.243750,0.668750,0.025000,0.025000},
-{0.243750,0.668750,0.050000,0.050000},
-{0.256250,0.668750,0.025000,0.025000},
-{0.256250,0.668750,0.050000,0.050000},
-{0.268750,0.668750,0.025000,0.025000},
-{0.268750,0.668750,0.050000,0.050000},
-{0.281250,0.668750,0.025000,0.025000},
-{0.281250,0.668750,0.050000,0.050000},
-{0.293750,0.668750,0.025000,0.025000},
-{0.293750,0.668750,0.050000,0.050000},
-{0.306250,0.668750,0.025000,0.025000},
-{0.306250,0.668750,0.050000,0.050000},
-{0.318750,0.668750,0.025000,0.025000},
-{0.318750,0.668750,0.050000,0.050000},
-{0.331250,0.668750,0.025000,0.025000},
-{0.331250,0.668750,0.050000,0.050000},
-{0.343750,0.668750,0.025000,0.025000},
-{0.343750,0.668750,0.050000,0.050000},
-{0.356250,0.668750,0.025000,0.025000},
-{0.356250,0.668750,0.050000,0.050000},
-{0.368750,0.668750,0.025000,0.025000},
-{0.368750,0.668750,0.050000,0.050000},
-{0.381250,0.668750,0.025000,0.025000},
-{0.381250,0.668750,0.050000,0.050000},
-{0.393750,0.668750,0.025000,0.025000},
-{0.393750,0.668750,0.050000,0.050000},
-{0.406250,0.668750,0.025000,0.025000},
-{0.406250,0.668750,0.050000,0.050000},
-{0.418750,0.668750,0.025000,0.025000},
-{0.418750,0.668750,0.050000,0.050000},
-{0.431250,0.668750,0.025000,0.025000},
-{0.431250,0.668750,0.050000,0.050000},
-{0.443750,0.668750,0.025000,0.025000},
-{0.443750,0.668750,0.050000,0.050000},
-{0.456250,0.668750,0.025000,0.025000},
-{0.456250,0.668750,0.050000,0.050000},
-{0.468750,0.668750,0.025000,0.025000},
-{0.468750,0.668750,0.050000,0.050000},
-{0.481250,0.668750,0.025000,0.025000},
-{0.481250,0.668750,0.050000,0.050000},
-{0.493750,0.668750,0.025000,0.025000},
-{0.493750,0.668750,0.050000,0.050000},
-{0.506250,0.668750,0.025000,0.025000},
-{0.506250,0.668750,0.050000,0.050000},
-{0.518750,0.668750,0.025000,0.025000},
-{0.518750,0.668750,0.050000,0.050000},
-{0.531250,0.668750,0.025000,0.025000},
-{0.531250,0.668750,0.050000,0.050000},
-{0.543750,0.668750,0.025000,0.025000},
-{0.543750,0.668750,0.050000,0.050000},
-{0.556250,0.668750,0.025000,0.025000},
-{0.556250,0.668750,0.050000,0.050000},
-{0.568750,0.668750,0.025000,0.025000},
-{0.568750,0.668750,0.050000,0.050000},
-{0.581250,0.668750,0.025000,0.025000},
-{0.581250,0.668750,0.050000,0.050000},
-{0.593750,0.668750,0.025000,0.025000},
-{0.593750,0.668750,0.050000,0.050000},
-{0.606250,0.668750,0.025000,0.025000},
-{0.606250,0.668750,0.050000,0.050000},
-{0.618750,0.668750,0.025000,0.025000},
-{0.618750,0.668750,0.050000,0.050000},
-{0.631250,0.668750,0.025000,0.025000},
-{0.631250,0.668750,0.050000,0.050000},
-{0.643750,0.668750,0.025000,0.025000},
-{0.643750,0.668750,0.050000,0.050000},
-{0.656250,0.668750,0.025000,0.025000},
-{0.656250,0.668750,0.050000,0.050000},
-{0.668750,0.668750,0.025000,0.025000},
-{0.668750,0.668750,0.050000,0.050000},
-{0.681250,0.668750,0.025000,0.025000},
-{0.681250,0.668750,0.050000,0.050000},
-{0.693750,0.668750,0.025000,0.025000},
-{0.693750,0.668750,0.050000,0.050000},
-{0.706250,0.668750,0.025000,0.025000},
-{0.706250,0.668750,0.050000,0.050000},
-{0.718750,0.668750,0.025000,0.025000},
-{0.718750,0.668750,0.050000,0.050000},
-{0.731250,0.668750,0.025000,0.025000},
-{0.731250,0.668750,0.050000,0.050000},
-{0.743750,0.668750,0.025000,0.025000},
-{0.743750,0.668750,0.050000,0.050000},
-{0.756250,0.668750,0.025000,0.025000},
-{0.756250,0.668750,0.050000,0.050000},
-{0.768750,0.668750,0.025000,0.025000},
-{0.768750,0.668750,0.050000,0.050000},
-{0.781250,0.668750,0.025000,0.025000},
-{0.781250,0.668750,0.050000,0.050000},
-{0.793750,0.668750,0.025000,0.025000},
-{0.793750,0.668750,0.050000,0.050000},
-{0.806250,0.668750,0.025000,0.025000},
-{0.806250,0.668750,0.050000,0.050000},
-{0.818750,0.668750,0.025000,0.025000},
-{0.818750,0.668750,0.050000,0.050000},
-{0.831250,0.668750,0.025000,0.025000},
-{0.831250,0.668750,0.050000,0.050000},
-{0.843750,0.668750,0.025000,0.025000},
-{0.843750,0.668750,0.050000,0.050000},
-{0.856250,0.668750,0.025000,0.025000},
-{0.856250,0.668750,0.050000,0.050000},
-{0.868750,0.668750,0.025000,0.025000},
-{0.868750,0.668750,0.050000,0.050000},
-{0.881250,0.668750,0.025000,0.025000},
-{0.881250,0.668750,0.050000,0.050000},
-{0.893750,0.668750,0.025000,0.025000},
-{0.893750,0.668750,0.050000,0.050000},
-{0.906250,0.668750,0.025000,0.025000},
-{0.906250,0.668750,0.050000,0.050000},
-{0.918750,0.668750,0.025000,0.025000},
-{0.918750,0.668750,0.050000,0.050000},
-{0.931250,0.668750,0.025000,0.025000},
-{0.931250,0.668750,0.050000,0.050000},
-{0.943750,0.668750,0.025000,0.025000},
-{0.943750,0.668750,0.050000,0.050000},
-{0.956250,0.668750,0.025000,0.025000},
-{0.956250,0.668750,0.050000,0.050000},
-{0.968750,0.668750,0.025000,0.025000},
-{0.968750,0.668750,0.050000,0.050000},
-{0.981250,0.668750,0.025000,0.025000},
-{0.981250,0.668750,0.050000,0.050000},
-{0.993750,0.668750,0.025000,0.025000},
-{0.993750,0.668750,0.050000,0.050000},
-{0.006250,0.681250,0.025000,0.025000},
-{0.006250,0.681250,0.050000,0.050000},
-{0.018750,0.681250,0.025000,0.025000},
-{0.018750,0.681250,0.050000,0.050000},
-{0.031250,0.681250,0.025000,0.025000},
-{0.031250,0.681250,0.050000,0.050000},
-{0.043750,0.681250,0.025000,0.025000},
-{0.043750,0.681250,0.050000,0.050000},
-{0.056250,0.681250,0.025000,0.025000},
-{0.056250,0.681250,0.050000,0.050000},
-{0.068750,0.681250,0.025000,0.025000},
-{0.068750,0.681250,0.050000,0.050000},
-{0.081250,0.681250,0.025000,0.025000},
-{0.081250,0.681250,0.050000,0.050000},
-{0.093750,0.681250,0.025000,0.025000},
-{0.093750,0.681250,0.050000,0.050000},
-{0.106250,0.681250,0.025000,0.025000},
-{0.106250,0.681250,0.050000,0.050000},
-{0.118750,0.681250,0.025000,0.025000},
-{0.118750,0.681250,0.050000,0.050000},
-{0.131250,0.681250,0.025000,0.025000},
-{0.131250,0.681250,0.050000,0.050000},
-{0.143750,0.681250,0.025000,0.025000},
-{0.143750,0.681250,0.050000,0.050000},
-{0.156250,0.681250,0.025000,0.025000},
-{0.156250,0.681250,0.050000,0.050000},
-{0.168750,0.681250,0.025000,0.025000},
-{0.168750,0.681250,0.050000,0.050000},
-{0.181250,0.681250,0.025000,0.025000},
-{0.181250,0.681250,0.050000,0.050000},
-{0.193750,0.681250,0.025000,0.025000},
-{0.193750,0.681250,0.050000,0.050000},
-{0.206250,0.681250,0.025000,0.025000},
-{0.206250,0.681250,0.050000,0.050000},
-{0.218750,0.681250,0.025000,0.025000},
-{0.218750,0.681250,0.050000,0.050000},
-{0.231250,0.681250,0.025000,0.025000},
-{0.231250,0.681250,0.050000,0.050000},
-{0.243750,0.681250,0.025000,0.025000},
-{0.243750,0.681250,0.050000,0.050000},
-{0.256250,0.681250,0.025000,0.025000},
-{0.256250,0.681250,0.050000,0.050000},
-{0.268750,0.681250,0.025000,0.025000},
-{0.268750,0.681250,0.050000,0.050000},
-{0.281250,0.681250,0.025000,0.025000},
-{0.281250,0.681250,0.050000,0.050000},
-{0.293750,0.681250,0.025000,0.025000},
-{0.293750,0.681250,0.050000,0.050000},
-{0.306250,0.681250,0.025000,0.025000},
-{0.306250,0.681250,0.050000,0.050000},
-{0.318750,0.681250,0.025000,0.025000},
-{0.318750,0.681250,0.050000,0.050000},
-{0.331250,0.681250,0.025000,0.025000},
-{0.331250,0.681250,0.050000,0.050000},
-{0.343750,0.681250,0.025000,0.025000},
-{0.343750,0.681250,0.050000,0.050000},
-{0.356250,0.681250,0.025000,0.025000},
-{0.356250,0.681250,0.050000,0.050000},
-{0.368750,0.681250,0.025000,0.025000},
-{0.368750,0.681250,0.050000,0.050000},
-{0.381250,0.681250,0.025000,0.025000},
-{0.381250,0.681250,0.050000,0.050000},
-{0.393750,0.681250,0.025000,0.025000},
-{0.393750,0.681250,0.050000,0.050000},
-{0.406250,0.681250,0.025000,0.025000},
-{0.406250,0.681250,0.050000,0.050000},
-{0.418750,0.681250,0.025000,0.025000},
-{0.418750,0.681250,0.050000,0.050000},
-{0.431250,0.681250,0.025000,0.025000},
-{0.431250,0.681250,0.050000,0.050000},
-{0.443750,0.681250,0.025000,0.025000},
-{0.443750,0.681250,0.050000,0.050000},
-{0.456250,0.681250,0.025000,0.025000},
-{0.456250,0.681250,0.050000,0.050000},
-{0.468750,0.681250,0.025000,0.025000},
-{0.468750,0.681250,0.050000,0.050000},
-{0.481250,0.681250,0.025000,0.025000},
-{0.481250,0.681250,0.050000,0.050000},
-{0.493750,0.681250,0.025000,0.025000},
-{0.493750,0.681250,0.050000,0.050000},
-{0.506250,0.681250,0.025000,0.025000},
-{0.506250,0.681250,0.050000,0.050000},
-{0.518750,0.681250,0.025000,0.025000},
-{0.518750,0.681250,0.050000,0.050000},
-{0.531250,0.681250,0.025000,0.025000},
-{0.531250,0.681250,0.050000,0.050000},
-{0.543750,0.681250,0.025000,0.025000},
-{0.543750,0.681250,0.050000,0.050000},
-{0.556250,0.681250,0.025000,0.025000},
-{0.556250,0.681250,0.050000,0.050000},
-{0.568750,0.681250,0.025000,0.025000},
-{0.568750,0.681250,0.050000,0.050000},
-{0.581250,0.681250,0.025000,0.025000},
-{0.581250,0.681250,0.050000,0.050000},
-{0.593750,0.681250,0.025000,0.025000},
-{0.593750,0.681250,0.050000,0.050000},
-{0.606250,0.681250,0.025000,0.025000},
-{0.606250,0.681250,0.050000,0.050000},
-{0.618750,0.681250,0.025000,0.025000},
-{0.618750,0.681250,0.050000,0.050000},
-{0.631250,0.681250,0.025000,0.025000},
-{0.631250,0.681250,0.050000,0.050000},
-{0.643750,0.681250,0.025000,0.025000},
-{0.643750,0.681250,0.050000,0.050000},
-{0.656250,0.681250,0.025000,0.025000},
-{0.656250,0.681250,0.050000,0.050000},
-{0.668750,0.681250,0.025000,0.025000},
-{0.668750,0.681250,0.050000,0.050000},
-{0.681250,0.681250,0.025000,0.025000},
-{0.681250,0.681250,0.050000,0.050000},
-{0.693750,0.681250,0.025000,0.025000},
-{0.693750,0.681250,0.050000,0.050000},
-{0.706250,0.681250,0.025000,0.025000},
-{0.706250,0.681250,0.050000,0.050000},
-{0.718750,0.681250,0.025000,0.025000},
-{0.718750,0.681250,0.050000,0.050000},
-{0.731250,0.681250,0.025000,0.025000},
-{0.731250,0.681250,0.050000,0.050000},
-{0.743750,0.681250,0.025000,0.025000},
-{0.743750,0.681250,0.050000,0.050000},
-{0.756250,0.681250,0.025000,0.025000},
-{0.756250,0.681250,0.050000,0.050000},
-{0.768750,0.681250,0.025000,0.025000},
-{0.768750,0.681250,0.050000,0.050000},
-{0.781250,0.681250,0.025000,0.025000},
-{0.781250,0.681250,0.050000,0.050000},
-{0.793750,0.681250,0.025000,0.025000},
-{0.793750,0.681250,0.050000,0.050000},
-{0.806250,0.681250,0.025000,0.025000},
-{0.806250,0.681250,0.050000,0.050000},
-{0.818750,0.681250,0.025000,0.025000},
-{0.818750,0.681250,0.050000,0.050000},
-{0.831250,0.681250,0.025000,0.025000},
-{0.831250,0.681250,0.050000,0.050000},
-{0.843750,0.681250,0.025000,0.025000},
-{0.843750,0.681250,0.050000,0.050000},
-{0.856250,0.681250,0.025000,0.025000},
-{0.856250,0.681250,0.050000,0.050000},
-{0.868750,0.681250,0.025000,0.025000},
-{0.868750,0.681250,0.050000,0.050000},
-{0.881250,0.681250,0.025000,0.025000},
-{0.881250,0.681250,0.050000,0.050000},
-{0.893750,0.681250,0.025000,0.025000},
-{0.893750,0.681250,0.050000,0.050000},
-{0.906250,0.681250,0.025000,0.025000},
-{0.906250,0.681250,0.050000,0.050000},
-{0.918750,0.681250,0.025000,0.025000},
-{0.918750,0.681250,0.050000,0.050000},
-{0.931250,0.681250,0.025000,0.025000},
-{0.931250,0.681250,0.050000,0.050000},
-{0.943750,0.681250,0.025000,0.025000},
-{0.943750,0.681250,0.050000,0.050000},
-{0.956250,0.681250,0.025000,0.025000},
-{0.956250,0.681250,0.050000,0.050000},
-{0.968750,0.681250,0.025000,0.025000},
-{0.968750,0.681250,0.050000,0.050000},
-{0.981250,0.681250,0.025000,0.025000},
-{0.981250,0.681250,0.050000,0.050000},
-{0.993750,0.681250,0.025000,0.025000},
-{0.993750,0.681250,0.050000,0.050000},
-{0.006250,0.693750,0.025000,0.025000},
-{0.006250,0.693750,0.050000,0.050000},
-{0.018750,0.693750,0.025000,0.025000},
-{0.018750,0.693750,0.050000,0.050000},
-{0.031250,0.693750,0.025000,0.025000},
-{0.031250,0.693750,0.050000,0.050000},
-{0.043750,0.693750,0.025000,0.025000},
-{0.043750,0.693750,0.050000,0.050000},
-{0.056250,0.693750,0.025000,0.025000},
-{0.056250,0.693750,0.050000,0.050000},
-{0.068750,0.693750,0.025000,0.025000},
-{0.068750,0.693750,0.050000,0.050000},
-{0.081250,0.693750,0.025000,0.025000},
-{0.081250,0.693750,0.050000,0.050000},
-{0.093750,0.693750,0.025000,0.025000},
-{0.093750,0.693750,0.050000,0.050000},
-{0.106250,0.693750,0.025000,0.025000},
-{0.106250,0.693750,0.050000,0.050000},
-{0.118750,0.693750,0.025000,0.025000},
-{0.118750,0.693750,0.050000,0.050000},
-{0.131250,0.693750,0.025000,0.025000},
-{0.131250,0.693750,0.050000,0.050000},
-{0.143750,0.693750,0.025000,0.025000},
-{0.143750,0.693750,0.050000,0.050000},
-{0.156250,0.693750,0.025000,0.025000},
-{0.156250,0.693750,0.050000,0.050000},
-{0.168750,0.693750,0.025000,0.025000},
-{0.168750,0.693750,0.050000,0.050000},
-{0.181250,0.693750,0.025000,0.025000},
-{0.181250,0.693750,0.050000,0.050000},
-{0.193750,0.693750,0.025000,0.025000},
-{0.193750,0.693750,0.050000,0.050000},
-{0.206250,0.693750,0.025000,0.025000},
-{0.206250,0.693750,0.050000,0.050000},
-{0.218750,0.693750,0.025000,0.025000},
-{0.218750,0.693750,0.050000,0.050000},
-{0.231250,0.693750,0.025000,0.025000},
-{0.231250,0.693750,0.050000,0.050000},
-{0.243750,0.693750,0.025000,0.025000},
-{0.243750,0.693750,0.050000,0.050000},
-{0.256250,0.693750,0.025000,0.025000},
-{0.256250,0.693750,0.050000,0.050000},
-{0.268750,0.693750,0.025000,0.025000},
-{0.268750,0.693750,0.050000,0.050000},
-{0.281250,0.693750,0.025000,0.025000},
-{0.281250,0.693750,0.050000,0.050000},
-{0.293750,0.693750,0.025000,0.025000},
-{0.293750,0.693750,0.050000,0.050000},
-{0.306250,0.693750,0.025000,0.025000},
-{0.306250,0.693750,0.050000,0.050000},
-{0.318750,0.693750,0.025000,0.025000},
-{0.318750,0.693750,0.050000,0.050000},
-{0.331250,0.693750,0.025000,0.025000},
-{0.331250,0.693750,0.050000,0.050000},
-{0.343750,0.693750,0.025000,0.025000},
-{0.343750,0.693750,0.050000,0.050000},
-{0.356250,0.693750,0.025000,0.025000},
-{0.356250,0.693750,0.050000,0.050000},
-{0.368750,0.693750,0.025000,0.025000},
-{0.368750,0.693750,0.050000,0.050000},
-{0.381250,0.693750,0.025000,0.025000},
-{0.381250,0.693750,0.050000,0.050000},
-{0.393750,0.693750,0.025000,0.025000},
-{0.393750,0.693750,0.050000,0.050000},
-{0.406250,0.693750,0.025000,0.025000},
-{0.406250,0.693750,0.050000,0.050000},
-{0.418750,0.693750,0.025000,0.025000},
-{0.418750,0.693750,0.050000,0.050000},
-{0.431250,0.693750,0.025000,0.025000},
-{0.431250,0.693750,0.050000,0.050000},
-{0.443750,0.693750,0.025000,0.025000},
-{0.443750,0.693750,0.050000,0.050000},
-{0.456250,0.693750,0.025000,0.025000},
-{0.456250,0.693750,0.050000,0.050000},
-{0.468750,0.693750,0.025000,0.025000},
-{0.468750,0.693750,0.050000,0.050000},
-{0.481250,0.693750,0.025000,0.025000},
-{0.481250,0.693750,0.050000,0.050000},
-{0.493750,0.693750,0.025000,0.025000},
-{0.493750,0.693750,0.050000,0.050000},
-{0.506250,0.693750,0.025000,0.025000},
-{0.506250,0.693750,0.050000,0.050000},
-{0.518750,0.693750,0.025000,0.025000},
-{0.518750,0.693750,0.050000,0.050000},
-{0.531250,0.693750,0.025000,0.025000},
-{0.531250,0.693750,0.050000,0.050000},
-{0.543750,0.693750,0.025000,0.025000},
-{0.543750,0.693750,0.050000,0.050000},
-{0.556250,0.693750,0.025000,0.025000},
-{0.556250,0.693750,0.050000,0.050000},
-{0.568750,0.693750,0.025000,0.025000},
-{0.568750,0.693750,0.050000,0.050000},
-{0.581250,0.693750,0.025000,0.025000},
-{0.581250,0.693750,0.050000,0.050000},
-{0.593750,0.693750,0.025000,0.025000},
-{0.593750,0.693750,0.050000,0.050000},
-{0.606250,0.693750,0.025000,0.025000},
-{0.606250,0.693750,0.050000,0.050000},
-{0.618750,0.693750,0.025000,0.025000},
-{0.618750,0.693750,0.050000,0.050000},
-{0.631250,0.693750,0.025000,0.025000},
-{0.631250,0.693750,0.050000,0.050000},
-{0.643750,0.693750,0.025000,0.025000},
-{0.643750,0.693750,0.050000,0.050000},
-{0.656250,0.693750,0.025000,0.025000},
-{0.656250,0.693750,0.050000,0.050000},
-{0.668750,0.693750,0.025000,0.025000},
-{0.668750,0.693750,0.050000,0.050000},
-{0.681250,0.693750,0.025000,0.025000},
-{0.681250,0.693750,0.050000,0.050000},
-{0.693750,0.693750,0.025000,0.025000},
-{0.693750,0.693750,0.050000,0.050000},
-{0.706250,0.693750,0.025000,0.025000},
-{0.706250,0.693750,0.050000,0.050000},
-{0.718750,0.693750,0.025000,0.025000},
-{0.718750,0.693750,0.050000,0.050000},
-{0.731250,0.693750,0.025000,0.025000},
-{0.731250,0.693750,0.050000,0.050000},
-{0.743750,0.693750,0.025000,0.025000},
-{0.743750,0.693750,0.050000,0.050000},
-{0.756250,0.693750,0.025000,0.025000},
-{0.756250,0.693750,0.050000,0.050000},
-{0.768750,0.693750,0.025000,0.025000},
-{0.768750,0.693750,0.050000,0.050000},
-{0.781250,0.693750,0.025000,0.025000},
-{0.781250,0.693750,0.050000,0.050000},
-{0.793750,0.693750,0.025000,0.025000},
-{0.793750,0.693750,0.050000,0.050000},
-{0.806250,0.693750,0.025000,0.025000},
-{0.806250,0.693750,0.050000,0.050000},
-{0.818750,0.693750,0.025000,0.025000},
-{0.818750,0.693750,0.050000,0.050000},
-{0.831250,0.693750,0.025000,0.025000},
-{0.831250,0.693750,0.050000,0.050000},
-{0.843750,0.693750,0.025000,0.025000},
-{0.843750,0.693750,0.050000,0.050000},
-{0.856250,0.693750,0.025000,0.025000},
-{0.856250,0.693750,0.050000,0.050000},
-{0.868750,0.693750,0.025000,0.025000},
-{0.868750,0.693750,0.050000,0.050000},
-{0.881250,0.693750,0.025000,0.025000},
-{0.881250,0.693750,0.050000,0.050000},
-{0.893750,0.693750,0.025000,0.025000},
-{0.893750,0.693750,0.050000,0.050000},
-{0.906250,0.693750,0.025000,0.025000},
-{0.906250,0.693750,0.050000,0.050000},
-{0.918750,0.693750,0.025000,0.025000},
-{0.918750,0.693750,0.050000,0.050000},
-{0.931250,0.693750,0.025000,0.025000},
-{0.931250,0.693750,0.050000,0.050000},
-{0.943750,0.693750,0.025000,0.025000},
-{0.943750,0.693750,0.050000,0.050000},
-{0.956250,0.693750,0.025000,0.025000},
-{0.956250,0.693750,0.050000,0.050000},
-{0.968750,0.693750,0.025000,0.025000},
-{0.968750,0.693750,0.050000,0.050000},
-{0.981250,0.693750,0.025000,0.025000},
-{0.981250,0.693750,0.050000,0.050000},
-{0.993750,0.693750,0.025000,0.025000},
-{0.993750,0.693750,0.050000,0.050000},
-{0.006250,0.706250,0.025000,0.025000},
-{0.006250,0.706250,0.050000,0.050000},
-{0.018750,0.706250,0.025000,0.025000},
-{0.018750,0.706250,0.050000,0.050000},
-{0.031250,0.706250,0.025000,0.025000},
-{0.031250,0.706250,0.050000,0.050000},
-{0.043750,0.706250,0.025000,0.025000},
-{0.043750,0.706250,0.050000,0.050000},
-{0.056250,0.706250,0.025000,0.025000},
-{0.056250,0.706250,0.050000,0.050000},
-{0.068750,0.706250,0.025000,0.025000},
-{0.068750,0.706250,0.050000,0.050000},
-{0.081250,0.706250,0.025000,0.025000},
-{0.081250,0.706250,0.050000,0.050000},
-{0.093750,0.706250,0.025000,0.025000},
-{0.093750,0.706250,0.050000,0.050000},
-{0.106250,0.706250,0.025000,0.025000},
-{0.106250,0.706250,0.050000,0.050000},
-{0.118750,0.706250,0.025000,0.025000},
-{0.118750,0.706250,0.050000,0.050000},
-{0.131250,0.706250,0.025000,0.025000},
-{0.131250,0.706250,0.050000,0.050000},
-{0.143750,0.706250,0.025000,0.025000},
-{0.143750,0.706250,0.050000,0.050000},
-{0.156250,0.706250,0.025000,0.025000},
-{0.156250,0.706250,0.050000,0.050000},
-{0.168750,0.706250,0.025000,0.025000},
-{0.168750,0.706250,0.050000,0.050000},
-{0.181250,0.706250,0.025000,0.025000},
-{0.181250,0.706250,0.050000,0.050000},
-{0.193750,0.706250,0.025000,0.025000},
-{0.193750,0.706250,0.050000,0.050000},
-{0.206250,0.706250,0.025000,0.025000},
-{0.206250,0.706250,0.050000,0.050000},
-{0.218750,0.706250,0.025000,0.025000},
-{0.218750,0.706250,0.050000,0.050000},
-{0.231250,0.706250,0.025000,0.025000},
-{0.231250,0.706250,0.050000,0.050000},
-{0.243750,0.706250,0.025000,0.025000},
-{0.243750,0.706250,0.050000,0.050000},
-{0.256250,0.706250,0.025000,0.025000},
-{0.256250,0.706250,0.050000,0.050000},
-{0.268750,0.706250,0.025000,0.025000},
-{0.268750,0.706250,0.050000,0.050000},
-{0.281250,0.706250,0.025000,0.025000},
-{0.281250,0.706250,0.050000,0.050000},
-{0.293750,0.706250,0.025000,0.025000},
-{0.293750,0.706250,0.050000,0.050000},
-{0.306250,0.706250,0.025000,0.025000},
-{0.306250,0.706250,0.050000,0.050000},
-{0.318750,0.706250,0.025000,0.025000},
-{0.318750,0.706250,0.050000,0.050000},
-{0.331250,0.706250,0.025000,0.025000},
-{0.331250,0.706250,0.050000,0.050000},
-{0.343750,0.706250,0.025000,0.025000},
-{0.343750,0.706250,0.050000,0.050000},
-{0.356250,0.706250,0.025000,0.025000},
-{0.356250,0.706250,0.050000,0.050000},
-{0.368750,0.706250,0.025000,0.025000},
-{0.368750,0.706250,0.050000,0.050000},
-{0.381250,0.706250,0.025000,0.025000},
-{0.381250,0.706250,0.050000,0.050000},
-{0.393750,0.706250,0.025000,0.025000},
-{0.393750,0.706250,0.050000,0.050000},
-{0.406250,0.706250,0.025000,0.025000},
-{0.406250,0.706250,0.050000,0.050000},
-{0.418750,0.706250,0.025000,0.025000},
-{0.418750,0.706250,0.050000,0.050000},
-{0.431250,0.706250,0.025000,0.025000},
-{0.431250,0.706250,0.050000,0.050000},
-{0.443750,0.706250,0.025000,0.025000},
-{0.443750,0.706250,0.050000,0.050000},
-{0.456250,0.706250,0.025000,0.025000},
-{0.456250,0.706250,0.050000,0.050000},
-{0.468750,0.706250,0.025000,0.025000},
-{0.468750,0.706250,0.050000,0.050000},
-{0.481250,0.706250,0.025000,0.025000},
-{0.481250,0.706250,0.050000,0.050000},
-{0.493750,0.706250,0.025000,0.025000},
-{0.493750,0.706250,0.050000,0.050000},
-{0.506250,0.706250,0.025000,0.025000},
-{0.506250,0.706250,0.050000,0.050000},
-{0.518750,0.706250,0.025000,0.025000},
-{0.518750,0.706250,0.050000,0.050000},
-{0.531250,0.706250,0.025000,0.025000},
-{0.531250,0.706250,0.050000,0.050000},
-{0.543750,0.706250,0.025000,0.025000},
-{0.543750,0.706250,0.050000,0.050000},
-{0.556250,0.706250,0.025000,0.025000},
-{0.556250,0.706250,0.050000,0.050000},
-{0.568750,0.706250,0.025000,0.025000},
-{0.568750,0.706250,0.050000,0.050000},
-{0.581250,0.706250,0.025000,0.025000},
-{0.581250,0.706250,0.050000,0.050000},
-{0.593750,0.706250,0.025000,0.025000},
-{0.593750,0.706250,0.050000,0.050000},
-{0.606250,0.706250,0.025000,0.025000},
-{0.606250,0.706250,0.050000,0.050000},
-{0.618750,0.706250,0.025000,0.025000},
-{0.618750,0.706250,0.050000,0.050000},
-{0.631250,0.706250,0.025000,0.025000},
-{0.631250,0.706250,0.050000,0.050000},
-{0.643750,0.706250,0.025000,0.025000},
-{0.643750,0.706250,0.050000,0.050000},
-{0.656250,0.706250,0.025000,0.025000},
-{0.656250,0.706250,0.050000,0.050000},
-{0.668750,0.706250,0.025000,0.025000},
-{0.668750,0.706250,0.050000,0.050000},
-{0.681250,0.706250,0.025000,0.025000},
-{0.681250,0.706250,0.050000,0.050000},
-{0.693750,0.706250,0.025000,0.025000},
-{0.693750,0.706250,0.050000,0.050000},
-{0.706250,0.706250,0.025000,0.025000},
-{0.706250,0.706250,0.050000,0.050000},
-{0.718750,0.706250,0.025000,0.025000},
-{0.718750,0.706250,0.050000,0.050000},
-{0.731250,0.706250,0.025000,0.025000},
-{0.731250,0.706250,0.050000,0.050000},
-{0.743750,0.706250,0.025000,0.025000},
-{0.743750,0.706250,0.050000,0.050000},
-{0.756250,0.706250,0.025000,0.025000},
-{0.756250,0.706250,0.050000,0.050000},
-{0.768750,0.706250,0.025000,0.025000},
-{0.768750,0.706250,0.050000,0.050000},
-{0.781250,0.706250,0.025000,0.025000},
-{0.781250,0.706250,0.050000,0.050000},
-{0.793750,0.706250,0.025000,0.025000},
-{0.793750,0.706250,0.050000,0.050000},
-{0.806250,0.706250,0.025000,0.025000},
-{0.806250,0.706250,0.050000,0.050000},
-{0.818750,0.706250,0.025000,0.025000},
-{0.818750,0.706250,0.050000,0.050000},
-{0.831250,0.706250,0.025000,0.025000},
-{0.831250,0.706250,0.050000,0.050000},
-{0.843750,0.706250,0.025000,0.025000},
-{0.843750,0.706250,0.050000,0.050000},
-{0.856250,0.706250,0.025000,0.025000},
-{0.856250,0.706250,0.050000,0.050000},
-{0.868750,0.706250,0.025000,0.025000},
-{0.868750,0.706250,0.050000,0.050000},
-{0.881250,0.706250,0.025000,0.025000},
-{0.881250,0.706250,0.050000,0.050000},
-{0.893750,0.706250,0.025000,0.025000},
-{0.893750,0.706250,0.050000,0.050000},
-{0.906250,0.706250,0.025000,0.025000},
-{0.906250,0.706250,0.050000,0.050000},
-{0.918750,0.706250,0.025000,0.025000},
-{0.918750,0.706250,0.050000,0.050000},
-{0.931250,0.706250,0.025000,0.025000},
-{0.931250,0.706250,0.050000,0.050000},
-{0.943750,0.706250,0.025000,0.025000},
-{0.943750,0.706250,0.050000,0.050000},
-{0.956250,0.706250,0.025000,0.025000},
-{0.956250,0.706250,0.050000,0.050000},
-{0.968750,0.706250,0.025000,0.025000},
-{0.968750,0.706250,0.050000,0.050000},
-{0.981250,0.706250,0.025000,0.025000},
-{0.981250,0.706250,0.050000,0.050000},
-{0.993750,0.706250,0.025000,0.025000},
-{0.993750,0.706250,0.050000,0.050000},
-{0.006250,0.718750,0.025000,0.025000},
-{0.006250,0.718750,0.050000,0.050000},
-{0.018750,0.718750,0.025000,0.025000},
-{0.018750,0.718750,0.050000,0.050000},
-{0.031250,0.718750,0.025000,0.025000},
-{0.031250,0.718750,0.050000,0.050000},
-{0.043750,0.718750,0.025000,0.025000},
-{0.043750,0.718750,0.050000,0.050000},
-{0.056250,0.718750,0.025000,0.025000},
-{0.056250,0.718750,0.050000,0.050000},
-{0.068750,0.718750,0.025000,0.025000},
-{0.068750,0.718750,0.050000,0.050000},
-{0.081250,0.718750,0.025000,0.025000},
-{0.081250,0.718750,0.050000,0.050000},
-{0.093750,0.718750,0.025000,0.025000},
-{0.093750,0.718750,0.050000,0.050000},
-{0.106250,0.718750,0.025000,0.025000},
-{0.106250,0.718750,0.050000,0.050000},
-{0.118750,0.718750,0.025000,0.025000},
-{0.118750,0.718750,0.050000,0.050000},
-{0.131250,0.718750,0.025000,0.025000},
-{0.131250,0.718750,0.050000,0.050000},
-{0.143750,0.718750,0.025000,0.025000},
-{0.143750,0.718750,0.050000,0.050000},
-{0.156250,0.718750,0.025000,0.025000},
-{0.156250,0.718750,0.050000,0.050000},
-{0.168750,0.718750,0.025000,0.025000},
-{0.168750,0.718750,0.050000,0.050000},
-{0.181250,0.718750,0.025000,0.025000},
-{0.181250,0.718750,0.050000,0.050000},
-{0.193750,0.718750,0.025000,0.025000},
-{0.193750,0.718750,0.050000,0.050000},
-{0.206250,0.718750,0.025000,0.025000},
-{0.206250,0.718750,0.050000,0.050000},
-{0.218750,0.718750,0.025000,0.025000},
-{0.218750,0.718750,0.050000,0.050000},
-{0.231250,0.718750,0.025000,0.025000},
-{0.231250,0.718750,0.050000,0.050000},
-{0.243750,0.718750,0.025000,0.025000},
-{0.243750,0.718750,0.050000,0.050000},
-{0.256250,0.718750,0.025000,0.025000},
-{0.256250,0.718750,0.050000,0.050000},
-{0.268750,0.718750,0.025000,0.025000},
-{0.268750,0.718750,0.050000,0.050000},
-{0.281250,0.718750,0.025000,0.025000},
-{0.281250,0.718750,0.050000,0.050000},
-{0.293750,0.718750,0.025000,0.025000},
-{0.293750,0.718750,0.050000,0.050000},
-{0.306250,0.718750,0.025000,0.025000},
-{0.306250,0.718750,0.050000,0.050000},
-{0.318750,0.718750,0.025000,0.025000},
-{0.318750,0.718750,0.050000,0.050000},
-{0.331250,0.718750,0.025000,0.025000},
-{0.331250,0.718750,0.050000,0.050000},
-{0.343750,0.718750,0.025000,0.025000},
-{0.343750,0.718750,0.050000,0.050000},
-{0.356250,0.718750,0.025000,0.025000},
-{0.356250,0.718750,0.050000,0.050000},
-{0.368750,0.718750,0.025000,0.025000},
-{0.368750,0.718750,0.050000,0.050000},
-{0.381250,0.718750,0.025000,0.025000},
-{0.381250,0.718750,0.050000,0.050000},
-{0.393750,0.718750,0.025000,0.025000},
-{0.393750,0.718750,0.050000,0.050000},
-{0.406250,0.718750,0.025000,0.025000},
-{0.406250,0.718750,0.050000,0.050000},
-{0.418750,0.718750,0.025000,0.025000},
-{0.418750,0.718750,0.050000,0.050000},
-{0.431250,0.718750,0.025000,0.025000},
-{0.431250,0.718750,0.050000,0.050000},
-{0.443750,0.718750,0.025000,0.025000},
-{0.443750,0.718750,0.050000,0.050000},
-{0.456250,0.718750,0.025000,0.025000},
-{0.456250,0.718750,0.050000,0.050000},
-{0.468750,0.718750,0.025000,0.025000},
-{0.468750,0.718750,0.050000,0.050000},
-{0.481250,0.718750,0.025000,0.025000},
-{0.481250,0.718750,0.050000,0.050000},
-{0.493750,0.718750,0.025000,0.025000},
-{0.493750,0.718750,0.050000,0.050000},
-{0.506250,0.718750,0.025000,0.025000},
-{0.506250,0.718750,0.050000,0.050000},
-{0.518750,0.718750,0.025000,0.025000},
-{0.518750,0.718750,0.050000,0.050000},
-{0.531250,0.718750,0.025000,0.025000},
-{0.531250,0.718750,0.050000,0.050000},
-{0.543750,0.718750,0.025000,0.025000},
-{0.543750,0.718750,0.050000,0.050000},
-{0.556250,0.718750,0.025000,0.025000},
-{0.556250,0.718750,0.050000,0.050000},
-{0.568750,0.718750,0.025000,0.025000},
-{0.568750,0.718750,0.050000,0.050000},
-{0.581250,0.718750,0.025000,0.025000},
-{0.581250,0.718750,0.050000,0.050000},
-{0.593750,0.718750,0.025000,0.025000},
-{0.593750,0.718750,0.050000,0.050000},
-{0.606250,0.718750,0.025000,0.025000},
-{0.606250,0.718750,0.050000,0.050000},
-{0.618750,0.718750,0.025000,0.025000},
-{0.618750,0.718750,0.050000,0.050000},
-{0.631250,0.718750,0.025000,0.025000},
-{0.631250,0.718750,0.050000,0.050000},
-{0.643750,0.718750,0.025000,0.025000},
-{0.643750,0.718750,0.050000,0.050000},
-{0.656250,0.718750,0.025000,0.025000},
-{0.656250,0.718750,0.050000,0.050000},
-{0.668750,0.718750,0.025000,0.025000},
-{0.668750,0.718750,0.050000,0.050000},
-{0.681250,0.718750,0.025000,0.025000},
-{0.681250,0.718750,0.050000,0.050000},
-{0.693750,0.718750,0.025000,0.025000},
-{0.693750,0.718750,0.050000,0.050000},
-{0.706250,0.718750,0.025000,0.025000},
-{0.706250,0.718750,0.050000,0.050000},
-{0.718750,0.718750,0.025000,0.025000},
-{0.718750,0.718750,0.050000,0.050000},
-{0.731250,0.718750,0.025000,0.025000},
-{0.731250,0.718750,0.050000,0.050000},
-{0.743750,0.718750,0.025000,0.025000},
-{0.743750,0.718750,0.050000,0.050000},
-{0.756250,0.718750,0.025000,0.025000},
-{0.756250,0.718750,0.050000,0.050000},
-{0.768750,0.718750,0.025000,0.025000},
-{0.768750,0.718750,0.050000,0.050000},
-{0.781250,0.718750,0.025000,0.025000},
-{0.781250,0.718750,0.050000,0.050000},
-{0.793750,0.718750,0.025000,0.025000},
-{0.793750,0.718750,0.050000,0.050000},
-{0.806250,0.718750,0.025000,0.025000},
-{0.806250,0.718750,0.050000,0.050000},
-{0.818750,0.718750,0.025000,0.025000},
-{0.818750,0.718750,0.050000,0.050000},
-{0.831250,0.718750,0.025000,0.025000},
-{0.831250,0.718750,0.050000,0.050000},
-{0.843750,0.718750,0.025000,0.025000},
-{0.843750,0.718750,0.050000,0.050000},
-{0.856250,0.718750,0.025000,0.025000},
-{0.856250,0.718750,0.050000,0.050000},
-{0.868750,0.718750,0.025000,0.025000},
-{0.868750,0.718750,0.050000,0.050000},
-{0.881250,0.718750,0.025000,0.025000},
-{0.881250,0.718750,0.050000,0.050000},
-{0.893750,0.718750,0.025000,0.025000},
-{0.893750,0.718750,0.050000,0.050000},
-{0.906250,0.718750,0.025000,0.025000},
-{0.906250,0.718750,0.050000,0.050000},
-{0.918750,0.718750,0.025000,0.025000},
-{0.918750,0.718750,0.050000,0.050000},
-{0.931250,0.718750,0.025000,0.025000},
-{0.931250,0.718750,0.050000,0.050000},
-{0.943750,0.718750,0.025000,0.025000},
-{0.943750,0.718750,0.050000,0.050000},
-{0.956250,0.718750,0.025000,0.025000},
-{0.956250,0.718750,0.050000,0.050000},
-{0.968750,0.718750,0.025000,0.025000},
-{0.968750,0.718750,0.050000,0.050000},
-{0.981250,0.718750,0.025000,0.025000},
-{0.981250,0.718750,0.050000,0.050000},
-{0.993750,0.718750,0.025000,0.025000},
-{0.993750,0.718750,0.050000,0.050000},
-{0.006250,0.731250,0.025000,0.025000},
-{0.006250,0.731250,0.050000,0.050000},
-{0.018750,0.731250,0.025000,0.025000},
-{0.018750,0.731250,0.050000,0.050000},
-{0.031250,0.731250,0.025000,0.025000},
-{0.031250,0.731250,0.050000,0.050000},
-{0.043750,0.731250,0.025000,0.025000},
-{0.043750,0.731250,0.050000,0.050000},
-{0.056250,0.731250,0.025000,0.025000},
-{0.056250,0.731250,0.050000,0.050000},
-{0.068750,0.731250,0.025000,0.025000},
-{0.068750,0.731250,0.050000,0.050000},
-{0.081250,0.731250,0.025000,0.025000},
-{0.081250,0.731250,0.050000,0.050000},
-{0.093750,0.731250,0.025000,0.025000},
-{0.093750,0.731250,0.050000,0.050000},
-{0.106250,0.731250,0.025000,0.025000},
-{0.106250,0.731250,0.050000,0.050000},
-{0.118750,0.731250,0.025000,0.025000},
-{0.118750,0.731250,0.050000,0.050000},
-{0.131250,0.731250,0.025000,0.025000},
-{0.131250,0.731250,0.050000,0.050000},
-{0.143750,0.731250,0.025000,0.025000},
-{0.143750,0.731250,0.050000,0.050000},
-{0.156250,0.731250,0.025000,0.025000},
-{0.156250,0.731250,0.050000,0.050000},
-{0.168750,0.731250,0.025000,0.025000},
-{0.168750,0.731250,0.050000,0.050000},
-{0.181250,0.731250,0.025000,0.025000},
-{0.181250,0.731250,0.050000,0.050000},
-{0.193750,0.731250,0.025000,0.025000},
-{0.193750,0.731250,0.050000,0.050000},
-{0.206250,0.731250,0.025000,0.025000},
-{0.206250,0.731250,0.050000,0.050000},
-{0.218750,0.731250,0.025000,0.025000},
-{0.218750,0.731250,0.050000,0.050000},
-{0.231250,0.731250,0.025000,0.025000},
-{0.231250,0.731250,0.050000,0.050000},
-{0.243750,0.731250,0.025000,0.025000},
-{0.243750,0.731250,0.050000,0.050000},
-{0.256250,0.731250,0.025000,0.025000},
-{0.256250,0.731250,0.050000,0.050000},
-{0.268750,0.731250,0.025000,0.025000},
-{0.268750,0.731250,0.050000,0.050000},
-{0.281250,0.731250,0.025000,0.025000},
-{0.281250,0.731250,0.050000,0.050000},
-{0.293750,0.731250,0.025000,0.025000},
-{0.293750,0.731250,0.050000,0.050000},
-{0.306250,0.731250,0.025000,0.025000},
-{0.306250,0.731250,0.050000,0.050000},
-{0.318750,0.731250,0.025000,0.025000},
-{0.318750,0.731250,0.050000,0.050000},
-{0.331250,0.731250,0.025000,0.025000},
-{0.331250,0.731250,0.050000,0.050000},
-{0.343750,0.731250,0.025000,0.025000},
-{0.343750,0.731250,0.050000,0.050000},
-{0.356250,0.731250,0.025000,0.025000},
-{0.356250,0.731250,0.050000,0.050000},
-{0.368750,0.731250,0.025000,0.025000},
-{0.368750,0.731250,0.050000,0.050000},
-{0.381250,0.731250,0.025000,0.025000},
-{0.381250,0.731250,0.050000,0.050000},
-{0.393750,0.731250,0.025000,0.025000},
-{0.393750,0.731250,0.050000,0.050000},
-{0.406250,0.731250,0.025000,0.025000},
-{0.406250,0.731250,0.050000,0.050000},
-{0.418750,0.731250,0.025000,0.025000},
-{0.418750,0.731250,0.050000,0.050000},
-{0.431250,0.731250,0.025000,0.025000},
-{0.431250,0.731250,0.050000,0.050000},
-{0.443750,0.731250,0.025000,0.025000},
-{0.443750,0.731250,0.050000,0.050000},
-{0.456250,0.731250,0.025000,0.025000},
-{0.456250,0.731250,0.050000,0.050000},
-{0.468750,0.731250,0.025000,0.025000},
-{0.468750,0.731250,0.050000,0.050000},
-{0.481250,0.731250,0.025000,0.025000},
-{0.481250,0.731250,0.050000,0.050000},
-{0.493750,0.731250,0.025000,0.025000},
-{0.493750,0.731250,0.050000,0.050000},
-{0.506250,0.731250,0.025000,0.025000},
-{0.506250,0.731250,0.050000,0.050000},
-{0.518750,0.731250,0.025000,0.025000},
-{0.518750,0.731250,0.050000,0.050000},
-{0.531250,0.731250,0.025000,0.025000},
-{0.531250,0.731250,0.050000,0.050000},
-{0.543750,0.731250,0.025000,0.025000},
-{0.543750,0.731250,0.050000,0.050000},
-{0.556250,0.731250,0.025000,0.025000},
-{0.556250,0.731250,0.050000,0.050000},
-{0.568750,0.731250,0.025000,0.025000},
-{0.568750,0.731250,0.050000,0.050000},
-{0.581250,0.731250,0.025000,0.025000},
-{0.581250,0.731250,0.050000,0.050000},
-{0.593750,0.731250,0.025000,0.025000},
-{0.593750,0.731250,0.050000,0.050000},
-{0.606250,0.731250,0.025000,0.025000},
-{0.606250,0.731250,0.050000,0.050000},
-{0.618750,0.731250,0.025000,0.025000},
-{0.618750,0.731250,0.050000,0.050000},
-{0.631250,0.731250,0.025000,0.025000},
-{0.631250,0.731250,0.050000,0.050000},
-{0.643750,0.731250,0.025000,0.025000},
-{0.643750,0.731250,0.050000,0.050000},
-{0.656250,0.731250,0.025000,0.025000},
-{0.656250,0.731250,0.050000,0.050000},
-{0.668750,0.731250,0.025000,0.025000},
-{0.668750,0.731250,0.050000,0.050000},
-{0.681250,0.731250,0.025000,0.025000},
-{0.681250,0.731250,0.050000,0.050000},
-{0.693750,0.731250,0.025000,0.025000},
-{0.693750,0.731250,0.050000,0.050000},
-{0.706250,0.731250,0.025000,0.025000},
-{0.706250,0.731250,0.050000,0.050000},
-{0.718750,0.731250,0.025000,0.025000},
-{0.718750,0.731250,0.050000,0.050000},
-{0.731250,0.731250,0.025000,0.025000},
-{0.731250,0.731250,0.050000,0.050000},
-{0.743750,0.731250,0.025000,0.025000},
-{0.743750,0.731250,0.050000,0.050000},
-{0.756250,0.731250,0.025000,0.025000},
-{0.756250,0.731250,0.050000,0.050000},
-{0.768750,0.731250,0.025000,0.025000},
-{0.768750,0.731250,0.050000,0.050000},
-{0.781250,0.731250,0.025000,0.025000},
-{0.781250,0.731250,0.050000,0.050000},
-{0.793750,0.731250,0.025000,0.025000},
-{0.793750,0.731250,0.050000,0.050000},
-{0.806250,0.731250,0.025000,0.025000},
-{0.806250,0.731250,0.050000,0.050000},
-{0.818750,0.731250,0.025000,0.025000},
-{0.818750,0.731250,0.050000,0.050000},
-{0.831250,0.731250,0.025000,0.025000},
-{0.831250,0.731250,0.050000,0.050000},
-{0.843750,0.731250,0.025000,0.025000},
-{0.843750,0.731250,0.050000,0.050000},
-{0.856250,0.731250,0.025000,0.025000},
-{0.856250,0.731250,0.050000,0.050000},
-{0.868750,0.731250,0.025000,0.025000},
-{0.868750,0.731250,0.050000,0.050000},
-{0.881250,0.731250,0.025000,0.025000},
-{0.881250,0.731250,0.050000,0.050000},
-{0.893750,0.731250,0.025000,0.025000},
-{0.893750,0.731250,0.050000,0.050000},
-{0.906250,0.731250,0.025000,0.025000},
-{0.906250,0.731250,0.050000,0.050000},
-{0.918750,0.731250,0.025000,0.025000},
-{0.918750,0.731250,0.050000,0.050000},
-{0.931250,0.731250,0.025000,0.025000},
-{0.931250,0.731250,0.050000,0.050000},
-{0.943750,0.731250,0.025000,0.025000},
-{0.943750,0.731250,0.050000,0.050000},
-{0.956250,0.731250,0.025000,0.025000},
-{0.956250,0.731250,0.050000,0.050000},
-{0.968750,0.731250,0.025000,0.025000},
-{0.968750,0.731250,0.050000,0.050000},
-{0.981250,0.731250,0.025000,0.025000},
-{0.981250,0.731250,0.050000,0.050000},
-{0.993750,0.731250,0.025000,0.025000},
-{0.993750,0.731250,0.050000,0.050000},
-{0.006250,0.743750,0.025000,0.025000},
-{0.006250,0.743750,0.050000,0.050000},
-{0.018750,0.743750,0.025000,0.025000},
-{0.018750,0.743750,0.050000,0.050000},
-{0.031250,0.743750,0.025000,0.025000},
-{0.031250,0.743750,0.050000,0.050000},
-{0.043750,0.743750,0.025000,0.025000},
-{0.043750,0.743750,0.050000,0.050000},
-{0.056250,0.743750,0.025000,0.025000},
-{0.056250,0.743750,0.050000,0.050000},
-{0.068750,0.743750,0.025000,0.025000},
-{0.068750,0.743750,0.050000,0.050000},
-{0.081250,0.743750,0.025000,0.025000},
-{0.081250,0.743750,0.050000,0.050000},
-{0.093750,0.743750,0.025000,0.025000},
-{0.093750,0.743750,0.050000,0.050000},
-{0.106250,0.743750,0.025000,0.025000},
-{0.106250,0.743750,0.050000,0.050000},
-{0.118750,0.743750,0.025000,0.025000},
-{0.118750,0.743750,0.050000,0.050000},
-{0.131250,0.743750,0.025000,0.025000},
-{0.131250,0.743750,0.050000,0.050000},
-{0.143750,0.743750,0.025000,0.025000},
-{0.143750,0.743750,0.050000,0.050000},
-{0.156250,0.743750,0.025000,0.025000},
-{0.156250,0.743750,0.050000,0.050000},
-{0.168750,0.743750,0.025000,0.025000},
-{0.168750,0.743750,0.050000,0.050000},
-{0.181250,0.743750,0.025000,0.025000},
-{0.181250,0.743750,0.050000,0.050000},
-{0.193750,0.743750,0.025000,0.025000},
-{0.193750,0.743750,0.050000,0.050000},
-{0.206250,0.743750,0.025000,0.025000},
-{0.206250,0.743750,0.050000,0.050000},
-{0.218750,0.743750,0.025000,0.025000},
-{0.218750,0.743750,0.050000,0.050000},
-{0.231250,0.743750,0.025000,0.025000},
-{0.231250,0.743750,0.050000,0.050000},
-{0.243750,0.743750,0.025000,0.025000},
-{0.243750,0.743750,0.050000,0.050000},
-{0.256250,0.743750,0.025000,0.025000},
-{0.256250,0.743750,0.050000,0.050000},
-{0.268750,0.743750,0.025000,0.025000},
-{0.268750,0.743750,0.050000,0.050000},
-{0.281250,0.743750,0.025000,0.025000},
-{0.281250,0.743750,0.050000,0.050000},
-{0.293750,0.743750,0.025000,0.025000},
-{0.293750,0.743750,0.050000,0.050000},
-{0.306250,0.743750,0.025000,0.025000},
-{0.306250,0.743750,0.050000,0.050000},
-{0.318750,0.743750,0.025000,0.025000},
-{0.318750,0.743750,0.050000,0.050000},
-{0.331250,0.743750,0.025000,0.025000},
-{0.331250,0.743750,0.050000,0.050000},
-{0.343750,0.743750,0.025000,0.025000},
-{0.343750,0.743750,0.050000,0.050000},
-{0.356250,0.743750,0.025000,0.025000},
-{0.356250,0.743750,0.050000,0.050000},
-{0.368750,0.743750,0.025000,0.025000},
-{0.368750,0.743750,0.050000,0.050000},
-{0.381250,0.743750,0.025000,0.025000},
-{0.381250,0.743750,0.050000,0.050000},
-{0.393750,0.743750,0.025000,0.025000},
-{0.393750,0.743750,0.050000,0.050000},
-{0.406250,0.743750,0.025000,0.025000},
-{0.406250,0.743750,0.050000,0.050000},
-{0.418750,0.743750,0.025000,0.025000},
-{0.418750,0.743750,0.050000,0.050000},
-{0.431250,0.743750,0.025000,0.025000},
-{0.431250,0.743750,0.050000,0.050000},
-{0.443750,0.743750,0.025000,0.025000},
-{0.443750,0.743750,0.050000,0.050000},
-{0.456250,0.743750,0.025000,0.025000},
-{0.456250,0.743750,0.050000,0.050000},
-{0.468750,0.743750,0.025000,0.025000},
-{0.468750,0.743750,0.050000,0.050000},
-{0.481250,0.743750,0.025000,0.025000},
-{0.481250,0.743750,0.050000,0.050000},
-{0.493750,0.743750,0.025000,0.025000},
-{0.493750,0.743750,0.050000,0.050000},
-{0.506250,0.743750,0.025000,0.025000},
-{0.506250,0.743750,0.050000,0.050000},
-{0.518750,0.743750,0.025000,0.025000},
-{0.518750,0.743750,0.050000,0.050000},
-{0.531250,0.743750,0.025000,0.025000},
-{0.531250,0.743750,0.050000,0.050000},
-{0.543750,0.743750,0.025000,0.025000},
-{0.543750,0.743750,0.050000,0.050000},
-{0.556250,0.743750,0.025000,0.025000},
-{0.556250,0.743750,0.050000,0.050000},
-{0.568750,0.743750,0.025000,0.025000},
-{0.568750,0.743750,0.050000,0.050000},
-{0.581250,0.743750,0.025000,0.025000},
-{0.581250,0.743750,0.050000,0.050000},
-{0.593750,0.743750,0.025000,0.025000},
-{0.593750,0.743750,0.050000,0.050000},
-{0.606250,0.743750,0.025000,0.025000},
-{0.606250,0.743750,0.050000,0.050000},
-{0.618750,0.743750,0.025000,0.025000},
-{0.618750,0.743750,0.050000,0.050000},
-{0.631250,0.743750,0.025000,0.025000},
-{0.631250,0.743750,0.050000,0.050000},
-{0.643750,0.743750,0.025000,0.025000},
-{0.643750,0.743750,0.050000,0.050000},
-{0.656250,0.743750,0.025000,0.025000},
-{0.656250,0.743750,0.050000,0.050000},
-{0.668750,0.743750,0.025000,0.025000},
-{0.668750,0.743750,0.050000,0.050000},
-{0.681250,0.743750,0.025000,0.025000},
-{0.681250,0.743750,0.050000,0.050000},
-{0.693750,0.743750,0.025000,0.025000},
-{0.693750,0.743750,0.050000,0.050000},
-{0.706250,0.743750,0.025000,0.025000},
-{0.706250,0.743750,0.050000,0.050000},
-{0.718750,0.743750,0.025000,0.025000},
-{0.718750,0.743750,0.050000,0.050000},
-{0.731250,0.743750,0.025000,0.025000},
-{0.731250,0.743750,0.050000,0.050000},
-{0.743750,0.743750,0.025000,0.025000},
-{0.743750,0.743750,0.050000,0.050000},
-{0.756250,0.743750,0.025000,0.025000},
-{0.756250,0.743750,0.050000,0.050000},
-{0.768750,0.743750,0.025000,0.025000},
-{0.768750,0.743750,0.050000,0.050000},
-{0.781250,0.743750,0.025000,0.025000},
-{0.781250,0.743750,0.050000,0.050000},
-{0.793750,0.743750,0.025000,0.025000},
-{0.793750,0.743750,0.050000,0.050000},
-{0.806250,0.743750,0.025000,0.025000},
-{0.806250,0.743750,0.050000,0.050000},
-{0.818750,0.743750,0.025000,0.025000},
-{0.818750,0.743750,0.050000,0.050000},
-{0.831250,0.743750,0.025000,0.025000},
-{0.831250,0.743750,0.050000,0.050000},
-{0.843750,0.743750,0.025000,0.025000},
-{0.843750,0.743750,0.050000,0.050000},
-{0.856250,0.743750,0.025000,0.025000},
-{0.856250,0.743750,0.050000,0.050000},
-{0.868750,0.743750,0.025000,0.025000},
-{0.868750,0.743750,0.050000,0.050000},
-{0.881250,0.743750,0.025000,0.025000},
-{0.881250,0.743750,0.050000,0.050000},
-{0.893750,0.743750,0.025000,0.025000},
-{0.893750,0.743750,0.050000,0.050000},
-{0.906250,0.743750,0.025000,0.025000},
-{0.906250,0.743750,0.050000,0.050000},
-{0.918750,0.743750,0.025000,0.025000},
-{0.918750,0.743750,0.050000,0.050000},
-{0.931250,0.743750,0.025000,0.025000},
-{0.931250,0.743750,0.050000,0.050000},
-{0.943750,0.743750,0.025000,0.025000},
-{0.943750,0.743750,0.050000,0.050000},
-{0.956250,0.743750,0.025000,0.025000},
-{0.956250,0.743750,0.050000,0.050000},
-{0.968750,0.743750,0.025000,0.025000},
-{0.968750,0.743750,0.050000,0.050000},
-{0.981250,0.743750,0.025000,0.025000},
-{0.981250,0.743750,0.050000,0.050000},
-{0.993750,0.743750,0.025000,0.025000},
-{0.993750,0.743750,0.050000,0.050000},
-{0.006250,0.756250,0.025000,0.025000},
-{0.006250,0.756250,0.050000,0.050000},
-{0.018750,0.756250,0.025000,0.025000},
-{0.018750,0.756250,0.050000,0.050000},
-{0.031250,0.756250,0.025000,0.025000},
-{0.031250,0.756250,0.050000,0.050000},
-{0.043750,0.756250,0.025000,0.025000},
-{0.043750,0.756250,0.050000,0.050000},
-{0.056250,0.756250,0.025000,0.025000},
-{0.056250,0.756250,0.050000,0.050000},
-{0.068750,0.756250,0.025000,0.025000},
-{0.068750,0.756250,0.050000,0.050000},
-{0.081250,0.756250,0.025000,0.025000},
-{0.081250,0.756250,0.050000,0.050000},
-{0.093750,0.756250,0.025000,0.025000},
-{0.093750,0.756250,0.050000,0.050000},
-{0.106250,0.756250,0.025000,0.025000},
-{0.106250,0.756250,0.050000,0.050000},
-{0.118750,0.756250,0.025000,0.025000},
-{0.118750,0.756250,0.050000,0.050000},
-{0.131250,0.756250,0.025000,0.025000},
-{0.131250,0.756250,0.050000,0.050000},
-{0.143750,0.756250,0.025000,0.025000},
-{0.143750,0.756250,0.050000,0.050000},
-{0.156250,0.756250,0.025000,0.025000},
-{0.156250,0.756250,0.050000,0.050000},
-{0.168750,0.756250,0.025000,0.025000},
-{0.168750,0.756250,0.050000,0.050000},
-{0.181250,0.756250,0.025000,0.025000},
-{0.181250,0.756250,0.050000,0.050000},
-{0.193750,0.756250,0.025000,0.025000},
-{0.193750,0.756250,0.050000,0.050000},
-{0.206250,0.756250,0.025000,0.025000},
-{0.206250,0.756250,0.050000,0.050000},
-{0.218750,0.756250,0.025000,0.025000},
-{0.218750,0.756250,0.050000,0.050000},
-{0.231250,0.756250,0.025000,0.025000},
-{0.231250,0.756250,0.050000,0.050000},
-{0.243750,0.756250,0.025000,0.025000},
-{0.243750,0.756250,0.050000,0.050000},
-{0.256250,0.756250,0.025000,0.025000},
-{0.256250,0.756250,0.050000,0.050000},
-{0.268750,0.756250,0.025000,0.025000},
-{0.268750,0.756250,0.050000,0.050000},
-{0.281250,0.756250,0.025000,0.025000},
-{0.281250,0.756250,0.050000,0.050000},
-{0.293750,0.756250,0.025000,0.025000},
-{0.293750,0.756250,0.050000,0.050000},
-{0.306250,0.756250,0.025000,0.025000},
-{0.306250,0.756250,0.050000,0.050000},
-{0.318750,0.756250,0.025000,0.025000},
-{0.318750,0.756250,0.050000,0.050000},
-{0.331250,0.756250,0.025000,0.025000},
-{0.331250,0.756250,0.050000,0.050000},
-{0.343750,0.756250,0.025000,0.025000},
-{0.343750,0.756250,0.050000,0.050000},
-{0.356250,0.756250,0.025000,0.025000},
-{0.356250,0.756250,0.050000,0.050000},
-{0.368750,0.756250,0.025000,0.025000},
-{0.368750,0.756250,0.050000,0.050000},
-{0.381250,0.756250,0.025000,0.025000},
-{0.381250,0.756250,0.050000,0.050000},
-{0.393750,0.756250,0.025000,0.025000},
-{0.393750,0.756250,0.050000,0.050000},
-{0.406250,0.756250,0.025000,0.025000},
-{0.406250,0.756250,0.050000,0.050000},
-{0.418750,0.756250,0.025000,0.025000},
-{0.418750,0.756250,0.050000,0.050000},
-{0.431250,0.756250,0.025000,0.025000},
-{0.431250,0.756250,0.050000,0.050000},
-{0.443750,0.756250,0.025000,0.025000},
-{0.443750,0.756250,0.050000,0.050000},
-{0.456250,0.756250,0.025000,0.025000},
-{0.456250,0.756250,0.050000,0.050000},
-{0.468750,0.756250,0.025000,0.025000},
-{0.468750,0.756250,0.050000,0.050000},
-{0.481250,0.756250,0.025000,0.025000},
-{0.481250,0.756250,0.050000,0.050000},
-{0.493750,0.756250,0.025000,0.025000},
-{0.493750,0.756250,0.050000,0.050000},
-{0.506250,0.756250,0.025000,0.025000},
-{0.506250,0.756250,0.050000,0.050000},
-{0.518750,0.756250,0.025000,0.025000},
-{0.518750,0.756250,0.050000,0.050000},
-{0.531250,0.756250,0.025000,0.025000},
-{0.531250,0.756250,0.050000,0.050000},
-{0.543750,0.756250,0.025000,0.025000},
-{0.543750,0.756250,0.050000,0.050000},
-{0.556250,0.756250,0.025000,0.025000},
-{0.556250,0.756250,0.050000,0.050000},
-{0.568750,0.756250,0.025000,0.025000},
-{0.568750,0.756250,0.050000,0.050000},
-{0.581250,0.756250,0.025000,0.025000},
-{0.581250,0.756250,0.050000,0.050000},
-{0.593750,0.756250,0.025000,0.025000},
-{0.593750,0.756250,0.050000,0.050000},
-{0.606250,0.756250,0.025000,0.025000},
-{0.606250,0.756250,0.050000,0.050000},
-{0.618750,0.756250,0.025000,0.025000},
-{0.618750,0.756250,0.050000,0.050000},
-{0.631250,0.756250,0.025000,0.025000},
-{0.631250,0.756250,0.050000,0.050000},
-{0.643750,0.756250,0.025000,0.025000},
-{0.643750,0.756250,0.050000,0.050000},
-{0.656250,0.756250,0.025000,0.025000},
-{0.656250,0.756250,0.050000,0.050000},
-{0.668750,0.756250,0.025000,0.025000},
-{0.668750,0.756250,0.050000,0.050000},
-{0.681250,0.756250,0.025000,0.025000},
-{0.681250,0.756250,0.050000,0.050000},
-{0.693750,0.756250,0.025000,0.025000},
-{0.693750,0.756250,0.050000,0.050000},
-{0.706250,0.756250,0.025000,0.025000},
-{0.706250,0.756250,0.050000,0.050000},
-{0.718750,0.756250,0.025000,0.025000},
-{0.718750,0.756250,0.050000,0.050000},
-{0.731250,0.756250,0.025000,0.025000},
-{0.731250,0.756250,0.050000,0.050000},
-{0.743750,0.756250,0.025000,0.025000},
-{0.743750,0.756250,0.050000,0.050000},
-{0.756250,0.756250,0.025000,0.025000},
-{0.756250,0.756250,0.050000,0.050000},
-{0.768750,0.756250,0.025000,0.025000},
-{0.768750,0.756250,0.050000,0.050000},
-{0.781250,0.756250,0.025000,0.025000},
-{0.781250,0.756250,0.050000,0.050000},
-{0.793750,0.756250,0.025000,0.025000},
-{0.793750,0.756250,0.050000,0.050000},
-{0.806250,0.756250,0.025000,0.025000},
-{0.806250,0.756250,0.050000,0.050000},
-{0.818750,0.756250,0.025000,0.025000},
-{0.818750,0.756250,0.050000,0.050000},
-{0.831250,0.756250,0.025000,0.025000},
-{0.831250,0.756250,0.050000,0.050000},
-{0.843750,0.756250,0.025000,0.025000},
-{0.843750,0.756250,0.050000,0.050000},
-{0.856250,0.756250,0.025000,0.025000},
-{0.856250,0.756250,0.050000,0.050000},
-{0.868750,0.756250,0.025000,0.025000},
-{0.868750,0.756250,0.050000,0.050000},
-{0.881250,0.756250,0.025000,0.025000},
-{0.881250,0.756250,0.050000,0.050000},
-{0.893750,0.756250,0.025000,0.025000},
-{0.893750,0.756250,0.050000,0.050000},
-{0.906250,0.756250,0.025000,0.025000},
-{0.906250,0.756250,0.050000,0.050000},
-{0.918750,0.756250,0.025000,0.025000},
-{0.918750,0.756250,0.050000,0.050000},
-{0.931250,0.756250,0.025000,0.025000},
-{0.931250,0.756250,0.050000,0.050000},
-{0.943750,0.756250,0.025000,0.025000},
-{0.943750,0.756250,0.050000,0.050000},
-{0.956250,0.756250,0.025000,0.025000},
-{0.956250,0.756250,0.050000,0.050000},
-{0.968750,0.756250,0.025000,0.025000},
-{0.968750,0.756250,0.050000,0.050000},
-{0.981250,0.756250,0.025000,0.025000},
-{0.981250,0.756250,0.050000,0.050000},
-{0.993750,0.756250,0.025000,0.025000},
-{0.993750,0.756250,0.050000,0.050000},
-{0.006250,0.768750,0.025000,0.025000},
-{0.006250,0.768750,0.050000,0.050000},
-{0.018750,0.768750,0.025000,0.025000},
-{0.018750,0.768750,0.050000,0.050000},
-{0.031250,0.768750,0.025000,0.025000},
-{0.031250,0.768750,0.050000,0.050000},
-{0.043750,0.768750,0.025000,0.025000},
-{0.043750,0.768750,0.050000,0.050000},
-{0.056250,0.768750,0.025000,0.025000},
-{0.056250,0.768750,0.050000,0.050000},
-{0.068750,0.768750,0.025000,0.025000},
-{0.068750,0.768750,0.050000,0.050000},
-{0.081250,0.768750,0.025000,0.025000},
-{0.081250,0.768750,0.050000,0.050000},
-{0.093750,0.768750,0.025000,0.025000},
-{0.093750,0.768750,0.050000,0.050000},
-{0.106250,0.768750,0.025000,0.025000},
-{0.106250,0.768750,0.050000,0.050000},
-{0.118750,0.768750,0.025000,0.025000},
-{0.118750,0.768750,0.050000,0.050000},
-{0.131250,0.768750,0.025000,0.025000},
-{0.131250,0.768750,0.050000,0.050000},
-{0.143750,0.768750,0.025000,0.025000},
-{0.143750,0.768750,0.050000,0.050000},
-{0.156250,0.768750,0.025000,0.025000},
-{0.156250,0.768750,0.050000,0.050000},
-{0.168750,0.768750,0.025000,0.025000},
-{0.168750,0.768750,0.050000,0.050000},
-{0.181250,0.768750,0.025000,0.025000},
-{0.181250,0.768750,0.050000,0.050000},
-{0.193750,0.768750,0.025000,0.025000},
-{0.193750,0.768750,0.050000,0.050000},
-{0.206250,0.768750,0.025000,0.025000},
-{0.206250,0.768750,0.050000,0.050000},
-{0.218750,0.768750,0.025000,0.025000},
-{0.218750,0.768750,0.050000,0.050000},
-{0.231250,0.768750,0.025000,0.025000},
-{0.231250,0.768750,0.050000,0.050000},
-{0.243750,0.768750,0.025000,0.025000},
-{0.243750,0.768750,0.050000,0.050000},
-{0.256250,0.768750,0.025000,0.025000},
-{0.256250,0.768750,0.050000,0.050000},
-{0.268750,0.768750,0.025000,0.025000},
-{0.268750,0.768750,0.050000,0.050000},
-{0.281250,0.768750,0.025000,0.025000},
-{0.281250,0.768750,0.050000,0.050000},
-{0.293750,0.768750,0.025000,0.025000},
-{0.293750,0.768750,0.050000,0.050000},
-{0.306250,0.768750,0.025000,0.025000},
-{0.306250,0.768750,0.050000,0.050000},
-{0.318750,0.768750,0.025000,0.025000},
-{0.318750,0.768750,0.050000,0.050000},
-{0.331250,0.768750,0.025000,0.025000},
-{0.331250,0.768750,0.050000,0.050000},
-{0.343750,0.768750,0.025000,0.025000},
-{0.343750,0.768750,0.050000,0.050000},
-{0.356250,0.768750,0.025000,0.025000},
-{0.356250,0.768750,0.050000,0.050000},
-{0.368750,0.768750,0.025000,0.025000},
-{0.368750,0.768750,0.050000,0.050000},
-{0.381250,0.768750,0.025000,0.025000},
-{0.381250,0.768750,0.050000,0.050000},
-{0.393750,0.768750,0.025000,0.025000},
-{0.393750,0.768750,0.050000,0.050000},
-{0.406250,0.768750,0.025000,0.025000},
-{0.406250,0.768750,0.050000,0.050000},
-{0.418750,0.768750,0.025000,0.025000},
-{0.418750,0.768750,0.050000,0.050000},
-{0.431250,0.768750,0.025000,0.025000},
-{0.431250,0.768750,0.050000,0.050000},
-{0.443750,0.768750,0.025000,0.025000},
-{0.443750,0.768750,0.050000,0.050000},
-{0.456250,0.768750,0.025000,0.025000},
-{0.456250,0.768750,0.050000,0.050000},
-{0.468750,0.768750,0.025000,0.025000},
-{0.468750,0.768750,0.050000,0.050000},
-{0.481250,0.768750,0.025000,0.025000},
-{0.481250,0.768750,0.050000,0.050000},
-{0.493750,0.768750,0.025000,0.025000},
-{0.493750,0.768750,0.050000,0.050000},
-{0.506250,0.768750,0.025000,0.025000},
-{0.506250,0.768750,0.050000,0.050000},
-{0.518750,0.768750,0.025000,0.025000},
-{0.518750,0.768750,0.050000,0.050000},
-{0.531250,0.768750,0.025000,0.025000},
-{0.531250,0.768750,0.050000,0.050000},
-{0.543750,0.768750,0.025000,0.025000},
-{0.543750,0.768750,0.050000,0.050000},
-{0.556250,0.768750,0.025000,0.025000},
-{0.556250,0.768750,0.050000,0.050000},
-{0.568750,0.768750,0.025000,0.025000},
-{0.568750,0.768750,0.050000,0.050000},
-{0.581250,0.768750,0.025000,0.025000},
-{0.581250,0.768750,0.050000,0.050000},
-{0.593750,0.768750,0.025000,0.025000},
-{0.593750,0.768750,0.050000,0.050000},
-{0.606250,0.768750,0.025000,0.025000},
-{0.606250,0.768750,0.050000,0.050000},
-{0.618750,0.768750,0.025000,0.025000},
-{0.618750,0.768750,0.050000,0.050000},
-{0.631250,0.768750,0.025000,0.025000},
-{0.631250,0.768750,0.050000,0.050000},
-{0.643750,0.768750,0.025000,0.025000},
-{0.643750,0.768750,0.050000,0.050000},
-{0.656250,0.768750,0.025000,0.025000},
-{0.656250,0.768750,0.050000,0.050000},
-{0.668750,0.768750,0.025000,0.025000},
-{0.668750,0.768750,0.050000,0.050000},
-{0.681250,0.768750,0.025000,0.025000},
-{0.681250,0.768750,0.050000,0.050000},
-{0.693750,0.768750,0.025000,0.025000},
-{0.693750,0.768750,0.050000,0.050000},
-{0.706250,0.768750,0.025000,0.025000},
-{0.706250,0.768750,0.050000,0.050000},
-{0.718750,0.768750,0.025000,0.025000},
-{0.718750,0.768750,0.050000,0.050000},
-{0.731250,0.768750,0.025000,0.025000},
-{0.731250,0.768750,0.050000,0.050000},
-{0.743750,0.768750,0.025000,0.025000},
-{0.743750,0.768750,0.050000,0.050000},
-{0.756250,0.768750,0.025000,0.025000},
-{0.756250,0.768750,0.050000,0.050000},
-{0.768750,0.768750,0.025000,0.025000},
-{0.768750,0.768750,0.050000,0.050000},
-{0.781250,0.768750,0.025000,0.025000},
-{0.781250,0.768750,0.050000,0.050000},
-{0.793750,0.768750,0.025000,0.025000},
-{0.793750,0.768750,0.050000,0.050000},
-{0.806250,0.768750,0.025000,0.025000},
-{0.806250,0.768750,0.050000,0.050000},
-{0.818750,0.768750,0.025000,0.025000},
-{0.818750,0.768750,0.050000,0.050000},
-{0.831250,0.768750,0.025000,0.025000},
-{0.831250,0.768750,0.050000,0.050000},
-{0.843750,0.768750,0.025000,0.025000},
-{0.843750,0.768750,0.050000,0.050000},
-{0.856250,0.768750,0.025000,0.025000},
-{0.856250,0.768750,0.050000,0.050000},
-{0.868750,0.768750,0.025000,0.025000},
-{0.868750,0.768750,0.050000,0.050000},
-{0.881250,0.768750,0.025000,0.025000},
-{0.881250,0.768750,0.050000,0.050000},
-{0.893750,0.768750,0.025000,0.025000},
-{0.893750,0.768750,0.050000,0.050000},
-{0.906250,0.768750,0.025000,0.025000},
-{0.906250,0.768750,0.050000,0.050000},
-{0.918750,0.768750,0.025000,0.025000},
-{0.918750,0.768750,0.050000,0.050000},
-{0.931250,0.768750,0.025000,0.025000},
-{0.931250,0.768750,0.050000,0.050000},
-{0.943750,0.768750,0.025000,0.025000},
-{0.943750,0.768750,0.050000,0.050000},
-{0.956250,0.768750,0.025000,0.025000},
-{0.956250,0.768750,0.050000,0.050000},
-{0.968750,0.768750,0.025000,0.025000},
-{0.968750,0.768750,0.050000,0.050000},
-{0.981250,0.768750,0.025000,0.025000},
-{0.981250,0.768750,0.050000,0.050000},
-{0.993750,0.768750,0.025000,0.025000},
-{0.993750,0.768750,0.050000,0.050000},
-{0.006250,0.781250,0.025000,0.025000},
-{0.006250,0.781250,0.050000,0.050000},
-{0.018750,0.781250,0.025000,0.025000},
-{0.018750,0.781250,0.050000,0.050000},
-{0.031250,0.781250,0.025000,0.025000},
-{0.031250,0.781250,0.050000,0.050000},
-{0.043750,0.781250,0.025000,0.025000},
-{0.043750,0.781250,0.050000,0.050000},
-{0.056250,0.781250,0.025000,0.025000},
-{0.056250,0.781250,0.050000,0.050000},
-{0.068750,0.781250,0.025000,0.025000},
-{0.068750,0.781250,0.050000,0.050000},
-{0.081250,0.781250,0.025000,0.025000},
-{0.081250,0.781250,0.050000,0.050000},
-{0.093750,0.781250,0.025000,0.025000},
-{0.093750,0.781250,0.050000,0.050000},
-{0.106250,0.781250,0.025000,0.025000},
-{0.106250,0.781250,0.050000,0.050000},
-{0.118750,0.781250,0.025000,0.025000},
-{0.118750,0.781250,0.050000,0.050000},
-{0.131250,0.781250,0.025000,0.025000},
-{0.131250,0.781250,0.050000,0.050000},
-{0.143750,0.781250,0.025000,0.025000},
-{0.143750,0.781250,0.050000,0.050000},
-{0.156250,0.781250,0.025000,0.025000},
-{0.156250,0.781250,0.050000,0.050000},
-{0.168750,0.781250,0.025000,0.025000},
-{0.168750,0.781250,0.050000,0.050000},
-{0.181250,0.781250,0.025000,0.025000},
-{0.181250,0.781250,0.050000,0.050000},
-{0.193750,0.781250,0.025000,0.025000},
-{0.193750,0.781250,0.050000,0.050000},
-{0.206250,0.781250,0.025000,0.025000},
-{0.206250,0.781250,0.050000,0.050000},
-{0.218750,0.781250,0.025000,0.025000},
-{0.218750,0.781250,0.050000,0.050000},
-{0.231250,0.781250,0.025000,0.025000},
-{0.231250,0.781250,0.050000,0.050000},
-{0.243750,0.781250,0.025000,0.025000},
-{0.243750,0.781250,0.050000,0.050000},
-{0.256250,0.781250,0.025000,0.025000},
-{0.256250,0.781250,0.050000,0.050000},
-{0.268750,0.781250,0.025000,0.025000},
-{0.268750,0.781250,0.050000,0.050000},
-{0.281250,0.781250,0.025000,0.025000},
-{0.281250,0.781250,0.050000,0.050000},
-{0.293750,0.781250,0.025000,0.025000},
-{0.293750,0.781250,0.050000,0.050000},
-{0.306250,0.781250,0.025000,0.025000},
-{0.306250,0.781250,0.050000,0.050000},
-{0.318750,0.781250,0.025000,0.025000},
-{0.318750,0.781250,0.050000,0.050000},
-{0.331250,0.781250,0.025000,0.025000},
-{0.331250,0.781250,0.050000,0.050000},
-{0.343750,0.781250,0.025000,0.025000},
-{0.343750,0.781250,0.050000,0.050000},
-{0.356250,0.781250,0.025000,0.025000},
-{0.356250,0.781250,0.050000,0.050000},
-{0.368750,0.781250,0.025000,0.025000},
-{0.368750,0.781250,0.050000,0.050000},
-{0.381250,0.781250,0.025000,0.025000},
-{0.381250,0.781250,0.050000,0.050000},
-{0.393750,0.781250,0.025000,0.025000},
-{0.393750,0.781250,0.050000,0.050000},
-{0.406250,0.781250,0.025000,0.025000},
-{0.406250,0.781250,0.050000,0.050000},
-{0.418750,0.781250,0.025000,0.025000},
-{0.418750,0.781250,0.050000,0.050000},
-{0.431250,0.781250,0.025000,0.025000},
-{0.431250,0.781250,0.050000,0.050000},
-{0.443750,0.781250,0.025000,0.025000},
-{0.443750,0.781250,0.050000,0.050000},
-{0.456250,0.781250,0.025000,0.025000},
-{0.456250,0.781250,0.050000,0.050000},
-{0.468750,0.781250,0.025000,0.025000},
-{0.468750,0.781250,0.050000,0.050000},
-{0.481250,0.781250,0.025000,0.025000},
-{0.481250,0.781250,0.050000,0.050000},
-{0.493750,0.781250,0.025000,0.025000},
-{0.493750,0.781250,0.050000,0.050000},
-{0.506250,0.781250,0.025000,0.025000},
-{0.506250,0.781250,0.050000,0.050000},
-{0.518750,0.781250,0.025000,0.025000},
-{0.518750,0.781250,0.050000,0.050000},
-{0.531250,0.781250,0.025000,0.025000},
-{0.531250,0.781250,0.050000,0.050000},
-{0.543750,0.781250,0.025000,0.025000},
-{0.543750,0.781250,0.050000,0.050000},
-{0.556250,0.781250,0.025000,0.025000},
-{0.556250,0.781250,0.050000,0.050000},
-{0.568750,0.781250,0.025000,0.025000},
-{0.568750,0.781250,0.050000,0.050000},
-{0.581250,0.781250,0.025000,0.025000},
-{0.581250,0.781250,0.050000,0.050000},
-{0.593750,0.781250,0.025000,0.025000},
-{0.593750,0.781250,0.050000,0.050000},
-{0.606250,0.781250,0.025000,0.025000},
-{0.606250,0.781250,0.050000,0.050000},
-{0.618750,0.781250,0.025000,0.025000},
-{0.618750,0.781250,0.050000,0.050000},
-{0.631250,0.781250,0.025000,0.025000},
-{0.631250,0.781250,0.050000,0.050000},
-{0.643750,0.781250,0.025000,0.025000},
-{0.643750,0.781250,0.050000,0.050000},
-{0.656250,0.781250,0.025000,0.025000},
-{0.656250,0.781250,0.050000,0.050000},
-{0.668750,0.781250,0.025000,0.025000},
-{0.668750,0.781250,0.050000,0.050000},
-{0.681250,0.781250,0.025000,0.025000},
-{0.681250,0.781250,0.050000,0.050000},
-{0.693750,0.781250,0.025000,0.025000},
-{0.693750,0.781250,0.050000,0.050000},
-{0.706250,0.781250,0.025000,0.025000},
-{0.706250,0.781250,0.050000,0.050000},
-{0.718750,0.781250,0.025000,0.025000},
-{0.718750,0.781250,0.050000,0.050000},
-{0.731250,0.781250,0.025000,0.025000},
-{0.731250,0.781250,0.050000,0.050000},
-{0.743750,0.781250,0.025000,0.025000},
-{0.743750,0.781250,0.050000,0.050000},
-{0.756250,0.781250,0.025000,0.025000},
-{0.756250,0.781250,0.050000,0.050000},
-{0.768750,0.781250,0.025000,0.025000},
-{0.768750,0.781250,0.050000,0.050000},
-{0.781250,0.781250,0.025000,0.025000},
-{0.781250,0.781250,0.050000,0.050000},
-{0.793750,0.781250,0.025000,0.025000},
-{0.793750,0.781250,0.050000,0.050000},
-{0.806250,0.781250,0.025000,0.025000},
-{0.806250,0.781250,0.050000,0.050000},
-{0.818750,0.781250,0.025000,0.025000},
-{0.818750,0.781250,0.050000,0.050000},
-{0.831250,0.781250,0.025000,0.025000},
-{0.831250,0.781250,0.050000,0.050000},
-{0.843750,0.781250,0.025000,0.025000},
-{0.843750,0.781250,0.050000,0.050000},
-{0.856250,0.781250,0.025000,0.025000},
-{0.856250,0.781250,0.050000,0.050000},
-{0.868750,0.781250,0.025000,0.025000},
-{0.868750,0.781250,0.050000,0.050000},
-{0.881250,0.781250,0.025000,0.025000},
-{0.881250,0.781250,0.050000,0.050000},
-{0.893750,0.781250,0.025000,0.025000},
-{0.893750,0.781250,0.050000,0.050000},
-{0.906250,0.781250,0.025000,0.025000},
-{0.906250,0.781250,0.050000,0.050000},
-{0.918750,0.781250,0.025000,0.025000},
-{0.918750,0.781250,0.050000,0.050000},
-{0.931250,0.781250,0.025000,0.025000},
-{0.931250,0.781250,0.050000,0.050000},
-{0.943750,0.781250,0.025000,0.025000},
-{0.943750,0.781250,0.050000,0.050000},
-{0.956250,0.781250,0.025000,0.025000},
-{0.956250,0.781250,0.050000,0.050000},
-{0.968750,0.781250,0.025000,0.025000},
-{0.968750,0.781250,0.050000,0.050000},
-{0.981250,0.781250,0.025000,0.025000},
-{0.981250,0.781250,0.050000,0.050000},
-{0.993750,0.781250,0.025000,0.025000},
-{0.993750,0.781250,0.050000,0.050000},
-{0.006250,0.793750,0.025000,0.025000},
-{0.006250,0.793750,0.050000,0.050000},
-{0.018750,0.793750,0.025000,0.025000},
-{0.018750,0.793750,0.050000,0.050000},
-{0.031250,0.793750,0.025000,0.025000},
-{0.031250,0.793750,0.050000,0.050000},
-{0.043750,0.793750,0.025000,0.025000},
-{0.043750,0.793750,0.050000,0.050000},
-{0.056250,0.793750,0.025000,0.025000},
-{0.056250,0.793750,0.050000,0.050000},
-{0.068750,0.793750,0.025000,0.025000},
-{0.068750,0.793750,0.050000,0.050000},
-{0.081250,0.793750,0.025000,0.025000},
-{0.081250,0.793750,0.050000,0.050000},
-{0.093750,0.793750,0.025000,0.025000},
-{0.093750,0.793750,0.050000,0.050000},
-{0.106250,0.793750,0.025000,0.025000},
-{0.106250,0.793750,0.050000,0.050000},
-{0.118750,0.793750,0.025000,0.025000},
-{0.118750,0.793750,0.050000,0.050000},
-{0.131250,0.793750,0.025000,0.025000},
-{0.131250,0.793750,0.050000,0.050000},
-{0.143750,0.793750,0.025000,0.025000},
-{0.143750,0.793750,0.050000,0.050000},
-{0.156250,0.793750,0.025000,0.025000},
-{0.156250,0.793750,0.050000,0.050000},
-{0.168750,0.793750,0.025000,0.025000},
-{0.168750,0.793750,0.050000,0.050000},
-{0.181250,0.793750,0.025000,0.025000},
-{0.181250,0.793750,0.050000,0.050000},
-{0.193750,0.793750,0.025000,0.025000},
-{0.193750,0.793750,0.050000,0.050000},
-{0.206250,0.793750,0.025000,0.025000},
-{0.206250,0.793750,0.050000,0.050000},
-{0.218750,0.793750,0.025000,0.025000},
-{0.218750,0.793750,0.050000,0.050000},
-{0.231250,0.793750,0.025000,0.025000},
-{0.231250,0.793750,0.050000,0.050000},
-{0.243750,0.793750,0.025000,0.025000},
-{0.243750,0.793750,0.050000,0.050000},
-{0.256250,0.793750,0.025000,0.025000},
-{0.256250,0.793750,0.050000,0.050000},
-{0.268750,0.793750,0.025000,0.025000},
-{0.268750,0.793750,0.050000,0.050000},
-{0.281250,0.793750,0.025000,0.025000},
-{0.281250,0.793750,0.050000,0.050000},
-{0.293750,0.793750,0.025000,0.025000},
-{0.293750,0.793750,0.050000,0.050000},
-{0.306250,0.793750,0.025000,0.025000},
-{0.306250,0.793750,0.050000,0.050000},
-{0.318750,0.793750,0.025000,0.025000},
-{0.318750,0.793750,0.050000,0.050000},
-{0.331250,0.793750,0.025000,0.025000},
-{0.331250,0.793750,0.050000,0.050000},
-{0.343750,0.793750,0.025000,0.025000},
-{0.343750,0.793750,0.050000,0.050000},
-{0.356250,0.793750,0.025000,0.025000},
-{0.356250,0.793750,0.050000,0.050000},
-{0.368750,0.793750,0.025000,0.025000},
-{0.368750,0.793750,0.050000,0.050000},
-{0.381250,0.793750,0.025000,0.025000},
-{0.381250,0.793750,0.050000,0.050000},
-{0.393750,0.793750,0.025000,0.025000},
-{0.393750,0.793750,0.050000,0.050000},
-{0.406250,0.793750,0.025000,0.025000},
-{0.406250,0.793750,0.050000,0.050000},
-{0.418750,0.793750,0.025000,0.025000},
-{0.418750,0.793750,0.050000,0.050000},
-{0.431250,0.793750,0.025000,0.025000},
-{0.431250,0.793750,0.050000,0.050000},
-{0.443750,0.793750,0.025000,0.025000},
-{0.443750,0.793750,0.050000,0.050000},
-{0.456250,0.793750,0.025000,0.025000},
-{0.456250,0.793750,0.050000,0.050000},
-{0.468750,0.793750,0.025000,0.025000},
-{0.468750,0.793750,0.050000,0.050000},
-{0.481250,0.793750,0.025000,0.025000},
-{0.481250,0.793750,0.050000,0.050000},
-{0.493750,0.793750,0.025000,0.025000},
-{0.493750,0.793750,0.050000,0.050000},
-{0.506250,0.793750,0.025000,0.025000},
-{0.506250,0.793750,0.050000,0.050000},
-{0.518750,0.793750,0.025000,0.025000},
-{0.518750,0.793750,0.050000,0.050000},
-{0.531250,0.793750,0.025000,0.025000},
-{0.531250,0.793750,0.050000,0.050000},
-{0.543750,0.793750,0.025000,0.025000},
-{0.543750,0.793750,0.050000,0.050000},
-{0.556250,0.793750,0.025000,0.025000},
-{0.556250,0.793750,0.050000,0.050000},
-{0.568750,0.793750,0.025000,0.025000},
-{0.568750,0.793750,0.050000,0.050000},
-{0.581250,0.793750,0.025000,0.025000},
-{0.581250,0.793750,0.050000,0.050000},
-{0.593750,0.793750,0.025000,0.025000},
-{0.593750,0.793750,0.050000,0.050000},
-{0.606250,0.793750,0.025000,0.025000},
-{0.606250,0.793750,0.050000,0.050000},
-{0.618750,0.793750,0.025000,0.025000},
-{0.618750,0.793750,0.050000,0.050000},
-{0.631250,0.793750,0.025000,0.025000},
-{0.631250,0.793750,0.050000,0.050000},
-{0.643750,0.793750,0.025000,0.025000},
-{0.643750,0.793750,0.050000,0.050000},
-{0.656250,0.793750,0.025000,0.025000},
-{0.656250,0.793750,0.050000,0.050000},
-{0.668750,0.793750,0.025000,0.025000},
-{0.668750,0.793750,0.050000,0.050000},
-{0.681250,0.793750,0.025000,0.025000},
-{0.681250,0.793750,0.050000,0.050000},
-{0.693750,0.793750,0.025000,0.025000},
-{0.693750,0.793750,0.050000,0.050000},
-{0.706250,0.793750,0.025000,0.025000},
-{0.706250,0.793750,0.050000,0.050000},
-{0.718750,0.793750,0.025000,0.025000},
-{0.718750,0.793750,0.050000,0.050000},
-{0.731250,0.793750,0.025000,0.025000},
-{0.731250,0.793750,0.050000,0.050000},
-{0.743750,0.793750,0.025000,0.025000},
-{0.743750,0.793750,0.050000,0.050000},
-{0.756250,0.793750,0.025000,0.025000},
-{0.756250,0.793750,0.050000,0.050000},
-{0.768750,0.793750,0.025000,0.025000},
-{0.768750,0.793750,0.050000,0.050000},
-{0.781250,0.793750,0.025000,0.025000},
-{0.781250,0.793750,0.050000,0.050000},
-{0.793750,0.793750,0.025000,0.025000},
-{0.793750,0.793750,0.050000,0.050000},
-{0.806250,0.793750,0.025000,0.025000},
-{0.806250,0.793750,0.050000,0.050000},
-{0.818750,0.793750,0.025000,0.025000},
-{0.818750,0.793750,0.050000,0.050000},
-{0.831250,0.793750,0.025000,0.025000},
-{0.831250,0.793750,0.050000,0.050000},
-{0.843750,0.793750,0.025000,0.025000},
-{0.843750,0.793750,0.050000,0.050000},
-{0.856250,0.793750,0.025000,0.025000},
-{0.856250,0.793750,0.050000,0.050000},
-{0.868750,0.793750,0.025000,0.025000},
-{0.868750,0.793750,0.050000,0.050000},
-{0.881250,0.793750,0.025000,0.025000},
-{0.881250,0.793750,0.050000,0.050000},
-{0.893750,0.793750,0.025000,0.025000},
-{0.893750,0.793750,0.050000,0.050000},
-{0.906250,0.793750,0.025000,0.025000},
-{0.906250,0.793750,0.050000,0.050000},
-{0.918750,0.793750,0.025000,0.025000},
-{0.918750,0.793750,0.050000,0.050000},
-{0.931250,0.793750,0.025000,0.025000},
-{0.931250,0.793750,0.050000,0.050000},
-{0.943750,0.793750,0.025000,0.025000},
-{0.943750,0.793750,0.050000,0.050000},
-{0.956250,0.793750,0.025000,0.025000},
-{0.956250,0.793750,0.050000,0.050000},
-{0.968750,0.793750,0.025000,0.025000},
-{0.968750,0.793750,0.050000,0.050000},
-{0.981250,0.793750,0.025000,0.025000},
-{0.981250,0.793750,0.050000,0.050000},
-{0.993750,0.793750,0.025000,0.025000},
-{0.993750,0.793750,0.050000,0.050000},
-{0.006250,0.806250,0.025000,0.025000},
-{0.006250,0.806250,0.050000,0.050000},
-{0.018750,0.806250,0.025000,0.025000},
-{0.018750,0.806250,0.050000,0.050000},
-{0.031250,0.806250,0.025000,0.025000},
-{0.031250,0.806250,0.050000,0.050000},
-{0.043750,0.806250,0.025000,0.025000},
-{0.043750,0.806250,0.050000,0.050000},
-{0.056250,0.806250,0.025000,0.025000},
-{0.056250,0.806250,0.050000,0.050000},
-{0.068750,0.806250,0.025000,0.025000},
-{0.068750,0.806250,0.050000,0.050000},
-{0.081250,0.806250,0.025000,0.025000},
-{0.081250,0.806250,0.050000,0.050000},
-{0.093750,0.806250,0.025000,0.025000},
-{0.093750,0.806250,0.050000,0.050000},
-{0.106250,0.806250,0.025000,0.025000},
-{0.106250,0.806250,0.050000,0.050000},
-{0.118750,0.806250,0.025000,0.025000},
-{0.118750,0.806250,0.050000,0.050000},
-{0.131250,0.806250,0.025000,0.025000},
-{0.131250,0.806250,0.050000,0.050000},
-{0.143750,0.806250,0.025000,0.025000},
-{0.143750,0.806250,0.050000,0.050000},
-{0.156250,0.806250,0.025000,0.025000},
-{0.156250,0.806250,0.050000,0.050000},
-{0.168750,0.806250,0.025000,0.025000},
-{0.168750,0.806250,0.050000,0.050000},
-{0.181250,0.806250,0.025000,0.025000},
-{0.181250,0.806250,0.050000,0.050000},
-{0.193750,0.806250,0.025000,0.025000},
-{0.193750,0.806250,0.050000,0.050000},
-{0.206250,0.806250,0.025000,0.025000},
-{0.206250,0.806250,0.050000,0.050000},
-{0.218750,0.806250,0.025000,0.025000},
-{0.218750,0.806250,0.050000,0.050000},
-{0.231250,0.806250,0.025000,0.025000},
-{0.231250,0.806250,0.050000,0.050000},
-{0.243750,0.806250,0.025000,0.025000},
-{0.243750,0.806250,0.050000,0.050000},
-{0.256250,0.806250,0.025000,0.025000},
-{0.256250,0.806250,0.050000,0.050000},
-{0.268750,0.806250,0.025000,0.025000},
-{0.268750,0.806250,0.050000,0.050000},
-{0.281250,0.806250,0.025000,0.025000},
-{0.281250,0.806250,0.050000,0.050000},
-{0.293750,0.806250,0.025000,0.025000},
-{0.293750,0.806250,0.050000,0.050000},
-{0.306250,0.806250,0.025000,0.025000},
-{0.306250,0.806250,0.050000,0.050000},
-{0.318750,0.806250,0.025000,0.025000},
-{0.318750,0.806250,0.050000,0.050000},
-{0.331250,0.806250,0.025000,0.025000},
-{0.331250,0.806250,0.050000,0.050000},
-{0.343750,0.806250,0.025000,0.025000},
-{0.343750,0.806250,0.050000,0.050000},
-{0.356250,0.806250,0.025000,0.025000},
-{0.356250,0.806250,0.050000,0.050000},
-{0.368750,0.806250,0.025000,0.025000},
-{0.368750,0.806250,0.050000,0.050000},
-{0.381250,0.806250,0.025000,0.025000},
-{0.381250,0.806250,0.050000,0.050000},
-{0.393750,0.806250,0.025000,0.025000},
-{0.393750,0.806250,0.050000,0.050000},
-{0.406250,0.806250,0.025000,0.025000},
-{0.406250,0.806250,0.050000,0.050000},
-{0.418750,0.806250,0.025000,0.025000},
-{0.418750,0.806250,0.050000,0.050000},
-{0.431250,0.806250,0.025000,0.025000},
-{0.431250,0.806250,0.050000,0.050000},
-{0.443750,0.806250,0.025000,0.025000},
-{0.443750,0.806250,0.050000,0.050000},
-{0.456250,0.806250,0.025000,0.025000},
-{0.456250,0.806250,0.050000,0.050000},
-{0.468750,0.806250,0.025000,0.025000},
-{0.468750,0.806250,0.050000,0.050000},
-{0.481250,0.806250,0.025000,0.025000},
-{0.481250,0.806250,0.050000,0.050000},
-{0.493750,0.806250,0.025000,0.025000},
-{0.493750,0.806250,0.050000,0.050000},
-{0.506250,0.806250,0.025000,0.025000},
-{0.506250,0.806250,0.050000,0.050000},
-{0.518750,0.806250,0.025000,0.025000},
-{0.518750,0.806250,0.050000,0.050000},
-{0.531250,0.806250,0.025000,0.025000},
-{0.531250,0.806250,0.050000,0.050000},
-{0.543750,0.806250,0.025000,0.025000},
-{0.543750,0.806250,0.050000,0.050000},
-{0.556250,0.806250,0.025000,0.025000},
-{0.556250,0.806250,0.050000,0.050000},
-{0.568750,0.806250,0.025000,0.025000},
-{0.568750,0.806250,0.050000,0.050000},
-{0.581250,0.806250,0.025000,0.025000},
-{0.581250,0.806250,0.050000,0.050000},
-{0.593750,0.806250,0.025000,0.025000},
-{0.593750,0.806250,0.050000,0.050000},
-{0.606250,0.806250,0.025000,0.025000},
-{0.606250,0.806250,0.050000,0.050000},
-{0.618750,0.806250,0.025000,0.025000},
-{0.618750,0.806250,0.050000,0.050000},
-{0.631250,0.806250,0.025000,0.025000},
-{0.631250,0.806250,0.050000,0.050000},
-{0.643750,0.806250,0.025000,0.025000},
-{0.643750,0.806250,0.050000,0.050000},
-{0.656250,0.806250,0.025000,0.025000},
-{0.656250,0.806250,0.050000,0.050000},
-{0.668750,0.806250,0.025000,0.025000},
-{0.668750,0.806250,0.050000,0.050000},
-{0.681250,0.806250,0.025000,0.025000},
-{0.681250,0.806250,0.050000,0.050000},
-{0.693750,0.806250,0.025000,0.025000},
-{0.693750,0.806250,0.050000,0.050000},
-{0.706250,0.806250,0.025000,0.025000},
-{0.706250,0.806250,0.050000,0.050000},
-{0.718750,0.806250,0.025000,0.025000},
-{0.718750,0.806250,0.050000,0.050000},
-{0.731250,0.806250,0.025000,0.025000},
-{0.731250,0.806250,0.050000,0.050000},
-{0.743750,0.806250,0.025000,0.025000},
-{0.743750,0.806250,0.050000,0.050000},
-{0.756250,0.806250,0.025000,0.025000},
-{0.756250,0.806250,0.050000,0.050000},
-{0.768750,0.806250,0.025000,0.025000},
-{0.768750,0.806250,0.050000,0.050000},
-{0.781250,0.806250,0.025000,0.025000},
-{0.781250,0.806250,0.050000,0.050000},
-{0.793750,0.806250,0.025000,0.025000},
-{0.793750,0.806250,0.050000,0.050000},
-{0.806250,0.806250,0.025000,0.025000},
-{0.806250,0.806250,0.050000,0.050000},
-{0.818750,0.806250,0.025000,0.025000},
-{0.818750,0.806250,0.050000,0.050000},
-{0.831250,0.806250,0.025000,0.025000},
-{0.831250,0.806250,0.050000,0.050000},
-{0.843750,0.806250,0.025000,0.025000},
-{0.843750,0.806250,0.050000,0.050000},
-{0.856250,0.806250,0.025000,0.025000},
-{0.856250,0.806250,0.050000,0.050000},
-{0.868750,0.806250,0.025000,0.025000},
-{0.868750,0.806250,0.050000,0.050000},
-{0.881250,0.806250,0.025000,0.025000},
-{0.881250,0.806250,0.050000,0.050000},
-{0.893750,0.806250,0.025000,0.025000},
-{0.893750,0.806250,0.050000,0.050000},
-{0.906250,0.806250,0.025000,0.025000},
-{0.906250,0.806250,0.050000,0.050000},
-{0.918750,0.806250,0.025000,0.025000},
-{0.918750,0.806250,0.050000,0.050000},
-{0.931250,0.806250,0.025000,0.025000},
-{0.931250,0.806250,0.050000,0.050000},
-{0.943750,0.806250,0.025000,0.025000},
-{0.943750,0.806250,0.050000,0.050000},
-{0.956250,0.806250,0.025000,0.025000},
-{0.956250,0.806250,0.050000,0.050000},
-{0.968750,0.806250,0.025000,0.025000},
-{0.968750,0.806250,0.050000,0.050000},
-{0.981250,0.806250,0.025000,0.025000},
-{0.981250,0.806250,0.050000,0.050000},
-{0.993750,0.806250,0.025000,0.025000},
-{0.993750,0.806250,0.050000,0.050000},
-{0.006250,0.818750,0.025000,0.025000},
-{0.006250,0.818750,0.050000,0.050000},
-{0.018750,0.818750,0.025000,0.025000},
-{0.018750,0.818750,0.050000,0.050000},
-{0.031250,0.818750,0.025000,0.025000},
-{0.031250,0.818750,0.050000,0.050000},
-{0.043750,0.818750,0.025000,0.025000},
-{0.043750,0.818750,0.050000,0.050000},
-{0.056250,0.818750,0.025000,0.025000},
-{0.056250,0.818750,0.050000,0.050000},
-{0.068750,0.818750,0.025000,0.025000},
-{0.068750,0.818750,0.050000,0.050000},
-{0.081250,0.818750,0.025000,0.025000},
-{0.081250,0.818750,0.050000,0.050000},
-{0.093750,0.818750,0.025000,0.025000},
-{0.093750,0.818750,0.050000,0.050000},
-{0.106250,0.818750,0.025000,0.025000},
-{0.106250,0.818750,0.050000,0.050000},
-{0.118750,0.818750,0.025000,0.025000},
-{0.118750,0.818750,0.050000,0.050000},
-{0.131250,0.818750,0.025000,0.025000},
-{0.131250,0.818750,0.050000,0.050000},
-{0.143750,0.818750,0.025000,0.025000},
-{0.143750,0.818750,0.050000,0.050000},
-{0.156250,0.818750,0.025000,0.025000},
-{0.156250,0.818750,0.050000,0.050000},
-{0.168750,0.818750,0.025000,0.025000},
-{0.168750,0.818750,0.050000,0.050000},
-{0.181250,0.818750,0.025000,0.025000},
-{0.181250,0.818750,0.050000,0.050000},
-{0.193750,0.818750,0.025000,0.025000},
-{0.193750,0.818750,0.050000,0.050000},
-{0.206250,0.818750,0.025000,0.025000},
-{0.206250,0.818750,0.050000,0.050000},
-{0.218750,0.818750,0.025000,0.025000},
-{0.218750,0.818750,0.050000,0.050000},
-{0.231250,0.818750,0.025000,0.025000},
-{0.231250,0.818750,0.050000,0.050000},
-{0.243750,0.818750,0.025000,0.025000},
-{0.243750,0.818750,0.050000,0.050000},
-{0.256250,0.818750,0.025000,0.025000},
-{0.256250,0.818750,0.050000,0.050000},
-{0.268750,0.818750,0.025000,0.025000},
-{0.268750,0.818750,0.050000,0.050000},
-{0.281250,0.818750,0.025000,0.025000},
-{0.281250,0.818750,0.050000,0.050000},
-{0.293750,0.818750,0.025000,0.025000},
-{0.293750,0.818750,0.050000,0.050000},
-{0.306250,0.818750,0.025000,0.025000},
-{0.306250,0.818750,0.050000,0.050000},
-{0.318750,0.818750,0.025000,0.025000},
-{0.318750,0.818750,0.050000,0.050000},
-{0.331250,0.818750,0.025000,0.025000},
-{0.331250,0.818750,0.050000,0.050000},
-{0.343750,0.818750,0.025000,0.025000},
-{0.343750,0.818750,0.050000,0.050000},
-{0.356250,0.818750,0.025000,0.025000},
-{0.356250,0.818750,0.050000,0.050000},
-{0.368750,0.818750,0.025000,0.025000},
-{0.368750,0.818750,0.050000,0.050000},
-{0.381250,0.818750,0.025000,0.025000},
-{0.381250,0.818750,0.050000,0.050000},
-{0.393750,0.818750,0.025000,0.025000},
-{0.393750,0.818750,0.050000,0.050000},
-{0.406250,0.818750,0.025000,0.025000},
-{0.406250,0.818750,0.050000,0.050000},
-{0.418750,0.818750,0.025000,0.025000},
-{0.418750,0.818750,0.050000,0.050000},
-{0.431250,0.818750,0.025000,0.025000},
-{0.431250,0.818750,0.050000,0.050000},
-{0.443750,0.818750,0.025000,0.025000},
-{0.443750,0.818750,0.050000,0.050000},
-{0.456250,0.818750,0.025000,0.025000},
-{0.456250,0.818750,0.050000,0.050000},
-{0.468750,0.818750,0.025000,0.025000},
-{0.468750,0.818750,0.050000,0.050000},
-{0.481250,0.818750,0.025000,0.025000},
-{0.481250,0.818750,0.050000,0.050000},
-{0.493750,0.818750,0.025000,0.025000},
-{0.493750,0.818750,0.050000,0.050000},
-{0.506250,0.818750,0.025000,0.025000},
-{0.506250,0.818750,0.050000,0.050000},
-{0.518750,0.818750,0.025000,0.025000},
-{0.518750,0.818750,0.050000,0.050000},
-{0.531250,0.818750,0.025000,0.025000},
-{0.531250,0.818750,0.050000,0.050000},
-{0.543750,0.818750,0.025000,0.025000},
-{0.543750,0.818750,0.050000,0.050000},
-{0.556250,0.818750,0.025000,0.025000},
-{0.556250,0.818750,0.050000,0.050000},
-{0.568750,0.818750,0.025000,0.025000},
-{0.568750,0.818750,0.050000,0.050000},
-{0.581250,0.818750,0.025000,0.025000},
-{0.581250,0.818750,0.050000,0.050000},
-{0.593750,0.818750,0.025000,0.025000},
-{0.593750,0.818750,0.050000,0.050000},
-{0.606250,0.818750,0.025000,0.025000},
-{0.606250,0.818750,0.050000,0.050000},
-{0.618750,0.818750,0.025000,0.025000},
-{0.618750,0.818750,0.050000,0.050000},
-{0.631250,0.818750,0.025000,0.025000},
-{0.631250,0.818750,0.050000,0.050000},
-{0.643750,0.818750,0.025000,0.025000},
-{0.643750,0.818750,0.050000,0.050000},
-{0.656250,0.818750,0.025000,0.025000},
-{0.656250,0.818750,0.050000,0.050000},
-{0.668750,0.818750,0.025000,0.025000},
-{0.668750,0.818750,0.050000,0.050000},
-{0.681250,0.818750,0.025000,0.025000},
-{0.681250,0.818750,0.050000,0.050000},
-{0.693750,0.818750,0.025000,0.025000},
-{0.693750,0.818750,0.050000,0.050000},
-{0.706250,0.818750,0.025000,0.025000},
-{0.706250,0.818750,0.050000,0.050000},
-{0.718750,0.818750,0.025000,0.025000},
-{0.718750,0.818750,0.050000,0.050000},
-{0.731250,0.818750,0.025000,0.025000},
-{0.731250,0.818750,0.050000,0.050000},
-{0.743750,0.818750,0.025000,0.025000},
-{0.743750,0.818750,0.050000,0.050000},
-{0.756250,0.818750,0.025000,0.025000},
-{0.756250,0.818750,0.050000,0.050000},
-{0.768750,0.818750,0.025000,0.025000},
-{0.768750,0.818750,0.050000,0.050000},
-{0.781250,0.818750,0.025000,0.025000},
-{0.781250,0.818750,0.050000,0.050000},
-{0.793750,0.818750,0.025000,0.025000},
-{0.793750,0.818750,0.050000,0.050000},
-{0.806250,0.818750,0.025000,0.025000},
-{0.806250,0.818750,0.050000,0.050000},
-{0.818750,0.818750,0.025000,0.025000},
-{0.818750,0.818750,0.050000,0.050000},
-{0.831250,0.818750,0.025000,0.025000},
-{0.831250,0.818750,0.050000,0.050000},
-{0.843750,0.818750,0.025000,0.025000},
-{0.843750,0.818750,0.050000,0.050000},
-{0.856250,0.818750,0.025000,0.025000},
-{0.856250,0.818750,0.050000,0.050000},
-{0.868750,0.818750,0.025000,0.025000},
-{0.868750,0.818750,0.050000,0.050000},
-{0.881250,0.818750,0.025000,0.025000},
-{0.881250,0.818750,0.050000,0.050000},
-{0.893750,0.818750,0.025000,0.025000},
-{0.893750,0.818750,0.050000,0.050000},
-{0.906250,0.818750,0.025000,0.025000},
-{0.906250,0.818750,0.050000,0.050000},
-{0.918750,0.818750,0.025000,0.025000},
-{0.918750,0.818750,0.050000,0.050000},
-{0.931250,0.818750,0.025000,0.025000},
-{0.931250,0.818750,0.050000,0.050000},
-{0.943750,0.818750,0.025000,0.025000},
-{0.943750,0.818750,0.050000,0.050000},
-{0.956250,0.818750,0.025000,0.025000},
-{0.956250,0.818750,0.050000,0.050000},
-{0.968750,0.818750,0.025000,0.025000},
-{0.968750,0.818750,0.050000,0.050000},
-{0.981250,0.818750,0.025000,0.025000},
-{0.981250,0.818750,0.050000,0.050000},
-{0.993750,0.818750,0.025000,0.025000},
-{0.993750,0.818750,0.050000,0.050000},
-{0.006250,0.831250,0.025000,0.025000},
-{0.006250,0.831250,0.050000,0.050000},
-{0.018750,0.831250,0.025000,0.025000},
-{0.018750,0.831250,0.050000,0.050000},
-{0.031250,0.831250,0.025000,0.025000},
-{0.031250,0.831250,0.050000,0.050000},
-{0.043750,0.831250,0.025000,0.025000},
-{0.043750,0.831250,0.050000,0.050000},
-{0.056250,0.831250,0.025000,0.025000},
-{0.056250,0.831250,0.050000,0.050000},
-{0.068750,0.831250,0.025000,0.025000},
-{0.068750,0.831250,0.050000,0.050000},
-{0.081250,0.831250,0.025000,0.025000},
-{0.081250,0.831250,0.050000,0.050000},
-{0.093750,0.831250,0.025000,0.025000},
-{0.093750,0.831250,0.050000,0.050000},
-{0.106250,0.831250,0.025000,0.025000},
-{0.106250,0.831250,0.050000,0.050000},
-{0.118750,0.831250,0.025000,0.025000},
-{0.118750,0.831250,0.050000,0.050000},
-{0.131250,0.831250,0.025000,0.025000},
-{0.131250,0.831250,0.050000,0.050000},
-{0.143750,0.831250,0.025000,0.025000},
-{0.143750,0.831250,0.050000,0.050000},
-{0.156250,0.831250,0.025000,0.025000},
-{0.156250,0.831250,0.050000,0.050000},
-{0.168750,0.831250,0.025000,0.025000},
-{0.168750,0.831250,0.050000,0.050000},
-{0.181250,0.831250,0.025000,0.025000},
-{0.181250,0.831250,0.050000,0.050000},
-{0.193750,0.831250,0.025000,0.025000},
-{0.193750,0.831250,0.050000,0.050000},
-{0.206250,0.831250,0.025000,0.025000},
-{0.206250,0.831250,0.050000,0.050000},
-{0.218750,0.831250,0.025000,0.025000},
-{0.218750,0.831250,0.050000,0.050000},
-{0.231250,0.831250,0.025000,0.025000},
-{0.231250,0.831250,0.050000,0.050000},
-{0.243750,0.831250,0.025000,0.025000},
-{0.243750,0.831250,0.050000,0.050000},
-{0.256250,0.831250,0.025000,0.025000},
-{0.256250,0.831250,0.050000,0.050000},
-{0.268750,0.831250,0.025000,0.025000},
-{0.268750,0.831250,0.050000,0.050000},
-{0.281250,0.831250,0.025000,0.025000},
-{0.281250,0.831250,0.050000,0.050000},
-{0.293750,0.831250,0.025000,0.025000},
-{0.293750,0.831250,0.050000,0.050000},
-{0.306250,0.831250,0.025000,0.025000},
-{0.306250,0.831250,0.050000,0.050000},
-{0.318750,0.831250,0.025000,0.025000},
-{0.318750,0.831250,0.050000,0.050000},
-{0.331250,0.831250,0.025000,0.025000},
-{0.331250,0.831250,0.050000,0.050000},
-{0.343750,0.831250,0.025000,0.025000},
-{0.343750,0.831250,0.050000,0.050000},
-{0.356250,0.831250,0.025000,0.025000},
-{0.356250,0.831250,0.050000,0.050000},
-{0.368750,0.831250,0.025000,0.025000},
-{0.368750,0.831250,0.050000,0.050000},
-{0.381250,0.831250,0.025000,0.025000},
-{0.381250,0.831250,0.050000,0.050000},
-{0.393750,0.831250,0.025000,0.025000},
-{0.393750,0.831250,0.050000,0.050000},
-{0.406250,0.831250,0.025000,0.025000},
-{0.406250,0.831250,0.050000,0.050000},
-{0.418750,0.831250,0.025000,0.025000},
-{0.418750,0.831250,0.050000,0.050000},
-{0.431250,0.831250,0.025000,0.025000},
-{0.431250,0.831250,0.050000,0.050000},
-{0.443750,0.831250,0.025000,0.025000},
-{0.443750,0.831250,0.050000,0.050000},
-{0.456250,0.831250,0.025000,0.025000},
-{0.456250,0.831250,0.050000,0.050000},
-{0.468750,0.831250,0.025000,0.025000},
-{0.468750,0.831250,0.050000,0.050000},
-{0.481250,0.831250,0.025000,0.025000},
-{0.481250,0.831250,0.050000,0.050000},
-{0.493750,0.831250,0.025000,0.025000},
-{0.493750,0.831250,0.050000,0.050000},
-{0.506250,0.831250,0.025000,0.025000},
-{0.506250,0.831250,0.050000,0.050000},
-{0.518750,0.831250,0.025000,0.025000},
-{0.518750,0.831250,0.050000,0.050000},
-{0.531250,0.831250,0.025000,0.025000},
-{0.531250,0.831250,0.050000,0.050000},
-{0.543750,0.831250,0.025000,0.025000},
-{0.543750,0.831250,0.050000,0.050000},
-{0.556250,0.831250,0.025000,0.025000},
-{0.556250,0.831250,0.050000,0.050000},
-{0.568750,0.831250,0.025000,0.025000},
-{0.568750,0.831250,0.050000,0.050000},
-{0.581250,0.831250,0.025000,0.025000},
-{0.581250,0.831250,0.050000,0.050000},
-{0.593750,0.831250,0.025000,0.025000},
-{0.593750,0.831250,0.050000,0.050000},
-{0.606250,0.831250,0.025000,0.025000},
-{0.606250,0.831250,0.050000,0.050000},
-{0.618750,0.831250,0.025000,0.025000},
-{0.618750,0.831250,0.050000,0.050000},
-{0.631250,0.831250,0.025000,0.025000},
-{0.631250,0.831250,0.050000,0.050000},
-{0.643750,0.831250,0.025000,0.025000},
-{0.643750,0.831250,0.050000,0.050000},
-{0.656250,0.831250,0.025000,0.025000},
-{0.656250,0.831250,0.050000,0.050000},
-{0.668750,0.831250,0.025000,0.025000},
-{0.668750,0.831250,0.050000,0.050000},
-{0.681250,0.831250,0.025000,0.025000},
-{0.681250,0.831250,0.050000,0.050000},
-{0.693750,0.831250,0.025000,0.025000},
-{0.693750,0.831250,0.050000,0.050000},
-{0.706250,0.831250,0.025000,0.025000},
-{0.706250,0.831250,0.050000,0.050000},
-{0.718750,0.831250,0.025000,0.025000},
-{0.718750,0.831250,0.050000,0.050000},
-{0.731250,0.831250,0.025000,0.025000},
-{0.731250,0.831250,0.050000,0.050000},
-{0.743750,0.831250,0.025000,0.025000},
-{0.743750,0.831250,0.050000,0.050000},
-{0.756250,0.831250,0.025000,0.025000},
-{0.756250,0.831250,0.050000,0.050000},
-{0.768750,0.831250,0.025000,0.025000},
-{0.768750,0.831250,0.050000,0.050000},
-{0.781250,0.831250,0.025000,0.025000},
-{0.781250,0.831250,0.050000,0.050000},
-{0.793750,0.831250,0.025000,0.025000},
-{0.793750,0.831250,0.050000,0.050000},
-{0.806250,0.831250,0.025000,0.025000},
-{0.806250,0.831250,0.050000,0.050000},
-{0.818750,0.831250,0.025000,0.025000},
-{0.818750,0.831250,0.050000,0.050000},
-{0.831250,0.831250,0.025000,0.025000},
-{0.831250,0.831250,0.050000,0.050000},
-{0.843750,0.831250,0.025000,0.025000},
-{0.843750,0.831250,0.050000,0.050000},
-{0.856250,0.831250,0.025000,0.025000},
-{0.856250,0.831250,0.050000,0.050000},
-{0.868750,0.831250,0.025000,0.025000},
-{0.868750,0.831250,0.050000,0.050000},
-{0.881250,0.831250,0.025000,0.025000},
-{0.881250,0.831250,0.050000,0.050000},
-{0.893750,0.831250,0.025000,0.025000},
-{0.893750,0.831250,0.050000,0.050000},
-{0.906250,0.831250,0.025000,0.025000},
-{0.906250,0.831250,0.050000,0.050000},
-{0.918750,0.831250,0.025000,0.025000},
-{0.918750,0.831250,0.050000,0.050000},
-{0.931250,0.831250,0.025000,0.025000},
-{0.931250,0.831250,0.050000,0.050000},
-{0.943750,0.831250,0.025000,0.025000},
-{0.943750,0.831250,0.050000,0.050000},
-{0.956250,0.831250,0.025000,0.025000},
-{0.956250,0.831250,0.050000,0.050000},
-{0.968750,0.831250,0.025000,0.025000},
-{0.968750,0.831250,0.050000,0.050000},
-{0.981250,0.831250,0.025000,0.025000},
-{0.981250,0.831250,0.050000,0.050000},
-{0.993750,0.831250,0.025000,0.025000},
-{0.993750,0.831250,0.050000,0.050000},
-{0.006250,0.843750,0.025000,0.025000},
-{0.006250,0.843750,0.050000,0.050000},
-{0.018750,0.843750,0.025000,0.025000},
-{0.018750,0.843750,0.050000,0.050000},
-{0.031250,0.843750,0.025000,0.025000},
-{0.031250,0.843750,0.050000,0.050000},
-{0.043750,0.843750,0.025000,0.025000},
-{0.043750,0.843750,0.050000,0.050000},
-{0.056250,0.843750,0.025000,0.025000},
-{0.056250,0.843750,0.050000,0.050000},
-{0.068750,0.843750,0.025000,0.025000},
-{0.068750,0.843750,0.050000,0.050000},
-{0.081250,0.843750,0.025000,0.025000},
-{0.081250,0.843750,0.050000,0.050000},
-{0.093750,0.843750,0.025000,0.025000},
-{0.093750,0.843750,0.050000,0.050000},
-{0.106250,0.843750,0.025000,0.025000},
-{0.106250,0.843750,0.050000,0.050000},
-{0.118750,0.843750,0.025000,0.025000},
-{0.118750,0.843750,0.050000,0.050000},
-{0.131250,0.843750,0.025000,0.025000},
-{0.131250,0.843750,0.050000,0.050000},
-{0.143750,0.843750,0.025000,0.025000},
-{0.143750,0.843750,0.050000,0.050000},
-{0.156250,0.843750,0.025000,0.025000},
-{0.156250,0.843750,0.050000,0.050000},
-{0.168750,0.843750,0.025000,0.025000},
-{0.168750,0.843750,0.050000,0.050000},
-{0.181250,0.843750,0.025000,0.025000},
-{0.181250,0.843750,0.050000,0.050000},
-{0.193750,0.843750,0.025000,0.025000},
-{0.193750,0.843750,0.050000,0.050000},
-{0.206250,0.843750,0.025000,0.025000},
-{0.206250,0.843750,0.050000,0.050000},
-{0.218750,0.843750,0.025000,0.025000},
-{0.218750,0.843750,0.050000,0.050000},
-{0.231250,0.843750,0.025000,0.025000},
-{0.231250,0.843750,0.050000,0.050000},
-{0.243750,0.843750,0.025000,0.025000},
-{0.243750,0.843750,0.050000,0.050000},
-{0.256250,0.843750,0.025000,0.025000},
-{0.256250,0.843750,0.050000,0.050000},
-{0.268750,0.843750,0.025000,0.025000},
-{0.268750,0.843750,0.050000,0.050000},
-{0.281250,0.843750,0.025000,0.025000},
-{0.281250,0.843750,0.050000,0.050000},
-{0.293750,0.843750,0.025000,0.025000},
-{0.293750,0.843750,0.050000,0.050000},
-{0.306250,0.843750,0.025000,0.025000},
-{0.306250,0.843750,0.050000,0.050000},
-{0.318750,0.843750,0.025000,0.025000},
-{0.318750,0.843750,0.050000,0.050000},
-{0.331250,0.843750,0.025000,0.025000},
-{0.331250,0.843750,0.050000,0.050000},
-{0.343750,0.843750,0.025000,0.025000},
-{0.343750,0.843750,0.050000,0.050000},
-{0.356250,0.843750,0.025000,0.025000},
-{0.356250,0.843750,0.050000,0.050000},
-{0.368750,0.843750,0.025000,0.025000},
-{0.368750,0.843750,0.050000,0.050000},
-{0.381250,0.843750,0.025000,0.025000},
-{0.381250,0.843750,0.050000,0.050000},
-{0.393750,0.843750,0.025000,0.025000},
-{0.393750,0.843750,0.050000,0.050000},
-{0.406250,0.843750,0.025000,0.025000},
-{0.406250,0.843750,0.050000,0.050000},
-{0.418750,0.843750,0.025000,0.025000},
-{0.418750,0.843750,0.050000,0.050000},
-{0.431250,0.843750,0.025000,0.025000},
-{0.431250,0.843750,0.050000,0.050000},
-{0.443750,0.843750,0.025000,0.025000},
-{0.443750,0.843750,0.050000,0.050000},
-{0.456250,0.843750,0.025000,0.025000},
-{0.456250,0.843750,0.050000,0.050000},
-{0.468750,0.843750,0.025000,0.025000},
-{0.468750,0.843750,0.050000,0.050000},
-{0.481250,0.843750,0.025000,0.025000},
-{0.481250,0.843750,0.050000,0.050000},
-{0.493750,0.843750,0.025000,0.025000},
-{0.493750,0.843750,0.050000,0.050000},
-{0.506250,0.843750,0.025000,0.025000},
-{0.506250,0.843750,0.050000,0.050000},
-{0.518750,0.843750,0.025000,0.025000},
-{0.518750,0.843750,0.050000,0.050000},
-{0.531250,0.843750,0.025000,0.025000},
-{0.531250,0.843750,0.050000,0.050000},
-{0.543750,0.843750,0.025000,0.025000},
-{0.543750,0.843750,0.050000,0.050000},
-{0.556250,0.843750,0.025000,0.025000},
-{0.556250,0.843750,0.050000,0.050000},
-{0.568750,0.843750,0.025000,0.025000},
-{0.568750,0.843750,0.050000,0.050000},
-{0.581250,0.843750,0.025000,0.025000},
-{0.581250,0.843750,0.050000,0.050000},
-{0.593750,0.843750,0.025000,0.025000},
-{0.593750,0.843750,0.050000,0.050000},
-{0.606250,0.843750,0.025000,0.025000},
-{0.606250,0.843750,0.050000,0.050000},
-{0.618750,0.843750,0.025000,0.025000},
-{0.618750,0.843750,0.050000,0.050000},
-{0.631250,0.843750,0.025000,0.025000},
-{0.631250,0.843750,0.050000,0.050000},
-{0.643750,0.843750,0.025000,0.025000},
-{0.643750,0.843750,0.050000,0.050000},
-{0.656250,0.843750,0.025000,0.025000},
-{0.656250,0.843750,0.050000,0.050000},
-{0.668750,0.843750,0.025000,0.025000},
-{0.668750,0.843750,0.050000,0.050000},
-{0.681250,0.843750,0.025000,0.025000},
-{0.681250,0.843750,0.050000,0.050000},
-{0.693750,0.843750,0.025000,0.025000},
-{0.693750,0.843750,0.050000,0.050000},
-{0.706250,0.843750,0.025000,0.025000},
-{0.706250,0.843750,0.050000,0.050000},
-{0.718750,0.843750,0.025000,0.025000},
-{0.718750,0.843750,0.050000,0.050000},
-{0.731250,0.843750,0.025000,0.025000},
-{0.731250,0.843750,0.050000,0.050000},
-{0.743750,0.843750,0.025000,0.025000},
-{0.743750,0.843750,0.050000,0.050000},
-{0.756250,0.843750,0.025000,0.025000},
-{0.756250,0.843750,0.050000,0.050000},
-{0.768750,0.843750,0.025000,0.025000},
-{0.768750,0.843750,0.050000,0.050000},
-{0.781250,0.843750,0.025000,0.025000},
-{0.781250,0.843750,0.050000,0.050000},
-{0.793750,0.843750,0.025000,0.025000},
-{0.793750,0.843750,0.050000,0.050000},
-{0.806250,0.843750,0.025000,0.025000},
-{0.806250,0.843750,0.050000,0.050000},
-{0.818750,0.843750,0.025000,0.025000},
-{0.818750,0.843750,0.050000,0.050000},
-{0.831250,0.843750,0.025000,0.025000},
-{0.831250,0.843750,0.050000,0.050000},
-{0.843750,0.843750,0.025000,0.025000},
-{0.843750,0.843750,0.050000,0.050000},
-{0.856250,0.843750,0.025000,0.025000},
-{0.856250,0.843750,0.050000,0.050000},
-{0.868750,0.843750,0.025000,0.025000},
-{0.868750,0.843750,0.050000,0.050000},
-{0.881250,0.843750,0.025000,0.025000},
-{0.881250,0.843750,0.050000,0.050000},
-{0.893750,0.843750,0.025000,0.025000},
-{0.893750,0.843750,0.050000,0.050000},
-{0.906250,0.843750,0.025000,0.025000},
-{0.906250,0.843750,0.050000,0.050000},
-{0.918750,0.843750,0.025000,0.025000},
-{0.918750,0.843750,0.050000,0.050000},
-{0.931250,0.843750,0.025000,0.025000},
-{0.931250,0.843750,0.050000,0.050000},
-{0.943750,0.843750,0.025000,0.025000},
-{0.943750,0.843750,0.050000,0.050000},
-{0.956250,0.843750,0.025000,0.025000},
-{0.956250,0.843750,0.050000,0.050000},
-{0.968750,0.843750,0.025000,0.025000},
-{0.968750,0.843750,0.050000,0.050000},
-{0.981250,0.843750,0.025000,0.025000},
-{0.981250,0.843750,0.050000,0.050000},
-{0.993750,0.843750,0.025000,0.025000},
-{0.993750,0.843750,0.050000,0.050000},
-{0.006250,0.856250,0.025000,0.025000},
-{0.006250,0.856250,0.050000,0.050000},
-{0.018750,0.856250,0.025000,0.025000},
-{0.018750,0.856250,0.050000,0.050000},
-{0.031250,0.856250,0.025000,0.025000},
-{0.031250,0.856250,0.050000,0.050000},
-{0.043750,0.856250,0.025000,0.025000},
-{0.043750,0.856250,0.050000,0.050000},
-{0.056250,0.856250,0.025000,0.025000},
-{0.056250,0.856250,0.050000,0.050000},
-{0.068750,0.856250,0.025000,0.025000},
-{0.068750,0.856250,0.050000,0.050000},
-{0.081250,0.856250,0.025000,0.025000},
-{0.081250,0.856250,0.050000,0.050000},
-{0.093750,0.856250,0.025000,0.025000},
-{0.093750,0.856250,0.050000,0.050000},
-{0.106250,0.856250,0.025000,0.025000},
-{0.106250,0.856250,0.050000,0.050000},
-{0.118750,0.856250,0.025000,0.025000},
-{0.118750,0.856250,0.050000,0.050000},
-{0.131250,0.856250,0.025000,0.025000},
-{0.131250,0.856250,0.050000,0.050000},
-{0.143750,0.856250,0.025000,0.025000},
-{0.143750,0.856250,0.050000,0.050000},
-{0.156250,0.856250,0.025000,0.025000},
-{0.156250,0.856250,0.050000,0.050000},
-{0.168750,0.856250,0.025000,0.025000},
-{0.168750,0.856250,0.050000,0.050000},
-{0.181250,0.856250,0.025000,0.025000},
-{0.181250,0.856250,0.050000,0.050000},
-{0.193750,0.856250,0.025000,0.025000},
-{0.193750,0.856250,0.050000,0.050000},
-{0.206250,0.856250,0.025000,0.025000},
-{0.206250,0.856250,0.050000,0.050000},
-{0.218750,0.856250,0.025000,0.025000},
-{0.218750,0.856250,0.050000,0.050000},
-{0.231250,0.856250,0.025000,0.025000},
-{0.231250,0.856250,0.050000,0.050000},
-{0.243750,0.856250,0.025000,0.025000},
-{0.243750,0.856250,0.050000,0.050000},
-{0.256250,0.856250,0.025000,0.025000},
-{0.256250,0.856250,0.050000,0.050000},
-{0.268750,0.856250,0.025000,0.025000},
-{0.268750,0.856250,0.050000,0.050000},
-{0.281250,0.856250,0.025000,0.025000},
-{0.281250,0.856250,0.050000,0.050000},
-{0.293750,0.856250,0.025000,0.025000},
-{0.293750,0.856250,0.050000,0.050000},
-{0.306250,0.856250,0.025000,0.025000},
-{0.306250,0.856250,0.050000,0.050000},
-{0.318750,0.856250,0.025000,0.025000},
-{0.318750,0.856250,0.050000,0.050000},
-{0.331250,0.856250,0.025000,0.025000},
-{0.331250,0.856250,0.050000,0.050000},
-{0.343750,0.856250,0.025000,0.025000},
-{0.343750,0.856250,0.050000,0.050000},
-{0.356250,0.856250,0.025000,0.025000},
-{0.356250,0.856250,0.050000,0.050000},
-{0.368750,0.856250,0.025000,0.025000},
-{0.368750,0.856250,0.050000,0.050000},
-{0.381250,0.856250,0.025000,0.025000},
-{0.381250,0.856250,0.050000,0.050000},
-{0.393750,0.856250,0.025000,0.025000},
-{0.393750,0.856250,0.050000,0.050000},
-{0.406250,0.856250,0.025000,0.025000},
-{0.406250,0.856250,0.050000,0.050000},
-{0.418750,0.856250,0.025000,0.025000},
-{0.418750,0.856250,0.050000,0.050000},
-{0.431250,0.856250,0.025000,0.025000},
-{0.431250,0.856250,0.050000,0.050000},
-{0.443750,0.856250,0.025000,0.025000},
-{0.443750,0.856250,0.050000,0.050000},
-{0.456250,0.856250,0.025000,0.025000},
-{0.456250,0.856250,0.050000,0.050000},
-{0.468750,0.856250,0.025000,0.025000},
-{0.468750,0.856250,0.050000,0.050000},
-{0.481250,0.856250,0.025000,0.025000},
-{0.481250,0.856250,0.050000,0.050000},
-{0.493750,0.856250,0.025000,0.025000},
-{0.493750,0.856250,0.050000,0.050000},
-{0.506250,0.856250,0.025000,0.025000},
-{0.506250,0.856250,0.050000,0.050000},
-{0.518750,0.856250,0.025000,0.025000},
-{0.518750,0.856250,0.050000,0.050000},
-{0.531250,0.856250,0.025000,0.025000},
-{0.531250,0.856250,0.050000,0.050000},
-{0.543750,0.856250,0.025000,0.025000},
-{0.543750,0.856250,0.050000,0.050000},
-{0.556250,0.856250,0.025000,0.025000},
-{0.556250,0.856250,0.050000,0.050000},
-{0.568750,0.856250,0.025000,0.025000},
-{0.568750,0.856250,0.050000,0.050000},
-{0.581250,0.856250,0.025000,0.025000},
-{0.581250,0.856250,0.050000,0.050000},
-{0.593750,0.856250,0.025000,0.025000},
-{0.593750,0.856250,0.050000,0.050000},
-{0.606250,0.856250,0.025000,0.025000},
-{0.606250,0.856250,0.050000,0.050000},
-{0.618750,0.856250,0.025000,0.025000},
-{0.618750,0.856250,0.050000,0.050000},
-{0.631250,0.856250,0.025000,0.025000},
-{0.631250,0.856250,0.050000,0.050000},
-{0.643750,0.856250,0.025000,0.025000},
-{0.643750,0.856250,0.050000,0.050000},
-{0.656250,0.856250,0.025000,0.025000},
-{0.656250,0.856250,0.050000,0.050000},
-{0.668750,0.856250,0.025000,0.025000},
-{0.668750,0.856250,0.050000,0.050000},
-{0.681250,0.856250,0.025000,0.025000},
-{0.681250,0.856250,0.050000,0.050000},
-{0.693750,0.856250,0.025000,0.025000},
-{0.693750,0.856250,0.050000,0.050000},
-{0.706250,0.856250,0.025000,0.025000},
-{0.706250,0.856250,0.050000,0.050000},
-{0.718750,0.856250,0.025000,0.025000},
-{0.718750,0.856250,0.050000,0.050000},
-{0.731250,0.856250,0.025000,0.025000},
-{0.731250,0.856250,0.050000,0.050000},
-{0.743750,0.856250,0.025000,0.025000},
-{0.743750,0.856250,0.050000,0.050000},
-{0.756250,0.856250,0.025000,0.025000},
-{0.756250,0.856250,0.050000,0.050000},
-{0.768750,0.856250,0.025000,0.025000},
-{0.768750,0.856250,0.050000,0.050000},
-{0.781250,0.856250,0.025000,0.025000},
-{0.781250,0.856250,0.050000,0.050000},
-{0.793750,0.856250,0.025000,0.025000},
-{0.793750,0.856250,0.050000,0.050000},
-{0.806250,0.856250,0.025000,0.025000},
-{0.806250,0.856250,0.050000,0.050000},
-{0.818750,0.856250,0.025000,0.025000},
-{0.818750,0.856250,0.050000,0.050000},
-{0.831250,0.856250,0.025000,0.025000},
-{0.831250,0.856250,0.050000,0.050000},
-{0.843750,0.856250,0.025000,0.025000},
-{0.843750,0.856250,0.050000,0.050000},
-{0.856250,0.856250,0.025000,0.025000},
-{0.856250,0.856250,0.050000,0.050000},
-{0.868750,0.856250,0.025000,0.025000},
-{0.868750,0.856250,0.050000,0.050000},
-{0.881250,0.856250,0.025000,0.025000},
-{0.881250,0.856250,0.050000,0.050000},
-{0.893750,0.856250,0.025000,0.025000},
-{0.893750,0.856250,0.050000,0.050000},
-{0.906250,0.856250,0.025000,0.025000},
-{0.906250,0.856250,0.050000,0.050000},
-{0.918750,0.856250,0.025000,0.025000},
-{0.918750,0.856250,0.050000,0.050000},
-{0.931250,0.856250,0.025000,0.025000},
-{0.931250,0.856250,0.050000,0.050000},
-{0.943750,0.856250,0.025000,0.025000},
-{0.943750,0.856250,0.050000,0.050000},
-{0.956250,0.856250,0.025000,0.025000},
-{0.956250,0.856250,0.050000,0.050000},
-{0.968750,0.856250,0.025000,0.025000},
-{0.968750,0.856250,0.050000,0.050000},
-{0.981250,0.856250,0.025000,0.025000},
-{0.981250,0.856250,0.050000,0.050000},
-{0.993750,0.856250,0.025000,0.025000},
-{0.993750,0.856250,0.050000,0.050000},
-{0.006250,0.868750,0.025000,0.025000},
-{0.006250,0.868750,0.050000,0.050000},
-{0.018750,0.868750,0.025000,0.025000},
-{0.018750,0.868750,0.050000,0.050000},
-{0.031250,0.868750,0.025000,0.025000},
-{0.031250,0.868750,0.050000,0.050000},
-{0.043750,0.868750,0.025000,0.025000},
-{0.043750,0.868750,0.050000,0.050000},
-{0.056250,0.868750,0.025000,0.025000},
-{0.056250,0.868750,0.050000,0.050000},
-{0.068750,0.868750,0.025000,0.025000},
-{0.068750,0.868750,0.050000,0.050000},
-{0.081250,0.868750,0.025000,0.025000},
-{0.081250,0.868750,0.050000,0.050000},
-{0.093750,0.868750,0.025000,0.025000},
-{0.093750,0.868750,0.050000,0.050000},
-{0.106250,0.868750,0.025000,0.025000},
-{0.106250,0.868750,0.050000,0.050000},
-{0.118750,0.868750,0.025000,0.025000},
-{0.118750,0.868750,0.050000,0.050000},
-{0.131250,0.868750,0.025000,0.025000},
-{0.131250,0.868750,0.050000,0.050000},
-{0.143750,0.868750,0.025000,0.025000},
-{0.143750,0.868750,0.050000,0.050000},
-{0.156250,0.868750,0.025000,0.025000},
-{0.156250,0.868750,0.050000,0.050000},
-{0.168750,0.868750,0.025000,0.025000},
-{0.168750,0.868750,0.050000,0.050000},
-{0.181250,0.868750,0.025000,0.025000},
-{0.181250,0.868750,0.050000,0.050000},
-{0.193750,0.868750,0.025000,0.025000},
-{0.193750,0.868750,0.050000,0.050000},
-{0.206250,0.868750,0.025000,0.025000},
-{0.206250,0.868750,0.050000,0.050000},
-{0.218750,0.868750,0.025000,0.025000},
-{0.218750,0.868750,0.050000,0.050000},
-{0.231250,0.868750,0.025000,0.025000},
-{0.231250,0.868750,0.050000,0.050000},
-{0.243750,0.868750,0.025000,0.025000},
-{0.243750,0.868750,0.050000,0.050000},
-{0.256250,0.868750,0.025000,0.025000},
-{0.256250,0.868750,0.050000,0.050000},
-{0.268750,0.868750,0.025000,0.025000},
-{0.268750,0.868750,0.050000,0.050000},
-{0.281250,0.868750,0.025000,0.025000},
-{0.281250,0.868750,0.050000,0.050000},
-{0.293750,0.868750,0.025000,0.025000},
-{0.293750,0.868750,0.050000,0.050000},
-{0.306250,0.868750,0.025000,0.025000},
-{0.306250,0.868750,0.050000,0.050000},
-{0.318750,0.868750,0.025000,0.025000},
-{0.318750,0.868750,0.050000,0.050000},
-{0.331250,0.868750,0.025000,0.025000},
-{0.331250,0.868750,0.050000,0.050000},
-{0.343750,0.868750,0.025000,0.025000},
-{0.343750,0.868750,0.050000,0.050000},
-{0.356250,0.868750,0.025000,0.025000},
-{0.356250,0.868750,0.050000,0.050000},
-{0.368750,0.868750,0.025000,0.025000},
-{0.368750,0.868750,0.050000,0.050000},
-{0.381250,0.868750,0.025000,0.025000},
-{0.381250,0.868750,0.050000,0.050000},
-{0.393750,0.868750,0.025000,0.025000},
-{0.393750,0.868750,0.050000,0.050000},
-{0.406250,0.868750,0.025000,0.025000},
-{0.406250,0.868750,0.050000,0.050000},
-{0.418750,0.868750,0.025000,0.025000},
-{0.418750,0.868750,0.050000,0.050000},
-{0.431250,0.868750,0.025000,0.025000},
-{0.431250,0.868750,0.050000,0.050000},
-{0.443750,0.868750,0.025000,0.025000},
-{0.443750,0.868750,0.050000,0.050000},
-{0.456250,0.868750,0.025000,0.025000},
-{0.456250,0.868750,0.050000,0.050000},
-{0.468750,0.868750,0.025000,0.025000},
-{0.468750,0.868750,0.050000,0.050000},
-{0.481250,0.868750,0.025000,0.025000},
-{0.481250,0.868750,0.050000,0.050000},
-{0.493750,0.868750,0.025000,0.025000},
-{0.493750,0.868750,0.050000,0.050000},
-{0.506250,0.868750,0.025000,0.025000},
-{0.506250,0.868750,0.050000,0.050000},
-{0.518750,0.868750,0.025000,0.025000},
-{0.518750,0.868750,0.050000,0.050000},
-{0.531250,0.868750,0.025000,0.025000},
-{0.531250,0.868750,0.050000,0.050000},
-{0.543750,0.868750,0.025000,0.025000},
-{0.543750,0.868750,0.050000,0.050000},
-{0.556250,0.868750,0.025000,0.025000},
-{0.556250,0.868750,0.050000,0.050000},
-{0.568750,0.868750,0.025000,0.025000},
-{0.568750,0.868750,0.050000,0.050000},
-{0.581250,0.868750,0.025000,0.025000},
-{0.581250,0.868750,0.050000,0.050000},
-{0.593750,0.868750,0.025000,0.025000},
-{0.593750,0.868750,0.050000,0.050000},
-{0.606250,0.868750,0.025000,0.025000},
-{0.606250,0.868750,0.050000,0.050000},
-{0.618750,0.868750,0.025000,0.025000},
-{0.618750,0.868750,0.050000,0.050000},
-{0.631250,0.868750,0.025000,0.025000},
-{0.631250,0.868750,0.050000,0.050000},
-{0.643750,0.868750,0.025000,0.025000},
-{0.643750,0.868750,0.050000,0.050000},
-{0.656250,0.868750,0.025000,0.025000},
-{0.656250,0.868750,0.050000,0.050000},
-{0.668750,0.868750,0.025000,0.025000},
-{0.668750,0.868750,0.050000,0.050000},
-{0.681250,0.868750,0.025000,0.025000},
-{0.681250,0.868750,0.050000,0.050000},
-{0.693750,0.868750,0.025000,0.025000},
-{0.693750,0.868750,0.050000,0.050000},
-{0.706250,0.868750,0.025000,0.025000},
-{0.706250,0.868750,0.050000,0.050000},
-{0.718750,0.868750,0.025000,0.025000},
-{0.718750,0.868750,0.050000,0.050000},
-{0.731250,0.868750,0.025000,0.025000},
-{0.731250,0.868750,0.050000,0.050000},
-{0.743750,0.868750,0.025000,0.025000},
-{0.743750,0.868750,0.050000,0.050000},
-{0.756250,0.868750,0.025000,0.025000},
-{0.756250,0.868750,0.050000,0.050000},
-{0.768750,0.868750,0.025000,0.025000},
-{0.768750,0.868750,0.050000,0.050000},
-{0.781250,0.868750,0.025000,0.025000},
-{0.781250,0.868750,0.050000,0.050000},
-{0.793750,0.868750,0.025000,0.025000},
-{0.793750,0.868750,0.050000,0.050000},
-{0.806250,0.868750,0.025000,0.025000},
-{0.806250,0.868750,0.050000,0.050000},
-{0.818750,0.868750,0.025000,0.025000},
-{0.818750,0.868750,0.050000,0.050000},
-{0.831250,0.868750,0.025000,0.025000},
-{0.831250,0.868750,0.050000,0.050000},
-{0.843750,0.868750,0.025000,0.025000},
-{0.843750,0.868750,0.050000,0.050000},
-{0.856250,0.868750,0.025000,0.025000},
-{0.856250,0.868750,0.050000,0.050000},
-{0.868750,0.868750,0.025000,0.025000},
-{0.868750,0.868750,0.050000,0.050000},
-{0.881250,0.868750,0.025000,0.025000},
-{0.881250,0.868750,0.050000,0.050000},
-{0.893750,0.868750,0.025000,0.025000},
-{0.893750,0.868750,0.050000,0.050000},
-{0.906250,0.868750,0.025000,0.025000},
-{0.906250,0.868750,0.050000,0.050000},
-{0.918750,0.868750,0.025000,0.025000},
-{0.918750,0.868750,0.050000,0.050000},
-{0.931250,0.868750,0.025000,0.025000},
-{0.931250,0.868750,0.050000,0.050000},
-{0.943750,0.868750,0.025000,0.025000},
-{0.943750,0.868750,0.050000,0.050000},
-{0.956250,0.868750,0.025000,0.025000},
-{0.956250,0.868750,0.050000,0.050000},
-{0.968750,0.868750,0.025000,0.025000},
-{0.968750,0.868750,0.050000,0.050000},
-{0.981250,0.868750,0.025000,0.025000},
-{0.981250,0.868750,0.050000,0.050000},
-{0.993750,0.868750,0.025000,0.025000},
-{0.993750,0.868750,0.050000,0.050000},
-{0.006250,0.881250,0.025000,0.025000},
-{0.006250,0.881250,0.050000,0.050000},
-{0.018750,0.881250,0.025000,0.025000},
-{0.018750,0.881250,0.050000,0.050000},
-{0.031250,0.881250,0.025000,0.025000},
-{0.031250,0.881250,0.050000,0.050000},
-{0.043750,0.881250,0.025000,0.025000},
-{0.043750,0.881250,0.050000,0.050000},
-{0.056250,0.881250,0.025000,0.025000},
-{0.056250,0.881250,0.050000,0.050000},
-{0.068750,0.881250,0.025000,0.025000},
-{0.068750,0.881250,0.050000,0.050000},
-{0.081250,0.881250,0.025000,0.025000},
-{0.081250,0.881250,0.050000,0.050000},
-{0.093750,0.881250,0.025000,0.025000},
-{0.093750,0.881250,0.050000,0.050000},
-{0.106250,0.881250,0.025000,0.025000},
-{0.106250,0.881250,0.050000,0.050000},
-{0.118750,0.881250,0.025000,0.025000},
-{0.118750,0.881250,0.050000,0.050000},
-{0.131250,0.881250,0.025000,0.025000},
-{0.131250,0.881250,0.050000,0.050000},
-{0.143750,0.881250,0.025000,0.025000},
-{0.143750,0.881250,0.050000,0.050000},
-{0.156250,0.881250,0.025000,0.025000},
-{0.156250,0.881250,0.050000,0.050000},
-{0.168750,0.881250,0.025000,0.025000},
-{0.168750,0.881250,0.050000,0.050000},
-{0.181250,0.881250,0.025000,0.025000},
-{0.181250,0.881250,0.050000,0.050000},
-{0.193750,0.881250,0.025000,0.025000},
-{0.193750,0.881250,0.050000,0.050000},
-{0.206250,0.881250,0.025000,0.025000},
-{0.206250,0.881250,0.050000,0.050000},
-{0.218750,0.881250,0.025000,0.025000},
-{0.218750,0.881250,0.050000,0.050000},
-{0.231250,0.881250,0.025000,0.025000},
-{0.231250,0.881250,0.050000,0.050000},
-{0.243750,0.881250,0.025000,0.025000},
-{0.243750,0.881250,0.050000,0.050000},
-{0.256250,0.881250,0.025000,0.025000},
-{0.256250,0.881250,0.050000,0.050000},
-{0.268750,0.881250,0.025000,0.025000},
-{0.268750,0.881250,0.050000,0.050000},
-{0.281250,0.881250,0.025000,0.025000},
-{0.281250,0.881250,0.050000,0.050000},
-{0.293750,0.881250,0.025000,0.025000},
-{0.293750,0.881250,0.050000,0.050000},
-{0.306250,0.881250,0.025000,0.025000},
-{0.306250,0.881250,0.050000,0.050000},
-{0.318750,0.881250,0.025000,0.025000},
-{0.318750,0.881250,0.050000,0.050000},
-{0.331250,0.881250,0.025000,0.025000},
-{0.331250,0.881250,0.050000,0.050000},
-{0.343750,0.881250,0.025000,0.025000},
-{0.343750,0.881250,0.050000,0.050000},
-{0.356250,0.881250,0.025000,0.025000},
-{0.356250,0.881250,0.050000,0.050000},
-{0.368750,0.881250,0.025000,0.025000},
-{0.368750,0.881250,0.050000,0.050000},
-{0.381250,0.881250,0.025000,0.025000},
-{0.381250,0.881250,0.050000,0.050000},
-{0.393750,0.881250,0.025000,0.025000},
-{0.393750,0.881250,0.050000,0.050000},
-{0.406250,0.881250,0.025000,0.025000},
-{0.406250,0.881250,0.050000,0.050000},
-{0.418750,0.881250,0.025000,0.025000},
-{0.418750,0.881250,0.050000,0.050000},
-{0.431250,0.881250,0.025000,0.025000},
-{0.431250,0.881250,0.050000,0.050000},
-{0.443750,0.881250,0.025000,0.025000},
-{0.443750,0.881250,0.050000,0.050000},
-{0.456250,0.881250,0.025000,0.025000},
-{0.456250,0.881250,0.050000,0.050000},
-{0.468750,0.881250,0.025000,0.025000},
-{0.468750,0.881250,0.050000,0.050000},
-{0.481250,0.881250,0.025000,0.025000},
-{0.481250,0.881250,0.050000,0.050000},
-{0.493750,0.881250,0.025000,0.025000},
-{0.493750,0.881250,0.050000,0.050000},
-{0.506250,0.881250,0.025000,0.025000},
-{0.506250,0.881250,0.050000,0.050000},
-{0.518750,0.881250,0.025000,0.025000},
-{0.518750,0.881250,0.050000,0.050000},
-{0.531250,0.881250,0.025000,0.025000},
-{0.531250,0.881250,0.050000,0.050000},
-{0.543750,0.881250,0.025000,0.025000},
-{0.543750,0.881250,0.050000,0.050000},
-{0.556250,0.881250,0.025000,0.025000},
-{0.556250,0.881250,0.050000,0.050000},
-{0.568750,0.881250,0.025000,0.025000},
-{0.568750,0.881250,0.050000,0.050000},
-{0.581250,0.881250,0.025000,0.025000},
-{0.581250,0.881250,0.050000,0.050000},
-{0.593750,0.881250,0.025000,0.025000},
-{0.593750,0.881250,0.050000,0.050000},
-{0.606250,0.881250,0.025000,0.025000},
-{0.606250,0.881250,0.050000,0.050000},
-{0.618750,0.881250,0.025000,0.025000},
-{0.618750,0.881250,0.050000,0.050000},
-{0.631250,0.881250,0.025000,0.025000},
-{0.631250,0.881250,0.050000,0.050000},
-{0.643750,0.881250,0.025000,0.025000},
-{0.643750,0.881250,0.050000,0.050000},
-{0.656250,0.881250,0.025000,0.025000},
-{0.656250,0.881250,0.050000,0.050000},
-{0.668750,0.881250,0.025000,0.025000},
-{0.668750,0.881250,0.050000,0.050000},
-{0.681250,0.881250,0.025000,0.025000},
-{0.681250,0.881250,0.050000,0.050000},
-{0.693750,0.881250,0.025000,0.025000},
-{0.693750,0.881250,0.050000,0.050000},
-{0.706250,0.881250,0.025000,0.025000},
-{0.706250,0.881250,0.050000,0.050000},
-{0.718750,0.881250,0.025000,0.025000},
-{0.718750,0.881250,0.050000,0.050000},
-{0.731250,0.881250,0.025000,0.025000},
-{0.731250,0.881250,0.050000,0.050000},
-{0.743750,0.881250,0.025000,0.025000},
-{0.743750,0.881250,0.050000,0.050000},
-{0.756250,0.881250,0.025000,0.025000},
-{0.756250,0.881250,0.050000,0.050000},
-{0.768750,0.881250,0.025000,0.025000},
-{0.768750,0.881250,0.050000,0.050000},
-{0.781250,0.881250,0.025000,0.025000},
-{0.781250,0.881250,0.050000,0.050000},
-{0.793750,0.881250,0.025000,0.025000},
-{0.793750,0.881250,0.050000,0.050000},
-{0.806250,0.881250,0.025000,0.025000},
-{0.806250,0.881250,0.050000,0.050000},
-{0.818750,0.881250,0.025000,0.025000},
-{0.818750,0.881250,0.050000,0.050000},
-{0.831250,0.881250,0.025000,0.025000},
-{0.831250,0.881250,0.050000,0.050000},
-{0.843750,0.881250,0.025000,0.025000},
-{0.843750,0.881250,0.050000,0.050000},
-{0.856250,0.881250,0.025000,0.025000},
-{0.856250,0.881250,0.050000,0.050000},
-{0.868750,0.881250,0.025000,0.025000},
-{0.868750,0.881250,0.050000,0.050000},
-{0.881250,0.881250,0.025000,0.025000},
-{0.881250,0.881250,0.050000,0.050000},
-{0.893750,0.881250,0.025000,0.025000},
-{0.893750,0.881250,0.050000,0.050000},
-{0.906250,0.881250,0.025000,0.025000},
-{0.906250,0.881250,0.050000,0.050000},
-{0.918750,0.881250,0.025000,0.025000},
-{0.918750,0.881250,0.050000,0.050000},
-{0.931250,0.881250,0.025000,0.025000},
-{0.931250,0.881250,0.050000,0.050000},
-{0.943750,0.881250,0.025000,0.025000},
-{0.943750,0.881250,0.050000,0.050000},
-{0.956250,0.881250,0.025000,0.025000},
-{0.956250,0.881250,0.050000,0.050000},
-{0.968750,0.881250,0.025000,0.025000},
-{0.968750,0.881250,0.050000,0.050000},
-{0.981250,0.881250,0.025000,0.025000},
-{0.981250,0.881250,0.050000,0.050000},
-{0.993750,0.881250,0.025000,0.025000},
-{0.993750,0.881250,0.050000,0.050000},
-{0.006250,0.893750,0.025000,0.025000},
-{0.006250,0.893750,0.050000,0.050000},
-{0.018750,0.893750,0.025000,0.025000},
-{0.018750,0.893750,0.050000,0.050000},
-{0.031250,0.893750,0.025000,0.025000},
-{0.031250,0.893750,0.050000,0.050000},
-{0.043750,0.893750,0.025000,0.025000},
-{0.043750,0.893750,0.050000,0.050000},
-{0.056250,0.893750,0.025000,0.025000},
-{0.056250,0.893750,0.050000,0.050000},
-{0.068750,0.893750,0.025000,0.025000},
-{0.068750,0.893750,0.050000,0.050000},
-{0.081250,0.893750,0.025000,0.025000},
-{0.081250,0.893750,0.050000,0.050000},
-{0.093750,0.893750,0.025000,0.025000},
-{0.093750,0.893750,0.050000,0.050000},
-{0.106250,0.893750,0.025000,0.025000},
-{0.106250,0.893750,0.050000,0.050000},
-{0.118750,0.893750,0.025000,0.025000},
-{0.118750,0.893750,0.050000,0.050000},
-{0.131250,0.893750,0.025000,0.025000},
-{0.131250,0.893750,0.050000,0.050000},
-{0.143750,0.893750,0.025000,0.025000},
-{0.143750,0.893750,0.050000,0.050000},
-{0.156250,0.893750,0.025000,0.025000},
-{0.156250,0.893750,0.050000,0.050000},
-{0.168750,0.893750,0.025000,0.025000},
-{0.168750,0.893750,0.050000,0.050000},
-{0.181250,0.893750,0.025000,0.025000},
-{0.181250,0.893750,0.050000,0.050000},
-{0.193750,0.893750,0.025000,0.025000},
-{0.193750,0.893750,0.050000,0.050000},
-{0.206250,0.893750,0.025000,0.025000},
-{0.206250,0.893750,0.050000,0.050000},
-{0.218750,0.893750,0.025000,0.025000},
-{0.218750,0.893750,0.050000,0.050000},
-{0.231250,0.893750,0.025000,0.025000},
-{0.231250,0.893750,0.050000,0.050000},
-{0.243750,0.893750,0.025000,0.025000},
-{0.243750,0.893750,0.050000,0.050000},
-{0.256250,0.893750,0.025000,0.025000},
-{0.256250,0.893750,0.050000,0.050000},
-{0.268750,0.893750,0.025000,0.025000},
-{0.268750,0.893750,0.050000,0.050000},
-{0.281250,0.893750,0.025000,0.025000},
-{0.281250,0.893750,0.050000,0.050000},
-{0.293750,0.893750,0.025000,0.025000},
-{0.293750,0.893750,0.050000,0.050000},
-{0.306250,0.893750,0.025000,0.025000},
-{0.306250,0.893750,0.050000,0.050000},
-{0.318750,0.893750,0.025000,0.025000},
-{0.318750,0.893750,0.050000,0.050000},
-{0.331250,0.893750,0.025000,0.025000},
-{0.331250,0.893750,0.050000,0.050000},
-{0.343750,0.893750,0.025000,0.025000},
-{0.343750,0.893750,0.050000,0.050000},
-{0.356250,0.893750,0.025000,0.025000},
-{0.356250,0.893750,0.050000,0.050000},
-{0.368750,0.893750,0.025000,0.025000},
-{0.368750,0.893750,0.050000,0.050000},
-{0.381250,0.893750,0.025000,0.025000},
-{0.381250,0.893750,0.050000,0.050000},
-{0.393750,0.893750,0.025000,0.025000},
-{0.393750,0.893750,0.050000,0.050000},
-{0.406250,0.893750,0.025000,0.025000},
-{0.406250,0.893750,0.050000,0.050000},
-{0.418750,0.893750,0.025000,0.025000},
-{0.418750,0.893750,0.050000,0.050000},
-{0.431250,0.893750,0.025000,0.025000},
-{0.431250,0.893750,0.050000,0.050000},
-{0.443750,0.893750,0.025000,0.025000},
-{0.443750,0.893750,0.050000,0.050000},
-{0.456250,0.893750,0.025000,0.025000},
-{0.456250,0.893750,0.050000,0.050000},
-{0.468750,0.893750,0.025000,0.025000},
-{0.468750,0.893750,0.050000,0.050000},
-{0.481250,0.893750,0.025000,0.025000},
-{0.481250,0.893750,0.050000,0.050000},
-{0.493750,0.893750,0.025000,0.025000},
-{0.493750,0.893750,0.050000,0.050000},
-{0.506250,0.893750,0.025000,0.025000},
-{0.506250,0.893750,0.050000,0.050000},
-{0.518750,0.893750,0.025000,0.025000},
-{0.518750,0.893750,0.050000,0.050000},
-{0.531250,0.893750,0.025000,0.025000},
-{0.531250,0.893750,0.050000,0.050000},
-{0.543750,0.893750,0.025000,0.025000},
-{0.543750,0.893750,0.050000,0.050000},
-{0.556250,0.893750,0.025000,0.025000},
-{0.556250,0.893750,0.050000,0.050000},
-{0.568750,0.893750,0.025000,0.025000},
-{0.568750,0.893750,0.050000,0.050000},
-{0.581250,0.893750,0.025000,0.025000},
-{0.581250,0.893750,0.050000,0.050000},
-{0.593750,0.893750,0.025000,0.025000},
-{0.593750,0.893750,0.050000,0.050000},
-{0.606250,0.893750,0.025000,0.025000},
-{0.606250,0.893750,0.050000,0.050000},
-{0.618750,0.893750,0.025000,0.025000},
-{0.618750,0.893750,0.050000,0.050000},
-{0.631250,0.893750,0.025000,0.025000},
-{0.631250,0.893750,0.050000,0.050000},
-{0.643750,0.893750,0.025000,0.025000},
-{0.643750,0.893750,0.050000,0.050000},
-{0.656250,0.893750,0.025000,0.025000},
-{0.656250,0.893750,0.050000,0.050000},
-{0.668750,0.893750,0.025000,0.025000},
-{0.668750,0.893750,0.050000,0.050000},
-{0.681250,0.893750,0.025000,0.025000},
-{0.681250,0.893750,0.050000,0.050000},
-{0.693750,0.893750,0.025000,0.025000},
-{0.693750,0.893750,0.050000,0.050000},
-{0.706250,0.893750,0.025000,0.025000},
-{0.706250,0.893750,0.050000,0.050000},
-{0.718750,0.893750,0.025000,0.025000},
-{0.718750,0.893750,0.050000,0.050000},
-{0.731250,0.893750,0.025000,0.025000},
-{0.731250,0.893750,0.050000,0.050000},
-{0.743750,0.893750,0.025000,0.025000},
-{0.743750,0.893750,0.050000,0.050000},
-{0.756250,0.893750,0.025000,0.025000},
-{0.756250,0.893750,0.050000,0.050000},
-{0.768750,0.893750,0.025000,0.025000},
-{0.768750,0.893750,0.050000,0.050000},
-{0.781250,0.893750,0.025000,0.025000},
-{0.781250,0.893750,0.050000,0.050000},
-{0.793750,0.893750,0.025000,0.025000},
-{0.793750,0.893750,0.050000,0.050000},
-{0.806250,0.893750,0.025000,0.025000},
-{0.806250,0.893750,0.050000,0.050000},
-{0.818750,0.893750,0.025000,0.025000},
-{0.818750,0.893750,0.050000,0.050000},
-{0.831250,0.893750,0.025000,0.025000},
-{0.831250,0.893750,0.050000,0.050000},
-{0.843750,0.893750,0.025000,0.025000},
-{0.843750,0.893750,0.050000,0.050000},
-{0.856250,0.893750,0.025000,0.025000},
-{0.856250,0.893750,0.050000,0.050000},
-{0.868750,0.893750,0.025000,0.025000},
-{0.868750,0.893750,0.050000,0.050000},
-{0.881250,0.893750,0.025000,0.025000},
-{0.881250,0.893750,0.050000,0.050000},
-{0.893750,0.893750,0.025000,0.025000},
-{0.893750,0.893750,0.050000,0.050000},
-{0.906250,0.893750,0.025000,0.025000},
-{0.906250,0.893750,0.050000,0.050000},
-{0.918750,0.893750,0.025000,0.025000},
-{0.918750,0.893750,0.050000,0.050000},
-{0.931250,0.893750,0.025000,0.025000},
-{0.931250,0.893750,0.050000,0.050000},
-{0.943750,0.893750,0.025000,0.025000},
-{0.943750,0.893750,0.050000,0.050000},
-{0.956250,0.893750,0.025000,0.025000},
-{0.956250,0.893750,0.050000,0.050000},
-{0.968750,0.893750,0.025000,0.025000},
-{0.968750,0.893750,0.050000,0.050000},
-{0.981250,0.893750,0.025000,0.025000},
-{0.981250,0.893750,0.050000,0.050000},
-{0.993750,0.893750,0.025000,0.025000},
-{0.993750,0.893750,0.050000,0.050000},
-{0.006250,0.906250,0.025000,0.025000},
-{0.006250,0.906250,0.050000,0.050000},
-{0.018750,0.906250,0.025000,0.025000},
-{0.018750,0.906250,0.050000,0.050000},
-{0.031250,0.906250,0.025000,0.025000},
-{0.031250,0.906250,0.050000,0.050000},
-{0.043750,0.906250,0.025000,0.025000},
-{0.043750,0.906250,0.050000,0.050000},
-{0.056250,0.906250,0.025000,0.025000},
-{0.056250,0.906250,0.050000,0.050000},
-{0.068750,0.906250,0.025000,0.025000},
-{0.068750,0.906250,0.050000,0.050000},
-{0.081250,0.906250,0.025000,0.025000},
-{0.081250,0.906250,0.050000,0.050000},
-{0.093750,0.906250,0.025000,0.025000},
-{0.093750,0.906250,0.050000,0.050000},
-{0.106250,0.906250,0.025000,0.025000},
-{0.106250,0.906250,0.050000,0.050000},
-{0.118750,0.906250,0.025000,0.025000},
-{0.118750,0.906250,0.050000,0.050000},
-{0.131250,0.906250,0.025000,0.025000},
-{0.131250,0.906250,0.050000,0.050000},
-{0.143750,0.906250,0.025000,0.025000},
-{0.143750,0.906250,0.050000,0.050000},
-{0.156250,0.906250,0.025000,0.025000},
-{0.156250,0.906250,0.050000,0.050000},
-{0.168750,0.906250,0.025000,0.025000},
-{0.168750,0.906250,0.050000,0.050000},
-{0.181250,0.906250,0.025000,0.025000},
-{0.181250,0.906250,0.050000,0.050000},
-{0.193750,0.906250,0.025000,0.025000},
-{0.193750,0.906250,0.050000,0.050000},
-{0.206250,0.906250,0.025000,0.025000},
-{0.206250,0.906250,0.050000,0.050000},
-{0.218750,0.906250,0.025000,0.025000},
-{0.218750,0.906250,0.050000,0.050000},
-{0.231250,0.906250,0.025000,0.025000},
-{0.231250,0.906250,0.050000,0.050000},
-{0.243750,0.906250,0.025000,0.025000},
-{0.243750,0.906250,0.050000,0.050000},
-{0.256250,0.906250,0.025000,0.025000},
-{0.256250,0.906250,0.050000,0.050000},
-{0.268750,0.906250,0.025000,0.025000},
-{0.268750,0.906250,0.050000,0.050000},
-{0.281250,0.906250,0.025000,0.025000},
-{0.281250,0.906250,0.050000,0.050000},
-{0.293750,0.906250,0.025000,0.025000},
-{0.293750,0.906250,0.050000,0.050000},
-{0.306250,0.906250,0.025000,0.025000},
-{0.306250,0.906250,0.050000,0.050000},
-{0.318750,0.906250,0.025000,0.025000},
-{0.318750,0.906250,0.050000,0.050000},
-{0.331250,0.906250,0.025000,0.025000},
-{0.331250,0.906250,0.050000,0.050000},
-{0.343750,0.906250,0.025000,0.025000},
-{0.343750,0.906250,0.050000,0.050000},
-{0.356250,0.906250,0.025000,0.025000},
-{0.356250,0.906250,0.050000,0.050000},
-{0.368750,0.906250,0.025000,0.025000},
-{0.368750,0.906250,0.050000,0.050000},
-{0.381250,0.906250,0.025000,0.025000},
-{0.381250,0.906250,0.050000,0.050000},
-{0.393750,0.906250,0.025000,0.025000},
-{0.393750,0.906250,0.050000,0.050000},
-{0.406250,0.906250,0.025000,0.025000},
-{0.406250,0.906250,0.050000,0.050000},
-{0.418750,0.906250,0.025000,0.025000},
-{0.418750,0.906250,0.050000,0.050000},
-{0.431250,0.906250,0.025000,0.025000},
-{0.431250,0.906250,0.050000,0.050000},
-{0.443750,0.906250,0.025000,0.025000},
-{0.443750,0.906250,0.050000,0.050000},
-{0.456250,0.906250,0.025000,0.025000},
-{0.456250,0.906250,0.050000,0.050000},
-{0.468750,0.906250,0.025000,0.025000},
-{0.468750,0.906250,0.050000,0.050000},
-{0.481250,0.906250,0.025000,0.025000},
-{0.481250,0.906250,0.050000,0.050000},
-{0.493750,0.906250,0.025000,0.025000},
-{0.493750,0.906250,0.050000,0.050000},
-{0.506250,0.906250,0.025000,0.025000},
-{0.506250,0.906250,0.050000,0.050000},
-{0.518750,0.906250,0.025000,0.025000},
-{0.518750,0.906250,0.050000,0.050000},
-{0.531250,0.906250,0.025000,0.025000},
-{0.531250,0.906250,0.050000,0.050000},
-{0.543750,0.906250,0.025000,0.025000},
-{0.543750,0.906250,0.050000,0.050000},
-{0.556250,0.906250,0.025000,0.025000},
-{0.556250,0.906250,0.050000,0.050000},
-{0.568750,0.906250,0.025000,0.025000},
-{0.568750,0.906250,0.050000,0.050000},
-{0.581250,0.906250,0.025000,0.025000},
-{0.581250,0.906250,0.050000,0.050000},
-{0.593750,0.906250,0.025000,0.025000},
-{0.593750,0.906250,0.050000,0.050000},
-{0.606250,0.906250,0.025000,0.025000},
-{0.606250,0.906250,0.050000,0.050000},
-{0.618750,0.906250,0.025000,0.025000},
-{0.618750,0.906250,0.050000,0.050000},
-{0.631250,0.906250,0.025000,0.025000},
-{0.631250,0.906250,0.050000,0.050000},
-{0.643750,0.906250,0.025000,0.025000},
-{0.643750,0.906250,0.050000,0.050000},
-{0.656250,0.906250,0.025000,0.025000},
-{0.656250,0.906250,0.050000,0.050000},
-{0.668750,0.906250,0.025000,0.025000},
-{0.668750,0.906250,0.050000,0.050000},
-{0.681250,0.906250,0.025000,0.025000},
-{0.681250,0.906250,0.050000,0.050000},
-{0.693750,0.906250,0.025000,0.025000},
-{0.693750,0.906250,0.050000,0.050000},
-{0.706250,0.906250,0.025000,0.025000},
-{0.706250,0.906250,0.050000,0.050000},
-{0.718750,0.906250,0.025000,0.025000},
-{0.718750,0.906250,0.050000,0.050000},
-{0.731250,0.906250,0.025000,0.025000},
-{0.731250,0.906250,0.050000,0.050000},
-{0.743750,0.906250,0.025000,0.025000},
-{0.743750,0.906250,0.050000,0.050000},
-{0.756250,0.906250,0.025000,0.025000},
-{0.756250,0.906250,0.050000,0.050000},
-{0.768750,0.906250,0.025000,0.025000},
-{0.768750,0.906250,0.050000,0.050000},
-{0.781250,0.906250,0.025000,0.025000},
-{0.781250,0.906250,0.050000,0.050000},
-{0.793750,0.906250,0.025000,0.025000},
-{0.793750,0.906250,0.050000,0.050000},
-{0.806250,0.906250,0.025000,0.025000},
-{0.806250,0.906250,0.050000,0.050000},
-{0.818750,0.906250,0.025000,0.025000},
-{0.818750,0.906250,0.050000,0.050000},
-{0.831250,0.906250,0.025000,0.025000},
-{0.831250,0.906250,0.050000,0.050000},
-{0.843750,0.906250,0.025000,0.025000},
-{0.843750,0.906250,0.050000,0.050000},
-{0.856250,0.906250,0.025000,0.025000},
-{0.856250,0.906250,0.050000,0.050000},
-{0.868750,0.906250,0.025000,0.025000},
-{0.868750,0.906250,0.050000,0.050000},
-{0.881250,0.906250,0.025000,0.025000},
-{0.881250,0.906250,0.050000,0.050000},
-{0.893750,0.906250,0.025000,0.025000},
-{0.893750,0.906250,0.050000,0.050000},
-{0.906250,0.906250,0.025000,0.025000},
-{0.906250,0.906250,0.050000,0.050000},
-{0.918750,0.906250,0.025000,0.025000},
-{0.918750,0.906250,0.050000,0.050000},
-{0.931250,0.906250,0.025000,0.025000},
-{0.931250,0.906250,0.050000,0.050000},
-{0.943750,0.906250,0.025000,0.025000},
-{0.943750,0.906250,0.050000,0.050000},
-{0.956250,0.906250,0.025000,0.025000},
-{0.956250,0.906250,0.050000,0.050000},
-{0.968750,0.906250,0.025000,0.025000},
-{0.968750,0.906250,0.050000,0.050000},
-{0.981250,0.906250,0.025000,0.025000},
-{0.981250,0.906250,0.050000,0.050000},
-{0.993750,0.906250,0.025000,0.025000},
-{0.993750,0.906250,0.050000,0.050000},
-{0.006250,0.918750,0.025000,0.025000},
-{0.006250,0.918750,0.050000,0.050000},
-{0.018750,0.918750,0.025000,0.025000},
-{0.018750,0.918750,0.050000,0.050000},
-{0.031250,0.918750,0.025000,0.025000},
-{0.031250,0.918750,0.050000,0.050000},
-{0.043750,0.918750,0.025000,0.025000},
-{0.043750,0.918750,0.050000,0.050000},
-{0.056250,0.918750,0.025000,0.025000},
-{0.056250,0.918750,0.050000,0.050000},
-{0.068750,0.918750,0.025000,0.025000},
-{0.068750,0.918750,0.050000,0.050000},
-{0.081250,0.918750,0.025000,0.025000},
-{0.081250,0.918750,0.050000,0.050000},
-{0.093750,0.918750,0.025000,0.025000},
-{0.093750,0.918750,0.050000,0.050000},
-{0.106250,0.918750,0.025000,0.025000},
-{0.106250,0.918750,0.050000,0.050000},
-{0.118750,0.918750,0.025000,0.025000},
-{0.118750,0.918750,0.050000,0.050000},
-{0.131250,0.918750,0.025000,0.025000},
-{0.131250,0.918750,0.050000,0.050000},
-{0.143750,0.918750,0.025000,0.025000},
-{0.143750,0.918750,0.050000,0.050000},
-{0.156250,0.918750,0.025000,0.025000},
-{0.156250,0.918750,0.050000,0.050000},
-{0.168750,0.918750,0.025000,0.025000},
-{0.168750,0.918750,0.050000,0.050000},
-{0.181250,0.918750,0.025000,0.025000},
-{0.181250,0.918750,0.050000,0.050000},
-{0.193750,0.918750,0.025000,0.025000},
-{0.193750,0.918750,0.050000,0.050000},
-{0.206250,0.918750,0.025000,0.025000},
-{0.206250,0.918750,0.050000,0.050000},
-{0.218750,0.918750,0.025000,0.025000},
-{0.218750,0.918750,0.050000,0.050000},
-{0.231250,0.918750,0.025000,0.025000},
-{0.231250,0.918750,0.050000,0.050000},
-{0.243750,0.918750,0.025000,0.025000},
-{0.243750,0.918750,0.050000,0.050000},
-{0.256250,0.918750,0.025000,0.025000},
-{0.256250,0.918750,0.050000,0.050000},
-{0.268750,0.918750,0.025000,0.025000},
-{0.268750,0.918750,0.050000,0.050000},
-{0.281250,0.918750,0.025000,0.025000},
-{0.281250,0.918750,0.050000,0.050000},
-{0.293750,0.918750,0.025000,0.025000},
-{0.293750,0.918750,0.050000,0.050000},
-{0.306250,0.918750,0.025000,0.025000},
-{0.306250,0.918750,0.050000,0.050000},
-{0.318750,0.918750,0.025000,0.025000},
-{0.318750,0.918750,0.050000,0.050000},
-{0.331250,0.918750,0.025000,0.025000},
-{0.331250,0.918750,0.050000,0.050000},
-{0.343750,0.918750,0.025000,0.025000},
-{0.343750,0.918750,0.050000,0.050000},
-{0.356250,0.918750,0.025000,0.025000},
-{0.356250,0.918750,0.050000,0.050000},
-{0.368750,0.918750,0.025000,0.025000},
-{0.368750,0.918750,0.050000,0.050000},
-{0.381250,0.918750,0.025000,0.025000},
-{0.381250,0.918750,0.050000,0.050000},
-{0.393750,0.918750,0.025000,0.025000},
-{0.393750,0.918750,0.050000,0.050000},
-{0.406250,0.918750,0.025000,0.025000},
-{0.406250,0.918750,0.050000,0.050000},
-{0.418750,0.918750,0.025000,0.025000},
-{0.418750,0.918750,0.050000,0.050000},
-{0.431250,0.918750,0.025000,0.025000},
-{0.431250,0.918750,0.050000,0.050000},
-{0.443750,0.918750,0.025000,0.025000},
-{0.443750,0.918750,0.050000,0.050000},
-{0.456250,0.918750,0.025000,0.025000},
-{0.456250,0.918750,0.050000,0.050000},
-{0.468750,0.918750,0.025000,0.025000},
-{0.468750,0.918750,0.050000,0.050000},
-{0.481250,0.918750,0.025000,0.025000},
-{0.481250,0.918750,0.050000,0.050000},
-{0.493750,0.918750,0.025000,0.025000},
-{0.493750,0.918750,0.050000,0.050000},
-{0.506250,0.918750,0.025000,0.025000},
-{0.506250,0.918750,0.050000,0.050000},
-{0.518750,0.918750,0.025000,0.025000},
-{0.518750,0.918750,0.050000,0.050000},
-{0.531250,0.918750,0.025000,0.025000},
-{0.531250,0.918750,0.050000,0.050000},
-{0.543750,0.918750,0.025000,0.025000},
-{0.543750,0.918750,0.050000,0.050000},
-{0.556250,0.918750,0.025000,0.025000},
-{0.556250,0.918750,0.050000,0.050000},
-{0.568750,0.918750,0.025000,0.025000},
-{0.568750,0.918750,0.050000,0.050000},
-{0.581250,0.918750,0.025000,0.025000},
-{0.581250,0.918750,0.050000,0.050000},
-{0.593750,0.918750,0.025000,0.025000},
-{0.593750,0.918750,0.050000,0.050000},
-{0.606250,0.918750,0.025000,0.025000},
-{0.606250,0.918750,0.050000,0.050000},
-{0.618750,0.918750,0.025000,0.025000},
-{0.618750,0.918750,0.050000,0.050000},
-{0.631250,0.918750,0.025000,0.025000},
-{0.631250,0.918750,0.050000,0.050000},
-{0.643750,0.918750,0.025000,0.025000},
-{0.643750,0.918750,0.050000,0.050000},
-{0.656250,0.918750,0.025000,0.025000},
-{0.656250,0.918750,0.050000,0.050000},
-{0.668750,0.918750,0.025000,0.025000},
-{0.668750,0.918750,0.050000,0.050000},
-{0.681250,0.918750,0.025000,0.025000},
-{0.681250,0.918750,0.050000,0.050000},
-{0.693750,0.918750,0.025000,0.025000},
-{0.693750,0.918750,0.050000,0.050000},
-{0.706250,0.918750,0.025000,0.025000},
-{0.706250,0.918750,0.050000,0.050000},
-{0.718750,0.918750,0.025000,0.025000},
-{0.718750,0.918750,0.050000,0.050000},
-{0.731250,0.918750,0.025000,0.025000},
-{0.731250,0.918750,0.050000,0.050000},
-{0.743750,0.918750,0.025000,0.025000},
-{0.743750,0.918750,0.050000,0.050000},
-{0.756250,0.918750,0.025000,0.025000},
-{0.756250,0.918750,0.050000,0.050000},
-{0.768750,0.918750,0.025000,0.025000},
-{0.768750,0.918750,0.050000,0.050000},
-{0.781250,0.918750,0.025000,0.025000},
-{0.781250,0.918750,0.050000,0.050000},
-{0.793750,0.918750,0.025000,0.025000},
-{0.793750,0.918750,0.050000,0.050000},
-{0.806250,0.918750,0.025000,0.025000},
-{0.806250,0.918750,0.050000,0.050000},
-{0.818750,0.918750,0.025000,0.025000},
-{0.818750,0.918750,0.050000,0.050000},
-{0.831250,0.918750,0.025000,0.025000},
-{0.831250,0.918750,0.050000,0.050000},
-{0.843750,0.918750,0.025000,0.025000},
-{0.843750,0.918750,0.050000,0.050000},
-{0.856250,0.918750,0.025000,0.025000},
-{0.856250,0.918750,0.050000,0.050000},
-{0.868750,0.918750,0.025000,0.025000},
-{0.868750,0.918750,0.050000,0.050000},
-{0.881250,0.918750,0.025000,0.025000},
-{0.881250,0.918750,0.050000,0.050000},
-{0.893750,0.918750,0.025000,0.025000},
-{0.893750,0.918750,0.050000,0.050000},
-{0.906250,0.918750,0.025000,0.025000},
-{0.906250,0.918750,0.050000,0.050000},
-{0.918750,0.918750,0.025000,0.025000},
-{0.918750,0.918750,0.050000,0.050000},
-{0.931250,0.918750,0.025000,0.025000},
-{0.931250,0.918750,0.050000,0.050000},
-{0.943750,0.918750,0.025000,0.025000},
-{0.943750,0.918750,0.050000,0.050000},
-{0.956250,0.918750,0.025000,0.025000},
-{0.956250,0.918750,0.050000,0.050000},
-{0.968750,0.918750,0.025000,0.025000},
-{0.968750,0.918750,0.050000,0.050000},
-{0.981250,0.918750,0.025000,0.025000},
-{0.981250,0.918750,0.050000,0.050000},
-{0.993750,0.918750,0.025000,0.025000},
-{0.993750,0.918750,0.050000,0.050000},
-{0.006250,0.931250,0.025000,0.025000},
-{0.006250,0.931250,0.050000,0.050000},
-{0.018750,0.931250,0.025000,0.025000},
-{0.018750,0.931250,0.050000,0.050000},
-{0.031250,0.931250,0.025000,0.025000},
-{0.031250,0.931250,0.050000,0.050000},
-{0.043750,0.931250,0.025000,0.025000},
-{0.043750,0.931250,0.050000,0.050000},
-{0.056250,0.931250,0.025000,0.025000},
-{0.056250,0.931250,0.050000,0.050000},
-{0.068750,0.931250,0.025000,0.025000},
-{0.068750,0.931250,0.050000,0.050000},
-{0.081250,0.931250,0.025000,0.025000},
-{0.081250,0.931250,0.050000,0.050000},
-{0.093750,0.931250,0.025000,0.025000},
-{0.093750,0.931250,0.050000,0.050000},
-{0.106250,0.931250,0.025000,0.025000},
-{0.106250,0.931250,0.050000,0.050000},
-{0.118750,0.931250,0.025000,0.025000},
-{0.118750,0.931250,0.050000,0.050000},
-{0.131250,0.931250,0.025000,0.025000},
-{0.131250,0.931250,0.050000,0.050000},
-{0.143750,0.931250,0.025000,0.025000},
-{0.143750,0.931250,0.050000,0.050000},
-{0.156250,0.931250,0.025000,0.025000},
-{0.156250,0.931250,0.050000,0.050000},
-{0.168750,0.931250,0.025000,0.025000},
-{0.168750,0.931250,0.050000,0.050000},
-{0.181250,0.931250,0.025000,0.025000},
-{0.181250,0.931250,0.050000,0.050000},
-{0.193750,0.931250,0.025000,0.025000},
-{0.193750,0.931250,0.050000,0.050000},
-{0.206250,0.931250,0.025000,0.025000},
-{0.206250,0.931250,0.050000,0.050000},
-{0.218750,0.931250,0.025000,0.025000},
-{0.218750,0.931250,0.050000,0.050000},
-{0.231250,0.931250,0.025000,0.025000},
-{0.231250,0.931250,0.050000,0.050000},
-{0.243750,0.931250,0.025000,0.025000},
-{0.243750,0.931250,0.050000,0.050000},
-{0.256250,0.931250,0.025000,0.025000},
-{0.256250,0.931250,0.050000,0.050000},
-{0.268750,0.931250,0.025000,0.025000},
-{0.268750,0.931250,0.050000,0.050000},
-{0.281250,0.931250,0.025000,0.025000},
-{0.281250,0.931250,0.050000,0.050000},
-{0.293750,0.931250,0.025000,0.025000},
-{0.293750,0.931250,0.050000,0.050000},
-{0.306250,0.931250,0.025000,0.025000},
-{0.306250,0.931250,0.050000,0.050000},
-{0.318750,0.931250,0.025000,0.025000},
-{0.318750,0.931250,0.050000,0.050000},
-{0.331250,0.931250,0.025000,0.025000},
-{0.331250,0.931250,0.050000,0.050000},
-{0.343750,0.931250,0.025000,0.025000},
-{0.343750,0.931250,0.050000,0.050000},
-{0.356250,0.931250,0.025000,0.025000},
-{0.356250,0.931250,0.050000,0.050000},
-{0.368750,0.931250,0.025000,0.025000},
-{0.368750,0.931250,0.050000,0.050000},
-{0.381250,0.931250,0.025000,0.025000},
-{0.381250,0.931250,0.050000,0.050000},
-{0.393750,0.931250,0.025000,0.025000},
-{0.393750,0.931250,0.050000,0.050000},
-{0.406250,0.931250,0.025000,0.025000},
-{0.406250,0.931250,0.050000,0.050000},
-{0.418750,0.931250,0.025000,0.025000},
-{0.418750,0.931250,0.050000,0.050000},
-{0.431250,0.931250,0.025000,0.025000},
-{0.431250,0.931250,0.050000,0.050000},
-{0.443750,0.931250,0.025000,0.025000},
-{0.443750,0.931250,0.050000,0.050000},
-{0.456250,0.931250,0.025000,0.025000},
-{0.456250,0.931250,0.050000,0.050000},
-{0.468750,0.931250,0.025000,0.025000},
-{0.468750,0.931250,0.050000,0.050000},
-{0.481250,0.931250,0.025000,0.025000},
-{0.481250,0.931250,0.050000,0.050000},
-{0.493750,0.931250,0.025000,0.025000},
-{0.493750,0.931250,0.050000,0.050000},
-{0.506250,0.931250,0.025000,0.025000},
-{0.506250,0.931250,0.050000,0.050000},
-{0.518750,0.931250,0.025000,0.025000},
-{0.518750,0.931250,0.050000,0.050000},
-{0.531250,0.931250,0.025000,0.025000},
-{0.531250,0.931250,0.050000,0.050000},
-{0.543750,0.931250,0.025000,0.025000},
-{0.543750,0.931250,0.050000,0.050000},
-{0.556250,0.931250,0.025000,0.025000},
-{0.556250,0.931250,0.050000,0.050000},
-{0.568750,0.931250,0.025000,0.025000},
-{0.568750,0.931250,0.050000,0.050000},
-{0.581250,0.931250,0.025000,0.025000},
-{0.581250,0.931250,0.050000,0.050000},
-{0.593750,0.931250,0.025000,0.025000},
-{0.593750,0.931250,0.050000,0.050000},
-{0.606250,0.931250,0.025000,0.025000},
-{0.606250,0.931250,0.050000,0.050000},
-{0.618750,0.931250,0.025000,0.025000},
-{0.618750,0.931250,0.050000,0.050000},
-{0.631250,0.931250,0.025000,0.025000},
-{0.631250,0.931250,0.050000,0.050000},
-{0.643750,0.931250,0.025000,0.025000},
-{0.643750,0.931250,0.050000,0.050000},
-{0.656250,0.931250,0.025000,0.025000},
-{0.656250,0.931250,0.050000,0.050000},
-{0.668750,0.931250,0.025000,0.025000},
-{0.668750,0.931250,0.050000,0.050000},
-{0.681250,0.931250,0.025000,0.025000},
-{0.681250,0.931250,0.050000,0.050000},
-{0.693750,0.931250,0.025000,0.025000},
-{0.693750,0.931250,0.050000,0.050000},
-{0.706250,0.931250,0.025000,0.025000},
-{0.706250,0.931250,0.050000,0.050000},
-{0.718750,0.931250,0.025000,0.025000},
-{0.718750,0.931250,0.050000,0.050000},
-{0.731250,0.931250,0.025000,0.025000},
-{0.731250,0.931250,0.050000,0.050000},
-{0.743750,0.931250,0.025000,0.025000},
-{0.743750,0.931250,0.050000,0.050000},
-{0.756250,0.931250,0.025000,0.025000},
-{0.756250,0.931250,0.050000,0.050000},
-{0.768750,0.931250,0.025000,0.025000},
-{0.768750,0.931250,0.050000,0.050000},
-{0.781250,0.931250,0.025000,0.025000},
-{0.781250,0.931250,0.050000,0.050000},
-{0.793750,0.931250,0.025000,0.025000},
-{0.793750,0.931250,0.050000,0.050000},
-{0.806250,0.931250,0.025000,0.025000},
-{0.806250,0.931250,0.050000,0.050000},
-{0.818750,0.931250,0.025000,0.025000},
-{0.818750,0.931250,0.050000,0.050000},
-{0.831250,0.931250,0.025000,0.025000},
-{0.831250,0.931250,0.050000,0.050000},
-{0.843750,0.931250,0.025000,0.025000},
-{0.843750,0.931250,0.050000,0.050000},
-{0.856250,0.931250,0.025000,0.025000},
-{0.856250,0.931250,0.050000,0.050000},
-{0.868750,0.931250,0.025000,0.025000},
-{0.868750,0.931250,0.050000,0.050000},
-{0.881250,0.931250,0.025000,0.025000},
-{0.881250,0.931250,0.050000,0.050000},
-{0.893750,0.931250,0.025000,0.025000},
-{0.893750,0.931250,0.050000,0.050000},
-{0.906250,0.931250,0.025000,0.025000},
-{0.906250,0.931250,0.050000,0.050000},
-{0.918750,0.931250,0.025000,0.025000},
-{0.918750,0.931250,0.050000,0.050000},
-{0.931250,0.931250,0.025000,0.025000},
-{0.931250,0.931250,0.050000,0.050000},
-{0.943750,0.931250,0.025000,0.025000},
-{0.943750,0.931250,0.050000,0.050000},
-{0.956250,0.931250,0.025000,0.025000},
-{0.956250,0.931250,0.050000,0.050000},
-{0.968750,0.931250,0.025000,0.025000},
-{0.968750,0.931250,0.050000,0.050000},
-{0.981250,0.931250,0.025000,0.025000},
-{0.981250,0.931250,0.050000,0.050000},
-{0.993750,0.931250,0.025000,0.025000},
-{0.993750,0.931250,0.050000,0.050000},
-{0.006250,0.943750,0.025000,0.025000},
-{0.006250,0.943750,0.050000,0.050000},
-{0.018750,0.943750,0.025000,0.025000},
-{0.018750,0.943750,0.050000,0.050000},
-{0.031250,0.943750,0.025000,0.025000},
-{0.031250,0.943750,0.050000,0.050000},
-{0.043750,0.943750,0.025000,0.025000},
-{0.043750,0.943750,0.050000,0.050000},
-{0.056250,0.943750,0.025000,0.025000},
-{0.056250,0.943750,0.050000,0.050000},
-{0.068750,0.943750,0.025000,0.025000},
-{0.068750,0.943750,0.050000,0.050000},
-{0.081250,0.943750,0.025000,0.025000},
-{0.081250,0.943750,0.050000,0.050000},
-{0.093750,0.943750,0.025000,0.025000},
-{0.093750,0.943750,0.050000,0.050000},
-{0.106250,0.943750,0.025000,0.025000},
-{0.106250,0.943750,0.050000,0.050000},
-{0.118750,0.943750,0.025000,0.025000},
-{0.118750,0.943750,0.050000,0.050000},
-{0.131250,0.943750,0.025000,0.025000},
-{0.131250,0.943750,0.050000,0.050000},
-{0.143750,0.943750,0.025000,0.025000},
-{0.143750,0.943750,0.050000,0.050000},
-{0.156250,0.943750,0.025000,0.025000},
-{0.156250,0.943750,0.050000,0.050000},
-{0.168750,0.943750,0.025000,0.025000},
-{0.168750,0.943750,0.050000,0.050000},
-{0.181250,0.943750,0.025000,0.025000},
-{0.181250,0.943750,0.050000,0.050000},
-{0.193750,0.943750,0.025000,0.025000},
-{0.193750,0.943750,0.050000,0.050000},
-{0.206250,0.943750,0.025000,0.025000},
-{0.206250,0.943750,0.050000,0.050000},
-{0.218750,0.943750,0.025000,0.025000},
-{0.218750,0.943750,0.050000,0.050000},
-{0.231250,0.943750,0.025000,0.025000},
-{0.231250,0.943750,0.050000,0.050000},
-{0.243750,0.943750,0.025000,0.025000},
-{0.243750,0.943750,0.050000,0.050000},
-{0.256250,0.943750,0.025000,0.025000},
-{0.256250,0.943750,0.050000,0.050000},
-{0.268750,0.943750,0.025000,0.025000},
-{0.268750,0.943750,0.050000,0.050000},
-{0.281250,0.943750,0.025000,0.025000},
-{0.281250,0.943750,0.050000,0.050000},
-{0.293750,0.943750,0.025000,0.025000},
-{0.293750,0.943750,0.050000,0.050000},
-{0.306250,0.943750,0.025000,0.025000},
-{0.306250,0.943750,0.050000,0.050000},
-{0.318750,0.943750,0.025000,0.025000},
-{0.318750,0.943750,0.050000,0.050000},
-{0.331250,0.943750,0.025000,0.025000},
-{0.331250,0.943750,0.050000,0.050000},
-{0.343750,0.943750,0.025000,0.025000},
-{0.343750,0.943750,0.050000,0.050000},
-{0.356250,0.943750,0.025000,0.025000},
-{0.356250,0.943750,0.050000,0.050000},
-{0.368750,0.943750,0.025000,0.025000},
-{0.368750,0.943750,0.050000,0.050000},
-{0.381250,0.943750,0.025000,0.025000},
-{0.381250,0.943750,0.050000,0.050000},
-{0.393750,0.943750,0.025000,0.025000},
-{0.393750,0.943750,0.050000,0.050000},
-{0.406250,0.943750,0.025000,0.025000},
-{0.406250,0.943750,0.050000,0.050000},
-{0.418750,0.943750,0.025000,0.025000},
-{0.418750,0.943750,0.050000,0.050000},
-{0.431250,0.943750,0.025000,0.025000},
-{0.431250,0.943750,0.050000,0.050000},
-{0.443750,0.943750,0.025000,0.025000},
-{0.443750,0.943750,0.050000,0.050000},
-{0.456250,0.943750,0.025000,0.025000},
-{0.456250,0.943750,0.050000,0.050000},
-{0.468750,0.943750,0.025000,0.025000},
-{0.468750,0.943750,0.050000,0.050000},
-{0.481250,0.943750,0.025000,0.025000},
-{0.481250,0.943750,0.050000,0.050000},
-{0.493750,0.943750,0.025000,0.025000},
-{0.493750,0.943750,0.050000,0.050000},
-{0.506250,0.943750,0.025000,0.025000},
-{0.506250,0.943750,0.050000,0.050000},
-{0.518750,0.943750,0.025000,0.025000},
-{0.518750,0.943750,0.050000,0.050000},
-{0.531250,0.943750,0.025000,0.025000},
-{0.531250,0.943750,0.050000,0.050000},
-{0.543750,0.943750,0.025000,0.025000},
-{0.543750,0.943750,0.050000,0.050000},
-{0.556250,0.943750,0.025000,0.025000},
-{0.556250,0.943750,0.050000,0.050000},
-{0.568750,0.943750,0.025000,0.025000},
-{0.568750,0.943750,0.050000,0.050000},
-{0.581250,0.943750,0.025000,0.025000},
-{0.581250,0.943750,0.050000,0.050000},
-{0.593750,0.943750,0.025000,0.025000},
-{0.593750,0.943750,0.050000,0.050000},
-{0.606250,0.943750,0.025000,0.025000},
-{0.606250,0.943750,0.050000,0.050000},
-{0.618750,0.943750,0.025000,0.025000},
-{0.618750,0.943750,0.050000,0.050000},
-{0.631250,0.943750,0.025000,0.025000},
-{0.631250,0.943750,0.050000,0.050000},
-{0.643750,0.943750,0.025000,0.025000},
-{0.643750,0.943750,0.050000,0.050000},
-{0.656250,0.943750,0.025000,0.025000},
-{0.656250,0.943750,0.050000,0.050000},
-{0.668750,0.943750,0.025000,0.025000},
-{0.668750,0.943750,0.050000,0.050000},
-{0.681250,0.943750,0.025000,0.025000},
-{0.681250,0.943750,0.050000,0.050000},
-{0.693750,0.943750,0.025000,0.025000},
-{0.693750,0.943750,0.050000,0.050000},
-{0.706250,0.943750,0.025000,0.025000},
-{0.706250,0.943750,0.050000,0.050000},
-{0.718750,0.943750,0.025000,0.025000},
-{0.718750,0.943750,0.050000,0.050000},
-{0.731250,0.943750,0.025000,0.025000},
-{0.731250,0.943750,0.050000,0.050000},
-{0.743750,0.943750,0.025000,0.025000},
-{0.743750,0.943750,0.050000,0.050000},
-{0.756250,0.943750,0.025000,0.025000},
-{0.756250,0.943750,0.050000,0.050000},
-{0.768750,0.943750,0.025000,0.025000},
-{0.768750,0.943750,0.050000,0.050000},
-{0.781250,0.943750,0.025000,0.025000},
-{0.781250,0.943750,0.050000,0.050000},
-{0.793750,0.943750,0.025000,0.025000},
-{0.793750,0.943750,0.050000,0.050000},
-{0.806250,0.943750,0.025000,0.025000},
-{0.806250,0.943750,0.050000,0.050000},
-{0.818750,0.943750,0.025000,0.025000},
-{0.818750,0.943750,0.050000,0.050000},
-{0.831250,0.943750,0.025000,0.025000},
-{0.831250,0.943750,0.050000,0.050000},
-{0.843750,0.943750,0.025000,0.025000},
-{0.843750,0.943750,0.050000,0.050000},
-{0.856250,0.943750,0.025000,0.025000},
-{0.856250,0.943750,0.050000,0.050000},
-{0.868750,0.943750,0.025000,0.025000},
-{0.868750,0.943750,0.050000,0.050000},
-{0.881250,0.943750,0.025000,0.025000},
-{0.881250,0.943750,0.050000,0.050000},
-{0.893750,0.943750,0.025000,0.025000},
-{0.893750,0.943750,0.050000,0.050000},
-{0.906250,0.943750,0.025000,0.025000},
-{0.906250,0.943750,0.050000,0.050000},
-{0.918750,0.943750,0.025000,0.025000},
-{0.918750,0.943750,0.050000,0.050000},
-{0.931250,0.943750,0.025000,0.025000},
-{0.931250,0.943750,0.050000,0.050000},
-{0.943750,0.943750,0.025000,0.025000},
-{0.943750,0.943750,0.050000,0.050000},
-{0.956250,0.943750,0.025000,0.025000},
-{0.956250,0.943750,0.050000,0.050000},
-{0.968750,0.943750,0.025000,0.025000},
-{0.968750,0.943750,0.050000,0.050000},
-{0.981250,0.943750,0.025000,0.025000},
-{0.981250,0.943750,0.050000,0.050000},
-{0.993750,0.943750,0.025000,0.025000},
-{0.993750,0.943750,0.050000,0.050000},
-{0.006250,0.956250,0.025000,0.025000},
-{0.006250,0.956250,0.050000,0.050000},
-{0.018750,0.956250,0.025000,0.025000},
-{0.018750,0.956250,0.050000,0.050000},
-{0.031250,0.956250,0.025000,0.025000},
-{0.031250,0.956250,0.050000,0.050000},
-{0.043750,0.956250,0.025000,0.025000},
-{0.043750,0.956250,0.050000,0.050000},
-{0.056250,0.956250,0.025000,0.025000},
-{0.056250,0.956250,0.050000,0.050000},
-{0.068750,0.956250,0.025000,0.025000},
-{0.068750,0.956250,0.050000,0.050000},
-{0.081250,0.956250,0.025000,0.025000},
-{0.081250,0.956250,0.050000,0.050000},
-{0.093750,0.956250,0.025000,0.025000},
-{0.093750,0.956250,0.050000,0.050000},
-{0.106250,0.956250,0.025000,0.025000},
-{0.106250,0.956250,0.050000,0.050000},
-{0.118750,0.956250,0.025000,0.025000},
-{0.118750,0.956250,0.050000,0.050000},
-{0.131250,0.956250,0.025000,0.025000},
-{0.131250,0.956250,0.050000,0.050000},
-{0.143750,0.956250,0.025000,0.025000},
-{0.143750,0.956250,0.050000,0.050000},
-{0.156250,0.956250,0.025000,0.025000},
-{0.156250,0.956250,0.050000,0.050000},
-{0.168750,0.956250,0.025000,0.025000},
-{0.168750,0.956250,0.050000,0.050000},
-{0.181250,0.956250,0.025000,0.025000},
-{0.181250,0.956250,0.050000,0.050000},
-{0.193750,0.956250,0.025000,0.025000},
-{0.193750,0.956250,0.050000,0.050000},
-{0.206250,0.956250,0.025000,0.025000},
-{0.206250,0.956250,0.050000,0.050000},
-{0.218750,0.956250,0.025000,0.025000},
-{0.218750,0.956250,0.050000,0.050000},
-{0.231250,0.956250,0.025000,0.025000},
-{0.231250,0.956250,0.050000,0.050000},
-{0.243750,0.956250,0.025000,0.025000},
-{0.243750,0.956250,0.050000,0.050000},
-{0.256250,0.956250,0.025000,0.025000},
-{0.256250,0.956250,0.050000,0.050000},
-{0.268750,0.956250,0.025000,0.025000},
-{0.268750,0.956250,0.050000,0.050000},
-{0.281250,0.956250,0.025000,0.025000},
-{0.281250,0.956250,0.050000,0.050000},
-{0.293750,0.956250,0.025000,0.025000},
-{0.293750,0.956250,0.050000,0.050000},
-{0.306250,0.956250,0.025000,0.025000},
-{0.306250,0.956250,0.050000,0.050000},
-{0.318750,0.956250,0.025000,0.025000},
-{0.318750,0.956250,0.050000,0.050000},
-{0.331250,0.956250,0.025000,0.025000},
-{0.331250,0.956250,0.050000,0.050000},
-{0.343750,0.956250,0.025000,0.025000},
-{0.343750,0.956250,0.050000,0.050000},
-{0.356250,0.956250,0.025000,0.025000},
-{0.356250,0.956250,0.050000,0.050000},
-{0.368750,0.956250,0.025000,0.025000},
-{0.368750,0.956250,0.050000,0.050000},
-{0.381250,0.956250,0.025000,0.025000},
-{0.381250,0.956250,0.050000,0.050000},
-{0.393750,0.956250,0.025000,0.025000},
-{0.393750,0.956250,0.050000,0.050000},
-{0.406250,0.956250,0.025000,0.025000},
-{0.406250,0.956250,0.050000,0.050000},
-{0.418750,0.956250,0.025000,0.025000},
-{0.418750,0.956250,0.050000,0.050000},
-{0.431250,0.956250,0.025000,0.025000},
-{0.431250,0.956250,0.050000,0.050000},
-{0.443750,0.956250,0.025000,0.025000},
-{0.443750,0.956250,0.050000,0.050000},
-{0.456250,0.956250,0.025000,0.025000},
-{0.456250,0.956250,0.050000,0.050000},
-{0.468750,0.956250,0.025000,0.025000},
-{0.468750,0.956250,0.050000,0.050000},
-{0.481250,0.956250,0.025000,0.025000},
-{0.481250,0.956250,0.050000,0.050000},
-{0.493750,0.956250,0.025000,0.025000},
-{0.493750,0.956250,0.050000,0.050000},
-{0.506250,0.956250,0.025000,0.025000},
-{0.506250,0.956250,0.050000,0.050000},
-{0.518750,0.956250,0.025000,0.025000},
-{0.518750,0.956250,0.050000,0.050000},
-{0.531250,0.956250,0.025000,0.025000},
-{0.531250,0.956250,0.050000,0.050000},
-{0.543750,0.956250,0.025000,0.025000},
-{0.543750,0.956250,0.050000,0.050000},
-{0.556250,0.956250,0.025000,0.025000},
-{0.556250,0.956250,0.050000,0.050000},
-{0.568750,0.956250,0.025000,0.025000},
-{0.568750,0.956250,0.050000,0.050000},
-{0.581250,0.956250,0.025000,0.025000},
-{0.581250,0.956250,0.050000,0.050000},
-{0.593750,0.956250,0.025000,0.025000},
-{0.593750,0.956250,0.050000,0.050000},
-{0.606250,0.956250,0.025000,0.025000},
-{0.606250,0.956250,0.050000,0.050000},
-{0.618750,0.956250,0.025000,0.025000},
-{0.618750,0.956250,0.050000,0.050000},
-{0.631250,0.956250,0.025000,0.025000},
-{0.631250,0.956250,0.050000,0.050000},
-{0.643750,0.956250,0.025000,0.025000},
-{0.643750,0.956250,0.050000,0.050000},
-{0.656250,0.956250,0.025000,0.025000},
-{0.656250,0.956250,0.050000,0.050000},
-{0.668750,0.956250,0.025000,0.025000},
-{0.668750,0.956250,0.050000,0.050000},
-{0.681250,0.956250,0.025000,0.025000},
-{0.681250,0.956250,0.050000,0.050000},
-{0.693750,0.956250,0.025000,0.025000},
-{0.693750,0.956250,0.050000,0.050000},
-{0.706250,0.956250,0.025000,0.025000},
-{0.706250,0.956250,0.050000,0.050000},
-{0.718750,0.956250,0.025000,0.025000},
-{0.718750,0.956250,0.050000,0.050000},
-{0.731250,0.956250,0.025000,0.025000},
-{0.731250,0.956250,0.050000,0.050000},
-{0.743750,0.956250,0.025000,0.025000},
-{0.743750,0.956250,0.050000,0.050000},
-{0.756250,0.956250,0.025000,0.025000},
-{0.756250,0.956250,0.050000,0.050000},
-{0.768750,0.956250,0.025000,0.025000},
-{0.768750,0.956250,0.050000,0.050000},
-{0.781250,0.956250,0.025000,0.025000},
-{0.781250,0.956250,0.050000,0.050000},
-{0.793750,0.956250,0.025000,0.025000},
-{0.793750,0.956250,0.050000,0.050000},
-{0.806250,0.956250,0.025000,0.025000},
-{0.806250,0.956250,0.050000,0.050000},
-{0.818750,0.956250,0.025000,0.025000},
-{0.818750,0.956250,0.050000,0.050000},
-{0.831250,0.956250,0.025000,0.025000},
-{0.831250,0.956250,0.050000,0.050000},
-{0.843750,0.956250,0.025000,0.025000},
-{0.843750,0.956250,0.050000,0.050000},
-{0.856250,0.956250,0.025000,0.025000},
-{0.856250,0.956250,0.050000,0.050000},
-{0.868750,0.956250,0.025000,0.025000},
-{0.868750,0.956250,0.050000,0.050000},
-{0.881250,0.956250,0.025000,0.025000},
-{0.881250,0.956250,0.050000,0.050000},
-{0.893750,0.956250,0.025000,0.025000},
-{0.893750,0.956250,0.050000,0.050000},
-{0.906250,0.956250,0.025000,0.025000},
-{0.906250,0.956250,0.050000,0.050000},
-{0.918750,0.956250,0.025000,0.025000},
-{0.918750,0.956250,0.050000,0.050000},
-{0.931250,0.956250,0.025000,0.025000},
-{0.931250,0.956250,0.050000,0.050000},
-{0.943750,0.956250,0.025000,0.025000},
-{0.943750,0.956250,0.050000,0.050000},
-{0.956250,0.956250,0.025000,0.025000},
-{0.956250,0.956250,0.050000,0.050000},
-{0.968750,0.956250,0.025000,0.025000},
-{0.968750,0.956250,0.050000,0.050000},
-{0.981250,0.956250,0.025000,0.025000},
-{0.981250,0.956250,0.050000,0.050000},
-{0.993750,0.956250,0.025000,0.025000},
-{0.993750,0.956250,0.050000,0.050000},
-{0.006250,0.968750,0.025000,0.025000},
-{0.006250,0.968750,0.050000,0.050000},
-{0.018750,0.968750,0.025000,0.025000},
-{0.018750,0.968750,0.050000,0.050000},
-{0.031250,0.968750,0.025000,0.025000},
-{0.031250,0.968750,0.050000,0.050000},
-{0.043750,0.968750,0.025000,0.025000},
-{0.043750,0.968750,0.050000,0.050000},
-{0.056250,0.968750,0.025000,0.025000},
-{0.056250,0.968750,0.050000,0.050000},
-{0.068750,0.968750,0.025000,0.025000},
-{0.068750,0.968750,0.050000,0.050000},
-{0.081250,0.968750,0.025000,0.025000},
-{0.081250,0.968750,0.050000,0.050000},
-{0.093750,0.968750,0.025000,0.025000},
-{0.093750,0.968750,0.050000,0.050000},
-{0.106250,0.968750,0.025000,0.025000},
-{0.106250,0.968750,0.050000,0.050000},
-{0.118750,0.968750,0.025000,0.025000},
-{0.118750,0.968750,0.050000,0.050000},
-{0.131250,0.968750,0.025000,0.025000},
-{0.131250,0.968750,0.050000,0.050000},
-{0.143750,0.968750,0.025000,0.025000},
-{0.143750,0.968750,0.050000,0.050000},
-{0.156250,0.968750,0.025000,0.025000},
-{0.156250,0.968750,0.050000,0.050000},
-{0.168750,0.968750,0.025000,0.025000},
-{0.168750,0.968750,0.050000,0.050000},
-{0.181250,0.968750,0.025000,0.025000},
-{0.181250,0.968750,0.050000,0.050000},
-{0.193750,0.968750,0.025000,0.025000},
-{0.193750,0.968750,0.050000,0.050000},
-{0.206250,0.968750,0.025000,0.025000},
-{0.206250,0.968750,0.050000,0.050000},
-{0.218750,0.968750,0.025000,0.025000},
-{0.218750,0.968750,0.050000,0.050000},
-{0.231250,0.968750,0.025000,0.025000},
-{0.231250,0.968750,0.050000,0.050000},
-{0.243750,0.968750,0.025000,0.025000},
-{0.243750,0.968750,0.050000,0.050000},
-{0.256250,0.968750,0.025000,0.025000},
-{0.256250,0.968750,0.050000,0.050000},
-{0.268750,0.968750,0.025000,0.025000},
-{0.268750,0.968750,0.050000,0.050000},
-{0.281250,0.968750,0.025000,0.025000},
-{0.281250,0.968750,0.050000,0.050000},
-{0.293750,0.968750,0.025000,0.025000},
-{0.293750,0.968750,0.050000,0.050000},
-{0.306250,0.968750,0.025000,0.025000},
-{0.306250,0.968750,0.050000,0.050000},
-{0.318750,0.968750,0.025000,0.025000},
-{0.318750,0.968750,0.050000,0.050000},
-{0.331250,0.968750,0.025000,0.025000},
-{0.331250,0.968750,0.050000,0.050000},
-{0.343750,0.968750,0.025000,0.025000},
-{0.343750,0.968750,0.050000,0.050000},
-{0.356250,0.968750,0.025000,0.025000},
-{0.356250,0.968750,0.050000,0.050000},
-{0.368750,0.968750,0.025000,0.025000},
-{0.368750,0.968750,0.050000,0.050000},
-{0.381250,0.968750,0.025000,0.025000},
-{0.381250,0.968750,0.050000,0.050000},
-{0.393750,0.968750,0.025000,0.025000},
-{0.393750,0.968750,0.050000,0.050000},
-{0.406250,0.968750,0.025000,0.025000},
-{0.406250,0.968750,0.050000,0.050000},
-{0.418750,0.968750,0.025000,0.025000},
-{0.418750,0.968750,0.050000,0.050000},
-{0.431250,0.968750,0.025000,0.025000},
-{0.431250,0.968750,0.050000,0.050000},
-{0.443750,0.968750,0.025000,0.025000},
-{0.443750,0.968750,0.050000,0.050000},
-{0.456250,0.968750,0.025000,0.025000},
-{0.456250,0.968750,0.050000,0.050000},
-{0.468750,0.968750,0.025000,0.025000},
-{0.468750,0.968750,0.050000,0.050000},
-{0.481250,0.968750,0.025000,0.025000},
-{0.481250,0.968750,0.050000,0.050000},
-{0.493750,0.968750,0.025000,0.025000},
-{0.493750,0.968750,0.050000,0.050000},
-{0.506250,0.968750,0.025000,0.025000},
-{0.506250,0.968750,0.050000,0.050000},
-{0.518750,0.968750,0.025000,0.025000},
-{0.518750,0.968750,0.050000,0.050000},
-{0.531250,0.968750,0.025000,0.025000},
-{0.531250,0.968750,0.050000,0.050000},
-{0.543750,0.968750,0.025000,0.025000},
-{0.543750,0.968750,0.050000,0.050000},
-{0.556250,0.968750,0.025000,0.025000},
-{0.556250,0.968750,0.050000,0.050000},
-{0.568750,0.968750,0.025000,0.025000},
-{0.568750,0.968750,0.050000,0.050000},
-{0.581250,0.968750,0.025000,0.025000},
-{0.581250,0.968750,0.050000,0.050000},
-{0.593750,0.968750,0.025000,0.025000},
-{0.593750,0.968750,0.050000,0.050000},
-{0.606250,0.968750,0.025000,0.025000},
-{0.606250,0.968750,0.050000,0.050000},
-{0.618750,0.968750,0.025000,0.025000},
-{0.618750,0.968750,0.050000,0.050000},
-{0.631250,0.968750,0.025000,0.025000},
-{0.631250,0.968750,0.050000,0.050000},
-{0.643750,0.968750,0.025000,0.025000},
-{0.643750,0.968750,0.050000,0.050000},
-{0.656250,0.968750,0.025000,0.025000},
-{0.656250,0.968750,0.050000,0.050000},
-{0.668750,0.968750,0.025000,0.025000},
-{0.668750,0.968750,0.050000,0.050000},
-{0.681250,0.968750,0.025000,0.025000},
-{0.681250,0.968750,0.050000,0.050000},
-{0.693750,0.968750,0.025000,0.025000},
-{0.693750,0.968750,0.050000,0.050000},
-{0.706250,0.968750,0.025000,0.025000},
-{0.706250,0.968750,0.050000,0.050000},
-{0.718750,0.968750,0.025000,0.025000},
-{0.718750,0.968750,0.050000,0.050000},
-{0.731250,0.968750,0.025000,0.025000},
-{0.731250,0.968750,0.050000,0.050000},
-{0.743750,0.968750,0.025000,0.025000},
-{0.743750,0.968750,0.050000,0.050000},
-{0.756250,0.968750,0.025000,0.025000},
-{0.756250,0.968750,0.050000,0.050000},
-{0.768750,0.968750,0.025000,0.025000},
-{0.768750,0.968750,0.050000,0.050000},
-{0.781250,0.968750,0.025000,0.025000},
-{0.781250,0.968750,0.050000,0.050000},
-{0.793750,0.968750,0.025000,0.025000},
-{0.793750,0.968750,0.050000,0.050000},
-{0.806250,0.968750,0.025000,0.025000},
-{0.806250,0.968750,0.050000,0.050000},
-{0.818750,0.968750,0.025000,0.025000},
-{0.818750,0.968750,0.050000,0.050000},
-{0.831250,0.968750,0.025000,0.025000},
-{0.831250,0.968750,0.050000,0.050000},
-{0.843750,0.968750,0.025000,0.025000},
-{0.843750,0.968750,0.050000,0.050000},
-{0.856250,0.968750,0.025000,0.025000},
-{0.856250,0.968750,0.050000,0.050000},
-{0.868750,0.968750,0.025000,0.025000},
-{0.868750,0.968750,0.050000,0.050000},
-{0.881250,0.968750,0.025000,0.025000},
-{0.881250,0.968750,0.050000,0.050000},
-{0.893750,0.968750,0.025000,0.025000},
-{0.893750,0.968750,0.050000,0.050000},
-{0.906250,0.968750,0.025000,0.025000},
-{0.906250,0.968750,0.050000,0.050000},
-{0.918750,0.968750,0.025000,0.025000},
-{0.918750,0.968750,0.050000,0.050000},
-{0.931250,0.968750,0.025000,0.025000},
-{0.931250,0.968750,0.050000,0.050000},
-{0.943750,0.968750,0.025000,0.025000},
-{0.943750,0.968750,0.050000,0.050000},
-{0.956250,0.968750,0.025000,0.025000},
-{0.956250,0.968750,0.050000,0.050000},
-{0.968750,0.968750,0.025000,0.025000},
-{0.968750,0.968750,0.050000,0.050000},
-{0.981250,0.968750,0.025000,0.025000},
-{0.981250,0.968750,0.050000,0.050000},
-{0.993750,0.968750,0.025000,0.025000},
-{0.993750,0.968750,0.050000,0.050000},
-{0.006250,0.981250,0.025000,0.025000},
-{0.006250,0.981250,0.050000,0.050000},
-{0.018750,0.981250,0.025000,0.025000},
-{0.018750,0.981250,0.050000,0.050000},
-{0.031250,0.981250,0.025000,0.025000},
-{0.031250,0.981250,0.050000,0.050000},
-{0.043750,0.981250,0.025000,0.025000},
-{0.043750,0.981250,0.050000,0.050000},
-{0.056250,0.981250,0.025000,0.025000},
-{0.056250,0.981250,0.050000,0.050000},
-{0.068750,0.981250,0.025000,0.025000},
-{0.068750,0.981250,0.050000,0.050000},
-{0.081250,0.981250,0.025000,0.025000},
-{0.081250,0.981250,0.050000,0.050000},
-{0.093750,0.981250,0.025000,0.025000},
-{0.093750,0.981250,0.050000,0.050000},
-{0.106250,0.981250,0.025000,0.025000},
-{0.106250,0.981250,0.050000,0.050000},
-{0.118750,0.981250,0.025000,0.025000},
-{0.118750,0.981250,0.050000,0.050000},
-{0.131250,0.981250,0.025000,0.025000},
-{0.131250,0.981250,0.050000,0.050000},
-{0.143750,0.981250,0.025000,0.025000},
-{0.143750,0.981250,0.050000,0.050000},
-{0.156250,0.981250,0.025000,0.025000},
-{0.156250,0.981250,0.050000,0.050000},
-{0.168750,0.981250,0.025000,0.025000},
-{0.168750,0.981250,0.050000,0.050000},
-{0.181250,0.981250,0.025000,0.025000},
-{0.181250,0.981250,0.050000,0.050000},
-{0.193750,0.981250,0.025000,0.025000},
-{0.193750,0.981250,0.050000,0.050000},
-{0.206250,0.981250,0.025000,0.025000},
-{0.206250,0.981250,0.050000,0.050000},
-{0.218750,0.981250,0.025000,0.025000},
-{0.218750,0.981250,0.050000,0.050000},
-{0.231250,0.981250,0.025000,0.025000},
-{0.231250,0.981250,0.050000,0.050000},
-{0.243750,0.981250,0.025000,0.025000},
-{0.243750,0.981250,0.050000,0.050000},
-{0.256250,0.981250,0.025000,0.025000},
-{0.256250,0.981250,0.050000,0.050000},
-{0.268750,0.981250,0.025000,0.025000},
-{0.268750,0.981250,0.050000,0.050000},
-{0.281250,0.981250,0.025000,0.025000},
-{0.281250,0.981250,0.050000,0.050000},
-{0.293750,0.981250,0.025000,0.025000},
-{0.293750,0.981250,0.050000,0.050000},
-{0.306250,0.981250,0.025000,0.025000},
-{0.306250,0.981250,0.050000,0.050000},
-{0.318750,0.981250,0.025000,0.025000},
-{0.318750,0.981250,0.050000,0.050000},
-{0.331250,0.981250,0.025000,0.025000},
-{0.331250,0.981250,0.050000,0.050000},
-{0.343750,0.981250,0.025000,0.025000},
-{0.343750,0.981250,0.050000,0.050000},
-{0.356250,0.981250,0.025000,0.025000},
-{0.356250,0.981250,0.050000,0.050000},
-{0.368750,0.981250,0.025000,0.025000},
-{0.368750,0.981250,0.050000,0.050000},
-{0.381250,0.981250,0.025000,0.025000},
-{0.381250,0.981250,0.050000,0.050000},
-{0.393750,0.981250,0.025000,0.025000},
-{0.393750,0.981250,0.050000,0.050000},
-{0.406250,0.981250,0.025000,0.025000},
-{0.406250,0.981250,0.050000,0.050000},
-{0.418750,0.981250,0.025000,0.025000},
-{0.418750,0.981250,0.050000,0.050000},
-{0.431250,0.981250,0.025000,0.025000},
-{0.431250,0.981250,0.050000,0.050000},
-{0.443750,0.981250,0.025000,0.025000},
-{0.443750,0.981250,0.050000,0.050000},
-{0.456250,0.981250,0.025000,0.025000},
-{0.456250,0.981250,0.050000,0.050000},
-{0.468750,0.981250,0.025000,0.025000},
-{0.468750,0.981250,0.050000,0.050000},
-{0.481250,0.981250,0.025000,0.025000},
-{0.481250,0.981250,0.050000,0.050000},
-{0.493750,0.981250,0.025000,0.025000},
-{0.493750,0.981250,0.050000,0.050000},
-{0.506250,0.981250,0.025000,0.025000},
-{0.506250,0.981250,0.050000,0.050000},
-{0.518750,0.981250,0.025000,0.025000},
-{0.518750,0.981250,0.050000,0.050000},
-{0.531250,0.981250,0.025000,0.025000},
-{0.531250,0.981250,0.050000,0.050000},
-{0.543750,0.981250,0.025000,0.025000},
-{0.543750,0.981250,0.050000,0.050000},
-{0.556250,0.981250,0.025000,0.025000},
-{0.556250,0.981250,0.050000,0.050000},
-{0.568750,0.981250,0.025000,0.025000},
-{0.568750,0.981250,0.050000,0.050000},
-{0.581250,0.981250,0.025000,0.025000},
-{0.581250,0.981250,0.050000,0.050000},
-{0.593750,0.981250,0.025000,0.025000},
-{0.593750,0.981250,0.050000,0.050000},
-{0.606250,0.981250,0.025000,0.025000},
-{0.606250,0.981250,0.050000,0.050000},
-{0.618750,0.981250,0.025000,0.025000},
-{0.618750,0.981250,0.050000,0.050000},
-{0.631250,0.981250,0.025000,0.025000},
-{0.631250,0.981250,0.050000,0.050000},
-{0.643750,0.981250,0.025000,0.025000},
-{0.643750,0.981250,0.050000,0.050000},
-{0.656250,0.981250,0.025000,0.025000},
-{0.656250,0.981250,0.050000,0.050000},
-{0.668750,0.981250,0.025000,0.025000},
-{0.668750,0.981250,0.050000,0.050000},
-{0.681250,0.981250,0.025000,0.025000},
-{0.681250,0.981250,0.050000,0.050000},
-{0.693750,0.981250,0.025000,0.025000},
-{0.693750,0.981250,0.050000,0.050000},
-{0.706250,0.981250,0.025000,0.025000},
-{0.706250,0.981250,0.050000,0.050000},
-{0.718750,0.981250,0.025000,0.025000},
-{0.718750,0.981250,0.050000,0.050000},
-{0.731250,0.981250,0.025000,0.025000},
-{0.731250,0.981250,0.050000,0.050000},
-{0.743750,0.981250,0.025000,0.025000},
-{0.743750,0.981250,0.050000,0.050000},
-{0.756250,0.981250,0.025000,0.025000},
-{0.756250,0.981250,0.050000,0.050000},
-{0.768750,0.981250,0.025000,0.025000},
-{0.768750,0.981250,0.050000,0.050000},
-{0.781250,0.981250,0.025000,0.025000},
-{0.781250,0.981250,0.050000,0.050000},
-{0.793750,0.981250,0.025000,0.025000},
-{0.793750,0.981250,0.050000,0.050000},
-{0.806250,0.981250,0.025000,0.025000},
-{0.806250,0.981250,0.050000,0.050000},
-{0.818750,0.981250,0.025000,0.025000},
-{0.818750,0.981250,0.050000,0.050000},
-{0.831250,0.981250,0.025000,0.025000},
-{0.831250,0.981250,0.050000,0.050000},
-{0.843750,0.981250,0.025000,0.025000},
-{0.843750,0.981250,0.050000,0.050000},
-{0.856250,0.981250,0.025000,0.025000},
-{0.856250,0.981250,0.050000,0.050000},
-{0.868750,0.981250,0.025000,0.025000},
-{0.868750,0.981250,0.050000,0.050000},
-{0.881250,0.981250,0.025000,0.025000},
-{0.881250,0.981250,0.050000,0.050000},
-{0.893750,0.981250,0.025000,0.025000},
-{0.893750,0.981250,0.050000,0.050000},
-{0.906250,0.981250,0.025000,0.025000},
-{0.906250,0.981250,0.050000,0.050000},
-{0.918750,0.981250,0.025000,0.025000},
-{0.918750,0.981250,0.050000,0.050000},
-{0.931250,0.981250,0.025000,0.025000},
-{0.931250,0.981250,0.050000,0.050000},
-{0.943750,0.981250,0.025000,0.025000},
-{0.943750,0.981250,0.050000,0.050000},
-{0.956250,0.981250,0.025000,0.025000},
-{0.956250,0.981250,0.050000,0.050000},
-{0.968750,0.981250,0.025000,0.025000},
-{0.968750,0.981250,0.050000,0.050000},
-{0.981250,0.981250,0.025000,0.025000},
-{0.981250,0.981250,0.050000,0.050000},
-{0.993750,0.981250,0.025000,0.025000},
-{0.993750,0.981250,0.050000,0.050000},
-{0.006250,0.993750,0.025000,0.025000},
-{0.006250,0.993750,0.050000,0.050000},
-{0.018750,0.993750,0.025000,0.025000},
-{0.018750,0.993750,0.050000,0.050000},
-{0.031250,0.993750,0.025000,0.025000},
-{0.031250,0.993750,0.050000,0.050000},
-{0.043750,0.993750,0.025000,0.025000},
-{0.043750,0.993750,0.050000,0.050000},
-{0.056250,0.993750,0.025000,0.025000},
-{0.056250,0.993750,0.050000,0.050000},
-{0.068750,0.993750,0.025000,0.025000},
-{0.068750,0.993750,0.050000,0.050000},
-{0.081250,0.993750,0.025000,0.025000},
-{0.081250,0.993750,0.050000,0.050000},
-{0.093750,0.993750,0.025000,0.025000},
-{0.093750,0.993750,0.050000,0.050000},
-{0.106250,0.993750,0.025000,0.025000},
-{0.106250,0.993750,0.050000,0.050000},
-{0.118750,0.993750,0.025000,0.025000},
-{0.118750,0.993750,0.050000,0.050000},
-{0.131250,0.993750,0.025000,0.025000},
-{0.131250,0.993750,0.050000,0.050000},
-{0.143750,0.993750,0.025000,0.025000},
-{0.143750,0.993750,0.050000,0.050000},
-{0.156250,0.993750,0.025000,0.025000},
-{0.156250,0.993750,0.050000,0.050000},
-{0.168750,0.993750,0.025000,0.025000},
-{0.168750,0.993750,0.050000,0.050000},
-{0.181250,0.993750,0.025000,0.025000},
-{0.181250,0.993750,0.050000,0.050000},
-{0.193750,0.993750,0.025000,0.025000},
-{0.193750,0.993750,0.050000,0.050000},
-{0.206250,0.993750,0.025000,0.025000},
-{0.206250,0.993750,0.050000,0.050000},
-{0.218750,0.993750,0.025000,0.025000},
-{0.218750,0.993750,0.050000,0.050000},
-{0.231250,0.993750,0.025000,0.025000},
-{0.231250,0.993750,0.050000,0.050000},
-{0.243750,0.993750,0.025000,0.025000},
-{0.243750,0.993750,0.050000,0.050000},
-{0.256250,0.993750,0.025000,0.025000},
-{0.256250,0.993750,0.050000,0.050000},
-{0.268750,0.993750,0.025000,0.025000},
-{0.268750,0.993750,0.050000,0.050000},
-{0.281250,0.993750,0.025000,0.025000},
-{0.281250,0.993750,0.050000,0.050000},
-{0.293750,0.993750,0.025000,0.025000},
-{0.293750,0.993750,0.050000,0.050000},
-{0.306250,0.993750,0.025000,0.025000},
-{0.306250,0.993750,0.050000,0.050000},
-{0.318750,0.993750,0.025000,0.025000},
-{0.318750,0.993750,0.050000,0.050000},
-{0.331250,0.993750,0.025000,0.025000},
-{0.331250,0.993750,0.050000,0.050000},
-{0.343750,0.993750,0.025000,0.025000},
-{0.343750,0.993750,0.050000,0.050000},
-{0.356250,0.993750,0.025000,0.025000},
-{0.356250,0.993750,0.050000,0.050000},
-{0.368750,0.993750,0.025000,0.025000},
-{0.368750,0.993750,0.050000,0.050000},
-{0.381250,0.993750,0.025000,0.025000},
-{0.381250,0.993750,0.050000,0.050000},
-{0.393750,0.993750,0.025000,0.025000},
-{0.393750,0.993750,0.050000,0.050000},
-{0.406250,0.993750,0.025000,0.025000},
-{0.406250,0.993750,0.050000,0.050000},
-{0.418750,0.993750,0.025000,0.025000},
-{0.418750,0.993750,0.050000,0.050000},
-{0.431250,0.993750,0.025000,0.025000},
-{0.431250,0.993750,0.050000,0.050000},
-{0.443750,0.993750,0.025000,0.025000},
-{0.443750,0.993750,0.050000,0.050000},
-{0.456250,0.993750,0.025000,0.025000},
-{0.456250,0.993750,0.050000,0.050000},
-{0.468750,0.993750,0.025000,0.025000},
-{0.468750,0.993750,0.050000,0.050000},
-{0.481250,0.993750,0.025000,0.025000},
-{0.481250,0.993750,0.050000,0.050000},
-{0.493750,0.993750,0.025000,0.025000},
-{0.493750,0.993750,0.050000,0.050000},
-{0.506250,0.993750,0.025000,0.025000},
-{0.506250,0.993750,0.050000,0.050000},
-{0.518750,0.993750,0.025000,0.025000},
-{0.518750,0.993750,0.050000,0.050000},
-{0.531250,0.993750,0.025000,0.025000},
-{0.531250,0.993750,0.050000,0.050000},
-{0.543750,0.993750,0.025000,0.025000},
-{0.543750,0.993750,0.050000,0.050000},
-{0.556250,0.993750,0.025000,0.025000},
-{0.556250,0.993750,0.050000,0.050000},
-{0.568750,0.993750,0.025000,0.025000},
-{0.568750,0.993750,0.050000,0.050000},
-{0.581250,0.993750,0.025000,0.025000},
-{0.581250,0.993750,0.050000,0.050000},
-{0.593750,0.993750,0.025000,0.025000},
-{0.593750,0.993750,0.050000,0.050000},
-{0.606250,0.993750,0.025000,0.025000},
-{0.606250,0.993750,0.050000,0.050000},
-{0.618750,0.993750,0.025000,0.025000},
-{0.618750,0.993750,0.050000,0.050000},
-{0.631250,0.993750,0.025000,0.025000},
-{0.631250,0.993750,0.050000,0.050000},
-{0.643750,0.993750,0.025000,0.025000},
-{0.643750,0.993750,0.050000,0.050000},
-{0.656250,0.993750,0.025000,0.025000},
-{0.656250,0.993750,0.050000,0.050000},
-{0.668750,0.993750,0.025000,0.025000},
-{0.668750,0.993750,0.050000,0.050000},
-{0.681250,0.993750,0.025000,0.025000},
-{0.681250,0.993750,0.050000,0.050000},
-{0.693750,0.993750,0.025000,0.025000},
-{0.693750,0.993750,0.050000,0.050000},
-{0.706250,0.993750,0.025000,0.025000},
-{0.706250,0.993750,0.050000,0.050000},
-{0.718750,0.993750,0.025000,0.025000},
-{0.718750,0.993750,0.050000,0.050000},
-{0.731250,0.993750,0.025000,0.025000},
-{0.731250,0.993750,0.050000,0.050000},
-{0.743750,0.993750,0.025000,0.025000},
-{0.743750,0.993750,0.050000,0.050000},
-{0.756250,0.993750,0.025000,0.025000},
-{0.756250,0.993750,0.050000,0.050000},
-{0.768750,0.993750,0.025000,0.025000},
-{0.768750,0.993750,0.050000,0.050000},
-{0.781250,0.993750,0.025000,0.025000},
-{0.781250,0.993750,0.050000,0.050000},
-{0.793750,0.993750,0.025000,0.025000},
-{0.793750,0.993750,0.050000,0.050000},
-{0.806250,0.993750,0.025000,0.025000},
-{0.806250,0.993750,0.050000,0.050000},
-{0.818750,0.993750,0.025000,0.025000},
-{0.818750,0.993750,0.050000,0.050000},
-{0.831250,0.993750,0.025000,0.025000},
-{0.831250,0.993750,0.050000,0.050000},
-{0.843750,0.993750,0.025000,0.025000},
-{0.843750,0.993750,0.050000,0.050000},
-{0.856250,0.993750,0.025000,0.025000},
-{0.856250,0.993750,0.050000,0.050000},
-{0.868750,0.993750,0.025000,0.025000},
-{0.868750,0.993750,0.050000,0.050000},
-{0.881250,0.993750,0.025000,0.025000},
-{0.881250,0.993750,0.050000,0.050000},
-{0.893750,0.993750,0.025000,0.025000},
-{0.893750,0.993750,0.050000,0.050000},
-{0.906250,0.993750,0.025000,0.025000},
-{0.906250,0.993750,0.050000,0.050000},
-{0.918750,0.993750,0.025000,0.025000},
-{0.918750,0.993750,0.050000,0.050000},
-{0.931250,0.993750,0.025000,0.025000},
-{0.931250,0.993750,0.050000,0.050000},
-{0.943750,0.993750,0.025000,0.025000},
-{0.943750,0.993750,0.050000,0.050000},
-{0.956250,0.993750,0.025000,0.025000},
-{0.956250,0.993750,0.050000,0.050000},
-{0.968750,0.993750,0.025000,0.025000},
-{0.968750,0.993750,0.050000,0.050000},
-{0.981250,0.993750,0.025000,0.025000},
-{0.981250,0.993750,0.050000,0.050000},
-{0.993750,0.993750,0.025000,0.025000},
-{0.993750,0.993750,0.050000,0.050000},
-{0.012500,0.012500,0.100000,0.100000},
-{0.012500,0.012500,0.200000,0.200000},
-{0.037500,0.012500,0.100000,0.100000},
-{0.037500,0.012500,0.200000,0.200000},
-{0.062500,0.012500,0.100000,0.100000},
-{0.062500,0.012500,0.200000,0.200000},
-{0.087500,0.012500,0.100000,0.100000},
-{0.087500,0.012500,0.200000,0.200000},
-{0.112500,0.012500,0.100000,0.100000},
-{0.112500,0.012500,0.200000,0.200000},
-{0.137500,0.012500,0.100000,0.100000},
-{0.137500,0.012500,0.200000,0.200000},
-{0.162500,0.012500,0.100000,0.100000},
-{0.162500,0.012500,0.200000,0.200000},
-{0.187500,0.012500,0.100000,0.100000},
-{0.187500,0.012500,0.200000,0.200000},
-{0.212500,0.012500,0.100000,0.100000},
-{0.212500,0.012500,0.200000,0.200000},
-{0.237500,0.012500,0.100000,0.100000},
-{0.237500,0.012500,0.200000,0.200000},
-{0.262500,0.012500,0.100000,0.100000},
-{0.262500,0.012500,0.200000,0.200000},
-{0.287500,0.012500,0.100000,0.100000},
-{0.287500,0.012500,0.200000,0.200000},
-{0.312500,0.012500,0.100000,0.100000},
-{0.312500,0.012500,0.200000,0.200000},
-{0.337500,0.012500,0.100000,0.100000},
-{0.337500,0.012500,0.200000,0.200000},
-{0.362500,0.012500,0.100000,0.100000},
-{0.362500,0.012500,0.200000,0.200000},
-{0.387500,0.012500,0.100000,0.100000},
-{0.387500,0.012500,0.200000,0.200000},
-{0.412500,0.012500,0.100000,0.100000},
-{0.412500,0.012500,0.200000,0.200000},
-{0.437500,0.012500,0.100000,0.100000},
-{0.437500,0.012500,0.200000,0.200000},
-{0.462500,0.012500,0.100000,0.100000},
-{0.462500,0.012500,0.200000,0.200000},
-{0.487500,0.012500,0.100000,0.100000},
-{0.487500,0.012500,0.200000,0.200000},
-{0.512500,0.012500,0.100000,0.100000},
-{0.512500,0.012500,0.200000,0.200000},
-{0.537500,0.012500,0.100000,0.100000},
-{0.537500,0.012500,0.200000,0.200000},
-{0.562500,0.012500,0.100000,0.100000},
-{0.562500,0.012500,0.200000,0.200000},
-{0.587500,0.012500,0.100000,0.100000},
-{0.587500,0.012500,0.200000,0.200000},
-{0.612500,0.012500,0.100000,0.100000},
-{0.612500,0.012500,0.200000,0.200000},
-{0.637500,0.012500,0.100000,0.100000},
-{0.637500,0.012500,0.200000,0.200000},
-{0.662500,0.012500,0.100000,0.100000},
-{0.662500,0.012500,0.200000,0.200000},
-{0.687500,0.012500,0.100000,0.100000},
-{0.687500,0.012500,0.200000,0.200000},
-{0.712500,0.012500,0.100000,0.100000},
-{0.712500,0.012500,0.200000,0.200000},
-{0.737500,0.012500,0.100000,0.100000},
-{0.737500,0.012500,0.200000,0.200000},
-{0.762500,0.012500,0.100000,0.100000},
-{0.762500,0.012500,0.200000,0.200000},
-{0.787500,0.012500,0.100000,0.100000},
-{0.787500,0.012500,0.200000,0.200000},
-{0.812500,0.012500,0.100000,0.100000},
-{0.812500,0.012500,0.200000,0.200000},
-{0.837500,0.012500,0.100000,0.100000},
-{0.837500,0.012500,0.200000,0.200000},
-{0.862500,0.012500,0.100000,0.100000},
-{0.862500,0.012500,0.200000,0.200000},
-{0.887500,0.012500,0.100000,0.100000},
-{0.887500,0.012500,0.200000,0.200000},
-{0.912500,0.012500,0.100000,0.100000},
-{0.912500,0.012500,0.200000,0.200000},
-{0.937500,0.012500,0.100000,0.100000},
-{0.937500,0.012500,0.200000,0.200000},
-{0.962500,0.012500,0.100000,0.100000},
-{0.962500,0.012500,0.200000,0.200000},
-{0.987500,0.012500,0.100000,0.100000},
-{0.987500,0.012500,0.200000,0.200000},
-{0.012500,0.037500,0.100000,0.100000},
-{0.012500,0.037500,0.200000,0.200000},
-{0.037500,0.037500,0.100000,0.100000},
-{0.037500,0.037500,0.200000,0.200000},
-{0.062500,0.037500,0.100000,0.100000},
-{0.062500,0.037500,0.200000,0.200000},
-{0.087500,0.037500,0.100000,0.100000},
-{0.087500,0.037500,0.200000,0.200000},
-{0.112500,0.037500,0.100000,0.100000},
-{0.112500,0.037500,0.200000,0.200000},
-{0.137500,0.037500,0.100000,0.100000},
-{0.137500,0.037500,0.200000,0.200000},
-{0.162500,0.037500,0.100000,0.100000},
-{0.162500,0.037500,0.200000,0.200000},
-{0.187500,0.037500,0.100000,0.100000},
-{0.187500,0.037500,0.200000,0.200000},
-{0.212500,0.037500,0.100000,0.100000},
-{0.212500,0.037500,0.200000,0.200000},
-{0.237500,0.037500,0.100000,0.100000},
-{0.237500,0.037500,0.200000,0.200000},
-{0.262500,0.037500,0.100000,0.100000},
-{0.262500,0.037500,0.200000,0.200000},
-{0.287500,0.037500,0.100000,0.100000},
-{0.287500,0.037500,0.200000,0.200000},
-{0.312500,0.037500,0.100000,0.100000},
-{0.312500,0.037500,0.200000,0.200000},
-{0.337500,0.037500,0.100000,0.100000},
-{0.337500,0.037500,0.200000,0.200000},
-{0.362500,0.037500,0.100000,0.100000},
-{0.362500,0.037500,0.200000,0.200000},
-{0.387500,0.037500,0.100000,0.100000},
-{0.387500,0.037500,0.200000,0.200000},
-{0.412500,0.037500,0.100000,0.100000},
-{0.412500,0.037500,0.200000,0.200000},
-{0.437500,0.037500,0.100000,0.100000},
-{0.437500,0.037500,0.200000,0.200000},
-{0.462500,0.037500,0.100000,0.100000},
-{0.462500,0.037500,0.200000,0.200000},
-{0.487500,0.037500,0.100000,0.100000},
-{0.487500,0.037500,0.200000,0.200000},
-{0.512500,0.037500,0.100000,0.100000},
-{0.512500,0.037500,0.200000,0.200000},
-{0.537500,0.037500,0.100000,0.100000},
-{0.537500,0.037500,0.200000,0.200000},
-{0.562500,0.037500,0.100000,0.100000},
-{0.562500,0.037500,0.200000,0.200000},
-{0.587500,0.037500,0.100000,0.100000},
-{0.587500,0.037500,0.200000,0.200000},
-{0.612500,0.037500,0.100000,0.100000},
-{0.612500,0.037500,0.200000,0.200000},
-{0.637500,0.037500,0.100000,0.100000},
-{0.637500,0.037500,0.200000,0.200000},
-{0.662500,0.037500,0.100000,0.100000},
-{0.662500,0.037500,0.200000,0.200000},
-{0.687500,0.037500,0.100000,0.100000},
-{0.687500,0.037500,0.200000,0.200000},
-{0.712500,0.037500,0.100000,0.100000},
-{0.712500,0.037500,0.200000,0.200000},
-{0.737500,0.037500,0.100000,0.100000},
-{0.737500,0.037500,0.200000,0.200000},
-{0.762500,0.037500,0.100000,0.100000},
-{0.762500,0.037500,0.200000,0.200000},
-{0.787500,0.037500,0.100000,0.100000},
-{0.787500,0.037500,0.200000,0.200000},
-{0.812500,0.037500,0.100000,0.100000},
-{0.812500,0.037500,0.200000,0.200000},
-{0.837500,0.037500,0.100000,0.100000},
-{0.837500,0.037500,0.200000,0.200000},
-{0.862500,0.037500,0.100000,0.100000},
-{0.862500,0.037500,0.200000,0.200000},
-{0.887500,0.037500,0.100000,0.100000},
-{0.887500,0.037500,0.200000,0.200000},
-{0.912500,0.037500,0.100000,0.100000},
-{0.912500,0.037500,0.200000,0.200000},
-{0.937500,0.037500,0.100000,0.100000},
-{0.937500,0.037500,0.200000,0.200000},
-{0.962500,0.037500,0.100000,0.100000},
-{0.962500,0.037500,0.200000,0.200000},
-{0.987500,0.037500,0.100000,0.100000},
-{0.987500,0.037500,0.200000,0.200000},
-{0.012500,0.062500,0.100000,0.100000},
-{0.012500,0.062500,0.200000,0.200000},
-{0.037500,0.062500,0.100000,0.100000},
-{0.037500,0.062500,0.200000,0.200000},
-{0.062500,0.062500,0.100000,0.100000},
-{0.062500,0.062500,0.200000,0.200000},
-{0.087500,0.062500,0.100000,0.100000},
-{0.087500,0.062500,0.200000,0.200000},
-{0.112500,0.062500,0.100000,0.100000},
-{0.112500,0.062500,0.200000,0.200000},
-{0.137500,0.062500,0.100000,0.100000},
-{0.137500,0.062500,0.200000,0.200000},
-{0.162500,0.062500,0.100000,0.100000},
-{0.162500,0.062500,0.200000,0.200000},
-{0.187500,0.062500,0.100000,0.100000},
-{0.187500,0.062500,0.200000,0.200000},
-{0.212500,0.062500,0.100000,0.100000},
-{0.212500,0.062500,0.200000,0.200000},
-{0.237500,0.062500,0.100000,0.100000},
-{0.237500,0.062500,0.200000,0.200000},
-{0.262500,0.062500,0.100000,0.100000},
-{0.262500,0.062500,0.200000,0.200000},
-{0.287500,0.062500,0.100000,0.100000},
-{0.287500,0.062500,0.200000,0.200000},
-{0.312500,0.062500,0.100000,0.100000},
-{0.312500,0.062500,0.200000,0.200000},
-{0.337500,0.062500,0.100000,0.100000},
-{0.337500,0.062500,0.200000,0.200000},
-{0.362500,0.062500,0.100000,0.100000},
-{0.362500,0.062500,0.200000,0.200000},
-{0.387500,0.062500,0.100000,0.100000},
-{0.387500,0.062500,0.200000,0.200000},
-{0.412500,0.062500,0.100000,0.100000},
-{0.412500,0.062500,0.200000,0.200000},
-{0.437500,0.062500,0.100000,0.100000},
-{0.437500,0.062500,0.200000,0.200000},
-{0.462500,0.062500,0.100000,0.100000},
-{0.462500,0.062500,0.200000,0.200000},
-{0.487500,0.062500,0.100000,0.100000},
-{0.487500,0.062500,0.200000,0.200000},
-{0.512500,0.062500,0.100000,0.100000},
-{0.512500,0.062500,0.200000,0.200000},
-{0.537500,0.062500,0.100000,0.100000},
-{0.537500,0.062500,0.200000,0.200000},
-{0.562500,0.062500,0.100000,0.100000},
-{0.562500,0.062500,0.200000,0.200000},
-{0.587500,0.062500,0.100000,0.100000},
-{0.587500,0.062500,0.200000,0.200000},
-{0.612500,0.062500,0.100000,0.100000},
-{0.612500,0.062500,0.200000,0.200000},
-{0.637500,0.062500,0.100000,0.100000},
-{0.637500,0.062500,0.200000,0.200000},
-{0.662500,0.062500,0.100000,0.100000},
-{0.662500,0.062500,0.200000,0.200000},
-{0.687500,0.062500,0.100000,0.100000},
-{0.687500,0.062500,0.200000,0.200000},
-{0.712500,0.062500,0.100000,0.100000},
-{0.712500,0.062500,0.200000,0.200000},
-{0.737500,0.062500,0.100000,0.100000},
-{0.737500,0.062500,0.200000,0.200000},
-{0.762500,0.062500,0.100000,0.100000},
-{0.762500,0.062500,0.200000,0.200000},
-{0.787500,0.062500,0.100000,0.100000},
-{0.787500,0.062500,0.200000,0.200000},
-{0.812500,0.062500,0.100000,0.100000},
-{0.812500,0.062500,0.200000,0.200000},
-{0.837500,0.062500,0.100000,0.100000},
-{0.837500,0.062500,0.200000,0.200000},
-{0.862500,0.062500,0.100000,0.100000},
-{0.862500,0.062500,0.200000,0.200000},
-{0.887500,0.062500,0.100000,0.100000},
-{0.887500,0.062500,0.200000,0.200000},
-{0.912500,0.062500,0.100000,0.100000},
-{0.912500,0.062500,0.200000,0.200000},
-{0.937500,0.062500,0.100000,0.100000},
-{0.937500,0.062500,0.200000,0.200000},
-{0.962500,0.062500,0.100000,0.100000},
-{0.962500,0.062500,0.200000,0.200000},
-{0.987500,0.062500,0.100000,0.100000},
-{0.987500,0.062500,0.200000,0.200000},
-{0.012500,0.087500,0.100000,0.100000},
-{0.012500,0.087500,0.200000,0.200000},
-{0.037500,0.087500,0.100000,0.100000},
-{0.037500,0.087500,0.200000,0.200000},
-{0.062500,0.087500,0.100000,0.100000},
-{0.062500,0.087500,0.200000,0.200000},
-{0.087500,0.087500,0.100000,0.100000},
-{0.087500,0.087500,0.200000,0.200000},
-{0.112500,0.087500,0.100000,0.100000},
-{0.112500,0.087500,0.200000,0.200000},
-{0.137500,0.087500,0.100000,0.100000},
-{0.137500,0.087500,0.200000,0.200000},
-{0.162500,0.087500,0.100000,0.100000},
-{0.162500,0.087500,0.200000,0.200000},
-{0.187500,0.087500,0.100000,0.100000},
-{0.187500,0.087500,0.200000,0.200000},
-{0.212500,0.087500,0.100000,0.100000},
-{0.212500,0.087500,0.200000,0.200000},
-{0.237500,0.087500,0.100000,0.100000},
-{0.237500,0.087500,0.200000,0.200000},
-{0.262500,0.087500,0.100000,0.100000},
-{0.262500,0.087500,0.200000,0.200000},
-{0.287500,0.087500,0.100000,0.100000},
-{0.287500,0.087500,0.200000,0.200000},
-{0.312500,0.087500,0.100000,0.100000},
-{0.312500,0.087500,0.200000,0.200000},
-{0.337500,0.087500,0.100000,0.100000},
-{0.337500,0.087500,0.200000,0.200000},
-{0.362500,0.087500,0.100000,0.100000},
-{0.362500,0.087500,0.200000,0.200000},
-{0.387500,0.087500,0.100000,0.100000},
-{0.387500,0.087500,0.200000,0.200000},
-{0.412500,0.087500,0.100000,0.100000},
-{0.412500,0.087500,0.200000,0.200000},
-{0.437500,0.087500,0.100000,0.100000},
-{0.437500,0.087500,0.200000,0.200000},
-{0.462500,0.087500,0.100000,0.100000},
-{0.462500,0.087500,0.200000,0.200000},
-{0.487500,0.087500,0.100000,0.100000},
-{0.487500,0.087500,0.200000,0.200000},
-{0.512500,0.087500,0.100000,0.100000},
-{0.512500,0.087500,0.200000,0.200000},
-{0.537500,0.087500,0.100000,0.100000},
-{0.537500,0.087500,0.200000,0.200000},
-{0.562500,0.087500,0.100000,0.100000},
-{0.562500,0.087500,0.200000,0.200000},
-{0.587500,0.087500,0.100000,0.100000},
-{0.587500,0.087500,0.200000,0.200000},
-{0.612500,0.087500,0.100000,0.100000},
-{0.612500,0.087500,0.200000,0.200000},
-{0.637500,0.087500,0.100000,0.100000},
-{0.637500,0.087500,0.200000,0.200000},
-{0.662500,0.087500,0.100000,0.100000},
-{0.662500,0.087500,0.200000,0.200000},
-{0.687500,0.087500,0.100000,0.100000},
-{0.687500,0.087500,0.200000,0.200000},
-{0.712500,0.087500,0.100000,0.100000},
-{0.712500,0.087500,0.200000,0.200000},
-{0.737500,0.087500,0.100000,0.100000},
-{0.737500,0.087500,0.200000,0.200000},
-{0.762500,0.087500,0.100000,0.100000},
-{0.762500,0.087500,0.200000,0.200000},
-{0.787500,0.087500,0.100000,0.100000},
-{0.787500,0.087500,0.200000,0.200000},
-{0.812500,0.087500,0.100000,0.100000},
-{0.812500,0.087500,0.200000,0.200000},
-{0.837500,0.087500,0.100000,0.100000},
-{0.837500,0.087500,0.200000,0.200000},
-{0.862500,0.087500,0.100000,0.100000},
-{0.862500,0.087500,0.200000,0.200000},
-{0.887500,0.087500,0.100000,0.100000},
-{0.887500,0.087500,0.200000,0.200000},
-{0.912500,0.087500,0.100000,0.100000},
-{0.912500,0.087500,0.200000,0.200000},
-{0.937500,0.087500,0.100000,0.100000},
-{0.937500,0.087500,0.200000,0.200000},
-{0.962500,0.087500,0.100000,0.100000},
-{0.962500,0.087500,0.200000,0.200000},
-{0.987500,0.087500,0.100000,0.100000},
-{0.987500,0.087500,0.200000,0.200000},
-{0.012500,0.112500,0.100000,0.100000},
-{0.012500,0.112500,0.200000,0.200000},
-{0.037500,0.112500,0.100000,0.100000},
-{0.037500,0.112500,0.200000,0.200000},
-{0.062500,0.112500,0.100000,0.100000},
-{0.062500,0.112500,0.200000,0.200000},
-{0.087500,0.112500,0.100000,0.100000},
-{0.087500,0.112500,0.200000,0.200000},
-{0.112500,0.112500,0.100000,0.100000},
-{0.112500,0.112500,0.200000,0.200000},
-{0.137500,0.112500,0.100000,0.100000},
-{0.137500,0.112500,0.200000,0.200000},
-{0.162500,0.112500,0.100000,0.100000},
-{0.162500,0.112500,0.200000,0.200000},
-{0.187500,0.112500,0.100000,0.100000},
-{0.187500,0.112500,0.200000,0.200000},
-{0.212500,0.112500,0.100000,0.100000},
-{0.212500,0.112500,0.200000,0.200000},
-{0.237500,0.112500,0.100000,0.100000},
-{0.237500,0.112500,0.200000,0.200000},
-{0.262500,0.112500,0.100000,0.100000},
-{0.262500,0.112500,0.200000,0.200000},
-{0.287500,0.112500,0.100000,0.100000},
-{0.287500,0.112500,0.200000,0.200000},
-{0.312500,0.112500,0.100000,0.100000},
-{0.312500,0.112500,0.200000,0.200000},
-{0.337500,0.112500,0.100000,0.100000},
-{0.337500,0.112500,0.200000,0.200000},
-{0.362500,0.112500,0.100000,0.100000},
-{0.362500,0.112500,0.200000,0.200000},
-{0.387500,0.112500,0.100000,0.100000},
-{0.387500,0.112500,0.200000,0.200000},
-{0.412500,0.112500,0.100000,0.100000},
-{0.412500,0.112500,0.200000,0.200000},
-{0.437500,0.112500,0.100000,0.100000},
-{0.437500,0.112500,0.200000,0.200000},
-{0.462500,0.112500,0.100000,0.100000},
-{0.462500,0.112500,0.200000,0.200000},
-{0.487500,0.112500,0.100000,0.100000},
-{0.487500,0.112500,0.200000,0.200000},
-{0.512500,0.112500,0.100000,0.100000},
-{0.512500,0.112500,0.200000,0.200000},
-{0.537500,0.112500,0.100000,0.100000},
-{0.537500,0.112500,0.200000,0.200000},
-{0.562500,0.112500,0.100000,0.100000},
-{0.562500,0.112500,0.200000,0.200000},
-{0.587500,0.112500,0.100000,0.100000},
-{0.587500,0.112500,0.200000,0.200000},
-{0.612500,0.112500,0.100000,0.100000},
-{0.612500,0.112500,0.200000,0.200000},
-{0.637500,0.112500,0.100000,0.100000},
-{0.637500,0.112500,0.200000,0.200000},
-{0.662500,0.112500,0.100000,0.100000},
-{0.662500,0.112500,0.200000,0.200000},
-{0.687500,0.112500,0.100000,0.100000},
-{0.687500,0.112500,0.200000,0.200000},
-{0.712500,0.112500,0.100000,0.100000},
-{0.712500,0.112500,0.200000,0.200000},
-{0.737500,0.112500,0.100000,0.100000},
-{0.737500,0.112500,0.200000,0.200000},
-{0.762500,0.112500,0.100000,0.100000},
-{0.762500,0.112500,0.200000,0.200000},
-{0.787500,0.112500,0.100000,0.100000},
-{0.787500,0.112500,0.200000,0.200000},
-{0.812500,0.112500,0.100000,0.100000},
-{0.812500,0.112500,0.200000,0.200000},
-{0.837500,0.112500,0.100000,0.100000},
-{0.837500,0.112500,0.200000,0.200000},
-{0.862500,0.112500,0.100000,0.100000},
-{0.862500,0.112500,0.200000,0.200000},
-{0.887500,0.112500,0.100000,0.100000},
-{0.887500,0.112500,0.200000,0.200000},
-{0.912500,0.112500,0.100000,0.100000},
-{0.912500,0.112500,0.200000,0.200000},
-{0.937500,0.112500,0.100000,0.100000},
-{0.937500,0.112500,0.200000,0.200000},
-{0.962500,0.112500,0.100000,0.100000},
-{0.962500,0.112500,0.200000,0.200000},
-{0.987500,0.112500,0.100000,0.100000},
-{0.987500,0.112500,0.200000,0.200000},
-{0.012500,0.137500,0.100000,0.100000},
-{0.012500,0.137500,0.200000,0.200000},
-{0.037500,0.137500,0.100000,0.100000},
-{0.037500,0.137500,0.200000,0.200000},
-{0.062500,0.137500,0.100000,0.100000},
-{0.062500,0.137500,0.200000,0.200000},
-{0.087500,0.137500,0.100000,0.100000},
-{0.087500,0.137500,0.200000,0.200000},
-{0.112500,0.137500,0.100000,0.100000},
-{0.112500,0.137500,0.200000,0.200000},
-{0.137500,0.137500,0.100000,0.100000},
-{0.137500,0.137500,0.200000,0.200000},
-{0.162500,0.137500,0.100000,0.100000},
-{0.162500,0.137500,0.200000,0.200000},
-{0.187500,0.137500,0.100000,0.100000},
-{0.187500,0.137500,0.200000,0.200000},
-{0.212500,0.137500,0.100000,0.100000},
-{0.212500,0.137500,0.200000,0.200000},
-{0.237500,0.137500,0.100000,0.100000},
-{0.237500,0.137500,0.200000,0.200000},
-{0.262500,0.137500,0.100000,0.100000},
-{0.262500,0.137500,0.200000,0.200000},
-{0.287500,0.137500,0.100000,0.100000},
-{0.287500,0.137500,0.200000,0.200000},
-{0.312500,0.137500,0.100000,0.100000},
-{0.312500,0.137500,0.200000,0.200000},
-{0.337500,0.137500,0.100000,0.100000},
-{0.337500,0.137500,0.200000,0.200000},
-{0.362500,0.137500,0.100000,0.100000},
-{0.362500,0.137500,0.200000,0.200000},
-{0.387500,0.137500,0.100000,0.100000},
-{0.387500,0.137500,0.200000,0.200000},
-{0.412500,0.137500,0.100000,0.100000},
-{0.412500,0.137500,0.200000,0.200000},
-{0.437500,0.137500,0.100000,0.100000},
-{0.437500,0.137500,0.200000,0.200000},
-{0.462500,0.137500,0.100000,0.100000},
-{0.462500,0.137500,0.200000,0.200000},
-{0.487500,0.137500,0.100000,0.100000},
-{0.487500,0.137500,0.200000,0.200000},
-{0.512500,0.137500,0.100000,0.100000},
-{0.512500,0.137500,0.200000,0.200000},
-{0.537500,0.137500,0.100000,0.100000},
-{0.537500,0.137500,0.200000,0.200000},
-{0.562500,0.137500,0.100000,0.100000},
-{0.562500,0.137500,0.200000,0.200000},
-{0.587500,0.137500,0.100000,0.100000},
-{0.587500,0.137500,0.200000,0.200000},
-{0.612500,0.137500,0.100000,0.100000},
-{0.612500,0.137500,0.200000,0.200000},
-{0.637500,0.137500,0.100000,0.100000},
-{0.637500,0.137500,0.200000,0.200000},
-{0.662500,0.137500,0.100000,0.100000},
-{0.662500,0.137500,0.200000,0.200000},
-{0.687500,0.137500,0.100000,0.100000},
-{0.687500,0.137500,0.200000,0.200000},
-{0.712500,0.137500,0.100000,0.100000},
-{0.712500,0.137500,0.200000,0.200000},
-{0.737500,0.137500,0.100000,0.100000},
-{0.737500,0.137500,0.200000,0.200000},
-{0.762500,0.137500,0.100000,0.100000},
-{0.762500,0.137500,0.200000,0.200000},
-{0.787500,0.137500,0.100000,0.100000},
-{0.787500,0.137500,0.200000,0.200000},
-{0.812500,0.137500,0.100000,0.100000},
-{0.812500,0.137500,0.200000,0.200000},
-{0.837500,0.137500,0.100000,0.100000},
-{0.837500,0.137500,0.200000,0.200000},
-{0.862500,0.137500,0.100000,0.100000},
-{0.862500,0.137500,0.200000,0.200000},
-{0.887500,0.137500,0.100000,0.100000},
-{0.887500,0.137500,0.200000,0.200000},
-{0.912500,0.137500,0.100000,0.100000},
-{0.912500,0.137500,0.200000,0.200000},
-{0.937500,0.137500,0.100000,0.100000},
-{0.937500,0.137500,0.200000,0.200000},
-{0.962500,0.137500,0.100000,0.100000},
-{0.962500,0.137500,0.200000,0.200000},
-{0.987500,0.137500,0.100000,0.100000},
-{0.987500,0.137500,0.200000,0.200000},
-{0.012500,0.162500,0.100000,0.100000},
-{0.012500,0.162500,0.200000,0.200000},
-{0.037500,0.162500,0.100000,0.100000},
-{0.037500,0.162500,0.200000,0.200000},
-{0.062500,0.162500,0.100000,0.100000},
-{0.062500,0.162500,0.200000,0.200000},
-{0.087500,0.162500,0.100000,0.100000},
-{0.087500,0.162500,0.200000,0.200000},
-{0.112500,0.162500,0.100000,0.100000},
-{0.112500,0.162500,0.200000,0.200000},
-{0.137500,0.162500,0.100000,0.100000},
-{0.137500,0.162500,0.200000,0.200000},
-{0.162500,0.162500,0.100000,0.100000},
-{0.162500,0.162500,0.200000,0.200000},
-{0.187500,0.162500,0.100000,0.100000},
-{0.187500,0.162500,0.200000,0.200000},
-{0.212500,0.162500,0.100000,0.100000},
-{0.212500,0.162500,0.200000,0.200000},
-{0.237500,0.162500,0.100000,0.100000},
-{0.237500,0.162500,0.200000,0.200000},
-{0.262500,0.162500,0.100000,0.100000},
-{0.262500,0.162500,0.200000,0.200000},
-{0.287500,0.162500,0.100000,0.100000},
-{0.287500,0.162500,0.200000,0.200000},
-{0.312500,0.162500,0.100000,0.100000},
-{0.312500,0.162500,0.200000,0.200000},
-{0.337500,0.162500,0.100000,0.100000},
-{0.337500,0.162500,0.200000,0.200000},
-{0.362500,0.162500,0.100000,0.100000},
-{0.362500,0.162500,0.200000,0.200000},
-{0.387500,0.162500,0.100000,0.100000},
-{0.387500,0.162500,0.200000,0.200000},
-{0.412500,0.162500,0.100000,0.100000},
-{0.412500,0.162500,0.200000,0.200000},
-{0.437500,0.162500,0.100000,0.100000},
-{0.437500,0.162500,0.200000,0.200000},
-{0.462500,0.162500,0.100000,0.100000},
-{0.462500,0.162500,0.200000,0.200000},
-{0.487500,0.162500,0.100000,0.100000},
-{0.487500,0.162500,0.200000,0.200000},
-{0.512500,0.162500,0.100000,0.100000},
-{0.512500,0.162500,0.200000,0.200000},
-{0.537500,0.162500,0.100000,0.100000},
-{0.537500,0.162500,0.200000,0.200000},
-{0.562500,0.162500,0.100000,0.100000},
-{0.562500,0.162500,0.200000,0.200000},
-{0.587500,0.162500,0.100000,0.100000},
-{0.587500,0.162500,0.200000,0.200000},
-{0.612500,0.162500,0.100000,0.100000},
-{0.612500,0.162500,0.200000,0.200000},
-{0.637500,0.162500,0.100000,0.100000},
-{0.637500,0.162500,0.200000,0.200000},
-{0.662500,0.162500,0.100000,0.100000},
-{0.662500,0.162500,0.200000,0.200000},
-{0.687500,0.162500,0.100000,0.100000},
-{0.687500,0.162500,0.200000,0.200000},
-{0.712500,0.162500,0.100000,0.100000},
-{0.712500,0.162500,0.200000,0.200000},
-{0.737500,0.162500,0.100000,0.100000},
-{0.737500,0.162500,0.200000,0.200000},
-{0.762500,0.162500,0.100000,0.100000},
-{0.762500,0.162500,0.200000,0.200000},
-{0.787500,0.162500,0.100000,0.100000},
-{0.787500,0.162500,0.200000,0.200000},
-{0.812500,0.162500,0.100000,0.100000},
-{0.812500,0.162500,0.200000,0.200000},
-{0.837500,0.162500,0.100000,0.100000},
-{0.837500,0.162500,0.200000,0.200000},
-{0.862500,0.162500,0.100000,0.100000},
-{0.862500,0.162500,0.200000,0.200000},
-{0.887500,0.162500,0.100000,0.100000},
-{0.887500,0.162500,0.200000,0.200000},
-{0.912500,0.162500,0.100000,0.100000},
-{0.912500,0.162500,0.200000,0.200000},
-{0.937500,0.162500,0.100000,0.100000},
-{0.937500,0.162500,0.200000,0.200000},
-{0.962500,0.162500,0.100000,0.100000},
-{0.962500,0.162500,0.200000,0.200000},
-{0.987500,0.162500,0.100000,0.100000},
-{0.987500,0.162500,0.200000,0.200000},
-{0.012500,0.187500,0.100000,0.100000},
-{0.012500,0.187500,0.200000,0.200000},
-{0.037500,0.187500,0.100000,0.100000},
-{0.037500,0.187500,0.200000,0.200000},
-{0.062500,0.187500,0.100000,0.100000},
-{0.062500,0.187500,0.200000,0.200000},
-{0.087500,0.187500,0.100000,0.100000},
-{0.087500,0.187500,0.200000,0.200000},
-{0.112500,0.187500,0.100000,0.100000},
-{0.112500,0.187500,0.200000,0.200000},
-{0.137500,0.187500,0.100000,0.100000},
-{0.137500,0.187500,0.200000,0.200000},
-{0.162500,0.187500,0.100000,0.100000},
-{0.162500,0.187500,0.200000,0.200000},
-{0.187500,0.187500,0.100000,0.100000},
-{0.187500,0.187500,0.200000,0.200000},
-{0.212500,0.187500,0.100000,0.100000},
-{0.212500,0.187500,0.200000,0.200000},
-{0.237500,0.187500,0.100000,0.100000},
-{0.237500,0.187500,0.200000,0.200000},
-{0.262500,0.187500,0.100000,0.100000},
-{0.262500,0.187500,0.200000,0.200000},
-{0.287500,0.187500,0.100000,0.100000},
-{0.287500,0.187500,0.200000,0.200000},
-{0.312500,0.187500,0.100000,0.100000},
-{0.312500,0.187500,0.200000,0.200000},
-{0.337500,0.187500,0.100000,0.100000},
-{0.337500,0.187500,0.200000,0.200000},
-{0.362500,0.187500,0.100000,0.100000},
-{0.362500,0.187500,0.200000,0.200000},
-{0.387500,0.187500,0.100000,0.100000},
-{0.387500,0.187500,0.200000,0.200000},
-{0.412500,0.187500,0.100000,0.100000},
-{0.412500,0.187500,0.200000,0.200000},
-{0.437500,0.187500,0.100000,0.100000},
-{0.437500,0.187500,0.200000,0.200000},
-{0.462500,0.187500,0.100000,0.100000},
-{0.462500,0.187500,0.200000,0.200000},
-{0.487500,0.187500,0.100000,0.100000},
-{0.487500,0.187500,0.200000,0.200000},
-{0.512500,0.187500,0.100000,0.100000},
-{0.512500,0.187500,0.200000,0.200000},
-{0.537500,0.187500,0.100000,0.100000},
-{0.537500,0.187500,0.200000,0.200000},
-{0.562500,0.187500,0.100000,0.100000},
-{0.562500,0.187500,0.200000,0.200000},
-{0.587500,0.187500,0.100000,0.100000},
-{0.587500,0.187500,0.200000,0.200000},
-{0.612500,0.187500,0.100000,0.100000},
-{0.612500,0.187500,0.200000,0.200000},
-{0.637500,0.187500,0.100000,0.100000},
-{0.637500,0.187500,0.200000,0.200000},
-{0.662500,0.187500,0.100000,0.100000},
-{0.662500,0.187500,0.200000,0.200000},
-{0.687500,0.187500,0.100000,0.100000},
-{0.687500,0.187500,0.200000,0.200000},
-{0.712500,0.187500,0.100000,0.100000},
-{0.712500,0.187500,0.200000,0.200000},
-{0.737500,0.187500,0.100000,0.100000},
-{0.737500,0.187500,0.200000,0.200000},
-{0.762500,0.187500,0.100000,0.100000},
-{0.762500,0.187500,0.200000,0.200000},
-{0.787500,0.187500,0.100000,0.100000},
-{0.787500,0.187500,0.200000,0.200000},
-{0.812500,0.187500,0.100000,0.100000},
-{0.812500,0.187500,0.200000,0.200000},
-{0.837500,0.187500,0.100000,0.100000},
-{0.837500,0.187500,0.200000,0.200000},
-{0.862500,0.187500,0.100000,0.100000},
-{0.862500,0.187500,0.200000,0.200000},
-{0.887500,0.187500,0.100000,0.100000},
-{0.887500,0.187500,0.200000,0.200000},
-{0.912500,0.187500,0.100000,0.100000},
-{0.912500,0.187500,0.200000,0.200000},
-{0.937500,0.187500,0.100000,0.100000},
-{0.937500,0.187500,0.200000,0.200000},
-{0.962500,0.187500,0.100000,0.100000},
-{0.962500,0.187500,0.200000,0.200000},
-{0.987500,0.187500,0.100000,0.100000},
-{0.987500,0.187500,0.200000,0.200000},
-{0.012500,0.212500,0.100000,0.100000},
-{0.012500,0.212500,0.200000,0.200000},
-{0.037500,0.212500,0.100000,0.100000},
-{0.037500,0.212500,0.200000,0.200000},
-{0.062500,0.212500,0.100000,0.100000},
-{0.062500,0.212500,0.200000,0.200000},
-{0.087500,0.212500,0.100000,0.100000},
-{0.087500,0.212500,0.200000,0.200000},
-{0.112500,0.212500,0.100000,0.100000},
-{0.112500,0.212500,0.200000,0.200000},
-{0.137500,0.212500,0.100000,0.100000},
-{0.137500,0.212500,0.200000,0.200000},
-{0.162500,0.212500,0.100000,0.100000},
-{0.162500,0.212500,0.200000,0.200000},
-{0.187500,0.212500,0.100000,0.100000},
-{0.187500,0.212500,0.200000,0.200000},
-{0.212500,0.212500,0.100000,0.100000},
-{0.212500,0.212500,0.200000,0.200000},
-{0.237500,0.212500,0.100000,0.100000},
-{0.237500,0.212500,0.200000,0.200000},
-{0.262500,0.212500,0.100000,0.100000},
-{0.262500,0.212500,0.200000,0.200000},
-{0.287500,0.212500,0.100000,0.100000},
-{0.287500,0.212500,0.200000,0.200000},
-{0.312500,0.212500,0.100000,0.100000},
-{0.312500,0.212500,0.200000,0.200000},
-{0.337500,0.212500,0.100000,0.100000},
-{0.337500,0.212500,0.200000,0.200000},
-{0.362500,0.212500,0.100000,0.100000},
-{0.362500,0.212500,0.200000,0.200000},
-{0.387500,0.212500,0.100000,0.100000},
-{0.387500,0.212500,0.200000,0.200000},
-{0.412500,0.212500,0.100000,0.100000},
-{0.412500,0.212500,0.200000,0.200000},
-{0.437500,0.212500,0.100000,0.100000},
-{0.437500,0.212500,0.200000,0.200000},
-{0.462500,0.212500,0.100000,0.100000},
-{0.462500,0.212500,0.200000,0.200000},
-{0.487500,0.212500,0.100000,0.100000},
-{0.487500,0.212500,0.200000,0.200000},
-{0.512500,0.212500,0.100000,0.100000},
-{0.512500,0.212500,0.200000,0.200000},
-{0.537500,0.212500,0.100000,0.100000},
-{0.537500,0.212500,0.200000,0.200000},
-{0.562500,0.212500,0.100000,0.100000},
-{0.562500,0.212500,0.200000,0.200000},
-{0.587500,0.212500,0.100000,0.100000},
-{0.587500,0.212500,0.200000,0.200000},
-{0.612500,0.212500,0.100000,0.100000},
-{0.612500,0.212500,0.200000,0.200000},
-{0.637500,0.212500,0.100000,0.100000},
-{0.637500,0.212500,0.200000,0.200000},
-{0.662500,0.212500,0.100000,0.100000},
-{0.662500,0.212500,0.200000,0.200000},
-{0.687500,0.212500,0.100000,0.100000},
-{0.687500,0.212500,0.200000,0.200000},
-{0.712500,0.212500,0.100000,0.100000},
-{0.712500,0.212500,0.200000,0.200000},
-{0.737500,0.212500,0.100000,0.100000},
-{0.737500,0.212500,0.200000,0.200000},
-{0.762500,0.212500,0.100000,0.100000},
-{0.762500,0.212500,0.200000,0.200000},
-{0.787500,0.212500,0.100000,0.100000},
-{0.787500,0.212500,0.200000,0.200000},
-{0.812500,0.212500,0.100000,0.100000},
-{0.812500,0.212500,0.200000,0.200000},
-{0.837500,0.212500,0.100000,0.100000},
-{0.837500,0.212500,0.200000,0.200000},
-{0.862500,0.212500,0.100000,0.100000},
-{0.862500,0.212500,0.200000,0.200000},
-{0.887500,0.212500,0.100000,0.100000},
-{0.887500,0.212500,0.200000,0.200000},
-{0.912500,0.212500,0.100000,0.100000},
-{0.912500,0.212500,0.200000,0.200000},
-{0.937500,0.212500,0.100000,0.100000},
-{0.937500,0.212500,0.200000,0.200000},
-{0.962500,0.212500,0.100000,0.100000},
-{0.962500,0.212500,0.200000,0.200000},
-{0.987500,0.212500,0.100000,0.100000},
-{0.987500,0.212500,0.200000,0.200000},
-{0.012500,0.237500,0.100000,0.100000},
-{0.012500,0.237500,0.200000,0.200000},
-{0.037500,0.237500,0.100000,0.100000},
-{0.037500,0.237500,0.200000,0.200000},
-{0.062500,0.237500,0.100000,0.100000},
-{0.062500,0.237500,0.200000,0.200000},
-{0.087500,0.237500,0.100000,0.100000},
-{0.087500,0.237500,0.200000,0.200000},
-{0.112500,0.237500,0.100000,0.100000},
-{0.112500,0.237500,0.200000,0.200000},
-{0.137500,0.237500,0.100000,0.100000},
-{0.137500,0.237500,0.200000,0.200000},
-{0.162500,0.237500,0.100000,0.100000},
-{0.162500,0.237500,0.200000,0.200000},
-{0.187500,0.237500,0.100000,0.100000},
-{0.187500,0.237500,0.200000,0.200000},
-{0.212500,0.237500,0.100000,0.100000},
-{0.212500,0.237500,0.200000,0.200000},
-{0.237500,0.237500,0.100000,0.100000},
-{0.237500,0.237500,0.200000,0.200000},
-{0.262500,0.237500,0.100000,0.100000},
-{0.262500,0.237500,0.200000,0.200000},
-{0.287500,0.237500,0.100000,0.100000},
-{0.287500,0.237500,0.200000,0.200000},
-{0.312500,0.237500,0.100000,0.100000},
-{0.312500,0.237500,0.200000,0.200000},
-{0.337500,0.237500,0.100000,0.100000},
-{0.337500,0.237500,0.200000,0.200000},
-{0.362500,0.237500,0.100000,0.100000},
-{0.362500,0.237500,0.200000,0.200000},
-{0.387500,0.237500,0.100000,0.100000},
-{0.387500,0.237500,0.200000,0.200000},
-{0.412500,0.237500,0.100000,0.100000},
-{0.412500,0.237500,0.200000,0.200000},
-{0.437500,0.237500,0.100000,0.100000},
-{0.437500,0.237500,0.200000,0.200000},
-{0.462500,0.237500,0.100000,0.100000},
-{0.462500,0.237500,0.200000,0.200000},
-{0.487500,0.237500,0.100000,0.100000},
-{0.487500,0.237500,0.200000,0.200000},
-{0.512500,0.237500,0.100000,0.100000},
-{0.512500,0.237500,0.200000,0.200000},
-{0.537500,0.237500,0.100000,0.100000},
-{0.537500,0.237500,0.200000,0.200000},
-{0.562500,0.237500,0.100000,0.100000},
-{0.562500,0.237500,0.200000,0.200000},
-{0.587500,0.237500,0.100000,0.100000},
-{0.587500,0.237500,0.200000,0.200000},
-{0.612500,0.237500,0.100000,0.100000},
-{0.612500,0.237500,0.200000,0.200000},
-{0.637500,0.237500,0.100000,0.100000},
-{0.637500,0.237500,0.200000,0.200000},
-{0.662500,0.237500,0.100000,0.100000},
-{0.662500,0.237500,0.200000,0.200000},
-{0.687500,0.237500,0.100000,0.100000},
-{0.687500,0.237500,0.200000,0.200000},
-{0.712500,0.237500,0.100000,0.100000},
-{0.712500,0.237500,0.200000,0.200000},
-{0.737500,0.237500,0.100000,0.100000},
-{0.737500,0.237500,0.200000,0.200000},
-{0.762500,0.237500,0.100000,0.100000},
-{0.762500,0.237500,0.200000,0.200000},
-{0.787500,0.237500,0.100000,0.100000},
-{0.787500,0.237500,0.200000,0.200000},
-{0.812500,0.237500,0.100000,0.100000},
-{0.812500,0.237500,0.200000,0.200000},
-{0.837500,0.237500,0.100000,0.100000},
-{0.837500,0.237500,0.200000,0.200000},
-{0.862500,0.237500,0.100000,0.100000},
-{0.862500,0.237500,0.200000,0.200000},
-{0.887500,0.237500,0.100000,0.100000},
-{0.887500,0.237500,0.200000,0.200000},
-{0.912500,0.237500,0.100000,0.100000},
-{0.912500,0.237500,0.200000,0.200000},
-{0.937500,0.237500,0.100000,0.100000},
-{0.937500,0.237500,0.200000,0.200000},
-{0.962500,0.237500,0.100000,0.100000},
-{0.962500,0.237500,0.200000,0.200000},
-{0.987500,0.237500,0.100000,0.100000},
-{0.987500,0.237500,0.200000,0.200000},
-{0.012500,0.262500,0.100000,0.100000},
-{0.012500,0.262500,0.200000,0.200000},
-{0.037500,0.262500,0.100000,0.100000},
-{0.037500,0.262500,0.200000,0.200000},
-{0.062500,0.262500,0.100000,0.100000},
-{0.062500,0.262500,0.200000,0.200000},
-{0.087500,0.262500,0.100000,0.100000},
-{0.087500,0.262500,0.200000,0.200000},
-{0.112500,0.262500,0.100000,0.100000},
-{0.112500,0.262500,0.200000,0.200000},
-{0.137500,0.262500,0.100000,0.100000},
-{0.137500,0.262500,0.200000,0.200000},
-{0.162500,0.262500,0.100000,0.100000},
-{0.162500,0.262500,0.200000,0.200000},
-{0.187500,0.262500,0.100000,0.100000},
-{0.187500,0.262500,0.200000,0.200000},
-{0.212500,0.262500,0.100000,0.100000},
-{0.212500,0.262500,0.200000,0.200000},
-{0.237500,0.262500,0.100000,0.100000},
-{0.237500,0.262500,0.200000,0.200000},
-{0.262500,0.262500,0.100000,0.100000},
-{0.262500,0.262500,0.200000,0.200000},
-{0.287500,0.262500,0.100000,0.100000},
-{0.287500,0.262500,0.200000,0.200000},
-{0.312500,0.262500,0.100000,0.100000},
-{0.312500,0.262500,0.200000,0.200000},
-{0.337500,0.262500,0.100000,0.100000},
-{0.337500,0.262500,0.200000,0.200000},
-{0.362500,0.262500,0.100000,0.100000},
-{0.362500,0.262500,0.200000,0.200000},
-{0.387500,0.262500,0.100000,0.100000},
-{0.387500,0.262500,0.200000,0.200000},
-{0.412500,0.262500,0.100000,0.100000},
-{0.412500,0.262500,0.200000,0.200000},
-{0.437500,0.262500,0.100000,0.100000},
-{0.437500,0.262500,0.200000,0.200000},
-{0.462500,0.262500,0.100000,0.100000},
-{0.462500,0.262500,0.200000,0.200000},
-{0.487500,0.262500,0.100000,0.100000},
-{0.487500,0.262500,0.200000,0.200000},
-{0.512500,0.262500,0.100000,0.100000},
-{0.512500,0.262500,0.200000,0.200000},
-{0.537500,0.262500,0.100000,0.100000},
-{0.537500,0.262500,0.200000,0.200000},
-{0.562500,0.262500,0.100000,0.100000},
-{0.562500,0.262500,0.200000,0.200000},
-{0.587500,0.262500,0.100000,0.100000},
-{0.587500,0.262500,0.200000,0.200000},
-{0.612500,0.262500,0.100000,0.100000},
-{0.612500,0.262500,0.200000,0.200000},
-{0.637500,0.262500,0.100000,0.100000},
-{0.637500,0.262500,0.200000,0.200000},
-{0.662500,0.262500,0.100000,0.100000},
-{0.662500,0.262500,0.200000,0.200000},
-{0.687500,0.262500,0.100000,0.100000},
-{0.687500,0.262500,0.200000,0.200000},
-{0.712500,0.262500,0.100000,0.100000},
-{0.712500,0.262500,0.200000,0.200000},
-{0.737500,0.262500,0.100000,0.100000},
-{0.737500,0.262500,0.200000,0.200000},
-{0.762500,0.262500,0.100000,0.100000},
-{0.762500,0.262500,0.200000,0.200000},
-{0.787500,0.262500,0.100000,0.100000},
-{0.787500,0.262500,0.200000,0.200000},
-{0.812500,0.262500,0.100000,0.100000},
-{0.812500,0.262500,0.200000,0.200000},
-{0.837500,0.262500,0.100000,0.100000},
-{0.837500,0.262500,0.200000,0.200000},
-{0.862500,0.262500,0.100000,0.100000},
-{0.862500,0.262500,0.200000,0.200000},
-{0.887500,0.262500,0.100000,0.100000},
-{0.887500,0.262500,0.200000,0.200000},
-{0.912500,0.262500,0.100000,0.100000},
-{0.912500,0.262500,0.200000,0.200000},
-{0.937500,0.262500,0.100000,0.100000},
-{0.937500,0.262500,0.200000,0.200000},
-{0.962500,0.262500,0.100000,0.100000},
-{0.962500,0.262500,0.200000,0.200000},
-{0.987500,0.262500,0.100000,0.100000},
-{0.987500,0.262500,0.200000,0.200000},
-{0.012500,0.287500,0.100000,0.100000},
-{0.012500,0.287500,0.200000,0.200000},
-{0.037500,0.287500,0.100000,0.100000},
-{0.037500,0.287500,0.200000,0.200000},
-{0.062500,0.287500,0.100000,0.100000},
-{0.062500,0.287500,0.200000,0.200000},
-{0.087500,0.287500,0.100000,0.100000},
-{0.087500,0.287500,0.200000,0.200000},
-{0.112500,0.287500,0.100000,0.100000},
-{0.112500,0.287500,0.200000,0.200000},
-{0.137500,0.287500,0.100000,0.100000},
-{0.137500,0.287500,0.200000,0.200000},
-{0.162500,0.287500,0.100000,0.100000},
-{0.162500,0.287500,0.200000,0.200000},
-{0.187500,0.287500,0.100000,0.100000},
-{0.187500,0.287500,0.200000,0.200000},
-{0.212500,0.287500,0.100000,0.100000},
-{0.212500,0.287500,0.200000,0.200000},
-{0.237500,0.287500,0.100000,0.100000},
-{0.237500,0.287500,0.200000,0.200000},
-{0.262500,0.287500,0.100000,0.100000},
-{0.262500,0.287500,0.200000,0.200000},
-{0.287500,0.287500,0.100000,0.100000},
-{0.287500,0.287500,0.200000,0.200000},
-{0.312500,0.287500,0.100000,0.100000},
-{0.312500,0.287500,0.200000,0.200000},
-{0.337500,0.287500,0.100000,0.100000},
-{0.337500,0.287500,0.200000,0.200000},
-{0.362500,0.287500,0.100000,0.100000},
-{0.362500,0.287500,0.200000,0.200000},
-{0.387500,0.287500,0.100000,0.100000},
-{0.387500,0.287500,0.200000,0.200000},
-{0.412500,0.287500,0.100000,0.100000},
-{0.412500,0.287500,0.200000,0.200000},
-{0.437500,0.287500,0.100000,0.100000},
-{0.437500,0.287500,0.200000,0.200000},
-{0.462500,0.287500,0.100000,0.100000},
-{0.462500,0.287500,0.200000,0.200000},
-{0.487500,0.287500,0.100000,0.100000},
-{0.487500,0.287500,0.200000,0.200000},
-{0.512500,0.287500,0.100000,0.100000},
-{0.512500,0.287500,0.200000,0.200000},
-{0.537500,0.287500,0.100000,0.100000},
-{0.537500,0.287500,0.200000,0.200000},
-{0.562500,0.287500,0.100000,0.100000},
-{0.562500,0.287500,0.200000,0.200000},
-{0.587500,0.287500,0.100000,0.100000},
-{0.587500,0.287500,0.200000,0.200000},
-{0.612500,0.287500,0.100000,0.100000},
-{0.612500,0.287500,0.200000,0.200000},
-{0.637500,0.287500,0.100000,0.100000},
-{0.637500,0.287500,0.200000,0.200000},
-{0.662500,0.287500,0.100000,0.100000},
-{0.662500,0.287500,0.200000,0.200000},
-{0.687500,0.287500,0.100000,0.100000},
-{0.687500,0.287500,0.200000,0.200000},
-{0.712500,0.287500,0.100000,0.100000},
-{0.712500,0.287500,0.200000,0.200000},
-{0.737500,0.287500,0.100000,0.100000},
-{0.737500,0.287500,0.200000,0.200000},
-{0.762500,0.287500,0.100000,0.100000},
-{0.762500,0.287500,0.200000,0.200000},
-{0.787500,0.287500,0.100000,0.100000},
-{0.787500,0.287500,0.200000,0.200000},
-{0.812500,0.287500,0.100000,0.100000},
-{0.812500,0.287500,0.200000,0.200000},
-{0.837500,0.287500,0.100000,0.100000},
-{0.837500,0.287500,0.200000,0.200000},
-{0.862500,0.287500,0.100000,0.100000},
-{0.862500,0.287500,0.200000,0.200000},
-{0.887500,0.287500,0.100000,0.100000},
-{0.887500,0.287500,0.200000,0.200000},
-{0.912500,0.287500,0.100000,0.100000},
-{0.912500,0.287500,0.200000,0.200000},
-{0.937500,0.287500,0.100000,0.100000},
-{0.937500,0.287500,0.200000,0.200000},
-{0.962500,0.287500,0.100000,0.100000},
-{0.962500,0.287500,0.200000,0.200000},
-{0.987500,0.287500,0.100000,0.100000},
-{0.987500,0.287500,0.200000,0.200000},
-{0.012500,0.312500,0.100000,0.100000},
-{0.012500,0.312500,0.200000,0.200000},
-{0.037500,0.312500,0.100000,0.100000},
-{0.037500,0.312500,0.200000,0.200000},
-{0.062500,0.312500,0.100000,0.100000},
-{0.062500,0.312500,0.200000,0.200000},
-{0.087500,0.312500,0.100000,0.100000},
-{0.087500,0.312500,0.200000,0.200000},
-{0.112500,0.312500,0.100000,0.100000},
-{0.112500,0.312500,0.200000,0.200000},
-{0.137500,0.312500,0.100000,0.100000},
-{0.137500,0.312500,0.200000,0.200000},
-{0.162500,0.312500,0.100000,0.100000},
-{0.162500,0.312500,0.200000,0.200000},
-{0.187500,0.312500,0.100000,0.100000},
-{0.187500,0.312500,0.200000,0.200000},
-{0.212500,0.312500,0.100000,0.100000},
-{0.212500,0.312500,0.200000,0.200000},
-{0.237500,0.312500,0.100000,0.100000},
-{0.237500,0.312500,0.200000,0.200000},
-{0.262500,0.312500,0.100000,0.100000},
-{0.262500,0.312500,0.200000,0.200000},
-{0.287500,0.312500,0.100000,0.100000},
-{0.287500,0.312500,0.200000,0.200000},
-{0.312500,0.312500,0.100000,0.100000},
-{0.312500,0.312500,0.200000,0.200000},
-{0.337500,0.312500,0.100000,0.100000},
-{0.337500,0.312500,0.200000,0.200000},
-{0.362500,0.312500,0.100000,0.100000},
-{0.362500,0.312500,0.200000,0.200000},
-{0.387500,0.312500,0.100000,0.100000},
-{0.387500,0.312500,0.200000,0.200000},
-{0.412500,0.312500,0.100000,0.100000},
-{0.412500,0.312500,0.200000,0.200000},
-{0.437500,0.312500,0.100000,0.100000},
-{0.437500,0.312500,0.200000,0.200000},
-{0.462500,0.312500,0.100000,0.100000},
-{0.462500,0.312500,0.200000,0.200000},
-{0.487500,0.312500,0.100000,0.100000},
-{0.487500,0.312500,0.200000,0.200000},
-{0.512500,0.312500,0.100000,0.100000},
-{0.512500,0.312500,0.200000,0.200000},
-{0.537500,0.312500,0.100000,0.100000},
-{0.537500,0.312500,0.200000,0.200000},
-{0.562500,0.312500,0.100000,0.100000},
-{0.562500,0.312500,0.200000,0.200000},
-{0.587500,0.312500,0.100000,0.100000},
-{0.587500,0.312500,0.200000,0.200000},
-{0.612500,0.312500,0.100000,0.100000},
-{0.612500,0.312500,0.200000,0.200000},
-{0.637500,0.312500,0.100000,0.100000},
-{0.637500,0.312500,0.200000,0.200000},
-{0.662500,0.312500,0.100000,0.100000},
-{0.662500,0.312500,0.200000,0.200000},
-{0.687500,0.312500,0.100000,0.100000},
-{0.687500,0.312500,0.200000,0.200000},
-{0.712500,0.312500,0.100000,0.100000},
-{0.712500,0.312500,0.200000,0.200000},
-{0.737500,0.312500,0.100000,0.100000},
-{0.737500,0.312500,0.200000,0.200000},
-{0.762500,0.312500,0.100000,0.100000},
-{0.762500,0.312500,0.200000,0.200000},
-{0.787500,0.312500,0.100000,0.100000},
-{0.787500,0.312500,0.200000,0.200000},
-{0.812500,0.312500,0.100000,0.100000},
-{0.812500,0.312500,0.200000,0.200000},
-{0.837500,0.312500,0.100000,0.100000},
-{0.837500,0.312500,0.200000,0.200000},
-{0.862500,0.312500,0.100000,0.100000},
-{0.862500,0.312500,0.200000,0.200000},
-{0.887500,0.312500,0.100000,0.100000},
-{0.887500,0.312500,0.200000,0.200000},
-{0.912500,0.312500,0.100000,0.100000},
-{0.912500,0.312500,0.200000,0.200000},
-{0.937500,0.312500,0.100000,0.100000},
-{0.937500,0.312500,0.200000,0.200000},
-{0.962500,0.312500,0.100000,0.100000},
-{0.962500,0.312500,0.200000,0.200000},
-{0.987500,0.312500,0.100000,0.100000},
-{0.987500,0.312500,0.200000,0.200000},
-{0.012500,0.337500,0.100000,0.100000},
-{0.012500,0.337500,0.200000,0.200000},
-{0.037500,0.337500,0.100000,0.100000},
-{0.037500,0.337500,0.200000,0.200000},
-{0.062500,0.337500,0.100000,0.100000},
-{0.062500,0.337500,0.200000,0.200000},
-{0.087500,0.337500,0.100000,0.100000},
-{0.087500,0.337500,0.200000,0.200000},
-{0.112500,0.337500,0.100000,0.100000},
-{0.112500,0.337500,0.200000,0.200000},
-{0.137500,0.337500,0.100000,0.100000},
-{0.137500,0.337500,0.200000,0.200000},
-{0.162500,0.337500,0.100000,0.100000},
-{0.162500,0.337500,0.200000,0.200000},
-{0.187500,0.337500,0.100000,0.100000},
-{0.187500,0.337500,0.200000,0.200000},
-{0.212500,0.337500,0.100000,0.100000},
-{0.212500,0.337500,0.200000,0.200000},
-{0.237500,0.337500,0.100000,0.100000},
-{0.237500,0.337500,0.200000,0.200000},
-{0.262500,0.337500,0.100000,0.100000},
-{0.262500,0.337500,0.200000,0.200000},
-{0.287500,0.337500,0.100000,0.100000},
-{0.287500,0.337500,0.200000,0.200000},
-{0.312500,0.337500,0.100000,0.100000},
-{0.312500,0.337500,0.200000,0.200000},
-{0.337500,0.337500,0.100000,0.100000},
-{0.337500,0.337500,0.200000,0.200000},
-{0.362500,0.337500,0.100000,0.100000},
-{0.362500,0.337500,0.200000,0.200000},
-{0.387500,0.337500,0.100000,0.100000},
-{0.387500,0.337500,0.200000,0.200000},
-{0.412500,0.337500,0.100000,0.100000},
-{0.412500,0.337500,0.200000,0.200000},
-{0.437500,0.337500,0.100000,0.100000},
-{0.437500,0.337500,0.200000,0.200000},
-{0.462500,0.337500,0.100000,0.100000},
-{0.462500,0.337500,0.200000,0.200000},
-{0.487500,0.337500,0.100000,0.100000},
-{0.487500,0.337500,0.200000,0.200000},
-{0.512500,0.337500,0.100000,0.100000},
-{0.512500,0.337500,0.200000,0.200000},
-{0.537500,0.337500,0.100000,0.100000},
-{0.537500,0.337500,0.200000,0.200000},
-{0.562500,0.337500,0.100000,0.100000},
-{0.562500,0.337500,0.200000,0.200000},
-{0.587500,0.337500,0.100000,0.100000},
-{0.587500,0.337500,0.200000,0.200000},
-{0.612500,0.337500,0.100000,0.100000},
-{0.612500,0.337500,0.200000,0.200000},
-{0.637500,0.337500,0.100000,0.100000},
-{0.637500,0.337500,0.200000,0.200000},
-{0.662500,0.337500,0.100000,0.100000},
-{0.662500,0.337500,0.200000,0.200000},
-{0.687500,0.337500,0.100000,0.100000},
-{0.687500,0.337500,0.200000,0.200000},
-{0.712500,0.337500,0.100000,0.100000},
-{0.712500,0.337500,0.200000,0.200000},
-{0.737500,0.337500,0.100000,0.100000},
-{0.737500,0.337500,0.200000,0.200000},
-{0.762500,0.337500,0.100000,0.100000},
-{0.762500,0.337500,0.200000,0.200000},
-{0.787500,0.337500,0.100000,0.100000},
-{0.787500,0.337500,0.200000,0.200000},
-{0.812500,0.337500,0.100000,0.100000},
-{0.812500,0.337500,0.200000,0.200000},
-{0.837500,0.337500,0.100000,0.100000},
-{0.837500,0.337500,0.200000,0.200000},
-{0.862500,0.337500,0.100000,0.100000},
-{0.862500,0.337500,0.200000,0.200000},
-{0.887500,0.337500,0.100000,0.100000},
-{0.887500,0.337500,0.200000,0.200000},
-{0.912500,0.337500,0.100000,0.100000},
-{0.912500,0.337500,0.200000,0.200000},
-{0.937500,0.337500,0.100000,0.100000},
-{0.937500,0.337500,0.200000,0.200000},
-{0.962500,0.337500,0.100000,0.100000},
-{0.962500,0.337500,0.200000,0.200000},
-{0.987500,0.337500,0.100000,0.100000},
-{0.987500,0.337500,0.200000,0.200000},
-{0.012500,0.362500,0.100000,0.100000},
-{0.012500,0.362500,0.200000,0.200000},
-{0.037500,0.362500,0.100000,0.100000},
-{0.037500,0.362500,0.200000,0.200000},
-{0.062500,0.362500,0.100000,0.100000},
-{0.062500,0.362500,0.200000,0.200000},
-{0.087500,0.362500,0.100000,0.100000},
-{0.087500,0.362500,0.200000,0.200000},
-{0.112500,0.362500,0.100000,0.100000},
-{0.112500,0.362500,0.200000,0.200000},
-{0.137500,0.362500,0.100000,0.100000},
-{0.137500,0.362500,0.200000,0.200000},
-{0.162500,0.362500,0.100000,0.100000},
-{0.162500,0.362500,0.200000,0.200000},
-{0.187500,0.362500,0.100000,0.100000},
-{0.187500,0.362500,0.200000,0.200000},
-{0.212500,0.362500,0.100000,0.100000},
-{0.212500,0.362500,0.200000,0.200000},
-{0.237500,0.362500,0.100000,0.100000},
-{0.237500,0.362500,0.200000,0.200000},
-{0.262500,0.362500,0.100000,0.100000},
-{0.262500,0.362500,0.200000,0.200000},
-{0.287500,0.362500,0.100000,0.100000},
-{0.287500,0.362500,0.200000,0.200000},
-{0.312500,0.362500,0.100000,0.100000},
-{0.312500,0.362500,0.200000,0.200000},
-{0.337500,0.362500,0.100000,0.100000},
-{0.337500,0.362500,0.200000,0.200000},
-{0.362500,0.362500,0.100000,0.100000},
-{0.362500,0.362500,0.200000,0.200000},
-{0.387500,0.362500,0.100000,0.100000},
-{0.387500,0.362500,0.200000,0.200000},
-{0.412500,0.362500,0.100000,0.100000},
-{0.412500,0.362500,0.200000,0.200000},
-{0.437500,0.362500,0.100000,0.100000},
-{0.437500,0.362500,0.200000,0.200000},
-{0.462500,0.362500,0.100000,0.100000},
-{0.462500,0.362500,0.200000,0.200000},
-{0.487500,0.362500,0.100000,0.100000},
-{0.487500,0.362500,0.200000,0.200000},
-{0.512500,0.362500,0.100000,0.100000},
-{0.512500,0.362500,0.200000,0.200000},
-{0.537500,0.362500,0.100000,0.100000},
-{0.537500,0.362500,0.200000,0.200000},
-{0.562500,0.362500,0.100000,0.100000},
-{0.562500,0.362500,0.200000,0.200000},
-{0.587500,0.362500,0.100000,0.100000},
-{0.587500,0.362500,0.200000,0.200000},
-{0.612500,0.362500,0.100000,0.100000},
-{0.612500,0.362500,0.200000,0.200000},
-{0.637500,0.362500,0.100000,0.100000},
-{0.637500,0.362500,0.200000,0.200000},
-{0.662500,0.362500,0.100000,0.100000},
-{0.662500,0.362500,0.200000,0.200000},
-{0.687500,0.362500,0.100000,0.100000},
-{0.687500,0.362500,0.200000,0.200000},
-{0.712500,0.362500,0.100000,0.100000},
-{0.712500,0.362500,0.200000,0.200000},
-{0.737500,0.362500,0.100000,0.100000},
-{0.737500,0.362500,0.200000,0.200000},
-{0.762500,0.362500,0.100000,0.100000},
-{0.762500,0.362500,0.200000,0.200000},
-{0.787500,0.362500,0.100000,0.100000},
-{0.787500,0.362500,0.200000,0.200000},
-{0.812500,0.362500,0.100000,0.100000},
-{0.812500,0.362500,0.200000,0.200000},
-{0.837500,0.362500,0.100000,0.100000},
-{0.837500,0.362500,0.200000,0.200000},
-{0.862500,0.362500,0.100000,0.100000},
-{0.862500,0.362500,0.200000,0.200000},
-{0.887500,0.362500,0.100000,0.100000},
-{0.887500,0.362500,0.200000,0.200000},
-{0.912500,0.362500,0.100000,0.100000},
-{0.912500,0.362500,0.200000,0.200000},
-{0.937500,0.362500,0.100000,0.100000},
-{0.937500,0.362500,0.200000,0.200000},
-{0.962500,0.362500,0.100000,0.100000},
-{0.962500,0.362500,0.200000,0.200000},
-{0.987500,0.362500,0.100000,0.100000},
-{0.987500,0.362500,0.200000,0.200000},
-{0.012500,0.387500,0.100000,0.100000},
-{0.012500,0.387500,0.200000,0.200000},
-{0.037500,0.387500,0.100000,0.100000},
-{0.037500,0.387500,0.200000,0.200000},
-{0.062500,0.387500,0.100000,0.100000},
-{0.062500,0.387500,0.200000,0.200000},
-{0.087500,0.387500,0.100000,0.100000},
-{0.087500,0.387500,0.200000,0.200000},
-{0.112500,0.387500,0.100000,0.100000},
-{0.112500,0.387500,0.200000,0.200000},
-{0.137500,0.387500,0.100000,0.100000},
-{0.137500,0.387500,0.200000,0.200000},
-{0.162500,0.387500,0.100000,0.100000},
-{0.162500,0.387500,0.200000,0.200000},
-{0.187500,0.387500,0.100000,0.100000},
-{0.187500,0.387500,0.200000,0.200000},
-{0.212500,0.387500,0.100000,0.100000},
-{0.212500,0.387500,0.200000,0.200000},
-{0.237500,0.387500,0.100000,0.100000},
-{0.237500,0.387500,0.200000,0.200000},
-{0.262500,0.387500,0.100000,0.100000},
-{0.262500,0.387500,0.200000,0.200000},
-{0.287500,0.387500,0.100000,0.100000},
-{0.287500,0.387500,0.200000,0.200000},
-{0.312500,0.387500,0.100000,0.100000},
-{0.312500,0.387500,0.200000,0.200000},
-{0.337500,0.387500,0.100000,0.100000},
-{0.337500,0.387500,0.200000,0.200000},
-{0.362500,0.387500,0.100000,0.100000},
-{0.362500,0.387500,0.200000,0.200000},
-{0.387500,0.387500,0.100000,0.100000},
-{0.387500,0.387500,0.200000,0.200000},
-{0.412500,0.387500,0.100000,0.100000},
-{0.412500,0.387500,0.200000,0.200000},
-{0.437500,0.387500,0.100000,0.100000},
-{0.437500,0.387500,0.200000,0.200000},
-{0.462500,0.387500,0.100000,0.100000},
-{0.462500,0.387500,0.200000,0.200000},
-{0.487500,0.387500,0.100000,0.100000},
-{0.487500,0.387500,0.200000,0.200000},
-{0.512500,0.387500,0.100000,0.100000},
-{0.512500,0.387500,0.200000,0.200000},
-{0.537500,0.387500,0.100000,0.100000},
-{0.537500,0.387500,0.200000,0.200000},
-{0.562500,0.387500,0.100000,0.100000},
-{0.562500,0.387500,0.200000,0.200000},
-{0.587500,0.387500,0.100000,0.100000},
-{0.587500,0.387500,0.200000,0.200000},
-{0.612500,0.387500,0.100000,0.100000},
-{0.612500,0.387500,0.200000,0.200000},
-{0.637500,0.387500,0.100000,0.100000},
-{0.637500,0.387500,0.200000,0.200000},
-{0.662500,0.387500,0.100000,0.100000},
-{0.662500,0.387500,0.200000,0.200000},
-{0.687500,0.387500,0.100000,0.100000},
-{0.687500,0.387500,0.200000,0.200000},
-{0.712500,0.387500,0.100000,0.100000},
-{0.712500,0.387500,0.200000,0.200000},
-{0.737500,0.387500,0.100000,0.100000},
-{0.737500,0.387500,0.200000,0.200000},
-{0.762500,0.387500,0.100000,0.100000},
-{0.762500,0.387500,0.200000,0.200000},
-{0.787500,0.387500,0.100000,0.100000},
-{0.787500,0.387500,0.200000,0.200000},
-{0.812500,0.387500,0.100000,0.100000},
-{0.812500,0.387500,0.200000,0.200000},
-{0.837500,0.387500,0.100000,0.100000},
-{0.837500,0.387500,0.200000,0.200000},
-{0.862500,0.387500,0.100000,0.100000},
-{0.862500,0.387500,0.200000,0.200000},
-{0.887500,0.387500,0.100000,0.100000},
-{0.887500,0.387500,0.200000,0.200000},
-{0.912500,0.387500,0.100000,0.100000},
-{0.912500,0.387500,0.200000,0.200000},
-{0.937500,0.387500,0.100000,0.100000},
-{0.937500,0.387500,0.200000,0.200000},
-{0.962500,0.387500,0.100000,0.100000},
-{0.962500,0.387500,0.200000,0.200000},
-{0.987500,0.387500,0.100000,0.100000},
-{0.987500,0.387500,0.200000,0.200000},
-{0.012500,0.412500,0.100000,0.100000},
-{0.012500,0.412500,0.200000,0.200000},
-{0.037500,0.412500,0.100000,0.100000},
-{0.037500,0.412500,0.200000,0.200000},
-{0.062500,0.412500,0.100000,0.100000},
-{0.062500,0.412500,0.200000,0.200000},
-{0.087500,0.412500,0.100000,0.100000},
-{0.087500,0.412500,0.200000,0.200000},
-{0.112500,0.412500,0.100000,0.100000},
-{0.112500,0.412500,0.200000,0.200000},
-{0.137500,0.412500,0.100000,0.100000},
-{0.137500,0.412500,0.200000,0.200000},
-{0.162500,0.412500,0.100000,0.100000},
-{0.162500,0.412500,0.200000,0.200000},
-{0.187500,0.412500,0.100000,0.100000},
-{0.187500,0.412500,0.200000,0.200000},
-{0.212500,0.412500,0.100000,0.100000},
-{0.212500,0.412500,0.200000,0.200000},
-{0.237500,0.412500,0.100000,0.100000},
-{0.237500,0.412500,0.200000,0.200000},
-{0.262500,0.412500,0.100000,0.100000},
-{0.262500,0.412500,0.200000,0.200000},
-{0.287500,0.412500,0.100000,0.100000},
-{0.287500,0.412500,0.200000,0.200000},
-{0.312500,0.412500,0.100000,0.100000},
-{0.312500,0.412500,0.200000,0.200000},
-{0.337500,0.412500,0.100000,0.100000},
-{0.337500,0.412500,0.200000,0.200000},
-{0.362500,0.412500,0.100000,0.100000},
-{0.362500,0.412500,0.200000,0.200000},
-{0.387500,0.412500,0.100000,0.100000},
-{0.387500,0.412500,0.200000,0.200000},
-{0.412500,0.412500,0.100000,0.100000},
-{0.412500,0.412500,0.200000,0.200000},
-{0.437500,0.412500,0.100000,0.100000},
-{0.437500,0.412500,0.200000,0.200000},
-{0.462500,0.412500,0.100000,0.100000},
-{0.462500,0.412500,0.200000,0.200000},
-{0.487500,0.412500,0.100000,0.100000},
-{0.487500,0.412500,0.200000,0.200000},
-{0.512500,0.412500,0.100000,0.100000},
-{0.512500,0.412500,0.200000,0.200000},
-{0.537500,0.412500,0.100000,0.100000},
-{0.537500,0.412500,0.200000,0.200000},
-{0.562500,0.412500,0.100000,0.100000},
-{0.562500,0.412500,0.200000,0.200000},
-{0.587500,0.412500,0.100000,0.100000},
-{0.587500,0.412500,0.200000,0.200000},
-{0.612500,0.412500,0.100000,0.100000},
-{0.612500,0.412500,0.200000,0.200000},
-{0.637500,0.412500,0.100000,0.100000},
-{0.637500,0.412500,0.200000,0.200000},
-{0.662500,0.412500,0.100000,0.100000},
-{0.662500,0.412500,0.200000,0.200000},
-{0.687500,0.412500,0.100000,0.100000},
-{0.687500,0.412500,0.200000,0.200000},
-{0.712500,0.412500,0.100000,0.100000},
-{0.712500,0.412500,0.200000,0.200000},
-{0.737500,0.412500,0.100000,0.100000},
-{0.737500,0.412500,0.200000,0.200000},
-{0.762500,0.412500,0.100000,0.100000},
-{0.762500,0.412500,0.200000,0.200000},
-{0.787500,0.412500,0.100000,0.100000},
-{0.787500,0.412500,0.200000,0.200000},
-{0.812500,0.412500,0.100000,0.100000},
-{0.812500,0.412500,0.200000,0.200000},
-{0.837500,0.412500,0.100000,0.100000},
-{0.837500,0.412500,0.200000,0.200000},
-{0.862500,0.412500,0.100000,0.100000},
-{0.862500,0.412500,0.200000,0.200000},
-{0.887500,0.412500,0.100000,0.100000},
-{0.887500,0.412500,0.200000,0.200000},
-{0.912500,0.412500,0.100000,0.100000},
-{0.912500,0.412500,0.200000,0.200000},
-{0.937500,0.412500,0.100000,0.100000},
-{0.937500,0.412500,0.200000,0.200000},
-{0.962500,0.412500,0.100000,0.100000},
-{0.962500,0.412500,0.200000,0.200000},
-{0.987500,0.412500,0.100000,0.100000},
-{0.987500,0.412500,0.200000,0.200000},
-{0.012500,0.437500,0.100000,0.100000},
-{0.012500,0.437500,0.200000,0.200000},
-{0.037500,0.437500,0.100000,0.100000},
-{0.037500,0.437500,0.200000,0.200000},
-{0.062500,0.437500,0.100000,0.100000},
-{0.062500,0.437500,0.200000,0.200000},
-{0.087500,0.437500,0.100000,0.100000},
-{0.087500,0.437500,0.200000,0.200000},
-{0.112500,0.437500,0.100000,0.100000},
-{0.112500,0.437500,0.200000,0.200000},
-{0.137500,0.437500,0.100000,0.100000},
-{0.137500,0.437500,0.200000,0.200000},
-{0.162500,0.437500,0.100000,0.100000},
-{0.162500,0.437500,0.200000,0.200000},
-{0.187500,0.437500,0.100000,0.100000},
-{0.187500,0.437500,0.200000,0.200000},
-{0.212500,0.437500,0.100000,0.100000},
-{0.212500,0.437500,0.200000,0.200000},
-{0.237500,0.437500,0.100000,0.100000},
-{0.237500,0.437500,0.200000,0.200000},
-{0.262500,0.437500,0.100000,0.100000},
-{0.262500,0.437500,0.200000,0.200000},
-{0.287500,0.437500,0.100000,0.100000},
-{0.287500,0.437500,0.200000,0.200000},
-{0.312500,0.437500,0.100000,0.100000},
-{0.312500,0.437500,0.200000,0.200000},
-{0.337500,0.437500,0.100000,0.100000},
-{0.337500,0.437500,0.200000,0.200000},
-{0.362500,0.437500,0.100000,0.100000},
-{0.362500,0.437500,0.200000,0.200000},
-{0.387500,0.437500,0.100000,0.100000},
-{0.387500,0.437500,0.200000,0.200000},
-{0.412500,0.437500,0.100000,0.100000},
-{0.412500,0.437500,0.200000,0.200000},
-{0.437500,0.437500,0.100000,0.100000},
-{0.437500,0.437500,0.200000,0.200000},
-{0.462500,0.437500,0.100000,0.100000},
-{0.462500,0.437500,0.200000,0.200000},
-{0.487500,0.437500,0.100000,0.100000},
-{0.487500,0.437500,0.200000,0.200000},
-{0.512500,0.437500,0.100000,0.100000},
-{0.512500,0.437500,0.200000,0.200000},
-{0.537500,0.437500,0.100000,0.100000},
-{0.537500,0.437500,0.200000,0.200000},
-{0.562500,0.437500,0.100000,0.100000},
-{0.562500,0.437500,0.200000,0.200000},
-{0.587500,0.437500,0.100000,0.100000},
-{0.587500,0.437500,0.200000,0.200000},
-{0.612500,0.437500,0.100000,0.100000},
-{0.612500,0.437500,0.200000,0.200000},
-{0.637500,0.437500,0.100000,0.100000},
-{0.637500,0.437500,0.200000,0.200000},
-{0.662500,0.437500,0.100000,0.100000},
-{0.662500,0.437500,0.200000,0.200000},
-{0.687500,0.437500,0.100000,0.100000},
-{0.687500,0.437500,0.200000,0.200000},
-{0.712500,0.437500,0.100000,0.100000},
-{0.712500,0.437500,0.200000,0.200000},
-{0.737500,0.437500,0.100000,0.100000},
-{0.737500,0.437500,0.200000,0.200000},
-{0.762500,0.437500,0.100000,0.100000},
-{0.762500,0.437500,0.200000,0.200000},
-{0.787500,0.437500,0.100000,0.100000},
-{0.787500,0.437500,0.200000,0.200000},
-{0.812500,0.437500,0.100000,0.100000},
-{0.812500,0.437500,0.200000,0.200000},
-{0.837500,0.437500,0.100000,0.100000},
-{0.837500,0.437500,0.200000,0.200000},
-{0.862500,0.437500,0.100000,0.100000},
-{0.862500,0.437500,0.200000,0.200000},
-{0.887500,0.437500,0.100000,0.100000},
-{0.887500,0.437500,0.200000,0.200000},
-{0.912500,0.437500,0.100000,0.100000},
-{0.912500,0.437500,0.200000,0.200000},
-{0.937500,0.437500,0.100000,0.100000},
-{0.937500,0.437500,0.200000,0.200000},
-{0.962500,0.437500,0.100000,0.100000},
-{0.962500,0.437500,0.200000,0.200000},
-{0.987500,0.437500,0.100000,0.100000},
-{0.987500,0.437500,0.200000,0.200000},
-{0.012500,0.462500,0.100000,0.100000},
-{0.012500,0.462500,0.200000,0.200000},
-{0.037500,0.462500,0.100000,0.100000},
-{0.037500,0.462500,0.200000,0.200000},
-{0.062500,0.462500,0.100000,0.100000},
-{0.062500,0.462500,0.200000,0.200000},
-{0.087500,0.462500,0.100000,0.100000},
-{0.087500,0.462500,0.200000,0.200000},
-{0.112500,0.462500,0.100000,0.100000},
-{0.112500,0.462500,0.200000,0.200000},
-{0.137500,0.462500,0.100000,0.100000},
-{0.137500,0.462500,0.200000,0.200000},
-{0.162500,0.462500,0.100000,0.100000},
-{0.162500,0.462500,0.200000,0.200000},
-{0.187500,0.462500,0.100000,0.100000},
-{0.187500,0.462500,0.200000,0.200000},
-{0.212500,0.462500,0.100000,0.100000},
-{0.212500,0.462500,0.200000,0.200000},
-{0.237500,0.462500,0.100000,0.100000},
-{0.237500,0.462500,0.200000,0.200000},
-{0.262500,0.462500,0.100000,0.100000},
-{0.262500,0.462500,0.200000,0.200000},
-{0.287500,0.462500,0.100000,0.100000},
-{0.287500,0.462500,0.200000,0.200000},
-{0.312500,0.462500,0.100000,0.100000},
-{0.312500,0.462500,0.200000,0.200000},
-{0.337500,0.462500,0.100000,0.100000},
-{0.337500,0.462500,0.200000,0.200000},
-{0.362500,0.462500,0.100000,0.100000},
-{0.362500,0.462500,0.200000,0.200000},
-{0.387500,0.462500,0.100000,0.100000},
-{0.387500,0.462500,0.200000,0.200000},
-{0.412500,0.462500,0.100000,0.100000},
-{0.412500,0.462500,0.200000,0.200000},
-{0.437500,0.462500,0.100000,0.100000},
-{0.437500,0.462500,0.200000,0.200000},
-{0.462500,0.462500,0.100000,0.100000},
-{0.462500,0.462500,0.200000,0.200000},
-{0.487500,0.462500,0.100000,0.100000},
-{0.487500,0.462500,0.200000,0.200000},
-{0.512500,0.462500,0.100000,0.100000},
-{0.512500,0.462500,0.200000,0.200000},
-{0.537500,0.462500,0.100000,0.100000},
-{0.537500,0.462500,0.200000,0.200000},
-{0.562500,0.462500,0.100000,0.100000},
-{0.562500,0.462500,0.200000,0.200000},
-{0.587500,0.462500,0.100000,0.100000},
-{0.587500,0.462500,0.200000,0.200000},
-{0.612500,0.462500,0.100000,0.100000},
-{0.612500,0.462500,0.200000,0.200000},
-{0.637500,0.462500,0.100000,0.100000},
-{0.637500,0.462500,0.200000,0.200000},
-{0.662500,0.462500,0.100000,0.100000},
-{0.662500,0.462500,0.200000,0.200000},
-{0.687500,0.462500,0.100000,0.100000},
-{0.687500,0.462500,0.200000,0.200000},
-{0.712500,0.462500,0.100000,0.100000},
-{0.712500,0.462500,0.200000,0.200000},
-{0.737500,0.462500,0.100000,0.100000},
-{0.737500,0.462500,0.200000,0.200000},
-{0.762500,0.462500,0.100000,0.100000},
-{0.762500,0.462500,0.200000,0.200000},
-{0.787500,0.462500,0.100000,0.100000},
-{0.787500,0.462500,0.200000,0.200000},
-{0.812500,0.462500,0.100000,0.100000},
-{0.812500,0.462500,0.200000,0.200000},
-{0.837500,0.462500,0.100000,0.100000},
-{0.837500,0.462500,0.200000,0.200000},
-{0.862500,0.462500,0.100000,0.100000},
-{0.862500,0.462500,0.200000,0.200000},
-{0.887500,0.462500,0.100000,0.100000},
-{0.887500,0.462500,0.200000,0.200000},
-{0.912500,0.462500,0.100000,0.100000},
-{0.912500,0.462500,0.200000,0.200000},
-{0.937500,0.462500,0.100000,0.100000},
-{0.937500,0.462500,0.200000,0.200000},
-{0.962500,0.462500,0.100000,0.100000},
-{0.962500,0.462500,0.200000,0.200000},
-{0.987500,0.462500,0.100000,0.100000},
-{0.987500,0.462500,0.200000,0.200000},
-{0.012500,0.487500,0.100000,0.100000},
-{0.012500,0.487500,0.200000,0.200000},
-{0.037500,0.487500,0.100000,0.100000},
-{0.037500,0.487500,0.200000,0.200000},
-{0.062500,0.487500,0.100000,0.100000},
-{0.062500,0.487500,0.200000,0.200000},
-{0.087500,0.487500,0.100000,0.100000},
-{0.087500,0.487500,0.200000,0.200000},
-{0.112500,0.487500,0.100000,0.100000},
-{0.112500,0.487500,0.200000,0.200000},
-{0.137500,0.487500,0.100000,0.100000},
-{0.137500,0.487500,0.200000,0.200000},
-{0.162500,0.487500,0.100000,0.100000},
-{0.162500,0.487500,0.200000,0.200000},
-{0.187500,0.487500,0.100000,0.100000},
-{0.187500,0.487500,0.200000,0.200000},
-{0.212500,0.487500,0.100000,0.100000},
-{0.212500,0.487500,0.200000,0.200000},
-{0.237500,0.487500,0.100000,0.100000},
-{0.237500,0.487500,0.200000,0.200000},
-{0.262500,0.487500,0.100000,0.100000},
-{0.262500,0.487500,0.200000,0.200000},
-{0.287500,0.487500,0.100000,0.100000},
-{0.287500,0.487500,0.200000,0.200000},
-{0.312500,0.487500,0.100000,0.100000},
-{0.312500,0.487500,0.200000,0.200000},
-{0.337500,0.487500,0.100000,0.100000},
-{0.337500,0.487500,0.200000,0.200000},
-{0.362500,0.487500,0.100000,0.100000},
-{0.362500,0.487500,0.200000,0.200000},
-{0.387500,0.487500,0.100000,0.100000},
-{0.387500,0.487500,0.200000,0.200000},
-{0.412500,0.487500,0.100000,0.100000},
-{0.412500,0.487500,0.200000,0.200000},
-{0.437500,0.487500,0.100000,0.100000},
-{0.437500,0.487500,0.200000,0.200000},
-{0.462500,0.487500,0.100000,0.100000},
-{0.462500,0.487500,0.200000,0.200000},
-{0.487500,0.487500,0.100000,0.100000},
-{0.487500,0.487500,0.200000,0.200000},
-{0.512500,0.487500,0.100000,0.100000},
-{0.512500,0.487500,0.200000,0.200000},
-{0.537500,0.487500,0.100000,0.100000},
-{0.537500,0.487500,0.200000,0.200000},
-{0.562500,0.487500,0.100000,0.100000},
-{0.562500,0.487500,0.200000,0.200000},
-{0.587500,0.487500,0.100000,0.100000},
-{0.587500,0.487500,0.200000,0.200000},
-{0.612500,0.487500,0.100000,0.100000},
-{0.612500,0.487500,0.200000,0.200000},
-{0.637500,0.487500,0.100000,0.100000},
-{0.637500,0.487500,0.200000,0.200000},
-{0.662500,0.487500,0.100000,0.100000},
-{0.662500,0.487500,0.200000,0.200000},
-{0.687500,0.487500,0.100000,0.100000},
-{0.687500,0.487500,0.200000,0.200000},
-{0.712500,0.487500,0.100000,0.100000},
-{0.712500,0.487500,0.200000,0.200000},
-{0.737500,0.487500,0.100000,0.100000},
-{0.737500,0.487500,0.200000,0.200000},
-{0.762500,0.487500,0.100000,0.100000},
-{0.762500,0.487500,0.200000,0.200000},
-{0.787500,0.487500,0.100000,0.100000},
-{0.787500,0.487500,0.200000,0.200000},
-{0.812500,0.487500,0.100000,0.100000},
-{0.812500,0.487500,0.200000,0.200000},
-{0.837500,0.487500,0.100000,0.100000},
-{0.837500,0.487500,0.200000,0.200000},
-{0.862500,0.487500,0.100000,0.100000},
-{0.862500,0.487500,0.200000,0.200000},
-{0.887500,0.487500,0.100000,0.100000},
-{0.887500,0.487500,0.200000,0.200000},
-{0.912500,0.487500,0.100000,0.100000},
-{0.912500,0.487500,0.200000,0.200000},
-{0.937500,0.487500,0.100000,0.100000},
-{0.937500,0.487500,0.200000,0.200000},
-{0.962500,0.487500,0.100000,0.100000},
-{0.962500,0.487500,0.200000,0.200000},
-{0.987500,0.487500,0.100000,0.100000},
-{0.987500,0.487500,0.200000,0.200000},
-{0.012500,0.512500,0.100000,0.100000},
-{0.012500,0.512500,0.200000,0.200000},
-{0.037500,0.512500,0.100000,0.100000},
-{0.037500,0.512500,0.200000,0.200000},
-{0.062500,0.512500,0.100000,0.100000},
-{0.062500,0.512500,0.200000,0.200000},
-{0.087500,0.512500,0.100000,0.100000},
-{0.087500,0.512500,0.200000,0.200000},
-{0.112500,0.512500,0.100000,0.100000},
-{0.112500,0.512500,0.200000,0.200000},
-{0.137500,0.512500,0.100000,0.100000},
-{0.137500,0.512500,0.200000,0.200000},
-{0.162500,0.512500,0.100000,0.100000},
-{0.162500,0.512500,0.200000,0.200000},
-{0.187500,0.512500,0.100000,0.100000},
-{0.187500,0.512500,0.200000,0.200000},
-{0.212500,0.512500,0.100000,0.100000},
-{0.212500,0.512500,0.200000,0.200000},
-{0.237500,0.512500,0.100000,0.100000},
-{0.237500,0.512500,0.200000,0.200000},
-{0.262500,0.512500,0.100000,0.100000},
-{0.262500,0.512500,0.200000,0.200000},
-{0.287500,0.512500,0.100000,0.100000},
-{0.287500,0.512500,0.200000,0.200000},
-{0.312500,0.512500,0.100000,0.100000},
-{0.312500,0.512500,0.200000,0.200000},
-{0.337500,0.512500,0.100000,0.100000},
-{0.337500,0.512500,0.200000,0.200000},
-{0.362500,0.512500,0.100000,0.100000},
-{0.362500,0.512500,0.200000,0.200000},
-{0.387500,0.512500,0.100000,0.100000},
-{0.387500,0.512500,0.200000,0.200000},
-{0.412500,0.512500,0.100000,0.100000},
-{0.412500,0.512500,0.200000,0.200000},
-{0.437500,0.512500,0.100000,0.100000},
-{0.437500,0.512500,0.200000,0.200000},
-{0.462500,0.512500,0.100000,0.100000},
-{0.462500,0.512500,0.200000,0.200000},
-{0.487500,0.512500,0.100000,0.100000},
-{0.487500,0.512500,0.200000,0.200000},
-{0.512500,0.512500,0.100000,0.100000},
-{0.512500,0.512500,0.200000,0.200000},
-{0.537500,0.512500,0.100000,0.100000},
-{0.537500,0.512500,0.200000,0.200000},
-{0.562500,0.512500,0.100000,0.100000},
-{0.562500,0.512500,0.200000,0.200000},
-{0.587500,0.512500,0.100000,0.100000},
-{0.587500,0.512500,0.200000,0.200000},
-{0.612500,0.512500,0.100000,0.100000},
-{0.612500,0.512500,0.200000,0.200000},
-{0.637500,0.512500,0.100000,0.100000},
-{0.637500,0.512500,0.200000,0.200000},
-{0.662500,0.512500,0.100000,0.100000},
-{0.662500,0.512500,0.200000,0.200000},
-{0.687500,0.512500,0.100000,0.100000},
-{0.687500,0.512500,0.200000,0.200000},
-{0.712500,0.512500,0.100000,0.100000},
-{0.712500,0.512500,0.200000,0.200000},
-{0.737500,0.512500,0.100000,0.100000},
-{0.737500,0.512500,0.200000,0.200000},
-{0.762500,0.512500,0.100000,0.100000},
-{0.762500,0.512500,0.200000,0.200000},
-{0.787500,0.512500,0.100000,0.100000},
-{0.787500,0.512500,0.200000,0.200000},
-{0.812500,0.512500,0.100000,0.100000},
-{0.812500,0.512500,0.200000,0.200000},
-{0.837500,0.512500,0.100000,0.100000},
-{0.837500,0.512500,0.200000,0.200000},
-{0.862500,0.512500,0.100000,0.100000},
-{0.862500,0.512500,0.200000,0.200000},
-{0.887500,0.512500,0.100000,0.100000},
-{0.887500,0.512500,0.200000,0.200000},
-{0.912500,0.512500,0.100000,0.100000},
-{0.912500,0.512500,0.200000,0.200000},
-{0.937500,0.512500,0.100000,0.100000},
-{0.937500,0.512500,0.200000,0.200000},
-{0.962500,0.512500,0.100000,0.100000},
-{0.962500,0.512500,0.200000,0.200000},
-{0.987500,0.512500,0.100000,0.100000},
-{0.987500,0.512500,0.200000,0.200000},
-{0.012500,0.537500,0.100000,0.100000},
-{0.012500,0.537500,0.200000,0.200000},
-{0.037500,0.537500,0.100000,0.100000},
-{0.037500,0.537500,0.200000,0.200000},
-{0.062500,0.537500,0.100000,0.100000},
-{0.062500,0.537500,0.200000,0.200000},
-{0.087500,0.537500,0.100000,0.100000},
-{0.087500,0.537500,0.200000,0.200000},
-{0.112500,0.537500,0.100000,0.100000},
-{0.112500,0.537500,0.200000,0.200000},
-{0.137500,0.537500,0.100000,0.100000},
-{0.137500,0.537500,0.200000,0.200000},
-{0.162500,0.537500,0.100000,0.100000},
-{0.162500,0.537500,0.200000,0.200000},
-{0.187500,0.537500,0.100000,0.100000},
-{0.187500,0.537500,0.200000,0.200000},
-{0.212500,0.537500,0.100000,0.100000},
-{0.212500,0.537500,0.200000,0.200000},
-{0.237500,0.537500,0.100000,0.100000},
-{0.237500,0.537500,0.200000,0.200000},
-{0.262500,0.537500,0.100000,0.100000},
-{0.262500,0.537500,0.200000,0.200000},
-{0.287500,0.537500,0.100000,0.100000},
-{0.287500,0.537500,0.200000,0.200000},
-{0.312500,0.537500,0.100000,0.100000},
-{0.312500,0.537500,0.200000,0.200000},
-{0.337500,0.537500,0.100000,0.100000},
-{0.337500,0.537500,0.200000,0.200000},
-{0.362500,0.537500,0.100000,0.100000},
-{0.362500,0.537500,0.200000,0.200000},
-{0.387500,0.537500,0.100000,0.100000},
-{0.387500,0.537500,0.200000,0.200000},
-{0.412500,0.537500,0.100000,0.100000},
-{0.412500,0.537500,0.200000,0.200000},
-{0.437500,0.537500,0.100000,0.100000},
-{0.437500,0.537500,0.200000,0.200000},
-{0.462500,0.537500,0.100000,0.100000},
-{0.462500,0.537500,0.200000,0.200000},
-{0.487500,0.537500,0.100000,0.100000},
-{0.487500,0.537500,0.200000,0.200000},
-{0.512500,0.537500,0.100000,0.100000},
-{0.512500,0.537500,0.200000,0.200000},
-{0.537500,0.537500,0.100000,0.100000},
-{0.537500,0.537500,0.200000,0.200000},
-{0.562500,0.537500,0.100000,0.100000},
-{0.562500,0.537500,0.200000,0.200000},
-{0.587500,0.537500,0.100000,0.100000},
-{0.587500,0.537500,0.200000,0.200000},
-{0.612500,0.537500,0.100000,0.100000},
-{0.612500,0.537500,0.200000,0.200000},
-{0.637500,0.537500,0.100000,0.100000},
-{0.637500,0.537500,0.200000,0.200000},
-{0.662500,0.537500,0.100000,0.100000},
-{0.662500,0.537500,0.200000,0.200000},
-{0.687500,0.537500,0.100000,0.100000},
-{0.687500,0.537500,0.200000,0.200000},
-{0.712500,0.537500,0.100000,0.100000},
-{0.712500,0.537500,0.200000,0.200000},
-{0.737500,0.537500,0.100000,0.100000},
-{0.737500,0.537500,0.200000,0.200000},
-{0.762500,0.537500,0.100000,0.100000},
-{0.762500,0.537500,0.200000,0.200000},
-{0.787500,0.537500,0.100000,0.100000},
-{0.787500,0.537500,0.200000,0.200000},
-{0.812500,0.537500,0.100000,0.100000},
-{0.812500,0.537500,0.200000,0.200000},
-{0.837500,0.537500,0.100000,0.100000},
-{0.837500,0.537500,0.200000,0.200000},
-{0.862500,0.537500,0.100000,0.100000},
-{0.862500,0.537500,0.200000,0.200000},
-{0.887500,0.537500,0.100000,0.100000},
-{0.887500,0.537500,0.200000,0.200000},
-{0.912500,0.537500,0.100000,0.100000},
-{0.912500,0.537500,0.200000,0.200000},
-{0.937500,0.537500,0.100000,0.100000},
-{0.937500,0.537500,0.200000,0.200000},
-{0.962500,0.537500,0.100000,0.100000},
-{0.962500,0.537500,0.200000,0.200000},
-{0.987500,0.537500,0.100000,0.100000},
-{0.987500,0.537500,0.200000,0.200000},
-{0.012500,0.562500,0.100000,0.100000},
-{0.012500,0.562500,0.200000,0.200000},
-{0.037500,0.562500,0.100000,0.100000},
-{0.037500,0.562500,0.200000,0.200000},
-{0.062500,0.562500,0.100000,0.100000},
-{0.062500,0.562500,0.200000,0.200000},
-{0.087500,0.562500,0.100000,0.100000},
-{0.087500,0.562500,0.200000,0.200000},
-{0.112500,0.562500,0.100000,0.100000},
-{0.112500,0.562500,0.200000,0.200000},
-{0.137500,0.562500,0.100000,0.100000},
-{0.137500,0.562500,0.200000,0.200000},
-{0.162500,0.562500,0.100000,0.100000},
-{0.162500,0.562500,0.200000,0.200000},
-{0.187500,0.562500,0.100000,0.100000},
-{0.187500,0.562500,0.200000,0.200000},
-{0.212500,0.562500,0.100000,0.100000},
-{0.212500,0.562500,0.200000,0.200000},
-{0.237500,0.562500,0.100000,0.100000},
-{0.237500,0.562500,0.200000,0.200000},
-{0.262500,0.562500,0.100000,0.100000},
-{0.262500,0.562500,0.200000,0.200000},
-{0.287500,0.562500,0.100000,0.100000},
-{0.287500,0.562500,0.200000,0.200000},
-{0.312500,0.562500,0.100000,0.100000},
-{0.312500,0.562500,0.200000,0.200000},
-{0.337500,0.562500,0.100000,0.100000},
-{0.337500,0.562500,0.200000,0.200000},
-{0.362500,0.562500,0.100000,0.100000},
-{0.362500,0.562500,0.200000,0.200000},
-{0.387500,0.562500,0.100000,0.100000},
-{0.387500,0.562500,0.200000,0.200000},
-{0.412500,0.562500,0.100000,0.100000},
-{0.412500,0.562500,0.200000,0.200000},
-{0.437500,0.562500,0.100000,0.100000},
-{0.437500,0.562500,0.200000,0.200000},
-{0.462500,0.562500,0.100000,0.100000},
-{0.462500,0.562500,0.200000,0.200000},
-{0.487500,0.562500,0.100000,0.100000},
-{0.487500,0.562500,0.200000,0.200000},
-{0.512500,0.562500,0.100000,0.100000},
-{0.512500,0.562500,0.200000,0.200000},
-{0.537500,0.562500,0.100000,0.100000},
-{0.537500,0.562500,0.200000,0.200000},
-{0.562500,0.562500,0.100000,0.100000},
-{0.562500,0.562500,0.200000,0.200000},
-{0.587500,0.562500,0.100000,0.100000},
-{0.587500,0.562500,0.200000,0.200000},
-{0.612500,0.562500,0.100000,0.100000},
-{0.612500,0.562500,0.200000,0.200000},
-{0.637500,0.562500,0.100000,0.100000},
-{0.637500,0.562500,0.200000,0.200000},
-{0.662500,0.562500,0.100000,0.100000},
-{0.662500,0.562500,0.200000,0.200000},
-{0.687500,0.562500,0.100000,0.100000},
-{0.687500,0.562500,0.200000,0.200000},
-{0.712500,0.562500,0.100000,0.100000},
-{0.712500,0.562500,0.200000,0.200000},
-{0.737500,0.562500,0.100000,0.100000},
-{0.737500,0.562500,0.200000,0.200000},
-{0.762500,0.562500,0.100000,0.100000},
-{0.762500,0.562500,0.200000,0.200000},
-{0.787500,0.562500,0.100000,0.100000},
-{0.787500,0.562500,0.200000,0.200000},
-{0.812500,0.562500,0.100000,0.100000},
-{0.812500,0.562500,0.200000,0.200000},
-{0.837500,0.562500,0.100000,0.100000},
-{0.837500,0.562500,0.200000,0.200000},
-{0.862500,0.562500,0.100000,0.100000},
-{0.862500,0.562500,0.200000,0.200000},
-{0.887500,0.562500,0.100000,0.100000},
-{0.887500,0.562500,0.200000,0.200000},
-{0.912500,0.562500,0.100000,0.100000},
-{0.912500,0.562500,0.200000,0.200000},
-{0.937500,0.562500,0.100000,0.100000},
-{0.937500,0.562500,0.200000,0.200000},
-{0.962500,0.562500,0.100000,0.100000},
-{0.962500,0.562500,0.200000,0.200000},
-{0.987500,0.562500,0.100000,0.100000},
-{0.987500,0.562500,0.200000,0.200000},
-{0.012500,0.587500,0.100000,0.100000},
-{0.012500,0.587500,0.200000,0.200000},
-{0.037500,0.587500,0.100000,0.100000},
-{0.037500,0.587500,0.200000,0.200000},
-{0.062500,0.587500,0.100000,0.100000},
-{0.062500,0.587500,0.200000,0.200000},
-{0.087500,0.587500,0.100000,0.100000},
-{0.087500,0.587500,0.200000,0.200000},
-{0.112500,0.587500,0.100000,0.100000},
-{0.112500,0.587500,0.200000,0.200000},
-{0.137500,0.587500,0.100000,0.100000},
-{0.137500,0.587500,0.200000,0.200000},
-{0.162500,0.587500,0.100000,0.100000},
-{0.162500,0.587500,0.200000,0.200000},
-{0.187500,0.587500,0.100000,0.100000},
-{0.187500,0.587500,0.200000,0.200000},
-{0.212500,0.587500,0.100000,0.100000},
-{0.212500,0.587500,0.200000,0.200000},
-{0.237500,0.587500,0.100000,0.100000},
-{0.237500,0.587500,0.200000,0.200000},
-{0.262500,0.587500,0.100000,0.100000},
-{0.262500,0.587500,0.200000,0.200000},
-{0.287500,0.587500,0.100000,0.100000},
-{0.287500,0.587500,0.200000,0.200000},
-{0.312500,0.587500,0.100000,0.100000},
-{0.312500,0.587500,0.200000,0.200000},
-{0.337500,0.587500,0.100000,0.100000},
-{0.337500,0.587500,0.200000,0.200000},
-{0.362500,0.587500,0.100000,0.100000},
-{0.362500,0.587500,0.200000,0.200000},
-{0.387500,0.587500,0.100000,0.100000},
-{0.387500,0.587500,0.200000,0.200000},
-{0.412500,0.587500,0.100000,0.100000},
-{0.412500,0.587500,0.200000,0.200000},
-{0.437500,0.587500,0.100000,0.100000},
-{0.437500,0.587500,0.200000,0.200000},
-{0.462500,0.587500,0.100000,0.100000},
-{0.462500,0.587500,0.200000,0.200000},
-{0.487500,0.587500,0.100000,0.100000},
-{0.487500,0.587500,0.200000,0.200000},
-{0.512500,0.587500,0.100000,0.100000},
-{0.512500,0.587500,0.200000,0.200000},
-{0.537500,0.587500,0.100000,0.100000},
-{0.537500,0.587500,0.200000,0.200000},
-{0.562500,0.587500,0.100000,0.100000},
-{0.562500,0.587500,0.200000,0.200000},
-{0.587500,0.587500,0.100000,0.100000},
-{0.587500,0.587500,0.200000,0.200000},
-{0.612500,0.587500,0.100000,0.100000},
-{0.612500,0.587500,0.200000,0.200000},
-{0.637500,0.587500,0.100000,0.100000},
-{0.637500,0.587500,0.200000,0.200000},
-{0.662500,0.587500,0.100000,0.100000},
-{0.662500,0.587500,0.200000,0.200000},
-{0.687500,0.587500,0.100000,0.100000},
-{0.687500,0.587500,0.200000,0.200000},
-{0.712500,0.587500,0.100000,0.100000},
-{0.712500,0.587500,0.200000,0.200000},
-{0.737500,0.587500,0.100000,0.100000},
-{0.737500,0.587500,0.200000,0.200000},
-{0.762500,0.587500,0.100000,0.100000},
-{0.762500,0.587500,0.200000,0.200000},
-{0.787500,0.587500,0.100000,0.100000},
-{0.787500,0.587500,0.200000,0.200000},
-{0.812500,0.587500,0.100000,0.100000},
-{0.812500,0.587500,0.200000,0.200000},
-{0.837500,0.587500,0.100000,0.100000},
-{0.837500,0.587500,0.200000,0.200000},
-{0.862500,0.587500,0.100000,0.100000},
-{0.862500,0.587500,0.200000,0.200000},
-{0.887500,0.587500,0.100000,0.100000},
-{0.887500,0.587500,0.200000,0.200000},
-{0.912500,0.587500,0.100000,0.100000},
-{0.912500,0.587500,0.200000,0.200000},
-{0.937500,0.587500,0.100000,0.100000},
-{0.937500,0.587500,0.200000,0.200000},
-{0.962500,0.587500,0.100000,0.100000},
-{0.962500,0.587500,0.200000,0.200000},
-{0.987500,0.587500,0.100000,0.100000},
-{0.987500,0.587500,0.200000,0.200000},
-{0.012500,0.612500,0.100000,0.100000},
-{0.012500,0.612500,0.200000,0.200000},
-{0.037500,0.612500,0.100000,0.100000},
-{0.037500,0.612500,0.200000,0.200000},
-{0.062500,0.612500,0.100000,0.100000},
-{0.062500,0.612500,0.200000,0.200000},
-{0.087500,0.612500,0.100000,0.100000},
-{0.087500,0.612500,0.200000,0.200000},
-{0.112500,0.612500,0.100000,0.100000},
-{0.112500,0.612500,0.200000,0.200000},
-{0.137500,0.612500,0.100000,0.100000},
-{0.137500,0.612500,0.200000,0.200000},
-{0.162500,0.612500,0.100000,0.100000},
-{0.162500,0.612500,0.200000,0.200000},
-{0.187500,0.612500,0.100000,0.100000},
-{0.187500,0.612500,0.200000,0.200000},
-{0.212500,0.612500,0.100000,0.100000},
-{0.212500,0.612500,0.200000,0.200000},
-{0.237500,0.612500,0.100000,0.100000},
-{0.237500,0.612500,0.200000,0.200000},
-{0.262500,0.612500,0.100000,0.100000},
-{0.262500,0.612500,0.200000,0.200000},
-{0.287500,0.612500,0.100000,0.100000},
-{0.287500,0.612500,0.200000,0.200000},
-{0.312500,0.612500,0.100000,0.100000},
-{0.312500,0.612500,0.200000,0.200000},
-{0.337500,0.612500,0.100000,0.100000},
-{0.337500,0.612500,0.200000,0.200000},
-{0.362500,0.612500,0.100000,0.100000},
-{0.362500,0.612500,0.200000,0.200000},
-{0.387500,0.612500,0.100000,0.100000},
-{0.387500,0.612500,0.200000,0.200000},
-{0.412500,0.612500,0.100000,0.100000},
-{0.412500,0.612500,0.200000,0.200000},
-{0.437500,0.612500,0.100000,0.100000},
-{0.437500,0.612500,0.200000,0.200000},
-{0.462500,0.612500,0.100000,0.100000},
-{0.462500,0.612500,0.200000,0.200000},
-{0.487500,0.612500,0.100000,0.100000},
-{0.487500,0.612500,0.200000,0.200000},
-{0.512500,0.612500,0.100000,0.100000},
-{0.512500,0.612500,0.200000,0.200000},
-{0.537500,0.612500,0.100000,0.100000},
-{0.537500,0.612500,0.200000,0.200000},
-{0.562500,0.612500,0.100000,0.100000},
-{0.562500,0.612500,0.200000,0.200000},
-{0.587500,0.612500,0.100000,0.100000},
-{0.587500,0.612500,0.200000,0.200000},
-{0.612500,0.612500,0.100000,0.100000},
-{0.612500,0.612500,0.200000,0.200000},
-{0.637500,0.612500,0.100000,0.100000},
-{0.637500,0.612500,0.200000,0.200000},
-{0.662500,0.612500,0.100000,0.100000},
-{0.662500,0.612500,0.200000,0.200000},
-{0.687500,0.612500,0.100000,0.100000},
-{0.687500,0.612500,0.200000,0.200000},
-{0.712500,0.612500,0.100000,0.100000},
-{0.712500,0.612500,0.200000,0.200000},
-{0.737500,0.612500,0.100000,0.100000},
-{0.737500,0.612500,0.200000,0.200000},
-{0.762500,0.612500,0.100000,0.100000},
-{0.762500,0.612500,0.200000,0.200000},
-{0.787500,0.612500,0.100000,0.100000},
-{0.787500,0.612500,0.200000,0.200000},
-{0.812500,0.612500,0.100000,0.100000},
-{0.812500,0.612500,0.200000,0.200000},
-{0.837500,0.612500,0.100000,0.100000},
-{0.837500,0.612500,0.200000,0.200000},
-{0.862500,0.612500,0.100000,0.100000},
-{0.862500,0.612500,0.200000,0.200000},
-{0.887500,0.612500,0.100000,0.100000},
-{0.887500,0.612500,0.200000,0.200000},
-{0.912500,0.612500,0.100000,0.100000},
-{0.912500,0.612500,0.200000,0.200000},
-{0.937500,0.612500,0.100000,0.100000},
-{0.937500,0.612500,0.200000,0.200000},
-{0.962500,0.612500,0.100000,0.100000},
-{0.962500,0.612500,0.200000,0.200000},
-{0.987500,0.612500,0.100000,0.100000},
-{0.987500,0.612500,0.200000,0.200000},
-{0.012500,0.637500,0.100000,0.100000},
-{0.012500,0.637500,0.200000,0.200000},
-{0.037500,0.637500,0.100000,0.100000},
-{0.037500,0.637500,0.200000,0.200000},
-{0.062500,0.637500,0.100000,0.100000},
-{0.062500,0.637500,0.200000,0.200000},
-{0.087500,0.637500,0.100000,0.100000},
-{0.087500,0.637500,0.200000,0.200000},
-{0.112500,0.637500,0.100000,0.100000},
-{0.112500,0.637500,0.200000,0.200000},
-{0.137500,0.637500,0.100000,0.100000},
-{0.137500,0.637500,0.200000,0.200000},
-{0.162500,0.637500,0.100000,0.100000},
-{0.162500,0.637500,0.200000,0.200000},
-{0.187500,0.637500,0.100000,0.100000},
-{0.187500,0.637500,0.200000,0.200000},
-{0.212500,0.637500,0.100000,0.100000},
-{0.212500,0.637500,0.200000,0.200000},
-{0.237500,0.637500,0.100000,0.100000},
-{0.237500,0.637500,0.200000,0.200000},
-{0.262500,0.637500,0.100000,0.100000},
-{0.262500,0.637500,0.200000,0.200000},
-{0.287500,0.637500,0.100000,0.100000},
-{0.287500,0.637500,0.200000,0.200000},
-{0.312500,0.637500,0.100000,0.100000},
-{0.312500,0.637500,0.200000,0.200000},
-{0.337500,0.637500,0.100000,0.100000},
-{0.337500,0.637500,0.200000,0.200000},
-{0.362500,0.637500,0.100000,0.100000},
-{0.362500,0.637500,0.200000,0.200000},
-{0.387500,0.637500,0.100000,0.100000},
-{0.387500,0.637500,0.200000,0.200000},
-{0.412500,0.637500,0.100000,0.100000},
-{0.412500,0.637500,0.200000,0.200000},
-{0.437500,0.637500,0.100000,0.100000},
-{0.437500,0.637500,0.200000,0.200000},
-{0.462500,0.637500,0.100000,0.100000},
-{0.462500,0.637500,0.200000,0.200000},
-{0.487500,0.637500,0.100000,0.100000},
-{0.487500,0.637500,0.200000,0.200000},
-{0.512500,0.637500,0.100000,0.100000},
-{0.512500,0.637500,0.200000,0.200000},
-{0.537500,0.637500,0.100000,0.100000},
-{0.537500,0.637500,0.200000,0.200000},
-{0.562500,0.637500,0.100000,0.100000},
-{0.562500,0.637500,0.200000,0.200000},
-{0.587500,0.637500,0.100000,0.100000},
-{0.587500,0.637500,0.200000,0.200000},
-{0.612500,0.637500,0.100000,0.100000},
-{0.612500,0.637500,0.200000,0.200000},
-{0.637500,0.637500,0.100000,0.100000},
-{0.637500,0.637500,0.200000,0.200000},
-{0.662500,0.637500,0.100000,0.100000},
-{0.662500,0.637500,0.200000,0.200000},
-{0.687500,0.637500,0.100000,0.100000},
-{0.687500,0.637500,0.200000,0.200000},
-{0.712500,0.637500,0.100000,0.100000},
-{0.712500,0.637500,0.200000,0.200000},
-{0.737500,0.637500,0.100000,0.100000},
-{0.737500,0.637500,0.200000,0.200000},
-{0.762500,0.637500,0.100000,0.100000},
-{0.762500,0.637500,0.200000,0.200000},
-{0.787500,0.637500,0.100000,0.100000},
-{0.787500,0.637500,0.200000,0.200000},
-{0.812500,0.637500,0.100000,0.100000},
-{0.812500,0.637500,0.200000,0.200000},
-{0.837500,0.637500,0.100000,0.100000},
-{0.837500,0.637500,0.200000,0.200000},
-{0.862500,0.637500,0.100000,0.100000},
-{0.862500,0.637500,0.200000,0.200000},
-{0.887500,0.637500,0.100000,0.100000},
-{0.887500,0.637500,0.200000,0.200000},
-{0.912500,0.637500,0.100000,0.100000},
-{0.912500,0.637500,0.200000,0.200000},
-{0.937500,0.637500,0.100000,0.100000},
-{0.937500,0.637500,0.200000,0.200000},
-{0.962500,0.637500,0.100000,0.100000},
-{0.962500,0.637500,0.200000,0.200000},
-{0.987500,0.637500,0.100000,0.100000},
-{0.987500,0.637500,0.200000,0.200000},
-{0.012500,0.662500,0.100000,0.100000},
-{0.012500,0.662500,0.200000,0.200000},
-{0.037500,0.662500,0.100000,0.100000},
-{0.037500,0.662500,0.200000,0.200000},
-{0.062500,0.662500,0.100000,0.100000},
-{0.062500,0.662500,0.200000,0.200000},
-{0.087500,0.662500,0.100000,0.100000},
-{0.087500,0.662500,0.200000,0.200000},
-{0.112500,0.662500,0.100000,0.100000},
-{0.112500,0.662500,0.200000,0.200000},
-{0.137500,0.662500,0.100000,0.100000},
-{0.137500,0.662500,0.200000,0.200000},
-{0.162500,0.662500,0.100000,0.100000},
-{0.162500,0.662500,0.200000,0.200000},
-{0.187500,0.662500,0.100000,0.100000},
-{0.187500,0.662500,0.200000,0.200000},
-{0.212500,0.662500,0.100000,0.100000},
-{0.212500,0.662500,0.200000,0.200000},
-{0.237500,0.662500,0.100000,0.100000},
-{0.237500,0.662500,0.200000,0.200000},
-{0.262500,0.662500,0.100000,0.100000},
-{0.262500,0.662500,0.200000,0.200000},
-{0.287500,0.662500,0.100000,0.100000},
-{0.287500,0.662500,0.200000,0.200000},
-{0.312500,0.662500,0.100000,0.100000},
-{0.312500,0.662500,0.200000,0.200000},
-{0.337500,0.662500,0.100000,0.100000},
-{0.337500,0.662500,0.200000,0.200000},
-{0.362500,0.662500,0.100000,0.100000},
-{0.362500,0.662500,0.200000,0.200000},
-{0.387500,0.662500,0.100000,0.100000},
-{0.387500,0.662500,0.200000,0.200000},
-{0.412500,0.662500,0.100000,0.100000},
-{0.412500,0.662500,0.200000,0.200000},
-{0.437500,0.662500,0.100000,0.100000},
-{0.437500,0.662500,0.200000,0.200000},
-{0.462500,0.662500,0.100000,0.100000},
-{0.462500,0.662500,0.200000,0.200000},
-{0.487500,0.662500,0.100000,0.100000},
-{0.487500,0.662500,0.200000,0.200000},
-{0.512500,0.662500,0.100000,0.100000},
-{0.512500,0.662500,0.200000,0.200000},
-{0.537500,0.662500,0.100000,0.100000},
-{0.537500,0.662500,0.200000,0.200000},
-{0.562500,0.662500,0.100000,0.100000},
-{0.562500,0.662500,0.200000,0.200000},
-{0.587500,0.662500,0.100000,0.100000},
-{0.587500,0.662500,0.200000,0.200000},
-{0.612500,0.662500,0.100000,0.100000},
-{0.612500,0.662500,0.200000,0.200000},
-{0.637500,0.662500,0.100000,0.100000},
-{0.637500,0.662500,0.200000,0.200000},
-{0.662500,0.662500,0.100000,0.100000},
-{0.662500,0.662500,0.200000,0.200000},
-{0.687500,0.662500,0.100000,0.100000},
-{0.687500,0.662500,0.200000,0.200000},
-{0.712500,0.662500,0.100000,0.100000},
-{0.712500,0.662500,0.200000,0.200000},
-{0.737500,0.662500,0.100000,0.100000},
-{0.737500,0.662500,0.200000,0.200000},
-{0.762500,0.662500,0.100000,0.100000},
-{0.762500,0.662500,0.200000,0.200000},
-{0.787500,0.662500,0.100000,0.100000},
-{0.787500,0.662500,0.200000,0.200000},
-{0.812500,0.662500,0.100000,0.100000},
-{0.812500,0.662500,0.200000,0.200000},
-{0.837500,0.662500,0.100000,0.100000},
-{0.837500,0.662500,0.200000,0.200000},
-{0.862500,0.662500,0.100000,0.100000},
-{0.862500,0.662500,0.200000,0.200000},
-{0.887500,0.662500,0.100000,0.100000},
-{0.887500,0.662500,0.200000,0.200000},
-{0.912500,0.662500,0.100000,0.100000},
-{0.912500,0.662500,0.200000,0.200000},
-{0.937500,0.662500,0.100000,0.100000},
-{0.937500,0.662500,0.200000,0.200000},
-{0.962500,0.662500,0.100000,0.100000},
-{0.962500,0.662500,0.200000,0.200000},
-{0.987500,0.662500,0.100000,0.100000},
-{0.987500,0.662500,0.200000,0.200000},
-{0.012500,0.687500,0.100000,0.100000},
-{0.012500,0.687500,0.200000,0.200000},
-{0.037500,0.687500,0.100000,0.100000},
-{0.037500,0.687500,0.200000,0.200000},
-{0.062500,0.687500,0.100000,0.100000},
-{0.062500,0.687500,0.200000,0.200000},
-{0.087500,0.687500,0.100000,0.100000},
-{0.087500,0.687500,0.200000,0.200000},
-{0.112500,0.687500,0.100000,0.100000},
-{0.112500,0.687500,0.200000,0.200000},
-{0.137500,0.687500,0.100000,0.100000},
-{0.137500,0.687500,0.200000,0.200000},
-{0.162500,0.687500,0.100000,0.100000},
-{0.162500,0.687500,0.200000,0.200000},
-{0.187500,0.687500,0.100000,0.100000},
-{0.187500,0.687500,0.200000,0.200000},
-{0.212500,0.687500,0.100000,0.100000},
-{0.212500,0.687500,0.200000,0.200000},
-{0.237500,0.687500,0.100000,0.100000},
-{0.237500,0.687500,0.200000,0.200000},
-{0.262500,0.687500,0.100000,0.100000},
-{0.262500,0.687500,0.200000,0.200000},
-{0.287500,0.687500,0.100000,0.100000},
-{0.287500,0.687500,0.200000,0.200000},
-{0.312500,0.687500,0.100000,0.100000},
-{0.312500,0.687500,0.200000,0.200000},
-{0.337500,0.687500,0.100000,0.100000},
-{0.337500,0.687500,0.200000,0.200000},
-{0.362500,0.687500,0.100000,0.100000},
-{0.362500,0.687500,0.200000,0.200000},
-{0.387500,0.687500,0.100000,0.100000},
-{0.387500,0.687500,0.200000,0.200000},
-{0.412500,0.687500,0.100000,0.100000},
-{0.412500,0.687500,0.200000,0.200000},
-{0.437500,0.687500,0.100000,0.100000},
-{0.437500,0.687500,0.200000,0.200000},
-{0.462500,0.687500,0.100000,0.100000},
-{0.462500,0.687500,0.200000,0.200000},
-{0.487500,0.687500,0.100000,0.100000},
-{0.487500,0.687500,0.200000,0.200000},
-{0.512500,0.687500,0.100000,0.100000},
-{0.512500,0.687500,0.200000,0.200000},
-{0.537500,0.687500,0.100000,0.100000},
-{0.537500,0.687500,0.200000,0.200000},
-{0.562500,0.687500,0.100000,0.100000},
-{0.562500,0.687500,0.200000,0.200000},
-{0.587500,0.687500,0.100000,0.100000},
-{0.587500,0.687500,0.200000,0.200000},
-{0.612500,0.687500,0.100000,0.100000},
-{0.612500,0.687500,0.200000,0.200000},
-{0.637500,0.687500,0.100000,0.100000},
-{0.637500,0.687500,0.200000,0.200000},
-{0.662500,0.687500,0.100000,0.100000},
-{0.662500,0.687500,0.200000,0.200000},
-{0.687500,0.687500,0.100000,0.100000},
-{0.687500,0.687500,0.200000,0.200000},
-{0.712500,0.687500,0.100000,0.100000},
-{0.712500,0.687500,0.200000,0.200000},
-{0.737500,0.687500,0.100000,0.100000},
-{0.737500,0.687500,0.200000,0.200000},
-{0.762500,0.687500,0.100000,0.100000},
-{0.762500,0.687500,0.200000,0.200000},
-{0.787500,0.687500,0.100000,0.100000},
-{0.787500,0.687500,0.200000,0.200000},
-{0.812500,0.687500,0.100000,0.100000},
-{0.812500,0.687500,0.200000,0.200000},
-{0.837500,0.687500,0.100000,0.100000},
-{0.837500,0.687500,0.200000,0.200000},
-{0.862500,0.687500,0.100000,0.100000},
-{0.862500,0.687500,0.200000,0.200000},
-{0.887500,0.687500,0.100000,0.100000},
-{0.887500,0.687500,0.200000,0.200000},
-{0.912500,0.687500,0.100000,0.100000},
-{0.912500,0.687500,0.200000,0.200000},
-{0.937500,0.687500,0.100000,0.100000},
-{0.937500,0.687500,0.200000,0.200000},
-{0.962500,0.687500,0.100000,0.100000},
-{0.962500,0.687500,0.200000,0.200000},
-{0.987500,0.687500,0.100000,0.100000},
-{0.987500,0.687500,0.200000,0.200000},
-{0.012500,0.712500,0.100000,0.100000},
-{0.012500,0.712500,0.200000,0.200000},
-{0.037500,0.712500,0.100000,0.100000},
-{0.037500,0.712500,0.200000,0.200000},
-{0.062500,0.712500,0.100000,0.100000},
-{0.062500,0.712500,0.200000,0.200000},
-{0.087500,0.712500,0.100000,0.100000},
-{0.087500,0.712500,0.200000,0.200000},
-{0.112500,0.712500,0.100000,0.100000},
-{0.112500,0.712500,0.200000,0.200000},
-{0.137500,0.712500,0.100000,0.100000},
-{0.137500,0.712500,0.200000,0.200000},
-{0.162500,0.712500,0.100000,0.100000},
-{0.162500,0.712500,0.200000,0.200000},
-{0.187500,0.712500,0.100000,0.100000},
-{0.187500,0.712500,0.200000,0.200000},
-{0.212500,0.712500,0.100000,0.100000},
-{0.212500,0.712500,0.200000,0.200000},
-{0.237500,0.712500,0.100000,0.100000},
-{0.237500,0.712500,0.200000,0.200000},
-{0.262500,0.712500,0.100000,0.100000},
-{0.262500,0.712500,0.200000,0.200000},
-{0.287500,0.712500,0.100000,0.100000},
-{0.287500,0.712500,0.200000,0.200000},
-{0.312500,0.712500,0.100000,0.100000},
-{0.312500,0.712500,0.200000,0.200000},
-{0.337500,0.712500,0.100000,0.100000},
-{0.337500,0.712500,0.200000,0.200000},
-{0.362500,0.712500,0.100000,0.100000},
-{0.362500,0.712500,0.200000,0.200000},
-{0.387500,0.712500,0.100000,0.100000},
-{0.387500,0.712500,0.200000,0.200000},
-{0.412500,0.712500,0.100000,0.100000},
-{0.412500,0.712500,0.200000,0.200000},
-{0.437500,0.712500,0.100000,0.100000},
-{0.437500,0.712500,0.200000,0.200000},
-{0.462500,0.712500,0.100000,0.100000},
-{0.462500,0.712500,0.200000,0.200000},
-{0.487500,0.712500,0.100000,0.100000},
-{0.487500,0.712500,0.200000,0.200000},
-{0.512500,0.712500,0.100000,0.100000},
-{0.512500,0.712500,0.200000,0.200000},
-{0.537500,0.712500,0.100000,0.100000},
-{0.537500,0.712500,0.200000,0.200000},
-{0.562500,0.712500,0.100000,0.100000},
-{0.562500,0.712500,0.200000,0.200000},
-{0.587500,0.712500,0.100000,0.100000},
-{0.587500,0.712500,0.200000,0.200000},
-{0.612500,0.712500,0.100000,0.100000},
-{0.612500,0.712500,0.200000,0.200000},
-{0.637500,0.712500,0.100000,0.100000},
-{0.637500,0.712500,0.200000,0.200000},
-{0.662500,0.712500,0.100000,0.100000},
-{0.662500,0.712500,0.200000,0.200000},
-{0.687500,0.712500,0.100000,0.100000},
-{0.687500,0.712500,0.200000,0.200000},
-{0.712500,0.712500,0.100000,0.100000},
-{0.712500,0.712500,0.200000,0.200000},
-{0.737500,0.712500,0.100000,0.100000},
-{0.737500,0.712500,0.200000,0.200000},
-{0.762500,0.712500,0.100000,0.100000},
-{0.762500,0.712500,0.200000,0.200000},
-{0.787500,0.712500,0.100000,0.100000},
-{0.787500,0.712500,0.200000,0.200000},
-{0.812500,0.712500,0.100000,0.100000},
-{0.812500,0.712500,0.200000,0.200000},
-{0.837500,0.712500,0.100000,0.100000},
-{0.837500,0.712500,0.200000,0.200000},
-{0.862500,0.712500,0.100000,0.100000},
-{0.862500,0.712500,0.200000,0.200000},
-{0.887500,0.712500,0.100000,0.100000},
-{0.887500,0.712500,0.200000,0.200000},
-{0.912500,0.712500,0.100000,0.100000},
-{0.912500,0.712500,0.200000,0.200000},
-{0.937500,0.712500,0.100000,0.100000},
-{0.937500,0.712500,0.200000,0.200000},
-{0.962500,0.712500,0.100000,0.100000},
-{0.962500,0.712500,0.200000,0.200000},
-{0.987500,0.712500,0.100000,0.100000},
-{0.987500,0.712500,0.200000,0.200000},
-{0.012500,0.737500,0.100000,0.100000},
-{0.012500,0.737500,0.200000,0.200000},
-{0.037500,0.737500,0.100000,0.100000},
-{0.037500,0.737500,0.200000,0.200000},
-{0.062500,0.737500,0.100000,0.100000},
-{0.062500,0.737500,0.200000,0.200000},
-{0.087500,0.737500,0.100000,0.100000},
-{0.087500,0.737500,0.200000,0.200000},
-{0.112500,0.737500,0.100000,0.100000},
-{0.112500,0.737500,0.200000,0.200000},
-{0.137500,0.737500,0.100000,0.100000},
-{0.137500,0.737500,0.200000,0.200000},
-{0.162500,0.737500,0.100000,0.100000},
-{0.162500,0.737500,0.200000,0.200000},
-{0.187500,0.737500,0.100000,0.100000},
-{0.187500,0.737500,0.200000,0.200000},
-{0.212500,0.737500,0.100000,0.100000},
-{0.212500,0.737500,0.200000,0.200000},
-{0.237500,0.737500,0.100000,0.100000},
-{0.237500,0.737500,0.200000,0.200000},
-{0.262500,0.737500,0.100000,0.100000},
-{0.262500,0.737500,0.200000,0.200000},
-{0.287500,0.737500,0.100000,0.100000},
-{0.287500,0.737500,0.200000,0.200000},
-{0.312500,0.737500,0.100000,0.100000},
-{0.312500,0.737500,0.200000,0.200000},
-{0.337500,0.737500,0.100000,0.100000},
-{0.337500,0.737500,0.200000,0.200000},
-{0.362500,0.737500,0.100000,0.100000},
-{0.362500,0.737500,0.200000,0.200000},
-{0.387500,0.737500,0.100000,0.100000},
-{0.387500,0.737500,0.200000,0.200000},
-{0.412500,0.737500,0.100000,0.100000},
-{0.412500,0.737500,0.200000,0.200000},
-{0.437500,0.737500,0.100000,0.100000},
-{0.437500,0.737500,0.200000,0.200000},
-{0.462500,0.737500,0.100000,0.100000},
-{0.462500,0.737500,0.200000,0.200000},
-{0.487500,0.737500,0.100000,0.100000},
-{0.487500,0.737500,0.200000,0.200000},
-{0.512500,0.737500,0.100000,0.100000},
-{0.512500,0.737500,0.200000,0.200000},
-{0.537500,0.737500,0.100000,0.100000},
-{0.537500,0.737500,0.200000,0.200000},
-{0.562500,0.737500,0.100000,0.100000},
-{0.562500,0.737500,0.200000,0.200000},
-{0.587500,0.737500,0.100000,0.100000},
-{0.587500,0.737500,0.200000,0.200000},
-{0.612500,0.737500,0.100000,0.100000},
-{0.612500,0.737500,0.200000,0.200000},
-{0.637500,0.737500,0.100000,0.100000},
-{0.637500,0.737500,0.200000,0.200000},
-{0.662500,0.737500,0.100000,0.100000},
-{0.662500,0.737500,0.200000,0.200000},
-{0.687500,0.737500,0.100000,0.100000},
-{0.687500,0.737500,0.200000,0.200000},
-{0.712500,0.737500,0.100000,0.100000},
-{0.712500,0.737500,0.200000,0.200000},
-{0.737500,0.737500,0.100000,0.100000},
-{0.737500,0.737500,0.200000,0.200000},
-{0.762500,0.737500,0.100000,0.100000},
-{0.762500,0.737500,0.200000,0.200000},
-{0.787500,0.737500,0.100000,0.100000},
-{0.787500,0.737500,0.200000,0.200000},
-{0.812500,0.737500,0.100000,0.100000},
-{0.812500,0.737500,0.200000,0.200000},
-{0.837500,0.737500,0.100000,0.100000},
-{0.837500,0.737500,0.200000,0.200000},
-{0.862500,0.737500,0.100000,0.100000},
-{0.862500,0.737500,0.200000,0.200000},
-{0.887500,0.737500,0.100000,0.100000},
-{0.887500,0.737500,0.200000,0.200000},
-{0.912500,0.737500,0.100000,0.100000},
-{0.912500,0.737500,0.200000,0.200000},
-{0.937500,0.737500,0.100000,0.100000},
-{0.937500,0.737500,0.200000,0.200000},
-{0.962500,0.737500,0.100000,0.100000},
-{0.962500,0.737500,0.200000,0.200000},
-{0.987500,0.737500,0.100000,0.100000},
-{0.987500,0.737500,0.200000,0.200000},
-{0.012500,0.762500,0.100000,0.100000},
-{0.012500,0.762500,0.200000,0.200000},
-{0.037500,0.762500,0.100000,0.100000},
-{0.037500,0.762500,0.200000,0.200000},
-{0.062500,0.762500,0.100000,0.100000},
-{0.062500,0.762500,0.200000,0.200000},
-{0.087500,0.762500,0.100000,0.100000},
-{0.087500,0.762500,0.200000,0.200000},
-{0.112500,0.762500,0.100000,0.100000},
-{0.112500,0.762500,0.200000,0.200000},
-{0.137500,0.762500,0.100000,0.100000},
-{0.137500,0.762500,0.200000,0.200000},
-{0.162500,0.762500,0.100000,0.100000},
-{0.162500,0.762500,0.200000,0.200000},
-{0.187500,0.762500,0.100000,0.100000},
-{0.187500,0.762500,0.200000,0.200000},
-{0.212500,0.762500,0.100000,0.100000},
-{0.212500,0.762500,0.200000,0.200000},
-{0.237500,0.762500,0.100000,0.100000},
-{0.237500,0.762500,0.200000,0.200000},
-{0.262500,0.762500,0.100000,0.100000},
-{0.262500,0.762500,0.200000,0.200000},
-{0.287500,0.762500,0.100000,0.100000},
-{0.287500,0.762500,0.200000,0.200000},
-{0.312500,0.762500,0.100000,0.100000},
-{0.312500,0.762500,0.200000,0.200000},
-{0.337500,0.762500,0.100000,0.100000},
-{0.337500,0.762500,0.200000,0.200000},
-{0.362500,0.762500,0.100000,0.100000},
-{0.362500,0.762500,0.200000,0.200000},
-{0.387500,0.762500,0.100000,0.100000},
-{0.387500,0.762500,0.200000,0.200000},
-{0.412500,0.762500,0.100000,0.100000},
-{0.412500,0.762500,0.200000,0.200000},
-{0.437500,0.762500,0.100000,0.100000},
-{0.437500,0.762500,0.200000,0.200000},
-{0.462500,0.762500,0.100000,0.100000},
-{0.462500,0.762500,0.200000,0.200000},
-{0.487500,0.762500,0.100000,0.100000},
-{0.487500,0.762500,0.200000,0.200000},
-{0.512500,0.762500,0.100000,0.100000},
-{0.512500,0.762500,0.200000,0.200000},
-{0.537500,0.762500,0.100000,0.100000},
-{0.537500,0.762500,0.200000,0.200000},
-{0.562500,0.762500,0.100000,0.100000},
-{0.562500,0.762500,0.200000,0.200000},
-{0.587500,0.762500,0.100000,0.100000},
-{0.587500,0.762500,0.200000,0.200000},
-{0.612500,0.762500,0.100000,0.100000},
-{0.612500,0.762500,0.200000,0.200000},
-{0.637500,0.762500,0.100000,0.100000},
-{0.637500,0.762500,0.200000,0.200000},
-{0.662500,0.762500,0.100000,0.100000},
-{0.662500,0.762500,0.200000,0.200000},
-{0.687500,0.762500,0.100000,0.100000},
-{0.687500,0.762500,0.200000,0.200000},
-{0.712500,0.762500,0.100000,0.100000},
-{0.712500,0.762500,0.200000,0.200000},
-{0.737500,0.762500,0.100000,0.100000},
-{0.737500,0.762500,0.200000,0.200000},
-{0.762500,0.762500,0.100000,0.100000},
-{0.762500,0.762500,0.200000,0.200000},
-{0.787500,0.762500,0.100000,0.100000},
-{0.787500,0.762500,0.200000,0.200000},
-{0.812500,0.762500,0.100000,0.100000},
-{0.812500,0.762500,0.200000,0.200000},
-{0.837500,0.762500,0.100000,0.100000},
-{0.837500,0.762500,0.200000,0.200000},
-{0.862500,0.762500,0.100000,0.100000},
-{0.862500,0.762500,0.200000,0.200000},
-{0.887500,0.762500,0.100000,0.100000},
-{0.887500,0.762500,0.200000,0.200000},
-{0.912500,0.762500,0.100000,0.100000},
-{0.912500,0.762500,0.200000,0.200000},
-{0.937500,0.762500,0.100000,0.100000},
-{0.937500,0.762500,0.200000,0.200000},
-{0.962500,0.762500,0.100000,0.100000},
-{0.962500,0.762500,0.200000,0.200000},
-{0.987500,0.762500,0.100000,0.100000},
-{0.987500,0.762500,0.200000,0.200000},
-{0.012500,0.787500,0.100000,0.100000},
-{0.012500,0.787500,0.200000,0.200000},
-{0.037500,0.787500,0.100000,0.100000},
-{0.037500,0.787500,0.200000,0.200000},
-{0.062500,0.787500,0.100000,0.100000},
-{0.062500,0.787500,0.200000,0.200000},
-{0.087500,0.787500,0.100000,0.100000},
-{0.087500,0.787500,0.200000,0.200000},
-{0.112500,0.787500,0.100000,0.100000},
-{0.112500,0.787500,0.200000,0.200000},
-{0.137500,0.787500,0.100000,0.100000},
-{0.137500,0.787500,0.200000,0.200000},
-{0.162500,0.787500,0.100000,0.100000},
-{0.162500,0.787500,0.200000,0.200000},
-{0.187500,0.787500,0.100000,0.100000},
-{0.187500,0.787500,0.200000,0.200000},
-{0.212500,0.787500,0.100000,0.100000},
-{0.212500,0.787500,0.200000,0.200000},
-{0.237500,0.787500,0.100000,0.100000},
-{0.237500,0.787500,0.200000,0.200000},
-{0.262500,0.787500,0.100000,0.100000},
-{0.262500,0.787500,0.200000,0.200000},
-{0.287500,0.787500,0.100000,0.100000},
-{0.287500,0.787500,0.200000,0.200000},
-{0.312500,0.787500,0.100000,0.100000},
-{0.312500,0.787500,0.200000,0.200000},
-{0.337500,0.787500,0.100000,0.100000},
-{0.337500,0.787500,0.200000,0.200000},
-{0.362500,0.787500,0.100000,0.100000},
-{0.362500,0.787500,0.200000,0.200000},
-{0.387500,0.787500,0.100000,0.100000},
-{0.387500,0.787500,0.200000,0.200000},
-{0.412500,0.787500,0.100000,0.100000},
-{0.412500,0.787500,0.200000,0.200000},
-{0.437500,0.787500,0.100000,0.100000},
-{0.437500,0.787500,0.200000,0.200000},
-{0.462500,0.787500,0.100000,0.100000},
-{0.462500,0.787500,0.200000,0.200000},
-{0.487500,0.787500,0.100000,0.100000},
-{0.487500,0.787500,0.200000,0.200000},
-{0.512500,0.787500,0.100000,0.100000},
-{0.512500,0.787500,0.200000,0.200000},
-{0.537500,0.787500,0.100000,0.100000},
-{0.537500,0.787500,0.200000,0.200000},
-{0.562500,0.787500,0.100000,0.100000},
-{0.562500,0.787500,0.200000,0.200000},
-{0.587500,0.787500,0.100000,0.100000},
-{0.587500,0.787500,0.200000,0.200000},
-{0.612500,0.787500,0.100000,0.100000},
-{0.612500,0.787500,0.200000,0.200000},
-{0.637500,0.787500,0.100000,0.100000},
-{0.637500,0.787500,0.200000,0.200000},
-{0.662500,0.787500,0.100000,0.100000},
-{0.662500,0.787500,0.200000,0.200000},
-{0.687500,0.787500,0.100000,0.100000},
-{0.687500,0.787500,0.200000,0.200000},
-{0.712500,0.787500,0.100000,0.100000},
-{0.712500,0.787500,0.200000,0.200000},
-{0.737500,0.787500,0.100000,0.100000},
-{0.737500,0.787500,0.200000,0.200000},
-{0.762500,0.787500,0.100000,0.100000},
-{0.762500,0.787500,0.200000,0.200000},
-{0.787500,0.787500,0.100000,0.100000},
-{0.787500,0.787500,0.200000,0.200000},
-{0.812500,0.787500,0.100000,0.100000},
-{0.812500,0.787500,0.200000,0.200000},
-{0.837500,0.787500,0.100000,0.100000},
-{0.837500,0.787500,0.200000,0.200000},
-{0.862500,0.787500,0.100000,0.100000},
-{0.862500,0.787500,0.200000,0.200000},
-{0.887500,0.787500,0.100000,0.100000},
-{0.887500,0.787500,0.200000,0.200000},
-{0.912500,0.787500,0.100000,0.100000},
-{0.912500,0.787500,0.200000,0.200000},
-{0.937500,0.787500,0.100000,0.100000},
-{0.937500,0.787500,0.200000,0.200000},
-{0.962500,0.787500,0.100000,0.100000},
-{0.962500,0.787500,0.200000,0.200000},
-{0.987500,0.787500,0.100000,0.100000},
-{0.987500,0.787500,0.200000,0.200000},
-{0.012500,0.812500,0.100000,0.100000},
-{0.012500,0.812500,0.200000,0.200000},
-{0.037500,0.812500,0.100000,0.100000},
-{0.037500,0.812500,0.200000,0.200000},
-{0.062500,0.812500,0.100000,0.100000},
-{0.062500,0.812500,0.200000,0.200000},
-{0.087500,0.812500,0.100000,0.100000},
-{0.087500,0.812500,0.200000,0.200000},
-{0.112500,0.812500,0.100000,0.100000},
-{0.112500,0.812500,0.200000,0.200000},
-{0.137500,0.812500,0.100000,0.100000},
-{0.137500,0.812500,0.200000,0.200000},
-{0.162500,0.812500,0.100000,0.100000},
-{0.162500,0.812500,0.200000,0.200000},
-{0.187500,0.812500,0.100000,0.100000},
-{0.187500,0.812500,0.200000,0.200000},
-{0.212500,0.812500,0.100000,0.100000},
-{0.212500,0.812500,0.200000,0.200000},
-{0.237500,0.812500,0.100000,0.100000},
-{0.237500,0.812500,0.200000,0.200000},
-{0.262500,0.812500,0.100000,0.100000},
-{0.262500,0.812500,0.200000,0.200000},
-{0.287500,0.812500,0.100000,0.100000},
-{0.287500,0.812500,0.200000,0.200000},
-{0.312500,0.812500,0.100000,0.100000},
-{0.312500,0.812500,0.200000,0.200000},
-{0.337500,0.812500,0.100000,0.100000},
-{0.337500,0.812500,0.200000,0.200000},
-{0.362500,0.812500,0.100000,0.100000},
-{0.362500,0.812500,0.200000,0.200000},
-{0.387500,0.812500,0.100000,0.100000},
-{0.387500,0.812500,0.200000,0.200000},
-{0.412500,0.812500,0.100000,0.100000},
-{0.412500,0.812500,0.200000,0.200000},
-{0.437500,0.812500,0.100000,0.100000},
-{0.437500,0.812500,0.200000,0.200000},
-{0.462500,0.812500,0.100000,0.100000},
-{0.462500,0.812500,0.200000,0.200000},
-{0.487500,0.812500,0.100000,0.100000},
-{0.487500,0.812500,0.200000,0.200000},
-{0.512500,0.812500,0.100000,0.100000},
-{0.512500,0.812500,0.200000,0.200000},
-{0.537500,0.812500,0.100000,0.100000},
-{0.537500,0.812500,0.200000,0.200000},
-{0.562500,0.812500,0.100000,0.100000},
-{0.562500,0.812500,0.200000,0.200000},
-{0.587500,0.812500,0.100000,0.100000},
-{0.587500,0.812500,0.200000,0.200000},
-{0.612500,0.812500,0.100000,0.100000},
-{0.612500,0.812500,0.200000,0.200000},
-{0.637500,0.812500,0.100000,0.100000},
-{0.637500,0.812500,0.200000,0.200000},
-{0.662500,0.812500,0.100000,0.100000},
-{0.662500,0.812500,0.200000,0.200000},
-{0.687500,0.812500,0.100000,0.100000},
-{0.687500,0.812500,0.200000,0.200000},
-{0.712500,0.812500,0.100000,0.100000},
-{0.712500,0.812500,0.200000,0.200000},
-{0.737500,0.812500,0.100000,0.100000},
-{0.737500,0.812500,0.200000,0.200000},
-{0.762500,0.812500,0.100000,0.100000},
-{0.762500,0.812500,0.200000,0.200000},
-{0.787500,0.812500,0.100000,0.100000},
-{0.787500,0.812500,0.200000,0.200000},
-{0.812500,0.812500,0.100000,0.100000},
-{0.812500,0.812500,0.200000,0.200000},
-{0.837500,0.812500,0.100000,0.100000},
-{0.837500,0.812500,0.200000,0.200000},
-{0.862500,0.812500,0.100000,0.100000},
-{0.862500,0.812500,0.200000,0.200000},
-{0.887500,0.812500,0.100000,0.100000},
-{0.887500,0.812500,0.200000,0.200000},
-{0.912500,0.812500,0.100000,0.100000},
-{0.912500,0.812500,0.200000,0.200000},
-{0.937500,0.812500,0.100000,0.100000},
-{0.937500,0.812500,0.200000,0.200000},
-{0.962500,0.812500,0.100000,0.100000},
-{0.962500,0.812500,0.200000,0.200000},
-{0.987500,0.812500,0.100000,0.100000},
-{0.987500,0.812500,0.200000,0.200000},
-{0.012500,0.837500,0.100000,0.100000},
-{0.012500,0.837500,0.200000,0.200000},
-{0.037500,0.837500,0.100000,0.100000},
-{0.037500,0.837500,0.200000,0.200000},
-{0.062500,0.837500,0.100000,0.100000},
-{0.062500,0.837500,0.200000,0.200000},
-{0.087500,0.837500,0.100000,0.100000},
-{0.087500,0.837500,0.200000,0.200000},
-{0.112500,0.837500,0.100000,0.100000},
-{0.112500,0.837500,0.200000,0.200000},
-{0.137500,0.837500,0.100000,0.100000},
-{0.137500,0.837500,0.200000,0.200000},
-{0.162500,0.837500,0.100000,0.100000},
-{0.162500,0.837500,0.200000,0.200000},
-{0.187500,0.837500,0.100000,0.100000},
-{0.187500,0.837500,0.200000,0.200000},
-{0.212500,0.837500,0.100000,0.100000},
-{0.212500,0.837500,0.200000,0.200000},
-{0.237500,0.837500,0.100000,0.100000},
-{0.237500,0.837500,0.200000,0.200000},
-{0.262500,0.837500,0.100000,0.100000},
-{0.262500,0.837500,0.200000,0.200000},
-{0.287500,0.837500,0.100000,0.100000},
-{0.287500,0.837500,0.200000,0.200000},
-{0.312500,0.837500,0.100000,0.100000},
-{0.312500,0.837500,0.200000,0.200000},
-{0.337500,0.837500,0.100000,0.100000},
-{0.337500,0.837500,0.200000,0.200000},
-{0.362500,0.837500,0.100000,0.100000},
-{0.362500,0.837500,0.200000,0.200000},
-{0.387500,0.837500,0.100000,0.100000},
-{0.387500,0.837500,0.200000,0.200000},
-{0.412500,0.837500,0.100000,0.100000},
-{0.412500,0.837500,0.200000,0.200000},
-{0.437500,0.837500,0.100000,0.100000},
-{0.437500,0.837500,0.200000,0.200000},
-{0.462500,0.837500,0.100000,0.100000},
-{0.462500,0.837500,0.200000,0.200000},
-{0.487500,0.837500,0.100000,0.100000},
-{0.487500,0.837500,0.200000,0.200000},
-{0.512500,0.837500,0.100000,0.100000},
-{0.512500,0.837500,0.200000,0.200000},
-{0.537500,0.837500,0.100000,0.100000},
-{0.537500,0.837500,0.200000,0.200000},
-{0.562500,0.837500,0.100000,0.100000},
-{0.562500,0.837500,0.200000,0.200000},
-{0.587500,0.837500,0.100000,0.100000},
-{0.587500,0.837500,0.200000,0.200000},
-{0.612500,0.837500,0.100000,0.100000},
-{0.612500,0.837500,0.200000,0.200000},
-{0.637500,0.837500,0.100000,0.100000},
-{0.637500,0.837500,0.200000,0.200000},
-{0.662500,0.837500,0.100000,0.100000},
-{0.662500,0.837500,0.200000,0.200000},
-{0.687500,0.837500,0.100000,0.100000},
-{0.687500,0.837500,0.200000,0.200000},
-{0.712500,0.837500,0.100000,0.100000},
-{0.712500,0.837500,0.200000,0.200000},
-{0.737500,0.837500,0.100000,0.100000},
-{0.737500,0.837500,0.200000,0.200000},
-{0.762500,0.837500,0.100000,0.100000},
-{0.762500,0.837500,0.200000,0.200000},
-{0.787500,0.837500,0.100000,0.100000},
-{0.787500,0.837500,0.200000,0.200000},
-{0.812500,0.837500,0.100000,0.100000},
-{0.812500,0.837500,0.200000,0.200000},
-{0.837500,0.837500,0.100000,0.100000},
-{0.837500,0.837500,0.200000,0.200000},
-{0.862500,0.837500,0.100000,0.100000},
-{0.862500,0.837500,0.200000,0.200000},
-{0.887500,0.837500,0.100000,0.100000},
-{0.887500,0.837500,0.200000,0.200000},
-{0.912500,0.837500,0.100000,0.100000},
-{0.912500,0.837500,0.200000,0.200000},
-{0.937500,0.837500,0.100000,0.100000},
-{0.937500,0.837500,0.200000,0.200000},
-{0.962500,0.837500,0.100000,0.100000},
-{0.962500,0.837500,0.200000,0.200000},
-{0.987500,0.837500,0.100000,0.100000},
-{0.987500,0.837500,0.200000,0.200000},
-{0.012500,0.862500,0.100000,0.100000},
-{0.012500,0.862500,0.200000,0.200000},
-{0.037500,0.862500,0.100000,0.100000},
-{0.037500,0.862500,0.200000,0.200000},
-{0.062500,0.862500,0.100000,0.100000},
-{0.062500,0.862500,0.200000,0.200000},
-{0.087500,0.862500,0.100000,0.100000},
-{0.087500,0.862500,0.200000,0.200000},
-{0.112500,0.862500,0.100000,0.100000},
-{0.112500,0.862500,0.200000,0.200000},
-{0.137500,0.862500,0.100000,0.100000},
-{0.137500,0.862500,0.200000,0.200000},
-{0.162500,0.862500,0.100000,0.100000},
-{0.162500,0.862500,0.200000,0.200000},
-{0.187500,0.862500,0.100000,0.100000},
-{0.187500,0.862500,0.200000,0.200000},
-{0.212500,0.862500,0.100000,0.100000},
-{0.212500,0.862500,0.200000,0.200000},
-{0.237500,0.862500,0.100000,0.100000},
-{0.237500,0.862500,0.200000,0.200000},
-{0.262500,0.862500,0.100000,0.100000},
-{0.262500,0.862500,0.200000,0.200000},
-{0.287500,0.862500,0.100000,0.100000},
-{0.287500,0.862500,0.200000,0.200000},
-{0.312500,0.862500,0.100000,0.100000},
-{0.312500,0.862500,0.200000,0.200000},
-{0.337500,0.862500,0.100000,0.100000},
-{0.337500,0.862500,0.200000,0.200000},
-{0.362500,0.862500,0.100000,0.100000},
-{0.362500,0.862500,0.200000,0.200000},
-{0.387500,0.862500,0.100000,0.100000},
-{0.387500,0.862500,0.200000,0.200000},
-{0.412500,0.862500,0.100000,0.100000},
-{0.412500,0.862500,0.200000,0.200000},
-{0.437500,0.862500,0.100000,0.100000},
-{0.437500,0.862500,0.200000,0.200000},
-{0.462500,0.862500,0.100000,0.100000},
-{0.462500,0.862500,0.200000,0.200000},
-{0.487500,0.862500,0.100000,0.100000},
-{0.487500,0.862500,0.200000,0.200000},
-{0.512500,0.862500,0.100000,0.100000},
-{0.512500,0.862500,0.200000,0.200000},
-{0.537500,0.862500,0.100000,0.100000},
-{0.537500,0.862500,0.200000,0.200000},
-{0.562500,0.862500,0.100000,0.100000},
-{0.562500,0.862500,0.200000,0.200000},
-{0.587500,0.862500,0.100000,0.100000},
-{0.587500,0.862500,0.200000,0.200000},
-{0.612500,0.862500,0.100000,0.100000},
-{0.612500,0.862500,0.200000,0.200000},
-{0.637500,0.862500,0.100000,0.100000},
-{0.637500,0.862500,0.200000,0.200000},
-{0.662500,0.862500,0.100000,0.100000},
-{0.662500,0.862500,0.200000,0.200000},
-{0.687500,0.862500,0.100000,0.100000},
-{0.687500,0.862500,0.200000,0.200000},
-{0.712500,0.862500,0.100000,0.100000},
-{0.712500,0.862500,0.200000,0.200000},
-{0.737500,0.862500,0.100000,0.100000},
-{0.737500,0.862500,0.200000,0.200000},
-{0.762500,0.862500,0.100000,0.100000},
-{0.762500,0.862500,0.200000,0.200000},
-{0.787500,0.862500,0.100000,0.100000},
-{0.787500,0.862500,0.200000,0.200000},
-{0.812500,0.862500,0.100000,0.100000},
-{0.812500,0.862500,0.200000,0.200000},
-{0.837500,0.862500,0.100000,0.100000},
-{0.837500,0.862500,0.200000,0.200000},
-{0.862500,0.862500,0.100000,0.100000},
-{0.862500,0.862500,0.200000,0.200000},
-{0.887500,0.862500,0.100000,0.100000},
-{0.887500,0.862500,0.200000,0.200000},
-{0.912500,0.862500,0.100000,0.100000},
-{0.912500,0.862500,0.200000,0.200000},
-{0.937500,0.862500,0.100000,0.100000},
-{0.937500,0.862500,0.200000,0.200000},
-{0.962500,0.862500,0.100000,0.100000},
-{0.962500,0.862500,0.200000,0.200000},
-{0.987500,0.862500,0.100000,0.100000},
-{0.987500,0.862500,0.200000,0.200000},
-{0.012500,0.887500,0.100000,0.100000},
-{0.012500,0.887500,0.200000,0.200000},
-{0.037500,0.887500,0.100000,0.100000},
-{0.037500,0.887500,0.200000,0.200000},
-{0.062500,0.887500,0.100000,0.100000},
-{0.062500,0.887500,0.200000,0.200000},
-{0.087500,0.887500,0.100000,0.100000},
-{0.087500,0.887500,0.200000,0.200000},
-{0.112500,0.887500,0.100000,0.100000},
-{0.112500,0.887500,0.200000,0.200000},
-{0.137500,0.887500,0.100000,0.100000},
-{0.137500,0.887500,0.200000,0.200000},
-{0.162500,0.887500,0.100000,0.100000},
-{0.162500,0.887500,0.200000,0.200000},
-{0.187500,0.887500,0.100000,0.100000},
-{0.187500,0.887500,0.200000,0.200000},
-{0.212500,0.887500,0.100000,0.100000},
-{0.212500,0.887500,0.200000,0.200000},
-{0.237500,0.887500,0.100000,0.100000},
-{0.237500,0.887500,0.200000,0.200000},
-{0.262500,0.887500,0.100000,0.100000},
-{0.262500,0.887500,0.200000,0.200000},
-{0.287500,0.887500,0.100000,0.100000},
-{0.287500,0.887500,0.200000,0.200000},
-{0.312500,0.887500,0.100000,0.100000},
-{0.312500,0.887500,0.200000,0.200000},
-{0.337500,0.887500,0.100000,0.100000},
-{0.337500,0.887500,0.200000,0.200000},
-{0.362500,0.887500,0.100000,0.100000},
-{0.362500,0.887500,0.200000,0.200000},
-{0.387500,0.887500,0.100000,0.100000},
-{0.387500,0.887500,0.200000,0.200000},
-{0.412500,0.887500,0.100000,0.100000},
-{0.412500,0.887500,0.200000,0.200000},
-{0.437500,0.887500,0.100000,0.100000},
-{0.437500,0.887500,0.200000,0.200000},
-{0.462500,0.887500,0.100000,0.100000},
-{0.462500,0.887500,0.200000,0.200000},
-{0.487500,0.887500,0.100000,0.100000},
-{0.487500,0.887500,0.200000,0.200000},
-{0.512500,0.887500,0.100000,0.100000},
-{0.512500,0.887500,0.200000,0.200000},
-{0.537500,0.887500,0.100000,0.100000},
-{0.537500,0.887500,0.200000,0.200000},
-{0.562500,0.887500,0.100000,0.100000},
-{0.562500,0.887500,0.200000,0.200000},
-{0.587500,0.887500,0.100000,0.100000},
-{0.587500,0.887500,0.200000,0.200000},
-{0.612500,0.887500,0.100000,0.100000},
-{0.612500,0.887500,0.200000,0.200000},
-{0.637500,0.887500,0.100000,0.100000},
-{0.637500,0.887500,0.200000,0.200000},
-{0.662500,0.887500,0.100000,0.100000},
-{0.662500,0.887500,0.200000,0.200000},
-{0.687500,0.887500,0.100000,0.100000},
-{0.687500,0.887500,0.200000,0.200000},
-{0.712500,0.887500,0.100000,0.100000},
-{0.712500,0.887500,0.200000,0.200000},
-{0.737500,0.887500,0.100000,0.100000},
-{0.737500,0.887500,0.200000,0.200000},
-{0.762500,0.887500,0.100000,0.100000},
-{0.762500,0.887500,0.200000,0.200000},
-{0.787500,0.887500,0.100000,0.100000},
-{0.787500,0.887500,0.200000,0.200000},
-{0.812500,0.887500,0.100000,0.100000},
-{0.812500,0.887500,0.200000,0.200000},
-{0.837500,0.887500,0.100000,0.100000},
-{0.837500,0.887500,0.200000,0.200000},
-{0.862500,0.887500,0.100000,0.100000},
-{0.862500,0.887500,0.200000,0.200000},
-{0.887500,0.887500,0.100000,0.100000},
-{0.887500,0.887500,0.200000,0.200000},
-{0.912500,0.887500,0.100000,0.100000},
-{0.912500,0.887500,0.200000,0.200000},
-{0.937500,0.887500,0.100000,0.100000},
-{0.937500,0.887500,0.200000,0.200000},
-{0.962500,0.887500,0.100000,0.100000},
-{0.962500,0.887500,0.200000,0.200000},
-{0.987500,0.887500,0.100000,0.100000},
-{0.987500,0.887500,0.200000,0.200000},
-{0.012500,0.912500,0.100000,0.100000},
-{0.012500,0.912500,0.200000,0.200000},
-{0.037500,0.912500,0.100000,0.100000},
-{0.037500,0.912500,0.200000,0.200000},
-{0.062500,0.912500,0.100000,0.100000},
-{0.062500,0.912500,0.200000,0.200000},
-{0.087500,0.912500,0.100000,0.100000},
-{0.087500,0.912500,0.200000,0.200000},
-{0.112500,0.912500,0.100000,0.100000},
-{0.112500,0.912500,0.200000,0.200000},
-{0.137500,0.912500,0.100000,0.100000},
-{0.137500,0.912500,0.200000,0.200000},
-{0.162500,0.912500,0.100000,0.100000},
-{0.162500,0.912500,0.200000,0.200000},
-{0.187500,0.912500,0.100000,0.100000},
-{0.187500,0.912500,0.200000,0.200000},
-{0.212500,0.912500,0.100000,0.100000},
-{0.212500,0.912500,0.200000,0.200000},
-{0.237500,0.912500,0.100000,0.100000},
-{0.237500,0.912500,0.200000,0.200000},
-{0.262500,0.912500,0.100000,0.100000},
-{0.262500,0.912500,0.200000,0.200000},
-{0.287500,0.912500,0.100000,0.100000},
-{0.287500,0.912500,0.200000,0.200000},
-{0.312500,0.912500,0.100000,0.100000},
-{0.312500,0.912500,0.200000,0.200000},
-{0.337500,0.912500,0.100000,0.100000},
-{0.337500,0.912500,0.200000,0.200000},
-{0.362500,0.912500,0.100000,0.100000},
-{0.362500,0.912500,0.200000,0.200000},
-{0.387500,0.912500,0.100000,0.100000},
-{0.387500,0.912500,0.200000,0.200000},
-{0.412500,0.912500,0.100000,0.100000},
-{0.412500,0.912500,0.200000,0.200000},
-{0.437500,0.912500,0.100000,0.100000},
-{0.437500,0.912500,0.200000,0.200000},
-{0.462500,0.912500,0.100000,0.100000},
-{0.462500,0.912500,0.200000,0.200000},
-{0.487500,0.912500,0.100000,0.100000},
-{0.487500,0.912500,0.200000,0.200000},
-{0.512500,0.912500,0.100000,0.100000},
-{0.512500,0.912500,0.200000,0.200000},
-{0.537500,0.912500,0.100000,0.100000},
-{0.537500,0.912500,0.200000,0.200000},
-{0.562500,0.912500,0.100000,0.100000},
-{0.562500,0.912500,0.200000,0.200000},
-{0.587500,0.912500,0.100000,0.100000},
-{0.587500,0.912500,0.200000,0.200000},
-{0.612500,0.912500,0.100000,0.100000},
-{0.612500,0.912500,0.200000,0.200000},
-{0.637500,0.912500,0.100000,0.100000},
-{0.637500,0.912500,0.200000,0.200000},
-{0.662500,0.912500,0.100000,0.100000},
-{0.662500,0.912500,0.200000,0.200000},
-{0.687500,0.912500,0.100000,0.100000},
-{0.687500,0.912500,0.200000,0.200000},
-{0.712500,0.912500,0.100000,0.100000},
-{0.712500,0.912500,0.200000,0.200000},
-{0.737500,0.912500,0.100000,0.100000},
-{0.737500,0.912500,0.200000,0.200000},
-{0.762500,0.912500,0.100000,0.100000},
-{0.762500,0.912500,0.200000,0.200000},
-{0.787500,0.912500,0.100000,0.100000},
-{0.787500,0.912500,0.200000,0.200000},
-{0.812500,0.912500,0.100000,0.100000},
-{0.812500,0.912500,0.200000,0.200000},
-{0.837500,0.912500,0.100000,0.100000},
-{0.837500,0.912500,0.200000,0.200000},
-{0.862500,0.912500,0.100000,0.100000},
-{0.862500,0.912500,0.200000,0.200000},
-{0.887500,0.912500,0.100000,0.100000},
-{0.887500,0.912500,0.200000,0.200000},
-{0.912500,0.912500,0.100000,0.100000},
-{0.912500,0.912500,0.200000,0.200000},
-{0.937500,0.912500,0.100000,0.100000},
-{0.937500,0.912500,0.200000,0.200000},
-{0.962500,0.912500,0.100000,0.100000},
-{0.962500,0.912500,0.200000,0.200000},
-{0.987500,0.912500,0.100000,0.100000},
-{0.987500,0.912500,0.200000,0.200000},
-{0.012500,0.937500,0.100000,0.100000},
-{0.012500,0.937500,0.200000,0.200000},
-{0.037500,0.937500,0.100000,0.100000},
-{0.037500,0.937500,0.200000,0.200000},
-{0.062500,0.937500,0.100000,0.100000},
-{0.062500,0.937500,0.200000,0.200000},
-{0.087500,0.937500,0.100000,0.100000},
-{0.087500,0.937500,0.200000,0.200000},
-{0.112500,0.937500,0.100000,0.100000},
-{0.112500,0.937500,0.200000,0.200000},
-{0.137500,0.937500,0.100000,0.100000},
-{0.137500,0.937500,0.200000,0.200000},
-{0.162500,0.937500,0.100000,0.100000},
-{0.162500,0.937500,0.200000,0.200000},
-{0.187500,0.937500,0.100000,0.100000},
-{0.187500,0.937500,0.200000,0.200000},
-{0.212500,0.937500,0.100000,0.100000},
-{0.212500,0.937500,0.200000,0.200000},
-{0.237500,0.937500,0.100000,0.100000},
-{0.237500,0.937500,0.200000,0.200000},
-{0.262500,0.937500,0.100000,0.100000},
-{0.262500,0.937500,0.200000,0.200000},
-{0.287500,0.937500,0.100000,0.100000},
-{0.287500,0.937500,0.200000,0.200000},
-{0.312500,0.937500,0.100000,0.100000},
-{0.312500,0.937500,0.200000,0.200000},
-{0.337500,0.937500,0.100000,0.100000},
-{0.337500,0.937500,0.200000,0.200000},
-{0.362500,0.937500,0.100000,0.100000},
-{0.362500,0.937500,0.200000,0.200000},
-{0.387500,0.937500,0.100000,0.100000},
-{0.387500,0.937500,0.200000,0.200000},
-{0.412500,0.937500,0.100000,0.100000},
-{0.412500,0.937500,0.200000,0.200000},
-{0.437500,0.937500,0.100000,0.100000},
-{0.437500,0.937500,0.200000,0.200000},
-{0.462500,0.937500,0.100000,0.100000},
-{0.462500,0.937500,0.200000,0.200000},
-{0.487500,0.937500,0.100000,0.100000},
-{0.487500,0.937500,0.200000,0.200000},
-{0.512500,0.937500,0.100000,0.100000},
-{0.512500,0.937500,0.200000,0.200000},
-{0.537500,0.937500,0.100000,0.100000},
-{0.537500,0.937500,0.200000,0.200000},
-{0.562500,0.937500,0.100000,0.100000},
-{0.562500,0.937500,0.200000,0.200000},
-{0.587500,0.937500,0.100000,0.100000},
-{0.587500,0.937500,0.200000,0.200000},
-{0.612500,0.937500,0.100000,0.100000},
-{0.612500,0.937500,0.200000,0.200000},
-{0.637500,0.937500,0.100000,0.100000},
-{0.637500,0.937500,0.200000,0.200000},
-{0.662500,0.937500,0.100000,0.100000},
-{0.662500,0.937500,0.200000,0.200000},
-{0.687500,0.937500,0.100000,0.100000},
-{0.687500,0.937500,0.200000,0.200000},
-{0.712500,0.937500,0.100000,0.100000},
-{0.712500,0.937500,0.200000,0.200000},
-{0.737500,0.937500,0.100000,0.100000},
-{0.737500,0.937500,0.200000,0.200000},
-{0.762500,0.937500,0.100000,0.100000},
-{0.762500,0.937500,0.200000,0.200000},
-{0.787500,0.937500,0.100000,0.100000},
-{0.787500,0.937500,0.200000,0.200000},
-{0.812500,0.937500,0.100000,0.100000},
-{0.812500,0.937500,0.200000,0.200000},
-{0.837500,0.937500,0.100000,0.100000},
-{0.837500,0.937500,0.200000,0.200000},
-{0.862500,0.937500,0.100000,0.100000},
-{0.862500,0.937500,0.200000,0.200000},
-{0.887500,0.937500,0.100000,0.100000},
-{0.887500,0.937500,0.200000,0.200000},
-{0.912500,0.937500,0.100000,0.100000},
-{0.912500,0.937500,0.200000,0.200000},
-{0.937500,0.937500,0.100000,0.100000},
-{0.937500,0.937500,0.200000,0.200000},
-{0.962500,0.937500,0.100000,0.100000},
-{0.962500,0.937500,0.200000,0.200000},
-{0.987500,0.937500,0.100000,0.100000},
-{0.987500,0.937500,0.200000,0.200000},
-{0.012500,0.962500,0.100000,0.100000},
-{0.012500,0.962500,0.200000,0.200000},
-{0.037500,0.962500,0.100000,0.100000},
-{0.037500,0.962500,0.200000,0.200000},
-{0.062500,0.962500,0.100000,0.100000},
-{0.062500,0.962500,0.200000,0.200000},
-{0.087500,0.962500,0.100000,0.100000},
-{0.087500,0.962500,0.200000,0.200000},
-{0.112500,0.962500,0.100000,0.100000},
-{0.112500,0.962500,0.200000,0.200000},
-{0.137500,0.962500,0.100000,0.100000},
-{0.137500,0.962500,0.200000,0.200000},
-{0.162500,0.962500,0.100000,0.100000},
-{0.162500,0.962500,0.200000,0.200000},
-{0.187500,0.962500,0.100000,0.100000},
-{0.187500,0.962500,0.200000,0.200000},
-{0.212500,0.962500,0.100000,0.100000},
-{0.212500,0.962500,0.200000,0.200000},
-{0.237500,0.962500,0.100000,0.100000},
-{0.237500,0.962500,0.200000,0.200000},
-{0.262500,0.962500,0.100000,0.100000},
-{0.262500,0.962500,0.200000,0.200000},
-{0.287500,0.962500,0.100000,0.100000},
-{0.287500,0.962500,0.200000,0.200000},
-{0.312500,0.962500,0.100000,0.100000},
-{0.312500,0.962500,0.200000,0.200000},
-{0.337500,0.962500,0.100000,0.100000},
-{0.337500,0.962500,0.200000,0.200000},
-{0.362500,0.962500,0.100000,0.100000},
-{0.362500,0.962500,0.200000,0.200000},
-{0.387500,0.962500,0.100000,0.100000},
-{0.387500,0.962500,0.200000,0.200000},
-{0.412500,0.962500,0.100000,0.100000},
-{0.412500,0.962500,0.200000,0.200000},
-{0.437500,0.962500,0.100000,0.100000},
-{0.437500,0.962500,0.200000,0.200000},
-{0.462500,0.962500,0.100000,0.100000},
-{0.462500,0.962500,0.200000,0.200000},
-{0.487500,0.962500,0.100000,0.100000},
-{0.487500,0.962500,0.200000,0.200000},
-{0.512500,0.962500,0.100000,0.100000},
-{0.512500,0.962500,0.200000,0.200000},
-{0.537500,0.962500,0.100000,0.100000},
-{0.537500,0.962500,0.200000,0.200000},
-{0.562500,0.962500,0.100000,0.100000},
-{0.562500,0.962500,0.200000,0.200000},
-{0.587500,0.962500,0.100000,0.100000},
-{0.587500,0.962500,0.200000,0.200000},
-{0.612500,0.962500,0.100000,0.100000},
-{0.612500,0.962500,0.200000,0.200000},
-{0.637500,0.962500,0.100000,0.100000},
-{0.637500,0.962500,0.200000,0.200000},
-{0.662500,0.962500,0.100000,0.100000},
-{0.662500,0.962500,0.200000,0.200000},
-{0.687500,0.962500,0.100000,0.100000},
-{0.687500,0.962500,0.200000,0.200000},
-{0.712500,0.962500,0.100000,0.100000},
-{0.712500,0.962500,0.200000,0.200000},
-{0.737500,0.962500,0.100000,0.100000},
-{0.737500,0.962500,0.200000,0.200000},
-{0.762500,0.962500,0.100000,0.100000},
-{0.762500,0.962500,0.200000,0.200000},
-{0.787500,0.962500,0.100000,0.100000},
-{0.787500,0.962500,0.200000,0.200000},
-{0.812500,0.962500,0.100000,0.100000},
-{0.812500,0.962500,0.200000,0.200000},
-{0.837500,0.962500,0.100000,0.100000},
-{0.837500,0.962500,0.200000,0.200000},
-{0.862500,0.962500,0.100000,0.100000},
-{0.862500,0.962500,0.200000,0.200000},
-{0.887500,0.962500,0.100000,0.100000},
-{0.887500,0.962500,0.200000,0.200000},
-{0.912500,0.962500,0.100000,0.100000},
-{0.912500,0.962500,0.200000,0.200000},
-{0.937500,0.962500,0.100000,0.100000},
-{0.937500,0.962500,0.200000,0.200000},
-{0.962500,0.962500,0.100000,0.100000},
-{0.962500,0.962500,0.200000,0.200000},
-{0.987500,0.962500,0.100000,0.100000},
-{0.987500,0.962500,0.200000,0.200000},
-{0.012500,0.987500,0.100000,0.100000},
-{0.012500,0.987500,0.200000,0.200000},
-{0.037500,0.987500,0.100000,0.100000},
-{0.037500,0.987500,0.200000,0.200000},
-{0.062500,0.987500,0.100000,0.100000},
-{0.062500,0.987500,0.200000,0.200000},
-{0.087500,0.987500,0.100000,0.100000},
-{0.087500,0.987500,0.200000,0.200000},
-{0.112500,0.987500,0.100000,0.100000},
-{0.112500,0.987500,0.200000,0.200000},
-{0.137500,0.987500,0.100000,0.100000},
-{0.137500,0.987500,0.200000,0.200000},
-{0.162500,0.987500,0.100000,0.100000},
-{0.162500,0.987500,0.200000,0.200000},
-{0.187500,0.987500,0.100000,0.100000},
-{0.187500,0.987500,0.200000,0.200000},
-{0.212500,0.987500,0.100000,0.100000},
-{0.212500,0.987500,0.200000,0.200000},
-{0.237500,0.987500,0.100000,0.100000},
-{0.237500,0.987500,0.200000,0.200000},
-{0.262500,0.987500,0.100000,0.100000},
-{0.262500,0.987500,0.200000,0.200000},
-{0.287500,0.987500,0.100000,0.100000},
-{0.287500,0.987500,0.200000,0.200000},
-{0.312500,0.987500,0.100000,0.100000},
-{0.312500,0.987500,0.200000,0.200000},
-{0.337500,0.987500,0.100000,0.100000},
-{0.337500,0.987500,0.200000,0.200000},
-{0.362500,0.987500,0.100000,0.100000},
-{0.362500,0.987500,0.200000,0.200000},
-{0.387500,0.987500,0.100000,0.100000},
-{0.387500,0.987500,0.200000,0.200000},
-{0.412500,0.987500,0.100000,0.100000},
-{0.412500,0.987500,0.200000,0.200000},
-{0.437500,0.987500,0.100000,0.100000},
-{0.437500,0.987500,0.200000,0.200000},
-{0.462500,0.987500,0.100000,0.100000},
-{0.462500,0.987500,0.200000,0.200000},
-{0.487500,0.987500,0.100000,0.100000},
-{0.487500,0.987500,0.200000,0.200000},
-{0.512500,0.987500,0.100000,0.100000},
-{0.512500,0.987500,0.200000,0.200000},
-{0.537500,0.987500,0.100000,0.100000},
-{0.537500,0.987500,0.200000,0.200000},
-{0.562500,0.987500,0.100000,0.100000},
-{0.562500,0.987500,0.200000,0.200000},
-{0.587500,0.987500,0.100000,0.100000},
-{0.587500,0.987500,0.200000,0.200000},
-{0.612500,0.987500,0.100000,0.100000},
-{0.612500,0.987500,0.200000,0.200000},
-{0.637500,0.987500,0.100000,0.100000},
-{0.637500,0.987500,0.200000,0.200000},
-{0.662500,0.987500,0.100000,0.100000},
-{0.662500,0.987500,0.200000,0.200000},
-{0.687500,0.987500,0.100000,0.100000},
-{0.687500,0.987500,0.200000,0.200000},
-{0.712500,0.987500,0.100000,0.100000},
-{0.712500,0.987500,0.200000,0.200000},
-{0.737500,0.987500,0.100000,0.100000},
-{0.737500,0.987500,0.200000,0.200000},
-{0.762500,0.987500,0.100000,0.100000},
-{0.762500,0.987500,0.200000,0.200000},
-{0.787500,0.987500,0.100000,0.100000},
-{0.787500,0.987500,0.200000,0.200000},
-{0.812500,0.987500,0.100000,0.100000},
-{0.812500,0.987500,0.200000,0.200000},
-{0.837500,0.987500,0.100000,0.100000},
-{0.837500,0.987500,0.200000,0.200000},
-{0.862500,0.987500,0.100000,0.100000},
-{0.862500,0.987500,0.200000,0.200000},
-{0.887500,0.987500,0.100000,0.100000},
-{0.887500,0.987500,0.200000,0.200000},
-{0.912500,0.987500,0.100000,0.100000},
-{0.912500,0.987500,0.200000,0.200000},
-{0.937500,0.987500,0.100000,0.100000},
-{0.937500,0.987500,0.200000,0.200000},
-{0.962500,0.987500,0.100000,0.100000},
-{0.962500,0.987500,0.200000,0.200000},
-{0.987500,0.987500,0.100000,0.100000},
-{0.987500,0.987500,0.200000,0.200000},
-{0.025000,0.025000,0.400000,0.400000},
-{0.025000,0.025000,0.800000,0.800000},
-{0.075000,0.025000,0.400000,0.400000},
-{0.075000,0.025000,0.800000,0.800000},
-{0.125000,0.025000,0.400000,0.400000},
-{0.125000,0.025000,0.800000,0.800000},
-{0.175000,0.025000,0.400000,0.400000},
-{0.175000,0.025000,0.800000,0.800000},
-{0.225000,0.025000,0.400000,0.400000},
-{0.225000,0.025000,0.800000,0.800000},
-{0.275000,0.025000,0.400000,0.400000},
-{0.275000,0.025000,0.800000,0.800000},
-{0.325000,0.025000,0.400000,0.400000},
-{0.325000,0.025000,0.800000,0.800000},
-{0.375000,0.025000,0.400000,0.400000},
-{0.375000,0.025000,0.800000,0.800000},
-{0.425000,0.025000,0.400000,0.400000},
-{0.425000,0.025000,0.800000,0.800000},
-{0.475000,0.025000,0.400000,0.400000},
-{0.475000,0.025000,0.800000,0.800000},
-{0.525000,0.025000,0.400000,0.400000},
-{0.525000,0.025000,0.800000,0.800000},
-{0.575000,0.025000,0.400000,0.400000},
-{0.575000,0.025000,0.800000,0.800000},
-{0.625000,0.025000,0.400000,0.400000},
-{0.625000,0.025000,0.800000,0.800000},
-{0.675000,0.025000,0.400000,0.400000},
-{0.675000,0.025000,0.800000,0.800000},
-{0.725000,0.025000,0.400000,0.400000},
-{0.725000,0.025000,0.800000,0.800000},
-{0.775000,0.025000,0.400000,0.400000},
-{0.775000,0.025000,0.800000,0.800000},
-{0.825000,0.025000,0.400000,0.400000},
-{0.825000,0.025000,0.800000,0.800000},
-{0.875000,0.025000,0.400000,0.400000},
-{0.875000,0.025000,0.800000,0.800000},
-{0.925000,0.025000,0.400000,0.400000},
-{0.925000,0.025000,0.800000,0.800000},
-{0.975000,0.025000,0.400000,0.400000},
-{0.975000,0.025000,0.800000,0.800000},
-{0.025000,0.075000,0.400000,0.400000},
-{0.025000,0.075000,0.800000,0.800000},
-{0.075000,0.075000,0.400000,0.400000},
-{0.075000,0.075000,0.800000,0.800000},
-{0.125000,0.075000,0.400000,0.400000},
-{0.125000,0.075000,0.800000,0.800000},
-{0.175000,0.075000,0.400000,0.400000},
-{0.175000,0.075000,0.800000,0.800000},
-{0.225000,0.075000,0.400000,0.400000},
-{0.225000,0.075000,0.800000,0.800000},
-{0.275000,0.075000,0.400000,0.400000},
-{0.275000,0.075000,0.800000,0.800000},
-{0.325000,0.075000,0.400000,0.400000},
-{0.325000,0.075000,0.800000,0.800000},
-{0.375000,0.075000,0.400000,0.400000},
-{0.375000,0.075000,0.800000,0.800000},
-{0.425000,0.075000,0.400000,0.400000},
-{0.425000,0.075000,0.800000,0.800000},
-{0.475000,0.075000,0.400000,0.400000},
-{0.475000,0.075000,0.800000,0.800000},
-{0.525000,0.075000,0.400000,0.400000},
-{0.525000,0.075000,0.800000,0.800000},
-{0.575000,0.075000,0.400000,0.400000},
-{0.575000,0.075000,0.800000,0.800000},
-{0.625000,0.075000,0.400000,0.400000},
-{0.625000,0.075000,0.800000,0.800000},
-{0.675000,0.075000,0.400000,0.400000},
-{0.675000,0.075000,0.800000,0.800000},
-{0.725000,0.075000,0.400000,0.400000},
-{0.725000,0.075000,0.800000,0.800000},
-{0.775000,0.075000,0.400000,0.400000},
-{0.775000,0.075000,0.800000,0.800000},
-{0.825000,0.075000,0.400000,0.400000},
-{0.825000,0.075000,0.800000,0.800000},
-{0.875000,0.075000,0.400000,0.400000},
-{0.875000,0.075000,0.800000,0.800000},
-{0.925000,0.075000,0.400000,0.400000},
-{0.925000,0.075000,0.800000,0.800000},
-{0.975000,0.075000,0.400000,0.400000},
-{0.975000,0.075000,0.800000,0.800000},
-{0.025000,0.125000,0.400000,0.400000},
-{0.025000,0.125000,0.800000,0.800000},
-{0.075000,0.125000,0.400000,0.400000},
-{0.075000,0.125000,0.800000,0.800000},
-{0.125000,0.125000,0.400000,0.400000},
-{0.125000,0.125000,0.800000,0.800000},
-{0.175000,0.125000,0.400000,0.400000},
-{0.175000,0.125000,0.800000,0.800000},
-{0.225000,0.125000,0.400000,0.400000},
-{0.225000,0.125000,0.800000,0.800000},
-{0.275000,0.125000,0.400000,0.400000},
-{0.275000,0.125000,0.800000,0.800000},
-{0.325000,0.125000,0.400000,0.400000},
-{0.325000,0.125000,0.800000,0.800000},
-{0.375000,0.125000,0.400000,0.400000},
-{0.375000,0.125000,0.800000,0.800000},
-{0.425000,0.125000,0.400000,0.400000},
-{0.425000,0.125000,0.800000,0.800000},
-{0.475000,0.125000,0.400000,0.400000},
-{0.475000,0.125000,0.800000,0.800000},
-{0.525000,0.125000,0.400000,0.400000},
-{0.525000,0.125000,0.800000,0.800000},
-{0.575000,0.125000,0.400000,0.400000},
-{0.575000,0.125000,0.800000,0.800000},
-{0.625000,0.125000,0.400000,0.400000},
-{0.625000,0.125000,0.800000,0.800000},
-{0.675000,0.125000,0.400000,0.400000},
-{0.675000,0.125000,0.800000,0.800000},
-{0.725000,0.125000,0.400000,0.400000},
-{0.725000,0.125000,0.800000,0.800000},
-{0.775000,0.125000,0.400000,0.400000},
-{0.775000,0.125000,0.800000,0.800000},
-{0.825000,0.125000,0.400000,0.400000},
-{0.825000,0.125000,0.800000,0.800000},
-{0.875000,0.125000,0.400000,0.400000},
-{0.875000,0.125000,0.800000,0.800000},
-{0.925000,0.125000,0.400000,0.400000},
-{0.925000,0.125000,0.800000,0.800000},
-{0.975000,0.125000,0.400000,0.400000},
-{0.975000,0.125000,0.800000,0.800000},
-{0.025000,0.175000,0.400000,0.400000},
-{0.025000,0.175000,0.800000,0.800000},
-{0.075000,0.175000,0.400000,0.400000},
-{0.075000,0.175000,0.800000,0.800000},
-{0.125000,0.175000,0.400000,0.400000},
-{0.125000,0.175000,0.800000,0.800000},
-{0.175000,0.175000,0.400000,0.400000},
-{0.175000,0.175000,0.800000,0.800000},
-{0.225000,0.175000,0.400000,0.400000},
-{0.225000,0.175000,0.800000,0.800000},
-{0.275000,0.175000,0.400000,0.400000},
-{0.275000,0.175000,0.800000,0.800000},
-{0.325000,0.175000,0.400000,0.400000},
-{0.325000,0.175000,0.800000,0.800000},
-{0.375000,0.175000,0.400000,0.400000},
-{0.375000,0.175000,0.800000,0.800000},
-{0.425000,0.175000,0.400000,0.400000},
-{0.425000,0.175000,0.800000,0.800000},
-{0.475000,0.175000,0.400000,0.400000},
-{0.475000,0.175000,0.800000,0.800000},
-{0.525000,0.175000,0.400000,0.400000},
-{0.525000,0.175000,0.800000,0.800000},
-{0.575000,0.175000,0.400000,0.400000},
-{0.575000,0.175000,0.800000,0.800000},
-{0.625000,0.175000,0.400000,0.400000},
-{0.625000,0.175000,0.800000,0.800000},
-{0.675000,0.175000,0.400000,0.400000},
-{0.675000,0.175000,0.800000,0.800000},
-{0.725000,0.175000,0.400000,0.400000},
-{0.725000,0.175000,0.800000,0.800000},
-{0.775000,0.175000,0.400000,0.400000},
-{0.775000,0.175000,0.800000,0.800000},
-{0.825000,0.175000,0.400000,0.400000},
-{0.825000,0.175000,0.800000,0.800000},
-{0.875000,0.175000,0.400000,0.400000},
-{0.875000,0.175000,0.800000,0.800000},
-{0.925000,0.175000,0.400000,0.400000},
-{0.925000,0.175000,0.800000,0.800000},
-{0.975000,0.175000,0.400000,0.400000},
-{0.975000,0.175000,0.800000,0.800000},
-{0.025000,0.225000,0.400000,0.400000},
-{0.025000,0.225000,0.800000,0.800000},
-{0.075000,0.225000,0.400000,0.400000},
-{0.075000,0.225000,0.800000,0.800000},
-{0.125000,0.225000,0.400000,0.400000},
-{0.125000,0.225000,0.800000,0.800000},
-{0.175000,0.225000,0.400000,0.400000},
-{0.175000,0.225000,0.800000,0.800000},
-{0.225000,0.225000,0.400000,0.400000},
-{0.225000,0.225000,0.800000,0.800000},
-{0.275000,0.225000,0.400000,0.400000},
-{0.275000,0.225000,0.800000,0.800000},
-{0.325000,0.225000,0.400000,0.400000},
-{0.325000,0.225000,0.800000,0.800000},
-{0.375000,0.225000,0.400000,0.400000},
-{0.375000,0.225000,0.800000,0.800000},
-{0.425000,0.225000,0.400000,0.400000},
-{0.425000,0.225000,0.800000,0.800000},
-{0.475000,0.225000,0.400000,0.400000},
-{0.475000,0.225000,0.800000,0.800000},
-{0.525000,0.225000,0.400000,0.400000},
-{0.525000,0.225000,0.800000,0.800000},
-{0.575000,0.225000,0.400000,0.400000},
-{0.575000,0.225000,0.800000,0.800000},
-{0.625000,0.225000,0.400000,0.400000},
-{0.625000,0.225000,0.800000,0.800000},
-{0.675000,0.225000,0.400000,0.400000},
-{0.675000,0.225000,0.800000,0.800000},
-{0.725000,0.225000,0.400000,0.400000},
-{0.725000,0.225000,0.800000,0.800000},
-{0.775000,0.225000,0.400000,0.400000},
-{0.775000,0.225000,0.800000,0.800000},
-{0.825000,0.225000,0.400000,0.400000},
-{0.825000,0.225000,0.800000,0.800000},
-{0.875000,0.225000,0.400000,0.400000},
-{0.875000,0.225000,0.800000,0.800000},
-{0.925000,0.225000,0.400000,0.400000},
-{0.925000,0.225000,0.800000,0.800000},
-{0.975000,0.225000,0.400000,0.400000},
-{0.975000,0.225000,0.800000,0.800000},
-{0.025000,0.275000,0.400000,0.400000},
-{0.025000,0.275000,0.800000,0.800000},
-{0.075000,0.275000,0.400000,0.400000},
-{0.075000,0.275000,0.800000,0.800000},
-{0.125000,0.275000,0.400000,0.400000},
-{0.125000,0.275000,0.800000,0.800000},
-{0.175000,0.275000,0.400000,0.400000},
-{0.175000,0.275000,0.800000,0.800000},
-{0.225000,0.275000,0.400000,0.400000},
-{0.225000,0.275000,0.800000,0.800000},
-{0.275000,0.275000,0.400000,0.400000},
-{0.275000,0.275000,0.800000,0.800000},
-{0.325000,0.275000,0.400000,0.400000},
-{0.325000,0.275000,0.800000,0.800000},
-{0.375000,0.275000,0.400000,0.400000},
-{0.375000,0.275000,0.800000,0.800000},
-{0.425000,0.275000,0.400000,0.400000},
-{0.425000,0.275000,0.800000,0.800000},
-{0.475000,0.275000,0.400000,0.400000},
-{0.475000,0.275000,0.800000,0.800000},
-{0.525000,0.275000,0.400000,0.400000},
-{0.525000,0.275000,0.800000,0.800000},
-{0.575000,0.275000,0.400000,0.400000},
-{0.575000,0.275000,0.800000,0.800000},
-{0.625000,0.275000,0.400000,0.400000},
-{0.625000,0.275000,0.800000,0.800000},
-{0.675000,0.275000,0.400000,0.400000},
-{0.675000,0.275000,0.800000,0.800000},
-{0.725000,0.275000,0.400000,0.400000},
-{0.725000,0.275000,0.800000,0.800000},
-{0.775000,0.275000,0.400000,0.400000},
-{0.775000,0.275000,0.800000,0.800000},
-{0.825000,0.275000,0.400000,0.400000},
-{0.825000,0.275000,0.800000,0.800000},
-{0.875000,0.275000,0.400000,0.400000},
-{0.875000,0.275000,0.800000,0.800000},
-{0.925000,0.275000,0.400000,0.400000},
-{0.925000,0.275000,0.800000,0.800000},
-{0.975000,0.275000,0.400000,0.400000},
-{0.975000,0.275000,0.800000,0.800000},
-{0.025000,0.325000,0.400000,0.400000},
-{0.025000,0.325000,0.800000,0.800000},
-{0.075000,0.325000,0.400000,0.400000},
-{0.075000,0.325000,0.800000,0.800000},
-{0.125000,0.325000,0.400000,0.400000},
-{0.125000,0.325000,0.800000,0.800000},
-{0.175000,0.325000,0.400000,0.400000},
-{0.175000,0.325000,0.800000,0.800000},
-{0.225000,0.325000,0.400000,0.400000},
-{0.225000,0.325000,0.800000,0.800000},
-{0.275000,0.325000,0.400000,0.400000},
-{0.275000,0.325000,0.800000,0.800000},
-{0.325000,0.325000,0.400000,0.400000},
-{0.325000,0.325000,0.800000,0.800000},
-{0.375000,0.325000,0.400000,0.400000},
-{0.375000,0.325000,0.800000,0.800000},
-{0.425000,0.325000,0.400000,0.400000},
-{0.425000,0.325000,0.800000,0.800000},
-{0.475000,0.325000,0.400000,0.400000},
-{0.475000,0.325000,0.800000,0.800000},
-{0.525000,0.325000,0.400000,0.400000},
-{0.525000,0.325000,0.800000,0.800000},
-{0.575000,0.325000,0.400000,0.400000},
-{0.575000,0.325000,0.800000,0.800000},
-{0.625000,0.325000,0.400000,0.400000},
-{0.625000,0.325000,0.800000,0.800000},
-{0.675000,0.325000,0.400000,0.400000},
-{0.675000,0.325000,0.800000,0.800000},
-{0.725000,0.325000,0.400000,0.400000},
-{0.725000,0.325000,0.800000,0.800000},
-{0.775000,0.325000,0.400000,0.400000},
-{0.775000,0.325000,0.800000,0.800000},
-{0.825000,0.325000,0.400000,0.400000},
-{0.825000,0.325000,0.800000,0.800000},
-{0.875000,0.325000,0.400000,0.400000},
-{0.875000,0.325000,0.800000,0.800000},
-{0.925000,0.325000,0.400000,0.400000},
-{0.925000,0.325000,0.800000,0.800000},
-{0.975000,0.325000,0.400000,0.400000},
-{0.975000,0.325000,0.800000,0.800000},
-{0.025000,0.375000,0.400000,0.400000},
-{0.025000,0.375000,0.800000,0.800000},
-{0.075000,0.375000,0.400000,0.400000},
-{0.075000,0.375000,0.800000,0.800000},
-{0.125000,0.375000,0.400000,0.400000},
-{0.125000,0.375000,0.800000,0.800000},
-{0.175000,0.375000,0.400000,0.400000},
-{0.175000,0.375000,0.800000,0.800000},
-{0.225000,0.375000,0.400000,0.400000},
-{0.225000,0.375000,0.800000,0.800000},
-{0.275000,0.375000,0.400000,0.400000},
-{0.275000,0.375000,0.800000,0.800000},
-{0.325000,0.375000,0.400000,0.400000},
-{0.325000,0.375000,0.800000,0.800000},
-{0.375000,0.375000,0.400000,0.400000},
-{0.375000,0.375000,0.800000,0.800000},
-{0.425000,0.375000,0.400000,0.400000},
-{0.425000,0.375000,0.800000,0.800000},
-{0.475000,0.375000,0.400000,0.400000},
-{0.475000,0.375000,0.800000,0.800000},
-{0.525000,0.375000,0.400000,0.400000},
-{0.525000,0.375000,0.800000,0.800000},
-{0.575000,0.375000,0.400000,0.400000},
-{0.575000,0.375000,0.800000,0.800000},
-{0.625000,0.375000,0.400000,0.400000},
-{0.625000,0.375000,0.800000,0.800000},
-{0.675000,0.375000,0.400000,0.400000},
-{0.675000,0.375000,0.800000,0.800000},
-{0.725000,0.375000,0.400000,0.400000},
-{0.725000,0.375000,0.800000,0.800000},
-{0.775000,0.375000,0.400000,0.400000},
-{0.775000,0.375000,0.800000,0.800000},
-{0.825000,0.375000,0.400000,0.400000},
-{0.825000,0.375000,0.800000,0.800000},
-{0.875000,0.375000,0.400000,0.400000},
-{0.875000,0.375000,0.800000,0.800000},
-{0.925000,0.375000,0.400000,0.400000},
-{0.925000,0.375000,0.800000,0.800000},
-{0.975000,0.375000,0.400000,0.400000},
-{0.975000,0.375000,0.800000,0.800000},
-{0.025000,0.425000,0.400000,0.400000},
-{0.025000,0.425000,0.800000,0.800000},
-{0.075000,0.425000,0.400000,0.400000},
-{0.075000,0.425000,0.800000,0.800000},
-{0.125000,0.425000,0.400000,0.400000},
-{0.125000,0.425000,0.800000,0.800000},
-{0.175000,0.425000,0.400000,0.400000},
-{0.175000,0.425000,0.800000,0.800000},
-{0.225000,0.425000,0.400000,0.400000},
-{0.225000,0.425000,0.800000,0.800000},
-{0.275000,0.425000,0.400000,0.400000},
-{0.275000,0.425000,0.800000,0.800000},
-{0.325000,0.425000,0.400000,0.400000},
-{0.325000,0.425000,0.800000,0.800000},
-{0.375000,0.425000,0.400000,0.400000},
-{0.375000,0.425000,0.800000,0.800000},
-{0.425000,0.425000,0.400000,0.400000},
-{0.425000,0.425000,0.800000,0.800000},
-{0.475000,0.425000,0.400000,0.400000},
-{0.475000,0.425000,0.800000,0.800000},
-{0.525000,0.425000,0.400000,0.400000},
-{0.525000,0.425000,0.800000,0.800000},
-{0.575000,0.425000,0.400000,0.400000},
-{0.575000,0.425000,0.800000,0.800000},
-{0.625000,0.425000,0.400000,0.400000},
-{0.625000,0.425000,0.800000,0.800000},
-{0.675000,0.425000,0.400000,0.400000},
-{0.675000,0.425000,0.800000,0.800000},
-{0.725000,0.425000,0.400000,0.400000},
-{0.725000,0.425000,0.800000,0.800000},
-{0.775000,0.425000,0.400000,0.400000},
-{0.775000,0.425000,0.800000,0.800000},
-{0.825000,0.425000,0.400000,0.400000},
-{0.825000,0.425000,0.800000,0.800000},
-{0.875000,0.425000,0.400000,0.400000},
-{0.875000,0.425000,0.800000,0.800000},
-{0.925000,0.425000,0.400000,0.400000},
-{0.925000,0.425000,0.800000,0.800000},
-{0.975000,0.425000,0.400000,0.400000},
-{0.975000,0.425000,0.800000,0.800000},
-{0.025000,0.475000,0.400000,0.400000},
-{0.025000,0.475000,0.800000,0.800000},
-{0.075000,0.475000,0.400000,0.400000},
-{0.075000,0.475000,0.800000,0.800000},
-{0.125000,0.475000,0.400000,0.400000},
-{0.125000,0.475000,0.800000,0.800000},
-{0.175000,0.475000,0.400000,0.400000},
-{0.175000,0.475000,0.800000,0.800000},
-{0.225000,0.475000,0.400000,0.400000},
-{0.225000,0.475000,0.800000,0.800000},
-{0.275000,0.475000,0.400000,0.400000},
-{0.275000,0.475000,0.800000,0.800000},
-{0.325000,0.475000,0.400000,0.400000},
-{0.325000,0.475000,0.800000,0.800000},
-{0.375000,0.475000,0.400000,0.400000},
-{0.375000,0.475000,0.800000,0.800000},
-{0.425000,0.475000,0.400000,0.400000},
-{0.425000,0.475000,0.800000,0.800000},
-{0.475000,0.475000,0.400000,0.400000},
-{0.475000,0.475000,0.800000,0.800000},
-{0.525000,0.475000,0.400000,0.400000},
-{0.525000,0.475000,0.800000,0.800000},
-{0.575000,0.475000,0.400000,0.400000},
-{0.575000,0.475000,0.800000,0.800000},
-{0.625000,0.475000,0.400000,0.400000},
-{0.625000,0.475000,0.800000,0.800000},
-{0.675000,0.475000,0.400000,0.400000},
-{0.675000,0.475000,0.800000,0.800000},
-{0.725000,0.475000,0.400000,0.400000},
-{0.725000,0.475000,0.800000,0.800000},
-{0.775000,0.475000,0.400000,0.400000},
-{0.775000,0.475000,0.800000,0.800000},
-{0.825000,0.475000,0.400000,0.400000},
-{0.825000,0.475000,0.800000,0.800000},
-{0.875000,0.475000,0.400000,0.400000},
-{0.875000,0.475000,0.800000,0.800000},
-{0.925000,0.475000,0.400000,0.400000},
-{0.925000,0.475000,0.800000,0.800000},
-{0.975000,0.475000,0.400000,0.400000},
-{0.975000,0.475000,0.800000,0.800000},
-{0.025000,0.525000,0.400000,0.400000},
-{0.025000,0.525000,0.800000,0.800000},
-{0.075000,0.525000,0.400000,0.400000},
-{0.075000,0.525000,0.800000,0.800000},
-{0.125000,0.525000,0.400000,0.400000},
-{0.125000,0.525000,0.800000,0.800000},
-{0.175000,0.525000,0.400000,0.400000},
-{0.175000,0.525000,0.800000,0.800000},
-{0.225000,0.525000,0.400000,0.400000},
-{0.225000,0.525000,0.800000,0.800000},
-{0.275000,0.525000,0.400000,0.400000},
-{0.275000,0.525000,0.800000,0.800000},
-{0.325000,0.525000,0.400000,0.400000},
-{0.325000,0.525000,0.800000,0.800000},
-{0.375000,0.525000,0.400000,0.400000},
-{0.375000,0.525000,0.800000,0.800000},
-{0.425000,0.525000,0.400000,0.400000},
-{0.425000,0.525000,0.800000,0.800000},
-{0.475000,0.525000,0.400000,0.400000},
-{0.475000,0.525000,0.800000,0.800000},
-{0.525000,0.525000,0.400000,0.400000},
-{0.525000,0.525000,0.800000,0.800000},
-{0.575000,0.525000,0.400000,0.400000},
-{0.575000,0.525000,0.800000,0.800000},
-{0.625000,0.525000,0.400000,0.400000},
-{0.625000,0.525000,0.800000,0.800000},
-{0.675000,0.525000,0.400000,0.400000},
-{0.675000,0.525000,0.800000,0.800000},
-{0.725000,0.525000,0.400000,0.400000},
-{0.725000,0.525000,0.800000,0.800000},
-{0.775000,0.525000,0.400000,0.400000},
-{0.775000,0.525000,0.800000,0.800000},
-{0.825000,0.525000,0.400000,0.400000},
-{0.825000,0.525000,0.800000,0.800000},
-{0.875000,0.525000,0.400000,0.400000},
-{0.875000,0.525000,0.800000,0.800000},
-{0.925000,0.525000,0.400000,0.400000},
-{0.925000,0.525000,0.800000,0.800000},
-{0.975000,0.525000,0.400000,0.400000},
-{0.975000,0.525000,0.800000,0.800000},
-{0.025000,0.575000,0.400000,0.400000},
-{0.025000,0.575000,0.800000,0.800000},
-{0.075000,0.575000,0.400000,0.400000},
-{0.075000,0.575000,0.800000,0.800000},
-{0.125000,0.575000,0.400000,0.400000},
-{0.125000,0.575000,0.800000,0.800000},
-{0.175000,0.575000,0.400000,0.400000},
-{0.175000,0.575000,0.800000,0.800000},
-{0.225000,0.575000,0.400000,0.400000},
-{0.225000,0.575000,0.800000,0.800000},
-{0.275000,0.575000,0.400000,0.400000},
-{0.275000,0.575000,0.800000,0.800000},
-{0.325000,0.575000,0.400000,0.400000},
-{0.325000,0.575000,0.800000,0.800000},
-{0.375000,0.575000,0.400000,0.400000},
-{0.375000,0.575000,0.800000,0.800000},
-{0.425000,0.575000,0.400000,0.400000},
-{0.425000,0.575000,0.800000,0.800000},
-{0.475000,0.575000,0.400000,0.400000},
-{0.475000,0.575000,0.800000,0.800000},
-{0.525000,0.575000,0.400000,0.400000},
-{0.525000,0.575000,0.800000,0.800000},
-{0.575000,0.575000,0.400000,0.400000},
-{0.575000,0.575000,0.800000,0.800000},
-{0.625000,0.575000,0.400000,0.400000},
-{0.625000,0.575000,0.800000,0.800000},
-{0.675000,0.575000,0.400000,0.400000},
-{0.675000,0.575000,0.800000,0.800000},
-{0.725000,0.575000,0.400000,0.400000},
-{0.725000,0.575000,0.800000,0.800000},
-{0.775000,0.575000,0.400000,0.400000},
-{0.775000,0.575000,0.800000,0.800000},
-{0.825000,0.575000,0.400000,0.400000},
-{0.825000,0.575000,0.800000,0.800000},
-{0.875000,0.575000,0.400000,0.400000},
-{0.875000,0.575000,0.800000,0.800000},
-{0.925000,0.575000,0.400000,0.400000},
-{0.925000,0.575000,0.800000,0.800000},
-{0.975000,0.575000,0.400000,0.400000},
-{0.975000,0.575000,0.800000,0.800000},
-{0.025000,0.625000,0.400000,0.400000},
-{0.025000,0.625000,0.800000,0.800000},
-{0.075000,0.625000,0.400000,0.400000},
-{0.075000,0.625000,0.800000,0.800000},
-{0.125000,0.625000,0.400000,0.400000},
-{0.125000,0.625000,0.800000,0.800000},
-{0.175000,0.625000,0.400000,0.400000},
-{0.175000,0.625000,0.800000,0.800000},
-{0.225000,0.625000,0.400000,0.400000},
-{0.225000,0.625000,0.800000,0.800000},
-{0.275000,0.625000,0.400000,0.400000},
-{0.275000,0.625000,0.800000,0.800000},
-{0.325000,0.625000,0.400000,0.400000},
-{0.325000,0.625000,0.800000,0.800000},
-{0.375000,0.625000,0.400000,0.400000},
-{0.375000,0.625000,0.800000,0.800000},
-{0.425000,0.625000,0.400000,0.400000},
-{0.425000,0.625000,0.800000,0.800000},
-{0.475000,0.625000,0.400000,0.400000},
-{0.475000,0.625000,0.800000,0.800000},
-{0.525000,0.625000,0.400000,0.400000},
-{0.525000,0.625000,0.800000,0.800000},
-{0.575000,0.625000,0.400000,0.400000},
-{0.575000,0.625000,0.800000,0.800000},
-{0.625000,0.625000,0.400000,0.400000},
-{0.625000,0.625000,0.800000,0.800000},
-{0.675000,0.625000,0.400000,0.400000},
-{0.675000,0.625000,0.800000,0.800000},
-{0.725000,0.625000,0.400000,0.400000},
-{0.725000,0.625000,0.800000,0.800000},
-{0.775000,0.625000,0.400000,0.400000},
-{0.775000,0.625000,0.800000,0.800000},
-{0.825000,0.625000,0.400000,0.400000},
-{0.825000,0.625000,0.800000,0.800000},
-{0.875000,0.625000,0.400000,0.400000},
-{0.875000,0.625000,0.800000,0.800000},
-{0.925000,0.625000,0.400000,0.400000},
-{0.925000,0.625000,0.800000,0.800000},
-{0.975000,0.625000,0.400000,0.400000},
-{0.975000,0.625000,0.800000,0.800000},
-{0.025000,0.675000,0.400000,0.400000},
-{0.025000,0.675000,0.800000,0.800000},
-{0.075000,0.675000,0.400000,0.400000},
-{0.075000,0.675000,0.800000,0.800000},
-{0.125000,0.675000,0.400000,0.400000},
-{0.125000,0.675000,0.800000,0.800000},
-{0.175000,0.675000,0.400000,0.400000},
-{0.175000,0.675000,0.800000,0.800000},
-{0.225000,0.675000,0.400000,0.400000},
-{0.225000,0.675000,0.800000,0.800000},
-{0.275000,0.675000,0.400000,0.400000},
-{0.275000,0.675000,0.800000,0.800000},
-{0.325000,0.675000,0.400000,0.400000},
-{0.325000,0.675000,0.800000,0.800000},
-{0.375000,0.675000,0.400000,0.400000},
-{0.375000,0.675000,0.800000,0.800000},
-{0.425000,0.675000,0.400000,0.400000},
-{0.425000,0.675000,0.800000,0.800000},
-{0.475000,0.675000,0.400000,0.400000},
-{0.475000,0.675000,0.800000,0.800000},
-{0.525000,0.675000,0.400000,0.400000},
-{0.525000,0.675000,0.800000,0.800000},
-{0.575000,0.675000,0.400000,0.400000},
-{0.575000,0.675000,0.800000,0.800000},
-{0.625000,0.675000,0.400000,0.400000},
-{0.625000,0.675000,0.800000,0.800000},
-{0.675000,0.675000,0.400000,0.400000},
-{0.675000,0.675000,0.800000,0.800000},
-{0.725000,0.675000,0.400000,0.400000},
-{0.725000,0.675000,0.800000,0.800000},
-{0.775000,0.675000,0.400000,0.400000},
-{0.775000,0.675000,0.800000,0.800000},
-{0.825000,0.675000,0.400000,0.400000},
-{0.825000,0.675000,0.800000,0.800000},
-{0.875000,0.675000,0.400000,0.400000},
-{0.875000,0.675000,0.800000,0.800000},
-{0.925000,0.675000,0.400000,0.400000},
-{0.925000,0.675000,0.800000,0.800000},
-{0.975000,0.675000,0.400000,0.400000},
-{0.975000,0.675000,0.800000,0.800000},
-{0.025000,0.725000,0.400000,0.400000},
-{0.025000,0.725000,0.800000,0.800000},
-{0.075000,0.725000,0.400000,0.400000},
-{0.075000,0.725000,0.800000,0.800000},
-{0.125000,0.725000,0.400000,0.400000},
-{0.125000,0.725000,0.800000,0.800000},
-{0.175000,0.725000,0.400000,0.400000},
-{0.175000,0.725000,0.800000,0.800000},
-{0.225000,0.725000,0.400000,0.400000},
-{0.225000,0.725000,0.800000,0.800000},
-{0.275000,0.725000,0.400000,0.400000},
-{0.275000,0.725000,0.800000,0.800000},
-{0.325000,0.725000,0.400000,0.400000},
-{0.325000,0.725000,0.800000,0.800000},
-{0.375000,0.725000,0.400000,0.400000},
-{0.375000,0.725000,0.800000,0.800000},
-{0.425000,0.725000,0.400000,0.400000},
-{0.425000,0.725000,0.800000,0.800000},
-{0.475000,0.725000,0.400000,0.400000},
-{0.475000,0.725000,0.800000,0.800000},
-{0.525000,0.725000,0.400000,0.400000},
-{0.525000,0.725000,0.800000,0.800000},
-{0.575000,0.725000,0.400000,0.400000},
-{0.575000,0.725000,0.800000,0.800000},
-{0.625000,0.725000,0.400000,0.400000},
-{0.625000,0.725000,0.800000,0.800000},
-{0.675000,0.725000,0.400000,0.400000},
-{0.675000,0.725000,0.800000,0.800000},
-{0.725000,0.725000,0.400000,0.400000},
-{0.725000,0.725000,0.800000,0.800000},
-{0.775000,0.725000,0.400000,0.400000},
-{0.775000,0.725000,0.800000,0.800000},
-{0.825000,0.725000,0.400000,0.400000},
-{0.825000,0.725000,0.800000,0.800000},
-{0.875000,0.725000,0.400000,0.400000},
-{0.875000,0.725000,0.800000,0.800000},
-{0.925000,0.725000,0.400000,0.400000},
-{0.925000,0.725000,0.800000,0.800000},
-{0.975000,0.725000,0.400000,0.400000},
-{0.975000,0.725000,0.800000,0.800000},
-{0.025000,0.775000,0.400000,0.400000},
-{0.025000,0.775000,0.800000,0.800000},
-{0.075000,0.775000,0.400000,0.400000},
-{0.075000,0.775000,0.800000,0.800000},
-{0.125000,0.775000,0.400000,0.400000},
-{0.125000,0.775000,0.800000,0.800000},
-{0.175000,0.775000,0.400000,0.400000},
-{0.175000,0.775000,0.800000,0.800000},
-{0.225000,0.775000,0.400000,0.400000},
-{0.225000,0.775000,0.800000,0.800000},
-{0.275000,0.775000,0.400000,0.400000},
-{0.275000,0.775000,0.800000,0.800000},
-{0.325000,0.775000,0.400000,0.400000},
-{0.325000,0.775000,0.800000,0.800000},
-{0.375000,0.775000,0.400000,0.400000},
-{0.375000,0.775000,0.800000,0.800000},
-{0.425000,0.775000,0.400000,0.400000},
-{0.425000,0.775000,0.800000,0.800000},
-{0.475000,0.775000,0.400000,0.400000},
-{0.475000,0.775000,0.800000,0.800000},
-{0.525000,0.775000,0.400000,0.400000},
-{0.525000,0.775000,0.800000,0.800000},
-{0.575000,0.775000,0.400000,0.400000},
-{0.575000,0.775000,0.800000,0.800000},
-{0.625000,0.775000,0.400000,0.400000},
-{0.625000,0.775000,0.800000,0.800000},
-{0.675000,0.775000,0.400000,0.400000},
-{0.675000,0.775000,0.800000,0.800000},
-{0.725000,0.775000,0.400000,0.400000},
-{0.725000,0.775000,0.800000,0.800000},
-{0.775000,0.775000,0.400000,0.400000},
-{0.775000,0.775000,0.800000,0.800000},
-{0.825000,0.775000,0.400000,0.400000},
-{0.825000,0.775000,0.800000,0.800000},
-{0.875000,0.775000,0.400000,0.400000},
-{0.875000,0.775000,0.800000,0.800000},
-{0.925000,0.775000,0.400000,0.400000},
-{0.925000,0.775000,0.800000,0.800000},
-{0.975000,0.775000,0.400000,0.400000},
-{0.975000,0.775000,0.800000,0.800000},
-{0.025000,0.825000,0.400000,0.400000},
-{0.025000,0.825000,0.800000,0.800000},
-{0.075000,0.825000,0.400000,0.400000},
-{0.075000,0.825000,0.800000,0.800000},
-{0.125000,0.825000,0.400000,0.400000},
-{0.125000,0.825000,0.800000,0.800000},
-{0.175000,0.825000,0.400000,0.400000},
-{0.175000,0.825000,0.800000,0.800000},
-{0.225000,0.825000,0.400000,0.400000},
-{0.225000,0.825000,0.800000,0.800000},
-{0.275000,0.825000,0.400000,0.400000},
-{0.275000,0.825000,0.800000,0.800000},
-{0.325000,0.825000,0.400000,0.400000},
-{0.325000,0.825000,0.800000,0.800000},
-{0.375000,0.825000,0.400000,0.400000},
-{0.375000,0.825000,0.800000,0.800000},
-{0.425000,0.825000,0.400000,0.400000},
-{0.425000,0.825000,0.800000,0.800000},
-{0.475000,0.825000,0.400000,0.400000},
-{0.475000,0.825000,0.800000,0.800000},
-{0.525000,0.825000,0.400000,0.400000},
-{0.525000,0.825000,0.800000,0.800000},
-{0.575000,0.825000,0.400000,0.400000},
-{0.575000,0.825000,0.800000,0.800000},
-{0.625000,0.825000,0.400000,0.400000},
-{0.625000,0.825000,0.800000,0.800000},
-{0.675000,0.825000,0.400000,0.400000},
-{0.675000,0.825000,0.800000,0.800000},
-{0.725000,0.825000,0.400000,0.400000},
-{0.725000,0.825000,0.800000,0.800000},
-{0.775000,0.825000,0.400000,0.400000},
-{0.775000,0.825000,0.800000,0.800000},
-{0.825000,0.825000,0.400000,0.400000},
-{0.825000,0.825000,0.800000,0.800000},
-{0.875000,0.825000,0.400000,0.400000},
-{0.875000,0.825000,0.800000,0.800000},
-{0.925000,0.825000,0.400000,0.400000},
-{0.925000,0.825000,0.800000,0.800000},
-{0.975000,0.825000,0.400000,0.400000},
-{0.975000,0.825000,0.800000,0.800000},
-{0.025000,0.875000,0.400000,0.400000},
-{0.025000,0.875000,0.800000,0.800000},
-{0.075000,0.875000,0.400000,0.400000},
-{0.075000,0.875000,0.800000,0.800000},
-{0.125000,0.875000,0.400000,0.400000},
-{0.125000,0.875000,0.800000,0.800000},
-{0.175000,0.875000,0.400000,0.400000},
-{0.175000,0.875000,0.800000,0.800000},
-{0.225000,0.875000,0.400000,0.400000},
-{0.225000,0.875000,0.800000,0.800000},
-{0.275000,0.875000,0.400000,0.400000},
-{0.275000,0.875000,0.800000,0.800000},
-{0.325000,0.875000,0.400000,0.400000},
-{0.325000,0.875000,0.800000,0.800000},
-{0.375000,0.875000,0.400000,0.400000},
-{0.375000,0.875000,0.800000,0.800000},
-{0.425000,0.875000,0.400000,0.400000},
-{0.425000,0.875000,0.800000,0.800000},
-{0.475000,0.875000,0.400000,0.400000},
-{0.475000,0.875000,0.800000,0.800000},
-{0.525000,0.875000,0.400000,0.400000},
-{0.525000,0.875000,0.800000,0.800000},
-{0.575000,0.875000,0.400000,0.400000},
-{0.575000,0.875000,0.800000,0.800000},
-{0.625000,0.875000,0.400000,0.400000},
-{0.625000,0.875000,0.800000,0.800000},
-{0.675000,0.875000,0.400000,0.400000},
-{0.675000,0.875000,0.800000,0.800000},
-{0.725000,0.875000,0.400000,0.400000},
-{0.725000,0.875000,0.800000,0.800000},
-{0.775000,0.875000,0.400000,0.400000},
-{0.775000,0.875000,0.800000,0.800000},
-{0.825000,0.875000,0.400000,0.400000},
-{0.825000,0.875000,0.800000,0.800000},
-{0.875000,0.875000,0.400000,0.400000},
-{0.875000,0.875000,0.800000,0.800000},
-{0.925000,0.875000,0.400000,0.400000},
-{0.925000,0.875000,0.800000,0.800000},
-{0.975000,0.875000,0.400000,0.400000},
-{0.975000,0.875000,0.800000,0.800000},
-{0.025000,0.925000,0.400000,0.400000},
-{0.025000,0.925000,0.800000,0.800000},
-{0.075000,0.925000,0.400000,0.400000},
-{0.075000,0.925000,0.800000,0.800000},
-{0.125000,0.925000,0.400000,0.400000},
-{0.125000,0.925000,0.800000,0.800000},
-{0.175000,0.925000,0.400000,0.400000},
-{0.175000,0.925000,0.800000,0.800000},
-{0.225000,0.925000,0.400000,0.400000},
-{0.225000,0.925000,0.800000,0.800000},
-{0.275000,0.925000,0.400000,0.400000},
-{0.275000,0.925000,0.800000,0.800000},
-{0.325000,0.925000,0.400000,0.400000},
-{0.325000,0.925000,0.800000,0.800000},
-{0.375000,0.925000,0.400000,0.400000},
-{0.375000,0.925000,0.800000,0.800000},
-{0.425000,0.925000,0.400000,0.400000},
-{0.425000,0.925000,0.800000,0.800000},
-{0.475000,0.925000,0.400000,0.400000},
-{0.475000,0.925000,0.800000,0.800000},
-{0.525000,0.925000,0.400000,0.400000},
-{0.525000,0.925000,0.800000,0.800000},
-{0.575000,0.925000,0.400000,0.400000},
-{0.575000,0.925000,0.800000,0.800000},
-{0.625000,0.925000,0.400000,0.400000},
-{0.625000,0.925000,0.800000,0.800000},
-{0.675000,0.925000,0.400000,0.400000},
-{0.675000,0.925000,0.800000,0.800000},
-{0.725000,0.925000,0.400000,0.400000},
-{0.725000,0.925000,0.800000,0.800000},
-{0.775000,0.925000,0.400000,0.400000},
-{0.775000,0.925000,0.800000,0.800000},
-{0.825000,0.925000,0.400000,0.400000},
-{0.825000,0.925000,0.800000,0.800000},
-{0.875000,0.925000,0.400000,0.400000},
-{0.875000,0.925000,0.800000,0.800000},
-{0.925000,0.925000,0.400000,0.400000},
-{0.925000,0.925000,0.800000,0.800000},
-{0.975000,0.925000,0.400000,0.400000},
-{0.975000,0.925000,0.800000,0.800000},
-{0.025000,0.975000,0.400000,0.400000},
-{0.025000,0.975000,0.800000,0.800000},
-{0.075000,0.975000,0.400000,0.400000},
-{0.075000,0.975000,0.800000,0.800000},
-{0.125000,0.975000,0.400000,0.400000},
-{0.125000,0.975000,0.800000,0.800000},
-{0.175000,0.975000,0.400000,0.400000},
-{0.175000,0.975000,0.800000,0.800000},
-{0.225000,0.975000,0.400000,0.400000},
-{0.225000,0.975000,0.800000,0.800000},
-{0.275000,0.975000,0.400000,0.400000},
-{0.275000,0.975000,0.800000,0.800000},
-{0.325000,0.975000,0.400000,0.400000},
-{0.325000,0.975000,0.800000,0.800000},
-{0.375000,0.975000,0.400000,0.400000},
-{0.375000,0.975000,0.800000,0.800000},
-{0.425000,0.975000,0.400000,0.400000},
-{0.425000,0.975000,0.800000,0.800000},
-{0.475000,0.975000,0.400000,0.400000},
-{0.475000,0.975000,0.800000,0.800000},
-{0.525000,0.975000,0.400000,0.400000},
-{0.525000,0.975000,0.800000,0.800000},
-{0.575000,0.975000,0.400000,0.400000},
-{0.575000,0.975000,0.800000,0.800000},
-{0.625000,0.975000,0.400000,0.400000},
-{0.625000,0.975000,0.800000,0.800000},
-{0.675000,0.975000,0.400000,0.400000},
-{0.675000,0.975000,0.800000,0.800000},
-{0.725000,0.975000,0.400000,0.400000},
-{0.725000,0.975000,0.800000,0.800000},
-{0.775000,0.975000,0.400000,0.400000},
-{0.775000,0.975000,0.800000,0.800000},
-{0.825000,0.975000,0.400000,0.400000},
-{0.825000,0.975000,0.800000,0.800000},
-{0.875000,0.975000,0.400000,0.400000},
-{0.875000,0.975000,0.800000,0.800000},
-{0.925000,0.975000,0.400000,0.400000},
-{0.925000,0.975000,0.800000,0.800000},
-{0.975000,0.975000,0.400000,0.400000},
-{0.975000,0.975000,0.800000,0.800000}
-};
-
-#endif //ROCKX_BOX_PRIORS_H
\ No newline at end of file
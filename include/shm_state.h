@@ -0,0 +1,84 @@
+#ifndef SHM_STATE_H
+#define SHM_STATE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/*
+ * Layout of the shared-memory segment written by SharedMemoryPublisher.
+ *
+ * Each record is a seqlock: the writer makes seq odd, copies the message,
+ * then makes seq even again. A reader copies the record and keeps the copy
+ * only if seq was even and unchanged across the copy, so readers never take
+ * a lock or make a syscall and cannot slow the writer down. count tells a
+ * reader how many messages it missed between two reads.
+ *
+ * The segment is /dev/shm/<name> and is removed when the publisher exits.
+ */
+
+constexpr uint32_t SHM_STATE_MAGIC = 0x4d485341;   // "ASHM" in memory
+constexpr uint32_t SHM_STATE_VERSION = 1;
+constexpr uint32_t SHM_RECORD_BYTES = 8192;        // longer messages are dropped
+
+struct alignas(64) ShmStateRecord {
+    std::atomic<uint32_t> seq;      // odd while the writer is copying
+    uint32_t length;                // bytes of data in use
+    uint64_t count;                 // messages written to this record so far
+    char data[SHM_RECORD_BYTES];
+};
+
+struct ShmStateSegment {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_bytes;
+    uint32_t reserved;
+    ShmStateRecord latest;          // every message
+    ShmStateRecord transcript;      // messages that carry a transcript
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "seqlock needs a lock-free counter");
+// fixed offsets for readers in other languages (scripts/read_shm.py)
+static_assert(sizeof(ShmStateRecord) == 8256, "record layout changed");
+static_assert(offsetof(ShmStateSegment, latest) == 64, "segment layout changed");
+static_assert(offsetof(ShmStateSegment, transcript) == 8320, "segment layout changed");
+
+// Writer side, single writer per segment
+inline void shm_state_write(ShmStateRecord& record, const char* data, uint32_t length) {
+    uint32_t seq = record.seq.load(std::memory_order_relaxed);
+    record.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(record.data, data, length);
+    record.length = length;
+    record.count++;
+    record.seq.store(seq + 2, std::memory_order_release);
+}
+
+/**
+ * @brief Consistent copy of a record
+ * @param tries attempts before giving up while the writer keeps the record busy
+ * @return false if the record is empty or no consistent copy was made
+ */
+inline bool shm_state_read(const ShmStateRecord& record, std::string& out, uint64_t& count, int tries = 100) {
+    for (int i = 0; i < tries; ++i) {
+        uint32_t before = record.seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        uint32_t length = record.length;
+        if (length > SHM_RECORD_BYTES) {
+            continue;
+        }
+        out.assign(record.data, length);
+        count = record.count;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (record.seq.load(std::memory_order_relaxed) == before) {
+            return count > 0;
+        }
+    }
+    return false;
+}
+
+#endif // SHM_STATE_H
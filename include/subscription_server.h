@@ -0,0 +1,115 @@
+#ifndef SUBSCRIPTION_SERVER_H
+#define SUBSCRIPTION_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "inference.h"
+#include "publisher.h"
+
+// formatted messages kept per format; bounds how far a subscriber can lag
+constexpr int SUBSCRIPTION_LOG_CAPACITY = 64;
+// messages a subscriber may fall behind before its oldest are dropped
+constexpr int SUBSCRIPTION_MAX_LAG = 32;
+constexpr int SUBSCRIPTION_MAX_SUBSCRIBERS = 64;
+constexpr const char* SUBSCRIPTION_DEFAULT_PATH = "/tmp/bsext-voice.sock";
+
+// Server counters, logged every PUBLISHER_REPORT_SECONDS
+struct SubscriptionStats {
+    long results{0};            // results read from the ring
+    long formatted{0};          // messages formatted, once per subscribed format
+    long messages{0};           // messages sent, summed over subscribers
+    long dropped{0};            // messages dropped for lagging subscribers
+    long syscalls{0};           // sends
+    long subscribed{0};
+    long unsubscribed{0};
+};
+
+/**
+ * @class SubscriptionServer
+ * @brief Fans results out to local subscribers from one epoll thread
+ *
+ * Clients connect to an AF_UNIX SOCK_SEQPACKET socket and send
+ *   subscribe <json|bsvar|binary> [transcripts]
+ * then receive one packet per result, or only results with a transcript.
+ * A later subscribe changes the subscription. A bad command is answered
+ * with "error: ..." and the connection is closed.
+ *
+ * Each result is formatted once per subscribed format into a log of
+ * SUBSCRIPTION_LOG_CAPACITY messages. Every subscriber keeps a cursor into
+ * its format's log, so its queue is the span between its cursor and the
+ * head. Sends never block: a subscriber whose socket is full is resumed on
+ * EPOLLOUT, and once it is more than max_lag messages behind its oldest
+ * messages are dropped. A slow subscriber never delays the others.
+ */
+class SubscriptionServer {
+public:
+    SubscriptionServer(
+        const std::string& path,
+        ResultRing& results,
+        std::atomic<bool>& isRunning,
+        int max_lag = SUBSCRIPTION_MAX_LAG,
+        int max_subscribers = SUBSCRIPTION_MAX_SUBSCRIBERS);
+    ~SubscriptionServer();
+
+    void operator()();
+    BroadcastConsumerStats getLagStats() const { return results.getStats(consumer); }
+    const std::string& getPath() const { return path; }
+
+private:
+    struct MessageLog {
+        std::string format;
+        std::shared_ptr<MessageFormatter> formatter;
+        std::vector<std::string> messages;      // ring of SUBSCRIPTION_LOG_CAPACITY reused buffers
+        std::vector<char> transcript;           // whether each message carries a transcript
+        uint64_t head{0};                       // messages written so far
+        int subscribers{0};
+    };
+
+    struct Subscriber {
+        int fd;
+        MessageLog* log{nullptr};               // nullptr until the first subscribe
+        bool transcripts_only{false};
+        uint64_t cursor{0};                     // next message to send from log
+        bool want_write{false};                 // waiting for EPOLLOUT
+        long sent{0};
+        long dropped{0};
+    };
+
+    void acceptClients();
+    void readCommand(Subscriber& sub);
+    void subscribe(Subscriber& sub, MessageLog& log, bool transcripts_only);
+    void drainResults();
+    void trimLag(Subscriber& sub);
+    void flush(Subscriber& sub);
+    void setWantWrite(Subscriber& sub, bool want);
+    void removeSubscriber(int fd);
+    void reportStats();
+    // Closes what the constructor opened and throws what, with errno
+    [[noreturn]] void failSetup(const std::string& what);
+    void closeSockets();
+
+    std::string path;
+    ResultRing& results;
+    int consumer;                               // the server's cursor in results
+    std::atomic<bool>& running;
+    int max_lag;
+    int max_subscribers;
+    int listen_fd{-1};
+    int epoll_fd{-1};
+    int event_fd{-1};                           // signalled by results on publish
+    std::vector<MessageLog> logs;
+    std::unordered_map<int, Subscriber> subscribers;
+    std::vector<int> closing;                   // fds to remove after the current pass
+    SubscriptionStats stats;
+    PublisherMetrics sink_metrics;              // sink="subscriptions"
+    Gauge& subscriber_count;
+    std::chrono::steady_clock::time_point last_report;
+};
+
+#endif // SUBSCRIPTION_SERVER_H
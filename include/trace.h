@@ -0,0 +1,94 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// spans kept in memory; older ones are overwritten
+constexpr size_t TRACE_RING_CAPACITY = 4096;
+constexpr const char* TRACE_DUMP_PATH = "/tmp/bsext-voice-trace.json";
+
+// One Chrome trace event: a complete span ('X') or an instant ('i')
+struct TraceEvent {
+    uint64_t trace_id;
+    const char* name;           // string literal
+    char phase;
+    int tid;
+    int64_t start_us;           // since the tracer was created
+    int64_t dur_us;
+};
+
+/**
+ * @class Tracer
+ * @brief Per-interaction spans in a bounded in-memory ring
+ *
+ * The inference thread starts a trace when the attention gate triggers; its
+ * id travels in the GazeStarted event, the ASR session and every
+ * InferenceResult of the session, so the spans of one interaction can be
+ * followed from the gaze to the publishers. Spans with trace id 0 are not
+ * recorded.
+ *
+ * Writers claim a slot with one atomic add and guard it with a per-slot
+ * sequence number, so recording never takes a lock. The ring is dumped as
+ * Chrome trace-event JSON, which Perfetto and chrome://tracing load.
+ */
+class Tracer {
+public:
+    Tracer();
+
+    uint64_t newTraceId() { return next_id.fetch_add(1, std::memory_order_relaxed); }
+    // Names the calling thread in dumps
+    void setThreadName(const std::string& name);
+    void complete(const char* name, uint64_t trace_id, std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end);
+    void instant(const char* name, uint64_t trace_id);
+
+    // Chrome trace-event JSON of the spans still in the ring
+    void writeChromeJson(std::string& out);
+    bool dump(const std::string& path);
+
+    // Trace of the interaction the calling thread is working on, 0 for none
+    static uint64_t current();
+    static void setCurrent(uint64_t trace_id);
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq{0};           // 2 * index + 2 once written, odd while writing
+        TraceEvent event;
+    };
+
+    void record(const TraceEvent& event);
+    int64_t micros(std::chrono::steady_clock::time_point t) const;
+
+    std::chrono::steady_clock::time_point epoch;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> head{0};              // events written so far
+    std::atomic<uint64_t> next_id{1};
+    std::mutex names_mutex;
+    std::vector<std::pair<int, std::string>> thread_names;
+};
+
+Tracer& tracer();
+
+// Records a span of the current trace from construction to destruction
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, uint64_t trace_id = Tracer::current())
+        : name(name), trace_id(trace_id), start(std::chrono::steady_clock::now()) {}
+    ~TraceSpan() { tracer().complete(name, trace_id, start, std::chrono::steady_clock::now()); }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    uint64_t trace_id;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // TRACE_H
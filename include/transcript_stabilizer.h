@@ -0,0 +1,51 @@
+#ifndef TRANSCRIPT_STABILIZER_H
+#define TRANSCRIPT_STABILIZER_H
+
+#include <string>
+#include <vector>
+
+// Partial transcript counters, logged at the end of each ASR session
+struct PartialTranscriptStats {
+    long decoded{0};            // partial hypotheses decoded
+    long published{0};          // partials whose text changed and were published
+    long unchanged{0};          // partials suppressed because the text did not change
+    long stable_words{0};       // words committed by the end of the session
+};
+
+/**
+ * @class TranscriptStabilizer
+ * @brief Turns successive partial hypotheses into text that does not flicker
+ *
+ * Whisper re-decodes the whole growing buffer, so consecutive hypotheses
+ * may rewrite earlier words. A word prefix that two consecutive hypotheses
+ * agree on is committed and kept in every later partial, even if a later
+ * hypothesis disagrees; only the words after it may change. A partial is
+ * published only when its text differs from the last one published.
+ */
+class TranscriptStabilizer {
+public:
+    void reset();
+    /**
+     * @brief Feed the next hypothesis
+     * @param out text to publish: committed words, then this hypothesis' remaining words
+     * @return true if out differs from the last published partial
+     */
+    bool update(const std::string& hypothesis, std::string& out);
+    bool anyPublished() const { return !published.empty(); }
+    /**
+     * @brief Whether the final transcript of the session is published
+     *
+     * Always, even if it repeats the last partial, since it ends the session.
+     * Only an empty final of a session that showed no partial is skipped.
+     */
+    bool publishFinal(const std::string& final_text) const { return !final_text.empty() || anyPublished(); }
+    const PartialTranscriptStats& getStats() const { return stats; }
+
+private:
+    std::vector<std::string> committed;
+    std::vector<std::string> previous;      // words of the previous hypothesis
+    std::string published;                  // last published partial
+    PartialTranscriptStats stats;
+};
+
+#endif // TRANSCRIPT_STABILIZER_H
@@ -15,8 +15,8 @@
 #ifndef _RKNN_DEMO_WHISPER_H_
 #define _RKNN_DEMO_WHISPER_H_
 
-#include "rknn_api.h"
 #include "audio_utils.h"
+#include "inference_backend.h"
 #include <iostream>
 #include <vector>
 #include <string>
@@ -24,20 +24,30 @@
 
 typedef struct
 {
-    rknn_context rknn_ctx;
-    rknn_input_output_num io_num;
-    rknn_tensor_attr *input_attrs;
-    rknn_tensor_attr *output_attrs;
-} rknn_voice_app_context_t;
+    InferenceBackend *backend;  // owned, freed by release_whisper_model()
+} whisper_model_context_t;
+
+// decode steps are capped at this many tokens per transcript
+#define WHISPER_MAX_DECODE_STEPS 200
+
+// Stage timings of the last inference_whisper_model() call
+typedef struct
+{
+    float encoder_ms;
+    float decoder_ms;
+    int decode_steps;
+    float decode_step_ms[WHISPER_MAX_DECODE_STEPS];
+} whisper_perf_t;
 
 typedef struct
 {
-    rknn_voice_app_context_t encoder_context;
-    rknn_voice_app_context_t decoder_context;
-} rknn_whisper_context_t;
+    whisper_model_context_t encoder_context;
+    whisper_model_context_t decoder_context;
+    whisper_perf_t perf;
+} whisper_context_t;
 
-int init_whisper_model(const char *model_path, rknn_voice_app_context_t *app_ctx);
-int release_whisper_model(rknn_voice_app_context_t *app_ctx);
-int inference_whisper_model(rknn_whisper_context_t *app_ctx, std::vector<float> audio_data, float *mel_filters, VocabEntry *vocab, int task_code, std::vector<std::string> &recognized_text);
+int init_whisper_model(const char *model_path, whisper_model_context_t *app_ctx);
+int release_whisper_model(whisper_model_context_t *app_ctx);
+int inference_whisper_model(whisper_context_t *app_ctx, std::vector<float> audio_data, float *mel_filters, VocabEntry *vocab, int task_code, std::vector<std::string> &recognized_text);
 
 #endif //_RKNN_DEMO_WHISPER_H_
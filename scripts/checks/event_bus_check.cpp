@@ -0,0 +1,231 @@
+/*
+ * Multi-producer stress test of the event bus (src/event_bus.cpp).
+ *
+ * Producer threads publish numbered events of two types while consumers
+ * wait on their mailboxes:
+ * - a mailbox large enough for every event receives each one exactly once,
+ *   in publish order per producer, and only the types it subscribed to;
+ * - a default 16-entry mailbox under the same load receives each event at
+ *   most once and in order, and received plus dropped equals published;
+ * - shutdown() wakes a consumer blocked in waitPop() on an empty mailbox,
+ *   and events posted before it are still drained;
+ * - subscribing more than EVENT_BUS_MAX_MAILBOXES mailboxes is reported
+ *   with an exception and leaves the bus working.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "event_bus.h"
+
+#define PRODUCERS 4
+#define EVENTS_PER_PRODUCER 20000
+#define WAKEUP_TIMEOUT_MS 2000
+
+static Event make_event(EventType type) {
+    Event event{};
+    event.type = type;
+    return event;
+}
+
+// track_id carries the producer, trace_id its sequence number
+static void produce(EventBus& bus, int producer) {
+    for (int i = 0; i < EVENTS_PER_PRODUCER; i++) {
+        Event event = make_event(i % 2 ? EventType::GazeStarted : EventType::TranscriptReady);
+        event.track_id = producer;
+        event.trace_id = (uint64_t)i;
+        bus.publish(event);
+        if (i % 1024 == 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+struct Received {
+    long events{0};
+    long duplicates_or_reordered{0};
+    long wrong_type{0};
+    long bad_producer{0};
+    std::vector<long> last;     // last sequence number per producer
+
+    Received() : last(PRODUCERS, -1) {}
+
+    void add(const Event& event, uint32_t mask) {
+        events++;
+        if ((eventMask(event.type) & mask) == 0) {
+            wrong_type++;
+        }
+        if (event.track_id < 0 || event.track_id >= PRODUCERS) {
+            bad_producer++;
+            return;
+        }
+        long seq = (long)event.trace_id;
+        if (seq <= last[event.track_id]) {
+            duplicates_or_reordered++;
+        }
+        last[event.track_id] = seq;
+    }
+};
+
+static void consume(EventMailbox* mailbox, uint32_t mask, Received* received) {
+    Event event;
+    while (mailbox->waitPop(event)) {
+        received->add(event, mask);
+    }
+}
+
+static int check_received(const char* name, const Received& r, long expected, long dropped, bool lossless) {
+    int failed = 0;
+    if (r.duplicates_or_reordered || r.wrong_type || r.bad_producer) {
+        printf("FAIL %s: %ld duplicated or out of order, %ld of an unsubscribed type, %ld corrupt\n", name,
+               r.duplicates_or_reordered, r.wrong_type, r.bad_producer);
+        failed++;
+    }
+    if (r.events + dropped != expected || (lossless && dropped != 0)) {
+        printf("FAIL %s: received %ld + dropped %ld, expected %ld%s\n", name, r.events, dropped, expected,
+               lossless ? " received" : "");
+        failed++;
+    }
+    printf("  %-10s received %6ld dropped %6ld\n", name, r.events, dropped);
+    return failed;
+}
+
+static int check_stress() {
+    EventBus bus;
+    const uint32_t both = eventMask(EventType::GazeStarted) | eventMask(EventType::TranscriptReady);
+    const uint32_t gaze = eventMask(EventType::GazeStarted);
+    EventMailbox& all = bus.subscribe(both, PRODUCERS * EVENTS_PER_PRODUCER);
+    EventMailbox& gaze_only = bus.subscribe(gaze, PRODUCERS * EVENTS_PER_PRODUCER / 2);
+    EventMailbox& small = bus.subscribe(both);
+
+    Received r_all, r_gaze, r_small;
+    std::thread consumers[3] = {
+        std::thread(consume, &all, both, &r_all),
+        std::thread(consume, &gaze_only, gaze, &r_gaze),
+        std::thread(consume, &small, both, &r_small),
+    };
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back(produce, std::ref(bus), p);
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    // waitPop() drains what is left before it reports the shutdown
+    bus.shutdown();
+    for (auto& t : consumers) {
+        t.join();
+    }
+
+    int failed = 0;
+    long published = PRODUCERS * EVENTS_PER_PRODUCER;
+    failed += check_received("all", r_all, published, all.getStats().dropped, true);
+    failed += check_received("gaze only", r_gaze, published / 2, gaze_only.getStats().dropped, true);
+    failed += check_received("16 slots", r_small, published, small.getStats().dropped, false);
+    if (all.getStats().events != r_all.events) {
+        printf("FAIL all: mailbox counted %ld events, consumer received %ld\n", all.getStats().events, r_all.events);
+        failed++;
+    }
+    return failed;
+}
+
+static int check_shutdown_wakeup() {
+    EventBus bus;
+    EventMailbox& mailbox = bus.subscribe(eventMask(EventType::GazeStarted));
+    std::atomic<int> popped{0};
+    std::atomic<bool> returned{false};
+    std::thread waiter([&] {
+        Event event;
+        while (mailbox.waitPop(event)) {
+            popped++;
+        }
+        returned = true;
+    });
+
+    // one event wakes it, then it blocks again on the empty mailbox
+    bus.publish(make_event(EventType::GazeStarted));
+    auto start = std::chrono::steady_clock::now();
+    while (popped.load() != 1 && std::chrono::steady_clock::now() - start < std::chrono::milliseconds(WAKEUP_TIMEOUT_MS)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    int failed = 0;
+    if (popped.load() != 1 || returned.load()) {
+        printf("FAIL shutdown: waiter popped %d event(s) and %s before the shutdown\n", popped.load(),
+               returned.load() ? "returned" : "kept waiting");
+        failed++;
+    }
+
+    bus.shutdown();
+    start = std::chrono::steady_clock::now();
+    while (!returned.load() && std::chrono::steady_clock::now() - start < std::chrono::milliseconds(WAKEUP_TIMEOUT_MS)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!returned.load()) {
+        // the waiter can not be joined, do not hang the test run
+        printf("FAIL shutdown: waiter still blocked %d ms after shutdown()\n", WAKEUP_TIMEOUT_MS);
+        fflush(stdout);
+        std::_Exit(1);
+    }
+    waiter.join();
+
+    // events posted before the shutdown are drained, then waitPop() reports it
+    EventBus drained_bus;
+    EventMailbox& drained = drained_bus.subscribe(eventMask(EventType::GazeEnded));
+    for (int i = 0; i < 3; i++) {
+        drained_bus.publish(make_event(EventType::GazeEnded));
+    }
+    drained_bus.shutdown();
+    Event event;
+    int n = 0;
+    while (drained.waitPop(event)) {
+        n++;
+    }
+    if (n != 3) {
+        printf("FAIL shutdown: drained %d of 3 events posted before it\n", n);
+        failed++;
+    }
+    printf("  shutdown  woke the blocked waiter, drained %d/3\n", n);
+    return failed;
+}
+
+static int check_subscribe_limit() {
+    EventBus bus;
+    EventMailbox& first = bus.subscribe(eventMask(EventType::ListeningStarted));
+    for (int i = 1; i < EVENT_BUS_MAX_MAILBOXES; i++) {
+        bus.subscribe(eventMask(EventType::ListeningStarted));
+    }
+    bool thrown = false;
+    try {
+        bus.subscribe(eventMask(EventType::ListeningStarted));
+    } catch (const std::runtime_error& e) {
+        thrown = true;
+        printf("  subscribe %d: %s\n", EVENT_BUS_MAX_MAILBOXES + 1, e.what());
+    }
+    if (!thrown) {
+        printf("FAIL subscribe: mailbox %d was not refused\n", EVENT_BUS_MAX_MAILBOXES + 1);
+        return 1;
+    }
+    // the bus keeps serving the mailboxes it has
+    bus.publish(make_event(EventType::ListeningStarted));
+    Event event;
+    if (!first.tryPop(event) || event.type != EventType::ListeningStarted) {
+        printf("FAIL subscribe: the bus stopped delivering after the refused subscription\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    int failed = 0;
+    printf("event_bus_check: %d producers x %d events\n", PRODUCERS, EVENTS_PER_PRODUCER);
+    failed += check_stress();
+    failed += check_shutdown_wakeup();
+    failed += check_subscribe_limit();
+    printf("event_bus_check: %d failures\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * Message formatter micro-benchmark (src/message_formatter.cpp).
+ *
+ * Formats a fixed set of mixed results (0-4 faces; empty, ASCII, escaped,
+ * multibyte and invalid UTF-8 transcripts) with the MessageWriter formatters
+ * and with the formatting they replaced: an nlohmann DOM dumped per message
+ * for JSON, std::string concatenation for BrightScript. Counts heap
+ * allocations with a replaced global operator new and fails if the
+ * formatters allocate once their output buffer has grown to the largest
+ * message. The JSON output is also parsed and compared with the nlohmann
+ * DOM, and the BrightScript output byte for byte with the old string.
+ *
+ *   format_bench [passes]
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "message_formatter.h"
+#include "nlohmann/json.hpp"
+
+static size_t allocations = 0;
+
+// GCC pairs inlined new/delete calls and flags free() on memory that came
+// from operator new, even though both ends are replaced here with malloc/free
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#pragma GCC diagnostic pop
+
+static const int NUM_RESULTS = 1000;
+
+static uint32_t lcg_state = 12345;
+static uint32_t lcg() {
+    lcg_state = lcg_state * 1664525u + 1013904223u;
+    return lcg_state >> 8;
+}
+
+static float angle() { return (float)((int)(lcg() % 120000) - 60000) / 1000.f + 0.0003f; }
+
+static std::vector<InferenceResult> make_results() {
+    static const char* transcripts[] = {
+        "",
+        "",
+        "",
+        "Listening...",
+        "turn on the lights in the meeting room",
+        "she said \"hello\" and left\\",
+        "line one\nline two\ttab\x01",
+        "Gr\xc3\xbc\xc3\x9f" "e, \xe4\xbd\xa0\xe5\xa5\xbd \xf0\x9f\x98\x80",
+        "bad \xff byte and cut \xc3",
+    };
+    int n_transcripts = (int)(sizeof(transcripts) / sizeof(transcripts[0]));
+    std::vector<InferenceResult> results(NUM_RESULTS);
+    for (int i = 0; i < NUM_RESULTS; i++) {
+        InferenceResult& r = results[i];
+        int faces = lcg() % 5;
+        for (int f = 0; f < faces; f++) {
+            FacePose face;
+            face.id = lcg() % 1000;
+            face.yaw = angle();
+            face.pitch = angle();
+            face.roll = lcg() % 50 == 0 ? NAN : angle();
+            face.attending = lcg() % 2;
+            r.faces.push_back(face);
+        }
+        r.count_all_faces_in_frame = faces + lcg() % 2;
+        r.num_faces_attending = lcg() % (faces + 1);
+        r.asr = transcripts[lcg() % n_transcripts];
+        r.timestamp = std::chrono::system_clock::time_point(std::chrono::milliseconds(1746732409000LL + i * 100));
+        r.is_final = !r.asr.empty() && lcg() % 3 == 0;
+        r.trace_id = r.asr.empty() ? 0 : 1 + lcg() % 100000;
+    }
+    return results;
+}
+
+// The JSON formatter before MessageWriter, with the fields added since.
+// Rounds in double: the float rounding printed 8.100000381 for 8.1.
+static std::string nlohmann_json(const InferenceResult& result) {
+    nlohmann::json j;
+    j["faces_in_frame_total"] = result.count_all_faces_in_frame;
+    j["faces_attending"] = result.num_faces_attending;
+    j["timestamp"] = std::chrono::system_clock::to_time_t(result.timestamp);
+    j["ASR"] = result.asr;
+    j["is_final"] = result.is_final;
+    j["trace_id"] = result.trace_id;
+    j["faces"] = nlohmann::json::array();
+    for (const auto& face : result.faces) {
+        j["faces"].push_back({
+            {"id", face.id},
+            {"yaw", std::round(face.yaw * 10.0) / 10.0},
+            {"pitch", std::round(face.pitch * 10.0) / 10.0},
+            {"roll", std::round(face.roll * 10.0) / 10.0},
+            {"attending", face.attending}});
+    }
+    // dump() throws on invalid UTF-8 by default
+    return j.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+// The BrightScript formatter before MessageWriter, with the fields added since
+static std::string concat_bsvar(const InferenceResult& result) {
+    return "faces_attending:" + std::to_string(result.num_faces_attending) + "!!" +
+        "faces_in_frame_total:" + std::to_string(result.count_all_faces_in_frame) + "!!" +
+        "ASR:" + result.asr + "!!" +
+        "is_final:" + (result.is_final ? "true" : "false") + "!!" +
+        "timestamp:" + std::to_string(std::chrono::system_clock::to_time_t(result.timestamp)) + "!!" +
+        "trace_id:" + std::to_string(result.trace_id);
+}
+
+struct BenchResult {
+    double us_per_message;
+    double allocs_per_message;
+    size_t bytes;
+};
+
+template <typename Format>
+static BenchResult bench(const std::vector<InferenceResult>& results, int passes, Format format) {
+    size_t bytes = 0;
+    // warm-up pass grows the reused buffers to the largest message
+    for (const InferenceResult& r : results) {
+        bytes += format(r);
+    }
+    size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < passes; p++) {
+        for (const InferenceResult& r : results) {
+            bytes += format(r);
+        }
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    double messages = (double)passes * results.size();
+    return {elapsed.count() / messages, (allocations - before) / messages, bytes};
+}
+
+static void report(const char* name, const BenchResult& r) {
+    printf("  %-22s %7.3f us/msg  %6.2f allocs/msg\n", name, r.us_per_message, r.allocs_per_message);
+}
+
+int main(int argc, char** argv) {
+    int passes = argc > 1 ? atoi(argv[1]) : 20;
+    std::vector<InferenceResult> results = make_results();
+    int failed = 0;
+
+    JsonMessageFormatter json;
+    BSVariableMessageFormatter bsvar;
+    BinaryMessageFormatter binary;
+    std::string out;
+
+    // same values as the DOM, and the old BrightScript string byte for byte
+    for (int i = 0; i < NUM_RESULTS; i++) {
+        json.formatMessage(results[i], out);
+        nlohmann::json parsed = nlohmann::json::parse(out, nullptr, false);
+        if (parsed.is_discarded() || parsed != nlohmann::json::parse(nlohmann_json(results[i]))) {
+            printf("FAIL json result %d: %s\n", i, out.c_str());
+            failed++;
+        }
+        bsvar.formatMessage(results[i], out);
+        if (out != concat_bsvar(results[i])) {
+            printf("FAIL bsvar result %d: %s\n", i, out.c_str());
+            failed++;
+        }
+    }
+
+    printf("format_bench: %d results x %d passes\n", NUM_RESULTS, passes);
+    BenchResult dom = bench(results, passes, [](const InferenceResult& r) { return nlohmann_json(r).size(); });
+    BenchResult writer_json = bench(results, passes, [&](const InferenceResult& r) {
+        json.formatMessage(r, out);
+        return out.size();
+    });
+    BenchResult concat = bench(results, passes, [](const InferenceResult& r) { return concat_bsvar(r).size(); });
+    BenchResult writer_bsvar = bench(results, passes, [&](const InferenceResult& r) {
+        bsvar.formatMessage(r, out);
+        return out.size();
+    });
+    BenchResult writer_binary = bench(results, passes, [&](const InferenceResult& r) {
+        binary.formatMessage(r, out);
+        return out.size();
+    });
+    report("json nlohmann", dom);
+    report("json MessageWriter", writer_json);
+    report("bsvar concatenation", concat);
+    report("bsvar MessageWriter", writer_bsvar);
+    report("binary MessageWriter", writer_binary);
+
+    struct {
+        const char* name;
+        const BenchResult* result;
+    } steady[] = {{"json", &writer_json}, {"bsvar", &writer_bsvar}, {"binary", &writer_binary}};
+    for (const auto& s : steady) {
+        if (s.result->allocs_per_message != 0) {
+            printf("FAIL %s: MessageWriter formatting allocated in steady state\n", s.name);
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
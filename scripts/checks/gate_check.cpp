@@ -0,0 +1,179 @@
+/*
+ * Check of the attention gate state machine (src/attention_gate.cpp).
+ *
+ * Scripted per-track head poses are fed frame by frame; a track attends
+ * when its pose is inside the attention cone. The frame time and gate
+ * times are powers of two, so the frame a dwell, release or cooldown ends
+ * on is exact. Each script checks the frames ASR is triggered on, the
+ * gate state and the AttentionGateStats counters:
+ * - a glance shorter than the dwell never triggers;
+ * - a dwell triggers exactly once, on the frame it is reached;
+ * - a track that keeps looking, or looks away briefly, does not re-trigger;
+ * - a look-away of the release time re-arms the track;
+ * - nothing triggers while cooling down after an empty transcript;
+ * - the longest attending track wins and every dwelled track is served;
+ * - a track that is lost or not yet reliable ends or starts no episode.
+ */
+#include <cstdio>
+#include <vector>
+
+#include "attention_gate.h"
+
+#define DT 0.0625                   // 16 fps
+#define DWELL_FRAMES 12
+#define RELEASE_FRAMES 6
+#define COOLDOWN_FRAMES 32
+
+static const HeadPose LOOKING = {3.f, -4.f, 0.f};
+static const HeadPose AWAY = {60.f, 0.f, 0.f};
+
+struct Run {
+    int triggers;
+    int first_frame;        // 1-based frame of the first trigger, 0 if none
+    int first_id;
+};
+
+static FaceTrack track(int id, const HeadPose& pose, const FaceTrackerConfig& config) {
+    FaceTrack t{};
+    t.id = id;
+    t.hits = config.min_hits;
+    t.pose = pose;
+    t.attending = pose_in_cone(pose, config.cone);
+    return t;
+}
+
+static Run run_frames(AttentionGate& gate, const std::vector<FaceTrack>& tracks, const FaceTrackerConfig& config,
+                      int frames) {
+    Run run = {0, 0, -1};
+    for (int f = 1; f <= frames; f++) {
+        int id = gate.update(tracks, config, DT);
+        if (id >= 0 && run.triggers++ == 0) {
+            run.first_frame = f;
+            run.first_id = id;
+        }
+    }
+    return run;
+}
+
+static int expect_run(const char* step, const Run& run, int triggers, int first_frame, int first_id) {
+    if (run.triggers != triggers || (triggers > 0 && (run.first_frame != first_frame || run.first_id != first_id))) {
+        printf("FAIL %s: %d trigger(s), first on frame %d by track %d, expected %d, frame %d, track %d\n", step,
+               run.triggers, run.first_frame, run.first_id, triggers, first_frame, first_id);
+        return 1;
+    }
+    return 0;
+}
+
+static int expect_state(const char* step, const AttentionGate& gate, GateState state) {
+    static const char* names[] = {"Idle", "Listening", "Cooldown"};
+    if (gate.getState() != state) {
+        printf("FAIL %s: gate is %s, expected %s\n", step, names[(int)gate.getState()], names[(int)state]);
+        return 1;
+    }
+    return 0;
+}
+
+static int expect_stats(const char* step, const AttentionGate& gate, long triggers, long empty, long glance,
+                        long cooldown, long repeat) {
+    const AttentionGateStats& s = gate.getStats();
+    if (s.triggers != triggers || s.empty_transcripts != empty || s.avoided_glance != glance ||
+        s.avoided_cooldown != cooldown || s.avoided_repeat != repeat) {
+        printf("FAIL %s stats: triggers=%ld empty=%ld glance=%ld cooldown=%ld repeat=%ld, "
+               "expected %ld %ld %ld %ld %ld\n",
+               step, s.triggers, s.empty_transcripts, s.avoided_glance, s.avoided_cooldown, s.avoided_repeat,
+               triggers, empty, glance, cooldown, repeat);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    FaceTrackerConfig tracker_config;
+    AttentionGateConfig gate_config;
+    gate_config.dwell_s = DWELL_FRAMES * DT;
+    gate_config.release_s = RELEASE_FRAMES * DT;
+    gate_config.cooldown_s = COOLDOWN_FRAMES * DT;
+    int failed = 0;
+
+    std::vector<FaceTrack> looking = {track(1, LOOKING, tracker_config)};
+    std::vector<FaceTrack> away = {track(1, AWAY, tracker_config)};
+    if (!looking[0].attending || away[0].attending) {
+        printf("FAIL scripted poses are not inside and outside the default cone\n");
+        return 1;
+    }
+
+    // a glance one frame short of the dwell, then a look-away
+    AttentionGate gate(gate_config);
+    failed += expect_run("glance", run_frames(gate, looking, tracker_config, DWELL_FRAMES - 1), 0, 0, 0);
+    failed += expect_run("glance released", run_frames(gate, away, tracker_config, RELEASE_FRAMES), 0, 0, 0);
+    failed += expect_stats("glance", gate, 0, 0, 1, 0, 0);
+    if (gate.getAttendSeconds(1) != 0) {
+        printf("FAIL glance: attention not reset by the look-away\n");
+        failed++;
+    }
+
+    // a dwell triggers once on its last frame, keeping on looking does not re-trigger
+    failed += expect_run("dwell", run_frames(gate, looking, tracker_config, DWELL_FRAMES + 40), 1, DWELL_FRAMES, 1);
+    failed += expect_state("dwell", gate, GateState::Listening);
+    gate.asrFinished(false);
+    failed += expect_state("transcript", gate, GateState::Idle);
+    failed += expect_stats("transcript", gate, 1, 0, 1, 0, 1);
+    failed += expect_run("still looking", run_frames(gate, looking, tracker_config, 3 * DWELL_FRAMES), 0, 0, 0);
+
+    // a look-away shorter than the release keeps the track served
+    failed += expect_run("short look-away", run_frames(gate, away, tracker_config, RELEASE_FRAMES - 1), 0, 0, 0);
+    failed += expect_run("back after short look-away", run_frames(gate, looking, tracker_config, 3 * DWELL_FRAMES),
+                         0, 0, 0);
+
+    // a look-away of the release time re-arms it, the next dwell triggers again
+    failed += expect_run("release", run_frames(gate, away, tracker_config, RELEASE_FRAMES), 0, 0, 0);
+    failed += expect_run("second dwell", run_frames(gate, looking, tracker_config, DWELL_FRAMES), 1, DWELL_FRAMES, 1);
+    failed += expect_stats("second dwell", gate, 2, 0, 1, 0, 1);
+
+    // an empty transcript cools down; a second viewer dwells meanwhile and is
+    // counted once, then triggers on the frame the cooldown ends
+    for (int i = 0; i < RELEASE_FRAMES; i++) {
+        gate.update(away, tracker_config, DT);
+    }
+    gate.asrFinished(true);
+    failed += expect_state("empty transcript", gate, GateState::Cooldown);
+    failed += expect_stats("empty transcript", gate, 2, 1, 1, 0, 1);
+    std::vector<FaceTrack> two = {track(1, AWAY, tracker_config), track(2, LOOKING, tracker_config)};
+    failed += expect_run("cooldown", run_frames(gate, two, tracker_config, COOLDOWN_FRAMES - 1), 0, 0, 0);
+    failed += expect_state("cooldown", gate, GateState::Cooldown);
+    failed += expect_stats("cooldown", gate, 2, 1, 1, 1, 1);
+    failed += expect_run("cooldown over", run_frames(gate, two, tracker_config, 1), 1, 1, 2);
+    failed += expect_stats("cooldown over", gate, 3, 1, 1, 1, 1);
+    gate.asrFinished(false);
+
+    // two viewers dwell while another one is heard; once it ends the longer
+    // dwell wins and both are served by the next session
+    AttentionGate pair(gate_config);
+    std::vector<FaceTrack> one = {track(9, LOOKING, tracker_config)};
+    std::vector<FaceTrack> two_more = {track(9, LOOKING, tracker_config), track(7, LOOKING, tracker_config)};
+    std::vector<FaceTrack> three = two_more;
+    three.push_back(track(8, LOOKING, tracker_config));
+    failed += expect_run("pair, first viewer", run_frames(pair, one, tracker_config, DWELL_FRAMES), 1, DWELL_FRAMES, 9);
+    failed += expect_run("pair, listening", run_frames(pair, two_more, tracker_config, 4), 0, 0, 0);
+    failed += expect_run("pair, listening", run_frames(pair, three, tracker_config, DWELL_FRAMES), 0, 0, 0);
+    pair.asrFinished(false);
+    failed += expect_run("pair", run_frames(pair, three, tracker_config, 3 * DWELL_FRAMES), 1, 1, 7);
+    pair.asrFinished(false);
+    failed += expect_run("pair served", run_frames(pair, three, tracker_config, 3 * DWELL_FRAMES), 0, 0, 0);
+    failed += expect_stats("pair", pair, 2, 0, 0, 0, 4);
+
+    // a track that leaves the frame or goes unreliable ends its episode
+    AttentionGate lost(gate_config);
+    failed += expect_run("lost", run_frames(lost, looking, tracker_config, DWELL_FRAMES / 2), 0, 0, 0);
+    std::vector<FaceTrack> missed = looking;
+    missed[0].misses = 1;
+    failed += expect_run("missed", run_frames(lost, missed, tracker_config, 1), 0, 0, 0);
+    failed += expect_stats("lost", lost, 0, 0, 1, 0, 0);
+    std::vector<FaceTrack> tentative = {track(3, LOOKING, tracker_config)};
+    tentative[0].hits = tracker_config.min_hits - 1;
+    failed += expect_run("tentative", run_frames(lost, tentative, tracker_config, 2 * DWELL_FRAMES), 0, 0, 0);
+    failed += expect_run("back", run_frames(lost, looking, tracker_config, DWELL_FRAMES), 1, DWELL_FRAMES, 1);
+
+    printf("gate_check: %d failures\n", failed);
+    return failed ? 1 : 0;
+}
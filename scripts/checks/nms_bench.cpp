@@ -0,0 +1,240 @@
+/*
+ * Grid-binned NMS benchmark (retinaface_nms in src/retinaface_postprocess.cc).
+ *
+ * Builds synthetic crowds of 100, 150 and 300 faces, each face seen by a
+ * handful of jittered candidate boxes with quantized (often equal) scores,
+ * and a quarter of the faces centered on grid-cell borders. Every run is
+ * timed against the all-pairs greedy NMS that retinaface_nms replaced and
+ * fails if the kept candidates differ. A last run keeps frame-wide strips
+ * whose cell links overflow the link pool, so the brute-force fallback is
+ * checked as well.
+ *
+ *   nms_bench [passes]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "retinaface_postprocess.h"
+
+#define FRAME_WIDTH 640
+#define FRAME_HEIGHT 480
+#define NMS_THRESHOLD 0.4f
+// the 640x640 model compacts into a candidate buffer of one entry per prior
+#define MODEL_CAPACITY 16800
+
+static uint32_t lcg_state = 12345;
+static uint32_t lcg() {
+    lcg_state = lcg_state * 1664525u + 1013904223u;
+    return lcg_state >> 8;
+}
+
+// uniform in [lo, hi)
+static float uniform(float lo, float hi) { return lo + (hi - lo) * (float)(lcg() % 65536) / 65536.f; }
+
+struct Box {
+    float score;
+    float x0, y0, x1, y1;   // pixels
+};
+
+// Candidates of one face: the detector fires on several neighbouring priors
+static void add_face(std::vector<Box>& boxes, float cx, float cy, float size) {
+    int n = 3 + lcg() % 6;
+    for (int i = 0; i < n; i++) {
+        float s = size * uniform(0.9f, 1.1f);
+        float x = cx + size * uniform(-0.08f, 0.08f);
+        float y = cy + size * uniform(-0.08f, 0.08f);
+        // int8 scores come in steps of the output scale, so ties are common
+        float score = 0.5f + (float)(lcg() % 128) / 256.f;
+        boxes.push_back({score, x - s * 0.5f, y - s * 0.6f, x + s * 0.5f, y + s * 0.6f});
+    }
+}
+
+static std::vector<Box> make_crowd(int faces) {
+    std::vector<Box> boxes;
+    float cell_w = (float)FRAME_WIDTH / RETINAFACE_NMS_GRID;
+    float cell_h = (float)FRAME_HEIGHT / RETINAFACE_NMS_GRID;
+    for (int f = 0; f < faces; f++) {
+        float size = uniform(12.f, 64.f);
+        float cx = uniform(0.f, (float)FRAME_WIDTH);
+        float cy = uniform(0.f, (float)FRAME_HEIGHT);
+        switch (f % 8) {
+        case 0:     // on a vertical cell border
+            cx = (float)(1 + lcg() % (RETINAFACE_NMS_GRID - 1)) * cell_w;
+            break;
+        case 1:     // on a horizontal cell border
+            cy = (float)(1 + lcg() % (RETINAFACE_NMS_GRID - 1)) * cell_h;
+            break;
+        default:
+            break;
+        }
+        add_face(boxes, cx, cy, size);
+    }
+    return boxes;
+}
+
+// Grid cells a box is linked into once kept, as retinaface_nms bins it
+static int cells_covered(const Box& b) {
+    float cell_w = (float)FRAME_WIDTH / RETINAFACE_NMS_GRID;
+    float cell_h = (float)FRAME_HEIGHT / RETINAFACE_NMS_GRID;
+    auto cell = [](float v, float size) { return std::clamp((int)(v / size), 0, RETINAFACE_NMS_GRID - 1); };
+    return (cell(b.x1, cell_w) - cell(b.x0, cell_w) + 1) * (cell(b.y1, cell_h) - cell(b.y0, cell_h) + 1);
+}
+
+// Frame-wide strips of 16 cells each, neighbours overlapping below the
+// threshold, each with a suppressed duplicate, plus a few faces. The kept
+// strips need more cell links than the pool holds.
+static std::vector<Box> make_strips(int* links) {
+    std::vector<Box> boxes;
+    *links = 0;
+    for (int y = 0; y + 72 <= FRAME_HEIGHT; y += 36) {
+        Box strip = {0.99f, 0.f, (float)y, (float)FRAME_WIDTH - 1, (float)y + 71};
+        *links += cells_covered(strip);
+        boxes.push_back(strip);
+        boxes.push_back({0.98f, 0.f, (float)y + 3, (float)FRAME_WIDTH - 1, (float)y + 71});
+    }
+    for (int x = 0; x + 96 <= FRAME_WIDTH; x += 48) {
+        Box strip = {0.97f, (float)x, 0.f, (float)x + 95, (float)FRAME_HEIGHT - 1};
+        *links += cells_covered(strip);
+        boxes.push_back(strip);
+        boxes.push_back({0.96f, (float)x + 3, 0.f, (float)x + 95, (float)FRAME_HEIGHT - 1});
+    }
+    for (int f = 0; f < 4; f++) {
+        add_face(boxes, uniform(40.f, FRAME_WIDTH - 40.f), uniform(40.f, FRAME_HEIGHT - 40.f), 30.f);
+    }
+    return boxes;
+}
+
+static void load(retinaface_candidates_t* cand, const std::vector<Box>& boxes) {
+    cand->count = (int)boxes.size();
+    for (int i = 0; i < cand->count; i++) {
+        cand->score[i] = boxes[i].score;
+        cand->box[i * 4 + 0] = boxes[i].x0 / FRAME_WIDTH;
+        cand->box[i * 4 + 1] = boxes[i].y0 / FRAME_HEIGHT;
+        cand->box[i * 4 + 2] = boxes[i].x1 / FRAME_WIDTH;
+        cand->box[i * 4 + 3] = boxes[i].y1 / FRAME_HEIGHT;
+    }
+}
+
+// The all-pairs NMS retinaface_nms replaced, on the same sort order
+static float overlap(float xmin0, float ymin0, float xmax0, float ymax0, float xmin1, float ymin1, float xmax1,
+                     float ymax1) {
+    float w = fmax(0.f, fmin(xmax0, xmax1) - fmax(xmin0, xmin1) + 1);
+    float h = fmax(0.f, fmin(ymax0, ymax1) - fmax(ymin0, ymin1) + 1);
+    float i = w * h;
+    float u = (xmax0 - xmin0 + 1) * (ymax0 - ymin0 + 1) + (xmax1 - xmin1 + 1) * (ymax1 - ymin1 + 1) - i;
+    return u <= 0.f ? 0.f : (i / u);
+}
+
+static int all_pairs_nms(const retinaface_candidates_t* cand, float threshold, int width, int height,
+                         std::vector<int>& order, std::vector<int>& keep) {
+    int n = cand->count;
+    const float* score = cand->score;
+    const float* box = cand->box;
+    order.resize(n);
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [score](int a, int b) { return score[a] > score[b]; });
+    keep.clear();
+    for (int i = 0; i < n; ++i) {
+        if (order[i] == -1) {
+            continue;
+        }
+        int k = order[i];
+        keep.push_back(k);
+        for (int j = i + 1; j < n; ++j) {
+            int m = order[j];
+            if (m == -1) {
+                continue;
+            }
+            float iou = overlap(box[k * 4 + 0] * width, box[k * 4 + 1] * height, box[k * 4 + 2] * width,
+                                box[k * 4 + 3] * height, box[m * 4 + 0] * width, box[m * 4 + 1] * height,
+                                box[m * 4 + 2] * width, box[m * 4 + 3] * height);
+            if (iou > threshold) {
+                order[j] = -1;
+            }
+        }
+    }
+    return (int)keep.size();
+}
+
+template <typename F>
+static double time_us(int passes, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < passes; p++) {
+        f();
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / passes;
+}
+
+static int run(const char* label, const std::vector<Box>& boxes, int capacity, int passes) {
+    retinaface_candidates_t cand;
+    if (retinaface_candidates_init(&cand, capacity) != 0) {
+        printf("FAIL %s: retinaface_candidates_init failed\n", label);
+        return 1;
+    }
+    load(&cand, boxes);
+    std::vector<int> order;
+    std::vector<int> keep;
+    int kept = retinaface_nms(&cand, NMS_THRESHOLD, FRAME_WIDTH, FRAME_HEIGHT);
+    int ref_kept = all_pairs_nms(&cand, NMS_THRESHOLD, FRAME_WIDTH, FRAME_HEIGHT, order, keep);
+
+    int failed = 0;
+    if (kept != ref_kept || !std::equal(keep.begin(), keep.end(), cand.keep)) {
+        printf("FAIL %s: kept %d candidates, all-pairs NMS kept %d\n", label, kept, ref_kept);
+        for (int i = 0; i < std::max(kept, ref_kept); i++) {
+            int got = i < kept ? cand.keep[i] : -1;
+            int expected = i < ref_kept ? keep[i] : -1;
+            if (got != expected) {
+                printf("  first difference at %d: %d, expected %d\n", i, got, expected);
+                break;
+            }
+        }
+        failed = 1;
+    }
+
+    double grid_us = time_us(passes, [&] { retinaface_nms(&cand, NMS_THRESHOLD, FRAME_WIDTH, FRAME_HEIGHT); });
+    double ref_us = time_us(passes, [&] { all_pairs_nms(&cand, NMS_THRESHOLD, FRAME_WIDTH, FRAME_HEIGHT, order, keep); });
+    printf("  %-14s %4d candidates %4d kept  grid %8.2f us  all-pairs %8.2f us\n", label, cand.count, kept, grid_us,
+           ref_us);
+    retinaface_candidates_release(&cand);
+    return failed;
+}
+
+int main(int argc, char** argv) {
+    int passes = argc > 1 ? atoi(argv[1]) : 200;
+    if (passes <= 0) {
+        passes = 1;
+    }
+    int failed = 0;
+    int total = 0;
+
+    printf("nms_bench: %dx%d frame, threshold %.2f, %d passes\n", FRAME_WIDTH, FRAME_HEIGHT, NMS_THRESHOLD, passes);
+    static const int crowds[] = {100, 150, 300};
+    for (int faces : crowds) {
+        char label[32];
+        snprintf(label, sizeof(label), "crowd %d", faces);
+        failed += run(label, make_crowd(faces), MODEL_CAPACITY, passes);
+        total++;
+    }
+
+    // size the buffer to the candidates so the link pool is at its smallest
+    int links = 0;
+    std::vector<Box> strips = make_strips(&links);
+    int capacity = (int)strips.size();
+    int pool = std::max(capacity * 4, 256);
+    if (links <= pool) {
+        printf("FAIL strips: %d cell links fit the %d link pool, the fallback is not reached\n", links, pool);
+        failed++;
+    }
+    failed += run("strips", strips, capacity, passes);
+    total += 2;
+
+    printf("nms_bench: %d/%d runs match the all-pairs NMS\n", total - failed, total);
+    return failed ? 1 : 0;
+}
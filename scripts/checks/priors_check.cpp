@@ -0,0 +1,167 @@
+/*
+ * Check of the generated anchor priors (src/retinaface_postprocess.cc).
+ *
+ * The prior counts of the two shipped model sizes must match the tables
+ * retinaface_priors_generate() replaced (BOX_PRIORS_320 and BOX_PRIORS_640
+ * in the old include/rknn_box_priors.h), and the first and last two anchors
+ * of each stride must match their rows. Non-square inputs, including sizes
+ * that are not a multiple of the largest stride, are compared anchor by
+ * anchor with the RetinaFace config recomputed in double precision.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "retinaface_postprocess.h"
+
+// rows of the old tables are printed with six decimals
+#define TABLE_TOLERANCE 1e-6f
+
+typedef struct {
+    int index;
+    float prior[4];     // cx, cy, w, h
+} table_row_t;
+
+// first and last two rows of each stride (8, 16, 32), from the old tables
+static const table_row_t TABLE_320[] = {
+    {0, {0.012500f, 0.012500f, 0.050000f, 0.050000f}},
+    {1, {0.012500f, 0.012500f, 0.100000f, 0.100000f}},
+    {3198, {0.987500f, 0.987500f, 0.050000f, 0.050000f}},
+    {3199, {0.987500f, 0.987500f, 0.100000f, 0.100000f}},
+    {3200, {0.025000f, 0.025000f, 0.200000f, 0.200000f}},
+    {3201, {0.025000f, 0.025000f, 0.400000f, 0.400000f}},
+    {3998, {0.975000f, 0.975000f, 0.200000f, 0.200000f}},
+    {3999, {0.975000f, 0.975000f, 0.400000f, 0.400000f}},
+    {4000, {0.050000f, 0.050000f, 0.800000f, 0.800000f}},
+    {4001, {0.050000f, 0.050000f, 1.600000f, 1.600000f}},
+    {4198, {0.950000f, 0.950000f, 0.800000f, 0.800000f}},
+    {4199, {0.950000f, 0.950000f, 1.600000f, 1.600000f}},
+};
+
+static const table_row_t TABLE_640[] = {
+    {0, {0.006250f, 0.006250f, 0.025000f, 0.025000f}},
+    {1, {0.006250f, 0.006250f, 0.050000f, 0.050000f}},
+    {12798, {0.993750f, 0.993750f, 0.025000f, 0.025000f}},
+    {12799, {0.993750f, 0.993750f, 0.050000f, 0.050000f}},
+    {12800, {0.012500f, 0.012500f, 0.100000f, 0.100000f}},
+    {12801, {0.012500f, 0.012500f, 0.200000f, 0.200000f}},
+    {15998, {0.987500f, 0.987500f, 0.100000f, 0.100000f}},
+    {15999, {0.987500f, 0.987500f, 0.200000f, 0.200000f}},
+    {16000, {0.025000f, 0.025000f, 0.400000f, 0.400000f}},
+    {16001, {0.025000f, 0.025000f, 0.800000f, 0.800000f}},
+    {16798, {0.975000f, 0.975000f, 0.400000f, 0.400000f}},
+    {16799, {0.975000f, 0.975000f, 0.800000f, 0.800000f}},
+};
+
+static int prior_differs(const retinaface_priors_t *priors, int i, const float expected[4], float tolerance) {
+    float got[4] = {priors->cx[i], priors->cy[i], priors->w[i], priors->h[i]};
+    for (int k = 0; k < 4; ++k) {
+        if (fabsf(got[k] - expected[k]) > tolerance) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int print_prior_failure(const char *label, const retinaface_priors_t *priors, int i, const float expected[4]) {
+    printf("FAIL %s prior %d: %f,%f,%f,%f, expected %f,%f,%f,%f\n", label, i, priors->cx[i], priors->cy[i],
+           priors->w[i], priors->h[i], expected[0], expected[1], expected[2], expected[3]);
+    return 1;
+}
+
+static int generate(const char *label, retinaface_priors_t *priors, int model_w, int model_h, int expected_count) {
+    int count = retinaface_count_priors(model_w, model_h);
+    if (count != expected_count) {
+        printf("FAIL %s: retinaface_count_priors is %d, expected %d\n", label, count, expected_count);
+        return 1;
+    }
+    if (retinaface_priors_generate(priors, model_w, model_h) != 0) {
+        printf("FAIL %s: retinaface_priors_generate failed\n", label);
+        return 1;
+    }
+    if (priors->count != expected_count) {
+        printf("FAIL %s: generated %d priors, expected %d\n", label, priors->count, expected_count);
+        return 1;
+    }
+    const float *planes[4] = {priors->cx, priors->cy, priors->w, priors->h};
+    for (int k = 0; k < 4; ++k) {
+        if ((uintptr_t)planes[k] % 16 != 0) {
+            printf("FAIL %s: prior plane %d is not 16-byte aligned\n", label, k);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int check_table(const char *label, int model_size, int expected_count, const table_row_t *rows, int n_rows) {
+    retinaface_priors_t priors;
+    if (generate(label, &priors, model_size, model_size, expected_count) != 0) {
+        retinaface_priors_release(&priors);
+        return 1;
+    }
+    int failed = 0;
+    for (int r = 0; r < n_rows; ++r) {
+        if (prior_differs(&priors, rows[r].index, rows[r].prior, TABLE_TOLERANCE)) {
+            failed += print_prior_failure(label, &priors, rows[r].index, rows[r].prior);
+        }
+    }
+    retinaface_priors_release(&priors);
+    return failed;
+}
+
+static int check_config(const char *label, int model_w, int model_h, int expected_count) {
+    static const int steps[3] = {8, 16, 32};
+    static const int min_sizes[3][2] = {{16, 32}, {64, 128}, {256, 512}};
+    retinaface_priors_t priors;
+    if (generate(label, &priors, model_w, model_h, expected_count) != 0) {
+        retinaface_priors_release(&priors);
+        return 1;
+    }
+    int failed = 0;
+    int n = 0;
+    for (int k = 0; k < 3; ++k) {
+        int fm_h = (int)ceil((double)model_h / steps[k]);
+        int fm_w = (int)ceil((double)model_w / steps[k]);
+        for (int i = 0; i < fm_h; ++i) {
+            for (int j = 0; j < fm_w; ++j) {
+                for (int m = 0; m < 2; ++m, ++n) {
+                    float expected[4] = {
+                        (float)((j + 0.5) * steps[k] / model_w),
+                        (float)((i + 0.5) * steps[k] / model_h),
+                        (float)((double)min_sizes[k][m] / model_w),
+                        (float)((double)min_sizes[k][m] / model_h),
+                    };
+                    if (prior_differs(&priors, n, expected, 1e-6f) && failed < 8) {
+                        failed += print_prior_failure(label, &priors, n, expected);
+                    }
+                }
+            }
+        }
+    }
+    retinaface_priors_release(&priors);
+    return failed;
+}
+
+int main(void) {
+    int failed = 0;
+    int total = 0;
+
+    failed += check_table("320x320", 320, 4200, TABLE_320, (int)(sizeof(TABLE_320) / sizeof(TABLE_320[0]))) != 0;
+    failed += check_table("640x640", 640, 16800, TABLE_640, (int)(sizeof(TABLE_640) / sizeof(TABLE_640[0]))) != 0;
+    // 480x320: 60x40, 30x20 and 15x10 feature maps
+    failed += check_config("480x320", 480, 320, (60 * 40 + 30 * 20 + 15 * 10) * 2) != 0;
+    // 320x480 transposed, and 500x300 where the feature maps are ceil'd
+    failed += check_config("320x480", 320, 480, (40 * 60 + 20 * 30 + 10 * 15) * 2) != 0;
+    failed += check_config("500x300", 500, 300, (63 * 38 + 32 * 19 + 16 * 10) * 2) != 0;
+    total += 5;
+
+    retinaface_priors_t priors;
+    if (retinaface_priors_generate(&priors, 0, 320) == 0 || priors.count != 0) {
+        printf("FAIL 0x320: invalid model size was not refused\n");
+        failed++;
+    }
+    total++;
+
+    printf("priors_check: %d/%d model sizes match\n", total - failed, total);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Check of the int8 RetinaFace post-process (src/retinaface_postprocess.cc),
+ * the host-side counterpart of building with RETINAFACE_VALIDATE_INT8.
+ *
+ * Synthetic loc/conf/landm tensors are quantized with non-zero zero points.
+ * retinaface_compact_scores_i8 and retinaface_decode_candidates_i8 must
+ * select exactly the candidates the float retinaface_compact_scores selects
+ * on the dequantized tensors, with the same scores and decoded values. The
+ * decoded values must also stay within one quantization step of decoding the
+ * unquantized tensors. Face scores are planted at the int8 cutoff
+ * floor(threshold / scale + zp) and one step either side of it, in both the
+ * vector blocks and the scalar tail, for exact and inexact cutoffs.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "retinaface_postprocess.h"
+
+#define CONF_THRESHOLD 0.5f
+#define LOC_SCALE 0.021f
+#define LOC_ZP 5
+#define LANDM_SCALE 0.033f
+#define LANDM_ZP (-9)
+
+typedef struct {
+    const char *label;
+    float scale;
+    int32_t zp;
+} conf_quant_t;
+
+static uint32_t rng_state = 12345;
+static uint32_t rng() {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static float uniform(float lo, float hi) { return lo + (hi - lo) * (float)(rng() % 65536) / 65536.f; }
+
+static int8_t quantize(float x, float scale, int32_t zp) {
+    int q = (int)lrintf(x / scale) + zp;
+    return (int8_t)(q < -128 ? -128 : (q > 127 ? 127 : q));
+}
+
+static void dequantize(const std::vector<int8_t> &q, float scale, int32_t zp, std::vector<float> &out) {
+    out.resize(q.size());
+    for (size_t i = 0; i < q.size(); ++i) {
+        out[i] = (q[i] - zp) * scale;
+    }
+}
+
+// Decode the given priors from float tensors into cand
+static void decode_priors(const float *loc, const float *landms, const retinaface_priors_t *priors,
+                          const int *prior, int count, retinaface_candidates_t *cand) {
+    for (int k = 0; k < count; ++k) {
+        cand->prior[k] = prior[k];
+    }
+    cand->count = count;
+    retinaface_decode_candidates(loc, landms, priors, cand);
+}
+
+static int check_config(const retinaface_priors_t *priors, const conf_quant_t *conf, int *planted) {
+    int n = priors->count;
+    std::vector<float> loc(n * 4);
+    std::vector<float> landms(n * 10);
+    std::vector<int8_t> q_loc(n * 4);
+    std::vector<int8_t> q_conf(n * 2);
+    std::vector<int8_t> q_landms(n * 10);
+    for (int i = 0; i < n * 4; ++i) {
+        loc[i] = uniform(-2.f, 2.f);
+        q_loc[i] = quantize(loc[i], LOC_SCALE, LOC_ZP);
+    }
+    for (int i = 0; i < n * 10; ++i) {
+        landms[i] = uniform(-3.f, 3.f);
+        q_landms[i] = quantize(landms[i], LANDM_SCALE, LANDM_ZP);
+    }
+    for (int i = 0; i < n; ++i) {
+        // mostly background, one prior in eight a likely face
+        float face = rng() % 8 == 0 ? uniform(0.3f, 1.f) : uniform(0.f, 0.3f);
+        q_conf[i * 2] = quantize(1.f - face, conf->scale, conf->zp);
+        q_conf[i * 2 + 1] = quantize(face, conf->scale, conf->zp);
+    }
+
+    // plant the cutoff and one step either side in vector blocks and in the tail
+    int cutoff = (int)floorf(CONF_THRESHOLD / conf->scale + conf->zp);
+    *planted = 0;
+    for (int d = -1; d <= 1; ++d) {
+        int q = cutoff + d;
+        if (q < -128 || q > 127) {
+            continue;
+        }
+        const int at[4] = {16 * 3 + d + 1, 16 * 17 + 15 - d, n - 16 * 2 + d + 5, n - 1 - d - 1};
+        for (int p = 0; p < 4; ++p) {
+            q_conf[at[p] * 2 + 1] = (int8_t)q;
+            (*planted)++;
+        }
+    }
+
+    std::vector<float> deq_loc, deq_conf, deq_landms;
+    dequantize(q_loc, LOC_SCALE, LOC_ZP, deq_loc);
+    dequantize(q_conf, conf->scale, conf->zp, deq_conf);
+    dequantize(q_landms, LANDM_SCALE, LANDM_ZP, deq_landms);
+
+    retinaface_candidates_t cand, ref, exact;
+    int failed = 0;
+    if (retinaface_candidates_init(&cand, n) != 0 || retinaface_candidates_init(&ref, n) != 0 ||
+        retinaface_candidates_init(&exact, n) != 0) {
+        printf("FAIL %s: retinaface_candidates_init failed\n", conf->label);
+        return 1;
+    }
+
+    retinaface_compact_scores_i8(q_conf.data(), conf->zp, conf->scale, n, CONF_THRESHOLD, &cand);
+    retinaface_decode_candidates_i8(q_loc.data(), LOC_ZP, LOC_SCALE, q_landms.data(), LANDM_ZP, LANDM_SCALE, priors,
+                                    &cand);
+    retinaface_compact_scores(deq_conf.data(), n, CONF_THRESHOLD, &ref);
+    retinaface_decode_candidates(deq_loc.data(), deq_landms.data(), priors, &ref);
+    decode_priors(loc.data(), landms.data(), priors, cand.prior, cand.count, &exact);
+
+    if (cand.count != ref.count) {
+        printf("FAIL %s: int8 kept %d candidates, float %d\n", conf->label, cand.count, ref.count);
+        failed++;
+    }
+    for (int k = 0; k < cand.count && k < ref.count && failed < 8; ++k) {
+        int i = cand.prior[k];
+        if (i != ref.prior[k] || cand.score[k] != ref.score[k]) {
+            printf("FAIL %s candidate %d: int8 prior %d score %f, float prior %d score %f\n", conf->label, k, i,
+                   cand.score[k], ref.prior[k], ref.score[k]);
+            failed++;
+            continue;
+        }
+        // one step of loc moves the center by VARIANCE0 * loc_scale * prior
+        // size and scales the size by exp(VARIANCE1 * loc_scale)
+        float pw = priors->w[i];
+        float ph = priors->h[i];
+        float w = exact.box[k * 4 + 2] - exact.box[k * 4 + 0];
+        float h = exact.box[k * 4 + 3] - exact.box[k * 4 + 1];
+        float growth = expf(0.2f * LOC_SCALE) - 1.f;
+        float box_tol[2] = {0.1f * LOC_SCALE * pw + 0.5f * w * growth, 0.1f * LOC_SCALE * ph + 0.5f * h * growth};
+        float landm_tol[2] = {0.1f * LANDM_SCALE * pw, 0.1f * LANDM_SCALE * ph};
+        for (int j = 0; j < 4; ++j) {
+            float got = cand.box[k * 4 + j];
+            if (fabsf(got - ref.box[k * 4 + j]) > 1e-6f || fabsf(got - exact.box[k * 4 + j]) > box_tol[j & 1] + 1e-6f) {
+                printf("FAIL %s prior %d box[%d]: int8 %f, dequantized %f, unquantized %f\n", conf->label, i, j, got,
+                       ref.box[k * 4 + j], exact.box[k * 4 + j]);
+                failed++;
+            }
+        }
+        for (int j = 0; j < 10; ++j) {
+            float got = cand.landms[k * 10 + j];
+            if (fabsf(got - ref.landms[k * 10 + j]) > 1e-6f ||
+                fabsf(got - exact.landms[k * 10 + j]) > landm_tol[j & 1] + 1e-6f) {
+                printf("FAIL %s prior %d landm[%d]: int8 %f, dequantized %f, unquantized %f\n", conf->label, i, j,
+                       got, ref.landms[k * 10 + j], exact.landms[k * 10 + j]);
+                failed++;
+            }
+        }
+    }
+
+    retinaface_candidates_release(&cand);
+    retinaface_candidates_release(&ref);
+    retinaface_candidates_release(&exact);
+    return failed;
+}
+
+int main(void) {
+    static const conf_quant_t fixed[] = {
+        {"softmax 1/256 zp -128", 1.f / 256, -128},     // threshold lands exactly on a step
+        {"scale 0.0037 zp -120", 0.0037f, -120},
+        {"scale 0.0041 zp 17", 0.0041f, 17},
+        {"scale 0.0079 zp -64", 0.0079f, -64},
+        {"1/512 zp -128", 1.f / 512, -128},             // cutoff above 127, nothing passes
+    };
+    int failed = 0;
+    int total = 0;
+    int planted = 0;
+    const int sizes[2][2] = {{320, 320}, {480, 320}};
+
+    for (int s = 0; s < 2; ++s) {
+        retinaface_priors_t priors;
+        if (retinaface_priors_generate(&priors, sizes[s][0], sizes[s][1]) != 0) {
+            printf("FAIL %dx%d: retinaface_priors_generate failed\n", sizes[s][0], sizes[s][1]);
+            return 1;
+        }
+        for (const conf_quant_t &conf : fixed) {
+            int p = 0;
+            failed += check_config(&priors, &conf, &p) != 0;
+            planted += p;
+            total++;
+        }
+        // random conf quantizations whose cutoff is representable
+        for (int r = 0; r < 40; ++r) {
+            char label[48];
+            conf_quant_t conf = {label, uniform(0.0021f, 0.0079f), (int32_t)(rng() % 160) - 128};
+            int cutoff = (int)floorf(CONF_THRESHOLD / conf.scale + conf.zp);
+            if (cutoff > 126) {
+                conf.zp -= cutoff - 126;
+            }
+            snprintf(label, sizeof(label), "scale %.6f zp %d", conf.scale, conf.zp);
+            int p = 0;
+            failed += check_config(&priors, &conf, &p) != 0;
+            planted += p;
+            total++;
+        }
+        retinaface_priors_release(&priors);
+    }
+
+    printf("quant_check: %d/%d quantizations match the float post-process, %d cutoff scores planted\n",
+           total - failed, total, planted);
+    return failed ? 1 : 0;
+}
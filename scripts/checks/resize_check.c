@@ -0,0 +1,307 @@
+/*
+ * Bit-exact check of the CPU resize (src/image_resize.c).
+ *
+ * Every case is recomputed pixel by pixel from the Q8 formula, without the
+ * coefficient tables, the cached rows or the vector kernels, and compared
+ * byte for byte, pad border included. A sequence of geometries through one
+ * resize_tables_t checks that kept tables are reused and rebuilt, and a dst
+ * box outside the image must be refused. Built once with the NEON or SSE2
+ * kernels of the target and once with IMAGE_RESIZE_NO_SIMD, so both are held
+ * to the same scalar result.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "image_resize.h"
+
+#define COEF_ONE 256
+#define SENTINEL 0x5a
+
+#if !defined(IMAGE_RESIZE_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+static const char* kernel_name = "neon";
+#elif !defined(IMAGE_RESIZE_NO_SIMD) && defined(__SSE2__)
+static const char* kernel_name = "sse2";
+#else
+static const char* kernel_name = "scalar";
+#endif
+
+typedef struct {
+    image_format_t src_format;
+    image_format_t dst_format;
+    int src_width, src_height;
+    int dst_width, dst_height;
+    int use_src_box;
+    image_rect_t src_box;
+    int use_dst_box;
+    image_rect_t dst_box;
+    int fill_pad;
+    int fill;               // -1 random pixels, else every source byte
+} resize_case_t;
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static const char* format_name(image_format_t fmt)
+{
+    switch (fmt) {
+    case IMAGE_FORMAT_GRAY8: return "GRAY8";
+    case IMAGE_FORMAT_RGB888: return "RGB888";
+    case IMAGE_FORMAT_BGR888: return "BGR888";
+    case IMAGE_FORMAT_RGBA8888: return "RGBA8888";
+    case IMAGE_FORMAT_YUV420SP_NV12: return "NV12";
+    case IMAGE_FORMAT_YUV420SP_NV21: return "NV21";
+    default: return "?";
+    }
+}
+
+static int format_channels(image_format_t fmt)
+{
+    switch (fmt) {
+    case IMAGE_FORMAT_GRAY8: return 1;
+    case IMAGE_FORMAT_RGB888:
+    case IMAGE_FORMAT_BGR888: return 3;
+    case IMAGE_FORMAT_RGBA8888: return 4;
+    default: return 0;
+    }
+}
+
+static int image_bytes(image_format_t fmt, int width, int height)
+{
+    int channel = format_channels(fmt);
+    return channel ? width * height * channel : width * height * 3 / 2;
+}
+
+// source index and Q8 weight of destination position d, straight from the mapping
+static int ref_coef(int d, int crop_start, int crop_len, int dst_len, int src_len, int *s0, int *s1)
+{
+    long num = (long)d * crop_len;
+    *s0 = crop_start + (int)(num / dst_len);
+    *s1 = *s0 + 1 < src_len ? *s0 + 1 : src_len - 1;
+    return (int)(((num % dst_len) * COEF_ONE + dst_len / 2) / dst_len);
+}
+
+static void ref_fill(uint8_t *dst, int width, int height, int channel,
+                     int bx, int by, int bw, int bh, uint8_t color)
+{
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (x < bx || x >= bx + bw || y < by || y >= by + bh) {
+                memset(dst + ((size_t)y * width + x) * channel, color, channel);
+            }
+        }
+    }
+}
+
+static void ref_resize(const uint8_t *src, int sw, int sh, int channel, int swap_rb,
+                       int cx, int cy, int cw, int ch,
+                       uint8_t *dst, int dw, int bx, int by, int bw, int bh)
+{
+    for (int dy = 0; dy < bh; dy++) {
+        int y0, y1;
+        int b = ref_coef(dy, cy, ch, bh, sh, &y0, &y1);
+        for (int dx = 0; dx < bw; dx++) {
+            int x0, x1;
+            int a = ref_coef(dx, cx, cw, bw, sw, &x0, &x1);
+            for (int c = 0; c < channel; c++) {
+                int k = swap_rb && c != 1 && c < 3 ? 2 - c : c;
+                uint32_t h0 = src[((size_t)y0 * sw + x0) * channel + k] * (COEF_ONE - a) +
+                              src[((size_t)y0 * sw + x1) * channel + k] * a;
+                uint32_t h1 = src[((size_t)y1 * sw + x0) * channel + k] * (COEF_ONE - a) +
+                              src[((size_t)y1 * sw + x1) * channel + k] * a;
+                dst[((size_t)(by + dy) * dw + bx + dx) * channel + c] =
+                    (uint8_t)((h0 * (COEF_ONE - b) + h1 * b + (1 << 15)) >> 16);
+            }
+        }
+    }
+}
+
+static void ref_convert(const resize_case_t *t, const uint8_t *src, uint8_t *dst, uint8_t color)
+{
+    int cx = 0, cy = 0, cw = t->src_width, ch = t->src_height;
+    if (t->use_src_box) {
+        cx = t->src_box.left;
+        cy = t->src_box.top;
+        cw = t->src_box.right - t->src_box.left + 1;
+        ch = t->src_box.bottom - t->src_box.top + 1;
+    }
+    int bx = 0, by = 0, bw = t->dst_width, bh = t->dst_height;
+    if (t->use_dst_box) {
+        bx = t->dst_box.left;
+        by = t->dst_box.top;
+        bw = t->dst_box.right - t->dst_box.left + 1;
+        bh = t->dst_box.bottom - t->dst_box.top + 1;
+    }
+    int pad = t->fill_pad && (bw != t->dst_width || bh != t->dst_height);
+    int channel = format_channels(t->src_format);
+    if (channel == 0) {
+        int sw = t->src_width, sh = t->src_height, dw = t->dst_width, dh = t->dst_height;
+        if (pad) {
+            ref_fill(dst, dw, dh, 1, bx, by, bw, bh, color);
+            ref_fill(dst + dw * dh, dw / 2, dh / 2, 2, bx / 2, by / 2, bw / 2, bh / 2, color);
+        }
+        ref_resize(src, sw, sh, 1, 0, cx, cy, cw, ch, dst, dw, bx, by, bw, bh);
+        ref_resize(src + sw * sh, sw / 2, sh / 2, 2, 0, cx / 2, cy / 2, cw / 2, ch / 2,
+                   dst + dw * dh, dw / 2, bx / 2, by / 2, bw / 2, bh / 2);
+        return;
+    }
+    if (pad) {
+        ref_fill(dst, t->dst_width, t->dst_height, channel, bx, by, bw, bh, color);
+    }
+    ref_resize(src, t->src_width, t->src_height, channel, t->src_format != t->dst_format,
+               cx, cy, cw, ch, dst, t->dst_width, bx, by, bw, bh);
+}
+
+static int run_case(const char *label, const resize_case_t *t, resize_tables_t *tables)
+{
+    const uint8_t color = 114;
+    int src_size = image_bytes(t->src_format, t->src_width, t->src_height);
+    int dst_size = image_bytes(t->dst_format, t->dst_width, t->dst_height);
+    uint8_t *src = (uint8_t *)malloc(src_size);
+    uint8_t *dst = (uint8_t *)malloc(dst_size);
+    uint8_t *expect = (uint8_t *)malloc(dst_size);
+    for (int i = 0; i < src_size; i++) {
+        src[i] = t->fill < 0 ? (uint8_t)rng() : (uint8_t)t->fill;
+    }
+    memset(dst, SENTINEL, dst_size);
+    memset(expect, SENTINEL, dst_size);
+
+    image_buffer_t src_img = {t->src_width, t->src_height, t->src_width, t->src_height, t->src_format, src, src_size, -1};
+    image_buffer_t dst_img = {t->dst_width, t->dst_height, t->dst_width, t->dst_height, t->dst_format, dst, dst_size, -1};
+    image_rect_t src_box = t->src_box;
+    image_rect_t dst_box = t->dst_box;
+    int ret = convert_image_cpu(&src_img, &dst_img, t->use_src_box ? &src_box : NULL,
+                                t->use_dst_box ? &dst_box : NULL, (char)color, t->fill_pad, tables);
+    ref_convert(t, src, expect, color);
+
+    int failed = 0;
+    if (ret != 0) {
+        printf("FAIL %s: convert_image_cpu returned %d\n", label, ret);
+        failed = 1;
+    } else {
+        for (int i = 0; i < dst_size; i++) {
+            if (dst[i] != expect[i]) {
+                printf("FAIL %s %s->%s %dx%d->%dx%d: byte %d is %d, expected %d\n", label,
+                       format_name(t->src_format), format_name(t->dst_format), t->src_width, t->src_height,
+                       t->dst_width, t->dst_height, i, dst[i], expect[i]);
+                failed = 1;
+                break;
+            }
+        }
+    }
+    free(src);
+    free(dst);
+    free(expect);
+    return failed;
+}
+
+// box inside an image, even coordinates and sizes when the format is semi-planar
+static image_rect_t random_box(int width, int height, int even)
+{
+    int step = even ? 2 : 1;
+    int w = step * (1 + rng() % (width / step));
+    int h = step * (1 + rng() % (height / step));
+    int x = step * (rng() % ((width - w) / step + 1));
+    int y = step * (rng() % ((height - h) / step + 1));
+    image_rect_t box = {x, y, x + w - 1, y + h - 1};
+    return box;
+}
+
+static int run_random(image_format_t src_format, image_format_t dst_format, int n)
+{
+    int failed = 0;
+    int even = format_channels(src_format) == 0;
+    for (int i = 0; i < n; i++) {
+        resize_case_t t;
+        memset(&t, 0, sizeof(t));
+        t.src_format = src_format;
+        t.dst_format = dst_format;
+        t.src_width = (even ? 2 : 1) * (1 + rng() % (even ? 200 : 400));
+        t.src_height = (even ? 2 : 1) * (1 + rng() % (even ? 150 : 300));
+        t.dst_width = (even ? 2 : 1) * (1 + rng() % (even ? 180 : 360));
+        t.dst_height = (even ? 2 : 1) * (1 + rng() % (even ? 120 : 240));
+        t.use_src_box = rng() % 2;
+        t.src_box = random_box(t.src_width, t.src_height, even);
+        t.use_dst_box = rng() % 2;
+        t.dst_box = random_box(t.dst_width, t.dst_height, even);
+        t.fill_pad = rng() % 2;
+        t.fill = -1;
+        failed += run_case("random", &t, NULL);
+    }
+    return failed;
+}
+
+int main(void)
+{
+    // the letterboxes the pipeline runs into the 320x320 RetinaFace input, a
+    // crop into a 2x2 ROI tile, odd sizes that end in the kernel tail, and
+    // all-255 sources at the top of the fixed-point range
+    const resize_case_t cases[] = {
+        {IMAGE_FORMAT_BGR888, IMAGE_FORMAT_RGB888, 640, 480, 320, 320, 0, {0}, 1, {0, 40, 319, 279}, 1, -1},
+        {IMAGE_FORMAT_BGR888, IMAGE_FORMAT_RGB888, 1280, 720, 320, 320, 0, {0}, 1, {0, 70, 319, 249}, 1, -1},
+        {IMAGE_FORMAT_RGB888, IMAGE_FORMAT_RGB888, 640, 480, 320, 320, 0, {0}, 1, {0, 40, 319, 279}, 1, -1},
+        {IMAGE_FORMAT_RGB888, IMAGE_FORMAT_BGR888, 320, 240, 320, 320, 0, {0}, 1, {0, 40, 319, 279}, 1, -1},
+        {IMAGE_FORMAT_BGR888, IMAGE_FORMAT_RGB888, 640, 480, 320, 320, 1, {213, 97, 402, 310}, 1, {160, 0, 319, 159}, 0, -1},
+        {IMAGE_FORMAT_RGB888, IMAGE_FORMAT_RGB888, 37, 23, 13, 11, 0, {0}, 0, {0}, 1, -1},
+        {IMAGE_FORMAT_RGB888, IMAGE_FORMAT_RGB888, 640, 480, 320, 320, 0, {0}, 1, {0, 40, 319, 279}, 1, 255},
+        {IMAGE_FORMAT_RGBA8888, IMAGE_FORMAT_RGBA8888, 640, 480, 320, 320, 0, {0}, 1, {0, 40, 319, 279}, 1, -1},
+        {IMAGE_FORMAT_RGBA8888, IMAGE_FORMAT_RGBA8888, 50, 37, 203, 151, 0, {0}, 0, {0}, 1, -1},
+        {IMAGE_FORMAT_RGBA8888, IMAGE_FORMAT_RGBA8888, 333, 201, 257, 129, 0, {0}, 0, {0}, 1, 255},
+        {IMAGE_FORMAT_YUV420SP_NV12, IMAGE_FORMAT_YUV420SP_NV12, 640, 480, 320, 320, 0, {0}, 1, {0, 40, 319, 279}, 1, -1},
+        {IMAGE_FORMAT_YUV420SP_NV12, IMAGE_FORMAT_YUV420SP_NV12, 1920, 1080, 640, 640, 0, {0}, 1, {0, 140, 639, 499}, 1, -1},
+        {IMAGE_FORMAT_YUV420SP_NV12, IMAGE_FORMAT_YUV420SP_NV12, 640, 480, 320, 320, 1, {100, 60, 299, 259}, 1, {0, 160, 159, 319}, 0, 255},
+        {IMAGE_FORMAT_GRAY8, IMAGE_FORMAT_GRAY8, 101, 77, 61, 45, 0, {0}, 0, {0}, 1, -1},
+    };
+    int n_cases = (int)(sizeof(cases) / sizeof(cases[0]));
+
+    int failed = 0;
+    for (int i = 0; i < n_cases; i++) {
+        failed += run_case("fixed", &cases[i], NULL);
+    }
+    failed += run_random(IMAGE_FORMAT_RGB888, IMAGE_FORMAT_RGB888, 100);
+    failed += run_random(IMAGE_FORMAT_BGR888, IMAGE_FORMAT_RGB888, 100);
+    failed += run_random(IMAGE_FORMAT_RGBA8888, IMAGE_FORMAT_RGBA8888, 100);
+    failed += run_random(IMAGE_FORMAT_YUV420SP_NV12, IMAGE_FORMAT_YUV420SP_NV12, 100);
+    failed += run_random(IMAGE_FORMAT_GRAY8, IMAGE_FORMAT_GRAY8, 50);
+
+    // through kept tables: the same geometry twice reuses them, any change rebuilds
+    static const int sequence[] = {0, 0, 1, 0, 10, 10, 4, 7, 12, 0, 11, 2};
+    int n_sequence = (int)(sizeof(sequence) / sizeof(sequence[0]));
+    resize_tables_t tables;
+    memset(&tables, 0, sizeof(tables));
+    for (int i = 0; i < n_sequence; i++) {
+        const resize_case_t *t = &cases[sequence[i]];
+        void *kept = tables.plane[0].tables;
+        failed += run_case("kept tables", t, &tables);
+        if (i > 0 && sequence[i] == sequence[i - 1] && tables.plane[0].tables != kept) {
+            printf("FAIL kept tables: rebuilt for an unchanged geometry\n");
+            failed++;
+        }
+    }
+    release_resize_tables(&tables);
+
+    // a dst box reaching past the image is refused before anything is written
+    uint8_t small_src[8 * 8 * 3], small_dst[4 * 4 * 3];
+    memset(small_dst, SENTINEL, sizeof(small_dst));
+    image_buffer_t small_src_img = {8, 8, 8, 8, IMAGE_FORMAT_RGB888, small_src, sizeof(small_src), -1};
+    image_buffer_t small_dst_img = {4, 4, 4, 4, IMAGE_FORMAT_RGB888, small_dst, sizeof(small_dst), -1};
+    image_rect_t outside = {2, 0, 5, 3};
+    int refused = convert_image_cpu(&small_src_img, &small_dst_img, NULL, &outside, 0, 0, NULL) != 0;
+    for (size_t i = 0; i < sizeof(small_dst); i++) {
+        refused &= small_dst[i] == SENTINEL;
+    }
+    if (!refused) {
+        printf("FAIL dst box outside the image was not refused\n");
+        failed++;
+    }
+
+    int total = n_cases + 450 + n_sequence + 1;
+    printf("resize_check (%s kernel): %d/%d cases bit-exact\n", kernel_name, total - failed, total);
+    return failed ? 1 : 0;
+}
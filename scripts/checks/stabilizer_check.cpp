@@ -0,0 +1,139 @@
+/*
+ * Check of the partial transcript stabilizer (src/transcript_stabilizer.cpp).
+ *
+ * Scripted hypothesis sequences, as Whisper produces them while re-decoding
+ * a growing buffer, must publish: nothing for an unchanged or empty
+ * hypothesis, a growing prefix as it grows, and a revised tail without
+ * rewriting words that two hypotheses agreed on. The final transcript must
+ * be published even when it repeats the last partial or is empty after
+ * partials were shown. The session counters are checked after each script.
+ */
+#include <cstdio>
+#include <string>
+
+#include "transcript_stabilizer.h"
+
+#define COUNT(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+struct Step {
+    const char* hypothesis;
+    const char* published;      // nullptr: nothing is published
+};
+
+static int run_script(const char* name, TranscriptStabilizer& stabilizer, const Step* steps, int n) {
+    int failed = 0;
+    for (int i = 0; i < n; i++) {
+        std::string out;
+        bool published = stabilizer.update(steps[i].hypothesis, out);
+        if (steps[i].published == nullptr && published) {
+            printf("FAIL %s step %d \"%s\": published \"%s\", expected nothing\n", name, i, steps[i].hypothesis,
+                   out.c_str());
+            failed++;
+        } else if (steps[i].published != nullptr && (!published || out != steps[i].published)) {
+            printf("FAIL %s step %d \"%s\": %s \"%s\", expected \"%s\"\n", name, i, steps[i].hypothesis,
+                   published ? "published" : "suppressed", out.c_str(), steps[i].published);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+static int check_stats(const char* name, const TranscriptStabilizer& stabilizer, long decoded, long published,
+                       long unchanged, long stable_words) {
+    const PartialTranscriptStats& s = stabilizer.getStats();
+    if (s.decoded != decoded || s.published != published || s.unchanged != unchanged ||
+        s.stable_words != stable_words) {
+        printf("FAIL %s stats: decoded=%ld published=%ld unchanged=%ld stable_words=%ld, "
+               "expected %ld %ld %ld %ld\n",
+               name, s.decoded, s.published, s.unchanged, s.stable_words, decoded, published, unchanged,
+               stable_words);
+        return 1;
+    }
+    return 0;
+}
+
+static int check_final(const char* name, const TranscriptStabilizer& stabilizer, const char* final_text,
+                       bool expected) {
+    if (stabilizer.publishFinal(final_text) != expected) {
+        printf("FAIL %s: final \"%s\" is %s, expected %s\n", name, final_text,
+               expected ? "dropped" : "published", expected ? "published" : "dropped");
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    int failed = 0;
+    int scripts = 0;
+    TranscriptStabilizer stabilizer;
+
+    // the same text again, or a silent decode, publishes nothing
+    static const Step unchanged[] = {
+        {"turn on the lights", "turn on the lights"},
+        {"turn on the lights", nullptr},
+        {"  turn  on the\tlights ", nullptr},
+        {"", nullptr},
+        {"turn on the lights", nullptr},
+    };
+    failed += run_script("unchanged", stabilizer, unchanged, COUNT(unchanged));
+    failed += check_stats("unchanged", stabilizer, 5, 1, 4, 4);
+    failed += check_final("unchanged", stabilizer, "turn on the lights", true);
+    failed += check_final("unchanged", stabilizer, "", true);
+    scripts++;
+
+    // each longer hypothesis is published, the agreed prefix is committed
+    stabilizer.reset();
+    static const Step growing[] = {
+        {"what", "what"},
+        {"what is", "what is"},
+        {"what is the", "what is the"},
+        {"what is the weather", "what is the weather"},
+        {"what is the weather today", "what is the weather today"},
+    };
+    failed += run_script("growing", stabilizer, growing, COUNT(growing));
+    failed += check_stats("growing", stabilizer, 5, 5, 0, 4);
+    scripts++;
+
+    // a revised tail is published, committed words are not rewritten
+    stabilizer.reset();
+    static const Step revised[] = {
+        {"set a timer", "set a timer"},
+        {"set a timer for", "set a timer for"},         // commits "set a timer"
+        {"set a time for ten", "set a timer for ten"},  // a committed word revised, kept
+        {"set a timer for tin minutes", "set a timer for tin minutes"},
+        {"set a timer for ten minutes", "set a timer for ten minutes"},
+    };
+    // a hypothesis shorter than the committed words shows only those words
+    static const Step revised_shorter[] = {
+        {"set a timer for ten minutes please", "set a timer for ten minutes please"},
+        {"sat a timer", "set a timer for ten minutes"},
+    };
+    failed += run_script("revised", stabilizer, revised, COUNT(revised));
+    failed += check_stats("revised", stabilizer, 5, 5, 0, 4);
+    failed += run_script("revised", stabilizer, revised_shorter, COUNT(revised_shorter));
+    failed += check_stats("revised", stabilizer, 7, 7, 0, 6);
+    failed += check_final("revised", stabilizer, "set a timer for ten minutes", true);
+    scripts++;
+
+    // the final is published unless it is empty and nothing was shown
+    stabilizer.reset();
+    failed += check_final("final", stabilizer, "", false);
+    failed += check_final("final", stabilizer, "hello", true);
+    std::string out;
+    stabilizer.update("", out);
+    failed += check_final("final", stabilizer, "", false);
+    stabilizer.update("hello", out);
+    failed += check_final("final", stabilizer, "hello", true);
+    failed += check_final("final", stabilizer, "", true);
+    stabilizer.reset();
+    if (stabilizer.anyPublished()) {
+        printf("FAIL final: reset() kept the last published partial\n");
+        failed++;
+    }
+    failed += check_final("final", stabilizer, "", false);
+    failed += check_stats("reset", stabilizer, 0, 0, 0, 0);
+    scripts++;
+
+    printf("stabilizer_check: %d scripts, %d failures\n", scripts, failed);
+    return failed ? 1 : 0;
+}
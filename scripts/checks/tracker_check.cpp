@@ -0,0 +1,255 @@
+/*
+ * Check of the SORT-style face tracker (src/face_tracker.cpp).
+ *
+ * Synthetic faces with a few pixels of detector jitter are fed at 30 fps,
+ * with detections every Nth frame and predict() in between, as the
+ * inference thread runs it:
+ * - a face moving across the frame keeps one track id for N = 1, 3 and 5,
+ *   and the predicted box stays on the face between detections;
+ * - a face missing for max_misses detection rounds keeps its id, one that
+ *   is missing for one round more comes back with a new id;
+ * - two faces crossing each other, listed in alternating order, keep their
+ *   ids through the greedy IoU association.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "face_tracker.h"
+
+#define FPS 30
+#define MAX_DETECTIONS 8
+
+struct Face {
+    float cx, cy, w, h;
+};
+
+static uint32_t rng_state = 12345;
+static uint32_t rng() {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+// -2..2 pixels of detector jitter
+static int jitter() { return (int)(rng() % 5) - 2; }
+
+// Detection of a frontal face, landmarks placed like the pose template
+static retinaface_object_t detect(const Face& f) {
+    retinaface_object_t det{};
+    int cx = (int)lroundf(f.cx) + jitter();
+    int cy = (int)lroundf(f.cy) + jitter();
+    int hw = (int)lroundf(f.w * 0.5f);
+    int hh = (int)lroundf(f.h * 0.5f);
+    det.box = {cx - hw, cy - hh, cx + hw, cy + hh};
+    det.score = 0.9f;
+    static const float landmarks[5][2] = {{-0.2f, -0.15f}, {0.2f, -0.15f}, {0.f, 0.f}, {-0.16f, 0.18f}, {0.16f, 0.18f}};
+    for (int j = 0; j < 5; ++j) {
+        det.ponit[j].x = cx + (int)lroundf(landmarks[j][0] * f.w);
+        det.ponit[j].y = cy + (int)lroundf(landmarks[j][1] * f.h);
+    }
+    return det;
+}
+
+struct Frame {
+    retinaface_object_t objects[MAX_DETECTIONS];
+    retinaface_result result;
+
+    Frame() : result{0, MAX_DETECTIONS, objects} {}
+    void add(const Face& f) { objects[result.count++] = detect(f); }
+};
+
+static float iou(const box_rect_t& a, const Face& f) {
+    float l = std::max((float)a.left, f.cx - f.w * 0.5f);
+    float r = std::min((float)a.right, f.cx + f.w * 0.5f);
+    float t = std::max((float)a.top, f.cy - f.h * 0.5f);
+    float b = std::min((float)a.bottom, f.cy + f.h * 0.5f);
+    if (r <= l || b <= t) {
+        return 0.f;
+    }
+    float i = (r - l) * (b - t);
+    return i / ((a.right - a.left) * (a.bottom - a.top) + f.w * f.h - i);
+}
+
+static const FaceTrack* find(const FaceTracker& tracker, int id) {
+    for (const FaceTrack& t : tracker.getTracks()) {
+        if (t.id == id) {
+            return &t;
+        }
+    }
+    return nullptr;
+}
+
+static int check_moving(int interval) {
+    FaceTracker tracker;
+    const double dt = 1.0 / FPS;
+    Face face = {60.f, 240.f, 80.f, 100.f};
+    const float speed = 150.f;      // px/s, 25 px between detections at N = 5
+    int id = -1;
+    float min_iou = 1.f;
+    for (int f = 0; f < 108; ++f) {
+        face.cx = 60.f + speed * f / FPS;
+        if (f % interval == 0) {
+            Frame frame;
+            frame.add(face);
+            tracker.update(frame.result, dt);
+        } else {
+            tracker.predict(dt);
+        }
+        const std::vector<FaceTrack>& tracks = tracker.getTracks();
+        if (tracks.size() != 1) {
+            printf("FAIL moving N=%d frame %d: %zu tracks, expected 1\n", interval, f, tracks.size());
+            return 1;
+        }
+        if (id == -1) {
+            id = tracks[0].id;
+        } else if (tracks[0].id != id) {
+            printf("FAIL moving N=%d frame %d: track id changed from %d to %d\n", interval, f, id, tracks[0].id);
+            return 1;
+        }
+        if (f > interval && !tracks[0].visible(tracker.getConfig())) {
+            printf("FAIL moving N=%d frame %d: track not visible\n", interval, f);
+            return 1;
+        }
+        // from the third detection on the velocity is known
+        if (f >= 2 * interval) {
+            min_iou = std::min(min_iou, iou(tracks[0].face.box, face));
+        }
+    }
+    if (min_iou < 0.7f) {
+        printf("FAIL moving N=%d: predicted box IoU with the face fell to %.2f\n", interval, min_iou);
+        return 1;
+    }
+    printf("  moving face, detection every %d frame(s): track %d, min IoU %.2f\n", interval, id, min_iou);
+    return 0;
+}
+
+// Detection rounds of a stationary face, every 3rd frame, with the face
+// missing for `absent` rounds in the middle
+static int check_reentry(int absent, bool expect_new_id) {
+    FaceTracker tracker;
+    const int max_misses = tracker.getConfig().max_misses;
+    const double dt = 1.0 / FPS;
+    const Face face = {320.f, 240.f, 80.f, 100.f};
+    int before = -1;
+    int round = 0;
+    for (int f = 0; f < 3 * (10 + absent + 10); ++f) {
+        if (f % 3 != 0) {
+            tracker.predict(dt);
+            continue;
+        }
+        Frame frame;
+        bool present = round < 10 || round >= 10 + absent;
+        if (present) {
+            frame.add(face);
+        }
+        tracker.update(frame.result, dt);
+        round++;
+        const std::vector<FaceTrack>& tracks = tracker.getTracks();
+        if (round == 10) {
+            before = tracks.empty() ? -1 : tracks[0].id;
+        }
+        if (!present && !tracks.empty() && tracks[0].visible(tracker.getConfig())) {
+            printf("FAIL re-entry after %d rounds: missing face still visible\n", absent);
+            return 1;
+        }
+        if (!present && round - 10 > max_misses && !tracks.empty()) {
+            printf("FAIL re-entry after %d rounds: track kept after %d misses\n", absent, round - 10);
+            return 1;
+        }
+    }
+    const std::vector<FaceTrack>& tracks = tracker.getTracks();
+    if (tracks.size() != 1 || before == -1) {
+        printf("FAIL re-entry after %d rounds: %zu tracks at the end\n", absent, tracks.size());
+        return 1;
+    }
+    int after = tracks[0].id;
+    if ((after != before) != expect_new_id) {
+        printf("FAIL re-entry after %d rounds (max_misses %d): id %d then %d, expected %s id\n", absent, max_misses,
+               before, after, expect_new_id ? "a new" : "the same");
+        return 1;
+    }
+    if (!tracks[0].visible(tracker.getConfig())) {
+        printf("FAIL re-entry after %d rounds: track not visible again\n", absent);
+        return 1;
+    }
+    printf("  face missing for %d detection round(s): track %d, then %d\n", absent, before, after);
+    return 0;
+}
+
+static int check_crossing(int interval) {
+    FaceTracker tracker;
+    const double dt = 1.0 / FPS;
+    Face a = {100.f, 240.f, 90.f, 110.f};
+    Face b = {540.f, 252.f, 90.f, 110.f};
+    const float speed = 200.f;
+    int id_a = -1;
+    int id_b = -1;
+    for (int f = 0; f < 3 * FPS; ++f) {
+        a.cx = 100.f + speed * f / FPS;
+        b.cx = 540.f - speed * f / FPS;
+        if (f % interval == 0) {
+            Frame frame;
+            // alternate the detection order so the association can not rely on it
+            if ((f / interval) % 2) {
+                frame.add(a);
+                frame.add(b);
+            } else {
+                frame.add(b);
+                frame.add(a);
+            }
+            tracker.update(frame.result, dt);
+        } else {
+            tracker.predict(dt);
+        }
+        const std::vector<FaceTrack>& tracks = tracker.getTracks();
+        if (tracks.size() != 2) {
+            printf("FAIL crossing N=%d frame %d: %zu tracks, expected 2\n", interval, f, tracks.size());
+            return 1;
+        }
+        if (id_a == -1) {
+            bool first_is_a = fabsf(tracks[0].cx.pos - a.cx) < fabsf(tracks[1].cx.pos - a.cx);
+            id_a = tracks[first_is_a ? 0 : 1].id;
+            id_b = tracks[first_is_a ? 1 : 0].id;
+        }
+        const FaceTrack* ta = find(tracker, id_a);
+        const FaceTrack* tb = find(tracker, id_b);
+        if (ta == nullptr || tb == nullptr) {
+            printf("FAIL crossing N=%d frame %d: tracks %d/%d lost\n", interval, f, id_a, id_b);
+            return 1;
+        }
+        // while the faces overlap either could be nearer, check once they separate
+        if (fabsf(a.cx - b.cx) > 40.f &&
+            (fabsf(ta->cx.pos - a.cx) > fabsf(ta->cx.pos - b.cx) || fabsf(tb->cx.pos - b.cx) > fabsf(tb->cx.pos - a.cx))) {
+            printf("FAIL crossing N=%d frame %d: ids swapped, track %d at x=%.0f and %d at x=%.0f, faces at %.0f/%.0f\n",
+                   interval, f, id_a, ta->cx.pos, id_b, tb->cx.pos, a.cx, b.cx);
+            return 1;
+        }
+    }
+    printf("  crossing faces, detection every %d frame(s): tracks %d and %d kept\n", interval, id_a, id_b);
+    return 0;
+}
+
+int main() {
+    int failed = 0;
+    int total = 0;
+    static const int intervals[] = {1, 3, 5};
+    for (int n : intervals) {
+        failed += check_moving(n);
+        total++;
+    }
+
+    const int max_misses = FaceTrackerConfig().max_misses;
+    failed += check_reentry(max_misses, false);
+    failed += check_reentry(max_misses + 1, true);
+    total += 2;
+
+    static const int crossing_intervals[] = {1, 2};
+    for (int n : crossing_intervals) {
+        failed += check_crossing(n);
+        total++;
+    }
+
+    printf("tracker_check: %d/%d scenarios passed\n", total - failed, total);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Decode the binary result stream (docs/WIRE_FORMAT.md).
+
+Listens on the binary UDP port and prints each datagram as a JSON line with
+the same keys as the port 5002 output, or decodes hex given with --hex.
+
+    ./decode_wire.py                  # listen on 127.0.0.1:5004
+    ./decode_wire.py --port 5004 --raw
+    ./decode_wire.py --hex 4253010188...
+"""
+
+import argparse
+import json
+import socket
+import sys
+
+MAGIC = b"BS"
+VERSION = 1
+FLAG_TRANSCRIPT = 1 << 0
+FLAG_FINAL = 1 << 1
+FACE_ATTENDING = 1 << 0
+FACE_POSE = 1 << 1
+
+
+class WireError(ValueError):
+    pass
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        if self.pos >= len(self.data):
+            raise WireError("truncated at byte %d" % self.pos)
+        value = self.data[self.pos]
+        self.pos += 1
+        return value
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while True:
+            b = self.byte()
+            value |= (b & 0x7F) << shift
+            if b < 0x80:
+                return value
+            shift += 7
+            if shift >= 64:
+                raise WireError("varint longer than 10 bytes")
+
+    def zigzag(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+    def utf8(self):
+        length = self.varint()
+        end = self.pos + length
+        if end > len(self.data):
+            raise WireError("transcript runs past the datagram")
+        text = self.data[self.pos:end].decode("utf-8")
+        self.pos = end
+        return text
+
+
+def decode(data):
+    """Decode one datagram into a dict shaped like the JSON output."""
+    r = Reader(data)
+    if bytes([r.byte(), r.byte()]) != MAGIC:
+        raise WireError("bad magic")
+    version = r.byte()
+    if version != VERSION:
+        raise WireError("unsupported version %d" % version)
+    flags = r.byte()
+    timestamp_ms = r.varint()
+    total = r.zigzag()
+    attending = r.zigzag()
+    faces = []
+    for _ in range(r.varint()):
+        face = {"id": r.zigzag()}
+        face_flags = r.byte()
+        face["attending"] = bool(face_flags & FACE_ATTENDING)
+        if face_flags & FACE_POSE:
+            face["yaw"] = r.zigzag() / 10
+            face["pitch"] = r.zigzag() / 10
+            face["roll"] = r.zigzag() / 10
+        else:
+            face["yaw"] = face["pitch"] = face["roll"] = None
+        faces.append(face)
+    asr = r.utf8() if flags & FLAG_TRANSCRIPT else ""
+    # appended after the transcript; older senders leave it out
+    trace_id = r.varint() if r.pos < len(r.data) else 0
+    # version 1 readers ignore fields appended after the ones they know
+    return {
+        "ASR": asr,
+        "faces": faces,
+        "faces_attending": attending,
+        "faces_in_frame_total": total,
+        "is_final": bool(flags & FLAG_FINAL),
+        "timestamp": timestamp_ms // 1000,
+        "timestamp_ms": timestamp_ms,
+        "trace_id": trace_id,
+    }
+
+
+def show(data, raw):
+    if raw:
+        print(data.hex())
+    try:
+        print(json.dumps(decode(data), sort_keys=True, ensure_ascii=False))
+    except (WireError, UnicodeDecodeError) as e:
+        print("undecodable datagram (%d bytes): %s" % (len(data), e), file=sys.stderr)
+        return False
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--ip", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=5004)
+    parser.add_argument("--hex", help="decode one hex-encoded datagram and exit")
+    parser.add_argument("--raw", action="store_true", help="also print each datagram as hex")
+    args = parser.parse_args()
+
+    if args.hex:
+        return 0 if show(bytes.fromhex(args.hex), args.raw) else 1
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind((args.ip, args.port))
+    try:
+        while True:
+            data, _ = sock.recvfrom(65535)
+            show(data, args.raw)
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Follow a shared-memory sink (include/shm_state.h).
+
+Polls /dev/shm/<name> and prints every new message it sees, decoding the
+binary format (docs/WIRE_FORMAT.md) to JSON. Reads make no syscalls; messages
+written between two polls are reported as missed.
+
+    ./read_shm.py /attention
+    ./read_shm.py /attention --transcript     # only messages with a transcript
+"""
+
+import argparse
+import json
+import mmap
+import os
+import struct
+import sys
+import time
+
+from decode_wire import WireError, decode
+
+MAGIC = 0x4D485341
+VERSION = 1
+LATEST_OFFSET = 64
+TRANSCRIPT_OFFSET = 8320
+RECORD_HEADER = struct.Struct("<IIQ")     # seq, length, count
+
+
+def read_record(mem, offset, record_bytes):
+    """Seqlock read; None while the writer keeps the record busy or it is empty."""
+    for _ in range(100):
+        seq, length, count = RECORD_HEADER.unpack_from(mem, offset)
+        if seq & 1 or length > record_bytes:
+            continue
+        data = mem[offset + RECORD_HEADER.size:offset + RECORD_HEADER.size + length]
+        if RECORD_HEADER.unpack_from(mem, offset)[0] == seq:
+            return (count, data) if count else None
+    return None
+
+
+def show(data):
+    try:
+        return json.dumps(decode(data), sort_keys=True, ensure_ascii=False)
+    except (WireError, UnicodeDecodeError):
+        return data.decode("utf-8", "replace")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("name", help="segment name as given in the sink, e.g. /attention")
+    parser.add_argument("--transcript", action="store_true", help="follow the transcript record")
+    parser.add_argument("--interval", type=float, default=0.01, help="poll interval in seconds")
+    args = parser.parse_args()
+
+    path = "/dev/shm/" + args.name.lstrip("/")
+    with open(path, "rb") as f:
+        mem = mmap.mmap(f.fileno(), os.fstat(f.fileno()).st_size, prot=mmap.PROT_READ)
+    magic, version, record_bytes, _ = struct.unpack_from("<IIII", mem, 0)
+    if magic != MAGIC or version != VERSION:
+        print("%s is not a version %d state segment" % (path, VERSION), file=sys.stderr)
+        return 1
+
+    offset = TRANSCRIPT_OFFSET if args.transcript else LATEST_OFFSET
+    last = None
+    try:
+        while True:
+            record = read_record(mem, offset, record_bytes)
+            if record and record[0] != last:
+                if last is not None and record[0] > last + 1:
+                    print("(missed %d)" % (record[0] - last - 1), file=sys.stderr)
+                last = record[0]
+                print(show(record[1]))
+                sys.stdout.flush()
+            time.sleep(args.interval)
+    except KeyboardInterrupt:
+        return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""Subscribe to results on the subscription socket.
+
+Connects to the SOCK_SEQPACKET socket, sends "subscribe <format>
+[transcripts]" and prints every message received. Binary messages are
+decoded to JSON (docs/WIRE_FORMAT.md).
+
+    ./subscribe.py                              # json from /tmp/bsext-voice.sock
+    ./subscribe.py --format binary --transcripts
+"""
+
+import argparse
+import json
+import socket
+import sys
+
+from decode_wire import WireError, decode
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--socket", default="/tmp/bsext-voice.sock")
+    parser.add_argument("--format", default="json", choices=["json", "bsvar", "binary"])
+    parser.add_argument("--transcripts", action="store_true", help="only results with a transcript")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_SEQPACKET)
+    sock.connect(args.socket)
+    command = "subscribe " + args.format + (" transcripts" if args.transcripts else "")
+    sock.send(command.encode())
+    try:
+        while True:
+            data = sock.recv(65536)
+            if not data:
+                print("server closed the connection", file=sys.stderr)
+                return 1
+            if data.startswith(b"error:"):
+                print(data.decode(), file=sys.stderr)
+                return 1
+            if args.format == "binary":
+                try:
+                    print(json.dumps(decode(data), sort_keys=True, ensure_ascii=False))
+                except (WireError, UnicodeDecodeError) as e:
+                    print("undecodable message: %s" % e, file=sys.stderr)
+            else:
+                print(data.decode("utf-8", "replace"))
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
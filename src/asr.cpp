@@ -3,62 +3,69 @@
 #include <iostream>
 #include <algorithm>
 #include "audio_utils.h"
+#include "audio_source.h"
+#include "replay.h"
+#include "trace.h"
 #include <sndfile.h>
-#include <alsa/asoundlib.h>
 #include <fvad.h>
+#include <functional>
 #include <iomanip>
 
+ASRMetrics::ASRMetrics()
+    : wakeup(metrics().histogram("bsext_event_wakeup_seconds", "Event bus publish to ASR thread wakeup latency")),
+      mel(stageHistogram("mel")),
+      encoder(stageHistogram("encoder")),
+      decode_step(stageHistogram("decode_step")),
+      decoder(stageHistogram("decoder")),
+      partial_decoded(metrics().counter("bsext_partial_transcripts_total", "Partial transcripts by outcome",
+                                        "outcome=\"decoded\"")),
+      partial_published(metrics().counter("bsext_partial_transcripts_total", "Partial transcripts by outcome",
+                                          "outcome=\"published\"")),
+      partial_unchanged(metrics().counter("bsext_partial_transcripts_total", "Partial transcripts by outcome",
+                                          "outcome=\"unchanged\"")) {}
+
 ASRThread::ASRThread(
     const std::string& whisper_encoder_model,
     const std::string& whisper_decoder_model,
     const std::string& mel_filters_path,
     const std::string& vocabulary_path,
-    ThreadSafeQueue<InferenceResult>& jsonQueue,
-    ThreadSafeQueue<InferenceResult>& bsvarQueue,
+    ResultRing& results,
     std::atomic<bool>& isRunning,
-    std::atomic<bool>& triggerFlag,
-    std::mutex& gaze_mutex_,
-    std::condition_variable& gaze_cv_,
-    bool& trigger_asr_,
-    std::atomic<bool>& asr_busy_,
-    std::atomic<int>& current_faces_attending_,
-    std::atomic<int>& current_total_faces_,
-    std::string& alsa_device_,
+    EventBus& events,
+    std::unique_ptr<AudioSource> audio_source_,
     const int sample_rate,
     const int channels,
-    const int record_seconds)
-    : jsonResultQueue(jsonQueue),
-      bsvarResultQueue(bsvarQueue),
+    const int record_seconds,
+    const int partial_interval_ms,
+    ReplayClock* replay_clock)
+    : results(results),
       running(isRunning),
-      asr_trigger(triggerFlag),
-      gaze_mutex(gaze_mutex_),
-      gaze_cv(gaze_cv_),
-      trigger_asr(trigger_asr_),
-      asr_busy(asr_busy_),
-      current_faces_attending(current_faces_attending_),
-      current_total_faces(current_total_faces_),
-      alsa_device(alsa_device_),
+      events(events),
+      gaze_events(events.subscribe(eventMask(EventType::GazeStarted))),
       sample_rate(sample_rate),
       channels(channels),
       record_seconds(record_seconds),
+      audio_source(std::move(audio_source_)),
       task_code{TASK_CODE},
       mel_filters(N_MELS * MELS_FILTERS_SIZE),
-      rknn_app_ctx{},
-      vocab{}
+      whisper_ctx{},
+      vocab{},
+      partial_interval_ms(partial_interval_ms),
+      replay_clock(replay_clock)
 {
-    asr_trigger = true;
     std::cout << "ASRThread initialized with individual model files:" << std::endl;
     std::cout << "Whisper Encoder: " << whisper_encoder_model << std::endl;
     std::cout << "Whisper Decoder: " << whisper_decoder_model << std::endl;
     std::cout << "Mel Filters: " << mel_filters_path << std::endl;
     std::cout << "Vocabulary: " << vocabulary_path << std::endl;
+    std::cout << "Audio source: " << audio_source->getName() << std::endl;
     //Init whisper encode and decoder models.
-    int ret = init_whisper_model(whisper_encoder_model.c_str(), &rknn_app_ctx.encoder_context);
+    int ret = init_whisper_model(whisper_encoder_model.c_str(), &whisper_ctx.encoder_context);
     if (ret != 0)
     {
         std::cout << "init_whisper_model fail! ret=" << ret << std::endl;
     }
-    ret = init_whisper_model(whisper_decoder_model.c_str(), &rknn_app_ctx.decoder_context);
+    ret = init_whisper_model(whisper_decoder_model.c_str(), &whisper_ctx.decoder_context);
     if (ret != 0)
     {
         std::cout << "init_whisper_model fail! ret=" << ret << std::endl;
@@ -78,41 +85,83 @@ ASRThread::ASRThread(
 
 ASRThread::~ASRThread() {
     int ret;
-    ret = release_whisper_model(&rknn_app_ctx.encoder_context);
+    // the models must outlive a partial decode still running
+    if (partial.valid()) {
+        partial.wait();
+    }
+    ret = release_whisper_model(&whisper_ctx.encoder_context);
     if (ret != 0)
     {
         std::cout << "release_whisper_model encoder_context fail! ret=" << ret << std::endl;
     }
-    ret = release_whisper_model(&rknn_app_ctx.decoder_context);
+    ret = release_whisper_model(&whisper_ctx.decoder_context);
     if (ret != 0)
     {
         std::cout << "release_ppocr_model decoder_context fail! ret=" << ret << std::endl;
     }
     running = false;
-    jsonResultQueue.signalShutdown();
-    bsvarResultQueue.signalShutdown();
+    results.signalShutdown();
+}
+
+/**
+ * @brief Gain normalization and a simple noise gate to improve recognition
+ * @return the gain applied, 1 if none
+ */
+static float normalize_recording(std::vector<short>& recorded_samples) {
+    float applied = 1.0f;
+    if (recorded_samples.empty()) {
+        return applied;
+    }
+    // Find peak amplitude
+    short max_amplitude = 0;
+    for (const auto& sample : recorded_samples) {
+        max_amplitude = std::max(max_amplitude, static_cast<short>(std::abs(sample)));
+    }
+
+    // Normalize if peak is too low (but not if it's near clipping)
+    if (max_amplitude > 0 && max_amplitude < 8000) {
+        float gain = 10000.0f / max_amplitude;  // Increased target level
+        if (gain > 1.0f && gain < 6.0f) { // Allow higher gain for very quiet audio
+            for (auto& sample : recorded_samples) {
+                sample = static_cast<short>(std::round(sample * gain));
+            }
+            applied = gain;
+        }
+    }
+
+    // Simple noise gate to reduce background noise
+    short noise_threshold = max_amplitude * 0.05f; // 5% of peak as noise threshold
+    for (auto& sample : recorded_samples) {
+        if (std::abs(sample) < noise_threshold) {
+            sample = sample * 0.3f; // Reduce noise by 70%
+        }
+    }
+    return applied;
 }
 
 /**
  * @brief Records audio using Voice Activity Detection (VAD)
- * @param device ALSA audio device name for recording
+ * @param source audio source to record from, opened and closed here
  * @param wav_path Output path for the recorded WAV file
+ * @param on_speech optional, called with the samples so far after every frame recorded during speech
  * @return true if speech was detected and recorded, false otherwise
  * 
  * This function performs the following steps.
  * - Initializes VAD (Voice Activity Detection) with mode 1
- * - Opens ALSA audio device for capture
+ * - Opens the audio source for capture
  * - Records audio frames and processes them through VAD
  * - Stops recording after detecting speech end or timeout
  * - Saves the recorded audio as a WAV file
  * - Uses silence detection to determine speech boundaries
  */
-bool record_on_vad(const std::string& device, const std::string& wav_path) {
+bool record_on_vad(AudioSource& source, const std::string& wav_path,
+                   const std::function<void(const std::vector<short>&)>& on_speech = nullptr) {
     constexpr int VAD_MODE = 2;  // Moderate aggressiveness
     constexpr int MAX_SILENCE_FRAMES = 80; // Reduced to 80 (1.6 seconds) for more responsive stopping
     constexpr int MIN_SAMPLES = 4000; // 0.25 second minimum
     constexpr int MAX_TOTAL_FRAMES_MULTIPLIER = 4; // Allow longer recordings
     constexpr int MIN_SPEECH_FRAMES = 6; // Reduced to 6 frames (120ms) for better single word detection
+    static Histogram& vad_stage = stageHistogram("vad");
 
     std::unique_ptr<Fvad, decltype(&fvad_free)> vad{fvad_new(), fvad_free};
     if (!vad) {
@@ -126,31 +175,7 @@ bool record_on_vad(const std::string& device, const std::string& wav_path) {
         return false;
     }
 
-    snd_pcm_t* pcm_handle = nullptr;
-    snd_pcm_hw_params_t* hw_params = nullptr;
-    const auto cleanup_alsa = [&pcm_handle]() {
-        if (pcm_handle) {
-            snd_pcm_close(pcm_handle);
-            pcm_handle = nullptr;
-        }
-    };
-    snd_pcm_format_t format = SND_PCM_FORMAT_S16_LE;
-
-    if (const int err = snd_pcm_open(&pcm_handle, device.c_str(), SND_PCM_STREAM_CAPTURE, 0) < 0) {
-        std::cout << "Cannot open device " << device << ": " << snd_strerror(err) << std::endl;
-        return false;
-    }
-
-    snd_pcm_hw_params_alloca(&hw_params);
-    snd_pcm_hw_params_any(pcm_handle, hw_params);
-    snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
-    snd_pcm_hw_params_set_format(pcm_handle, hw_params, format);
-    snd_pcm_hw_params_set_rate(pcm_handle, hw_params, SAMPLE_RATE, 0);
-    snd_pcm_hw_params_set_channels(pcm_handle, hw_params, CHANNELS);
-
-    if (const int err = snd_pcm_hw_params(pcm_handle, hw_params) < 0) {
-        std::cout << "Cannot set HW params: " << snd_strerror(err) << std::endl;
-        cleanup_alsa();
+    if (!source.open()) {
         return false;
     }
 
@@ -161,6 +186,7 @@ bool record_on_vad(const std::string& device, const std::string& wav_path) {
     int speech_frames = 0;
     int silence_frames = 0;
     bool in_speech = false;
+    auto speech_start = std::chrono::steady_clock::now();
     int max_speech_frames = (SAMPLE_RATE * MAX_SPEECH_SECONDS) / FRAME_LEN;
     int consecutive_speech_frames = 0;
     int max_consecutive_speech_frames = 0;  // Track maximum consecutive speech
@@ -174,17 +200,13 @@ bool record_on_vad(const std::string& device, const std::string& wav_path) {
     int energy_frames = 0;
     
     while (speech_frames < max_speech_frames) {
-        int r = snd_pcm_readi(pcm_handle, frame.data(), FRAME_LEN);
-        if (r < 0) {
-            std::cout << "ALSA read error: " << snd_strerror(r) << std::endl;
+        if (!source.read(frame.data(), FRAME_LEN)) {
             break;
         }
-        if (r != FRAME_LEN) {
-            std::cout << "Short read from ALSA: " << r << "/" << FRAME_LEN << std::endl;
-            continue;
-        }
 
+        auto vad_start = std::chrono::steady_clock::now();
         int vad_result = fvad_process(vad.get(), frame.data(), FRAME_LEN);
+        vad_stage.recordSince(vad_start);
         if (vad_result < 0) {
             std::cout << "VAD error!\n";
             break;
@@ -206,6 +228,7 @@ bool record_on_vad(const std::string& device, const std::string& wav_path) {
             if (!in_speech){
                 std::cout << "Speech detected, starting recording.\n";
                 in_speech = true;
+                speech_start = std::chrono::steady_clock::now();
                 // Add pre-buffer content to recorded samples
                 recorded_samples.insert(recorded_samples.end(), pre_buffer.begin(), pre_buffer.end());
                 speech_frames += pre_buffer.size() / FRAME_LEN;
@@ -213,6 +236,9 @@ bool record_on_vad(const std::string& device, const std::string& wav_path) {
             recorded_samples.insert(recorded_samples.end(), frame.begin(), frame.end());
             speech_frames++;
             silence_frames = 0;
+            if (on_speech) {
+                on_speech(recorded_samples);
+            }
             
             if (consecutive_speech_frames >= MIN_SPEECH_FRAMES) {
                 if (!has_real_speech) {
@@ -231,6 +257,9 @@ bool record_on_vad(const std::string& device, const std::string& wav_path) {
                 if (silence_frames < allowed_silence) {
                     recorded_samples.insert(recorded_samples.end(), frame.begin(), frame.end());
                     speech_frames++;
+                    if (on_speech) {
+                        on_speech(recorded_samples);
+                    }
                 } else {
                     std::cout << "NSR:Silence after speech, stopping.\n";
                     break;
@@ -249,7 +278,11 @@ bool record_on_vad(const std::string& device, const std::string& wav_path) {
             break;
         }
     }
-    cleanup_alsa();
+    source.close();
+    if (in_speech) {
+        // VAD start to end of the recording
+        tracer().complete("speech", Tracer::current(), speech_start, std::chrono::steady_clock::now());
+    }
     
     // Audio quality diagnostics
     float avg_energy = energy_frames > 0 ? total_energy / energy_frames : 0.0f;
@@ -278,31 +311,9 @@ bool record_on_vad(const std::string& device, const std::string& wav_path) {
               << max_consecutive_speech_frames << " max consecutive speech frames\n";
 
     // Basic audio normalization to improve recognition
-    if (!recorded_samples.empty()) {
-        // Find peak amplitude
-        short max_amplitude = 0;
-        for (const auto& sample : recorded_samples) {
-            max_amplitude = std::max(max_amplitude, static_cast<short>(std::abs(sample)));
-        }
-        
-        // Normalize if peak is too low (but not if it's near clipping)
-        if (max_amplitude > 0 && max_amplitude < 8000) {
-            float gain = 10000.0f / max_amplitude;  // Increased target level
-            if (gain > 1.0f && gain < 6.0f) { // Allow higher gain for very quiet audio
-                std::cout << "Applying gain normalization: " << gain << "x\n";
-                for (auto& sample : recorded_samples) {
-                    sample = static_cast<short>(std::round(sample * gain));
-                }
-            }
-        }
-        
-        // Simple noise gate to reduce background noise
-        short noise_threshold = max_amplitude * 0.05f; // 5% of peak as noise threshold
-        for (auto& sample : recorded_samples) {
-            if (std::abs(sample) < noise_threshold) {
-                sample = sample * 0.3f; // Reduce noise by 70%
-            }
-        }
+    float gain = normalize_recording(recorded_samples);
+    if (gain != 1.0f) {
+        std::cout << "Applied gain normalization: " << gain << "x\n";
     }
 
     SF_INFO sfinfo{
@@ -329,6 +340,96 @@ bool record_on_vad(const std::string& device, const std::string& wav_path) {
     return written > 0;
 }
 
+std::string ASRThread::decodeSamples(std::vector<short> samples, uint64_t trace_id) {
+    // runs on a worker thread, which has no trace of its own
+    Tracer::setCurrent(trace_id);
+    TraceSpan span("partial_decode");
+    normalize_recording(samples);
+    // the same scaling libsndfile applies when the final recording is read back
+    std::vector<float> pcm(samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        pcm[i] = samples[i] / 32768.0f;
+    }
+    audio_buffer_t audio{pcm.data(), (int)pcm.size(), CHANNELS, SAMPLE_RATE};
+    std::vector<float> audio_data(N_MELS * MAX_AUDIO_LENGTH / HOP_LENGTH, 0.0f);
+    auto mel_start = std::chrono::steady_clock::now();
+    audio_preprocess(&audio, mel_filters.data(), audio_data);
+    auto infer_start = std::chrono::steady_clock::now();
+    std::vector<std::string> recognized_text;
+    int ret = inference_whisper_model(&whisper_ctx, audio_data, mel_filters.data(), vocab, task_code, recognized_text);
+    if (ret != 0) {
+        std::cout << "partial inference_whisper_model fail! ret=" << ret << std::endl;
+        return "";
+    }
+    recordWhisperPerf(mel_start, infer_start, std::chrono::steady_clock::now());
+    std::string text;
+    for (const auto& str : recognized_text) {
+        text += str;
+    }
+    return text;
+}
+
+void ASRThread::recordWhisperPerf(std::chrono::steady_clock::time_point mel_start,
+                                  std::chrono::steady_clock::time_point infer_start,
+                                  std::chrono::steady_clock::time_point infer_end) {
+    const whisper_perf_t& perf = whisper_ctx.perf;
+    asr_metrics.mel.record(std::chrono::duration_cast<std::chrono::nanoseconds>(infer_start - mel_start).count());
+    // the encoder runs first and the decoder last inside inference_whisper_model()
+    auto encoder_end = infer_start + std::chrono::microseconds((int64_t)(perf.encoder_ms * 1000));
+    auto decoder_start = infer_end - std::chrono::microseconds((int64_t)(perf.decoder_ms * 1000));
+    tracer().complete("mel", Tracer::current(), mel_start, infer_start);
+    tracer().complete("encode", Tracer::current(), infer_start, encoder_end);
+    tracer().complete("decode", Tracer::current(), decoder_start, infer_end);
+    asr_metrics.encoder.recordMs(perf.encoder_ms);
+    asr_metrics.decoder.recordMs(perf.decoder_ms);
+    for (int i = 0; i < perf.decode_steps; ++i) {
+        asr_metrics.decode_step.recordMs(perf.decode_step_ms[i]);
+    }
+}
+
+void ASRThread::collectPartial(bool discard) {
+    if (!partial.valid()) {
+        return;
+    }
+    if (discard) {
+        // the final decode supersedes it, but must not share the NPU contexts with it
+        partial.wait();
+        partial.get();
+        return;
+    }
+    if (partial.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    std::string text;
+    if (!stabilizer.update(partial.get(), text)) {
+        return;
+    }
+    std::cout << "Partial transcript: " << text << std::endl;
+    InferenceResult result;
+    result.num_faces_attending = session_faces.attending;
+    result.count_all_faces_in_frame = session_faces.total;
+    result.faces = session_faces.toVector();
+    result.timestamp = std::chrono::system_clock::now();
+    result.asr = std::move(text);
+    result.trace_id = Tracer::current();
+    tracer().instant("partial_published", result.trace_id);
+    results.publish(std::move(result));
+}
+
+void ASRThread::onSpeech(const std::vector<short>& recorded) {
+    if (replay_clock && partial.valid()) {
+        // a replay publishes the same partials whatever the decode speed
+        partial.wait();
+    }
+    collectPartial(false);
+    size_t interval = (size_t)SAMPLE_RATE * partial_interval_ms / 1000;
+    if (partial.valid() || recorded.size() < partial_samples + interval) {
+        return;
+    }
+    partial_samples = recorded.size();
+    partial = std::async(std::launch::async, &ASRThread::decodeSamples, this, recorded, Tracer::current());
+}
+
 InferenceResult ASRThread::runASR() {
     InferenceResult result;
     int ret;
@@ -353,13 +454,32 @@ InferenceResult ASRThread::runASR() {
     float infer_time = 0.0;
     float audio_length = 0.0;
     float rtf = 0.0;
-    bool vad_detected = record_on_vad(alsa_device, "/tmp/capture.wav");
+    stabilizer.reset();
+    partial_samples = 0;
+    std::function<void(const std::vector<short>&)> on_speech;
+    if (partial_interval_ms > 0) {
+        on_speech = [this](const std::vector<short>& recorded) { onSpeech(recorded); };
+    }
+    auto listen_start = std::chrono::steady_clock::now();
+    bool vad_detected = record_on_vad(*audio_source, "/tmp/capture.wav", on_speech);
+    tracer().complete("listen", Tracer::current(), listen_start, std::chrono::steady_clock::now());
+    collectPartial(true);
+    const PartialTranscriptStats& partial_stats = stabilizer.getStats();
+    asr_metrics.partial_decoded.add(partial_stats.decoded);
+    asr_metrics.partial_published.add(partial_stats.published);
+    asr_metrics.partial_unchanged.add(partial_stats.unchanged);
+    if (partial_stats.decoded > 0) {
+        std::cout << "Partial transcripts: decoded=" << partial_stats.decoded << " published=" << partial_stats.published
+                  << " unchanged=" << partial_stats.unchanged << " stable_words=" << partial_stats.stable_words
+                  << std::endl;
+    }
     if(!vad_detected)
     {
         result.asr ="";
         return result;
     }
 
+    auto load_start = std::chrono::steady_clock::now();
     ret = read_audio("/tmp/capture.wav", &audio);
     if (ret != 0)
     {
@@ -388,9 +508,12 @@ InferenceResult ASRThread::runASR() {
             return result;
         }
     }
+    tracer().complete("load_audio", Tracer::current(), load_start, std::chrono::steady_clock::now());
     timer.tik();
+    auto mel_start = std::chrono::steady_clock::now();
     audio_preprocess(&audio, mel_filters.data(), audio_data);
-    ret = inference_whisper_model(&rknn_app_ctx, audio_data, mel_filters.data(), vocab, task_code, recognized_text);
+    auto infer_start = std::chrono::steady_clock::now();
+    ret = inference_whisper_model(&whisper_ctx, audio_data, mel_filters.data(), vocab, task_code, recognized_text);
     if (ret != 0)
     {
         std::cout << "inference_whisper_model fail! ret=" << ret << std::endl;
@@ -398,6 +521,7 @@ InferenceResult ASRThread::runASR() {
         return result;
     }
     timer.tok();
+    recordWhisperPerf(mel_start, infer_start, std::chrono::steady_clock::now());
     // print result
     std::cout << "\nWhisper output: ";
     for (const auto &str : recognized_text)
@@ -417,41 +541,69 @@ InferenceResult ASRThread::runASR() {
 }
 
 void ASRThread::operator()() {
-    while (running.load()) {
-	    std::unique_lock<std::mutex> lock(gaze_mutex);
-        gaze_cv.wait(lock, [&]{ return trigger_asr || !running.load(); });
-        // Clean exit on shutdown
-        if (!running.load()) {
-            break;  
+    tracer().setThreadName("asr");
+    Event event;
+    while (running.load() && gaze_events.waitPop(event)) {
+        if (event.type != EventType::GazeStarted) {
+            continue;
         }
-        //Gaze detected send "Listening..." prompt
-        // Get current values at the time of processing
-        const int faces_attending = current_faces_attending.load();
-        const int total_faces = current_total_faces.load();
+        const MailboxStats& stats = gaze_events.getStats();
+        double wakeup_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - event.time).count();
+        asr_metrics.wakeup.record((uint64_t)(wakeup_us * 1000));
+        // spans recorded on this thread until the session ends belong to the trigger's interaction
+        Tracer::setCurrent(event.trace_id);
+        auto session_start = std::chrono::steady_clock::now();
+        tracer().complete("event_wakeup", event.trace_id, event.time, session_start);
+        std::cout << "GazeStarted by track " << event.track_id << ", wakeup " << wakeup_us << " us (avg "
+                  << stats.latency_sum_us / stats.events << " max " << stats.latency_max_us << " dropped "
+                  << stats.dropped << ")" << std::endl;
+
+        //Gaze detected send "Listening..." prompt with the faces at trigger time
+        const FaceSnapshot faces = event.faces;
+        session_faces = faces;
+        Event listening_event{EventType::ListeningStarted};
+        listening_event.faces = faces;
+        listening_event.trace_id = event.trace_id;
+        events.publish(listening_event);
 
         InferenceResult listening;
-        listening.num_faces_attending = faces_attending;
-        listening.count_all_faces_in_frame = total_faces;
+        listening.num_faces_attending = faces.attending;
+        listening.count_all_faces_in_frame = faces.total;
+        listening.faces = faces.toVector();
         listening.timestamp = std::chrono::system_clock::now();
         listening.asr = "Listening...";
-        jsonResultQueue.push(InferenceResult{listening});
-        bsvarResultQueue.push(std::move(listening));
+        listening.trace_id = event.trace_id;
+        tracer().instant("listening_published", event.trace_id);
+        results.publish(std::move(listening));
 
         InferenceResult result = runASR();
-	    if(result.asr.empty())
+        const bool empty = result.asr.empty();
+        result.is_final = true;
+	    if(!stabilizer.publishFinal(result.asr))
         {
             std::cout<<"ASR is empty"<<std::endl;
         }
         else
         {
+            // an empty final still ends the session for consumers that showed partials
             // Fix update count_all_faces_in_frame from inference thread.
-            result.num_faces_attending = faces_attending;
-            result.count_all_faces_in_frame = total_faces;
+            result.num_faces_attending = faces.attending;
+            result.count_all_faces_in_frame = faces.total;
+            result.faces = faces.toVector();
             result.timestamp = std::chrono::system_clock::now();
-            jsonResultQueue.push(InferenceResult{result});
-            bsvarResultQueue.push(std::move(result));
+            result.trace_id = event.trace_id;
+            tracer().instant("final_published", event.trace_id);
+            results.publish(std::move(result));
+        }
+        Event done{EventType::TranscriptReady};
+        done.transcript_empty = empty;
+        done.faces = faces;
+        done.trace_id = event.trace_id;
+        events.publish(done);
+        if (replay_clock) {
+            replay_clock->sessionEnded();
         }
-        trigger_asr = false;
-	    asr_busy.store(false);
+        tracer().complete("session", event.trace_id, session_start, std::chrono::steady_clock::now());
+        Tracer::setCurrent(0);
     }
 }
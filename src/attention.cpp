@@ -1,39 +1,174 @@
 #include "attention.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
+/***
+ * Head pose from 5 landmarks with a scaled orthographic (POS) fit against a
+ * generic 3D face template:
+ *
+ *   [x y]_i ~ s * R[0..1] * X_i + t
+ *
+ * After centring both point sets, the two projected rows of s*R are the
+ * least-squares solution r = pinv(X) * x, where pinv(X) depends only on the
+ * template and is computed once. The rows are orthonormalised and the third
+ * row is their cross product, then converted to yaw/pitch/roll.
+ *
+ * Faces are processed in blocks of POSE_BLOCK with the face index innermost,
+ * so the per-point loops vectorize across faces.
+ ***/
 
-bool face_is_looking_at_us(retinaface_object_t face) {
-    auto left_eye = face.ponit[0];
-    auto right_eye = face.ponit[1];
-    auto interocular_dist_pix = sqrt(pow(left_eye.x - right_eye.x, 2) + pow(left_eye.y - right_eye.y, 2));
-
-    auto face_width = face.box.right - face.box.left;
-    auto face_height = face.box.bottom - face.box.top;
-    float face_aspect_ratio = ((float) face_height)/((float) face_width);
-
-    float interocular_face_ratio = interocular_dist_pix / face_width;
-    /***
-     * face_aspect_ratio should be approximately the golden ratio ~ 1.618
-     * interocular_face_ratio should be approximately 0.5
-     * 
-     * If face_aspect_ratio is < 1.5 or > 1.72, the face is not looking at the camera
-     * if interocular_face_ratio is < 0.4 or > 0.6, the face is not looking at the camera
-
-    CF: https://pmc.ncbi.nlm.nih.gov/articles/PMC2814183/
-    and https://www.researchgate.net/publication/341711316_Autoencoder-based_image_processing_framework_for_object_appearance_modifications
-    ***/
-//    std::cout << "face_aspect_ratio: " << face_aspect_ratio << "  "
-//      << "interocular_face_ratio: " << interocular_face_ratio << std::endl;
-
-   auto is_looking = face_aspect_ratio > 1.2 && face_aspect_ratio < 2.0
-        && interocular_face_ratio > 0.3 && interocular_face_ratio < 0.7;
-    // if (is_looking) {
-    //     std::cout << "Face is looking at us" << std::endl;
-    // } else {
-    //     std::cout << "Face is not looking at us" << std::endl;
-    // }
-   
-    return is_looking;
-}
\ No newline at end of file
+namespace {
+
+constexpr int POSE_BLOCK = 8;
+constexpr float RAD_TO_DEG = 57.29577951308232f;
+
+// mean face in mm: x right, y down, z away from the camera
+constexpr float FACE_TEMPLATE[5][3] = {
+    {-31.0f, -32.0f, 0.0f},     // left eye
+    {31.0f, -32.0f, 0.0f},      // right eye
+    {0.0f, 0.0f, -30.0f},       // nose tip
+    {-25.0f, 32.0f, -5.0f},     // left mouth corner
+    {25.0f, 32.0f, -5.0f},      // right mouth corner
+};
+
+struct TemplatePinv {
+    float m[3][5];
+
+    TemplatePinv() {
+        float c[5][3];
+        float mean[3] = {0, 0, 0};
+        for (int i = 0; i < 5; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                mean[k] += FACE_TEMPLATE[i][k] / 5;
+            }
+        }
+        for (int i = 0; i < 5; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                c[i][k] = FACE_TEMPLATE[i][k] - mean[k];
+            }
+        }
+        // A = X^T X (3x3), inverted by cofactors
+        float a[3][3] = {};
+        for (int r = 0; r < 3; ++r) {
+            for (int k = 0; k < 3; ++k) {
+                for (int i = 0; i < 5; ++i) {
+                    a[r][k] += c[i][r] * c[i][k];
+                }
+            }
+        }
+        float det = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+                  - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+                  + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+        float inv[3][3];
+        inv[0][0] = (a[1][1] * a[2][2] - a[1][2] * a[2][1]) / det;
+        inv[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) / det;
+        inv[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) / det;
+        inv[1][0] = (a[1][2] * a[2][0] - a[1][0] * a[2][2]) / det;
+        inv[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) / det;
+        inv[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) / det;
+        inv[2][0] = (a[1][0] * a[2][1] - a[1][1] * a[2][0]) / det;
+        inv[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) / det;
+        inv[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) / det;
+        for (int r = 0; r < 3; ++r) {
+            for (int i = 0; i < 5; ++i) {
+                m[r][i] = inv[r][0] * c[i][0] + inv[r][1] * c[i][1] + inv[r][2] * c[i][2];
+            }
+        }
+    }
+};
+
+const TemplatePinv& template_pinv() {
+    static const TemplatePinv pinv;
+    return pinv;
+}
+
+}  // namespace
+
+void estimate_head_poses(const float* landmarks, int n, HeadPose* poses) {
+    const auto& pinv = template_pinv().m;
+    for (int base = 0; base < n; base += POSE_BLOCK) {
+        int lanes = std::min(POSE_BLOCK, n - base);
+        float x[5][POSE_BLOCK];
+        float y[5][POSE_BLOCK];
+        float r1[3][POSE_BLOCK];
+        float r2[3][POSE_BLOCK];
+        float r3[3][POSE_BLOCK];
+
+        for (int i = 0; i < 5; ++i) {
+            for (int l = 0; l < POSE_BLOCK; ++l) {
+                int f = base + (l < lanes ? l : 0);
+                x[i][l] = landmarks[f * 10 + i * 2];
+                y[i][l] = landmarks[f * 10 + i * 2 + 1];
+            }
+        }
+        // centre the image points; pinv rows sum to zero, so this only
+        // matters for precision
+        for (int l = 0; l < POSE_BLOCK; ++l) {
+            float mx = (x[0][l] + x[1][l] + x[2][l] + x[3][l] + x[4][l]) * 0.2f;
+            float my = (y[0][l] + y[1][l] + y[2][l] + y[3][l] + y[4][l]) * 0.2f;
+            for (int i = 0; i < 5; ++i) {
+                x[i][l] -= mx;
+                y[i][l] -= my;
+            }
+        }
+        for (int k = 0; k < 3; ++k) {
+            for (int l = 0; l < POSE_BLOCK; ++l) {
+                float a = 0;
+                float b = 0;
+                for (int i = 0; i < 5; ++i) {
+                    a += pinv[k][i] * x[i][l];
+                    b += pinv[k][i] * y[i][l];
+                }
+                r1[k][l] = a;
+                r2[k][l] = b;
+            }
+        }
+        // orthonormalise symmetrically: split the error between both rows
+        for (int l = 0; l < POSE_BLOCK; ++l) {
+            float n1 = 1.f / std::max(std::sqrt(r1[0][l] * r1[0][l] + r1[1][l] * r1[1][l] + r1[2][l] * r1[2][l]), 1e-6f);
+            float n2 = 1.f / std::max(std::sqrt(r2[0][l] * r2[0][l] + r2[1][l] * r2[1][l] + r2[2][l] * r2[2][l]), 1e-6f);
+            float s[3];
+            float d[3];
+            for (int k = 0; k < 3; ++k) {
+                s[k] = r1[k][l] * n1 + r2[k][l] * n2;
+                d[k] = r1[k][l] * n1 - r2[k][l] * n2;
+            }
+            float ns = 1.f / std::max(std::sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]), 1e-6f);
+            float nd = 1.f / std::max(std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]), 1e-6f);
+            for (int k = 0; k < 3; ++k) {
+                s[k] *= ns * 0.70710678f;
+                d[k] *= nd * 0.70710678f;
+                r1[k][l] = s[k] + d[k];
+                r2[k][l] = s[k] - d[k];
+            }
+            r3[0][l] = r1[1][l] * r2[2][l] - r1[2][l] * r2[1][l];
+            r3[1][l] = r1[2][l] * r2[0][l] - r1[0][l] * r2[2][l];
+            r3[2][l] = r1[0][l] * r2[1][l] - r1[1][l] * r2[0][l];
+        }
+        // R = Rz(roll) * Ry(yaw) * Rx(pitch), rows r1, r2, r3
+        for (int l = 0; l < lanes; ++l) {
+            float sy = std::clamp(-r3[0][l], -1.f, 1.f);
+            poses[base + l].yaw = std::asin(sy) * RAD_TO_DEG;
+            poses[base + l].pitch = std::atan2(r3[1][l], r3[2][l]) * RAD_TO_DEG;
+            poses[base + l].roll = std::atan2(r2[0][l], r1[0][l]) * RAD_TO_DEG;
+        }
+    }
+}
+
+bool pose_in_cone(const HeadPose& pose, const AttentionCone& cone) {
+    return std::fabs(pose.yaw) <= cone.max_yaw_deg
+        && std::fabs(pose.pitch - cone.pitch_offset_deg) <= cone.max_pitch_deg;
+}
+
+bool face_is_looking_at_us(const retinaface_object_t& face, const AttentionCone& cone) {
+    float landmarks[10];
+    for (int j = 0; j < 5; ++j) {
+        landmarks[j * 2] = face.ponit[j].x;
+        landmarks[j * 2 + 1] = face.ponit[j].y;
+    }
+    HeadPose pose;
+    estimate_head_poses(landmarks, 1, &pose);
+    return pose_in_cone(pose, cone);
+}
@@ -0,0 +1,116 @@
+#include "attention_gate.h"
+
+#include <algorithm>
+
+AttentionGate::AttentionGate(const AttentionGateConfig& config) : config(config) {}
+
+// Attention stopped for good; a glance that never reached the dwell time is
+// a run the old rule would have started
+void AttentionGate::endEpisode(TrackState& ts) {
+    if (state == GateState::Idle && !ts.triggered && ts.attend_s > 0 && ts.attend_s < config.dwell_s) {
+        stats.avoided_glance++;
+    }
+    ts.attend_s = 0;
+    ts.triggered = false;
+    ts.cooldown_counted = false;
+}
+
+int AttentionGate::update(const std::vector<FaceTrack>& tracks, const FaceTrackerConfig& tracker_config, double dt) {
+    if (state == GateState::Cooldown) {
+        cooldown_left -= dt;
+        if (cooldown_left <= 0) {
+            state = GateState::Idle;
+        }
+    }
+
+    for (auto& ts : states) {
+        ts.seen = false;
+    }
+    for (const auto& track : tracks) {
+        if (!track.visible(tracker_config)) {
+            continue;
+        }
+        auto it = std::find_if(states.begin(), states.end(), [&](const TrackState& ts) { return ts.id == track.id; });
+        if (it == states.end()) {
+            states.push_back({track.id, 0, 0, false, false, false});
+            it = states.end() - 1;
+        }
+        TrackState& ts = *it;
+        ts.seen = true;
+        if (track.attending) {
+            ts.attend_s += dt;
+            ts.away_s = 0;
+        } else if (ts.attend_s > 0 || ts.triggered) {
+            ts.away_s += dt;
+            if (ts.away_s >= config.release_s) {
+                endEpisode(ts);
+            }
+        }
+    }
+    // tracks that left the frame or went unreliable end their episode
+    for (auto& ts : states) {
+        if (!ts.seen) {
+            endEpisode(ts);
+        }
+    }
+    states.erase(std::remove_if(states.begin(), states.end(), [](const TrackState& ts) { return !ts.seen; }),
+                 states.end());
+
+    TrackState* best = nullptr;
+    for (auto& ts : states) {
+        if (ts.triggered || ts.attend_s < config.dwell_s) {
+            continue;
+        }
+        if (state == GateState::Cooldown) {
+            if (!ts.cooldown_counted) {
+                stats.avoided_cooldown++;
+                ts.cooldown_counted = true;
+            }
+            continue;
+        }
+        if (!best || ts.attend_s > best->attend_s) {
+            best = &ts;
+        }
+    }
+    if (!best || state != GateState::Idle) {
+        return -1;
+    }
+
+    // everyone who has dwelled is heard by this session
+    for (auto& ts : states) {
+        if (ts.attend_s >= config.dwell_s) {
+            ts.triggered = true;
+        }
+    }
+    state = GateState::Listening;
+    stats.triggers++;
+    return best->id;
+}
+
+double AttentionGate::getAttendSeconds(int track_id) const {
+    for (const auto& ts : states) {
+        if (ts.id == track_id) {
+            return ts.attend_s;
+        }
+    }
+    return 0;
+}
+
+void AttentionGate::asrFinished(bool empty) {
+    if (state != GateState::Listening) {
+        return;
+    }
+    // triggered tracks still looking would have restarted ASR right away
+    for (const auto& ts : states) {
+        if (ts.triggered && ts.away_s == 0) {
+            stats.avoided_repeat++;
+        }
+    }
+    if (empty) {
+        stats.empty_transcripts++;
+        state = GateState::Cooldown;
+        cooldown_left = config.cooldown_s;
+    } else {
+        state = GateState::Idle;
+    }
+}
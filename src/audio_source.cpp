@@ -0,0 +1,58 @@
+#include "audio_source.h"
+
+#include <iostream>
+
+#include "asr.h"
+
+AlsaAudioSource::AlsaAudioSource(const std::string& device) : device(device) {}
+
+AlsaAudioSource::~AlsaAudioSource() {
+    close();
+}
+
+bool AlsaAudioSource::open() {
+    snd_pcm_hw_params_t* hw_params = nullptr;
+    int err = snd_pcm_open(&pcm_handle, device.c_str(), SND_PCM_STREAM_CAPTURE, 0);
+    if (err < 0) {
+        std::cout << "Cannot open device " << device << ": " << snd_strerror(err) << std::endl;
+        pcm_handle = nullptr;
+        return false;
+    }
+
+    snd_pcm_hw_params_alloca(&hw_params);
+    snd_pcm_hw_params_any(pcm_handle, hw_params);
+    snd_pcm_hw_params_set_access(pcm_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
+    snd_pcm_hw_params_set_format(pcm_handle, hw_params, SND_PCM_FORMAT_S16_LE);
+    snd_pcm_hw_params_set_rate(pcm_handle, hw_params, SAMPLE_RATE, 0);
+    snd_pcm_hw_params_set_channels(pcm_handle, hw_params, CHANNELS);
+
+    err = snd_pcm_hw_params(pcm_handle, hw_params);
+    if (err < 0) {
+        std::cout << "Cannot set HW params: " << snd_strerror(err) << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool AlsaAudioSource::read(short* frame, int len) {
+    while (true) {
+        int r = snd_pcm_readi(pcm_handle, frame, len);
+        if (r < 0) {
+            std::cout << "ALSA read error: " << snd_strerror(r) << std::endl;
+            return false;
+        }
+        if (r == len) {
+            return true;
+        }
+        // the partial frame is dropped, as before VAD ever sees it
+        std::cout << "Short read from ALSA: " << r << "/" << len << std::endl;
+    }
+}
+
+void AlsaAudioSource::close() {
+    if (pcm_handle) {
+        snd_pcm_close(pcm_handle);
+        pcm_handle = nullptr;
+    }
+}
@@ -0,0 +1,117 @@
+#include "event_bus.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "inference_result.h"
+
+void FaceSnapshot::assign(const InferenceResult& result) {
+    total = result.count_all_faces_in_frame;
+    attending = result.num_faces_attending;
+    count = std::min((int)result.faces.size(), EVENT_MAX_FACES);
+    std::copy(result.faces.begin(), result.faces.begin() + count, faces);
+}
+
+std::vector<FacePose> FaceSnapshot::toVector() const {
+    return std::vector<FacePose>(faces, faces + count);
+}
+
+EventMailbox::EventMailbox(uint32_t mask, size_t capacity)
+    : mask(mask), capacity(capacity), slots(new Slot[capacity]) {
+    for (size_t i = 0; i < capacity; ++i) {
+        slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool EventMailbox::post(const Event& event) {
+    uint64_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = slots[pos % capacity];
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.event = event;
+                slot.seq.store(pos + 1, std::memory_order_release);
+                break;
+            }
+        } else if (diff < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+    posted.fetch_add(1, std::memory_order_release);
+    posted.notify_one();
+    return true;
+}
+
+bool EventMailbox::tryPop(Event& event) {
+    uint64_t pos = tail.load(std::memory_order_relaxed);
+    Slot& slot = slots[pos % capacity];
+    if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+        return false;
+    }
+    event = slot.event;
+    slot.seq.store(pos + capacity, std::memory_order_release);
+    tail.store(pos + 1, std::memory_order_relaxed);
+    record(event);
+    return true;
+}
+
+bool EventMailbox::waitPop(Event& event) {
+    for (;;) {
+        uint32_t seen = posted.load(std::memory_order_acquire);
+        if (tryPop(event)) {
+            return true;
+        }
+        if (closed.load(std::memory_order_acquire)) {
+            return false;
+        }
+        posted.wait(seen, std::memory_order_acquire);
+    }
+}
+
+void EventMailbox::close() {
+    closed.store(true, std::memory_order_release);
+    posted.fetch_add(1, std::memory_order_release);
+    posted.notify_all();
+}
+
+void EventMailbox::record(const Event& event) {
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - event.time).count();
+    stats.events++;
+    stats.latency_sum_us += us;
+    stats.latency_max_us = std::max(stats.latency_max_us, us);
+}
+
+const MailboxStats& EventMailbox::getStats() {
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+EventMailbox& EventBus::subscribe(uint32_t mask, size_t capacity) {
+    if (mailbox_count == EVENT_BUS_MAX_MAILBOXES) {
+        throw std::runtime_error("EventBus: all " + std::to_string(EVENT_BUS_MAX_MAILBOXES) +
+                                 " mailboxes are subscribed");
+    }
+    mailboxes[mailbox_count] = std::make_unique<EventMailbox>(mask, capacity);
+    return *mailboxes[mailbox_count++];
+}
+
+void EventBus::publish(Event event) {
+    event.time = std::chrono::steady_clock::now();
+    for (int i = 0; i < mailbox_count; ++i) {
+        if (mailboxes[i]->accepts(event.type)) {
+            mailboxes[i]->post(event);
+        }
+    }
+}
+
+void EventBus::shutdown() {
+    for (int i = 0; i < mailbox_count; ++i) {
+        mailboxes[i]->close();
+    }
+}
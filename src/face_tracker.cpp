@@ -0,0 +1,215 @@
+#include "face_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+
+void Kalman1D::init(float z, float r) {
+    pos = z;
+    vel = 0;
+    p00 = r;
+    p01 = 0;
+    // velocity is unknown until the second measurement
+    p11 = r * 100;
+}
+
+void Kalman1D::predict(float dt, float q) {
+    pos += vel * dt;
+    float dt2 = dt * dt;
+    p00 += 2 * dt * p01 + dt2 * p11 + q * dt2 * dt / 3;
+    p01 += dt * p11 + q * dt2 / 2;
+    p11 += q * dt;
+}
+
+void Kalman1D::update(float z, float r) {
+    float y = z - pos;
+    float s = p00 + r;
+    float k0 = p00 / s;
+    float k1 = p01 / s;
+    pos += k0 * y;
+    vel += k1 * y;
+    p11 -= k1 * p01;
+    p01 *= 1 - k0;
+    p00 *= 1 - k0;
+}
+
+static float box_iou(const box_rect_t& a, const box_rect_t& b) {
+    float w = std::min(a.right, b.right) - std::max(a.left, b.left) + 1;
+    float h = std::min(a.bottom, b.bottom) - std::max(a.top, b.top) + 1;
+    if (w <= 0 || h <= 0) {
+        return 0.f;
+    }
+    float i = w * h;
+    float u = (a.right - a.left + 1) * (a.bottom - a.top + 1) + (b.right - b.left + 1) * (b.bottom - b.top + 1) - i;
+    return u <= 0.f ? 0.f : i / u;
+}
+
+FaceTracker::FaceTracker(const FaceTrackerConfig& config) : config(config) {}
+
+void FaceTracker::advance(double dt) {
+    for (auto& track : tracks) {
+        float size = std::max(track.h.pos, 1.f);
+        float q = config.process_noise * size;
+        q *= q;
+        track.cx.predict(dt, q);
+        track.cy.predict(dt, q);
+        track.w.predict(dt, q);
+        track.h.predict(dt, q);
+        refreshFace(track);
+    }
+}
+
+// Rebuild the integer face from the filter state and the landmark offsets
+void FaceTracker::refreshFace(FaceTrack& track) {
+    float cx = track.cx.pos;
+    float cy = track.cy.pos;
+    float half_w = std::max(track.w.pos, 1.f) * 0.5f;
+    float half_h = std::max(track.h.pos, 1.f) * 0.5f;
+    track.face.box.left = (int)lroundf(cx - half_w);
+    track.face.box.right = (int)lroundf(cx + half_w);
+    track.face.box.top = (int)lroundf(cy - half_h);
+    track.face.box.bottom = (int)lroundf(cy + half_h);
+    for (int j = 0; j < 5; ++j) {
+        track.face.ponit[j].x = (int)lroundf(cx + track.landmark_dx[j]);
+        track.face.ponit[j].y = (int)lroundf(cy + track.landmark_dy[j]);
+    }
+}
+
+void FaceTracker::accumulate(double dt) {
+    for (auto& track : tracks) {
+        track.dwell_s += dt;
+        if (track.attending && track.visible(config)) {
+            track.attention_s += dt;
+        }
+    }
+}
+
+// Pose of every track matched or created this round, from the raw detection
+// landmarks in one batch; coasting tracks keep their last pose.
+void FaceTracker::estimatePoses(const retinaface_result& detections) {
+    pose_pending.clear();
+    pose_landmarks.clear();
+    for (int d = 0; d < detections.count; ++d) {
+        const retinaface_object_t& det = detections.object[d];
+        pose_pending.push_back(det_match[d]);
+        for (int j = 0; j < 5; ++j) {
+            pose_landmarks.push_back((float)det.ponit[j].x);
+            pose_landmarks.push_back((float)det.ponit[j].y);
+        }
+    }
+    pose_out.resize(pose_pending.size());
+    estimate_head_poses(pose_landmarks.data(), (int)pose_pending.size(), pose_out.data());
+    for (size_t i = 0; i < pose_pending.size(); ++i) {
+        FaceTrack& track = tracks[pose_pending[i]];
+        track.pose = pose_out[i];
+        track.attending = pose_in_cone(track.pose, config.cone);
+    }
+}
+
+void FaceTracker::predict(double dt) {
+    advance(dt);
+    accumulate(dt);
+}
+
+void FaceTracker::update(const retinaface_result& detections, double dt) {
+    advance(dt);
+
+    // greedy association on IoU, best pairs first; face counts are small
+    // enough that this is as good as Hungarian in practice
+    int n_tracks = (int)tracks.size();
+    int n_dets = detections.count;
+    track_match.assign(n_tracks, -1);
+    det_match.assign(n_dets, -1);
+    std::vector<std::pair<float, std::pair<int, int>>> pairs;
+    for (int t = 0; t < n_tracks; ++t) {
+        for (int d = 0; d < n_dets; ++d) {
+            float iou = box_iou(tracks[t].face.box, detections.object[d].box);
+            if (iou >= config.iou_threshold) {
+                pairs.push_back({iou, {t, d}});
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (const auto& p : pairs) {
+        int t = p.second.first;
+        int d = p.second.second;
+        if (track_match[t] != -1 || det_match[d] != -1) {
+            continue;
+        }
+        track_match[t] = d;
+        det_match[d] = t;
+    }
+
+    for (int t = 0; t < n_tracks; ++t) {
+        FaceTrack& track = tracks[t];
+        if (track_match[t] == -1) {
+            track.misses++;
+            continue;
+        }
+        const retinaface_object_t& det = detections.object[track_match[t]];
+        float det_w = det.box.right - det.box.left;
+        float det_h = det.box.bottom - det.box.top;
+        float det_cx = (det.box.left + det.box.right) * 0.5f;
+        float det_cy = (det.box.top + det.box.bottom) * 0.5f;
+        float r = config.measurement_noise * std::max(det_h, 1.f);
+        r *= r;
+        track.cx.update(det_cx, r);
+        track.cy.update(det_cy, r);
+        track.w.update(det_w, r);
+        track.h.update(det_h, r);
+        for (int j = 0; j < 5; ++j) {
+            float a = config.landmark_alpha;
+            track.landmark_dx[j] = a * (det.ponit[j].x - det_cx) + (1 - a) * track.landmark_dx[j];
+            track.landmark_dy[j] = a * (det.ponit[j].y - det_cy) + (1 - a) * track.landmark_dy[j];
+        }
+        track.face.score = det.score;
+        track.face.cls = det.cls;
+        track.hits++;
+        track.misses = 0;
+        refreshFace(track);
+    }
+
+    // matched tracks survive the erase, but their indices shift
+    int kept = 0;
+    for (int t = 0; t < n_tracks; ++t) {
+        if (track_match[t] != -1) {
+            det_match[track_match[t]] = kept;
+        }
+        if (tracks[t].misses <= config.max_misses) {
+            kept++;
+        }
+    }
+    tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                                [this](const FaceTrack& track) { return track.misses > config.max_misses; }),
+                 tracks.end());
+
+    for (int d = 0; d < n_dets; ++d) {
+        if (det_match[d] != -1) {
+            continue;
+        }
+        const retinaface_object_t& det = detections.object[d];
+        FaceTrack track{};
+        track.id = next_id++;
+        track.face = det;
+        float det_w = det.box.right - det.box.left;
+        float det_h = det.box.bottom - det.box.top;
+        float det_cx = (det.box.left + det.box.right) * 0.5f;
+        float det_cy = (det.box.top + det.box.bottom) * 0.5f;
+        float r = config.measurement_noise * std::max(det_h, 1.f);
+        r *= r;
+        track.cx.init(det_cx, r);
+        track.cy.init(det_cy, r);
+        track.w.init(det_w, r);
+        track.h.init(det_h, r);
+        for (int j = 0; j < 5; ++j) {
+            track.landmark_dx[j] = det.ponit[j].x - det_cx;
+            track.landmark_dy[j] = det.ponit[j].y - det_cy;
+        }
+        track.hits = 1;
+        refreshFace(track);
+        det_match[d] = (int)tracks.size();
+        tracks.push_back(track);
+    }
+
+    estimatePoses(detections);
+    accumulate(dt);
+}
@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if !defined(IMAGE_RESIZE_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define RESIZE_NEON 1
+#include <arm_neon.h>
+#elif !defined(IMAGE_RESIZE_NO_SIMD) && defined(__SSE2__)
+#define RESIZE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include "image_resize.h"
+
+/*
+ * Fixed-point separable bilinear resize used by the CPU path.
+ *
+ * Coefficients are Q8: the horizontal pass produces exact 16-bit sums
+ * (p0 * (256 - a) + p1 * a), the vertical pass blends two of those rows with
+ * Q8 weights and rounds once ((r0 * (256 - b) + r1 * b + 2^15) >> 16). The
+ * NEON/SSE2 kernels of both passes compute the same integer expressions as
+ * the scalar loops, so every build produces bit-identical output.
+ *
+ * Source coordinates keep the original mapping src = crop + dst * crop / box
+ * (no half-pixel offset), so letterbox decoding is unchanged.
+ */
+#define RESIZE_COEF_BITS 8
+#define RESIZE_COEF_ONE (1 << RESIZE_COEF_BITS)
+
+#define RESIZE_ROW_PAD 4     // u16 slack after each cached row, the 3-channel vector store overruns by one
+
+#if defined(RESIZE_NEON) || defined(RESIZE_SSE2)
+// Leading destination pixels whose 4-byte loads stay inside a source row of
+// row_bytes, rounded down to the 4 pixels a vector iteration takes
+static int resize_hline_vec_width(const int *xofs, int dst_width, int row_bytes)
+{
+    int n = dst_width;
+    while (n > 0 && xofs[n * 2 - 1] + 4 > row_bytes) {
+        n--;
+    }
+    return n & ~3;
+}
+
+static inline uint32_t load_pixel(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+#endif
+
+#if defined(RESIZE_NEON)
+/*
+ * 3- and 4-channel horizontal pass, four destination pixels per iteration.
+ * Each pixel is gathered as 4 bytes and widened to four u16 lanes, so both
+ * channel counts share the arithmetic: p0 * (256 - a) + p1 * a is at most
+ * 65280 and equals (p0 << 8) + (p1 - p0) * a modulo 2^16, which the 16-bit
+ * multiply-accumulate computes exactly. 3-channel pixels are stored 4 lanes
+ * wide, the 4th lane is overwritten by the next pixel (or the row pad).
+ */
+static int resize_hline_simd(const unsigned char *src_row, uint16_t *dst_row, int n, int channel,
+                             const int *xofs, const uint16_t *xalpha, int swap_rb)
+{
+    // lanes 3 and 7 keep their channel when R and B trade places
+    static const uint16_t keep_lane3[8] = {0, 0, 0, 0xffff, 0, 0, 0, 0xffff};
+    const uint16x8_t keep = vld1q_u16(keep_lane3);
+    int dx = 0;
+    for (; dx < n; dx += 4) {
+        const int *o = xofs + dx * 2;
+        uint32x4_t v0 = vdupq_n_u32(0), v1 = vdupq_n_u32(0);
+        v0 = vsetq_lane_u32(load_pixel(src_row + o[0]), v0, 0);
+        v1 = vsetq_lane_u32(load_pixel(src_row + o[1]), v1, 0);
+        v0 = vsetq_lane_u32(load_pixel(src_row + o[2]), v0, 1);
+        v1 = vsetq_lane_u32(load_pixel(src_row + o[3]), v1, 1);
+        v0 = vsetq_lane_u32(load_pixel(src_row + o[4]), v0, 2);
+        v1 = vsetq_lane_u32(load_pixel(src_row + o[5]), v1, 2);
+        v0 = vsetq_lane_u32(load_pixel(src_row + o[6]), v0, 3);
+        v1 = vsetq_lane_u32(load_pixel(src_row + o[7]), v1, 3);
+        uint8x16_t b0 = vreinterpretq_u8_u32(v0), b1 = vreinterpretq_u8_u32(v1);
+        // alpha of each pixel on its four lanes
+        uint16x4x2_t a = vzip_u16(vld1_u16(xalpha + dx), vld1_u16(xalpha + dx));
+        uint16x4x2_t alo = vzip_u16(a.val[0], a.val[0]);
+        uint16x4x2_t ahi = vzip_u16(a.val[1], a.val[1]);
+        uint16x8_t p0[2] = {vmovl_u8(vget_low_u8(b0)), vmovl_u8(vget_high_u8(b0))};
+        uint16x8_t p1[2] = {vmovl_u8(vget_low_u8(b1)), vmovl_u8(vget_high_u8(b1))};
+        uint16x8_t alpha[2] = {vcombine_u16(alo.val[0], alo.val[1]), vcombine_u16(ahi.val[0], ahi.val[1])};
+        for (int h = 0; h < 2; h++) {
+            uint16x8_t d = vmlaq_u16(vshlq_n_u16(p0[h], RESIZE_COEF_BITS), vsubq_u16(p1[h], p0[h]), alpha[h]);
+            if (swap_rb) {
+                // [c0 c1 c2 c3] -> [c2 c1 c0 c3]: reverse, rotate by one lane, restore c3
+                uint16x8_t r = vrev64q_u16(d);
+                d = vbslq_u16(keep, d, vextq_u16(r, r, 1));
+            }
+            uint16_t *out = dst_row + (dx + h * 2) * channel;
+            if (channel == 4) {
+                vst1q_u16(out, d);
+            } else {
+                vst1_u16(out, vget_low_u16(d));
+                vst1_u16(out + 3, vget_high_u16(d));
+            }
+        }
+    }
+    return dx;
+}
+#elif defined(RESIZE_SSE2)
+// SSE2 twin of the NEON kernel above, same lanes and the same exact arithmetic
+static int resize_hline_simd(const unsigned char *src_row, uint16_t *dst_row, int n, int channel,
+                             const int *xofs, const uint16_t *xalpha, int swap_rb)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int dx = 0;
+    for (; dx < n; dx += 4) {
+        const int *o = xofs + dx * 2;
+        __m128i b0 = _mm_set_epi32((int)load_pixel(src_row + o[6]), (int)load_pixel(src_row + o[4]),
+                                   (int)load_pixel(src_row + o[2]), (int)load_pixel(src_row + o[0]));
+        __m128i b1 = _mm_set_epi32((int)load_pixel(src_row + o[7]), (int)load_pixel(src_row + o[5]),
+                                   (int)load_pixel(src_row + o[3]), (int)load_pixel(src_row + o[1]));
+        // alpha of each pixel on its four lanes
+        __m128i a = _mm_loadl_epi64((const __m128i *)(xalpha + dx));
+        a = _mm_unpacklo_epi16(a, a);
+        __m128i alpha[2] = {_mm_unpacklo_epi32(a, a), _mm_unpackhi_epi32(a, a)};
+        __m128i p0[2] = {_mm_unpacklo_epi8(b0, zero), _mm_unpackhi_epi8(b0, zero)};
+        __m128i p1[2] = {_mm_unpacklo_epi8(b1, zero), _mm_unpackhi_epi8(b1, zero)};
+        for (int h = 0; h < 2; h++) {
+            __m128i d = _mm_add_epi16(_mm_slli_epi16(p0[h], RESIZE_COEF_BITS),
+                                      _mm_mullo_epi16(_mm_sub_epi16(p1[h], p0[h]), alpha[h]));
+            if (swap_rb) {
+                d = _mm_shufflehi_epi16(_mm_shufflelo_epi16(d, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+            }
+            uint16_t *out = dst_row + (dx + h * 2) * channel;
+            if (channel == 4) {
+                _mm_storeu_si128((__m128i *)out, d);
+            } else {
+                _mm_storel_epi64((__m128i *)out, d);
+                _mm_storel_epi64((__m128i *)(out + 3), _mm_unpackhi_epi64(d, d));
+            }
+        }
+    }
+    return dx;
+}
+#endif
+
+// vec_width: leading pixels the vector kernel may take, see resize_hline_vec_width()
+static void resize_hline(const unsigned char *src_row, uint16_t *dst_row, int dst_width, int channel,
+                         const int *xofs, const uint16_t *xalpha, const int *src_c, int vec_width)
+{
+    int dx = 0;
+#if defined(RESIZE_NEON) || defined(RESIZE_SSE2)
+    if (channel >= 3) {
+        dx = resize_hline_simd(src_row, dst_row, vec_width, channel, xofs, xalpha, src_c[0] != 0);
+    }
+#else
+    (void)vec_width;
+#endif
+    const int c0 = src_c[0], c1 = src_c[1], c2 = src_c[2], c3 = src_c[3];
+    switch (channel) {
+    case 4:
+        for (; dx < dst_width; dx++) {
+            const unsigned char *p0 = src_row + xofs[dx * 2];
+            const unsigned char *p1 = src_row + xofs[dx * 2 + 1];
+            const int a1 = xalpha[dx];
+            const int a0 = RESIZE_COEF_ONE - a1;
+            uint16_t *d = dst_row + dx * 4;
+            d[0] = (uint16_t)(p0[c0] * a0 + p1[c0] * a1);
+            d[1] = (uint16_t)(p0[c1] * a0 + p1[c1] * a1);
+            d[2] = (uint16_t)(p0[c2] * a0 + p1[c2] * a1);
+            d[3] = (uint16_t)(p0[c3] * a0 + p1[c3] * a1);
+        }
+        break;
+    case 3:
+        for (; dx < dst_width; dx++) {
+            const unsigned char *p0 = src_row + xofs[dx * 2];
+            const unsigned char *p1 = src_row + xofs[dx * 2 + 1];
+            const int a1 = xalpha[dx];
+            const int a0 = RESIZE_COEF_ONE - a1;
+            uint16_t *d = dst_row + dx * 3;
+            d[0] = (uint16_t)(p0[c0] * a0 + p1[c0] * a1);
+            d[1] = (uint16_t)(p0[c1] * a0 + p1[c1] * a1);
+            d[2] = (uint16_t)(p0[c2] * a0 + p1[c2] * a1);
+        }
+        break;
+    case 2:
+        for (; dx < dst_width; dx++) {
+            const unsigned char *p0 = src_row + xofs[dx * 2];
+            const unsigned char *p1 = src_row + xofs[dx * 2 + 1];
+            const int a1 = xalpha[dx];
+            const int a0 = RESIZE_COEF_ONE - a1;
+            uint16_t *d = dst_row + dx * 2;
+            d[0] = (uint16_t)(p0[0] * a0 + p1[0] * a1);
+            d[1] = (uint16_t)(p0[1] * a0 + p1[1] * a1);
+        }
+        break;
+    default:
+        for (; dx < dst_width; dx++) {
+            const int a1 = xalpha[dx];
+            dst_row[dx] = (uint16_t)(src_row[xofs[dx * 2]] * (RESIZE_COEF_ONE - a1) + src_row[xofs[dx * 2 + 1]] * a1);
+        }
+        break;
+    }
+}
+
+static void resize_vline(const uint16_t *row0, const uint16_t *row1, unsigned char *dst, int len, int beta)
+{
+    const int b1 = beta;
+    const int b0 = RESIZE_COEF_ONE - beta;
+    int i = 0;
+#if defined(RESIZE_NEON)
+    const uint16x4_t vb0 = vdup_n_u16((uint16_t)b0);
+    const uint16x4_t vb1 = vdup_n_u16((uint16_t)b1);
+    for (; i + 8 <= len; i += 8) {
+        uint16x8_t r0 = vld1q_u16(row0 + i);
+        uint16x8_t r1 = vld1q_u16(row1 + i);
+        uint32x4_t lo = vmull_u16(vget_low_u16(r0), vb0);
+        uint32x4_t hi = vmull_u16(vget_high_u16(r0), vb0);
+        lo = vmlal_u16(lo, vget_low_u16(r1), vb1);
+        hi = vmlal_u16(hi, vget_high_u16(r1), vb1);
+        uint16x8_t sum = vcombine_u16(vrshrn_n_u32(lo, 16), vrshrn_n_u32(hi, 16));
+        vst1_u8(dst + i, vqmovn_u16(sum));
+    }
+#elif defined(RESIZE_SSE2)
+    const __m128i vb0 = _mm_set1_epi16((short)b0);
+    const __m128i vb1 = _mm_set1_epi16((short)b1);
+    const __m128i round = _mm_set1_epi32(1 << 15);
+    for (; i + 8 <= len; i += 8) {
+        __m128i r0 = _mm_loadu_si128((const __m128i *)(row0 + i));
+        __m128i r1 = _mm_loadu_si128((const __m128i *)(row1 + i));
+        // 16x16 -> 32 bit unsigned products from the low and high halves
+        __m128i l0 = _mm_mullo_epi16(r0, vb0);
+        __m128i h0 = _mm_mulhi_epu16(r0, vb0);
+        __m128i l1 = _mm_mullo_epi16(r1, vb1);
+        __m128i h1 = _mm_mulhi_epu16(r1, vb1);
+        __m128i lo = _mm_add_epi32(_mm_unpacklo_epi16(l0, h0), _mm_unpacklo_epi16(l1, h1));
+        __m128i hi = _mm_add_epi32(_mm_unpackhi_epi16(l0, h0), _mm_unpackhi_epi16(l1, h1));
+        lo = _mm_srli_epi32(_mm_add_epi32(lo, round), 16);
+        hi = _mm_srli_epi32(_mm_add_epi32(hi, round), 16);
+        __m128i sum = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(sum, sum));
+    }
+#endif
+    for (; i < len; i++) {
+        dst[i] = (unsigned char)((row0[i] * b0 + row1[i] * b1 + (1 << 15)) >> 16);
+    }
+}
+
+// Source offset pair and Q8 weight for each destination position
+static void resize_coefs(int dst_len, int crop_start, int crop_len, int src_len, int step,
+                         int *ofs, uint16_t *alpha)
+{
+    for (int d = 0; d < dst_len; d++) {
+        long num = (long)d * crop_len;
+        int s = (int)(num / dst_len);
+        int rem = (int)(num % dst_len);
+        int s0 = crop_start + s;
+        int s1 = s0 + 1 < src_len ? s0 + 1 : src_len - 1;
+        ofs[d * 2] = s0 * step;
+        ofs[d * 2 + 1] = s1 * step;
+        alpha[d] = (uint16_t)((rem * RESIZE_COEF_ONE + dst_len / 2) / dst_len);
+    }
+}
+
+static int crop_and_scale_image_c(int channel, unsigned char *src, int src_width, int src_height,
+                                    int crop_x, int crop_y, int crop_width, int crop_height,
+                                    unsigned char *dst, int dst_width, int dst_height,
+                                    int dst_box_x, int dst_box_y, int dst_box_width, int dst_box_height,
+                                    int swap_rb, resize_plane_tables_t *cache) {
+    if (dst == NULL) {
+        printf("dst buffer is null\n");
+        return -1;
+    }
+    if (dst_box_width <= 0 || dst_box_height <= 0 || crop_width <= 0 || crop_height <= 0) {
+        printf("invalid resize box %dx%d -> %dx%d\n", crop_width, crop_height, dst_box_width, dst_box_height);
+        return -1;
+    }
+    if (dst_box_x < 0 || dst_box_y < 0 || dst_box_x + dst_box_width > dst_width || dst_box_y + dst_box_height > dst_height) {
+        printf("dst box %d,%d %dx%d outside %dx%d image\n", dst_box_x, dst_box_y, dst_box_width, dst_box_height,
+               dst_width, dst_height);
+        return -1;
+    }
+
+    // source channel feeding each destination channel, swaps R/B while resizing
+    int src_c[4] = {0, 1, 2, 3};
+    if (swap_rb && channel >= 3) {
+        src_c[0] = 2;
+        src_c[2] = 0;
+    }
+
+    // one block for the coefficient tables and the two cached horizontal rows
+    int row_len = dst_box_width * channel;
+    int row_stride = row_len + RESIZE_ROW_PAD;
+    size_t xofs_size = sizeof(int) * dst_box_width * 2;
+    size_t yofs_size = sizeof(int) * dst_box_height * 2;
+    size_t xalpha_size = sizeof(uint16_t) * dst_box_width;
+    size_t yalpha_size = sizeof(uint16_t) * dst_box_height;
+    size_t rows_size = sizeof(uint16_t) * row_stride * 2;
+    // the tables only depend on the geometry, a cache keeps them across calls
+    int build = 1;
+    unsigned char *tables;
+    if (cache != NULL && cache->tables != NULL && cache->channel == channel &&
+        cache->src_width == src_width && cache->src_height == src_height &&
+        cache->crop_x == crop_x && cache->crop_y == crop_y &&
+        cache->crop_width == crop_width && cache->crop_height == crop_height &&
+        cache->dst_box_width == dst_box_width && cache->dst_box_height == dst_box_height) {
+        tables = (unsigned char *)cache->tables;
+        build = 0;
+    } else {
+        if (cache != NULL) {
+            free(cache->tables);
+            cache->tables = NULL;
+        }
+        tables = (unsigned char *)malloc(xofs_size + yofs_size + xalpha_size + yalpha_size + rows_size);
+        if (tables == NULL) {
+            printf("malloc resize tables fail!\n");
+            return -1;
+        }
+    }
+    int *xofs = (int *)tables;
+    int *yofs = (int *)(tables + xofs_size);
+    uint16_t *rows[2];
+    rows[0] = (uint16_t *)(tables + xofs_size + yofs_size);
+    rows[1] = rows[0] + row_stride;
+    uint16_t *xalpha = rows[1] + row_stride;
+    uint16_t *yalpha = xalpha + dst_box_width;
+
+    if (build) {
+        resize_coefs(dst_box_width, crop_x, crop_width, src_width, channel, xofs, xalpha);
+        resize_coefs(dst_box_height, crop_y, crop_height, src_height, src_width * channel, yofs, yalpha);
+        if (cache != NULL) {
+            cache->channel = channel;
+            cache->src_width = src_width;
+            cache->src_height = src_height;
+            cache->crop_x = crop_x;
+            cache->crop_y = crop_y;
+            cache->crop_width = crop_width;
+            cache->crop_height = crop_height;
+            cache->dst_box_width = dst_box_width;
+            cache->dst_box_height = dst_box_height;
+            cache->tables = tables;
+        }
+    }
+
+#if defined(RESIZE_NEON) || defined(RESIZE_SSE2)
+    int vec_width = resize_hline_vec_width(xofs, dst_box_width, src_width * channel);
+#else
+    int vec_width = 0;
+#endif
+
+    // horizontal rows are cached by source offset, consecutive output rows mostly reuse them
+    int row_src[2] = {-1, -1};
+    for (int dy = 0; dy < dst_box_height; dy++) {
+        int y0 = yofs[dy * 2];
+        int y1 = yofs[dy * 2 + 1];
+        if (row_src[0] != y0) {
+            if (row_src[1] == y0) {
+                uint16_t *tmp = rows[0];
+                rows[0] = rows[1];
+                rows[1] = tmp;
+                row_src[0] = y0;
+                row_src[1] = -1;
+            } else {
+                resize_hline(src + y0, rows[0], dst_box_width, channel, xofs, xalpha, src_c, vec_width);
+                row_src[0] = y0;
+            }
+        }
+        if (row_src[1] != y1) {
+            resize_hline(src + y1, rows[1], dst_box_width, channel, xofs, xalpha, src_c, vec_width);
+            row_src[1] = y1;
+        }
+        unsigned char *dst_row = dst + ((dst_box_y + dy) * dst_width + dst_box_x) * channel;
+        resize_vline(rows[0], rows[1], dst_row, row_len, yalpha[dy]);
+    }
+
+    if (cache == NULL) {
+        free(tables);
+    }
+    return 0;
+}
+
+// Fill only the letterbox border around dst box, the box itself is overwritten by the resize
+static void fill_pad_c(int channel, unsigned char *dst, int dst_width, int dst_height,
+                       int box_x, int box_y, int box_width, int box_height, char color)
+{
+    int stride = dst_width * channel;
+    if (box_y > 0) {
+        memset(dst, color, (size_t)box_y * stride);
+    }
+    if (box_y + box_height < dst_height) {
+        memset(dst + (size_t)(box_y + box_height) * stride, color, (size_t)(dst_height - box_y - box_height) * stride);
+    }
+    if (box_x > 0 || box_x + box_width < dst_width) {
+        for (int y = box_y; y < box_y + box_height; y++) {
+            unsigned char *row = dst + (size_t)y * stride;
+            memset(row, color, (size_t)box_x * channel);
+            memset(row + (box_x + box_width) * channel, color, (size_t)(dst_width - box_x - box_width) * channel);
+        }
+    }
+}
+
+static int crop_and_scale_image_yuv420sp(unsigned char *src, int src_width, int src_height,
+                                    int crop_x, int crop_y, int crop_width, int crop_height,
+                                    unsigned char *dst, int dst_width, int dst_height,
+                                    int dst_box_x, int dst_box_y, int dst_box_width, int dst_box_height,
+                                    resize_tables_t *cache) {
+
+    unsigned char* src_y = src;
+    unsigned char* src_uv = src + src_width * src_height;
+
+    unsigned char* dst_y = dst;
+    unsigned char* dst_uv = dst + dst_width * dst_height;
+
+    int ret = crop_and_scale_image_c(1, src_y, src_width, src_height, crop_x, crop_y, crop_width, crop_height,
+        dst_y, dst_width, dst_height, dst_box_x, dst_box_y, dst_box_width, dst_box_height, 0,
+        cache != NULL ? &cache->plane[0] : NULL);
+    if (ret != 0) {
+        return ret;
+    }
+
+    // interleaved UV plane is half size in both directions, including the dst box
+    return crop_and_scale_image_c(2, src_uv, src_width / 2, src_height / 2, crop_x / 2, crop_y / 2, crop_width / 2, crop_height / 2,
+        dst_uv, dst_width / 2, dst_height / 2, dst_box_x / 2, dst_box_y / 2, dst_box_width / 2, dst_box_height / 2, 0,
+        cache != NULL ? &cache->plane[1] : NULL);
+}
+
+int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rect_t *src_box, image_rect_t *dst_box, char color, int fill_pad,
+                      resize_tables_t *tables) {
+    if (dst->virt_addr == NULL) {
+        return -1;
+    }
+    if (src->virt_addr == NULL) {
+        return -1;
+    }
+    // BGR <-> RGB is the only conversion done here, fused into the resize
+    int swap_rb = 0;
+    if (src->format != dst->format) {
+        if ((src->format == IMAGE_FORMAT_BGR888 && dst->format == IMAGE_FORMAT_RGB888) ||
+            (src->format == IMAGE_FORMAT_RGB888 && dst->format == IMAGE_FORMAT_BGR888)) {
+            swap_rb = 1;
+        } else {
+            return -1;
+        }
+    }
+    // channels of the packed formats, 0 for semi-planar YUV
+    int channel;
+    switch (src->format) {
+    case IMAGE_FORMAT_GRAY8:
+        channel = 1;
+        break;
+    case IMAGE_FORMAT_RGB888:
+    case IMAGE_FORMAT_BGR888:
+        channel = 3;
+        break;
+    case IMAGE_FORMAT_RGBA8888:
+        channel = 4;
+        break;
+    case IMAGE_FORMAT_YUV420SP_NV12:
+    case IMAGE_FORMAT_YUV420SP_NV21:
+        channel = 0;
+        break;
+    default:
+        printf("no support format %d\n", src->format);
+        return -1;
+    }
+
+    int src_box_x = 0;
+    int src_box_y = 0;
+    int src_box_w = src->width;
+    int src_box_h = src->height;
+    if (src_box != NULL) {
+        src_box_x = src_box->left;
+        src_box_y = src_box->top;
+        src_box_w = src_box->right - src_box->left + 1;
+        src_box_h = src_box->bottom - src_box->top + 1;
+    }
+    int dst_box_x = 0;
+    int dst_box_y = 0;
+    int dst_box_w = dst->width;
+    int dst_box_h = dst->height;
+    if (dst_box != NULL) {
+        dst_box_x = dst_box->left;
+        dst_box_y = dst_box->top;
+        dst_box_w = dst_box->right - dst_box->left + 1;
+        dst_box_h = dst_box->bottom - dst_box->top + 1;
+    }
+
+    // fill pad color, only the border outside dst box
+    if (fill_pad && (dst_box_w != dst->width || dst_box_h != dst->height)) {
+        if (channel == 0) {
+            fill_pad_c(1, dst->virt_addr, dst->width, dst->height,
+                dst_box_x, dst_box_y, dst_box_w, dst_box_h, color);
+            fill_pad_c(2, dst->virt_addr + dst->width * dst->height, dst->width / 2, dst->height / 2,
+                dst_box_x / 2, dst_box_y / 2, dst_box_w / 2, dst_box_h / 2, color);
+        } else {
+            fill_pad_c(channel, dst->virt_addr, dst->width, dst->height,
+                dst_box_x, dst_box_y, dst_box_w, dst_box_h, color);
+        }
+    }
+
+    int reti;
+    if (channel == 0) {
+        reti = crop_and_scale_image_yuv420sp(src->virt_addr, src->width, src->height,
+            src_box_x, src_box_y, src_box_w, src_box_h,
+            dst->virt_addr, dst->width, dst->height,
+            dst_box_x, dst_box_y, dst_box_w, dst_box_h, tables);
+    } else {
+        reti = crop_and_scale_image_c(channel, src->virt_addr, src->width, src->height,
+            src_box_x, src_box_y, src_box_w, src_box_h,
+            dst->virt_addr, dst->width, dst->height,
+            dst_box_x, dst_box_y, dst_box_w, dst_box_h, swap_rb, tables != NULL ? &tables->plane[0] : NULL);
+    }
+    if (reti != 0) {
+        printf("convert_image_cpu fail %d\n", reti);
+        return -1;
+    }
+    return 0;
+}
+
+void release_resize_tables(resize_tables_t *tables)
+{
+    for (int i = 0; i < 2; i++) {
+        free(tables->plane[i].tables);
+    }
+    memset(tables, 0, sizeof(resize_tables_t));
+}
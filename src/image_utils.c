@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <dirent.h>
 #include <math.h>
+#include <stdint.h>
 #include <sys/time.h>
 
 #include "im2d.h"
@@ -19,6 +20,7 @@
 #include "turbojpeg.h"
 
 #include "image_utils.h"
+#include "image_resize.h"
 #include "file_utils.h"
 
 static const char* filter_image_names[] = {
@@ -192,7 +194,11 @@ static int write_image_jpeg(const char* path, int quality, const image_buffer_t*
 
 	tjhandle handle = tjInitCompress();
 
-    if (image->format == IMAGE_FORMAT_RGB888) {
+    if (image->format == IMAGE_FORMAT_BGR888) {
+        pixelFormat = TJPF_BGR;
+    }
+
+    if (image->format == IMAGE_FORMAT_RGB888 || image->format == IMAGE_FORMAT_BGR888) {
         ret = tjCompress2(handle, data, width, 0, height, pixelFormat, &jpegBuf, &jpegSize, jpegSubsamp, quality, flags);
     } else {
         printf("write_image_jpeg: pixel format %d not support\n", image->format);
@@ -288,173 +294,13 @@ int write_image(const char* path, const image_buffer_t* img)
     return ret;
 }
 
-static int crop_and_scale_image_c(int channel, unsigned char *src, int src_width, int src_height,
-                                    int crop_x, int crop_y, int crop_width, int crop_height,
-                                    unsigned char *dst, int dst_width, int dst_height,
-                                    int dst_box_x, int dst_box_y, int dst_box_width, int dst_box_height) {
-    if (dst == NULL) {
-        printf("dst buffer is null\n");
-        return -1;
-    }
-
-    float x_ratio = (float)crop_width / (float)dst_box_width;
-    float y_ratio = (float)crop_height / (float)dst_box_height;
-
-    // printf("src_width=%d src_height=%d crop_x=%d crop_y=%d crop_width=%d crop_height=%d\n",
-    //     src_width, src_height, crop_x, crop_y, crop_width, crop_height);
-    // printf("dst_width=%d dst_height=%d dst_box_x=%d dst_box_y=%d dst_box_width=%d dst_box_height=%d\n",
-    //     dst_width, dst_height, dst_box_x, dst_box_y, dst_box_width, dst_box_height);
-    // printf("channel=%d x_ratio=%f y_ratio=%f\n", channel, x_ratio, y_ratio);
-
-    // 从原图指定区域取数据，双线性缩放到目标指定区域
-    for (int dst_y = dst_box_y; dst_y < dst_box_y + dst_box_height; dst_y++) {
-        for (int dst_x = dst_box_x; dst_x < dst_box_x + dst_box_width; dst_x++) {
-            int dst_x_offset = dst_x - dst_box_x;
-            int dst_y_offset = dst_y - dst_box_y;
-
-            int src_x = (int)(dst_x_offset * x_ratio) + crop_x;
-            int src_y = (int)(dst_y_offset * y_ratio) + crop_y;
-
-            float x_diff = (dst_x_offset * x_ratio) - (src_x - crop_x);
-            float y_diff = (dst_y_offset * y_ratio) - (src_y - crop_y);
-
-            int index1 = src_y * src_width * channel + src_x * channel;
-            int index2 = index1 + src_width * channel;    // down
-            if (src_y == src_height - 1) {
-                // 如果到图像最下边缘，变成选择上面的像素
-                index2 = index1 - src_width * channel;
-            }
-            int index3 = index1 + 1 * channel;            // right
-            int index4 = index2 + 1 * channel;            // down right
-            if (src_x == src_width - 1) {
-                // 如果到图像最右边缘，变成选择左边的像素
-                index3 = index1 - 1 * channel;
-                index4 = index2 - 1 * channel;
-            }
-
-            // printf("dst_x=%d dst_y=%d dst_x_offset=%d dst_y_offset=%d src_x=%d src_y=%d x_diff=%f y_diff=%f src index=%d %d %d %d\n",
-            //     dst_x, dst_y, dst_x_offset, dst_y_offset,
-            //     src_x, src_y, x_diff, y_diff,
-            //     index1, index2, index3, index4);
-
-            for (int c = 0; c < channel; c++) {
-                unsigned char A = src[index1+c];
-                unsigned char B = src[index3+c];
-                unsigned char C = src[index2+c];
-                unsigned char D = src[index4+c];
-
-                unsigned char pixel = (unsigned char)(
-                    A * (1 - x_diff) * (1 - y_diff) +
-                    B * x_diff * (1 - y_diff) +
-                    C * y_diff * (1 - x_diff) +
-                    D * x_diff * y_diff
-                );
-
-                dst[(dst_y * dst_width  + dst_x) * channel + c] = pixel;
-            }
-        }
-    }
-
-    return 0;
-}
-
-static int crop_and_scale_image_yuv420sp(unsigned char *src, int src_width, int src_height,
-                                    int crop_x, int crop_y, int crop_width, int crop_height,
-                                    unsigned char *dst, int dst_width, int dst_height,
-                                    int dst_box_x, int dst_box_y, int dst_box_width, int dst_box_height) {
-
-    unsigned char* src_y = src;
-    unsigned char* src_uv = src + src_width * src_height;
-
-    unsigned char* dst_y = dst;
-    unsigned char* dst_uv = dst + dst_width * dst_height;
-
-    crop_and_scale_image_c(1, src_y, src_width, src_height, crop_x, crop_y, crop_width, crop_height,
-        dst_y, dst_width, dst_height, dst_box_x, dst_box_y, dst_box_width, dst_box_height);
-    
-    crop_and_scale_image_c(2, src_uv, src_width / 2, src_height / 2, crop_x / 2, crop_y / 2, crop_width / 2, crop_height / 2,
-        dst_uv, dst_width / 2, dst_height / 2, dst_box_x, dst_box_y, dst_box_width, dst_box_height);
-
-    return 0;
-}
-
-static int convert_image_cpu(image_buffer_t *src, image_buffer_t *dst, image_rect_t *src_box, image_rect_t *dst_box, char color) {
-    int ret;
-    if (dst->virt_addr == NULL) {
-        return -1;
-    }
-    if (src->virt_addr == NULL) {
-        return -1;
-    }
-    if (src->format != dst->format) {
-        return -1;
-    }
-
-    int src_box_x = 0;
-    int src_box_y = 0;
-    int src_box_w = src->width;
-    int src_box_h = src->height;
-    if (src_box != NULL) {
-        src_box_x = src_box->left;
-        src_box_y = src_box->top;
-        src_box_w = src_box->right - src_box->left + 1;
-        src_box_h = src_box->bottom - src_box->top + 1;
-    }
-    int dst_box_x = 0;
-    int dst_box_y = 0;
-    int dst_box_w = dst->width;
-    int dst_box_h = dst->height;
-    if (dst_box != NULL) {
-        dst_box_x = dst_box->left;
-        dst_box_y = dst_box->top;
-        dst_box_w = dst_box->right - dst_box->left + 1;
-        dst_box_h = dst_box->bottom - dst_box->top + 1;
-    }
-
-    // fill pad color
-    if (dst_box_w != dst->width || dst_box_h != dst->height) {
-        int dst_size = get_image_size(dst);
-        memset(dst->virt_addr, color, dst_size);
-    }
-
-    int need_release_dst_buffer = 0;
-    int reti = 0;
-    if (src->format == IMAGE_FORMAT_RGB888) {
-        reti = crop_and_scale_image_c(3, src->virt_addr, src->width, src->height,
-            src_box_x, src_box_y, src_box_w, src_box_h,
-            dst->virt_addr, dst->width, dst->height,
-            dst_box_x, dst_box_y, dst_box_w, dst_box_h);
-    } else if (src->format == IMAGE_FORMAT_RGBA8888) {
-        reti = crop_and_scale_image_c(4, src->virt_addr, src->width, src->height,
-            src_box_x, src_box_y, src_box_w, src_box_h,
-            dst->virt_addr, dst->width, dst->height,
-            dst_box_x, dst_box_y, dst_box_w, dst_box_h);
-    } else if (src->format == IMAGE_FORMAT_GRAY8) {
-        reti = crop_and_scale_image_c(1, src->virt_addr, src->width, src->height,
-            src_box_x, src_box_y, src_box_w, src_box_h,
-            dst->virt_addr, dst->width, dst->height,
-            dst_box_x, dst_box_y, dst_box_w, dst_box_h);
-    } else if (src->format == IMAGE_FORMAT_YUV420SP_NV12 || src->format == IMAGE_FORMAT_YUV420SP_NV21) {
-        reti = crop_and_scale_image_yuv420sp(src->virt_addr, src->width, src->height,
-            src_box_x, src_box_y, src_box_w, src_box_h,
-            dst->virt_addr, dst->width, dst->height,
-            dst_box_x, dst_box_y, dst_box_w, dst_box_h);
-    } else {
-        printf("no support format %d\n", src->format);
-    }
-    if (reti != 0) {
-        printf("convert_image_cpu fail %d\n", reti);
-        return -1;
-    }
-    // printf("finish\n");
-    return 0;
-}
-
 static int get_rga_fmt(image_format_t fmt) {
     switch (fmt)
     {
     case IMAGE_FORMAT_RGB888:
         return RK_FORMAT_RGB_888;
+    case IMAGE_FORMAT_BGR888:
+        return RK_FORMAT_BGR_888;
     case IMAGE_FORMAT_RGBA8888:
         return RK_FORMAT_RGBA_8888;
     case IMAGE_FORMAT_YUV420SP_NV12:
@@ -476,6 +322,7 @@ int get_image_size(const image_buffer_t* image)
     case IMAGE_FORMAT_GRAY8:
         return image->width * image->height;
     case IMAGE_FORMAT_RGB888:
+    case IMAGE_FORMAT_BGR888:
         return image->width * image->height * 3;    
     case IMAGE_FORMAT_RGBA8888:
         return image->width * image->height * 4;
@@ -487,7 +334,7 @@ int get_image_size(const image_buffer_t* image)
     }
 }
 
-static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color)
+static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color, int fill_pad)
 {
     int ret = 0;
 
@@ -620,7 +467,7 @@ static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, i
         }
     }
 
-    if (drect.width != dstWidth || drect.height != dstHeight) {
+    if (fill_pad && (drect.width != dstWidth || drect.height != dstHeight)) {
         im_rect dst_whole_rect = {0, 0, dstWidth, dstHeight};
         int imcolor;
         char* p_imcolor = (char *) &imcolor;
@@ -663,12 +510,13 @@ err:
     return ret;
 }
 
-int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color)
+static int convert_image_fill(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color, int fill_pad,
+    resize_tables_t* tables)
 {
     int ret;
 #if defined(DISABLE_RGA) 
     // printf("convert image use cpu\n");
-    ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color);
+    ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color, fill_pad, tables);
 #else
 
 #if defined(RV1106_1103) 
@@ -676,27 +524,33 @@ int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t
 #else
     if(src_img->width % 16 == 0 && dst_img->width % 16 == 0) {
 #endif
-        ret = convert_image_rga(src_img, dst_img, src_box, dst_box, color);
+        ret = convert_image_rga(src_img, dst_img, src_box, dst_box, color, fill_pad);
         if (ret != 0) {
             printf("try convert image use cpu\n");
-            ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color);
+            ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color, fill_pad, tables);
         }
     } else {
         printf("src width is not 4/16-aligned, convert image use cpu\n");
-        ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color);
+        ret = convert_image_cpu(src_img, dst_img, src_box, dst_box, color, fill_pad, tables);
     }
 #endif
     return ret;
 }
 
-int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color)
+int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color)
+{
+    return convert_image_fill(src_img, dst_img, src_box, dst_box, color, 1, NULL);
+}
+
+int convert_image_into_box(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box)
+{
+    return convert_image_fill(src_img, dst_img, src_box, dst_box, 0, 0, NULL);
+}
+
+static void compute_letterbox(int src_w, int src_h, int dst_w, int dst_h,
+    image_rect_t* src_box, image_rect_t* dst_box, letterbox_t* letterbox)
 {
-    int ret = 0;
     int allow_slight_change = 1;
-    int src_w = src_image->width;
-    int src_h = src_image->height;
-    int dst_w = dst_image->width;
-    int dst_h = dst_image->height;
     int resize_w = dst_w;
     int resize_h = dst_h;
 
@@ -707,17 +561,15 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
     int _top_offset = 0;
     float scale = 1.0;
 
-    image_rect_t src_box;
-    src_box.left = 0;
-    src_box.top = 0;
-    src_box.right = src_image->width - 1;
-    src_box.bottom = src_image->height - 1;
+    src_box->left = 0;
+    src_box->top = 0;
+    src_box->right = src_w - 1;
+    src_box->bottom = src_h - 1;
 
-    image_rect_t dst_box;
-    dst_box.left = 0;
-    dst_box.top = 0;
-    dst_box.right = dst_image->width - 1;
-    dst_box.bottom = dst_image->height - 1;
+    dst_box->left = 0;
+    dst_box->top = 0;
+    dst_box->right = dst_w - 1;
+    dst_box->bottom = dst_h - 1;
 
     float _scale_w = (float)dst_w / src_w;
     float _scale_h = (float)dst_h / src_h;
@@ -740,35 +592,47 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
     padding_w = dst_w - resize_w;
     // center
     if (_scale_w < _scale_h) {
-        dst_box.top = padding_h / 2;
-        if (dst_box.top % 2 != 0) {
-            dst_box.top -= dst_box.top % 2;
-            if (dst_box.top < 0) {
-                dst_box.top = 0;
+        dst_box->top = padding_h / 2;
+        if (dst_box->top % 2 != 0) {
+            dst_box->top -= dst_box->top % 2;
+            if (dst_box->top < 0) {
+                dst_box->top = 0;
             }
         }
-        dst_box.bottom = dst_box.top + resize_h - 1;
-        _top_offset = dst_box.top;
+        dst_box->bottom = dst_box->top + resize_h - 1;
+        _top_offset = dst_box->top;
     } else {
-        dst_box.left = padding_w / 2;
-        if (dst_box.left % 2 != 0) {
-            dst_box.left -= dst_box.left % 2;
-            if (dst_box.left < 0) {
-                dst_box.left = 0;
+        dst_box->left = padding_w / 2;
+        if (dst_box->left % 2 != 0) {
+            dst_box->left -= dst_box->left % 2;
+            if (dst_box->left < 0) {
+                dst_box->left = 0;
             }
         }
-        dst_box.right = dst_box.left + resize_w - 1;
-        _left_offset = dst_box.left;
+        dst_box->right = dst_box->left + resize_w - 1;
+        _left_offset = dst_box->left;
     }
     // printf("scale=%f dst_box=(%d %d %d %d) allow_slight_change=%d _left_offset=%d _top_offset=%d padding_w=%d padding_h=%d\n",
-    //     scale, dst_box.left, dst_box.top, dst_box.right, dst_box.bottom, allow_slight_change,
+    //     scale, dst_box->left, dst_box->top, dst_box->right, dst_box->bottom, allow_slight_change,
     //     _left_offset, _top_offset, padding_w, padding_h);
 
     //set offset and scale
+    letterbox->scale = scale;
+    letterbox->x_pad = _left_offset;
+    letterbox->y_pad = _top_offset;
+}
+
+int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color)
+{
+    int ret = 0;
+    image_rect_t src_box;
+    image_rect_t dst_box;
+    letterbox_t lb;
+
+    compute_letterbox(src_image->width, src_image->height, dst_image->width, dst_image->height,
+        &src_box, &dst_box, &lb);
     if(letterbox != NULL){
-        letterbox->scale = scale;
-        letterbox->x_pad = _left_offset;
-        letterbox->y_pad = _top_offset;
+        *letterbox = lb;
     }
     // alloc memory buffer for dst image,
     // remember to free
@@ -782,4 +646,42 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
     }
     ret = convert_image(src_image, dst_image, &src_box, &dst_box, color);
     return ret;
-}
\ No newline at end of file
+}
+
+int convert_image_with_letterbox_cached(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_cache_t* cache, char color)
+{
+    int ret = 0;
+    if (dst_image->virt_addr == NULL && dst_image->fd <= 0) {
+        printf("letterbox cache needs a preallocated dst image\n");
+        return -1;
+    }
+    // geometry only changes with the source or target size
+    if (cache->src_width != src_image->width || cache->src_height != src_image->height ||
+        cache->dst_width != dst_image->width || cache->dst_height != dst_image->height) {
+        compute_letterbox(src_image->width, src_image->height, dst_image->width, dst_image->height,
+            &cache->src_box, &cache->dst_box, &cache->letterbox);
+        cache->src_width = src_image->width;
+        cache->src_height = src_image->height;
+        cache->dst_width = dst_image->width;
+        cache->dst_height = dst_image->height;
+        cache->pad_filled = 0;
+    }
+    // the pad border is never written by the resize, so fill it once per target buffer
+    int fill_pad = !cache->pad_filled || cache->pad_color != color || cache->dst_addr != dst_image->virt_addr;
+    ret = convert_image_fill(src_image, dst_image, &cache->src_box, &cache->dst_box, color, fill_pad,
+        &cache->resize_tables);
+    if (ret == 0) {
+        cache->pad_filled = 1;
+        cache->pad_color = color;
+        cache->dst_addr = dst_image->virt_addr;
+    } else {
+        cache->pad_filled = 0;
+    }
+    return ret;
+}
+
+void release_letterbox_cache(letterbox_cache_t* cache)
+{
+    release_resize_tables(&cache->resize_tables);
+    memset(cache, 0, sizeof(letterbox_cache_t));
+}
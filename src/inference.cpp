@@ -1,68 +1,165 @@
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <thread>
 
 #include "attention.h"
+#include "event_bus.h"
 #include "inference.h"
+#include "replay.h"
+#include "trace.h"
 
+FrameMetrics::FrameMetrics()
+    : capture(stageHistogram("capture")),
+      letterbox(stageHistogram("letterbox")),
+      npu(stageHistogram("npu")),
+      postprocess(stageHistogram("postprocess")),
+      draw(stageHistogram("draw")),
+      jpeg(stageHistogram("jpeg")),
+      frames(metrics().counter("bsext_frames_total", "Camera frames processed")),
+      detect_frames(metrics().counter("bsext_detect_frames_total", "Frames the face detector ran on")),
+      roi_frames(metrics().counter("bsext_roi_frames_total", "Detector runs on crops around tracks")),
+      faces_truncated(metrics().counter("bsext_faces_truncated_total", "Faces dropped by the per-frame cap")),
+      tracks(metrics().gauge("bsext_tracks", "Face tracks in the last frame")),
+      asr_triggers(metrics().counter("bsext_asr_triggers_total", "ASR sessions started by the attention gate")),
+      empty_transcripts(metrics().counter("bsext_asr_empty_transcripts_total", "ASR sessions with an empty transcript")),
+      avoided_glance(metrics().counter("bsext_asr_avoided_total", "ASR sessions the attention gate avoided",
+                                       "reason=\"glance\"")),
+      avoided_cooldown(metrics().counter("bsext_asr_avoided_total", "ASR sessions the attention gate avoided",
+                                         "reason=\"cooldown\"")),
+      avoided_repeat(metrics().counter("bsext_asr_avoided_total", "ASR sessions the attention gate avoided",
+                                       "reason=\"repeat\"")) {}
 
+// Wraps the captured frame without copying. OpenCV frames are BGR; the swap
+// to the model's RGB happens inside the letterbox resize, so the frame stays
+// in the encoder's native order for drawing and cv::imwrite.
 void cv_to_image_buffer(cv::Mat& img, image_buffer_t* image) {
-    cv::cvtColor(img, img, cv::COLOR_BGR2RGB);
-
     image->width = img.cols;
     image->height = img.rows;
     image->width_stride = img.cols;
     image->height_stride = img.rows;
-    image->format = IMAGE_FORMAT_RGB888;
+    image->format = IMAGE_FORMAT_BGR888;
     image->virt_addr = img.data;
     image->size = img.cols * img.rows * 3;
     image->fd = -1;
 }
 
-// Simulated ML model inference
+// Padded crops around the current tracks for ROI re-detection. Returns 0 when
+// a full-frame scan is needed instead (no tracks, or more than fit one call).
+int MLInferenceThread::collectRois(const cv::Mat& img, image_rect_t* rois) {
+    const auto& tracks = tracker.getTracks();
+    if (tracks.empty() || tracks.size() > RETINAFACE_MAX_ROIS) {
+        return 0;
+    }
+    int n = 0;
+    for (const auto& track : tracks) {
+        const auto& box = track.face.box;
+        float cx = (box.left + box.right) * 0.5f;
+        float cy = (box.top + box.bottom) * 0.5f;
+        float side = std::max(box.right - box.left, box.bottom - box.top) * ROI_PAD_SCALE;
+        side = std::max(side, 32.f);
+        image_rect_t roi;
+        roi.left = std::max(0, (int)(cx - side / 2));
+        roi.top = std::max(0, (int)(cy - side / 2));
+        roi.right = std::min(img.cols - 1, (int)(cx + side / 2));
+        roi.bottom = std::min(img.rows - 1, (int)(cy + side / 2));
+        if (roi.right - roi.left < 8 || roi.bottom - roi.top < 8) {
+            // track drifted off the frame, let a full scan sort it out
+            return 0;
+        }
+        rois[n++] = roi;
+    }
+    return n;
+}
+
+// Runs the detector every detect_interval frames and the tracker on every
+// frame; counts and overlays come from the tracks, not raw detections.
+// Between full-frame scans the detector only looks at crops around tracks.
 InferenceResult MLInferenceThread::runInference(cv::Mat& cap) {
-    image_buffer_t image;
-    memset(&image, 0, sizeof(image));
-    cv_to_image_buffer(cap, &image);
+    InferenceResult final_result{-1, -1, {}, "", std::chrono::system_clock::now()};
 
-    InferenceResult final_result{-1, -1, "", std::chrono::system_clock::now()};
+    auto now = std::chrono::steady_clock::now();
+    double dt = 0;
+    if (frames > 0) {
+        // a replay moves exactly one frame of video time per frame
+        dt = replay_clock ? replay_clock->frameSeconds()
+                          : std::chrono::duration<double>(now - last_frame_time).count();
+    }
+    last_frame_time = now;
+    frame_dt = dt;
 
-    retinaface_result result;
-    int ret = inference_retinaface_model(&rknn_app_ctx, 
-        &image, &result);
-    if (ret != 0) {
-        printf("inference_retinaface_model fail! ret=%d\n", ret);
-        return final_result;
+    if (frames % detect_interval == 0) {
+        image_buffer_t image;
+        memset(&image, 0, sizeof(image));
+        cv_to_image_buffer(cap, &image);
+
+        retinaface_result& result = face_result;
+        image_rect_t rois[RETINAFACE_MAX_ROIS];
+        int n_rois = 0;
+        if (roi_redetect && detect_rounds % full_scan_interval != 0) {
+            n_rois = collectRois(cap, rois);
+        }
+        detect_rounds++;
+        int ret;
+        if (n_rois > 0) {
+            ret = inference_retinaface_model_rois(&retinaface_ctx, &image, rois, n_rois, &result);
+            frame_metrics.roi_frames.add();
+        } else {
+            ret = inference_retinaface_model(&retinaface_ctx, 
+                &image, &result);
+        }
+        if (ret != 0) {
+            printf("inference_retinaface_model fail! ret=%d\n", ret);
+            frames++;
+            return final_result;
+        }
+        tracker.update(result, dt);
+
+        frame_metrics.letterbox.recordMs(retinaface_ctx.perf.preprocess_ms);
+        frame_metrics.npu.recordMs(retinaface_ctx.perf.npu_ms);
+        frame_metrics.postprocess.recordMs(retinaface_ctx.perf.postprocess_ms);
+        frame_metrics.faces_truncated.add(retinaface_ctx.perf.truncated);
+        frame_metrics.detect_frames.add();
+    } else {
+        tracker.predict(dt);
     }
-    final_result.count_all_faces_in_frame = result.count;
+    final_result.count_all_faces_in_frame = 0;
     final_result.num_faces_attending = 0;
+    final_result.faces.clear();
 
-    // Draw boxes on the image
-    for (auto i{0}; i < result.count; i++) {
-        auto color = cv::Scalar(255, 0, 0);     // red
-        if (face_is_looking_at_us(result.object[i])) {
+    // Draw boxes on the image, colors are BGR to match the captured frame
+    auto draw_start = std::chrono::steady_clock::now();
+    for (const auto& track : tracker.getTracks()) {
+        if (!track.visible(tracker.getConfig())) {
+            continue;
+        }
+        final_result.count_all_faces_in_frame += 1;
+        final_result.faces.push_back({track.id, track.pose.yaw, track.pose.pitch, track.pose.roll, track.attending});
+        const auto& face = track.face;
+        auto color = cv::Scalar(0, 0, 255);     // red
+        if (track.attending) {
             // std::cout << "Face is looking at us" << std::endl;
             final_result.num_faces_attending += 1;
             color = cv::Scalar(0, 255, 0);     // green
 
             // draw eyes
-            auto left_eye = result.object[i].ponit[0];
-            auto right_eye = result.object[i].ponit[1];
-            cv::circle(cap, cv::Point(left_eye.x, left_eye.y), 2, cv::Scalar(0, 128, 128), 2);
+            auto left_eye = face.ponit[0];
+            auto right_eye = face.ponit[1];
+            cv::circle(cap, cv::Point(left_eye.x, left_eye.y), 2, cv::Scalar(128, 128, 0), 2);
 
             // draw the other points
             for (auto j{2}; j < 5; j++) {
-                auto point = result.object[i].ponit[j];
-                cv::circle(cap, cv::Point(point.x, point.y), 2, cv::Scalar(128, 128, 0), 2);
+                auto point = face.ponit[j];
+                cv::circle(cap, cv::Point(point.x, point.y), 2, cv::Scalar(0, 128, 128), 2);
             }
         }
 
-        auto box = result.object[i].box;
+        auto box = face.box;
         cv::rectangle(cap, cv::Point(box.left, box.top), cv::Point(box.right, box.bottom), color, 2);     
+        cv::putText(cap, std::to_string(track.id), cv::Point(box.left, box.top - 4),
+                    cv::FONT_HERSHEY_SIMPLEX, 0.5, color, 1);
     }
-
-    // Optionally write processed image to file for debugging
-    cv::cvtColor(cap, cap, cv::COLOR_RGB2BGR);
+    frame_metrics.draw.recordSince(draw_start);
 
     frames++;
 
@@ -72,33 +169,41 @@ InferenceResult MLInferenceThread::runInference(cv::Mat& cap) {
 MLInferenceThread::MLInferenceThread(
         const std::string& retinaface_model_path,
         const std::string& source_name,
-        ThreadSafeQueue<InferenceResult>& jsonQueue,
-        ThreadSafeQueue<InferenceResult>& bsvarQueue,
-        std::mutex& gaze_mutex_,
-        std::condition_variable& gaze_cv_,
-        bool& trigger_asr_,
-        std::atomic<bool>& asr_busy_,
-        std::atomic<int>& current_faces_attending_,
-        std::atomic<int>& current_total_faces_,
+        ResultRing& results,
+        EventBus& events,
         std::atomic<bool>& isRunning,
-        int target_fps=5)
-    : jsonResultQueue(jsonQueue),
-      bsvarResultQueue(bsvarQueue),
-      gaze_mutex(gaze_mutex_),
-      gaze_cv(gaze_cv_),
-      trigger_asr(trigger_asr_),
-      asr_busy(asr_busy_),
-      current_faces_attending(current_faces_attending_),
-      current_total_faces(current_total_faces_),
+        int target_fps,
+        int max_faces,
+        ReplayClock* replay_clock,
+        int detect_interval,
+        bool roi_redetect,
+        int full_scan_interval,
+        const AttentionGateConfig& gate_config)
+    : results(results),
       running(isRunning),
-      target_fps(target_fps) {
+      target_fps(target_fps),
+      gate(gate_config),
+      detect_interval(detect_interval > 0 ? detect_interval : 1),
+      roi_redetect(roi_redetect),
+      full_scan_interval(full_scan_interval > 0 ? full_scan_interval : 1),
+      events(events),
+      asr_events(events.subscribe(eventMask(EventType::ListeningStarted) | eventMask(EventType::TranscriptReady))),
+      replay_clock(replay_clock) {
 
     // Create and initialize the model
-    // rknn_app_context_t rknn_app_ctx;
-    memset(&rknn_app_ctx, 0, sizeof(rknn_app_ctx));
+    memset(&retinaface_ctx, 0, sizeof(retinaface_ctx));
+    if (init_retinaface_result(&face_result, max_faces) != 0) {
+        printf("init_retinaface_result fail! max_faces=%d\n", max_faces);
+        return;
+    }
+    std::cout << "Max faces per frame: " << face_result.max_faces << std::endl;
+    std::cout << "Face detection every " << this->detect_interval << " frame(s)" << std::endl;
+    if (this->roi_redetect) {
+        std::cout << "ROI re-detection on, full scan every " << this->full_scan_interval << " detection(s)" << std::endl;
+    }
     std::cout<< "RetinaFace model path: " << retinaface_model_path << std::endl;
     
-    auto ret = init_retinaface_model(retinaface_model_path, &rknn_app_ctx);
+    auto ret = init_retinaface_model(retinaface_model_path, &retinaface_ctx);
     if (ret != 0) {
         printf("init_retinaface_model fail! ret=%d model_path=%s\n", ret, retinaface_model_path);
         return;
@@ -127,6 +232,12 @@ MLInferenceThread::MLInferenceThread(
 
     capture.set(cv::CAP_PROP_FRAME_WIDTH, 320);
     capture.set(cv::CAP_PROP_FRAME_HEIGHT, 320);
+    if (replay_clock) {
+        // video time follows the file's frame rate, not target_fps
+        replay_clock->setFps(capture.get(cv::CAP_PROP_FPS));
+        std::cout << "Replaying " << source_name << " at " << 1.0 / replay_clock->frameSeconds() << " fps"
+                  << std::endl;
+    }
 
     if (!capture.isOpened()) {
         printf("Failed to open capture\n");
@@ -135,18 +246,31 @@ MLInferenceThread::MLInferenceThread(
 
 }
 
+// Stage latencies are recorded as they happen; this publishes the rest once per frame
+void MLInferenceThread::updateFrameMetrics() {
+    frame_metrics.frames.add();
+    frame_metrics.tracks.set(tracker.getTracks().size());
+    const auto& g = gate.getStats();
+    frame_metrics.asr_triggers.set(g.triggers);
+    frame_metrics.empty_transcripts.set(g.empty_transcripts);
+    frame_metrics.avoided_glance.set(g.avoided_glance);
+    frame_metrics.avoided_cooldown.set(g.avoided_cooldown);
+    frame_metrics.avoided_repeat.set(g.avoided_repeat);
+}
+
 MLInferenceThread::~MLInferenceThread() {
-    auto ret = release_retinaface_model(&rknn_app_ctx);
+    auto ret = release_retinaface_model(&retinaface_ctx);
     if (ret != 0) {
         printf("release_retinaface_model fail! ret=%d\n", ret);
     }  
+    release_retinaface_result(&face_result);
 
     running = false;
-    jsonResultQueue.signalShutdown();
-    bsvarResultQueue.signalShutdown();
+    results.signalShutdown();
 }
 
 void MLInferenceThread::operator()() {
+    tracer().setThreadName("inference");
     while (running) {
         if (!capture.isOpened()) {
             printf("Capture is not opened\n");
@@ -156,9 +280,14 @@ void MLInferenceThread::operator()() {
         auto frame_start_time = std::chrono::steady_clock::now();
         
         cv::Mat captured_img;
+        auto capture_start = std::chrono::steady_clock::now();
         try {
             if (!capture.read(captured_img)) {
-                printf("Failed to read frame from capture\n");
+                if (replay_clock) {
+                    printf("Replay video ended after %lld frames\n", (long long)replay_clock->getFrames());
+                } else {
+                    printf("Failed to read frame from capture\n");
+                }
                 break;
             }
 
@@ -182,25 +311,64 @@ void MLInferenceThread::operator()() {
             printf("Failed to read frame due to unknown exception!\n");
             break;
         }
+        frame_metrics.capture.recordSince(capture_start);
 
         InferenceResult result = runInference(captured_img);
-        //jsonResultQueue.push(std::move(result));
-        //bsvarResultQueue.push(std::move(result));
-	if(result.num_faces_attending > 0 && !asr_busy)
-	{
-	    std::unique_lock<std::mutex> lock(gaze_mutex);
-            trigger_asr = true;
-            asr_busy = true;
-            current_faces_attending = result.num_faces_attending;
-            current_total_faces = result.count_all_faces_in_frame;  
-            gaze_cv.notify_one();
-	}
+        // session outcomes from the ASR thread
+        Event event;
+        while (asr_events.tryPop(event)) {
+            if (event.type == EventType::TranscriptReady) {
+                gate.asrFinished(event.transcript_empty);
+            }
+        }
+        int trigger_track = gate.update(tracker.getTracks(), tracker.getConfig(), frame_dt);
+        if (trigger_track >= 0) {
+            std::cout << "Track " << trigger_track << " attending, starting ASR" << std::endl;
+            // the interaction starts when the track began attending
+            uint64_t trace_id = tracer().newTraceId();
+            auto now = std::chrono::steady_clock::now();
+            auto attended = std::chrono::duration<double>(gate.getAttendSeconds(trigger_track));
+            tracer().complete("dwell", trace_id,
+                              now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(attended), now);
+            Event gaze{EventType::GazeStarted};
+            gaze.track_id = trigger_track;
+            gaze.trace_id = trace_id;
+            gaze.faces.assign(result);
+            if (replay_clock) {
+                replay_clock->sessionStarted();
+            }
+            events.publish(gaze);
+        }
+        if (result.count_all_faces_in_frame >= 0) {
+            bool attending = result.num_faces_attending > 0;
+            if (gaze_active && !attending) {
+                Event ended{EventType::GazeEnded};
+                ended.faces.assign(result);
+                events.publish(ended);
+            }
+            gaze_active = attending;
+        }
+        // face-count-only updates, rate-limited here and coalesced by each publisher;
+        // dropped rather than stalling the video when a publisher is a full ring behind
+        face_update_age += frame_dt;
+        if (result.count_all_faces_in_frame >= 0 && face_update_age >= FACE_UPDATE_SECONDS) {
+            face_update_age = 0;
+            results.tryPublish(std::move(result));
+        }
         // release opencv image
+        auto jpeg_start = std::chrono::steady_clock::now();
         cv::imwrite("/tmp/out.jpg", captured_img);
         captured_img.release();
         // rename the file
         std::rename("/tmp/out.jpg", "/tmp/output.jpg");
+        frame_metrics.jpeg.recordSince(jpeg_start);
+        updateFrameMetrics();
 
+        if (replay_clock) {
+            // virtual time: run as fast as the pipeline allows
+            replay_clock->advanceFrame();
+            continue;
+        }
         auto current_time = std::chrono::steady_clock::now();
         auto frame_duration = std::chrono::duration_cast<std::chrono::microseconds>
             (current_time - frame_start_time);
@@ -213,4 +381,7 @@ void MLInferenceThread::operator()() {
             std::this_thread::sleep_for(sleep_time);
         }
     }
+    if (replay_clock) {
+        replay_clock->videoEnded();
+    }
 }
@@ -0,0 +1,63 @@
+#include "inference_backend.h"
+
+#include <stdio.h>
+
+static bool ends_with(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::unique_ptr<InferenceBackend> loadInferenceBackend(const std::string& model_path) {
+    std::unique_ptr<InferenceBackend> backend;
+    if (ends_with(model_path, ".onnx")) {
+#ifdef BSEXT_WITH_ONNXRUNTIME
+        backend = makeOnnxRuntimeBackend();
+#else
+        printf("%s needs ONNX Runtime, rebuild with -DWITH_ONNXRUNTIME=ON\n", model_path.c_str());
+        return nullptr;
+#endif
+    } else {
+        backend = makeRknnBackend();
+    }
+    if (backend->load(model_path) < 0) {
+        printf("%s backend cannot load %s\n", backend->name(), model_path.c_str());
+        return nullptr;
+    }
+    printf("%s: %s backend, %d inputs, %d outputs\n", model_path.c_str(), backend->name(),
+           backend->numInputs(), backend->numOutputs());
+    return backend;
+}
+
+const char* tensorTypeName(TensorType type) {
+    switch (type) {
+    case TensorType::Float32: return "FP32";
+    case TensorType::Float16: return "FP16";
+    case TensorType::Int8: return "INT8";
+    case TensorType::UInt8: return "UINT8";
+    case TensorType::Int32: return "INT32";
+    case TensorType::Int64: return "INT64";
+    default: return "OTHER";
+    }
+}
+
+size_t tensorTypeSize(TensorType type) {
+    switch (type) {
+    case TensorType::Float32: return 4;
+    case TensorType::Float16: return 2;
+    case TensorType::Int8: return 1;
+    case TensorType::UInt8: return 1;
+    case TensorType::Int32: return 4;
+    case TensorType::Int64: return 8;
+    default: return 0;
+    }
+}
+
+void printTensorAttr(const TensorAttr& attr) {
+    std::string dims;
+    for (int i = 0; i < attr.n_dims; i++) {
+        dims += (i ? ", " : "") + std::to_string(attr.dims[i]);
+    }
+    const char* fmt = attr.fmt == TensorFormat::NCHW ? "NCHW" : attr.fmt == TensorFormat::NHWC ? "NHWC" : "UNDEFINED";
+    printf("  index=%d, name=%s, n_dims=%d, dims=[%s], n_elems=%u, size=%u, fmt=%s, type=%s, qnt=%s, zp=%d, scale=%f\n",
+           attr.index, attr.name.c_str(), attr.n_dims, dims.c_str(), attr.n_elems, attr.size, fmt,
+           tensorTypeName(attr.type), attr.quantized ? "AFFINE" : "NONE", attr.zp, attr.scale);
+}
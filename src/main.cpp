@@ -1,12 +1,15 @@
 #include <chrono>
+#include <csignal>
 #include <memory>
 #include <sys/time.h>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -18,37 +21,63 @@
 #include "image_utils.h"
 #include "inference.h"
 #include "publisher.h"
-#include "queue.h"
 #include "retinaface.h"
 #include "utils.h"
 #include "asr.h"
-#include <mutex>
-#include <condition_variable>
+#include "audio_source.h"
+#include "event_bus.h"
+#include "subscription_server.h"
+#include "metrics_server.h"
+#include "replay.h"
+#include "trace.h"
 
 std::atomic<bool> running{true};
-ThreadSafeQueue<InferenceResult> jsonResultQueue(1);
-ThreadSafeQueue<InferenceResult> bsvarResultQueue(1);
+// every result is stored once and read by every publisher
+ResultRing results(RESULT_RING_CAPACITY);
 
-std::atomic<bool> asr_trigger{false};
-std::mutex gaze_mutex;
-std::condition_variable gaze_cv;
-bool trigger_asr = false;
-std::atomic<bool> asr_busy{false};
-std::atomic<int> current_faces_attending{0};
-std::atomic<int> current_total_faces{0};
+EventBus event_bus;
 
 void signalHandler(int signum) {
     std::cout << "Interrupt signal (" << signum << ") received.\n";
 
     // Cleanup and shutdown
     running = false;
-    jsonResultQueue.signalShutdown();
-    bsvarResultQueue.signalShutdown();
+    event_bus.shutdown();
+    results.signalShutdown();
+}
+
+// set by SIGUSR1; the main loop writes the trace ring to TRACE_DUMP_PATH
+std::atomic<bool> dump_trace{false};
+
+void traceSignalHandler(int) {
+    dump_trace = true;
+}
+
+// Lets the sinks send what a finished replay published before shutdown
+static void drainPublishers(const std::vector<std::unique_ptr<Publisher>>& publishers,
+                            SubscriptionServer* subscription_server) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(REPLAY_DRAIN_SECONDS);
+    while (std::chrono::steady_clock::now() < deadline) {
+        bool behind = subscription_server && subscription_server->getLagStats().lag > 0;
+        for (auto& publisher : publishers) {
+            behind = behind || publisher->getLagStats().lag > 0;
+        }
+        if (!behind) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    // results read but still waiting for a rate-limit token
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
 }
 
 int main(int argc, char **argv) {
-    if (argc != 8) {
-        printf("Usage: %s <retinaface_model> <whisper_encoder> <whisper_decoder> <mel_filters> <vocabulary> <source> <audio_device>\n", argv[0]);
+    const char* usage = "Usage: %s <retinaface_model> <whisper_encoder> <whisper_decoder> <mel_filters> <vocabulary> "
+                        "<source> <audio_device> [max_faces] [--sink <format>=<transport>:<address>]... "
+                        "[--subscription-socket <path>|none] [--asr-partial-ms <ms>] "
+                        "[--metrics tcp:<ip>:<port>|unix:<path>|none] [--replay <audio_script>]\n";
+    if (argc < 8) {
+        printf(usage, argv[0]);
         return -1;
     }
     // The path where the model is located
@@ -60,6 +89,59 @@ int main(int argc, char **argv) {
     std::string source_name = argv[6];
     //USB Mic device
     std::string audio_device = "plug" + std::string(argv[7]);
+    // optional cap on faces reported per frame
+    int max_faces = RETINAFACE_DEFAULT_MAX_FACES;
+    int arg = 8;
+    if (arg < argc && strncmp(argv[arg], "--", 2) != 0) {
+        max_faces = atoi(argv[arg]);
+        if (max_faces <= 0) {
+            printf("Invalid max_faces %s\n", argv[arg]);
+            return -1;
+        }
+        arg++;
+    }
+    // result sinks, see makePublisher(); the UDP ports below unless given
+    std::vector<std::string> sinks;
+    // local clients subscribe here, see SubscriptionServer
+    std::string subscription_socket = SUBSCRIPTION_DEFAULT_PATH;
+    // partial transcript cadence while the viewer speaks, 0 for final transcripts only
+    int asr_partial_ms = ASR_PARTIAL_INTERVAL_MS;
+    // Prometheus scrape endpoint, see MetricsServer
+    std::string metrics_endpoint = METRICS_DEFAULT_ENDPOINT;
+    // replay: source is a video file and audio comes from this script, see ReplayClock
+    std::string replay_script;
+    for (; arg < argc; ++arg) {
+        if (arg + 1 == argc) {
+            printf(usage, argv[0]);
+            return -1;
+        }
+        if (strcmp(argv[arg], "--sink") == 0) {
+            sinks.push_back(argv[++arg]);
+        } else if (strcmp(argv[arg], "--subscription-socket") == 0) {
+            subscription_socket = argv[++arg];
+        } else if (strcmp(argv[arg], "--metrics") == 0) {
+            metrics_endpoint = argv[++arg];
+        } else if (strcmp(argv[arg], "--replay") == 0) {
+            replay_script = argv[++arg];
+        } else if (strcmp(argv[arg], "--asr-partial-ms") == 0) {
+            asr_partial_ms = atoi(argv[++arg]);
+            if (asr_partial_ms < 0) {
+                printf("Invalid --asr-partial-ms %s\n", argv[arg]);
+                return -1;
+            }
+        } else {
+            printf(usage, argv[0]);
+            return -1;
+        }
+    }
+    bool subscriptions = subscription_socket != "none";
+    if (sinks.empty()) {
+        sinks = {"json=udp:127.0.0.1:5002", "bsvar=udp:127.0.0.1:5000"};
+    }
+    if ((int)sinks.size() + subscriptions > ResultRing::MAX_CONSUMERS) {
+        printf("At most %d sinks\n", ResultRing::MAX_CONSUMERS - subscriptions);
+        return -1;
+    }
     
     std::cout << "Model files:" << std::endl;
     std::cout << "RetinaFace: " << retinaface_model << std::endl;
@@ -70,70 +152,125 @@ int main(int argc, char **argv) {
     std::cout << "Source: " << source_name << std::endl;
     std::cout << "Audio Device: " << audio_device << std::endl;
 
-    MLInferenceThread mlThread(
-	retinaface_model,
-	source_name,
-	jsonResultQueue,
-	bsvarResultQueue,
-	gaze_mutex,
-	gaze_cv,
-	trigger_asr,
-	asr_busy,
-    current_faces_attending,
-    current_total_faces,
-	running,
-	30);
-
-    auto json_formatter = std::make_shared<JsonMessageFormatter>();
-    UDPPublisher json_publisher(
-        "127.0.0.1",
-        5002,
-        jsonResultQueue,
-        running,
-        json_formatter,
-        1000);
-    auto bsvar_formatter = std::make_shared<BSVariableMessageFormatter>();
-    UDPPublisher bsvar_publisher(
-        "127.0.0.1",
-        5000,
-        bsvarResultQueue,
-        running,
-        bsvar_formatter,
-        10);
-    ASRThread asrThread(
-        whisper_encoder_model,
-        whisper_decoder_model,
-        mel_filters_path,
-        vocabulary_path,
-        jsonResultQueue,
-	    bsvarResultQueue,
-	    running,
-	    asr_trigger,
-	    gaze_mutex,
-	    gaze_cv,
-	    trigger_asr,
-	    asr_busy,
-        current_faces_attending,
-        current_total_faces,
-	    audio_device);
-
-    std::thread inferenceThread(std::ref(mlThread));
-    std::thread asr_thread_handle(std::ref(asrThread));
-    std::thread json_publisherThread(std::ref(json_publisher));
-    std::thread bsvar_publisherThread(std::ref(bsvar_publisher));
+    std::unique_ptr<ReplayClock> replay_clock;
+    std::unique_ptr<AudioSource> audio_source;
+    if (replay_script.empty()) {
+        audio_source = std::make_unique<AlsaAudioSource>(audio_device);
+    } else {
+        try {
+            std::vector<ReplayClip> clips = loadReplayScript(replay_script);
+            replay_clock = std::make_unique<ReplayClock>();
+            audio_source = std::make_unique<ReplayAudioSource>(std::move(clips), *replay_clock,
+                                                               "replay:" + replay_script);
+        } catch (const std::exception& e) {
+            printf("%s\n", e.what());
+            return -1;
+        }
+    }
 
+    // subscribe() throws once the event bus has no mailbox left
+    std::unique_ptr<MLInferenceThread> mlThread;
+    std::unique_ptr<ASRThread> asrThread;
+    std::vector<std::unique_ptr<Publisher>> publishers;
+    std::unique_ptr<SubscriptionServer> subscription_server;
+    std::unique_ptr<MetricsServer> metrics_server;
+    try {
+        mlThread = std::make_unique<MLInferenceThread>(
+            retinaface_model,
+            source_name,
+            results,
+            event_bus,
+            running,
+            30,
+            max_faces,
+            replay_clock.get());
+        for (const std::string& sink : sinks) {
+            publishers.push_back(makePublisher(sink, results, running));
+            std::cout << "Sink: " << sink << std::endl;
+        }
+        if (subscriptions) {
+            subscription_server = std::make_unique<SubscriptionServer>(subscription_socket, results, running);
+            std::cout << "Subscription socket: " << subscription_socket << std::endl;
+        }
+        metrics_server = std::make_unique<MetricsServer>(metrics_endpoint, running);
+        asrThread = std::make_unique<ASRThread>(
+            whisper_encoder_model,
+            whisper_decoder_model,
+            mel_filters_path,
+            vocabulary_path,
+            results,
+            running,
+            event_bus,
+            std::move(audio_source),
+            SAMPLE_RATE,
+            CHANNELS,
+            3,
+            asr_partial_ms,
+            replay_clock.get());
+    } catch (const std::exception& e) {
+        printf("%s\n", e.what());
+        return -1;
+    }
+
+    std::thread inferenceThread(std::ref(*mlThread));
+    std::thread asr_thread_handle(std::ref(*asrThread));
+    std::vector<std::thread> publisherThreads;
+    for (auto& publisher : publishers) {
+        publisherThreads.emplace_back(std::ref(*publisher));
+    }
+    if (subscription_server) {
+        publisherThreads.emplace_back(std::ref(*subscription_server));
+    }
+    std::thread metrics_thread(std::ref(*metrics_server));
+
+    signal(SIGUSR1, traceSignalHandler);
+    auto run_start = std::chrono::steady_clock::now();
     while (running) {
+        if (replay_clock && replay_clock->finished()) {
+            drainPublishers(publishers, subscription_server.get());
+            break;
+        }
         std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (dump_trace.exchange(false)) {
+            if (tracer().dump(TRACE_DUMP_PATH)) {
+                std::cout << "Trace written to " << TRACE_DUMP_PATH << std::endl;
+            } else {
+                std::cout << "Cannot write trace to " << TRACE_DUMP_PATH << std::endl;
+            }
+        }
     }
 
     // Cleanup and shutdown
     running = false;
-    jsonResultQueue.signalShutdown();
-    bsvarResultQueue.signalShutdown();
+    event_bus.shutdown();
+    results.signalShutdown();
+    if (replay_clock) {
+        replay_clock->stop();
+    }
 
     inferenceThread.join();
-    json_publisherThread.join();
-    bsvar_publisherThread.join();
+    asr_thread_handle.join();
+    for (auto& thread : publisherThreads) {
+        thread.join();
+    }
+    metrics_thread.join();
+    printf("result ring: producer stalls=%llu, face updates dropped=%llu\n", (unsigned long long)results.getStalls(),
+           (unsigned long long)results.getDrops());
+    for (auto& publisher : publishers) {
+        printf("  %s max lag=%llu\n", publisher->getName().c_str(),
+               (unsigned long long)publisher->getLagStats().max_lag);
+    }
+    if (subscription_server) {
+        printf("  subscriptions %s max lag=%llu\n", subscription_socket.c_str(),
+               (unsigned long long)subscription_server->getLagStats().max_lag);
+    }
+    if (replay_clock) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+        printf("replay: %lld frames, %.1f s of video in %.1f s (%.2fx real time)\n",
+               (long long)replay_clock->getFrames(), replay_clock->videoSeconds(), elapsed,
+               replay_clock->videoSeconds() / elapsed);
+        printf("%s\n", metrics().closeWindow(elapsed).c_str());
+    }
 
     return 0;
 }
@@ -0,0 +1,101 @@
+#include "message_formatter.h"
+
+#include <chrono>
+#include <cmath>
+
+// Implementation of the JsonMessageFormatter
+void JsonMessageFormatter::formatMessage(const InferenceResult& result, std::string& out) {
+    MessageWriter w(out);
+    w.raw("{\"ASR\":");
+    w.jsonString(result.asr);
+    w.raw(",\"faces\":[");
+    for (size_t i = 0; i < result.faces.size(); ++i) {
+        const FacePose& face = result.faces[i];
+        if (i > 0) {
+            w.raw(',');
+        }
+        w.raw("{\"attending\":");
+        w.boolean(face.attending);
+        w.raw(",\"id\":");
+        w.integer(face.id);
+        w.raw(",\"pitch\":");
+        w.fixed1(face.pitch);
+        w.raw(",\"roll\":");
+        w.fixed1(face.roll);
+        w.raw(",\"yaw\":");
+        w.fixed1(face.yaw);
+        w.raw('}');
+    }
+    w.raw("],\"faces_attending\":");
+    w.integer(result.num_faces_attending);
+    w.raw(",\"faces_in_frame_total\":");
+    w.integer(result.count_all_faces_in_frame);
+    w.raw(",\"is_final\":");
+    w.boolean(result.is_final);
+    w.raw(",\"timestamp\":");
+    w.integer(std::chrono::system_clock::to_time_t(result.timestamp));
+    w.raw(",\"trace_id\":");
+    w.integer(result.trace_id);
+    w.raw('}');
+}
+
+// Implementation of the BSVariableMessageFormatter
+void BSVariableMessageFormatter::formatMessage(const InferenceResult& result, std::string& out) {
+    // format the message as a string like faces_attending:0!!faces_in_frame_total:0!!ASR:!!is_final:false!!timestamp:1746732409!!trace_id:0
+    MessageWriter w(out);
+    w.raw("faces_attending:");
+    w.integer(result.num_faces_attending);
+    w.raw("!!faces_in_frame_total:");
+    w.integer(result.count_all_faces_in_frame);
+    w.raw("!!ASR:");
+    w.raw(result.asr);
+    w.raw("!!is_final:");
+    w.boolean(result.is_final);
+    w.raw("!!timestamp:");
+    w.integer(std::chrono::system_clock::to_time_t(result.timestamp));
+    w.raw("!!trace_id:");
+    w.integer(result.trace_id);
+}
+
+// Implementation of the BinaryMessageFormatter
+void BinaryMessageFormatter::formatMessage(const InferenceResult& result, std::string& out) {
+    MessageWriter w(out);
+    w.byte(WIRE_MAGIC_0);
+    w.byte(WIRE_MAGIC_1);
+    w.byte(WIRE_VERSION);
+    w.byte((result.asr.empty() ? 0 : WIRE_FLAG_TRANSCRIPT) | (result.is_final ? WIRE_FLAG_FINAL : 0));
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(result.timestamp.time_since_epoch());
+    w.varint(ms.count());
+    w.zigzag(result.count_all_faces_in_frame);
+    w.zigzag(result.num_faces_attending);
+    w.varint(result.faces.size());
+    for (const FacePose& face : result.faces) {
+        bool pose = std::isfinite(face.yaw) && std::isfinite(face.pitch) && std::isfinite(face.roll);
+        w.zigzag(face.id);
+        w.byte((face.attending ? WIRE_FACE_ATTENDING : 0) | (pose ? WIRE_FACE_POSE : 0));
+        if (pose) {
+            // tenths of a degree, the precision of the JSON output
+            w.zigzag(std::lround(face.yaw * 10));
+            w.zigzag(std::lround(face.pitch * 10));
+            w.zigzag(std::lround(face.roll * 10));
+        }
+    }
+    if (!result.asr.empty()) {
+        w.utf8String(result.asr);
+    }
+    // appended after the transcript, so version 1 readers that predate it skip it
+    w.varint(result.trace_id);
+}
+
+std::shared_ptr<MessageFormatter> makeMessageFormatter(const std::string& format) {
+    if (format == "json") {
+        return std::make_shared<JsonMessageFormatter>();
+    }
+    if (format == "bsvar") {
+        return std::make_shared<BSVariableMessageFormatter>();
+    }
+    if (format == "binary") {
+        return std::make_shared<BinaryMessageFormatter>();
+    }
+    return nullptr;
+}
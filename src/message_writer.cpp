@@ -0,0 +1,148 @@
+#include "message_writer.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
+void MessageWriter::integer(int64_t value) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, res.ptr - buf);
+}
+
+void MessageWriter::fixed1(float value) {
+    if (!std::isfinite(value)) {
+        raw("null");
+        return;
+    }
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%.1f", value);
+    out.append(buf, n);
+}
+
+// Length of the valid UTF-8 sequence starting at s[0], 0 if invalid
+static size_t utf8_sequence(const unsigned char* s, size_t left) {
+    unsigned char c = s[0];
+    size_t len;
+    uint32_t min;
+    if (c < 0x80) {
+        return 1;
+    } else if ((c & 0xe0) == 0xc0) {
+        len = 2;
+        min = 0x80;
+    } else if ((c & 0xf0) == 0xe0) {
+        len = 3;
+        min = 0x800;
+    } else if ((c & 0xf8) == 0xf0) {
+        len = 4;
+        min = 0x10000;
+    } else {
+        return 0;
+    }
+    if (left < len) {
+        return 0;
+    }
+    uint32_t cp = c & (0x7f >> len);
+    for (size_t i = 1; i < len; ++i) {
+        if ((s[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (s[i] & 0x3f);
+    }
+    // overlong forms, surrogates and out of range code points
+    if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+        return 0;
+    }
+    return len;
+}
+
+void MessageWriter::jsonString(std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char* s = (const unsigned char*)text.data();
+    size_t n = text.size();
+    out.push_back('"');
+    size_t i = 0;
+    while (i < n) {
+        // copy runs of plain characters in one append
+        size_t run = i;
+        while (run < n && s[run] >= 0x20 && s[run] < 0x80 && s[run] != '"' && s[run] != '\\') {
+            run++;
+        }
+        out.append((const char*)s + i, run - i);
+        i = run;
+        if (i == n) {
+            break;
+        }
+        unsigned char c = s[i];
+        if (c >= 0x80) {
+            size_t len = utf8_sequence(s + i, n - i);
+            if (len == 0) {
+                raw("\\ufffd");
+                i++;
+            } else {
+                out.append((const char*)s + i, len);
+                i += len;
+            }
+            continue;
+        }
+        switch (c) {
+        case '"': raw("\\\""); break;
+        case '\\': raw("\\\\"); break;
+        case '\b': raw("\\b"); break;
+        case '\f': raw("\\f"); break;
+        case '\n': raw("\\n"); break;
+        case '\r': raw("\\r"); break;
+        case '\t': raw("\\t"); break;
+        default: {
+            char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            out.append(esc, sizeof(esc));
+        }
+        }
+        i++;
+    }
+    out.push_back('"');
+}
+
+void MessageWriter::varint(uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+static const char REPLACEMENT[] = "\xef\xbf\xbd";    // U+FFFD
+
+void MessageWriter::utf8String(std::string_view text) {
+    const unsigned char* s = (const unsigned char*)text.data();
+    size_t n = text.size();
+    // first pass sizes the prefix, the second copies
+    size_t length = 0;
+    bool valid = true;
+    for (size_t i = 0; i < n;) {
+        size_t len = utf8_sequence(s + i, n - i);
+        if (len == 0) {
+            length += sizeof(REPLACEMENT) - 1;
+            valid = false;
+            i++;
+        } else {
+            length += len;
+            i += len;
+        }
+    }
+    varint(length);
+    if (valid) {
+        raw(text);
+        return;
+    }
+    for (size_t i = 0; i < n;) {
+        size_t len = utf8_sequence(s + i, n - i);
+        if (len == 0) {
+            out.append(REPLACEMENT, sizeof(REPLACEMENT) - 1);
+            i++;
+        } else {
+            out.append((const char*)s + i, len);
+            i += len;
+        }
+    }
+}
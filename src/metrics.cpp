@@ -0,0 +1,238 @@
+#include "metrics.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+int Histogram::bucketIndex(uint64_t ns) {
+    if (ns < (uint64_t)HISTOGRAM_SUB_BUCKETS) {
+        return (int)ns;
+    }
+    int exponent = 63 - __builtin_clzll(ns);
+    if (exponent >= HISTOGRAM_MAX_BITS) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    int sub = (int)((ns >> (exponent - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+    return (exponent - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::bucketUpper(int index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    int exponent = index / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BITS - 1;
+    int sub = index % HISTOGRAM_SUB_BUCKETS;
+    uint64_t width = 1ull << (exponent - HISTOGRAM_SUB_BITS);
+    return (uint64_t)(HISTOGRAM_SUB_BUCKETS + sub) * width + width - 1;
+}
+
+void Histogram::snapshot(HistogramSnapshot& out) const {
+    out.count = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        out.counts[i] = buckets[i].load(std::memory_order_relaxed);
+        out.count += out.counts[i];
+    }
+    out.sum_ns = sum_ns.load(std::memory_order_relaxed);
+}
+
+uint64_t HistogramSnapshot::quantileNs(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)std::ceil(q * count);
+    rank = rank < 1 ? 1 : rank;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return Histogram::bucketUpper(i);
+        }
+    }
+    return Histogram::bucketUpper(HISTOGRAM_BUCKETS - 1);
+}
+
+// "bsext_stage_seconds" + stage="npu" -> "stage/npu", "bsext_frames_total" -> "frames"
+static std::string make_log_key(const std::string& name, const std::string& labels) {
+    std::string key = name;
+    if (key.compare(0, 6, "bsext_") == 0) {
+        key.erase(0, 6);
+    }
+    for (const char* suffix : {"_total", "_seconds"}) {
+        size_t n = strlen(suffix);
+        if (key.size() > n && key.compare(key.size() - n, n, suffix) == 0) {
+            key.erase(key.size() - n);
+        }
+    }
+    size_t pos = 0;
+    while ((pos = labels.find('"', pos)) != std::string::npos) {
+        size_t end = labels.find('"', pos + 1);
+        if (end == std::string::npos) {
+            break;
+        }
+        key += "/" + labels.substr(pos + 1, end - pos - 1);
+        pos = end + 1;
+    }
+    return key;
+}
+
+MetricsRegistry::Entry& MetricsRegistry::find(Kind kind, const std::string& name, const std::string& help,
+                                              const std::string& labels) {
+    for (Entry& entry : entries) {
+        if (entry.kind == kind && entry.name == name && entry.labels == labels) {
+            return entry;
+        }
+    }
+    entries.emplace_back();
+    Entry& entry = entries.back();
+    entry.kind = kind;
+    entry.name = name;
+    entry.help = help;
+    entry.labels = labels;
+    entry.log_key = make_log_key(name, labels);
+    return entry;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = find(Kind::Counter, name, help, labels);
+    if (!entry.counter) {
+        counters.emplace_back();
+        entry.counter = &counters.back();
+    }
+    return *entry.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = find(Kind::Gauge, name, help, labels);
+    if (!entry.gauge) {
+        gauges.emplace_back();
+        entry.gauge = &gauges.back();
+    }
+    return *entry.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = find(Kind::Histogram, name, help, labels);
+    if (!entry.histogram) {
+        histograms.emplace_back();
+        entry.histogram = &histograms.back();
+        entry.last.reset(new HistogramSnapshot());
+        entry.window.reset(new HistogramSnapshot());
+    }
+    return *entry.histogram;
+}
+
+static void append_sample(std::string& out, const std::string& name, const std::string& labels,
+                          const std::string& extra, const char* value) {
+    out += name;
+    if (!labels.empty() || !extra.empty()) {
+        out += '{';
+        out += labels;
+        out += (!labels.empty() && !extra.empty()) ? "," : "";
+        out += extra;
+        out += '}';
+    }
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+
+void MetricsRegistry::writePrometheus(std::string& out) {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<bool> written(entries.size(), false);
+    HistogramSnapshot total;
+    char value[64];
+    // samples of one name are grouped under a single HELP and TYPE
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (written[i]) {
+            continue;
+        }
+        const Entry& first = entries[i];
+        const char* type = first.kind == Kind::Counter ? "counter" : first.kind == Kind::Gauge ? "gauge" : "summary";
+        out += "# HELP " + first.name + " " + first.help + "\n";
+        out += "# TYPE " + first.name + " " + type + "\n";
+        for (size_t j = i; j < entries.size(); ++j) {
+            const Entry& entry = entries[j];
+            if (written[j] || entry.name != first.name || entry.kind != first.kind) {
+                continue;
+            }
+            written[j] = true;
+            if (entry.kind == Kind::Counter) {
+                snprintf(value, sizeof(value), "%llu", (unsigned long long)entry.counter->get());
+                append_sample(out, entry.name, entry.labels, "", value);
+            } else if (entry.kind == Kind::Gauge) {
+                snprintf(value, sizeof(value), "%lld", (long long)entry.gauge->get());
+                append_sample(out, entry.name, entry.labels, "", value);
+            } else {
+                for (double q : quantiles) {
+                    if (entry.window->count == 0) {
+                        snprintf(value, sizeof(value), "NaN");
+                    } else {
+                        snprintf(value, sizeof(value), "%.9g", entry.window->quantileNs(q) / 1e9);
+                    }
+                    char quantile[32];
+                    snprintf(quantile, sizeof(quantile), "quantile=\"%g\"", q);
+                    append_sample(out, entry.name, entry.labels, quantile, value);
+                }
+                entry.histogram->snapshot(total);
+                snprintf(value, sizeof(value), "%.9g", total.sum_ns / 1e9);
+                append_sample(out, entry.name + "_sum", entry.labels, "", value);
+                snprintf(value, sizeof(value), "%llu", (unsigned long long)total.count);
+                append_sample(out, entry.name + "_count", entry.labels, "", value);
+            }
+        }
+    }
+}
+
+// e.g. "metrics 60s (p50/p99 ms/count): stage/npu=12.1/14.3/900 ... frames=+1800 tracks=2"
+std::string MetricsRegistry::closeWindow(double elapsed_seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    char buf[160];
+    snprintf(buf, sizeof(buf), "metrics %.0fs (p50/p99 ms/count):", elapsed_seconds);
+    std::string line = buf;
+    HistogramSnapshot now;
+    for (Entry& entry : entries) {
+        if (entry.kind == Kind::Histogram) {
+            entry.histogram->snapshot(now);
+            HistogramSnapshot& window = *entry.window;
+            for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+                window.counts[i] = now.counts[i] - entry.last->counts[i];
+            }
+            window.count = now.count - entry.last->count;
+            window.sum_ns = now.sum_ns - entry.last->sum_ns;
+            *entry.last = now;
+            if (window.count == 0) {
+                continue;
+            }
+            snprintf(buf, sizeof(buf), " %s=%.3g/%.3g/%llu", entry.log_key.c_str(), window.quantileNs(0.5) / 1e6,
+                     window.quantileNs(0.99) / 1e6, (unsigned long long)window.count);
+            line += buf;
+        } else if (entry.kind == Kind::Counter) {
+            uint64_t value = entry.counter->get();
+            uint64_t delta = value - entry.last_count;
+            entry.last_count = value;
+            if (delta == 0) {
+                continue;
+            }
+            snprintf(buf, sizeof(buf), " %s=+%llu", entry.log_key.c_str(), (unsigned long long)delta);
+            line += buf;
+        } else {
+            snprintf(buf, sizeof(buf), " %s=%lld", entry.log_key.c_str(), (long long)entry.gauge->get());
+            line += buf;
+        }
+    }
+    return line;
+}
+
+MetricsRegistry& metrics() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+Histogram& stageHistogram(const std::string& stage) {
+    return metrics().histogram("bsext_stage_seconds", "Latency of one run of a pipeline stage",
+                               "stage=\"" + stage + "\"");
+}
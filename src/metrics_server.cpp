@@ -0,0 +1,154 @@
+#include "metrics_server.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+MetricsServer::MetricsServer(const std::string& endpoint, std::atomic<bool>& isRunning)
+    : endpoint(endpoint), running(isRunning) {
+    if (endpoint == "none") {
+        return;
+    }
+    size_t colon = endpoint.find(':');
+    std::string transport = endpoint.substr(0, colon);
+    std::string address = colon == std::string::npos ? "" : endpoint.substr(colon + 1);
+    if (transport == "tcp") {
+        size_t port_colon = address.rfind(':');
+        int port = port_colon == std::string::npos ? 0 : atoi(address.c_str() + port_colon + 1);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (port <= 0 || port > 65535 || inet_pton(AF_INET, address.substr(0, port_colon).c_str(), &addr.sin_addr) != 1) {
+            throw std::invalid_argument("Metrics endpoint needs tcp:<ip>:<port>: " + endpoint);
+        }
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0) {
+            throw std::runtime_error("Socket creation failed");
+        }
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 4) < 0) {
+            close(listen_fd);
+            throw std::runtime_error("Cannot listen on " + endpoint + ": " + strerror(errno));
+        }
+    } else if (transport == "unix") {
+        struct sockaddr_un addr;
+        if (address.empty() || address.size() >= sizeof(addr.sun_path)) {
+            throw std::invalid_argument("Unix socket path too long: " + address);
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, address.c_str(), address.size());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0) {
+            throw std::runtime_error("Socket creation failed");
+        }
+        // a socket file left by a previous run would make bind fail
+        unlink(address.c_str());
+        if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 4) < 0) {
+            close(listen_fd);
+            throw std::runtime_error("Cannot listen on " + endpoint + ": " + strerror(errno));
+        }
+        unix_path = address;
+    } else {
+        throw std::invalid_argument("Unknown metrics endpoint (tcp:<ip>:<port>, unix:<path>, none): " + endpoint);
+    }
+}
+
+MetricsServer::~MetricsServer() {
+    if (listen_fd >= 0) {
+        close(listen_fd);
+    }
+    if (!unix_path.empty()) {
+        unlink(unix_path.c_str());
+    }
+}
+
+// One request per connection; a scraper that stalls for a second is dropped
+void MetricsServer::serve(int fd) {
+    struct timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    char request[2048];
+    size_t length = 0;
+    while (length < sizeof(request) - 1) {
+        ssize_t n = recv(fd, request + length, sizeof(request) - 1 - length, 0);
+        if (n <= 0) {
+            return;
+        }
+        length += n;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) {
+            break;
+        }
+    }
+    request[length] = '\0';
+
+    std::string body;
+    const char* status = "200 OK";
+    const char* content_type = "text/plain; version=0.0.4";
+    if (strncmp(request, "GET / ", 6) == 0 || strncmp(request, "GET /metrics ", 13) == 0 ||
+        strncmp(request, "GET /metrics?", 13) == 0) {
+        metrics().writePrometheus(body);
+        scrapes++;
+    } else if (strncmp(request, "GET /trace ", 11) == 0) {
+        tracer().writeChromeJson(body);
+        content_type = "application/json";
+    } else {
+        status = "404 Not Found";
+        content_type = "text/plain";
+        body = "metrics are served at /metrics, traces at /trace\n";
+    }
+    response = "HTTP/1.0 ";
+    response += status;
+    response += "\r\nContent-Type: ";
+    response += content_type;
+    response += "\r\nContent-Length: ";
+    response += std::to_string(body.size());
+    response += "\r\nConnection: close\r\n\r\n";
+    response += body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        sent += n;
+    }
+}
+
+void MetricsServer::operator()() {
+    if (listen_fd >= 0) {
+        std::cout << "Metrics served on " << endpoint << std::endl;
+    }
+    last_report = std::chrono::steady_clock::now();
+    while (running) {
+        // the timeout paces the log line and the running check
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        int n = poll(&pfd, listen_fd >= 0 ? 1 : 0, 1000);
+        if (n > 0 && (pfd.revents & POLLIN)) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                serve(fd);
+                close(fd);
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_report).count();
+        if (elapsed >= METRICS_REPORT_SECONDS) {
+            printf("%s scrapes=%ld\n", metrics().closeWindow(elapsed).c_str(), scrapes);
+            scrapes = 0;
+            last_report = now;
+        }
+    }
+}
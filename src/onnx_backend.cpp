@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <future>
+
+#include <onnxruntime_cxx_api.h>
+
+#include "inference_backend.h"
+
+static TensorType from_onnx_type(ONNXTensorElementDataType type) {
+    switch (type) {
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT: return TensorType::Float32;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16: return TensorType::Float16;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8: return TensorType::Int8;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8: return TensorType::UInt8;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32: return TensorType::Int32;
+    case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64: return TensorType::Int64;
+    default: return TensorType::Other;
+    }
+}
+
+static ONNXTensorElementDataType to_onnx_type(TensorType type) {
+    switch (type) {
+    case TensorType::Float32: return ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT;
+    case TensorType::Float16: return ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16;
+    case TensorType::Int8: return ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8;
+    case TensorType::UInt8: return ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8;
+    case TensorType::Int32: return ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32;
+    case TensorType::Int64: return ONNX_TENSOR_ELEMENT_DATA_TYPE_INT64;
+    default: return ONNX_TENSOR_ELEMENT_DATA_TYPE_UNDEFINED;
+    }
+}
+
+// Every dimension must be fixed: the pipeline sizes its buffers and checks
+// output sizes from these attributes once, at load. A 4-D tensor with 1 or 3
+// channels on one side is an image.
+static int make_attr(int index, const std::string& name, const Ort::ConstTensorTypeAndShapeInfo& info, TensorAttr* attr) {
+    std::vector<int64_t> shape = info.GetShape();
+    if (shape.size() > (size_t)TENSOR_MAX_DIMS) {
+        printf("onnxruntime tensor %s: %zu dimensions, at most %d supported\n", name.c_str(), shape.size(),
+               TENSOR_MAX_DIMS);
+        return -1;
+    }
+    attr->index = index;
+    attr->name = name;
+    attr->type = from_onnx_type(info.GetElementType());
+    attr->n_dims = (int)shape.size();
+    attr->n_elems = 1;
+    for (int i = 0; i < attr->n_dims; i++) {
+        if (shape[i] <= 0) {
+            printf("onnxruntime tensor %s: dimension %d is dynamic (%lld); export the model with fixed shapes\n",
+                   name.c_str(), i, (long long)shape[i]);
+            return -1;
+        }
+        attr->dims[i] = shape[i];
+        attr->n_elems *= attr->dims[i];
+    }
+    attr->size = attr->n_elems * tensorTypeSize(attr->type);
+    if (attr->n_dims == 4 && (attr->dims[1] == 1 || attr->dims[1] == 3)) {
+        attr->fmt = TensorFormat::NCHW;
+    } else if (attr->n_dims == 4 && (attr->dims[3] == 1 || attr->dims[3] == 3)) {
+        attr->fmt = TensorFormat::NHWC;
+    }
+    return 0;
+}
+
+static Ort::Env& ort_env() {
+    static Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "bsext-voice");
+    return env;
+}
+
+/**
+ * @class OnnxRuntimeBackend
+ * @brief .onnx models on the CPU, for boards without an NPU and for workstations
+ *
+ * Takes the ONNX models the .rknn files are converted from. Those expect
+ * float input where the converted model takes uint8 images, so an image
+ * given as uint8 is normalized and laid out here, as the RKNN runtime does
+ * on the NPU. Outputs are whatever the model produces, float for the models
+ * this pipeline ships; want_float is not needed.
+ */
+class OnnxRuntimeBackend : public InferenceBackend {
+public:
+    ~OnnxRuntimeBackend() override;
+
+    int load(const std::string& model_path) override;
+    const char* name() const override { return "onnxruntime"; }
+
+    void setInputNormalization(int index, const float* mean, const float* stddev, int channels) override;
+    int setInput(int index, const void* data, uint32_t size, TensorType type, TensorFormat fmt) override;
+    int runAsync() override;
+    int wait() override;
+    int getOutputs(TensorOutput* outputs, int n) override;
+    void releaseOutputs(TensorOutput* outputs, int n) override;
+
+private:
+    int convertImage(int index, const uint8_t* data, uint32_t size, TensorFormat fmt);
+
+    Ort::Session session{nullptr};
+    Ort::MemoryInfo memory_info{Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault)};
+    std::vector<std::string> input_names;
+    std::vector<std::string> output_names;
+    std::vector<std::vector<uint8_t>> input_data;
+    std::vector<std::vector<float>> input_mean;
+    std::vector<std::vector<float>> input_std;
+    std::future<int> running;
+    std::vector<Ort::Value> results;
+};
+
+OnnxRuntimeBackend::~OnnxRuntimeBackend() {
+    if (running.valid()) {
+        running.wait();
+    }
+}
+
+int OnnxRuntimeBackend::load(const std::string& model_path) {
+    try {
+        Ort::SessionOptions options;
+        options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        session = Ort::Session(ort_env(), model_path.c_str(), options);
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        for (size_t i = 0; i < session.GetInputCount(); i++) {
+            input_names.push_back(session.GetInputNameAllocated(i, allocator).get());
+            Ort::TypeInfo type_info = session.GetInputTypeInfo(i);
+            input_attrs.emplace_back();
+            if (make_attr(i, input_names.back(), type_info.GetTensorTypeAndShapeInfo(), &input_attrs.back()) < 0) {
+                return -1;
+            }
+        }
+        for (size_t i = 0; i < session.GetOutputCount(); i++) {
+            output_names.push_back(session.GetOutputNameAllocated(i, allocator).get());
+            Ort::TypeInfo type_info = session.GetOutputTypeInfo(i);
+            output_attrs.emplace_back();
+            if (make_attr(i, output_names.back(), type_info.GetTensorTypeAndShapeInfo(), &output_attrs.back()) < 0) {
+                return -1;
+            }
+        }
+    } catch (const Ort::Exception& e) {
+        printf("onnxruntime load fail! %s\n", e.what());
+        return -1;
+    }
+    input_data.resize(input_attrs.size());
+    input_mean.resize(input_attrs.size());
+    input_std.resize(input_attrs.size());
+    return 0;
+}
+
+void OnnxRuntimeBackend::setInputNormalization(int index, const float* mean, const float* stddev, int channels) {
+    input_mean[index].assign(mean, mean + channels);
+    input_std[index].assign(stddev, stddev + channels);
+}
+
+int OnnxRuntimeBackend::convertImage(int index, const uint8_t* data, uint32_t size, TensorFormat fmt) {
+    const TensorAttr& attr = input_attrs[index];
+    bool nchw = attr.fmt == TensorFormat::NCHW;
+    int channels = nchw ? attr.dims[1] : attr.dims[3];
+    int height = nchw ? attr.dims[2] : attr.dims[1];
+    int width = nchw ? attr.dims[3] : attr.dims[2];
+    if (size != (uint32_t)(channels * height * width) || fmt == TensorFormat::Undefined) {
+        printf("onnxruntime input %d: %u bytes is not a %dx%dx%d image\n", index, size, width, height, channels);
+        return -1;
+    }
+    const std::vector<float>& mean = input_mean[index];
+    const std::vector<float>& stddev = input_std[index];
+    float* dst = (float*)input_data[index].data();
+    int plane = height * width;
+    for (int c = 0; c < channels; c++) {
+        float m = c < (int)mean.size() ? mean[c] : 0.f;
+        float inv_std = c < (int)stddev.size() && stddev[c] != 0.f ? 1.f / stddev[c] : 1.f;
+        for (int p = 0; p < plane; p++) {
+            uint8_t v = fmt == TensorFormat::NHWC ? data[p * channels + c] : data[c * plane + p];
+            dst[nchw ? c * plane + p : p * channels + c] = (v - m) * inv_std;
+        }
+    }
+    return 0;
+}
+
+int OnnxRuntimeBackend::setInput(int index, const void* data, uint32_t size, TensorType type, TensorFormat fmt) {
+    const TensorAttr& attr = input_attrs[index];
+    input_data[index].resize(attr.size);
+    if (type == attr.type && size == attr.size) {
+        memcpy(input_data[index].data(), data, size);
+        return 0;
+    }
+    if (type == TensorType::UInt8 && attr.type == TensorType::Float32 && attr.fmt != TensorFormat::Undefined) {
+        return convertImage(index, (const uint8_t*)data, size, fmt);
+    }
+    printf("onnxruntime input %d: cannot take %u bytes of %s for %u bytes of %s\n", index, size,
+           tensorTypeName(type), attr.size, tensorTypeName(attr.type));
+    return -1;
+}
+
+int OnnxRuntimeBackend::runAsync() {
+    if (running.valid()) {
+        printf("onnxruntime run already in flight\n");
+        return -1;
+    }
+    results.clear();
+    running = std::async(std::launch::async, [this] {
+        try {
+            std::vector<Ort::Value> inputs;
+            std::vector<const char*> in_names;
+            std::vector<const char*> out_names;
+            for (size_t i = 0; i < input_attrs.size(); i++) {
+                const TensorAttr& attr = input_attrs[i];
+                if (input_data[i].size() != attr.size) {
+                    printf("onnxruntime input %zu not set\n", i);
+                    return -1;
+                }
+                inputs.push_back(Ort::Value::CreateTensor(memory_info, input_data[i].data(), attr.size, attr.dims,
+                                                          attr.n_dims, to_onnx_type(attr.type)));
+                in_names.push_back(input_names[i].c_str());
+            }
+            for (const std::string& name : output_names) {
+                out_names.push_back(name.c_str());
+            }
+            results = session.Run(Ort::RunOptions{nullptr}, in_names.data(), inputs.data(), inputs.size(),
+                                  out_names.data(), out_names.size());
+        } catch (const Ort::Exception& e) {
+            printf("onnxruntime run fail! %s\n", e.what());
+            return -1;
+        }
+        return 0;
+    });
+    return 0;
+}
+
+int OnnxRuntimeBackend::wait() {
+    if (!running.valid()) {
+        return -1;
+    }
+    return running.get();
+}
+
+int OnnxRuntimeBackend::getOutputs(TensorOutput* outputs, int n) {
+    for (int i = 0; i < n; i++) {
+        if (outputs[i].index < 0 || outputs[i].index >= (int)results.size()) {
+            printf("onnxruntime output %d not available\n", outputs[i].index);
+            return -1;
+        }
+        Ort::Value& value = results[outputs[i].index];
+        Ort::TensorTypeAndShapeInfo info = value.GetTensorTypeAndShapeInfo();
+        outputs[i].buf = value.GetTensorMutableData<uint8_t>();
+        outputs[i].size = info.GetElementCount() * tensorTypeSize(from_onnx_type(info.GetElementType()));
+    }
+    return 0;
+}
+
+void OnnxRuntimeBackend::releaseOutputs(TensorOutput* outputs, int n) {
+    results.clear();
+    for (int i = 0; i < n; i++) {
+        outputs[i].buf = NULL;
+        outputs[i].size = 0;
+    }
+}
+
+std::unique_ptr<InferenceBackend> makeOnnxRuntimeBackend() {
+    return std::make_unique<OnnxRuntimeBackend>();
+}
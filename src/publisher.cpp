@@ -1,50 +1,221 @@
 #include "publisher.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
 #include <iostream>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
 #include <thread>
 
-// Implementation of the JsonMessageFormatter
-std::string JsonMessageFormatter::formatMessage(const InferenceResult& result) {
-    json j;
-    j["faces_in_frame_total"] = result.count_all_faces_in_frame;
-    j["faces_attending"] = result.num_faces_attending;
-    j["timestamp"] = std::chrono::system_clock::to_time_t(result.timestamp);
-    j["ASR"] = result.asr;
+#include "shm_state.h"
+#include "trace.h"
 
-    return j.dump();
+TokenBucket::TokenBucket(double rate, double burst)
+    : rate(rate), burst(burst), tokens(burst), last(std::chrono::steady_clock::now()) {}
+
+void TokenBucket::refill() {
+    auto now = std::chrono::steady_clock::now();
+    tokens = std::min(burst, tokens + rate * std::chrono::duration<double>(now - last).count());
+    last = now;
 }
 
-// Implementation of the BSVariableMessageFormatter
-std::string BSVariableMessageFormatter::formatMessage(const InferenceResult& result) {
-    // format the message as a string like faces_attending:0!!faces_in_frame_total:0!!timestamp:1746732409
-    std::string message = 
-        "faces_attending:" + std::to_string(result.num_faces_attending) + "!!" + 
-        "faces_in_frame_total:" + std::to_string(result.count_all_faces_in_frame) + "!!" +
-        "ASR:" + result.asr + "!!" +
-        "timestamp:" + std::to_string(std::chrono::system_clock::to_time_t(result.timestamp));
-    return message;
+int TokenBucket::take(int n) {
+    refill();
+    int granted = std::min(n, (int)tokens);
+    tokens -= granted;
+    return granted;
 }
 
-UDPPublisher::UDPPublisher(
-        const std::string& ip,
-        const int port,
-        ThreadSafeQueue<InferenceResult>& queue, 
+std::chrono::microseconds TokenBucket::untilNext() const {
+    if (tokens >= 1) {
+        return std::chrono::microseconds(0);
+    }
+    return std::chrono::microseconds((long)std::ceil((1 - tokens) / rate * 1e6));
+}
+
+static double thread_cpu_us() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static Histogram& publish_histogram(const std::string& step, const std::string& sink) {
+    return metrics().histogram("bsext_publish_seconds", "Latency of formatting one message and of one send call",
+                               "step=\"" + step + "\",sink=\"" + sink + "\"");
+}
+
+static Counter& publish_counter(const char* name, const char* help, const std::string& sink) {
+    return metrics().counter(name, help, "sink=\"" + sink + "\"");
+}
+
+PublisherMetrics::PublisherMetrics(const std::string& sink)
+    : format(publish_histogram("format", sink)),
+      send(publish_histogram("send", sink)),
+      results(publish_counter("bsext_publisher_results_total", "Results read from the result ring", sink)),
+      messages(publish_counter("bsext_publisher_messages_total", "Messages handed to the transport", sink)),
+      dropped(publish_counter("bsext_publisher_dropped_total", "Messages the transport refused or a slow reader lost",
+                              sink)),
+      coalesced(publish_counter("bsext_publisher_coalesced_total",
+                                "Face-count updates replaced by a newer one before sending", sink)),
+      lag(metrics().gauge("bsext_publisher_lag", "Results published but not yet read by the sink",
+                          "sink=\"" + sink + "\"")) {}
+
+Publisher::Publisher(
+        const std::string& name,
+        ResultRing& results,
         std::atomic<bool>& isRunning,
         std::shared_ptr<MessageFormatter> formatter,
         int messages_per_second)
-    : resultQueue(queue), 
-      running(isRunning), 
-      target_mps(messages_per_second),
-      formatter(formatter) {
+    : name(name),
+      sink_metrics(name),
+      results(results),
+      consumer(results.addConsumer()),
+      running(isRunning),
+      formatter(formatter),
+      // a tenth of a second of burst, so short bursts of transcripts are not delayed
+      bucket(messages_per_second > 0 ? messages_per_second : 1e9,
+             messages_per_second > 0 ? std::max(1, messages_per_second / 10) : PUBLISHER_MAX_BATCH) {}
+
+// Format a result into the pending list. Face-count updates coalesce: a newer
+// one replaces the unsent older one. Transcripts always wait for a token.
+// Pending buffers are rotated rather than freed, so steady state does not allocate.
+void Publisher::collect(const InferenceResult& result) {
+    stats.results++;
+    sink_metrics.results.add();
+    bool coalescable = !result.carriesTranscript();
+    if (coalescable) {
+        auto live_end = pending.begin() + pending_count;
+        auto it = std::find_if(pending.begin(), live_end, [](const PendingMessage& p) { return p.coalescable; });
+        if (it != live_end) {
+            std::rotate(it, it + 1, live_end);
+            pending_count--;
+            stats.coalesced++;
+            sink_metrics.coalesced.add();
+        }
+    }
+    if (pending_count == pending.size()) {
+        pending.emplace_back();
+    }
+    PendingMessage& slot = pending[pending_count++];
+    slot.coalescable = coalescable;
+    slot.trace_id = result.trace_id;
 
-    setupSocket(ip, port);
+    auto format_start = std::chrono::steady_clock::now();
+    double start = thread_cpu_us();
+    formatter->formatMessage(result, slot.message);
+    stats.format_cpu_us += thread_cpu_us() - start;
+    sink_metrics.format.recordSince(format_start);
+    tracer().complete("format", result.trace_id, format_start, std::chrono::steady_clock::now());
 }
 
-UDPPublisher::~UDPPublisher() {
-    close(sockfd);
+// Send as many pending messages as there are tokens, several per call
+void Publisher::sendPending() {
+    int n = bucket.take(std::min((int)pending_count, PUBLISHER_MAX_BATCH));
+    if (n == 0) {
+        return;
+    }
+    long dropped = stats.dropped;
+    auto send_start = std::chrono::steady_clock::now();
+    sendBatch(pending.data(), n);
+    auto send_end = std::chrono::steady_clock::now();
+    sink_metrics.send.recordSince(send_start);
+    for (int i = 0; i < n; ++i) {
+        tracer().complete("send", pending[i].trace_id, send_start, send_end);
+    }
+    stats.messages += n;
+    sink_metrics.messages.add(n);
+    sink_metrics.dropped.add(stats.dropped - dropped);
+    std::rotate(pending.begin(), pending.begin() + n, pending.begin() + pending_count);
+    pending_count -= n;
+}
+
+void Publisher::reportStats() {
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - last_report).count();
+    if (elapsed < PUBLISHER_REPORT_SECONDS) {
+        return;
+    }
+    if (stats.results > 0) {
+        printf("publisher %s: results=%ld sent=%ld dropped=%ld coalesced=%ld syscalls/s=%.2f "
+               "format_cpu=%.1f us/msg max_lag=%llu\n",
+               name.c_str(), stats.results, stats.messages, stats.dropped, stats.coalesced, stats.syscalls / elapsed,
+               stats.format_cpu_us / stats.results, (unsigned long long)results.getStats(consumer).max_lag);
+    }
+    stats = PublisherStats{};
+    last_report = now;
+}
+
+void Publisher::operator()() {
+    tracer().setThreadName("publisher " + name);
+    last_report = std::chrono::steady_clock::now();
+    while (running) {
+        const InferenceResult* result;
+        if (pending_count == 0) {
+            result = results.wait(consumer);
+            if (!result) {
+                break;
+            }
+            // format in place, the slot is only reused once every publisher released it
+            collect(*result);
+            results.release(consumer);
+        }
+        // drain whatever else is ready so it is coalesced and batched
+        while ((result = results.poll(consumer))) {
+            collect(*result);
+            results.release(consumer);
+        }
+
+        BroadcastConsumerStats lag = results.getStats(consumer);
+        sink_metrics.lag.set(lag.lag);
+        if (lag.lag > results.getCapacity() / 2) {
+            std::cout << "Publisher " << name << " is " << lag.lag << " results behind" << std::endl;
+        }
+
+        sendPending();
+        if (pending_count > 0) {
+            std::this_thread::sleep_for(bucket.untilNext());
+        }
+        reportStats();
+    }
+}
+
+// One sendmmsg for a batch; msg_name is null for connected sockets
+static int send_batch(int sockfd, const PendingMessage* messages, int n, void* addr, socklen_t addrlen,
+                      int flags) {
+    if (n == 1) {
+        ssize_t sent = addr ? sendto(sockfd, messages[0].message.data(), messages[0].message.length(), flags,
+                                     (struct sockaddr*)addr, addrlen)
+                            : send(sockfd, messages[0].message.data(), messages[0].message.length(), flags);
+        return sent < 0 ? 0 : 1;
+    }
+    struct mmsghdr msgs[PUBLISHER_MAX_BATCH];
+    struct iovec iov[PUBLISHER_MAX_BATCH];
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < n; ++i) {
+        iov[i].iov_base = (void*)messages[i].message.data();
+        iov[i].iov_len = messages[i].message.length();
+        msgs[i].msg_hdr.msg_name = addr;
+        msgs[i].msg_hdr.msg_namelen = addr ? addrlen : 0;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int sent = sendmmsg(sockfd, msgs, n, flags);
+    return sent < 0 ? 0 : sent;
 }
 
-void UDPPublisher::setupSocket(const std::string& ip, const int port) {
+UDPPublisher::UDPPublisher(
+        const std::string& ip,
+        const int port,
+        ResultRing& results,
+        std::atomic<bool>& isRunning,
+        std::shared_ptr<MessageFormatter> formatter,
+        int messages_per_second)
+    : Publisher("udp:" + ip + ":" + std::to_string(port), results, isRunning, formatter, messages_per_second) {
     sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         throw std::runtime_error("Socket creation failed");
@@ -56,12 +227,178 @@ void UDPPublisher::setupSocket(const std::string& ip, const int port) {
     servaddr.sin_addr.s_addr = inet_addr(ip.c_str()); 
 }
 
-void UDPPublisher::operator()() {
-    InferenceResult result;
-    while (resultQueue.pop(result)) {
-        std::string message = formatter->formatMessage(result);
-        sendto(sockfd, message.c_str(), message.length(), 0,
-               (struct sockaddr*)&servaddr, sizeof(servaddr));
+UDPPublisher::~UDPPublisher() {
+    close(sockfd);
+}
 
+void UDPPublisher::sendBatch(const PendingMessage* messages, int n) {
+    int sent = send_batch(sockfd, messages, n, &servaddr, sizeof(servaddr), 0);
+    stats.syscalls++;
+    stats.dropped += n - sent;
+}
+
+UnixSocketPublisher::UnixSocketPublisher(
+        const std::string& path,
+        int type,
+        ResultRing& results,
+        std::atomic<bool>& isRunning,
+        std::shared_ptr<MessageFormatter> formatter,
+        int messages_per_second)
+    : Publisher((type == SOCK_SEQPACKET ? "seqpacket:" : "unix:") + path, results, isRunning, formatter,
+                messages_per_second),
+      type(type) {
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("Unix socket path too long: " + path);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    if (type == SOCK_DGRAM) {
+        sockfd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (sockfd < 0) {
+            throw std::runtime_error("Socket creation failed");
+        }
+    }
+}
+
+UnixSocketPublisher::~UnixSocketPublisher() {
+    if (sockfd >= 0) {
+        close(sockfd);
+    }
+}
+
+// SOCK_SEQPACKET only: (re)connect to the consumer, at most once a second
+bool UnixSocketPublisher::connectSocket() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_connect < std::chrono::seconds(1)) {
+        return false;
+    }
+    last_connect = now;
+    sockfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sockfd < 0) {
+        return false;
+    }
+    if (connect(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sockfd);
+        sockfd = -1;
+        return false;
+    }
+    std::cout << "Publisher " << getName() << " connected" << std::endl;
+    return true;
+}
+
+void UnixSocketPublisher::sendBatch(const PendingMessage* messages, int n) {
+    if (sockfd < 0 && !connectSocket()) {
+        stats.dropped += n;
+        return;
+    }
+    // never block the publisher on a slow consumer
+    int flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+    int sent = type == SOCK_DGRAM ? send_batch(sockfd, messages, n, &addr, sizeof(addr), flags)
+                                  : send_batch(sockfd, messages, n, nullptr, 0, flags);
+    stats.syscalls++;
+    stats.dropped += n - sent;
+    // errno is only meaningful when nothing went out; a consumer that left mid-batch fails the next one
+    if (sent == 0 && type == SOCK_SEQPACKET && errno != EAGAIN && errno != EWOULDBLOCK) {
+        std::cout << "Publisher " << getName() << " disconnected: " << strerror(errno) << std::endl;
+        close(sockfd);
+        sockfd = -1;
+    }
+}
+
+SharedMemoryPublisher::SharedMemoryPublisher(
+        const std::string& shm_name,
+        ResultRing& results,
+        std::atomic<bool>& isRunning,
+        std::shared_ptr<MessageFormatter> formatter,
+        int messages_per_second)
+    : Publisher("shm:" + shm_name, results, isRunning, formatter, messages_per_second),
+      shm_name(shm_name) {
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("shm_open " + shm_name + " failed: " + strerror(errno));
+    }
+    if (ftruncate(fd, sizeof(ShmStateSegment)) < 0) {
+        close(fd);
+        throw std::runtime_error("ftruncate " + shm_name + " failed: " + strerror(errno));
+    }
+    void* mem = mmap(nullptr, sizeof(ShmStateSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        throw std::runtime_error("mmap " + shm_name + " failed: " + strerror(errno));
+    }
+    segment = new (mem) ShmStateSegment;
+    segment->magic = SHM_STATE_MAGIC;
+    segment->version = SHM_STATE_VERSION;
+    segment->record_bytes = SHM_RECORD_BYTES;
+    segment->reserved = 0;
+    for (ShmStateRecord* record : {&segment->latest, &segment->transcript}) {
+        record->seq.store(0, std::memory_order_relaxed);
+        record->length = 0;
+        record->count = 0;
+    }
+}
+
+SharedMemoryPublisher::~SharedMemoryPublisher() {
+    munmap(segment, sizeof(ShmStateSegment));
+    shm_unlink(shm_name.c_str());
+}
+
+void SharedMemoryPublisher::sendBatch(const PendingMessage* messages, int n) {
+    for (int i = 0; i < n; ++i) {
+        const std::string& message = messages[i].message;
+        if (message.size() > SHM_RECORD_BYTES) {
+            stats.dropped++;
+            continue;
+        }
+        // the latest record is rewritten in order, so it ends up with the newest message
+        shm_state_write(segment->latest, message.data(), message.size());
+        if (!messages[i].coalescable) {
+            shm_state_write(segment->transcript, message.data(), message.size());
+        }
+    }
+}
+
+int defaultMessagesPerSecond(const std::string& format) {
+    return format == "bsvar" ? 10 : 1000;
+}
+
+std::unique_ptr<Publisher> makePublisher(
+        const std::string& spec,
+        ResultRing& results,
+        std::atomic<bool>& isRunning) {
+    size_t eq = spec.find('=');
+    size_t colon = spec.find(':', eq);
+    if (eq == std::string::npos || colon == std::string::npos) {
+        throw std::invalid_argument("Sink must be <format>=<transport>:<address>: " + spec);
+    }
+    std::string format = spec.substr(0, eq);
+    std::string transport = spec.substr(eq + 1, colon - eq - 1);
+    std::string address = spec.substr(colon + 1);
+    auto formatter = makeMessageFormatter(format);
+    if (!formatter) {
+        throw std::invalid_argument("Unknown sink format " + format + " (json, bsvar, binary): " + spec);
+    }
+    int mps = defaultMessagesPerSecond(format);
+
+    if (transport == "udp") {
+        size_t port_colon = address.rfind(':');
+        int port = port_colon == std::string::npos ? 0 : atoi(address.c_str() + port_colon + 1);
+        if (port <= 0 || port > 65535) {
+            throw std::invalid_argument("UDP sink needs <ip>:<port>: " + spec);
+        }
+        return std::make_unique<UDPPublisher>(address.substr(0, port_colon), port, results, isRunning, formatter,
+                                              mps);
+    }
+    if (transport == "unix") {
+        return std::make_unique<UnixSocketPublisher>(address, SOCK_DGRAM, results, isRunning, formatter, mps);
+    }
+    if (transport == "seqpacket") {
+        return std::make_unique<UnixSocketPublisher>(address, SOCK_SEQPACKET, results, isRunning, formatter, mps);
+    }
+    if (transport == "shm") {
+        // readers only ever see the latest message, so there is nothing to rate-limit
+        return std::make_unique<SharedMemoryPublisher>(address, results, isRunning, formatter, 0);
     }
+    throw std::invalid_argument("Unknown sink transport " + transport + " (udp, unix, seqpacket, shm): " + spec);
 }
@@ -0,0 +1,175 @@
+#include "replay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "asr.h"
+#include "audio_utils.h"
+
+// WAV file as 16 kHz mono samples, with the conversions the final decode applies
+static std::vector<short> load_clip(const std::string& path) {
+    audio_buffer_t audio;
+    memset(&audio, 0, sizeof(audio));
+    if (read_audio(path.c_str(), &audio) != 0) {
+        throw std::runtime_error("Cannot read replay clip " + path);
+    }
+    int ret = 0;
+    if (audio.num_channels == 2) {
+        ret = convert_channels(&audio);
+    } else if (audio.num_channels != 1) {
+        ret = -1;
+    }
+    if (ret == 0 && audio.sample_rate != SAMPLE_RATE) {
+        ret = resample_audio(&audio, audio.sample_rate, SAMPLE_RATE);
+    }
+    std::vector<short> samples;
+    if (ret == 0) {
+        samples.resize(audio.num_frames);
+        for (int i = 0; i < audio.num_frames; ++i) {
+            float v = std::clamp(audio.data[i], -1.0f, 32767.0f / 32768.0f);
+            samples[i] = (short)std::lround(v * 32768.0f);
+        }
+    }
+    free(audio.data);
+    if (ret != 0) {
+        throw std::runtime_error("Replay clip must be mono or stereo: " + path);
+    }
+    return samples;
+}
+
+std::vector<ReplayClip> loadReplayScript(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot open replay script " + path);
+    }
+    std::string dir;
+    size_t slash = path.rfind('/');
+    if (slash != std::string::npos) {
+        dir = path.substr(0, slash + 1);
+    }
+    std::vector<ReplayClip> clips;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        ReplayClip clip;
+        if (!(fields >> clip.start_seconds)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            throw std::runtime_error(path + ":" + std::to_string(line_number) + ": expected <start_seconds> <wav_path>");
+        }
+        if (!(fields >> clip.path) || clip.start_seconds < 0) {
+            throw std::runtime_error(path + ":" + std::to_string(line_number) + ": expected <start_seconds> <wav_path>");
+        }
+        if (clip.path[0] != '/') {
+            clip.path = dir + clip.path;
+        }
+        clip.samples = load_clip(clip.path);
+        clips.push_back(std::move(clip));
+    }
+    return clips;
+}
+
+ReplayClock::ReplayClock(double fps) : fps(fps > 0 ? fps : REPLAY_DEFAULT_FPS) {}
+
+void ReplayClock::setFps(double new_fps) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (new_fps > 0) {
+        fps = new_fps;
+    }
+}
+
+void ReplayClock::advanceFrame() {
+    std::unique_lock<std::mutex> lock(mutex);
+    frames++;
+    double now = frames / fps;
+    cv.wait(lock, [&] { return !session || audio_seconds >= now || stopped; });
+}
+
+void ReplayClock::sessionStarted() {
+    std::lock_guard<std::mutex> lock(mutex);
+    session = true;
+    session_start = frames / fps;
+    audio_seconds = session_start;
+}
+
+void ReplayClock::videoEnded() {
+    std::lock_guard<std::mutex> lock(mutex);
+    video_ended = true;
+}
+
+double ReplayClock::sessionStartSeconds() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return session_start;
+}
+
+void ReplayClock::audioReached(double seconds) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        audio_seconds = seconds;
+    }
+    cv.notify_all();
+}
+
+void ReplayClock::sessionEnded() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        session = false;
+    }
+    cv.notify_all();
+}
+
+bool ReplayClock::finished() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return video_ended && !session;
+}
+
+int64_t ReplayClock::getFrames() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return frames;
+}
+
+double ReplayClock::videoSeconds() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return frames / fps;
+}
+
+void ReplayClock::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    cv.notify_all();
+}
+
+ReplayAudioSource::ReplayAudioSource(std::vector<ReplayClip> clips, ReplayClock& clock, const std::string& name)
+    : clips(std::move(clips)), clock(clock), name(name) {}
+
+bool ReplayAudioSource::open() {
+    position = std::llround(clock.sessionStartSeconds() * SAMPLE_RATE);
+    return true;
+}
+
+bool ReplayAudioSource::read(short* frame, int len) {
+    std::fill(frame, frame + len, 0);
+    for (const ReplayClip& clip : clips) {
+        int64_t clip_start = std::llround(clip.start_seconds * SAMPLE_RATE);
+        int64_t begin = std::max(position, clip_start);
+        int64_t end = std::min(position + len, clip_start + (int64_t)clip.samples.size());
+        for (int64_t t = begin; t < end; ++t) {
+            int mixed = frame[t - position] + clip.samples[t - clip_start];
+            frame[t - position] = (short)std::clamp(mixed, -32768, 32767);
+        }
+    }
+    position += len;
+    clock.audioReached((double)position / SAMPLE_RATE);
+    return true;
+}
@@ -5,178 +5,121 @@
 
 #include "retinaface.h"
 #include "common.h"
-#include "file_utils.h"
 #include "image_utils.h"
-#include "rknn_box_priors.h"
+#include "easy_timer.h"
 
 
 #define NMS_THRESHOLD 0.4
 #define CONF_THRESHOLD 0.5
 #define VIS_THRESHOLD 0.4
 
+// Build with -DRETINAFACE_VALIDATE_INT8 to check the int8 post-process against
+// the float decode on every frame
+
 static int clamp(int x, int min, int max) {
     if (x > max) return max;
     if (x < min) return min;
     return x;
 }
 
-static void dump_tensor_attr(rknn_tensor_attr *attr) {
-    printf("  index=%d, name=%s, n_dims=%d, dims=[%d, %d, %d, %d], n_elems=%d, size=%d, fmt=%s, type=%s, qnt_type=%s, "
-           "zp=%d, scale=%f\n",
-           attr->index, attr->name, attr->n_dims, attr->dims[0], attr->dims[1], attr->dims[2], attr->dims[3],
-           attr->n_elems, attr->size, get_format_string(attr->fmt), get_type_string(attr->type),
-           get_qnt_type_string(attr->qnt_type), attr->zp, attr->scale);
-}
-
-static float CalculateOverlap(float xmin0, float ymin0, float xmax0, float ymax0, float xmin1, float ymin1, float xmax1, float ymax1) {
-    float w = fmax(0.f, fmin(xmax0, xmax1) - fmax(xmin0, xmin1) + 1);
-    float h = fmax(0.f, fmin(ymax0, ymax1) - fmax(ymin0, ymin1) + 1);
-    float i = w * h;
-    float u = (xmax0 - xmin0 + 1) * (ymax0 - ymin0 + 1) + (xmax1 - xmin1 + 1) * (ymax1 - ymin1 + 1) - i;
-    return u <= 0.f ? 0.f : (i / u);
-}
-
-static int nms(int validCount, float *outputLocations, int order[], float threshold, int width, int height) {
-    for (int i = 0; i < validCount; ++i) {
-        if (order[i] == -1) {
-            continue;
-        }
-        int n = order[i];
-        for (int j = i + 1; j < validCount; ++j) {
-            int m = order[j];
-            if (m == -1) {
-                continue;
-            }
-            float xmin0 = outputLocations[n * 4 + 0] * width;
-            float ymin0 = outputLocations[n * 4 + 1] * height;
-            float xmax0 = outputLocations[n * 4 + 2] * width;
-            float ymax0 = outputLocations[n * 4 + 3] * height;
-
-            float xmin1 = outputLocations[m * 4 + 0] * width;
-            float ymin1 = outputLocations[m * 4 + 1] * height;
-            float xmax1 = outputLocations[m * 4 + 2] * width;
-            float ymax1 = outputLocations[m * 4 + 3] * height;
-
-            float iou = CalculateOverlap(xmin0, ymin0, xmax0, ymax0, xmin1, ymin1, xmax1, ymax1);
-
-            if (iou > threshold) {
-                order[j] = -1;
-            }
-        }
+// Input normalization of the RetinaFace conversion; .rknn models apply it on
+// the NPU, other backends are given it
+static const float RETINAFACE_MEAN[3] = {104.f, 117.f, 123.f};
+static const float RETINAFACE_STD[3] = {1.f, 1.f, 1.f};
+
+#ifdef RETINAFACE_VALIDATE_INT8
+// Dequantize the full tensors, run the float path and compare the candidates
+static void validate_int8_candidates(retinaface_context_t *app_ctx, TensorOutput outputs[], retinaface_candidates_t *cand) {
+    int n = app_ctx->priors.count;
+    const int elems[3] = {4, 2, 10};
+    float *deq[3];
+    retinaface_candidates_t ref;
+    if (retinaface_candidates_init(&ref, n) < 0) {
+        return;
     }
-    return 0;
-}
-
-static int quick_sort_indice_inverse(float *input, int left, int right, int *indices) {
-    float key;
-    int key_index;
-    int low = left;
-    int high = right;
-    if (left < right) {
-        key_index = indices[left];
-        key = input[left];
-        while (low < high) {
-            while (low < high && input[high] <= key) {
-                high--;
-            }
-            input[low] = input[high];
-            indices[low] = indices[high];
-            while (low < high && input[low] >= key) {
-                low++;
-            }
-            input[high] = input[low];
-            indices[high] = indices[low];
+    for (int t = 0; t < 3; ++t) {
+        const int8_t *q = (const int8_t *)outputs[t].buf;
+        int32_t zp = app_ctx->backend->outputAttr(t).zp;
+        float scale = app_ctx->backend->outputAttr(t).scale;
+        deq[t] = (float *)malloc(sizeof(float) * n * elems[t]);
+        for (int i = 0; i < n * elems[t]; ++i) {
+            deq[t][i] = (q[i] - zp) * scale;
         }
-        input[low] = key;
-        indices[low] = key_index;
-        quick_sort_indice_inverse(input, left, low - 1, indices);
-        quick_sort_indice_inverse(input, low + 1, right, indices);
     }
-    return low;
-}
-
-static int filterValidResult(float *scores, float *loc, float *landms, const float boxPriors[][4], int model_in_h, int model_in_w,
-                             int filter_indice[], float *props, float threshold, const int num_results) {
-    int validCount = 0;
-    const float VARIANCES[2] = {0.1, 0.2};
-    // Scale them back to the input size.
-    for (int i = 0; i < num_results; ++i) {
-        float face_score = scores[i * 2 + 1];
-        if (face_score > threshold) {
-            filter_indice[validCount] = i;
-            props[validCount] = face_score;
-            //decode location to origin position
-            float xcenter = loc[i * 4 + 0] * VARIANCES[0] * boxPriors[i][2] + boxPriors[i][0];
-            float ycenter = loc[i * 4 + 1] * VARIANCES[0] * boxPriors[i][3] + boxPriors[i][1];
-            float w = (float) expf(loc[i * 4 + 2] * VARIANCES[1] ) * boxPriors[i][2];
-            float h = (float) expf(loc[i * 4 + 3] * VARIANCES[1]) * boxPriors[i][3];
-
-            float xmin = xcenter - w * 0.5f;
-            float ymin = ycenter - h * 0.5f;
-            float xmax = xmin + w;
-            float ymax = ymin + h;
-
-            loc[i * 4 + 0] = xmin ;
-            loc[i * 4 + 1] = ymin ;
-            loc[i * 4 + 2] = xmax ;
-            loc[i * 4 + 3] = ymax ;
-            for (int j = 0; j < 5; ++j) {
-                landms[i * 10 + 2 * j] = landms[i * 10 + 2 * j] * VARIANCES[0] * boxPriors[i][2] + boxPriors[i][0];
-                landms[i * 10 + 2 * j + 1] = landms[i * 10 + 2 * j + 1] * VARIANCES[0] * boxPriors[i][3] + boxPriors[i][1];
-            }
-            ++validCount;
+    retinaface_compact_scores(deq[1], n, CONF_THRESHOLD, &ref);
+    retinaface_decode_candidates(deq[0], deq[2], &app_ctx->priors, &ref);
+
+    float max_diff = 0.f;
+    int mismatch = ref.count != cand->count;
+    for (int k = 0; !mismatch && k < ref.count; ++k) {
+        if (ref.prior[k] != cand->prior[k]) {
+            mismatch = 1;
+            break;
+        }
+        for (int j = 0; j < 4; ++j) {
+            max_diff = fmaxf(max_diff, fabsf(ref.box[k * 4 + j] - cand->box[k * 4 + j]));
+        }
+        for (int j = 0; j < 10; ++j) {
+            max_diff = fmaxf(max_diff, fabsf(ref.landms[k * 10 + j] - cand->landms[k * 10 + j]));
         }
     }
-
-    return validCount;
+    if (mismatch || max_diff > 1e-5f) {
+        printf("int8 post-process mismatch: candidates int8=%d float=%d max_diff=%f\n",
+               cand->count, ref.count, max_diff);
+    }
+    for (int t = 0; t < 3; ++t) {
+        free(deq[t]);
+    }
+    retinaface_candidates_release(&ref);
 }
-
-static int post_process_retinaface(rknn_app_context_t *app_ctx, image_buffer_t *src_img, rknn_output outputs[], retinaface_result *result, letterbox_t *letter_box) {
-    float *location = (float *)outputs[0].buf;
-    float *scores = (float *)outputs[1].buf;
-    float *landms = (float *)outputs[2].buf;
-    const float (*prior_ptr)[4];
-    int num_priors = 0;
-    if (app_ctx->model_height == 320) {
-        num_priors = 4200;//anchors box number
-        prior_ptr = BOX_PRIORS_320;
-    } else if(app_ctx->model_height == 640){
-        num_priors = 16800;//anchors box number
-        prior_ptr = BOX_PRIORS_640;
-    }
-    else
-    {
-        printf("model_shape error!!!\n");
-        return -1;
-
+#endif
+
+// Compact, decode and NMS the raw outputs; returns the kept candidate count.
+// NMS IoU is computed on normalized boxes scaled by nms_w x nms_h.
+static int decode_retinaface(retinaface_context_t *app_ctx, TensorOutput outputs[], int nms_w, int nms_h) {
+    retinaface_candidates_t *cand = &app_ctx->candidates;
+
+    // compact the priors above threshold first, then decode only those
+    if (app_ctx->output_int8) {
+        const TensorAttr &loc = app_ctx->backend->outputAttr(0);
+        const TensorAttr &conf = app_ctx->backend->outputAttr(1);
+        const TensorAttr &landm = app_ctx->backend->outputAttr(2);
+        retinaface_compact_scores_i8((int8_t *)outputs[1].buf, conf.zp, conf.scale,
+                                     app_ctx->priors.count, CONF_THRESHOLD, cand);
+        retinaface_decode_candidates_i8((int8_t *)outputs[0].buf, loc.zp, loc.scale,
+                                        (int8_t *)outputs[2].buf, landm.zp, landm.scale,
+                                        &app_ctx->priors, cand);
+#ifdef RETINAFACE_VALIDATE_INT8
+        validate_int8_candidates(app_ctx, outputs, cand);
+#endif
+    } else {
+        retinaface_compact_scores((float *)outputs[1].buf, app_ctx->priors.count, CONF_THRESHOLD, cand);
+        retinaface_decode_candidates((float *)outputs[0].buf, (float *)outputs[2].buf, &app_ctx->priors, cand);
     }
 
-    int filter_indices[num_priors];
-    float props[num_priors];
-
-    memset(filter_indices, 0, sizeof(int)*num_priors);
-    memset(props, 0, sizeof(float)*num_priors);
-
-    int validCount = filterValidResult(scores, location, landms, prior_ptr, app_ctx->model_height, app_ctx->model_width,
-                                       filter_indices, props, CONF_THRESHOLD, num_priors);
-
-    quick_sort_indice_inverse(props, 0, validCount - 1, filter_indices);
-    nms(validCount, location, filter_indices, NMS_THRESHOLD, src_img->width, src_img->height);
+    return retinaface_nms(cand, NMS_THRESHOLD, nms_w, nms_h);
+}
 
+static int post_process_retinaface(retinaface_context_t *app_ctx, image_buffer_t *src_img, TensorOutput outputs[], retinaface_result *result, letterbox_t *letter_box) {
+    retinaface_candidates_t *cand = &app_ctx->candidates;
+    int keepCount = decode_retinaface(app_ctx, outputs, src_img->width, src_img->height);
+    float *location = cand->box;
+    float *landms = cand->landms;
 
+    // keep is in score order, so the first max_faces visible faces are the top-K
     int last_count = 0;
+    int truncated = 0;
     result->count = 0;
-    for (int i = 0; i < validCount; ++i) {
-        if (last_count >= 128) {
-            printf("Warning: detected more than 128 faces, can not handle that");
-            break;
+    for (int i = 0; i < keepCount; ++i) {
+        int n = cand->keep[i];
+        if (cand->score[n] < VIS_THRESHOLD) {
+            continue;
         }
-        if (filter_indices[i] == -1 || props[i] < VIS_THRESHOLD) {
+        if (last_count >= result->max_faces) {
+            truncated++;
             continue;
         }
 
-        int n = filter_indices[i];
-
         float x1 = location[n * 4 + 0] * app_ctx->model_width - letter_box->x_pad;
         float y1 = location[n * 4 + 1] * app_ctx->model_height - letter_box->y_pad;
         float x2 = location[n * 4 + 2] * app_ctx->model_width - letter_box->x_pad;
@@ -187,7 +130,7 @@ static int post_process_retinaface(rknn_app_context_t *app_ctx, image_buffer_t *
         result->object[last_count].box.top    = (int)(clamp(y1, 0, model_in_h) / letter_box->scale);
         result->object[last_count].box.right  = (int)(clamp(x2, 0, model_in_w) / letter_box->scale);
         result->object[last_count].box.bottom = (int)(clamp(y2, 0, model_in_h) / letter_box->scale);
-        result->object[last_count].score = props[i]; // Confidence
+        result->object[last_count].score = cand->score[n]; // Confidence
 
         for (int j = 0; j < 5; ++j) { // Facial feature points
             float ponit_x = landms[n * 10 + 2 * j] * app_ctx->model_width - letter_box->x_pad;
@@ -199,184 +142,400 @@ static int post_process_retinaface(rknn_app_context_t *app_ctx, image_buffer_t *
     }
 
     result->count = last_count;
+    app_ctx->perf.truncated = truncated;
 
     return 0;
 }
 
-int init_retinaface_model(const std::string& model_path, rknn_app_context_t *app_ctx) {
-    int ret;
-    int model_len = 0;
-    char *model;
-    rknn_context ctx = 0;
+// One crop placed in the model input: src is the crop in frame pixels, dst the
+// region it was resized into, scale = dst size / src size
+typedef struct {
+    image_rect_t src;
+    image_rect_t dst;
+    float scale_x;
+    float scale_y;
+} roi_tile_t;
+
+static float result_iou(const box_rect_t *a, const box_rect_t *b) {
+    float w = fminf(a->right, b->right) - fmaxf(a->left, b->left) + 1;
+    float h = fminf(a->bottom, b->bottom) - fmaxf(a->top, b->top) + 1;
+    if (w <= 0.f || h <= 0.f) {
+        return 0.f;
+    }
+    float i = w * h;
+    float u = (a->right - a->left + 1) * (a->bottom - a->top + 1) + (b->right - b->left + 1) * (b->bottom - b->top + 1) - i;
+    return u <= 0.f ? 0.f : i / u;
+}
 
-    // Load RKNN Model
-    model_len = read_data_from_file(model_path.c_str(), &model);
-    if (model == NULL) {
-        printf("load_model fail!\n");
+static int post_process_retinaface_rois(retinaface_context_t *app_ctx, TensorOutput outputs[], const roi_tile_t *tiles, int n_tiles,
+                                        retinaface_result *result) {
+    retinaface_candidates_t *cand = &app_ctx->candidates;
+    int model_w = app_ctx->model_width;
+    int model_h = app_ctx->model_height;
+    int keepCount = decode_retinaface(app_ctx, outputs, model_w, model_h);
+
+    int last_count = 0;
+    int truncated = 0;
+    result->count = 0;
+    for (int i = 0; i < keepCount; ++i) {
+        int n = cand->keep[i];
+        if (cand->score[n] < VIS_THRESHOLD) {
+            continue;
+        }
+        const float *box = cand->box + n * 4;
+        float x1 = box[0] * model_w;
+        float y1 = box[1] * model_h;
+        float x2 = box[2] * model_w;
+        float y2 = box[3] * model_h;
+
+        // a face belongs to the tile holding its centre; faces cut by a tile
+        // edge are dropped, their tile neighbour is padding or another crop
+        float cx = (x1 + x2) * 0.5f;
+        float cy = (y1 + y2) * 0.5f;
+        const roi_tile_t *tile = NULL;
+        for (int t = 0; t < n_tiles; ++t) {
+            if (cx >= tiles[t].dst.left && cx <= tiles[t].dst.right && cy >= tiles[t].dst.top && cy <= tiles[t].dst.bottom) {
+                tile = &tiles[t];
+                break;
+            }
+        }
+        if (tile == NULL || x1 < tile->dst.left - 1 || y1 < tile->dst.top - 1 ||
+            x2 > tile->dst.right + 1 || y2 > tile->dst.bottom + 1) {
+            continue;
+        }
+
+        retinaface_object_t obj;
+        obj.cls = 0;
+        obj.score = cand->score[n];
+        obj.box.left = tile->src.left + (int)((x1 - tile->dst.left) / tile->scale_x);
+        obj.box.top = tile->src.top + (int)((y1 - tile->dst.top) / tile->scale_y);
+        obj.box.right = tile->src.left + (int)((x2 - tile->dst.left) / tile->scale_x);
+        obj.box.bottom = tile->src.top + (int)((y2 - tile->dst.top) / tile->scale_y);
+        for (int j = 0; j < 5; ++j) {
+            float px = cand->landms[n * 10 + 2 * j] * model_w;
+            float py = cand->landms[n * 10 + 2 * j + 1] * model_h;
+            obj.ponit[j].x = tile->src.left + (int)((clamp(px, tile->dst.left, tile->dst.right) - tile->dst.left) / tile->scale_x);
+            obj.ponit[j].y = tile->src.top + (int)((clamp(py, tile->dst.top, tile->dst.bottom) - tile->dst.top) / tile->scale_y);
+        }
+
+        // overlapping crops can see the same face; keep the first, highest score
+        int duplicate = 0;
+        for (int k = 0; k < last_count && !duplicate; ++k) {
+            duplicate = result_iou(&result->object[k].box, &obj.box) > NMS_THRESHOLD;
+        }
+        if (duplicate) {
+            continue;
+        }
+        if (last_count >= result->max_faces) {
+            truncated++;
+            continue;
+        }
+        result->object[last_count++] = obj;
+    }
+
+    result->count = last_count;
+    app_ctx->perf.truncated = truncated;
+
+    return 0;
+}
+
+int init_retinaface_result(retinaface_result *result, int max_faces) {
+    memset(result, 0, sizeof(retinaface_result));
+    if (max_faces <= 0) {
+        max_faces = RETINAFACE_DEFAULT_MAX_FACES;
+    }
+    result->object = (retinaface_object_t *)malloc(sizeof(retinaface_object_t) * max_faces);
+    if (result->object == NULL) {
+        printf("malloc result size %d fail!\n", max_faces);
         return -1;
     }
-    
-    ret = rknn_init(&ctx, model, model_len, 0, NULL);
-    printf("rknn_init done, %d\n", ret);
-    free(model);
-    if (ret < 0) {
-        printf("rknn_init fail! ret=%d\n", ret);
+    result->max_faces = max_faces;
+    return 0;
+}
+
+void release_retinaface_result(retinaface_result *result) {
+    free(result->object);
+    memset(result, 0, sizeof(retinaface_result));
+}
+
+// Allocate the model input once. If the backend can bind it, the buffer is
+// its own input memory (NPU tensor memory on RKNN), so the letterbox writes
+// straight into the input and setInput() is skipped; otherwise fall back to
+// a malloc'd staging buffer.
+static int setup_input_buffer(retinaface_context_t *app_ctx) {
+    image_buffer_t *img = &app_ctx->input_img;
+
+    memset(img, 0, sizeof(image_buffer_t));
+    memset(&app_ctx->letterbox_cache, 0, sizeof(letterbox_cache_t));
+    app_ctx->input_bound = 0;
+    img->width = app_ctx->model_width;
+    img->height = app_ctx->model_height;
+    img->format = IMAGE_FORMAT_RGB888;
+    img->size = get_image_size(img);
+    img->fd = -1;
+
+    void *mem = app_ctx->backend->bindInputBuffer(0, TensorType::UInt8, TensorFormat::NHWC, img->size, &img->fd);
+    if (mem != NULL) {
+        app_ctx->input_bound = 1;
+        img->virt_addr = (unsigned char *)mem;
+        return 0;
+    }
+
+    printf("model input uses setInput\n");
+    img->virt_addr = (unsigned char *)malloc(img->size);
+    if (img->virt_addr == NULL) {
+        printf("malloc buffer size:%d fail!\n", img->size);
         return -1;
     }
-    // printf("model freed\n");
+    return 0;
+}
 
-    // Get Model Input Output Number
-    rknn_input_output_num io_num;
-    ret = rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
-    if (ret != RKNN_SUCC) {
-        printf("rknn_query fail! ret=%d\n", ret);
+int init_retinaface_model(const std::string& model_path, retinaface_context_t *app_ctx) {
+    int ret;
+    std::unique_ptr<InferenceBackend> backend = loadInferenceBackend(model_path);
+    if (backend == nullptr) {
+        printf("load_model fail!\n");
         return -1;
     }
-    printf("model input num: %d, output num: %d\n", io_num.n_input, io_num.n_output);
-
-    // Get Model Input Info
-    printf("input tensors:\n");
-    rknn_tensor_attr input_attrs[io_num.n_input];
-    memset(input_attrs, 0, sizeof(input_attrs));
-    for (int i = 0; i < io_num.n_input; i++) {
-        input_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &(input_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC) {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
-        }
-        // dump_tensor_attr(&(input_attrs[i]));
-    }
-
-    // Get Model Output Info
-    printf("output tensors:\n");
-    rknn_tensor_attr output_attrs[io_num.n_output];
-    memset(output_attrs, 0, sizeof(output_attrs));
-    for (int i = 0; i < io_num.n_output; i++) {
-        output_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC) {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
-        }
-        // dump_tensor_attr(&(output_attrs[i]));
+    app_ctx->backend = backend.release();
+    InferenceBackend *model = app_ctx->backend;
+    if (model->numInputs() < 1 || model->numOutputs() < 3) {
+        printf("model_shape error!!! %d inputs, %d outputs\n", model->numInputs(), model->numOutputs());
+        return -1;
     }
 
-    // Set to context
-    app_ctx->rknn_ctx = ctx;
-    app_ctx->io_num = io_num;
-    app_ctx->input_attrs = (rknn_tensor_attr *)malloc(io_num.n_input * sizeof(rknn_tensor_attr));
-    memcpy(app_ctx->input_attrs, input_attrs, io_num.n_input * sizeof(rknn_tensor_attr));
-    app_ctx->output_attrs = (rknn_tensor_attr *)malloc(io_num.n_output * sizeof(rknn_tensor_attr));
-    memcpy(app_ctx->output_attrs, output_attrs, io_num.n_output * sizeof(rknn_tensor_attr));
-
-    if (input_attrs[0].fmt == RKNN_TENSOR_NCHW) {
+    const TensorAttr &input = model->inputAttr(0);
+    if (input.fmt == TensorFormat::NCHW) {
         printf("model is NCHW input fmt\n");
-        app_ctx->model_channel = input_attrs[0].dims[1];
-        app_ctx->model_height  = input_attrs[0].dims[2];
-        app_ctx->model_width   = input_attrs[0].dims[3];
+        app_ctx->model_channel = input.dims[1];
+        app_ctx->model_height  = input.dims[2];
+        app_ctx->model_width   = input.dims[3];
     } else {
         printf("model is NHWC input fmt\n");
-        app_ctx->model_height  = input_attrs[0].dims[1];
-        app_ctx->model_width   = input_attrs[0].dims[2];
-        app_ctx->model_channel = input_attrs[0].dims[3];
+        app_ctx->model_height  = input.dims[1];
+        app_ctx->model_width   = input.dims[2];
+        app_ctx->model_channel = input.dims[3];
     }
     // printf("model input height=%d, width=%d, channel=%d\n",
     //        app_ctx->model_height, app_ctx->model_width, app_ctx->model_channel);
+    model->setInputNormalization(0, RETINAFACE_MEAN, RETINAFACE_STD, 3);
+
+    ret = setup_input_buffer(app_ctx);
+    if (ret < 0) {
+        return -1;
+    }
+
+    // anchors depend only on the input size, so any WxH model works
+    ret = retinaface_priors_generate(&app_ctx->priors, app_ctx->model_width, app_ctx->model_height);
+    if (ret < 0) {
+        return -1;
+    }
+    if (model->outputAttr(0).n_elems != (uint32_t)app_ctx->priors.count * 4 ||
+        model->outputAttr(1).n_elems != (uint32_t)app_ctx->priors.count * 2 ||
+        model->outputAttr(2).n_elems != (uint32_t)app_ctx->priors.count * 10) {
+        printf("model_shape error!!! %dx%d input needs %d priors\n",
+               app_ctx->model_width, app_ctx->model_height, app_ctx->priors.count);
+        return -1;
+    }
+    printf("generated %d priors for %dx%d input\n", app_ctx->priors.count, app_ctx->model_width, app_ctx->model_height);
+    // int8 outputs are thresholded and dequantized in post-process, which
+    // saves the runtime converting all 16 values of every prior to float
+    app_ctx->output_int8 = 1;
+    for (int i = 0; i < 3; i++) {
+        const TensorAttr &attr = model->outputAttr(i);
+        if (attr.type != TensorType::Int8 || !attr.quantized || attr.scale <= 0.f) {
+            app_ctx->output_int8 = 0;
+        }
+    }
+    printf("post-process on %s outputs\n", app_ctx->output_int8 ? "int8" : "float");
+
+    // every prior can pass the threshold in the worst case
+    ret = retinaface_candidates_init(&app_ctx->candidates, app_ctx->priors.count);
+    if (ret < 0) {
+        return -1;
+    }
 
     return 0;
 }
 
-int release_retinaface_model(rknn_app_context_t *app_ctx) {
-    if (app_ctx->input_attrs != NULL) {
-        free(app_ctx->input_attrs);
-        app_ctx->input_attrs = NULL;
+int release_retinaface_model(retinaface_context_t *app_ctx) {
+    // bound input memory belongs to the backend
+    if (!app_ctx->input_bound && app_ctx->input_img.virt_addr != NULL) {
+        free(app_ctx->input_img.virt_addr);
     }
-    if (app_ctx->output_attrs != NULL) {
-        free(app_ctx->output_attrs);
-        app_ctx->output_attrs = NULL;
+    app_ctx->input_img.virt_addr = NULL;
+    app_ctx->input_bound = 0;
+    release_letterbox_cache(&app_ctx->letterbox_cache);
+    retinaface_priors_release(&app_ctx->priors);
+    retinaface_candidates_release(&app_ctx->candidates);
+    delete app_ctx->backend;
+    app_ctx->backend = NULL;
+    return 0;
+}
+
+// Feed the prepared input, run the model and fetch the outputs. The caller
+// releases the outputs with releaseOutputs() on success.
+static int run_retinaface(retinaface_context_t *app_ctx, TensorOutput outputs[]) {
+    int ret;
+    InferenceBackend *model = app_ctx->backend;
+
+    // Set Input Data, not needed when the buffer is bound as backend input memory
+    if (!app_ctx->input_bound) {
+        uint32_t size = app_ctx->model_width * app_ctx->model_height * app_ctx->model_channel;
+        ret = model->setInput(0, app_ctx->input_img.virt_addr, size, TensorType::UInt8, TensorFormat::NHWC);
+        if (ret < 0) {
+            printf("setInput fail! ret=%d\n", ret);
+            return -1;
+        }
     }
-    if (app_ctx->rknn_ctx != 0) {
-        rknn_destroy(app_ctx->rknn_ctx);
-        app_ctx->rknn_ctx = 0;
+
+    ret = model->run();
+    if (ret < 0) {
+        printf("model run fail! ret=%d\n", ret);
+        return -1;
+    }
+
+    // Get Output
+    for (int i = 0; i < 3; i++) {
+        outputs[i].index = i;
+        outputs[i].want_float = !app_ctx->output_int8;
+    }
+    ret = model->getOutputs(outputs, 3);
+    if (ret < 0) {
+        printf("getOutputs fail! ret=%d\n", ret);
+        return ret;
     }
     return 0;
 }
 
-int inference_retinaface_model(rknn_app_context_t *app_ctx, image_buffer_t *src_img, retinaface_result *out_result) {
+int inference_retinaface_model(retinaface_context_t *app_ctx, image_buffer_t *src_img, retinaface_result *out_result) {
     int ret;
-    image_buffer_t img;
+    if (out_result->object == NULL) {
+        printf("retinaface_result not initialized\n");
+        return -1;
+    }
+    image_buffer_t *img = &app_ctx->input_img;
     letterbox_t letter_box;
-    rknn_input inputs[1];
-    rknn_output outputs[app_ctx->io_num.n_output];
-    memset(&img, 0, sizeof(image_buffer_t));
-    memset(inputs, 0, sizeof(inputs));
-    memset(outputs, 0, sizeof(rknn_output) * 3);
-    memset(&letter_box, 0, sizeof(letterbox_t));
+    TensorOutput outputs[3];
     int bg_color = 114;//letterbox background pixel
+    TIMER timer;
 
-    // Pre Process
-    img.width = app_ctx->model_width;
-    img.height = app_ctx->model_height;
-    img.format = IMAGE_FORMAT_RGB888;
-    img.size = get_image_size(&img);
-    img.virt_addr = (unsigned char *)malloc(img.size);
-
-    if (img.virt_addr == NULL) {
-        printf("malloc buffer size:%d fail!\n", img.size);
+    if (img->virt_addr == NULL) {
+        printf("model input buffer not allocated\n");
         return -1;
     }
 
-    ret = convert_image_with_letterbox(src_img, &img, &letter_box, bg_color);
+    // Pre Process
+    // a BGR888 source is swapped to RGB inside the letterbox resize; geometry
+    // and pad border are reused while the source size stays the same
+    timer.tik();
+    ret = convert_image_with_letterbox_cached(src_img, img, &app_ctx->letterbox_cache, bg_color);
     if (ret < 0) {
         printf("convert_image fail! ret=%d\n", ret);
         return -1;
     }
+    letter_box = app_ctx->letterbox_cache.letterbox;
+    timer.tok();
+    app_ctx->perf.preprocess_ms = timer.get_time();
 
-    // Set Input Data
-    inputs[0].index = 0;
-    inputs[0].type  = RKNN_TENSOR_UINT8;
-    inputs[0].fmt   = RKNN_TENSOR_NHWC;
-    inputs[0].size  = app_ctx->model_width * app_ctx->model_height * app_ctx->model_channel;
-    inputs[0].buf   = img.virt_addr;
-
-    ret = rknn_inputs_set(app_ctx->rknn_ctx, 1, inputs);
+    timer.tik();
+    ret = run_retinaface(app_ctx, outputs);
     if (ret < 0) {
-        printf("rknn_input_set fail! ret=%d\n", ret);
-        return -1;
+        return ret;
     }
+    timer.tok();
+    app_ctx->perf.npu_ms = timer.get_time();
 
-    // Run
-    // printf("rknn_run\n");
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    timer.tik();
+    ret = post_process_retinaface(app_ctx, src_img, outputs, out_result, &letter_box);
     if (ret < 0) {
-        printf("rknn_run fail! ret=%d\n", ret);
+        printf("post_process_retinaface fail! ret=%d\n", ret);
+    }
+    timer.tok();
+    app_ctx->perf.postprocess_ms = timer.get_time();
+    // Remeber to release the outputs
+    app_ctx->backend->releaseOutputs(outputs, 3);
+
+    return ret;
+}
+
+int inference_retinaface_model_rois(retinaface_context_t *app_ctx, image_buffer_t *src_img, const image_rect_t *rois, int n_rois,
+                                    retinaface_result *out_result) {
+    int ret;
+    if (out_result->object == NULL) {
+        printf("retinaface_result not initialized\n");
         return -1;
     }
+    if (n_rois <= 0 || n_rois > RETINAFACE_MAX_ROIS) {
+        printf("invalid roi count %d\n", n_rois);
+        return -1;
+    }
+    image_buffer_t *img = &app_ctx->input_img;
+    TensorOutput outputs[3];
+    int bg_color = 114;//letterbox background pixel
+    roi_tile_t tiles[RETINAFACE_MAX_ROIS];
+    TIMER timer;
 
-    // Get Output
-    for (int i = 0; i < app_ctx->io_num.n_output; i++) {
-        outputs[i].index = i;
-        outputs[i].want_float = 1;
+    if (img->virt_addr == NULL) {
+        printf("model input buffer not allocated\n");
+        return -1;
     }
-    ret = rknn_outputs_get(app_ctx->rknn_ctx, 3, outputs, NULL);
-    if (ret < 0) {
-        printf("rknn_outputs_get fail! ret=%d\n", ret);
-        goto out;
+
+    // Pre Process
+    // a single crop gets the whole input, otherwise crops share a 2x2 mosaic
+    // so all of them go through one model run
+    timer.tik();
+    memset(img->virt_addr, bg_color, get_image_size(img));
+    // the full-frame letterbox has to refill its border next time
+    app_ctx->letterbox_cache.pad_filled = 0;
+    int grid = n_rois == 1 ? 1 : 2;
+    int tile_w = (app_ctx->model_width / grid) & ~3;
+    int tile_h = (app_ctx->model_height / grid) & ~1;
+    for (int t = 0; t < n_rois; ++t) {
+        roi_tile_t *tile = &tiles[t];
+        tile->src = rois[t];
+        int src_w = rois[t].right - rois[t].left + 1;
+        int src_h = rois[t].bottom - rois[t].top + 1;
+        if (src_w <= 0 || src_h <= 0) {
+            printf("invalid roi %d\n", t);
+            return -1;
+        }
+        float scale = fminf((float)tile_w / src_w, (float)tile_h / src_h);
+        int dst_w = (int)(src_w * scale);
+        int dst_h = (int)(src_h * scale);
+        dst_w = dst_w > 4 ? dst_w & ~3 : dst_w;
+        dst_h = dst_h > 2 ? dst_h & ~1 : dst_h;
+        tile->dst.left = (t % grid) * tile_w;
+        tile->dst.top = (t / grid) * tile_h;
+        tile->dst.right = tile->dst.left + dst_w - 1;
+        tile->dst.bottom = tile->dst.top + dst_h - 1;
+        tile->scale_x = (float)dst_w / src_w;
+        tile->scale_y = (float)dst_h / src_h;
+        ret = convert_image_into_box(src_img, img, &tile->src, &tile->dst);
+        if (ret < 0) {
+            printf("convert_image fail! ret=%d\n", ret);
+            return -1;
+        }
     }
+    timer.tok();
+    app_ctx->perf.preprocess_ms = timer.get_time();
 
-    ret = post_process_retinaface(app_ctx, src_img, outputs, out_result, &letter_box);
+    timer.tik();
+    ret = run_retinaface(app_ctx, outputs);
     if (ret < 0) {
-        printf("post_process_retinaface fail! ret=%d\n", ret);
-        return -1;
+        return ret;
     }
-    // Remeber to release rknn output
-    rknn_outputs_release(app_ctx->rknn_ctx, 3, outputs);
+    timer.tok();
+    app_ctx->perf.npu_ms = timer.get_time();
 
-out:
-    if (img.virt_addr != NULL) {
-        free(img.virt_addr);
+    timer.tik();
+    ret = post_process_retinaface_rois(app_ctx, outputs, tiles, n_rois, out_result);
+    if (ret < 0) {
+        printf("post_process_retinaface_rois fail! ret=%d\n", ret);
     }
+    timer.tok();
+    app_ctx->perf.postprocess_ms = timer.get_time();
+    app_ctx->backend->releaseOutputs(outputs, 3);
 
     return ret;
-}
\ No newline at end of file
+}
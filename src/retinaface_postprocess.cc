@@ -0,0 +1,399 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "retinaface_postprocess.h"
+
+static const float VARIANCES[2] = {0.1f, 0.2f};
+
+// RetinaFace (mobilenet0.25) anchor config
+static const int PRIOR_STEPS[3] = {8, 16, 32};
+static const int PRIOR_MIN_SIZES[3][2] = {{16, 32}, {64, 128}, {256, 512}};
+
+int retinaface_count_priors(int model_w, int model_h) {
+    int count = 0;
+    for (int k = 0; k < 3; ++k) {
+        int fm_h = (model_h + PRIOR_STEPS[k] - 1) / PRIOR_STEPS[k];
+        int fm_w = (model_w + PRIOR_STEPS[k] - 1) / PRIOR_STEPS[k];
+        count += fm_h * fm_w * 2;
+    }
+    return count;
+}
+
+int retinaface_priors_generate(retinaface_priors_t *priors, int model_w, int model_h) {
+    memset(priors, 0, sizeof(retinaface_priors_t));
+    if (model_w <= 0 || model_h <= 0) {
+        printf("invalid model size %dx%d\n", model_w, model_h);
+        return -1;
+    }
+    int count = retinaface_count_priors(model_w, model_h);
+    // one 16-byte aligned block, four planes each padded to a multiple of 4
+    int stride = (count + 3) & ~3;
+    float *buf = NULL;
+    if (posix_memalign((void **)&buf, 16, sizeof(float) * 4 * stride) != 0) {
+        printf("malloc priors size %d fail!\n", count);
+        return -1;
+    }
+    memset(buf, 0, sizeof(float) * 4 * stride);
+    priors->count = count;
+    priors->cx = buf;
+    priors->cy = buf + stride;
+    priors->w = buf + stride * 2;
+    priors->h = buf + stride * 3;
+
+    // same order as the model output: level, row, column, min size
+    int n = 0;
+    for (int k = 0; k < 3; ++k) {
+        int step = PRIOR_STEPS[k];
+        int fm_h = (model_h + step - 1) / step;
+        int fm_w = (model_w + step - 1) / step;
+        for (int i = 0; i < fm_h; ++i) {
+            for (int j = 0; j < fm_w; ++j) {
+                for (int m = 0; m < 2; ++m) {
+                    priors->cx[n] = (j + 0.5f) * step / model_w;
+                    priors->cy[n] = (i + 0.5f) * step / model_h;
+                    priors->w[n] = (float)PRIOR_MIN_SIZES[k][m] / model_w;
+                    priors->h[n] = (float)PRIOR_MIN_SIZES[k][m] / model_h;
+                    n++;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+void retinaface_priors_release(retinaface_priors_t *priors) {
+    if (priors->cx != NULL) {
+        free(priors->cx);
+    }
+    memset(priors, 0, sizeof(retinaface_priors_t));
+}
+
+int retinaface_candidates_init(retinaface_candidates_t *cand, int capacity) {
+    memset(cand, 0, sizeof(retinaface_candidates_t));
+    // a kept box is linked into every grid cell it covers; most faces cover a few
+    int cell_capacity = capacity * 4 > 256 ? capacity * 4 : 256;
+    cand->prior = (int *)malloc(sizeof(int) * capacity);
+    cand->score = (float *)malloc(sizeof(float) * capacity);
+    cand->box = (float *)malloc(sizeof(float) * 4 * capacity);
+    cand->landms = (float *)malloc(sizeof(float) * 10 * capacity);
+    cand->keep = (int *)malloc(sizeof(int) * capacity);
+    cand->order = (int *)malloc(sizeof(int) * capacity);
+    cand->pixel_box = (float *)malloc(sizeof(float) * 4 * capacity);
+    cand->area = (float *)malloc(sizeof(float) * capacity);
+    cand->cell_next = (int *)malloc(sizeof(int) * cell_capacity);
+    cand->cell_item = (int *)malloc(sizeof(int) * cell_capacity);
+    if (cand->prior == NULL || cand->score == NULL || cand->box == NULL || cand->landms == NULL ||
+        cand->keep == NULL || cand->order == NULL || cand->pixel_box == NULL || cand->area == NULL ||
+        cand->cell_next == NULL || cand->cell_item == NULL) {
+        printf("malloc candidates size %d fail!\n", capacity);
+        retinaface_candidates_release(cand);
+        return -1;
+    }
+    cand->capacity = capacity;
+    cand->cell_capacity = cell_capacity;
+    return 0;
+}
+
+void retinaface_candidates_release(retinaface_candidates_t *cand) {
+    free(cand->prior);
+    free(cand->score);
+    free(cand->box);
+    free(cand->landms);
+    free(cand->keep);
+    free(cand->order);
+    free(cand->pixel_box);
+    free(cand->area);
+    free(cand->cell_next);
+    free(cand->cell_item);
+    memset(cand, 0, sizeof(retinaface_candidates_t));
+}
+
+int retinaface_compact_scores(const float *scores, int num_priors, float threshold, retinaface_candidates_t *cand) {
+    int count = 0;
+    int capacity = cand->capacity;
+    int i = 0;
+    // scores are [bg, face] pairs; test the face column of 4 priors at a time and
+    // only branch into the per-lane append when at least one lane passes
+#if defined(__ARM_NEON)
+    float32x4_t vthr = vdupq_n_f32(threshold);
+    for (; i + 4 <= num_priors; i += 4) {
+        float32x4x2_t s = vld2q_f32(scores + i * 2);
+        uint32x4_t m = vcgtq_f32(s.val[1], vthr);
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u16(vmovn_u32(m)), 0);
+        if (bits == 0) {
+            continue;
+        }
+        for (int k = 0; k < 4; ++k) {
+            if ((bits >> (k * 16)) & 1 && count < capacity) {
+                cand->prior[count] = i + k;
+                cand->score[count] = scores[(i + k) * 2 + 1];
+                count++;
+            }
+        }
+    }
+#elif defined(__SSE2__)
+    __m128 vthr = _mm_set1_ps(threshold);
+    for (; i + 4 <= num_priors; i += 4) {
+        __m128 a = _mm_loadu_ps(scores + i * 2);
+        __m128 b = _mm_loadu_ps(scores + i * 2 + 4);
+        __m128 face = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(face, vthr));
+        if (mask == 0) {
+            continue;
+        }
+        for (int k = 0; k < 4; ++k) {
+            if ((mask >> k) & 1 && count < capacity) {
+                cand->prior[count] = i + k;
+                cand->score[count] = scores[(i + k) * 2 + 1];
+                count++;
+            }
+        }
+    }
+#endif
+    for (; i < num_priors; ++i) {
+        float face_score = scores[i * 2 + 1];
+        if (face_score > threshold && count < capacity) {
+            cand->prior[count] = i;
+            cand->score[count] = face_score;
+            count++;
+        }
+    }
+    cand->count = count;
+    return count;
+}
+
+static inline void decode_one(const retinaface_priors_t *priors, int i, const float l[4], const float lm[10],
+                              float *box, float *out) {
+    float pcx = priors->cx[i];
+    float pcy = priors->cy[i];
+    float pw = priors->w[i];
+    float ph = priors->h[i];
+    float sw = VARIANCES[0] * pw;
+    float sh = VARIANCES[0] * ph;
+
+    //decode location to origin position
+    float xcenter = l[0] * sw + pcx;
+    float ycenter = l[1] * sh + pcy;
+    float w = expf(l[2] * VARIANCES[1]) * pw;
+    float h = expf(l[3] * VARIANCES[1]) * ph;
+
+    box[0] = xcenter - w * 0.5f;
+    box[1] = ycenter - h * 0.5f;
+    box[2] = box[0] + w;
+    box[3] = box[1] + h;
+
+    for (int j = 0; j < 5; ++j) {
+        out[2 * j] = lm[2 * j] * sw + pcx;
+        out[2 * j + 1] = lm[2 * j + 1] * sh + pcy;
+    }
+}
+
+void retinaface_decode_candidates(const float *loc, const float *landms, const retinaface_priors_t *priors,
+                                  retinaface_candidates_t *cand) {
+    for (int k = 0; k < cand->count; ++k) {
+        int i = cand->prior[k];
+        decode_one(priors, i, loc + i * 4, landms + i * 10, cand->box + k * 4, cand->landms + k * 10);
+    }
+}
+
+int retinaface_compact_scores_i8(const int8_t *scores, int32_t zp, float scale, int num_priors, float threshold,
+                                 retinaface_candidates_t *cand) {
+    int count = 0;
+    int capacity = cand->capacity;
+    int i = 0;
+    // (q - zp) * scale > threshold  <=>  q > threshold / scale + zp
+    int cutoff = (int)floorf(threshold / scale + zp);
+    if (cutoff >= 127) {
+        cand->count = 0;
+        return 0;
+    }
+    if (cutoff < -128) {
+        // every prior passes, the int8 compare below can not express that
+        cutoff = -129;
+    }
+#if defined(__ARM_NEON)
+    if (cutoff >= -128) {
+        int8x16_t vcut = vdupq_n_s8((int8_t)cutoff);
+        for (; i + 16 <= num_priors; i += 16) {
+            int8x16x2_t s = vld2q_s8(scores + i * 2);
+            uint8x16_t m = vcgtq_s8(s.val[1], vcut);
+            uint64x2_t m64 = vreinterpretq_u64_u8(m);
+            if ((vgetq_lane_u64(m64, 0) | vgetq_lane_u64(m64, 1)) == 0) {
+                continue;
+            }
+            for (int k = 0; k < 16; ++k) {
+                int8_t q = scores[(i + k) * 2 + 1];
+                if (q > cutoff && count < capacity) {
+                    cand->prior[count] = i + k;
+                    cand->score[count] = (q - zp) * scale;
+                    count++;
+                }
+            }
+        }
+    }
+#elif defined(__SSE2__)
+    if (cutoff >= -128) {
+        __m128i vcut = _mm_set1_epi8((char)cutoff);
+        for (; i + 16 <= num_priors; i += 16) {
+            // face score is the high byte of each [bg, face] pair
+            __m128i a = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(scores + i * 2)), 8);
+            __m128i b = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(scores + i * 2 + 16)), 8);
+            int mask = _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_packs_epi16(a, b), vcut));
+            if (mask == 0) {
+                continue;
+            }
+            for (int k = 0; k < 16; ++k) {
+                if ((mask >> k) & 1 && count < capacity) {
+                    cand->prior[count] = i + k;
+                    cand->score[count] = (scores[(i + k) * 2 + 1] - zp) * scale;
+                    count++;
+                }
+            }
+        }
+    }
+#endif
+    for (; i < num_priors; ++i) {
+        int8_t q = scores[i * 2 + 1];
+        if (q > cutoff && count < capacity) {
+            cand->prior[count] = i;
+            cand->score[count] = (q - zp) * scale;
+            count++;
+        }
+    }
+    cand->count = count;
+    return count;
+}
+
+void retinaface_decode_candidates_i8(const int8_t *loc, int32_t loc_zp, float loc_scale,
+                                     const int8_t *landms, int32_t landms_zp, float landms_scale,
+                                     const retinaface_priors_t *priors, retinaface_candidates_t *cand) {
+    float l[4];
+    float lm[10];
+    for (int k = 0; k < cand->count; ++k) {
+        int i = cand->prior[k];
+        for (int j = 0; j < 4; ++j) {
+            l[j] = (loc[i * 4 + j] - loc_zp) * loc_scale;
+        }
+        for (int j = 0; j < 10; ++j) {
+            lm[j] = (landms[i * 10 + j] - landms_zp) * landms_scale;
+        }
+        decode_one(priors, i, l, lm, cand->box + k * 4, cand->landms + k * 10);
+    }
+}
+
+static inline int grid_cell(float v, float cell_size) {
+    int c = (int)(v / cell_size);
+    if (c < 0) return 0;
+    if (c >= RETINAFACE_NMS_GRID) return RETINAFACE_NMS_GRID - 1;
+    return c;
+}
+
+static inline int overlaps(const float *a, float area_a, const float *b, float area_b, float threshold) {
+    float w = std::min(a[2], b[2]) - std::max(a[0], b[0]) + 1;
+    if (w <= 0.f) {
+        return 0;
+    }
+    float h = std::min(a[3], b[3]) - std::max(a[1], b[1]) + 1;
+    if (h <= 0.f) {
+        return 0;
+    }
+    float i = w * h;
+    float u = area_a + area_b - i;
+    return u > 0.f && (i / u) > threshold;
+}
+
+int retinaface_nms(retinaface_candidates_t *cand, float threshold, int width, int height) {
+    int n = cand->count;
+    int *order = cand->order;
+    const float *score = cand->score;
+    float *pb = cand->pixel_box;
+
+    // introsort, no recursion depth blow-up on equal scores
+    for (int i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    std::sort(order, order + n, [score](int a, int b) {
+        return score[a] > score[b] || (score[a] == score[b] && a < b);
+    });
+
+    for (int k = 0; k < n; ++k) {
+        const float *box = cand->box + k * 4;
+        pb[k * 4 + 0] = box[0] * width;
+        pb[k * 4 + 1] = box[1] * height;
+        pb[k * 4 + 2] = box[2] * width;
+        pb[k * 4 + 3] = box[3] * height;
+        cand->area[k] = (pb[k * 4 + 2] - pb[k * 4 + 0] + 1) * (pb[k * 4 + 3] - pb[k * 4 + 1] + 1);
+    }
+
+    // boxes that overlap at all share at least one cell, so only kept boxes
+    // linked into the candidate's cells need an IoU test
+    for (int c = 0; c < RETINAFACE_NMS_GRID * RETINAFACE_NMS_GRID; ++c) {
+        cand->cell_head[c] = -1;
+    }
+    float cell_w = (float)width / RETINAFACE_NMS_GRID;
+    float cell_h = (float)height / RETINAFACE_NMS_GRID;
+    int cell_used = 0;
+    int brute_force = 0;
+    int kept = 0;
+
+    for (int oi = 0; oi < n; ++oi) {
+        int k = order[oi];
+        const float *a = pb + k * 4;
+        float area_a = cand->area[k];
+        int gx0 = grid_cell(a[0], cell_w);
+        int gy0 = grid_cell(a[1], cell_h);
+        int gx1 = grid_cell(a[2], cell_w);
+        int gy1 = grid_cell(a[3], cell_h);
+
+        int suppressed = 0;
+        if (brute_force) {
+            for (int t = 0; t < kept && !suppressed; ++t) {
+                int m = cand->keep[t];
+                suppressed = overlaps(a, area_a, pb + m * 4, cand->area[m], threshold);
+            }
+        } else {
+            for (int gy = gy0; gy <= gy1 && !suppressed; ++gy) {
+                for (int gx = gx0; gx <= gx1 && !suppressed; ++gx) {
+                    for (int e = cand->cell_head[gy * RETINAFACE_NMS_GRID + gx]; e != -1; e = cand->cell_next[e]) {
+                        int m = cand->cell_item[e];
+                        if (overlaps(a, area_a, pb + m * 4, cand->area[m], threshold)) {
+                            suppressed = 1;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        if (suppressed) {
+            continue;
+        }
+
+        cand->keep[kept++] = k;
+        int cells = (gx1 - gx0 + 1) * (gy1 - gy0 + 1);
+        if (brute_force || cell_used + cells > cand->cell_capacity) {
+            // link pool exhausted, fall back to testing every kept box
+            brute_force = 1;
+            continue;
+        }
+        for (int gy = gy0; gy <= gy1; ++gy) {
+            for (int gx = gx0; gx <= gx1; ++gx) {
+                int c = gy * RETINAFACE_NMS_GRID + gx;
+                cand->cell_item[cell_used] = k;
+                cand->cell_next[cell_used] = cand->cell_head[c];
+                cand->cell_head[c] = cell_used;
+                cell_used++;
+            }
+        }
+    }
+    cand->keep_count = kept;
+    return kept;
+}
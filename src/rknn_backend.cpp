@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "inference_backend.h"
+#include "rknn_api.h"
+
+static TensorType from_rknn_type(rknn_tensor_type type) {
+    switch (type) {
+    case RKNN_TENSOR_FLOAT32: return TensorType::Float32;
+    case RKNN_TENSOR_FLOAT16: return TensorType::Float16;
+    case RKNN_TENSOR_INT8: return TensorType::Int8;
+    case RKNN_TENSOR_UINT8: return TensorType::UInt8;
+    case RKNN_TENSOR_INT32: return TensorType::Int32;
+    case RKNN_TENSOR_INT64: return TensorType::Int64;
+    default: return TensorType::Other;
+    }
+}
+
+static rknn_tensor_type to_rknn_type(TensorType type) {
+    switch (type) {
+    case TensorType::Float16: return RKNN_TENSOR_FLOAT16;
+    case TensorType::Int8: return RKNN_TENSOR_INT8;
+    case TensorType::UInt8: return RKNN_TENSOR_UINT8;
+    case TensorType::Int32: return RKNN_TENSOR_INT32;
+    case TensorType::Int64: return RKNN_TENSOR_INT64;
+    default: return RKNN_TENSOR_FLOAT32;
+    }
+}
+
+// the runtime takes non-image inputs as NCHW, its default
+static rknn_tensor_format to_rknn_format(TensorFormat fmt) {
+    return fmt == TensorFormat::NHWC ? RKNN_TENSOR_NHWC : RKNN_TENSOR_NCHW;
+}
+
+static TensorAttr from_rknn_attr(const rknn_tensor_attr& attr) {
+    TensorAttr out;
+    out.index = attr.index;
+    out.name = attr.name;
+    out.n_dims = attr.n_dims < TENSOR_MAX_DIMS ? attr.n_dims : TENSOR_MAX_DIMS;
+    for (int i = 0; i < out.n_dims; i++) {
+        out.dims[i] = attr.dims[i];
+    }
+    out.n_elems = attr.n_elems;
+    out.size = attr.size;
+    out.size_with_stride = attr.size_with_stride;
+    out.w_stride = attr.w_stride;
+    out.type = from_rknn_type(attr.type);
+    out.fmt = attr.fmt == RKNN_TENSOR_NCHW ? TensorFormat::NCHW
+            : attr.fmt == RKNN_TENSOR_NHWC ? TensorFormat::NHWC : TensorFormat::Undefined;
+    out.quantized = attr.qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC;
+    out.zp = attr.zp;
+    out.scale = attr.scale;
+    return out;
+}
+
+/**
+ * @class RknnBackend
+ * @brief .rknn models on the NPU
+ *
+ * Inputs bound with bindInputBuffer() are NPU tensor memory set with
+ * rknn_set_io_mem, so they skip rknn_inputs_set. runAsync() starts a
+ * non-blocking rknn_run and wait() is rknn_wait.
+ */
+class RknnBackend : public InferenceBackend {
+public:
+    ~RknnBackend() override;
+
+    int load(const std::string& model_path) override;
+    const char* name() const override { return "rknn"; }
+
+    void* bindInputBuffer(int index, TensorType type, TensorFormat fmt, uint32_t size, int* fd) override;
+    int setInput(int index, const void* data, uint32_t size, TensorType type, TensorFormat fmt) override;
+    int runAsync() override;
+    int wait() override;
+    int getOutputs(TensorOutput* outputs, int n) override;
+    void releaseOutputs(TensorOutput* outputs, int n) override;
+
+private:
+    rknn_context ctx{0};
+    std::vector<rknn_tensor_attr> rknn_input_attrs;
+    std::vector<rknn_tensor_mem*> input_mems;
+    std::vector<rknn_input> pending_inputs;
+    std::vector<rknn_output> outputs_held;
+    rknn_run_extend run_extend{};
+};
+
+RknnBackend::~RknnBackend() {
+    if (!outputs_held.empty()) {
+        rknn_outputs_release(ctx, outputs_held.size(), outputs_held.data());
+    }
+    for (rknn_tensor_mem* mem : input_mems) {
+        if (mem != NULL) {
+            rknn_destroy_mem(ctx, mem);
+        }
+    }
+    if (ctx != 0) {
+        rknn_destroy(ctx);
+    }
+}
+
+int RknnBackend::load(const std::string& model_path) {
+    // a zero size makes rknn_init read the model from the path
+    int ret = rknn_init(&ctx, (void *)model_path.c_str(), 0, 0, NULL);
+    if (ret < 0) {
+        printf("rknn_init fail! ret=%d\n", ret);
+        ctx = 0;
+        return -1;
+    }
+
+    rknn_input_output_num io_num;
+    ret = rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
+    if (ret != RKNN_SUCC) {
+        printf("rknn_query fail! ret=%d\n", ret);
+        return -1;
+    }
+
+    rknn_input_attrs.resize(io_num.n_input);
+    for (uint32_t i = 0; i < io_num.n_input; i++) {
+        rknn_tensor_attr& attr = rknn_input_attrs[i];
+        memset(&attr, 0, sizeof(attr));
+        attr.index = i;
+        ret = rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &attr, sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC) {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+        input_attrs.push_back(from_rknn_attr(attr));
+    }
+    for (uint32_t i = 0; i < io_num.n_output; i++) {
+        rknn_tensor_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.index = i;
+        ret = rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &attr, sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC) {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+        output_attrs.push_back(from_rknn_attr(attr));
+    }
+    input_mems.assign(io_num.n_input, NULL);
+    return 0;
+}
+
+void* RknnBackend::bindInputBuffer(int index, TensorType type, TensorFormat fmt, uint32_t size, int* fd) {
+    rknn_tensor_attr* attr = &rknn_input_attrs[index];
+    // a padded row stride would not match a packed buffer
+    if (input_mems[index] != NULL || attr->fmt != to_rknn_format(fmt) ||
+        (attr->w_stride != 0 && attr->w_stride != attr->dims[2])) {
+        return NULL;
+    }
+    uint32_t mem_size = attr->size_with_stride > size ? attr->size_with_stride : size;
+    rknn_tensor_mem* mem = rknn_create_mem(ctx, mem_size);
+    if (mem == NULL) {
+        return NULL;
+    }
+    attr->type = to_rknn_type(type);
+    attr->fmt = to_rknn_format(fmt);
+    int ret = rknn_set_io_mem(ctx, mem, attr);
+    if (ret != RKNN_SUCC) {
+        printf("rknn_set_io_mem fail! ret=%d\n", ret);
+        rknn_destroy_mem(ctx, mem);
+        return NULL;
+    }
+    printf("model input %d bound with rknn_set_io_mem, size=%u\n", index, mem_size);
+    input_mems[index] = mem;
+    if (fd != NULL) {
+        *fd = mem->fd;
+    }
+    return mem->virt_addr;
+}
+
+int RknnBackend::setInput(int index, const void* data, uint32_t size, TensorType type, TensorFormat fmt) {
+    rknn_input input;
+    memset(&input, 0, sizeof(input));
+    input.index = index;
+    input.buf = (void *)data;
+    input.size = size;
+    input.type = to_rknn_type(type);
+    input.fmt = to_rknn_format(fmt);
+    pending_inputs.push_back(input);
+    return 0;
+}
+
+int RknnBackend::runAsync() {
+    int ret;
+    // rknn_inputs_set copies, so the caller's buffers only need to live until here
+    if (!pending_inputs.empty()) {
+        ret = rknn_inputs_set(ctx, pending_inputs.size(), pending_inputs.data());
+        pending_inputs.clear();
+        if (ret < 0) {
+            printf("rknn_input_set fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+    memset(&run_extend, 0, sizeof(run_extend));
+    run_extend.non_block = 1;
+    ret = rknn_run(ctx, &run_extend);
+    if (ret < 0) {
+        printf("rknn_run fail! ret=%d\n", ret);
+        return -1;
+    }
+    return 0;
+}
+
+int RknnBackend::wait() {
+    int ret = rknn_wait(ctx, &run_extend);
+    if (ret < 0) {
+        printf("rknn_wait fail! ret=%d\n", ret);
+        return -1;
+    }
+    return 0;
+}
+
+int RknnBackend::getOutputs(TensorOutput* outputs, int n) {
+    outputs_held.resize(n);
+    memset(outputs_held.data(), 0, n * sizeof(rknn_output));
+    for (int i = 0; i < n; i++) {
+        outputs_held[i].index = outputs[i].index;
+        outputs_held[i].want_float = outputs[i].want_float;
+    }
+    int ret = rknn_outputs_get(ctx, n, outputs_held.data(), NULL);
+    if (ret < 0) {
+        printf("rknn_outputs_get fail! ret=%d\n", ret);
+        outputs_held.clear();
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        outputs[i].buf = outputs_held[i].buf;
+        outputs[i].size = outputs_held[i].size;
+    }
+    return 0;
+}
+
+void RknnBackend::releaseOutputs(TensorOutput* outputs, int n) {
+    if (!outputs_held.empty()) {
+        rknn_outputs_release(ctx, outputs_held.size(), outputs_held.data());
+        outputs_held.clear();
+    }
+    for (int i = 0; i < n; i++) {
+        outputs[i].buf = NULL;
+        outputs[i].size = 0;
+    }
+}
+
+std::unique_ptr<InferenceBackend> makeRknnBackend() {
+    return std::make_unique<RknnBackend>();
+}
@@ -0,0 +1,369 @@
+#include "subscription_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+SubscriptionServer::SubscriptionServer(
+        const std::string& path,
+        ResultRing& results,
+        std::atomic<bool>& isRunning,
+        int max_lag,
+        int max_subscribers)
+    : path(path),
+      results(results),
+      consumer(results.addConsumer()),
+      running(isRunning),
+      max_lag(std::min(max_lag, SUBSCRIPTION_LOG_CAPACITY)),
+      max_subscribers(max_subscribers),
+      sink_metrics("subscriptions"),
+      subscriber_count(metrics().gauge("bsext_subscribers", "Clients connected to the subscription socket")) {
+    if (max_lag < 1) {
+        throw std::invalid_argument("SubscriptionServer: max_lag must be positive");
+    }
+    struct sockaddr_un addr;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("Unix socket path too long: " + path);
+    }
+    for (const char* format : {"json", "bsvar", "binary"}) {
+        MessageLog log;
+        log.format = format;
+        log.formatter = makeMessageFormatter(format);
+        log.messages.resize(SUBSCRIPTION_LOG_CAPACITY);
+        log.transcript.resize(SUBSCRIPTION_LOG_CAPACITY);
+        logs.push_back(std::move(log));
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        throw std::runtime_error("Socket creation failed");
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    // a socket file left by a previous run would make bind fail
+    unlink(path.c_str());
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+        failSetup("Cannot listen on " + path);
+    }
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0) {
+        failSetup("SubscriptionServer: eventfd creation failed");
+    }
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        failSetup("SubscriptionServer: epoll creation failed");
+    }
+    for (int fd : {listen_fd, event_fd}) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            failSetup("SubscriptionServer: epoll_ctl failed");
+        }
+    }
+    results.setEventFd(event_fd);
+}
+
+// The destructor does not run when the constructor throws, so undo what it set up
+void SubscriptionServer::failSetup(const std::string& what) {
+    std::string error = what + ": " + strerror(errno);
+    closeSockets();
+    throw std::runtime_error(error);
+}
+
+// Closes the listening socket, eventfd and epoll fd, whichever are open, and removes the socket file
+void SubscriptionServer::closeSockets() {
+    for (int* fd : {&epoll_fd, &event_fd, &listen_fd}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    unlink(path.c_str());
+}
+
+SubscriptionServer::~SubscriptionServer() {
+    for (auto& entry : subscribers) {
+        close(entry.first);
+    }
+    closeSockets();
+}
+
+void SubscriptionServer::acceptClients() {
+    for (;;) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        if ((int)subscribers.size() >= max_subscribers) {
+            static const char full[] = "error: too many subscribers";
+            (void)!send(fd, full, sizeof(full) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+            close(fd);
+            continue;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        subscribers.emplace(fd, Subscriber{fd});
+        subscriber_count.set(subscribers.size());
+    }
+}
+
+// "subscribe <format> [transcripts]"
+void SubscriptionServer::readCommand(Subscriber& sub) {
+    char buf[256];
+    ssize_t n = recv(sub.fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (n <= 0) {
+        closing.push_back(sub.fd);
+        return;
+    }
+    buf[n] = '\0';
+    std::istringstream command(buf);
+    std::string verb, format, filter;
+    command >> verb >> format >> filter;
+    std::string error;
+    if (verb != "subscribe") {
+        error = "error: expected subscribe <json|bsvar|binary> [transcripts]";
+    } else if (!filter.empty() && filter != "transcripts") {
+        error = "error: unknown filter " + filter;
+    } else {
+        for (MessageLog& log : logs) {
+            if (log.format == format) {
+                subscribe(sub, log, filter == "transcripts");
+                return;
+            }
+        }
+        error = "error: unknown format " + format;
+    }
+    (void)!send(sub.fd, error.data(), error.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    closing.push_back(sub.fd);
+}
+
+void SubscriptionServer::subscribe(Subscriber& sub, MessageLog& log, bool transcripts_only) {
+    if (sub.log) {
+        sub.log->subscribers--;
+    }
+    log.subscribers++;
+    sub.log = &log;
+    sub.transcripts_only = transcripts_only;
+    // only results from now on
+    sub.cursor = log.head;
+    stats.subscribed++;
+    std::cout << "Subscriber " << sub.fd << " on " << path << " subscribed to " << log.format
+              << (transcripts_only ? " transcripts" : "") << std::endl;
+}
+
+// Format new results once per subscribed format, then send to everyone who can take them
+void SubscriptionServer::drainResults() {
+    uint64_t count;
+    (void)!read(event_fd, &count, sizeof(count));
+    const InferenceResult* result;
+    bool any = false;
+    while ((result = results.poll(consumer))) {
+        stats.results++;
+        sink_metrics.results.add();
+        for (MessageLog& log : logs) {
+            if (log.subscribers == 0) {
+                continue;
+            }
+            size_t slot = log.head % SUBSCRIPTION_LOG_CAPACITY;
+            auto format_start = std::chrono::steady_clock::now();
+            log.formatter->formatMessage(*result, log.messages[slot]);
+            sink_metrics.format.recordSince(format_start);
+            tracer().complete("format", result->trace_id, format_start, std::chrono::steady_clock::now());
+            log.transcript[slot] = result->carriesTranscript();
+            log.head++;
+            stats.formatted++;
+        }
+        results.release(consumer);
+        any = true;
+    }
+    sink_metrics.lag.set(results.getStats(consumer).lag);
+    if (!any) {
+        return;
+    }
+    for (auto& entry : subscribers) {
+        Subscriber& sub = entry.second;
+        if (!sub.log) {
+            continue;
+        }
+        // subscribers waiting for EPOLLOUT drop here, the others send
+        trimLag(sub);
+        if (!sub.want_write) {
+            flush(sub);
+        }
+    }
+}
+
+// Drop the oldest messages of a subscriber more than max_lag behind
+void SubscriptionServer::trimLag(Subscriber& sub) {
+    MessageLog* log = sub.log;
+    if (log->head - sub.cursor > (uint64_t)max_lag) {
+        uint64_t keep_from = log->head - max_lag;
+        for (uint64_t pos = sub.cursor; pos < keep_from; ++pos) {
+            if (!sub.transcripts_only || log->transcript[pos % SUBSCRIPTION_LOG_CAPACITY]) {
+                sub.dropped++;
+                stats.dropped++;
+                sink_metrics.dropped.add();
+            }
+        }
+        sub.cursor = keep_from;
+    }
+}
+
+void SubscriptionServer::flush(Subscriber& sub) {
+    MessageLog* log = sub.log;
+    trimLag(sub);
+    while (sub.cursor < log->head) {
+        struct mmsghdr msgs[PUBLISHER_MAX_BATCH];
+        struct iovec iov[PUBLISHER_MAX_BATCH];
+        uint64_t next[PUBLISHER_MAX_BATCH];     // cursor after each message
+        int n = 0;
+        uint64_t pos = sub.cursor;
+        for (; pos < log->head && n < PUBLISHER_MAX_BATCH; ++pos) {
+            size_t slot = pos % SUBSCRIPTION_LOG_CAPACITY;
+            if (sub.transcripts_only && !log->transcript[slot]) {
+                continue;
+            }
+            iov[n].iov_base = (void*)log->messages[slot].data();
+            iov[n].iov_len = log->messages[slot].size();
+            next[n] = pos + 1;
+            n++;
+        }
+        if (n == 0) {
+            sub.cursor = pos;
+            return;
+        }
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < n; ++i) {
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        auto send_start = std::chrono::steady_clock::now();
+        int sent = sendmmsg(sub.fd, msgs, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+        sink_metrics.send.recordSince(send_start);
+        stats.syscalls++;
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                setWantWrite(sub, true);
+            } else {
+                closing.push_back(sub.fd);
+            }
+            return;
+        }
+        sub.sent += sent;
+        stats.messages += sent;
+        sink_metrics.messages.add(sent);
+        if (sent < n) {
+            // socket buffer full, resume on EPOLLOUT
+            sub.cursor = next[sent - 1];
+            setWantWrite(sub, true);
+            return;
+        }
+        sub.cursor = pos;
+    }
+}
+
+void SubscriptionServer::setWantWrite(Subscriber& sub, bool want) {
+    if (sub.want_write == want) {
+        return;
+    }
+    sub.want_write = want;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | (want ? EPOLLOUT : 0);
+    ev.data.fd = sub.fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, sub.fd, &ev);
+}
+
+void SubscriptionServer::removeSubscriber(int fd) {
+    auto it = subscribers.find(fd);
+    if (it == subscribers.end()) {
+        return;
+    }
+    Subscriber& sub = it->second;
+    if (sub.log) {
+        sub.log->subscribers--;
+        stats.unsubscribed++;
+        std::cout << "Subscriber " << fd << " on " << path << " left: sent=" << sub.sent << " dropped=" << sub.dropped
+                  << std::endl;
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    subscribers.erase(it);
+    subscriber_count.set(subscribers.size());
+}
+
+void SubscriptionServer::reportStats() {
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - last_report).count();
+    if (elapsed < PUBLISHER_REPORT_SECONDS) {
+        return;
+    }
+    if (stats.results > 0 || stats.subscribed > 0) {
+        printf("subscription server %s: subscribers=%zu joined=%ld left=%ld results=%ld formatted=%ld sent=%ld "
+               "dropped=%ld syscalls/s=%.2f max_lag=%llu\n",
+               path.c_str(), subscribers.size(), stats.subscribed, stats.unsubscribed, stats.results,
+               stats.formatted, stats.messages, stats.dropped, stats.syscalls / elapsed,
+               (unsigned long long)results.getStats(consumer).max_lag);
+    }
+    stats = SubscriptionStats{};
+    last_report = now;
+}
+
+void SubscriptionServer::operator()() {
+    tracer().setThreadName("subscriptions");
+    last_report = std::chrono::steady_clock::now();
+    struct epoll_event events[32];
+    while (running) {
+        // the timeout only paces the stats report; results arrive through event_fd
+        int n = epoll_wait(epoll_fd, events, 32, 1000);
+        if (n < 0 && errno != EINTR) {
+            std::cout << "Subscription server epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd) {
+                acceptClients();
+            } else if (fd == event_fd) {
+                drainResults();
+            } else {
+                auto it = subscribers.find(fd);
+                if (it == subscribers.end()) {
+                    continue;
+                }
+                Subscriber& sub = it->second;
+                if (events[i].events & EPOLLIN) {
+                    readCommand(sub);
+                }
+                if (events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
+                    closing.push_back(fd);
+                } else if ((events[i].events & EPOLLOUT) && sub.log) {
+                    setWantWrite(sub, false);
+                    flush(sub);
+                }
+            }
+        }
+        for (int fd : closing) {
+            removeSubscriber(fd);
+        }
+        closing.clear();
+        reportStats();
+    }
+}
@@ -0,0 +1,141 @@
+#include "trace.h"
+
+#include <cstdio>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "message_writer.h"
+
+static_assert((TRACE_RING_CAPACITY & (TRACE_RING_CAPACITY - 1)) == 0, "trace ring capacity must be a power of two");
+
+static thread_local uint64_t current_trace_id = 0;
+
+static int thread_id() {
+    static thread_local int tid = (int)syscall(SYS_gettid);
+    return tid;
+}
+
+Tracer::Tracer() : epoch(std::chrono::steady_clock::now()), slots(new Slot[TRACE_RING_CAPACITY]) {}
+
+uint64_t Tracer::current() {
+    return current_trace_id;
+}
+
+void Tracer::setCurrent(uint64_t trace_id) {
+    current_trace_id = trace_id;
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    std::lock_guard<std::mutex> lock(names_mutex);
+    int tid = thread_id();
+    for (auto& entry : thread_names) {
+        if (entry.first == tid) {
+            entry.second = name;
+            return;
+        }
+    }
+    thread_names.emplace_back(tid, name);
+}
+
+int64_t Tracer::micros(std::chrono::steady_clock::time_point t) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t - epoch).count();
+}
+
+void Tracer::record(const TraceEvent& event) {
+    uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[index & (TRACE_RING_CAPACITY - 1)];
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event = event;
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+}
+
+void Tracer::complete(const char* name, uint64_t trace_id, std::chrono::steady_clock::time_point start,
+                      std::chrono::steady_clock::time_point end) {
+    if (trace_id == 0) {
+        return;
+    }
+    int64_t start_us = micros(start);
+    record({trace_id, name, 'X', thread_id(), start_us, micros(end) - start_us});
+}
+
+void Tracer::instant(const char* name, uint64_t trace_id) {
+    if (trace_id == 0) {
+        return;
+    }
+    record({trace_id, name, 'i', thread_id(), micros(std::chrono::steady_clock::now()), 0});
+}
+
+// {"traceEvents":[{"name":"encode","ph":"X","ts":1200,"dur":450,"pid":1,"tid":812,"args":{"trace_id":3}},...]}
+void Tracer::writeChromeJson(std::string& out) {
+    MessageWriter w(out);
+    w.raw("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> lock(names_mutex);
+        for (const auto& entry : thread_names) {
+            w.raw(first ? "" : ",");
+            w.raw("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+            w.integer(entry.first);
+            w.raw(",\"args\":{\"name\":");
+            w.jsonString(entry.second);
+            w.raw("}}");
+            first = false;
+        }
+    }
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t begin = end > TRACE_RING_CAPACITY ? end - TRACE_RING_CAPACITY : 0;
+    for (uint64_t index = begin; index < end; ++index) {
+        Slot& slot = slots[index & (TRACE_RING_CAPACITY - 1)];
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq != 2 * index + 2) {
+            // still being written, or already overwritten
+            continue;
+        }
+        TraceEvent event = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq) {
+            continue;
+        }
+        w.raw(first ? "" : ",");
+        w.raw("{\"name\":");
+        w.jsonString(event.name);
+        w.raw(",\"cat\":\"interaction\",\"ph\":\"");
+        w.raw(event.phase == 'X' ? "X" : "i");
+        w.raw("\",\"ts\":");
+        w.integer(event.start_us);
+        if (event.phase == 'X') {
+            w.raw(",\"dur\":");
+            w.integer(event.dur_us);
+        } else {
+            // instants are drawn on their thread's track
+            w.raw(",\"s\":\"t\"");
+        }
+        w.raw(",\"pid\":1,\"tid\":");
+        w.integer(event.tid);
+        w.raw(",\"args\":{\"trace_id\":");
+        w.integer(event.trace_id);
+        w.raw("}}");
+        first = false;
+    }
+    w.raw("]}\n");
+}
+
+bool Tracer::dump(const std::string& path) {
+    std::string json;
+    writeChromeJson(json);
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(json.data(), 1, json.size(), f) == json.size();
+    ok = fclose(f) == 0 && ok;
+    // readers never see a half-written dump
+    return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+Tracer& tracer() {
+    static Tracer instance;
+    return instance;
+}
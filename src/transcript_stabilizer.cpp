@@ -0,0 +1,59 @@
+#include "transcript_stabilizer.h"
+
+#include <sstream>
+
+static std::vector<std::string> split_words(const std::string& text) {
+    std::vector<std::string> words;
+    std::istringstream in(text);
+    std::string word;
+    while (in >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+void TranscriptStabilizer::reset() {
+    committed.clear();
+    previous.clear();
+    published.clear();
+    stats = PartialTranscriptStats{};
+}
+
+bool TranscriptStabilizer::update(const std::string& hypothesis, std::string& out) {
+    stats.decoded++;
+    std::vector<std::string> words = split_words(hypothesis);
+    if (words.empty()) {
+        // failed or silent decode, keep showing the last partial
+        stats.unchanged++;
+        return false;
+    }
+
+    // commit what this hypothesis and the previous one agree on
+    size_t agree = 0;
+    while (agree < words.size() && agree < previous.size() && words[agree] == previous[agree]) {
+        agree++;
+    }
+    if (agree > committed.size()) {
+        committed.assign(words.begin(), words.begin() + agree);
+    }
+    previous = std::move(words);
+    stats.stable_words = committed.size();
+
+    // committed words stay as they are, the hypothesis only supplies the tail
+    out.clear();
+    for (const std::string& word : committed) {
+        out += out.empty() ? "" : " ";
+        out += word;
+    }
+    for (size_t i = committed.size(); i < previous.size(); ++i) {
+        out += out.empty() ? "" : " ";
+        out += previous[i];
+    }
+    if (out == published) {
+        stats.unchanged++;
+        return false;
+    }
+    published = out;
+    stats.published++;
+    return true;
+}
@@ -22,167 +22,72 @@
 #include <vector>
 #include "process.h"
 
-static void dump_tensor_attr(rknn_tensor_attr *attr)
+int init_whisper_model(const char *model_path, whisper_model_context_t *app_ctx)
 {
-    char dims_str[100];
-    char temp_str[100];
-    memset(dims_str, 0, sizeof(dims_str));
-    for (int i = 0; i < attr->n_dims; i++)
+    std::unique_ptr<InferenceBackend> backend = loadInferenceBackend(model_path);
+    if (backend == nullptr)
     {
-        strcpy(temp_str, dims_str);
-        if (i == attr->n_dims - 1)
-        {
-            sprintf(dims_str, "%s%d", temp_str, attr->dims[i]);
-        }
-        else
-        {
-            sprintf(dims_str, "%s%d, ", temp_str, attr->dims[i]);
-        }
-    }
-
-    printf("  index=%d, name=%s, n_dims=%d, dims=[%s], n_elems=%d, size=%d, fmt=%s, type=%s, qnt_type=%s, zp=%d, scale=%f\n",
-           attr->index, attr->name, attr->n_dims, dims_str, attr->n_elems, attr->size, get_format_string(attr->fmt),
-           get_type_string(attr->type), get_qnt_type_string(attr->qnt_type), attr->zp, attr->scale);
-}
-
-int init_whisper_model(const char *model_path, rknn_voice_app_context_t *app_ctx)
-{
-    int ret;
-    int model_len = 0;
-    rknn_context ctx = 0;
-
-    // Load RKNN Model
-    ret = rknn_init(&ctx, (void *)model_path, model_len, 0, NULL);
-    if (ret < 0)
-    {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("load model fail! %s\n", model_path);
         return -1;
     }
 
-    // Get Model Input Output Number
-    rknn_input_output_num io_num;
-    ret = rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
-    if (ret != RKNN_SUCC)
-    {
-        printf("rknn_query fail! ret=%d\n", ret);
-        return -1;
-    }
-    printf("model input num: %d, output num: %d\n", io_num.n_input, io_num.n_output);
-
-    // Get Model Input Info
     printf("input tensors:\n");
-    rknn_tensor_attr input_attrs[io_num.n_input];
-    memset(input_attrs, 0, sizeof(input_attrs));
-    for (int i = 0; i < io_num.n_input; i++)
+    for (int i = 0; i < backend->numInputs(); i++)
     {
-        input_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &(input_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC)
-        {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
-        }
-        dump_tensor_attr(&(input_attrs[i]));
+        printTensorAttr(backend->inputAttr(i));
     }
-
-    // Get Model Output Info
     printf("output tensors:\n");
-    rknn_tensor_attr output_attrs[io_num.n_output];
-    memset(output_attrs, 0, sizeof(output_attrs));
-    for (int i = 0; i < io_num.n_output; i++)
+    for (int i = 0; i < backend->numOutputs(); i++)
     {
-        output_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC)
-        {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
-        }
-        dump_tensor_attr(&(output_attrs[i]));
+        printTensorAttr(backend->outputAttr(i));
     }
 
-    // Set to context
-    app_ctx->rknn_ctx = ctx;
-    app_ctx->io_num = io_num;
-    app_ctx->input_attrs = (rknn_tensor_attr *)malloc(io_num.n_input * sizeof(rknn_tensor_attr));
-    memcpy(app_ctx->input_attrs, input_attrs, io_num.n_input * sizeof(rknn_tensor_attr));
-    app_ctx->output_attrs = (rknn_tensor_attr *)malloc(io_num.n_output * sizeof(rknn_tensor_attr));
-    memcpy(app_ctx->output_attrs, output_attrs, io_num.n_output * sizeof(rknn_tensor_attr));
-
+    app_ctx->backend = backend.release();
     return 0;
 }
 
-int release_whisper_model(rknn_voice_app_context_t *app_ctx)
+int release_whisper_model(whisper_model_context_t *app_ctx)
 {
-    if (app_ctx->input_attrs != NULL)
-    {
-        free(app_ctx->input_attrs);
-        app_ctx->input_attrs = NULL;
-    }
-    if (app_ctx->output_attrs != NULL)
-    {
-        free(app_ctx->output_attrs);
-        app_ctx->output_attrs = NULL;
-    }
-    if (app_ctx->rknn_ctx != 0)
-    {
-        rknn_destroy(app_ctx->rknn_ctx);
-        app_ctx->rknn_ctx = 0;
-    }
+    delete app_ctx->backend;
+    app_ctx->backend = NULL;
     return 0;
 }
 
-int inference_encoder_model(rknn_voice_app_context_t *app_ctx, std::vector<float> audio_data, float *mel_filters, float *encoder_output)
+int inference_encoder_model(whisper_model_context_t *app_ctx, std::vector<float> audio_data, float *mel_filters, float *encoder_output)
 {
     int ret;
-
-    rknn_input inputs[1];
-    rknn_output outputs[1];
-
-    memset(inputs, 0, sizeof(inputs));
-    memset(outputs, 0, sizeof(outputs));
+    InferenceBackend *model = app_ctx->backend;
+    TensorOutput outputs[1];
 
     // Set Input Data
-    inputs[0].index = 0;
-    inputs[0].type = RKNN_TENSOR_FLOAT32;
-    inputs[0].size = N_MELS * ENCODER_INPUT_SIZE * sizeof(float);
-    inputs[0].buf = (float *)malloc(inputs[0].size);
-    memcpy(inputs[0].buf, audio_data.data(), inputs[0].size);
-
-    ret = rknn_inputs_set(app_ctx->rknn_ctx, 1, inputs);
+    ret = model->setInput(0, audio_data.data(), N_MELS * ENCODER_INPUT_SIZE * sizeof(float), TensorType::Float32,
+                          TensorFormat::Undefined);
     if (ret < 0)
     {
-        printf("rknn_input_set fail! ret=%d\n", ret);
-        goto out;
+        printf("setInput fail! ret=%d\n", ret);
+        return ret;
     }
 
     // Run
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    ret = model->run();
     if (ret < 0)
     {
-        printf("rknn_run fail! ret=%d\n", ret);
-        goto out;
+        printf("model run fail! ret=%d\n", ret);
+        return ret;
     }
 
     // Get Output
-    outputs[0].want_float = 1;
-    ret = rknn_outputs_get(app_ctx->rknn_ctx, 1, outputs, NULL);
+    ret = model->getOutputs(outputs, 1);
     if (ret < 0)
     {
-        printf("rknn_outputs_get fail! ret=%d\n", ret);
-        goto out;
+        printf("getOutputs fail! ret=%d\n", ret);
+        return ret;
     }
 
     memcpy(encoder_output, (float *)outputs[0].buf, ENCODER_OUTPUT_SIZE * sizeof(float));
 
-out:
-
-    // Remeber to release rknn output
-    rknn_outputs_release(app_ctx->rknn_ctx, 1, outputs);
-    if (inputs[0].buf != NULL)
-    {
-        free(inputs[0].buf);
-    }
+    // Remeber to release the outputs
+    model->releaseOutputs(outputs, 1);
 
     return ret;
 }
@@ -205,26 +110,16 @@ bool has_repeated_ngram(const std::vector<int>& tokens, int ngram_len, int min_r
 }
 
 int inference_decoder_model(
-    rknn_voice_app_context_t *app_ctx,
+    whisper_model_context_t *app_ctx,
     float *encoder_output,
     VocabEntry *vocab,
     int task_code,
-    std::vector<std::string> &recognized_text
+    std::vector<std::string> &recognized_text,
+    whisper_perf_t *perf
 ) {
-    int ret;
-    rknn_input inputs[2];
-    rknn_output outputs[1];
-    memset(inputs, 0, sizeof(inputs));
-    memset(outputs, 0, sizeof(outputs));
-    inputs[0].index = 0;
-    inputs[0].type = RKNN_TENSOR_INT64;
-    inputs[0].size = MAX_TOKENS * sizeof(int64_t);
-    inputs[0].buf = (int64_t *)malloc(inputs[0].size);
-    inputs[1].index = 1;
-    inputs[1].type = RKNN_TENSOR_FLOAT32;
-    inputs[1].size = DECODER_INPUT_SIZE * sizeof(float);
-    inputs[1].buf = (float *)malloc(inputs[1].size);
-    memcpy(inputs[1].buf, encoder_output, inputs[1].size);
+    int ret = 0;
+    InferenceBackend *model = app_ctx->backend;
+    TensorOutput outputs[1];
 
     int64_t tokens[MAX_TOKENS + 1] = {50258, task_code, 50359, 50363};
     int timestamp_begin = 50364;
@@ -233,7 +128,7 @@ int inference_decoder_model(
     int pop_id = MAX_TOKENS;
     int vocab_size = 50257; // adjust if your vocab is different
 
-    const int MAX_DECODE_STEPS = 200;
+    const int MAX_DECODE_STEPS = WHISPER_MAX_DECODE_STEPS;
     const int REPEAT_WINDOW = 20;
     const int MAX_TOKEN_REPEAT = 10;
     const int MAX_OUT_OF_VOCAB = 5; // allowed out-of-vocab before abort
@@ -247,25 +142,29 @@ int inference_decoder_model(
         memcpy(&tokens[i * 4], tokens, 4 * sizeof(int64_t));
     }
 
+    TIMER step_timer;
+    perf->decode_steps = 0;
     while (next_token != end_token && count < MAX_DECODE_STEPS) {
         count++;
 
-        memcpy(inputs[0].buf, tokens, inputs[0].size);
-
-        ret = rknn_inputs_set(app_ctx->rknn_ctx, 2, inputs);
+        step_timer.tik();
+        ret = model->setInput(0, tokens, MAX_TOKENS * sizeof(int64_t), TensorType::Int64, TensorFormat::Undefined);
+        if (ret >= 0) {
+            ret = model->setInput(1, encoder_output, DECODER_INPUT_SIZE * sizeof(float), TensorType::Float32,
+                                  TensorFormat::Undefined);
+        }
         if (ret < 0) {
-            printf("rknn_input_set fail! ret=%d\n", ret);
+            printf("setInput fail! ret=%d\n", ret);
             break;
         }
-        ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+        ret = model->run();
         if (ret < 0) {
-            printf("rknn_run fail! ret=%d\n", ret);
+            printf("model run fail! ret=%d\n", ret);
             break;
         }
-        outputs[0].want_float = 1;
-        ret = rknn_outputs_get(app_ctx->rknn_ctx, 1, outputs, NULL);
+        ret = model->getOutputs(outputs, 1);
         if (ret < 0) {
-            printf("rknn_outputs_get fail! ret=%d\n", ret);
+            printf("getOutputs fail! ret=%d\n", ret);
             break;
         }
 
@@ -273,6 +172,8 @@ int inference_decoder_model(
         int total_floats = outputs[0].size / sizeof(float);
         vocab_size = outputs[0].size / sizeof(float);
         next_token = argmax((float *)outputs[0].buf, total_floats);
+        step_timer.tok();
+        perf->decode_step_ms[perf->decode_steps++] = step_timer.get_time();
 
         // Out-of-range check
         if (next_token < 0 || next_token >= vocab_size) {
@@ -280,10 +181,10 @@ int inference_decoder_model(
             consecutive_out_of_vocab++;
             if (consecutive_out_of_vocab > MAX_OUT_OF_VOCAB) {
                 std::cout << "Too many out-of-vocab tokens. Breaking out.\n";
-                rknn_outputs_release(app_ctx->rknn_ctx, 1, outputs);
+                model->releaseOutputs(outputs, 1);
                 break;
             }
-            rknn_outputs_release(app_ctx->rknn_ctx, 1, outputs);
+            model->releaseOutputs(outputs, 1);
             continue;
         }
         consecutive_out_of_vocab = 0;
@@ -294,6 +195,7 @@ int inference_decoder_model(
         const int NGRAM_REPEAT_MIN = 3; // How many times must it repeat?
         if (has_repeated_ngram(recent_tokens, NGRAM_LEN, NGRAM_REPEAT_MIN)) {
                 std::cout << "Detected repeated n-gram in output. Breaking out.\n";
+                model->releaseOutputs(outputs, 1);
                 break;
         }
         if ((int)recent_tokens.size() > REPEAT_WINDOW)
@@ -302,7 +204,7 @@ int inference_decoder_model(
         int repeats = std::count(recent_tokens.begin(), recent_tokens.end(), next_token);
         if (repeats >= MAX_TOKEN_REPEAT) {
             std::cout << "Detected repeated token (" << next_token << ") " << repeats << " times in window. Breaking out.\n";
-            rknn_outputs_release(app_ctx->rknn_ctx, 1, outputs);
+            model->releaseOutputs(outputs, 1);
             break;
         }
 
@@ -310,7 +212,7 @@ int inference_decoder_model(
         all_token_str += next_token_str;
 
         if (next_token > timestamp_begin) {
-            rknn_outputs_release(app_ctx->rknn_ctx, 1, outputs);
+            model->releaseOutputs(outputs, 1);
             continue;
         }
         if (pop_id > 4) pop_id--;
@@ -318,7 +220,7 @@ int inference_decoder_model(
         for (int j = pop_id; j < MAX_TOKENS; j++)
             tokens[j] = tokens[j + 1];
 
-        rknn_outputs_release(app_ctx->rknn_ctx, 1, outputs);
+        model->releaseOutputs(outputs, 1);
     }
 
     // Post-process output
@@ -332,20 +234,20 @@ int inference_decoder_model(
         recognized_text.push_back(all_token_str);
     }
 
-    for (int i = 0; i < 2; i++) {
-        if (inputs[i].buf != NULL)
-            free(inputs[i].buf);
-    }
-
     return ret;
 }
 
-int inference_whisper_model(rknn_whisper_context_t *app_ctx, std::vector<float> audio_data, float *mel_filters, VocabEntry *vocab, int task_code, std::vector<std::string> &recognized_text)
+int inference_whisper_model(whisper_context_t *app_ctx, std::vector<float> audio_data, float *mel_filters, VocabEntry *vocab, int task_code, std::vector<std::string> &recognized_text)
 {
     int ret;
     TIMER timer;
-    float *encoder_output = (float *)malloc(ENCODER_OUTPUT_SIZE * sizeof(float));
     recognized_text.clear();
+    if (app_ctx->encoder_context.backend == NULL || app_ctx->decoder_context.backend == NULL)
+    {
+        printf("whisper model not loaded\n");
+        return -1;
+    }
+    float *encoder_output = (float *)malloc(ENCODER_OUTPUT_SIZE * sizeof(float));
     timer.tik();
     ret = inference_encoder_model(&app_ctx->encoder_context, audio_data, mel_filters, encoder_output);
     if (ret != 0)
@@ -354,17 +256,18 @@ int inference_whisper_model(rknn_whisper_context_t *app_ctx, std::vector<float>
         goto out;
     }
     timer.tok();
-    timer.print_time("inference_encoder_model");
+    app_ctx->perf.encoder_ms = timer.get_time();
 
     timer.tik();
-    ret = inference_decoder_model(&app_ctx->decoder_context, encoder_output, vocab, task_code, recognized_text);
+    ret = inference_decoder_model(&app_ctx->decoder_context, encoder_output, vocab, task_code, recognized_text,
+                                  &app_ctx->perf);
     if (ret != 0)
     {
         printf("inference_decoder_model fail! ret=%d\n", ret);
         goto out;
     }
     timer.tok();
-    timer.print_time("inference_decoder_model");
+    app_ctx->perf.decoder_ms = timer.get_time();
 
 out:
     if (encoder_output != NULL)